@@ -25,6 +25,8 @@ int main(int argc, char **argv){
     double alpha = 0.05;
     int64_t n_permutations = 1000;
     uint64_t random_seed = 42;
+    std::string test_str = "sequential";
+    int64_t n_threads = 0;
 
     ArgumentHandler arger;
     arger.description = "Train a conditional inference tree model from tabular data (CSV/TSV).";
@@ -69,6 +71,17 @@ int main(int argc, char **argv){
         [&](const std::string &optarg) -> void {
             random_seed = std::stoull(optarg);
         }));
+    arger.push_back(std::make_tuple(2, 'T', "selection-test", true, "<method>",
+        "Variable selection test: permutation, sequential (stops permuting once the outcome is clear),"
+        " or asymptotic (no permutations) (default: sequential).",
+        [&](const std::string &optarg) -> void {
+            test_str = optarg;
+        }));
+    arger.push_back(std::make_tuple(2, 'j', "threads", true, "<int>",
+        "Number of threads used for permutation tests; 0 uses all hardware threads (default: 0).",
+        [&](const std::string &optarg) -> void {
+            n_threads = std::stoll(optarg);
+        }));
 
     arger.Launch(argc, argv);
 
@@ -79,6 +92,18 @@ int main(int argc, char **argv){
         throw std::runtime_error("An output file must be specified via -o or --output.");
     }
 
+    // Parse the variable selection test.
+    Stats::SelectionTest selection_test = Stats::SelectionTest::sequential;
+    if(test_str == "permutation"){
+        selection_test = Stats::SelectionTest::permutation;
+    }else if(test_str == "sequential"){
+        selection_test = Stats::SelectionTest::sequential;
+    }else if(test_str == "asymptotic"){
+        selection_test = Stats::SelectionTest::asymptotic;
+    }else{
+        throw std::runtime_error("Unknown selection test '" + test_str + "'. Use permutation, sequential, or asymptotic.");
+    }
+
     // Read the input file.
     std::ifstream fi(input_file);
     if(!fi.good()){
@@ -103,6 +128,8 @@ int main(int argc, char **argv){
     // Train the model.
     Stats::ConditionalInferenceTrees<double> model(max_depth, min_samples_split, alpha,
                                                     n_permutations, random_seed);
+    model.set_selection_test(selection_test);
+    model.set_n_threads(n_threads);
     model.fit(X, y);
 
     // Save the model.
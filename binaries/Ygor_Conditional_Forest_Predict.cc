@@ -5,6 +5,7 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <tuple>
@@ -20,12 +21,15 @@ int main(int argc, char **argv){
     std::string model_file;
     std::string input_file;
     bool has_header = false;
+    bool stream = false;
+    int64_t block_rows = 65536;
+    int64_t n_threads = 0;
 
     ArgumentHandler arger;
     arger.description = "Predict using a trained conditional random forest model.";
 
     arger.push_back(std::make_tuple(1, 'm', "model", true, "<file>",
-        "Trained model file to load.",
+        "Trained model file to load, in either the text or the binary format.",
         [&](const std::string &optarg) -> void {
             model_file = optarg;
         }));
@@ -39,6 +43,22 @@ int main(int argc, char **argv){
         [&](const std::string &) -> void {
             has_header = true;
         }));
+    arger.push_back(std::make_tuple(2, 's', "stream", false, "",
+        "Stream the input: read, predict, and write blocks of rows concurrently, holding only a few blocks in"
+        " memory at once. Throughput statistics are printed to stderr when done.",
+        [&](const std::string &) -> void {
+            stream = true;
+        }));
+    arger.push_back(std::make_tuple(2, 'b', "block-rows", true, "<int>",
+        "Number of rows per block when streaming (default: 65536).",
+        [&](const std::string &optarg) -> void {
+            block_rows = std::stoll(optarg);
+        }));
+    arger.push_back(std::make_tuple(2, 'j', "threads", true, "<int>",
+        "Number of threads used for prediction (default: 0, which uses all hardware threads).",
+        [&](const std::string &optarg) -> void {
+            n_threads = std::stoll(optarg);
+        }));
 
     arger.Launch(argc, argv);
 
@@ -48,39 +68,56 @@ int main(int argc, char **argv){
     if(input_file.empty()){
         throw std::runtime_error("An input file must be specified via -i or --input.");
     }
+    if(block_rows <= 0){
+        throw std::runtime_error("The number of rows per block must be positive.");
+    }
 
     // Load the model.
     Stats::ConditionalRandomForests<double> model;
     {
-        std::ifstream fm(model_file);
+        std::ifstream fm(model_file, std::ios::in | std::ios::binary);
         if(!fm.good()){
             throw std::runtime_error("Unable to open model file '" + model_file + "'.");
         }
-        if(!model.read_from(fm)){
+        // Either the binary or the text format is accepted.
+        const bool ok = Stats::is_binary_model(fm) ? model.read_binary(fm)
+                                                   : model.read_from(fm);
+        if(!ok){
             throw std::runtime_error("Failed to read model from '" + model_file + "'.");
         }
     }
 
+    model.set_n_threads(n_threads);
+
     // Read the input file.
     std::ifstream fi(input_file);
     if(!fi.good()){
         throw std::runtime_error("Unable to open input file '" + input_file + "'.");
     }
 
-    auto csv_result = ReadNumArrayFromCSV<double>(fi, has_header);
-    const auto &all_data = csv_result.data;
-    const int64_t n_rows = all_data.num_rows();
-    const int64_t n_cols = all_data.num_cols();
+    if(stream){
+        const std::function<num_array<double>(const num_array<double> &)> score = [&](const num_array<double> &X){
+            return model.predict_batch(X);
+        };
+        const auto stats = ScoreCSVStream<double>(fi, std::cout, score, block_rows, has_header);
+
+        const double rows_per_second = (0.0 < stats.wall_seconds)
+                                     ? static_cast<double>(stats.n_rows) / stats.wall_seconds
+                                     : std::numeric_limits<double>::infinity();
+        std::cerr << "Predicted " << stats.n_rows << " rows in " << stats.n_blocks << " blocks in "
+                  << stats.wall_seconds << " s (" << rows_per_second << " rows/s)." << std::endl;
+        std::cerr << "Time spent reading: " << stats.read_seconds << " s, predicting: " << stats.score_seconds
+                  << " s, writing: " << stats.write_seconds << " s." << std::endl;
+        return 0;
+    }
 
-    // Reuse a single 1xN buffer to avoid per-row subarray allocation and copy.
-    num_array<double> x(1, n_cols);
+    auto csv_result = ReadNumArrayFromCSV<double>(fi, has_header);
+    const auto predictions = model.predict_batch(csv_result.data);
+    const int64_t n_rows = predictions.num_rows();
     for(int64_t r = 0; r < n_rows; ++r){
-        for(int64_t c = 0; c < n_cols; ++c){
-            x.coeff(0, c) = all_data.read_coeff(r, c);
-        }
-        double prediction = model.predict(x);
-        std::cout << prediction << std::endl;
+        std::cout << predictions.read_coeff(r, 0) << '\n';
     }
+    std::cout.flush();
 
     return 0;
 }
@@ -29,6 +29,8 @@ int main(int argc, char **argv){
     double subsample_fraction = 0.632;
     double correlation_threshold = 0.20;
     uint64_t random_seed = 42;
+    std::string test_str = "sequential";
+    int64_t n_threads = 0;
     std::string importance_str = "none";
 
     ArgumentHandler arger;
@@ -99,6 +101,17 @@ int main(int argc, char **argv){
         [&](const std::string &optarg) -> void {
             importance_str = optarg;
         }));
+    arger.push_back(std::make_tuple(2, 'T', "selection-test", true, "<method>",
+        "Variable selection test: permutation, sequential (stops permuting once the outcome is clear),"
+        " or asymptotic (no permutations) (default: sequential).",
+        [&](const std::string &optarg) -> void {
+            test_str = optarg;
+        }));
+    arger.push_back(std::make_tuple(2, 'j', "threads", true, "<int>",
+        "Number of threads used for permutation tests; 0 uses all hardware threads (default: 0).",
+        [&](const std::string &optarg) -> void {
+            n_threads = std::stoll(optarg);
+        }));
 
     arger.Launch(argc, argv);
 
@@ -121,6 +134,18 @@ int main(int argc, char **argv){
         throw std::runtime_error("Unknown importance method '" + importance_str + "'. Use none, permutation, or conditional.");
     }
 
+    // Parse the variable selection test.
+    Stats::SelectionTest selection_test = Stats::SelectionTest::sequential;
+    if(test_str == "permutation"){
+        selection_test = Stats::SelectionTest::permutation;
+    }else if(test_str == "sequential"){
+        selection_test = Stats::SelectionTest::sequential;
+    }else if(test_str == "asymptotic"){
+        selection_test = Stats::SelectionTest::asymptotic;
+    }else{
+        throw std::runtime_error("Unknown selection test '" + test_str + "'. Use permutation, sequential, or asymptotic.");
+    }
+
     // Read the input file.
     std::ifstream fi(input_file);
     if(!fi.good()){
@@ -148,6 +173,8 @@ int main(int argc, char **argv){
                                                    subsample_fraction, correlation_threshold,
                                                    random_seed);
     model.set_importance_method(importance_method);
+    model.set_selection_test(selection_test);
+    model.set_n_threads(n_threads);
     model.fit(X, y);
 
     // Compute and display feature importances.
@@ -0,0 +1,570 @@
+//Ygor_Index_Benchmark.cc -- A command-line utility to benchmark the spatial indexes.
+//
+// Synthetic point and box distributions are indexed using each of the spatial indexes, and the construction time,
+// memory use, and range, radius, and k-nearest-neighbour query performance are measured. Results are emitted as CSV or
+// JSON so they can be tracked over releases.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#if defined(__GLIBC__)
+    #include <malloc.h>
+#endif
+
+#include "YgorArguments.h"
+#include "YgorMath.h"
+#include "YgorString.h"
+#include "YgorIndex.h"
+#include "YgorIndexKDTree.h"
+#include "YgorIndexRTree.h"
+#include "YgorIndexOctree.h"
+#include "YgorIndexLinearOctree.h"
+#include "YgorIndexCells.h"
+
+using bbox_t = index_bbox<double>;
+
+// Bytes currently allocated on the heap, or -1 if unavailable.
+static int64_t heap_bytes_in_use(){
+#if defined(__GLIBC__) && ((2 < __GLIBC__) || ((__GLIBC__ == 2) && (33 <= __GLIBC_MINOR__)))
+    const auto mi = mallinfo2();
+    return static_cast<int64_t>(mi.uordblks + mi.hblkhd);
+#else
+    return -1;
+#endif
+}
+
+template <class F>
+static double time_ms(F f){
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+//------------------------------------------------ Synthetic data -------------------------------------------------------
+
+struct dataset {
+    std::string distribution;
+    bool boxes = false;
+    std::vector<bbox_t> items;
+    double query_size = 1.0; // Edge length of the range queries, chosen so each returns a handful of items.
+};
+
+// Generate N items within (roughly) a 100 unit cube.
+//
+// - 'uniform' items are distributed uniformly.
+// - 'clustered' items are normally distributed around 100 randomly-placed centres.
+// - 'planar' items lie on a regular grid within a stack of parallel planes, like the voxels of CT image slices. Each
+//   slice holds at most 512x512 items, and there are many exact ties in coordinates.
+//
+// Boxes have a random extent of up to a few times the typical item spacing.
+static dataset generate(const std::string &distribution, bool boxes, size_t N, uint64_t seed){
+    dataset d;
+    d.distribution = distribution;
+    d.boxes = boxes;
+    d.items.reserve(N);
+
+    std::mt19937_64 re(seed);
+    std::uniform_real_distribution<double> rd(0.0, 100.0);
+    const double spacing = 100.0 / std::cbrt(static_cast<double>(std::max<size_t>(N, 1)));
+
+    if(distribution == "uniform"){
+        for(size_t i = 0; i < N; ++i){
+            const vec3<double> p(rd(re), rd(re), rd(re));
+            d.items.emplace_back(p, p);
+        }
+
+    }else if(distribution == "clustered"){
+        std::vector<vec3<double>> centres;
+        for(size_t i = 0; i < 100; ++i) centres.emplace_back(rd(re), rd(re), rd(re));
+        std::normal_distribution<double> rn(0.0, 2.0);
+        std::uniform_int_distribution<size_t> rc(0, centres.size() - 1);
+        for(size_t i = 0; i < N; ++i){
+            const auto p = centres[rc(re)] + vec3<double>(rn(re), rn(re), rn(re));
+            d.items.emplace_back(p, p);
+        }
+
+    }else if(distribution == "planar"){
+        const size_t slice_capacity = 512 * 512;
+        const size_t N_slices = std::max<size_t>(1, (N + slice_capacity - 1) / slice_capacity);
+        const size_t per_slice = (N + N_slices - 1) / N_slices;
+        const auto side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(per_slice))));
+        const double pitch = 100.0 / static_cast<double>(side);
+        const double slice_thickness = std::max(pitch, 100.0 / static_cast<double>(N_slices));
+        for(size_t i = 0; i < N; ++i){
+            const size_t slice = i / per_slice;
+            const size_t j = i % per_slice;
+            const vec3<double> p(pitch * static_cast<double>(j % side),
+                                 pitch * static_cast<double>(j / side),
+                                 slice_thickness * static_cast<double>(slice));
+            d.items.emplace_back(p, p);
+        }
+
+    }else{
+        throw std::invalid_argument("Unknown distribution '" + distribution + "'. Use uniform, clustered, or planar.");
+    }
+
+    if(boxes){
+        std::uniform_real_distribution<double> rs(0.0, 3.0 * spacing);
+        for(auto &b : d.items) b.max = b.min + vec3<double>(rs(re), rs(re), rs(re));
+    }
+
+    // Size the queries so that a uniform distribution would return approximately 16 items per query.
+    d.query_size = 100.0 * std::cbrt(16.0 / static_cast<double>(std::max<size_t>(N, 1)));
+    return d;
+}
+
+struct query_set {
+    std::vector<bbox_t> boxes;
+    std::vector<vec3<double>> centres;
+    double radius = 0.0;
+    size_t k = 10;
+};
+
+// Queries are centred near randomly-selected items so that they probe the occupied regions of every distribution.
+static query_set generate_queries(const dataset &d, size_t N_queries, size_t k, uint64_t seed){
+    query_set q;
+    q.k = k;
+    q.radius = 0.5 * d.query_size;
+    if(d.items.empty()) return q;
+
+    std::mt19937_64 re(seed);
+    std::uniform_int_distribution<size_t> ri(0, d.items.size() - 1);
+    std::uniform_real_distribution<double> rj(-0.5 * d.query_size, 0.5 * d.query_size);
+    const vec3<double> half(0.5 * d.query_size, 0.5 * d.query_size, 0.5 * d.query_size);
+    for(size_t i = 0; i < N_queries; ++i){
+        const auto c = d.items[ri(re)].min + vec3<double>(rj(re), rj(re), rj(re));
+        q.centres.push_back(c);
+        q.boxes.emplace_back(c - half, c + half);
+    }
+    return q;
+}
+
+//------------------------------------------------ Measurement ----------------------------------------------------------
+
+struct query_stats {
+    size_t queries = 0;          // Number of queries evaluated.
+    double mean_us = 0.0;        // Single-threaded latency.
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+    double qps_single = 0.0;     // Single-threaded throughput.
+    double qps_multi = 0.0;      // Multi-threaded throughput.
+    double mean_results = 0.0;   // Mean number of results per query.
+};
+
+struct result_row {
+    std::string index;
+    std::string distribution;
+    std::string geometry;
+    size_t N = 0;
+    size_t threads = 1;
+    double build_ms = 0.0;
+    int64_t memory_bytes = -1;
+    query_stats range;
+    query_stats radius;
+    query_stats knn;
+};
+
+// Evaluate a query, which returns the number of results, over the query set. Queries are first evaluated one at a time
+// (stopping early once the time budget is exhausted), then the same queries are split over multiple threads.
+static query_stats measure(size_t N_queries, size_t N_threads, double budget_ms,
+                           const std::function<size_t(size_t)> &query){
+    query_stats s;
+    std::vector<double> latencies;
+    latencies.reserve(N_queries);
+    size_t results = 0;
+
+    const auto t_start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < N_queries; ++i){
+        const auto t0 = std::chrono::steady_clock::now();
+        results += query(i);
+        const auto t1 = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        if(budget_ms < std::chrono::duration<double, std::milli>(t1 - t_start).count()) break;
+    }
+    s.queries = latencies.size();
+    if(s.queries == 0) return s;
+
+    double total_us = 0.0;
+    for(const auto l : latencies) total_us += l;
+    s.mean_us = total_us / static_cast<double>(s.queries);
+    s.qps_single = 1.0E6 / s.mean_us;
+    s.mean_results = static_cast<double>(results) / static_cast<double>(s.queries);
+    std::sort(latencies.begin(), latencies.end());
+    s.p50_us = latencies[s.queries / 2];
+    s.p99_us = latencies[std::min(s.queries - 1, (s.queries * 99) / 100)];
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> sink(0);
+    const auto worker = [&](){
+        size_t local = 0;
+        for(size_t i = next++; i < s.queries; i = next++) local += query(i);
+        sink += local;
+    };
+    const auto multi_ms = time_ms([&](){
+        std::vector<std::thread> threads;
+        for(size_t t = 1; t < N_threads; ++t) threads.emplace_back(worker);
+        worker();
+        for(auto &t : threads) t.join();
+    });
+    s.qps_multi = (0.0 < multi_ms) ? (1.0E3 * static_cast<double>(s.queries) / multi_ms) : 0.0;
+    if(sink.load() != results){
+        throw std::logic_error("Query results differ when evaluated concurrently.");
+    }
+    return s;
+}
+
+// Benchmark a single index. 'build' constructs the index from the dataset.
+template <class Index>
+static result_row benchmark_index(const std::string &name,
+                                  const dataset &d,
+                                  const query_set &q,
+                                  size_t N_threads,
+                                  double budget_ms,
+                                  const std::function<std::unique_ptr<Index>(const dataset &)> &build){
+    result_row r;
+    r.index = name;
+    r.distribution = d.distribution;
+    r.geometry = d.boxes ? "boxes" : "points";
+    r.N = d.items.size();
+    r.threads = N_threads;
+
+    std::unique_ptr<Index> idx;
+    const auto heap_before = heap_bytes_in_use();
+    r.build_ms = time_ms([&](){ idx = build(d); });
+    const auto heap_after = heap_bytes_in_use();
+    if((0 <= heap_before) && (0 <= heap_after)) r.memory_bytes = heap_after - heap_before;
+
+    using entry = typename Index::entry;
+    r.range = measure(q.boxes.size(), N_threads, budget_ms, [&](size_t i){
+        size_t n = 0;
+        idx->search(q.boxes[i], [&](const entry &){ ++n; return true; });
+        return n;
+    });
+    r.radius = measure(q.centres.size(), N_threads, budget_ms, [&](size_t i){
+        size_t n = 0;
+        idx->search_radius(q.centres[i], q.radius, [&](const entry &){ ++n; return true; });
+        return n;
+    });
+    r.knn = measure(q.centres.size(), N_threads, budget_ms, [&](size_t i){
+        size_t n = 0;
+        idx->nearest_neighbors(q.centres[i], q.k, [&](const entry &, double){ ++n; return true; });
+        return n;
+    });
+    return r;
+}
+
+// Benchmark the named index.
+static result_row benchmark_named_index(const std::string &name,
+                                        const dataset &d,
+                                        const query_set &q,
+                                        size_t N_threads,
+                                        double budget_ms){
+    if(name == "kdtree"){
+        using index_t = kdtree<double, uint32_t>;
+        return benchmark_index<index_t>(name, d, q, N_threads, budget_ms, [](const dataset &d){
+            auto idx = std::make_unique<index_t>();
+            for(size_t i = 0; i < d.items.size(); ++i) idx->insert(d.items[i], static_cast<uint32_t>(i));
+            idx->freeze();
+            return idx;
+        });
+
+    }else if(name == "rtree"){
+        using index_t = rtree<double, uint32_t>;
+        return benchmark_index<index_t>(name, d, q, N_threads, budget_ms, [](const dataset &d){
+            auto idx = std::make_unique<index_t>(16);
+            std::vector<index_t::entry> entries;
+            entries.reserve(d.items.size());
+            for(size_t i = 0; i < d.items.size(); ++i) entries.emplace_back(d.items[i], static_cast<uint32_t>(i));
+            idx->bulk_load(std::move(entries));
+            return idx;
+        });
+
+    }else if(name == "octree"){
+        using index_t = octree<double, uint32_t>;
+        return benchmark_index<index_t>(name, d, q, N_threads, budget_ms, [](const dataset &d){
+            auto idx = std::make_unique<index_t>(16);
+            for(size_t i = 0; i < d.items.size(); ++i) idx->insert(d.items[i], static_cast<uint32_t>(i));
+            return idx;
+        });
+
+    }else if(name == "linear_octree"){
+        using index_t = linear_octree<double, uint32_t>;
+        return benchmark_index<index_t>(name, d, q, N_threads, budget_ms, [](const dataset &d){
+            auto idx = std::make_unique<index_t>(16);
+            std::vector<index_t::entry> entries;
+            entries.reserve(d.items.size());
+            for(size_t i = 0; i < d.items.size(); ++i) entries.emplace_back(d.items[i], static_cast<uint32_t>(i));
+            idx->build(std::move(entries));
+            return idx;
+        });
+
+    }else if(name == "cells"){
+        using index_t = cells_index<double, uint32_t>;
+        return benchmark_index<index_t>(name, d, q, N_threads, budget_ms, [](const dataset &d){
+            auto idx = std::make_unique<index_t>(d.query_size);
+            for(size_t i = 0; i < d.items.size(); ++i) idx->insert(d.items[i].min, static_cast<uint32_t>(i));
+            idx->compact();
+            return idx;
+        });
+
+    }
+    throw std::invalid_argument("Unknown index '" + name + "'. Use kdtree, rtree, octree, linear_octree, or cells.");
+}
+
+static std::vector<result_row> benchmark_all(const std::vector<std::string> &indexes,
+                                             const dataset &d,
+                                             const query_set &q,
+                                             size_t N_threads,
+                                             double budget_ms){
+    std::vector<result_row> rows;
+    for(const auto &name : indexes){
+        // The cells index can only hold points.
+        if((name == "cells") && d.boxes) continue;
+
+        std::cerr << "Benchmarking " << name << " with " << d.items.size() << " " << d.distribution
+                  << (d.boxes ? " boxes" : " points") << std::endl;
+
+        // Report failures, but continue with the remaining benchmarks.
+        try{
+            rows.push_back(benchmark_named_index(name, d, q, N_threads, budget_ms));
+        }catch(const std::invalid_argument &){
+            throw;
+        }catch(const std::exception &e){
+            std::cerr << "Benchmark of " << name << " failed: " << e.what() << std::endl;
+        }
+    }
+    return rows;
+}
+
+//------------------------------------------------ Output ---------------------------------------------------------------
+
+static void write_csv(std::ostream &os, const std::vector<result_row> &rows){
+    os << "index,distribution,geometry,N,threads,build_ms,memory_bytes";
+    for(const std::string q : { "range", "radius", "knn" }){
+        os << "," << q << "_queries"
+           << "," << q << "_mean_us"
+           << "," << q << "_p50_us"
+           << "," << q << "_p99_us"
+           << "," << q << "_qps_single"
+           << "," << q << "_qps_multi"
+           << "," << q << "_mean_results";
+    }
+    os << "\n";
+    for(const auto &r : rows){
+        os << r.index << "," << r.distribution << "," << r.geometry << "," << r.N << "," << r.threads
+           << "," << r.build_ms << "," << r.memory_bytes;
+        for(const auto *s : { &r.range, &r.radius, &r.knn }){
+            os << "," << s->queries
+               << "," << s->mean_us
+               << "," << s->p50_us
+               << "," << s->p99_us
+               << "," << s->qps_single
+               << "," << s->qps_multi
+               << "," << s->mean_results;
+        }
+        os << "\n";
+    }
+    os.flush();
+    return;
+}
+
+static void write_json(std::ostream &os, const std::vector<result_row> &rows){
+    const auto write_stats = [&](const std::string &name, const query_stats &s){
+        os << "\"" << name << "\": { "
+           << "\"queries\": " << s.queries
+           << ", \"mean_us\": " << s.mean_us
+           << ", \"p50_us\": " << s.p50_us
+           << ", \"p99_us\": " << s.p99_us
+           << ", \"qps_single\": " << s.qps_single
+           << ", \"qps_multi\": " << s.qps_multi
+           << ", \"mean_results\": " << s.mean_results
+           << " }";
+    };
+
+    os << "{\n"
+       << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+       << "  \"results\": [";
+    for(size_t i = 0; i < rows.size(); ++i){
+        const auto &r = rows[i];
+        os << ((i == 0) ? "\n" : ",\n")
+           << "    { \"index\": \"" << r.index << "\""
+           << ", \"distribution\": \"" << r.distribution << "\""
+           << ", \"geometry\": \"" << r.geometry << "\""
+           << ", \"N\": " << r.N
+           << ", \"threads\": " << r.threads
+           << ", \"build_ms\": " << r.build_ms
+           << ", \"memory_bytes\": " << r.memory_bytes << ",\n      ";
+        write_stats("range", r.range);
+        os << ",\n      ";
+        write_stats("radius", r.radius);
+        os << ",\n      ";
+        write_stats("knn", r.knn);
+        os << " }";
+    }
+    os << "\n  ]\n}\n";
+    os.flush();
+    return;
+}
+
+int main(int argc, char **argv){
+
+    std::string indexes_str = "kdtree,rtree,octree,linear_octree,cells";
+    std::string distributions_str = "uniform,clustered,planar";
+    std::string geometry_str = "points,boxes";
+    std::string sizes_str = "1e3,1e4,1e5,1e6";
+    std::string format = "csv";
+    std::string output_file;
+    int64_t n_queries = 10'000;
+    int64_t k = 10;
+    int64_t n_threads = static_cast<int64_t>(std::max<unsigned int>(1U, std::thread::hardware_concurrency()));
+    double budget_ms = 2'000.0;
+    uint64_t random_seed = 42;
+
+    ArgumentHandler arger;
+    arger.description = "Benchmark the spatial indexes using synthetic point and box distributions."
+                        " Construction time, memory use, and range, radius, and k-nearest-neighbour query latency and"
+                        " throughput are reported.";
+    arger.examples = { { "--sizes 1e3,1e5,1e7 --distributions planar --format json -o results.json",
+                         "Benchmark all indexes using CT-slice-like points and boxes." },
+                       { "--indexes kdtree,cells --geometry points --threads 8",
+                         "Compare two indexes using eight threads for the throughput measurements." } };
+
+    arger.push_back(std::make_tuple(1, 'x', "indexes", true, "<list>",
+        "Comma-separated list of indexes to benchmark: kdtree, rtree, octree, linear_octree, and/or cells"
+        " (default: all).",
+        [&](const std::string &optarg) -> void {
+            indexes_str = optarg;
+        }));
+    arger.push_back(std::make_tuple(1, 'd', "distributions", true, "<list>",
+        "Comma-separated list of distributions: uniform, clustered, and/or planar (default: all).",
+        [&](const std::string &optarg) -> void {
+            distributions_str = optarg;
+        }));
+    arger.push_back(std::make_tuple(1, 'g', "geometry", true, "<list>",
+        "Comma-separated list of geometry: points and/or boxes (default: both). The cells index only supports points.",
+        [&](const std::string &optarg) -> void {
+            geometry_str = optarg;
+        }));
+    arger.push_back(std::make_tuple(1, 'n', "sizes", true, "<list>",
+        "Comma-separated list of the number of items to index, e.g., 1e3,1e8 (default: 1e3,1e4,1e5,1e6).",
+        [&](const std::string &optarg) -> void {
+            sizes_str = optarg;
+        }));
+    arger.push_back(std::make_tuple(2, 'q', "queries", true, "<int>",
+        "Number of queries of each type (default: 10000).",
+        [&](const std::string &optarg) -> void {
+            n_queries = std::stoll(optarg);
+        }));
+    arger.push_back(std::make_tuple(2, 'k', "k", true, "<int>",
+        "Number of nearest neighbours to find (default: 10).",
+        [&](const std::string &optarg) -> void {
+            k = std::stoll(optarg);
+        }));
+    arger.push_back(std::make_tuple(2, 't', "threads", true, "<int>",
+        "Number of threads used to measure query throughput (default: hardware concurrency).",
+        [&](const std::string &optarg) -> void {
+            n_threads = std::stoll(optarg);
+        }));
+    arger.push_back(std::make_tuple(2, 'b', "budget", true, "<ms>",
+        "Time budget for each query type; fewer queries are evaluated if exceeded (default: 2000).",
+        [&](const std::string &optarg) -> void {
+            budget_ms = std::stod(optarg);
+        }));
+    arger.push_back(std::make_tuple(2, 'r', "random-seed", true, "<int>",
+        "Random seed (default: 42).",
+        [&](const std::string &optarg) -> void {
+            random_seed = std::stoull(optarg);
+        }));
+    arger.push_back(std::make_tuple(3, 'f', "format", true, "<format>",
+        "Output format: csv or json (default: csv).",
+        [&](const std::string &optarg) -> void {
+            format = optarg;
+        }));
+    arger.push_back(std::make_tuple(3, 'o', "output", true, "<file>",
+        "Output file. Results are written to stdout if not provided.",
+        [&](const std::string &optarg) -> void {
+            output_file = optarg;
+        }));
+
+    arger.Launch(argc, argv);
+
+    if((format != "csv") && (format != "json")){
+        throw std::runtime_error("Unknown output format '" + format + "'. Use csv or json.");
+    }
+    if((n_queries < 1) || (k < 1) || (n_threads < 1) || !(0.0 < budget_ms)){
+        throw std::runtime_error("Query count, k, thread count, and budget must be positive.");
+    }
+
+    const auto indexes = SplitStringToVector(indexes_str, ',', 'd');
+    for(const auto &name : indexes){
+        if( (name != "kdtree") && (name != "rtree") && (name != "octree")
+        &&  (name != "linear_octree") && (name != "cells") ){
+            throw std::runtime_error("Unknown index '" + name + "'. Use kdtree, rtree, octree, linear_octree, or cells.");
+        }
+    }
+    const auto distributions = SplitStringToVector(distributions_str, ',', 'd');
+    std::vector<bool> geometries;
+    for(const auto &g : SplitStringToVector(geometry_str, ',', 'd')){
+        if(g == "points"){
+            geometries.push_back(false);
+        }else if(g == "boxes"){
+            geometries.push_back(true);
+        }else{
+            throw std::runtime_error("Unknown geometry '" + g + "'. Use points or boxes.");
+        }
+    }
+    std::vector<size_t> sizes;
+    for(const auto &s : SplitStringToVector(sizes_str, ',', 'd')){
+        const auto N = std::stod(s);
+        if(!(1.0 <= N) || !(N < static_cast<double>(std::numeric_limits<uint32_t>::max()))){
+            throw std::runtime_error("Invalid size '" + s + "'.");
+        }
+        sizes.push_back(static_cast<size_t>(std::llround(N)));
+    }
+
+    std::vector<result_row> rows;
+    for(const auto &distribution : distributions){
+        for(const bool boxes : geometries){
+            for(const auto N : sizes){
+                const auto d = generate(distribution, boxes, N, random_seed);
+                const auto q = generate_queries(d, static_cast<size_t>(n_queries), static_cast<size_t>(k), random_seed + 1);
+                const auto r = benchmark_all(indexes, d, q, static_cast<size_t>(n_threads), budget_ms);
+                rows.insert(rows.end(), r.begin(), r.end());
+            }
+        }
+    }
+
+    std::ofstream fo;
+    if(!output_file.empty()){
+        fo.open(output_file);
+        if(!fo.good()){
+            throw std::runtime_error("Unable to open output file '" + output_file + "'.");
+        }
+    }
+    std::ostream &os = output_file.empty() ? std::cout : fo;
+    if(format == "csv"){
+        write_csv(os, rows);
+    }else{
+        write_json(os, rows);
+    }
+    if(!os.good()){
+        throw std::runtime_error("Failed to write results.");
+    }
+    return 0;
+}
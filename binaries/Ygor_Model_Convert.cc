@@ -0,0 +1,133 @@
+//Ygor_Model_Convert.cc -- A command-line utility to convert trained tree models between the text and binary formats.
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "YgorArguments.h"
+#include "YgorStatsFlatTrees.h"
+#include "YgorStatsStochasticForests.h"
+#include "YgorStatsConditionalForests.h"
+#include "YgorStatsCITrees.h"
+
+namespace {
+
+// Read a model in either format and write it in the requested format.
+template <class M>
+void convert(M &model, std::istream &is, bool input_is_binary, std::ostream &os, bool output_is_binary){
+    const bool read_ok = input_is_binary ? model.read_binary(is)
+                                         : model.read_from(is);
+    if(!read_ok){
+        throw std::runtime_error("Failed to read the input model.");
+    }
+    const bool write_ok = output_is_binary ? model.write_binary(os)
+                                           : model.write_to(os);
+    if(!write_ok){
+        throw std::runtime_error("Failed to write the output model.");
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv){
+
+    std::string input_file;
+    std::string output_file;
+    std::string format_str;
+
+    ArgumentHandler arger;
+    arger.description = "Convert a trained stochastic forest, conditional random forest, or conditional inference tree"
+                        " model between the text and binary formats. The kind and format of the input model are"
+                        " detected automatically.";
+
+    arger.push_back(std::make_tuple(1, 'i', "input", true, "<file>",
+        "Trained model file to convert.",
+        [&](const std::string &optarg) -> void {
+            input_file = optarg;
+        }));
+    arger.push_back(std::make_tuple(1, 'o', "output", true, "<file>",
+        "Output file for the converted model.",
+        [&](const std::string &optarg) -> void {
+            output_file = optarg;
+        }));
+    arger.push_back(std::make_tuple(2, 'f', "format", true, "<text|binary>",
+        "Format of the output model (default: the opposite of the input format).",
+        [&](const std::string &optarg) -> void {
+            format_str = optarg;
+        }));
+
+    arger.Launch(argc, argv);
+
+    if(input_file.empty()){
+        throw std::runtime_error("An input file must be specified via -i or --input.");
+    }
+    if(output_file.empty()){
+        throw std::runtime_error("An output file must be specified via -o or --output.");
+    }
+    if(!format_str.empty() && (format_str != "text") && (format_str != "binary")){
+        throw std::runtime_error("Unrecognized format '" + format_str + "'. Use 'text' or 'binary'.");
+    }
+
+    std::ifstream fi(input_file, std::ios::in | std::ios::binary);
+    if(!fi.good()){
+        throw std::runtime_error("Unable to open input file '" + input_file + "'.");
+    }
+
+    // Identify the kind of model from the binary header or the text format's leading label.
+    Stats::BinaryModelHeader header;
+    const bool input_is_binary = Stats::peek_binary_model_header(fi, header);
+    Stats::BinaryModelKind kind;
+    if(input_is_binary){
+        kind = static_cast<Stats::BinaryModelKind>(header.kind);
+    }else{
+        std::string label;
+        fi >> label;
+        fi.clear();
+        fi.seekg(0);
+        if(label == "StochasticForests_v1"){
+            kind = Stats::BinaryModelKind::stochastic_forests;
+        }else if(label == "ConditionalRandomForests_v1"){
+            kind = Stats::BinaryModelKind::conditional_random_forests;
+        }else if(label == "ConditionalInferenceTrees_v1"){
+            kind = Stats::BinaryModelKind::conditional_inference_trees;
+        }else{
+            throw std::runtime_error("Unable to identify the model stored in '" + input_file + "'.");
+        }
+    }
+    if(input_is_binary && (header.value_size != sizeof(double))){
+        throw std::runtime_error("Only models using double-precision values are supported.");
+    }
+    const bool output_is_binary = format_str.empty() ? !input_is_binary
+                                                     : (format_str == "binary");
+
+    std::ofstream fo(output_file, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!fo.good()){
+        throw std::runtime_error("Unable to open output file '" + output_file + "'.");
+    }
+
+    if(kind == Stats::BinaryModelKind::stochastic_forests){
+        Stats::StochasticForests<double> model;
+        convert(model, fi, input_is_binary, fo, output_is_binary);
+    }else if(kind == Stats::BinaryModelKind::conditional_random_forests){
+        Stats::ConditionalRandomForests<double> model;
+        convert(model, fi, input_is_binary, fo, output_is_binary);
+    }else if(kind == Stats::BinaryModelKind::conditional_inference_trees){
+        Stats::ConditionalInferenceTrees<double> model;
+        convert(model, fi, input_is_binary, fo, output_is_binary);
+    }else{
+        throw std::runtime_error("Unrecognized binary model kind in '" + input_file + "'.");
+    }
+
+    fo.flush();
+    if(!fo.good()){
+        throw std::runtime_error("Unable to write output file '" + output_file + "'.");
+    }
+
+    return 0;
+}
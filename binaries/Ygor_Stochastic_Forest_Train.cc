@@ -26,6 +26,8 @@ int main(int argc, char **argv){
     int64_t max_features = -1;
     uint64_t random_seed = 42;
     std::string importance_str = "none";
+    std::string split_str = "exact";
+    int64_t n_threads = 0;
 
     ArgumentHandler arger;
     arger.description = "Train a stochastic forest model from tabular data (CSV/TSV).";
@@ -75,6 +77,16 @@ int main(int argc, char **argv){
         [&](const std::string &optarg) -> void {
             importance_str = optarg;
         }));
+    arger.push_back(std::make_tuple(2, 'S', "split-method", true, "<method>",
+        "Split finding method: exact, or histogram for faster training on large data (default: exact).",
+        [&](const std::string &optarg) -> void {
+            split_str = optarg;
+        }));
+    arger.push_back(std::make_tuple(2, 'j', "threads", true, "<int>",
+        "Number of threads used to build trees; 0 uses all hardware threads (default: 0).",
+        [&](const std::string &optarg) -> void {
+            n_threads = std::stoll(optarg);
+        }));
 
     arger.Launch(argc, argv);
 
@@ -97,6 +109,16 @@ int main(int argc, char **argv){
         throw std::runtime_error("Unknown importance method '" + importance_str + "'. Use none, gini, or permutation.");
     }
 
+    // Parse the split method.
+    Stats::SplitMethod split_method = Stats::SplitMethod::exact;
+    if(split_str == "exact"){
+        split_method = Stats::SplitMethod::exact;
+    }else if(split_str == "histogram"){
+        split_method = Stats::SplitMethod::histogram;
+    }else{
+        throw std::runtime_error("Unknown split method '" + split_str + "'. Use exact or histogram.");
+    }
+
     // Read the input file.
     std::ifstream fi(input_file);
     if(!fi.good()){
@@ -121,6 +143,8 @@ int main(int argc, char **argv){
     // Train the model.
     Stats::StochasticForests<double> model(n_trees, max_depth, min_samples_split, max_features, random_seed);
     model.set_importance_method(importance_method);
+    model.set_split_method(split_method);
+    model.set_n_threads(n_threads);
     model.fit(X, y);
 
     // Compute and display feature importances.
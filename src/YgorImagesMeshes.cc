@@ -0,0 +1,1226 @@
+//YgorImagesMeshes.cc - Routines that convert between image volumes and surface meshes.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorMisc.h"
+#include "YgorLog.h"
+#include "YgorMath.h"
+#include "YgorImages.h"
+#include "YgorIndexBVH.h"
+#include "YgorImagesMeshes.h"
+
+
+namespace {
+
+// A view of a regular grid of images, ordered along the image normal so voxels are addressable as (row, column, slice).
+template <class T, class R>
+struct regular_image_grid {
+    std::vector<planar_image<T,R>*> imgs;
+
+    int64_t rows    = 0;
+    int64_t columns = 0;
+    int64_t slices  = 0;
+
+    vec3<R> origin;     // Centre of voxel (0,0) in the first image.
+    vec3<R> row_unit;   // Direction of increasing column number.
+    vec3<R> col_unit;   // Direction of increasing row number.
+    vec3<R> slice_unit; // Direction of increasing slice number.
+
+    R dx = static_cast<R>(0); // Separation of adjacent columns.
+    R dy = static_cast<R>(0); // Separation of adjacent rows.
+    R dz = static_cast<R>(0); // Separation of adjacent slices.
+
+    vec3<R> position(int64_t row, int64_t col, int64_t slice) const {
+        return ( this->origin
+               + this->row_unit   * (this->dx * static_cast<R>(col))
+               + this->col_unit   * (this->dy * static_cast<R>(row))
+               + this->slice_unit * (this->dz * static_cast<R>(slice)) );
+    }
+
+    // Convert a position to continuous (row, column, slice) grid coordinates.
+    std::array<R,3> to_grid(const vec3<R> &p) const {
+        const auto d = p - this->origin;
+        return {{ d.Dot(this->col_unit) / this->dy,
+                  d.Dot(this->row_unit) / this->dx,
+                  d.Dot(this->slice_unit) / this->dz }};
+    }
+
+    int64_t voxel_count() const {
+        return this->rows * this->columns * this->slices;
+    }
+};
+
+template <class T, class R>
+regular_image_grid<T,R> make_regular_image_grid(planar_image_collection<T,R> &imgs, int64_t chnl){
+    if(imgs.images.empty()){
+        throw std::invalid_argument("No images provided");
+    }
+
+    std::list<std::reference_wrapper<planar_image<T,R>>> img_refws;
+    for(auto &img : imgs.images) img_refws.emplace_back( std::ref(img) );
+    if(!Images_Form_Regular_Grid(img_refws)){
+        throw std::invalid_argument("Images do not form a regular grid");
+    }
+    for(const auto &img : imgs.images){
+        if(!isininc(0, chnl, img.channels - 1)){
+            throw std::invalid_argument("Channel is not present in all images");
+        }
+    }
+
+    regular_image_grid<T,R> grid;
+    const auto &first = imgs.images.front();
+    grid.rows       = first.rows;
+    grid.columns    = first.columns;
+    grid.slices     = static_cast<int64_t>(imgs.images.size());
+    grid.row_unit   = first.row_unit.unit();
+    grid.col_unit   = first.col_unit.unit();
+    grid.slice_unit = grid.row_unit.Cross(grid.col_unit).unit();
+    grid.dx         = first.pxl_dx;
+    grid.dy         = first.pxl_dy;
+    if( !grid.row_unit.isfinite()
+    ||  !grid.col_unit.isfinite()
+    ||  !grid.slice_unit.isfinite() ){
+        throw std::invalid_argument("Unable to determine image orientation");
+    }
+
+    const auto first_pos = first.position(0, 0);
+    std::vector<std::pair<R, planar_image<T,R>*>> ordered;
+    for(auto &img : imgs.images){
+        ordered.emplace_back( (img.position(0, 0) - first_pos).Dot(grid.slice_unit), std::addressof(img) );
+    }
+    std::sort(std::begin(ordered), std::end(ordered),
+              [](const auto &l, const auto &r){ return (l.first < r.first); });
+    for(const auto &p : ordered) grid.imgs.push_back(p.second);
+
+    grid.origin = grid.imgs.front()->position(0, 0);
+    grid.dz = (1 < grid.slices) ? (grid.imgs[1]->position(0, 0) - grid.origin).Dot(grid.slice_unit)
+                                : first.pxl_dz;
+    return grid;
+}
+
+// Invoke f(k) for every k in [0, N), distributing contiguous blocks across threads.
+inline void parallel_over_slices(int64_t N, const std::function<void(int64_t)> &f){
+    const int64_t n_threads = std::max<int64_t>(1, static_cast<int64_t>(std::thread::hardware_concurrency()));
+    const int64_t n_chunks = std::min(n_threads, N);
+    if(n_chunks <= 1){
+        for(int64_t k = 0; k < N; ++k) f(k);
+        return;
+    }
+    const int64_t chunk = (N + n_chunks - 1) / n_chunks;
+    std::vector<std::future<void>> futures;
+    for(int64_t begin = 0; begin < N; begin += chunk){
+        const int64_t end = std::min(N, begin + chunk);
+        futures.emplace_back( std::async(std::launch::async, [&f, begin, end](){
+            for(int64_t k = begin; k < end; ++k) f(k);
+        }) );
+    }
+    for(auto &fut : futures) fut.get();
+    return;
+}
+
+// A reusable barrier for a fixed number of threads.
+class thread_barrier {
+    private:
+        std::mutex m;
+        std::condition_variable cv;
+        const size_t n_threads;
+        size_t n_waiting = 0;
+        size_t generation = 0;
+
+    public:
+        explicit thread_barrier(size_t n) : n_threads(n) {}
+
+        void arrive_and_wait(){
+            std::unique_lock<std::mutex> lock(this->m);
+            const auto gen = this->generation;
+            if(++(this->n_waiting) == this->n_threads){
+                this->n_waiting = 0;
+                ++(this->generation);
+                this->cv.notify_all();
+            }else{
+                this->cv.wait(lock, [&](){ return (gen != this->generation); });
+            }
+            return;
+        }
+};
+
+// Solve the upwind-discretized eikonal equation |grad(u)| = 1 at a single grid point given the smallest neighbouring
+// value 'a' along each axis and the corresponding grid spacing 'h'.
+inline double solve_eikonal(std::array<std::pair<double,double>,3> ah){
+    std::sort(std::begin(ah), std::end(ah),
+              [](const auto &l, const auto &r){ return (l.first < r.first); });
+    const auto inf = std::numeric_limits<double>::infinity();
+    if(!(ah[0].first < inf)) return inf;
+
+    double u = ah[0].first + ah[0].second;
+    double A = 0.0;
+    double B = 0.0;
+    double C = -1.0;
+    for(size_t n = 0; n < 3; ++n){
+        if(u <= ah[n].first) break;
+
+        const double w = 1.0 / (ah[n].second * ah[n].second);
+        A += w;
+        B += w * ah[n].first;
+        C += w * ah[n].first * ah[n].first;
+        if(n == 0) continue;
+
+        const double disc = B * B - A * C;
+        if(disc < 0.0) break;
+        u = (B + std::sqrt(disc)) / A;
+    }
+    return u;
+}
+
+// Propagate distances outward from frozen voxels using the fast sweeping method. Rows are processed concurrently
+// along (slice, row) hyperplanes, and each row is traversed sequentially in the sweep direction.
+template <class F>
+void fast_sweep(std::vector<F> &u,
+                const std::vector<uint8_t> &frozen,
+                int64_t rows,
+                int64_t columns,
+                int64_t slices,
+                double dx,
+                double dy,
+                double dz,
+                int64_t max_iterations){
+    const auto inf = std::numeric_limits<F>::infinity();
+    const int64_t row_stride = columns;
+    const int64_t slice_stride = rows * columns;
+
+    // Returns true if any voxel was updated.
+    const auto sweep_row = [&](int64_t k, int64_t r, bool forward) -> bool {
+        bool changed = false;
+        const int64_t base = k * slice_stride + r * row_stride;
+        for(int64_t cc = 0; cc < columns; ++cc){
+            const int64_t c = forward ? cc : (columns - 1 - cc);
+            const int64_t idx = base + c;
+            if(frozen[idx] != 0) continue;
+
+            const F a_x = std::min( (0 < c)            ? u[idx - 1]            : inf,
+                                    (c + 1 < columns)  ? u[idx + 1]            : inf );
+            const F a_y = std::min( (0 < r)            ? u[idx - row_stride]   : inf,
+                                    (r + 1 < rows)     ? u[idx + row_stride]   : inf );
+            const F a_z = std::min( (0 < k)            ? u[idx - slice_stride] : inf,
+                                    (k + 1 < slices)   ? u[idx + slice_stride] : inf );
+            const auto candidate = static_cast<F>( solve_eikonal({{ { static_cast<double>(a_x), dx },
+                                                                    { static_cast<double>(a_y), dy },
+                                                                    { static_cast<double>(a_z), dz } }}) );
+            if(candidate < u[idx]){
+                u[idx] = candidate;
+                changed = true;
+            }
+        }
+        return changed;
+    };
+
+    const int64_t n_levels = (slices - 1) + (rows - 1) + 1;
+    const int64_t n_threads = std::clamp<int64_t>( static_cast<int64_t>(std::thread::hardware_concurrency()),
+                                                   1, std::min(slices, rows) );
+    thread_barrier barrier(static_cast<size_t>(n_threads));
+    std::vector<std::atomic<bool>> changed(static_cast<size_t>(std::max<int64_t>(0, max_iterations)));
+    for(auto &c : changed) c.store(false);
+
+    const auto worker = [&](int64_t tid){
+        for(int64_t iter = 0; iter < max_iterations; ++iter){
+            for(int64_t dir = 0; dir < 8; ++dir){
+                const bool fwd_c = ((dir & 1) == 0);
+                const bool fwd_r = ((dir & 2) == 0);
+                const bool fwd_k = ((dir & 4) == 0);
+                for(int64_t l = 0; l < n_levels; ++l){
+                    const int64_t kk_lo = std::max<int64_t>(0, l - (rows - 1));
+                    const int64_t kk_hi = std::min<int64_t>(slices - 1, l);
+                    for(int64_t kk = kk_lo + tid; kk <= kk_hi; kk += n_threads){
+                        const int64_t rr = l - kk;
+                        const int64_t k = fwd_k ? kk : (slices - 1 - kk);
+                        const int64_t r = fwd_r ? rr : (rows - 1 - rr);
+                        if(sweep_row(k, r, fwd_c)) changed[iter].store(true, std::memory_order_relaxed);
+                    }
+                    if(1 < n_threads) barrier.arrive_and_wait();
+                }
+            }
+
+            // Every thread reads the flag after the final barrier of the iteration, so all agree whether to continue.
+            if(!changed[iter].load()) break;
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    for(int64_t tid = 1; tid < n_threads; ++tid){
+        futures.emplace_back( std::async(std::launch::async, worker, tid) );
+    }
+    worker(0);
+    for(auto &fut : futures) fut.get();
+    return;
+}
+
+} // namespace
+
+
+template <class T, class R, class I>
+void Signed_Distance_From_Mesh(planar_image_collection<T,R> &imgs,
+                               const fv_surface_mesh<R,I> &mesh,
+                               int64_t chnl,
+                               Signed_Distance_From_Mesh_Opts opts){
+    static_assert(std::is_floating_point<T>::value, "Signed distances require a floating-point voxel type");
+
+    if( !std::isfinite(opts.narrow_band)
+    ||  !(0.0 < opts.narrow_band) ){
+        throw std::invalid_argument("Narrow band width must be positive and finite");
+    }
+    const auto grid = make_regular_image_grid(imgs, chnl);
+
+    const mesh_bvh<R,I> bvh(mesh);
+    if(bvh.get_size() == 0){
+        throw std::invalid_argument("Mesh contains no faces");
+    }
+
+    const int64_t N_r = grid.rows;
+    const int64_t N_c = grid.columns;
+    const int64_t N_k = grid.slices;
+    const int64_t slice_size = N_r * N_c;
+    const auto inf = std::numeric_limits<T>::infinity();
+
+    std::vector<T> u(static_cast<size_t>(grid.voxel_count()), inf);
+    std::vector<uint8_t> frozen(u.size(), 0);
+
+    const R h_max = std::max({ grid.dx, grid.dy, grid.dz });
+    const R band = static_cast<R>(opts.narrow_band) * h_max;
+
+    const auto compute_all_exactly = [&](){
+        parallel_over_slices(N_k, [&](int64_t k){
+            for(int64_t r = 0; r < N_r; ++r){
+                for(int64_t c = 0; c < N_c; ++c){
+                    const auto idx = k * slice_size + r * N_c + c;
+                    u[idx] = static_cast<T>( bvh.closest_point(grid.position(r, c, k))->distance );
+                    frozen[idx] = 1;
+                }
+            }
+        });
+    };
+
+    if(opts.propagation == Signed_Distance_From_Mesh_Opts::Propagation::Exact){
+        compute_all_exactly();
+
+    }else if(opts.propagation == Signed_Distance_From_Mesh_Opts::Propagation::FastSweeping){
+        // Identify candidate narrow band voxels by rasterizing each triangle's (expanded) bounding box in grid
+        // coordinates. Triangles are bucketed by slice so slices can be processed independently.
+        struct grid_box {
+            int64_t r_lo, r_hi, c_lo, c_hi;
+        };
+        //
+        // If the mesh extends beyond the grid, the nearest surface for some voxels may not be reachable from within the
+        // grid. Since the grid is convex, seeding the outermost voxels with exact distances resolves this.
+        std::vector<std::vector<grid_box>> slice_boxes(static_cast<size_t>(N_k));
+        bool mesh_exceeds_grid = false;
+        const std::array<R,3> pad = {{ band / grid.dy, band / grid.dx, band / grid.dz }};
+        const std::array<int64_t,3> extent = {{ N_r, N_c, N_k }};
+        for(const auto &f : mesh.faces){
+            if(f.size() < 3) continue;
+            for(size_t j = 1; (j + 1) < f.size(); ++j){
+                std::array<R,3> lo, hi;
+                lo.fill( std::numeric_limits<R>::infinity() );
+                hi.fill( -std::numeric_limits<R>::infinity() );
+                for(const auto v : { f[0], f[j], f[j + 1] }){
+                    const auto g = grid.to_grid(mesh.vertices.at(v));
+                    for(size_t a = 0; a < 3; ++a){
+                        mesh_exceeds_grid = mesh_exceeds_grid
+                                         || (g[a] < static_cast<R>(0))
+                                         || (static_cast<R>(extent[a] - 1) < g[a]);
+                        lo[a] = std::min(lo[a], g[a]);
+                        hi[a] = std::max(hi[a], g[a]);
+                    }
+                }
+                std::array<int64_t,3> i_lo, i_hi;
+                bool overlaps = true;
+                for(size_t a = 0; a < 3; ++a){
+                    const R l = std::max<R>( std::ceil(lo[a] - pad[a]), static_cast<R>(0) );
+                    const R h = std::min<R>( std::floor(hi[a] + pad[a]), static_cast<R>(extent[a] - 1) );
+                    if(!(l <= h)){
+                        overlaps = false;
+                        break;
+                    }
+                    i_lo[a] = static_cast<int64_t>(l);
+                    i_hi[a] = static_cast<int64_t>(h);
+                }
+                if(!overlaps) continue;
+                for(int64_t k = i_lo[2]; k <= i_hi[2]; ++k){
+                    slice_boxes[k].push_back( grid_box{ i_lo[0], i_hi[0], i_lo[1], i_hi[1] } );
+                }
+            }
+        }
+
+        std::atomic<bool> any_frozen(false);
+        parallel_over_slices(N_k, [&](int64_t k){
+            std::vector<uint8_t> candidate(static_cast<size_t>(slice_size), 0);
+            for(const auto &b : slice_boxes[k]){
+                for(int64_t r = b.r_lo; r <= b.r_hi; ++r){
+                    std::fill( std::next(std::begin(candidate), r * N_c + b.c_lo),
+                               std::next(std::begin(candidate), r * N_c + b.c_hi + 1), 1 );
+                }
+            }
+            slice_boxes[k].clear();
+            slice_boxes[k].shrink_to_fit();
+
+            bool l_any_frozen = false;
+            for(int64_t r = 0; r < N_r; ++r){
+                for(int64_t c = 0; c < N_c; ++c){
+                    const bool on_boundary = (k == 0) || (k == (N_k - 1))
+                                          || (r == 0) || (r == (N_r - 1))
+                                          || (c == 0) || (c == (N_c - 1));
+                    const bool seed = mesh_exceeds_grid && on_boundary;
+                    if(!seed && (candidate[r * N_c + c] == 0)) continue;
+                    const auto cp = bvh.closest_point(grid.position(r, c, k),
+                                                      seed ? std::numeric_limits<R>::infinity() : band);
+                    if(!cp) continue;
+                    const auto idx = k * slice_size + r * N_c + c;
+                    u[idx] = static_cast<T>(cp->distance);
+                    frozen[idx] = 1;
+                    l_any_frozen = true;
+                }
+            }
+            if(l_any_frozen) any_frozen.store(true);
+        });
+
+        if(any_frozen.load()){
+            fast_sweep(u, frozen, N_r, N_c, N_k,
+                       static_cast<double>(grid.dx),
+                       static_cast<double>(grid.dy),
+                       static_cast<double>(grid.dz),
+                       opts.max_sweep_iterations);
+        }else{
+            YLOGDEBUG("No voxels lie within the narrow band; computing all distances exactly");
+            compute_all_exactly();
+        }
+
+    }else{
+        throw std::logic_error("Propagation option not understood");
+    }
+
+    // Classify voxels as inside or outside and write the signed distances.
+    //
+    // Each row is classified by casting a single ray that begins outside the mesh bounding box and travels along the
+    // row, counting crossings. A ray passing through a shared edge or vertex reports coincident hits, and an open mesh
+    // (or such a ray) can report an odd number of crossings. In these cases the ray is perturbed slightly, and if all
+    // attempts fail each voxel in the row is classified individually.
+    const auto bounds = bvh.get_bounds();
+    const auto bounds_centre = (bounds.min + bounds.max) * static_cast<R>(0.5);
+    const auto bounds_radius = bounds.min.distance(bounds.max) * static_cast<R>(0.5);
+    const std::array<std::pair<R,R>,4> perturbations = {{ { static_cast<R>( 0.0),     static_cast<R>( 0.0)     },
+                                                          { static_cast<R>( 1.37E-4), static_cast<R>( 0.71E-4) },
+                                                          { static_cast<R>(-0.53E-4), static_cast<R>( 1.19E-4) },
+                                                          { static_cast<R>( 0.89E-4), static_cast<R>(-1.61E-4) } }};
+
+    parallel_over_slices(N_k, [&](int64_t k){
+        auto &img = *(grid.imgs[k]);
+        std::vector<uint8_t> inside(static_cast<size_t>(N_c), 0);
+        for(int64_t r = 0; r < N_r; ++r){
+            const auto row_start = grid.position(r, 0, k);
+            const R lead = row_start.distance(bounds_centre) + bounds_radius + grid.dx;
+            const R length = lead + grid.dx * static_cast<R>(N_c);
+            const R tol = static_cast<R>(1000) * std::numeric_limits<R>::epsilon() * length;
+
+            bool classified = false;
+            for(const auto &p : perturbations){
+                const auto start = row_start + grid.col_unit * (p.first * grid.dy)
+                                             + grid.slice_unit * (p.second * grid.dz);
+                const auto hits = bvh.ray_intersections(start - grid.row_unit * lead, grid.row_unit);
+                bool ambiguous = ((hits.size() % 2UL) != 0UL);
+                for(size_t i = 1; !ambiguous && (i < hits.size()); ++i){
+                    ambiguous = ((hits[i].t - hits[i-1].t) <= tol);
+                }
+                if(ambiguous) continue;
+
+                size_t n_crossed = 0;
+                for(int64_t c = 0; c < N_c; ++c){
+                    const R t = lead + grid.dx * static_cast<R>(c);
+                    while((n_crossed < hits.size()) && (hits[n_crossed].t < t)) ++n_crossed;
+                    inside[c] = ((n_crossed % 2UL) == 1UL) ? 1 : 0;
+                }
+                classified = true;
+                break;
+            }
+            if(!classified){
+                for(int64_t c = 0; c < N_c; ++c){
+                    inside[c] = bvh.is_inside(grid.position(r, c, k)) ? 1 : 0;
+                }
+            }
+
+            for(int64_t c = 0; c < N_c; ++c){
+                const auto d = u[k * slice_size + r * N_c + c];
+                img.reference(r, c, chnl) = (inside[c] != 0) ? -d : d;
+            }
+        }
+    });
+    return;
+}
+
+#ifndef YGOR_IMAGES_MESHES_DISABLE_ALL_SPECIALIZATIONS
+    template void Signed_Distance_From_Mesh(planar_image_collection<float ,double> &, const fv_surface_mesh<double, uint32_t> &, int64_t, Signed_Distance_From_Mesh_Opts);
+    template void Signed_Distance_From_Mesh(planar_image_collection<float ,double> &, const fv_surface_mesh<double, uint64_t> &, int64_t, Signed_Distance_From_Mesh_Opts);
+    template void Signed_Distance_From_Mesh(planar_image_collection<double,double> &, const fv_surface_mesh<double, uint32_t> &, int64_t, Signed_Distance_From_Mesh_Opts);
+    template void Signed_Distance_From_Mesh(planar_image_collection<double,double> &, const fv_surface_mesh<double, uint64_t> &, int64_t, Signed_Distance_From_Mesh_Opts);
+#endif
+
+
+namespace {
+
+// Pair up the threshold crossings on the edges of a square with corners given in cyclic order, where edge i joins
+// corners i and (i+1)%4. Diagonally-opposite interior corners are always separated, so cells (or cubes) sharing a
+// square will always agree.
+inline std::vector<std::pair<int,int>> square_crossing_pairs(const std::array<bool,4> &inside){
+    std::vector<int> crossed;
+    for(int i = 0; i < 4; ++i){
+        if(inside[i] != inside[(i + 1) % 4]) crossed.push_back(i);
+    }
+
+    std::vector<std::pair<int,int>> out;
+    if(crossed.size() == 2){
+        out.emplace_back(crossed[0], crossed[1]);
+    }else if(crossed.size() == 4){
+        for(int i = 0; i < 4; ++i){
+            if(inside[i]) out.emplace_back((i + 3) % 4, i);
+        }
+    }
+    return out;
+}
+
+// The corners of a square cell in cyclic order. Corners are encoded as (column, row) offsets in bits 0 and 1.
+constexpr std::array<int,4> square_cycle = {{ 0, 1, 3, 2 }};
+
+// Marching squares segments for each of the 16 cases, where bit q of the case is set when corner q is inside. Segments
+// join cell edges (numbered as in square_crossing_pairs() using square_cycle) and are directed so the interior lies to
+// the left.
+inline const std::array<std::vector<std::pair<int,int>>,16> & marching_squares_table(){
+    static const auto table = [](){
+        std::array<std::vector<std::pair<int,int>>,16> t;
+        const auto corner = [](int i) -> std::array<double,2> {
+            const auto b = square_cycle[i];
+            return {{ static_cast<double>(b & 1), static_cast<double>((b >> 1) & 1) }};
+        };
+        const auto midpoint = [&](int e) -> std::array<double,2> {
+            const auto a = corner(e);
+            const auto b = corner((e + 1) % 4);
+            return {{ 0.5 * (a[0] + b[0]), 0.5 * (a[1] + b[1]) }};
+        };
+
+        for(int cs = 0; cs < 16; ++cs){
+            std::array<bool,4> inside;
+            for(int i = 0; i < 4; ++i) inside[i] = (((cs >> square_cycle[i]) & 1) != 0);
+
+            for(auto p : square_crossing_pairs(inside)){
+                // The interior endpoint of either crossed edge lies on the interior side of the segment.
+                const int ci = inside[p.first] ? p.first : ((p.first + 1) % 4);
+                const auto m1 = midpoint(p.first);
+                const auto m2 = midpoint(p.second);
+                const auto c = corner(ci);
+                const double cross = (m2[0] - m1[0]) * (c[1] - m1[1]) - (m2[1] - m1[1]) * (c[0] - m1[0]);
+                if(cross < 0.0) std::swap(p.first, p.second);
+                t[cs].push_back(p);
+            }
+        }
+        return t;
+    }();
+    return table;
+}
+
+// A cube edge, described by its lower corner and axis (0 = column, 1 = row, 2 = slice). Cube corners are encoded as
+// (column, row, slice) offsets in bits 0-2. Edges are numbered 4*axis + n, where n enumerates lower corners in order.
+struct cube_edge {
+    int corner;
+    int axis;
+};
+
+inline const std::array<cube_edge,12> & cube_edges(){
+    static const auto edges = [](){
+        std::array<cube_edge,12> e;
+        for(int a = 0; a < 3; ++a){
+            int n = 0;
+            for(int c = 0; c < 8; ++c){
+                if((c & (1 << a)) != 0) continue;
+                e[4 * a + n] = cube_edge{ c, a };
+                ++n;
+            }
+        }
+        return e;
+    }();
+    return edges;
+}
+
+// Marching cubes triangles for each of the 256 cases, where bit q of the case is set when corner q is inside.
+// Triangles are given as cube edge numbers and are oriented so normals point from the interior to the exterior.
+//
+// The cases are derived by applying the square_crossing_pairs() rule to all six faces, joining the resulting segments
+// into closed loops, and fan-triangulating each loop.
+inline const std::array<std::vector<std::array<int,3>>,256> & marching_cubes_table(){
+    static const auto table = [](){
+        const auto &edges = cube_edges();
+        const auto edge_between = [&](int c0, int c1) -> int {
+            const auto lo = std::min(c0, c1);
+            const auto hi = std::max(c0, c1);
+            for(int e = 0; e < 12; ++e){
+                if( (edges[e].corner == lo)
+                &&  ((lo | (1 << edges[e].axis)) == hi) ) return e;
+            }
+            throw std::logic_error("Corners do not share a cube edge");
+        };
+        const auto corner_pos = [](int c) -> vec3<double> {
+            return vec3<double>( static_cast<double>(c & 1),
+                                 static_cast<double>((c >> 1) & 1),
+                                 static_cast<double>((c >> 2) & 1) );
+        };
+
+        std::array<std::vector<std::array<int,3>>,256> t;
+        for(int cs = 0; cs < 256; ++cs){
+            const auto inside = [&](int c){ return (((cs >> c) & 1) != 0); };
+
+            // Link crossed edges that are joined by a segment on one of the faces.
+            std::array<std::vector<int>,12> links;
+            for(int a = 0; a < 3; ++a){
+                const int u = (a + 1) % 3;
+                const int v = (a + 2) % 3;
+                for(int side = 0; side < 2; ++side){
+                    const int base = (side << a);
+                    const std::array<int,4> cyc = {{ base, base | (1 << u), base | (1 << u) | (1 << v), base | (1 << v) }};
+                    std::array<bool,4> in;
+                    for(int i = 0; i < 4; ++i) in[i] = inside(cyc[i]);
+                    for(const auto &p : square_crossing_pairs(in)){
+                        const int e1 = edge_between(cyc[p.first], cyc[(p.first + 1) % 4]);
+                        const int e2 = edge_between(cyc[p.second], cyc[(p.second + 1) % 4]);
+                        links[e1].push_back(e2);
+                        links[e2].push_back(e1);
+                    }
+                }
+            }
+
+            // Every crossed edge borders two faces, so the links form closed loops.
+            std::array<bool,12> visited;
+            visited.fill(false);
+            for(int e0 = 0; e0 < 12; ++e0){
+                if(links[e0].empty() || visited[e0]) continue;
+
+                std::vector<int> loop;
+                int prev = -1;
+                int cur = e0;
+                do{
+                    if(links[cur].size() != 2) throw std::logic_error("Marching cubes face segments do not form a loop");
+                    loop.push_back(cur);
+                    visited[cur] = true;
+                    const int next = (links[cur][0] != prev) ? links[cur][0] : links[cur][1];
+                    prev = cur;
+                    cur = next;
+                }while(cur != e0);
+
+                // Orient the loop so its normal agrees with the interior-to-exterior direction along the crossed edges.
+                vec3<double> n(0.0, 0.0, 0.0);
+                vec3<double> d(0.0, 0.0, 0.0);
+                for(size_t i = 0; i < loop.size(); ++i){
+                    const auto &ea = edges[loop[i]];
+                    const auto &eb = edges[loop[(i + 1) % loop.size()]];
+                    const auto pa = (corner_pos(ea.corner) + corner_pos(ea.corner | (1 << ea.axis))) * 0.5;
+                    const auto pb = (corner_pos(eb.corner) + corner_pos(eb.corner | (1 << eb.axis))) * 0.5;
+                    n += pa.Cross(pb);
+
+                    const auto dir = corner_pos(ea.corner | (1 << ea.axis)) - corner_pos(ea.corner);
+                    d += inside(ea.corner) ? dir : (dir * -1.0);
+                }
+                if(n.Dot(d) < 0.0) std::reverse(std::begin(loop), std::end(loop));
+
+                for(size_t i = 1; (i + 1) < loop.size(); ++i){
+                    t[cs].push_back({{ loop[0], loop[i], loop[i + 1] }});
+                }
+            }
+        }
+        return t;
+    }();
+    return table;
+}
+
+} // namespace
+
+
+template <class T, class R>
+contour_collection<R>
+Marching_Squares(const planar_image<T,R> &img,
+                 int64_t chnl,
+                 Isosurface_Opts opts){
+    contour_collection<R> out;
+    if( (img.rows < 1)
+    ||  (img.columns < 1) ){
+        return out;
+    }
+    if(!isininc(0, chnl, img.channels - 1)){
+        throw std::invalid_argument("Channel is not present in image");
+    }
+
+    const int64_t N_r = img.rows;
+    const int64_t N_c = img.columns;
+    const int64_t P_c = N_c + 2; // Columns, including padding.
+    const auto threshold = static_cast<R>(opts.threshold);
+    const bool above = (opts.interior == Isosurface_Opts::Interior::Above);
+
+    // Sample the image, returning false for padding and non-finite voxels.
+    const auto sample = [&](int64_t r, int64_t c, R &val) -> bool {
+        if( (r < 0) || (N_r <= r)
+        ||  (c < 0) || (N_c <= c) ) return false;
+        val = static_cast<R>( img.data[ (r * N_c + c) * img.channels + chnl ] );
+        return std::isfinite(val);
+    };
+    const auto inside = [&](int64_t r, int64_t c) -> bool {
+        R val;
+        if(!sample(r, c, val)) return false;
+        return above ? (threshold <= val) : (val <= threshold);
+    };
+
+    // Voxel edges are identified by their lower voxel (in padded coordinates) and axis (0 = column, 1 = row).
+    const auto cell_edge_id = [&](int64_t r, int64_t c, int e) -> uint64_t {
+        const int b0 = square_cycle[e];
+        const int b1 = square_cycle[(e + 1) % 4];
+        const int lo = (b0 & b1);
+        const int axis = ((b0 ^ b1) == 1) ? 0 : 1;
+        const int64_t vr = r + ((lo >> 1) & 1) + 1;
+        const int64_t vc = c + (lo & 1) + 1;
+        return static_cast<uint64_t>((vr * P_c + vc) * 2 + axis);
+    };
+    const auto edge_vertex = [&](uint64_t id) -> vec3<R> {
+        const int64_t axis = static_cast<int64_t>(id % 2UL);
+        const int64_t node = static_cast<int64_t>(id / 2UL);
+        const int64_t r0 = node / P_c - 1;
+        const int64_t c0 = node % P_c - 1;
+        const int64_t r1 = r0 + ((axis == 1) ? 1 : 0);
+        const int64_t c1 = c0 + ((axis == 0) ? 1 : 0);
+
+        R v0, v1;
+        R t = static_cast<R>(0.5);
+        if(sample(r0, c0, v0) && sample(r1, c1, v1)){
+            t = std::clamp<R>( (threshold - v0) / (v1 - v0), static_cast<R>(0), static_cast<R>(1) );
+        }
+        return ( img.anchor
+               + img.offset
+               + img.row_unit * (img.pxl_dx * (static_cast<R>(c0) + ((axis == 0) ? t : static_cast<R>(0))))
+               + img.col_unit * (img.pxl_dy * (static_cast<R>(r0) + ((axis == 1) ? t : static_cast<R>(0)))) );
+    };
+
+    // Generate directed segments, which are implicitly joined via the shared edges.
+    const auto &table = marching_squares_table();
+    std::unordered_map<uint64_t, uint64_t> next_edge;
+    std::vector<uint64_t> starts;
+    for(int64_t r = -1; r < N_r; ++r){
+        for(int64_t c = -1; c < N_c; ++c){
+            int cs = 0;
+            for(int q = 0; q < 4; ++q){
+                if(inside(r + ((q >> 1) & 1), c + (q & 1))) cs |= (1 << q);
+            }
+            if((cs == 0) || (cs == 15)) continue;
+
+            for(const auto &p : table[cs]){
+                const auto id = cell_edge_id(r, c, p.first);
+                next_edge[id] = cell_edge_id(r, c, p.second);
+                starts.push_back(id);
+            }
+        }
+    }
+
+    // Walk the segments to form closed contours.
+    for(const auto &start : starts){
+        if(next_edge.count(start) == 0) continue;
+
+        contour_of_points<R> cop;
+        cop.closed = true;
+        auto id = start;
+        do{
+            cop.points.push_back( edge_vertex(id) );
+            const auto it = next_edge.find(id);
+            if(it == std::end(next_edge)){
+                throw std::logic_error("Marching squares segments do not form a closed contour");
+            }
+            id = it->second;
+            next_edge.erase(it);
+        }while(id != start);
+        out.contours.push_back( std::move(cop) );
+    }
+    return out;
+}
+
+#ifndef YGOR_IMAGES_MESHES_DISABLE_ALL_SPECIALIZATIONS
+    template contour_collection<double> Marching_Squares(const planar_image<float ,double> &, int64_t, Isosurface_Opts);
+    template contour_collection<double> Marching_Squares(const planar_image<double,double> &, int64_t, Isosurface_Opts);
+#endif
+
+
+template <class T, class R>
+contour_collection<R>
+Marching_Squares(const planar_image_collection<T,R> &imgs,
+                 int64_t chnl,
+                 Isosurface_Opts opts){
+    std::vector<const planar_image<T,R>*> img_ptrs;
+    for(const auto &img : imgs.images) img_ptrs.push_back( std::addressof(img) );
+
+    std::vector<contour_collection<R>> results(img_ptrs.size());
+    parallel_over_slices(static_cast<int64_t>(img_ptrs.size()), [&](int64_t i){
+        results[i] = Marching_Squares(*(img_ptrs[i]), chnl, opts);
+    });
+
+    contour_collection<R> out;
+    for(auto &cc : results) out.contours.splice( std::end(out.contours), cc.contours );
+    return out;
+}
+
+#ifndef YGOR_IMAGES_MESHES_DISABLE_ALL_SPECIALIZATIONS
+    template contour_collection<double> Marching_Squares(const planar_image_collection<float ,double> &, int64_t, Isosurface_Opts);
+    template contour_collection<double> Marching_Squares(const planar_image_collection<double,double> &, int64_t, Isosurface_Opts);
+#endif
+
+
+template <class I, class T, class R>
+fv_surface_mesh<R,I>
+Marching_Cubes(const planar_image_collection<T,R> &imgs,
+               int64_t chnl,
+               Isosurface_Opts opts){
+    // The images are not modified; the grid view is only non-const for compatibility with the regularity check.
+    const auto grid = make_regular_image_grid(const_cast<planar_image_collection<T,R>&>(imgs), chnl);
+
+    const int64_t N_r = grid.rows;
+    const int64_t N_c = grid.columns;
+    const int64_t N_k = grid.slices;
+    const int64_t P_r = N_r + 2; // Rows, including padding.
+    const int64_t P_c = N_c + 2; // Columns, including padding.
+    const auto threshold = static_cast<R>(opts.threshold);
+    const bool above = (opts.interior == Isosurface_Opts::Interior::Above);
+
+    // Sample the grid, returning false for padding and non-finite voxels.
+    const auto sample = [&](int64_t r, int64_t c, int64_t k, R &val) -> bool {
+        if( (r < 0) || (N_r <= r)
+        ||  (c < 0) || (N_c <= c)
+        ||  (k < 0) || (N_k <= k) ) return false;
+        const auto &img = *(grid.imgs[k]);
+        val = static_cast<R>( img.data[ (r * N_c + c) * img.channels + chnl ] );
+        return std::isfinite(val);
+    };
+
+    // Classify all voxels once.
+    std::vector<std::vector<uint8_t>> masks(static_cast<size_t>(N_k));
+    parallel_over_slices(N_k, [&](int64_t k){
+        auto &mask = masks[k];
+        mask.resize(static_cast<size_t>(N_r * N_c), 0);
+        for(int64_t r = 0; r < N_r; ++r){
+            for(int64_t c = 0; c < N_c; ++c){
+                R val;
+                if(!sample(r, c, k, val)) continue;
+                mask[r * N_c + c] = (above ? (threshold <= val) : (val <= threshold)) ? 1 : 0;
+            }
+        }
+    });
+    const auto inside = [&](int64_t r, int64_t c, int64_t k) -> bool {
+        if( (r < 0) || (N_r <= r)
+        ||  (c < 0) || (N_c <= c)
+        ||  (k < 0) || (N_k <= k) ) return false;
+        return (masks[k][r * N_c + c] != 0);
+    };
+
+    // Voxel edges are identified by their lower voxel (in padded coordinates) and axis (0 = column, 1 = row, 2 = slice).
+    const auto edge_id = [&](int64_t r, int64_t c, int64_t k, int64_t axis) -> uint64_t {
+        return static_cast<uint64_t>((((k + 1) * P_r + (r + 1)) * P_c + (c + 1)) * 3 + axis);
+    };
+    const std::array<vec3<R>,3> axis_steps = {{ grid.row_unit * grid.dx,
+                                                grid.col_unit * grid.dy,
+                                                grid.slice_unit * grid.dz }};
+    const auto edge_vertex = [&](int64_t r, int64_t c, int64_t k, int64_t axis) -> vec3<R> {
+        const int64_t r1 = r + ((axis == 1) ? 1 : 0);
+        const int64_t c1 = c + ((axis == 0) ? 1 : 0);
+        const int64_t k1 = k + ((axis == 2) ? 1 : 0);
+        R v0, v1;
+        R t = static_cast<R>(0.5);
+        if(sample(r, c, k, v0) && sample(r1, c1, k1, v1)){
+            t = std::clamp<R>( (threshold - v0) / (v1 - v0), static_cast<R>(0), static_cast<R>(1) );
+        }
+        return grid.position(r, c, k) + axis_steps[axis] * t;
+    };
+
+    // Create one vertex for every crossed voxel edge.
+    //
+    // Vertices are grouped into blocks so each block can be generated independently. Block b holds the vertices on
+    // in-plane edges of slice b and on edges joining slices b-1 and b. Edges joining two padding voxels are never
+    // crossed, so are not considered.
+    std::vector<std::vector<vec3<R>>> block_verts(static_cast<size_t>(N_k + 1));
+    std::vector<std::unordered_map<uint64_t, uint64_t>> block_maps(static_cast<size_t>(N_k + 1));
+    parallel_over_slices(N_k + 1, [&](int64_t b){
+        auto &verts = block_verts[b];
+        auto &edge_map = block_maps[b];
+        const auto add = [&](int64_t r, int64_t c, int64_t k, int64_t axis){
+            const bool in0 = inside(r, c, k);
+            const bool in1 = inside(r + ((axis == 1) ? 1 : 0),
+                                    c + ((axis == 0) ? 1 : 0),
+                                    k + ((axis == 2) ? 1 : 0));
+            if(in0 == in1) return;
+            edge_map.emplace( edge_id(r, c, k, axis), static_cast<uint64_t>(verts.size()) );
+            verts.push_back( edge_vertex(r, c, k, axis) );
+        };
+
+        if(b < N_k){
+            for(int64_t r = 0; r < N_r; ++r){
+                for(int64_t c = -1; c < N_c; ++c) add(r, c, b, 0);
+            }
+            for(int64_t r = -1; r < N_r; ++r){
+                for(int64_t c = 0; c < N_c; ++c) add(r, c, b, 1);
+            }
+        }
+        for(int64_t r = 0; r < N_r; ++r){
+            for(int64_t c = 0; c < N_c; ++c) add(r, c, b - 1, 2);
+        }
+    });
+
+    std::vector<uint64_t> block_offsets(block_verts.size() + 1, 0UL);
+    for(size_t b = 0; b < block_verts.size(); ++b){
+        block_offsets[b + 1] = block_offsets[b] + static_cast<uint64_t>(block_verts[b].size());
+    }
+    if(static_cast<uint64_t>(std::numeric_limits<I>::max()) < block_offsets.back()){
+        throw std::runtime_error("Too many vertices for the mesh index type");
+    }
+
+    fv_surface_mesh<R,I> mesh;
+    mesh.vertices.resize(static_cast<size_t>(block_offsets.back()));
+    for(size_t b = 0; b < block_verts.size(); ++b){
+        std::copy( std::begin(block_verts[b]), std::end(block_verts[b]),
+                   std::next(std::begin(mesh.vertices), block_offsets[b]) );
+        block_verts[b].clear();
+        block_verts[b].shrink_to_fit();
+    }
+
+    // Emit faces for the cubes in each slab, i.e., between slices s and s+1, including the padding slabs.
+    const auto &table = marching_cubes_table();
+    const auto &edges = cube_edges();
+    std::vector<std::vector<std::vector<I>>> slab_faces(static_cast<size_t>(N_k + 1));
+    parallel_over_slices(N_k + 1, [&](int64_t j){
+        const int64_t s = j - 1;
+        auto &faces = slab_faces[j];
+        for(int64_t r = -1; r < N_r; ++r){
+            for(int64_t c = -1; c < N_c; ++c){
+                int cs = 0;
+                for(int q = 0; q < 8; ++q){
+                    if(inside(r + ((q >> 1) & 1), c + (q & 1), s + ((q >> 2) & 1))) cs |= (1 << q);
+                }
+                if((cs == 0) || (cs == 255)) continue;
+
+                const auto vertex_index = [&](int e) -> I {
+                    const auto &ce = edges[e];
+                    const int64_t vr = r + ((ce.corner >> 1) & 1);
+                    const int64_t vc = c + (ce.corner & 1);
+                    const int64_t vk = s + ((ce.corner >> 2) & 1);
+                    const int64_t b = (ce.axis == 2) ? (vk + 1) : vk;
+                    return static_cast<I>( block_offsets[b] + block_maps[b].at( edge_id(vr, vc, vk, ce.axis) ) );
+                };
+                for(const auto &tri : table[cs]){
+                    faces.push_back({ vertex_index(tri[0]), vertex_index(tri[1]), vertex_index(tri[2]) });
+                }
+            }
+        }
+    });
+
+    size_t N_faces = 0;
+    for(const auto &faces : slab_faces) N_faces += faces.size();
+    mesh.faces.reserve(N_faces);
+    for(auto &faces : slab_faces){
+        std::move( std::begin(faces), std::end(faces), std::back_inserter(mesh.faces) );
+        faces.clear();
+    }
+    return mesh;
+}
+
+#ifndef YGOR_IMAGES_MESHES_DISABLE_ALL_SPECIALIZATIONS
+    template fv_surface_mesh<double, uint32_t> Marching_Cubes<uint32_t>(const planar_image_collection<float ,double> &, int64_t, Isosurface_Opts);
+    template fv_surface_mesh<double, uint64_t> Marching_Cubes<uint64_t>(const planar_image_collection<float ,double> &, int64_t, Isosurface_Opts);
+    template fv_surface_mesh<double, uint32_t> Marching_Cubes<uint32_t>(const planar_image_collection<double,double> &, int64_t, Isosurface_Opts);
+    template fv_surface_mesh<double, uint64_t> Marching_Cubes<uint64_t>(const planar_image_collection<double,double> &, int64_t, Isosurface_Opts);
+#endif
+
+
+template <class T, class R, class I>
+void Voxelize_Mesh(planar_image_collection<T,R> &imgs,
+                   const fv_surface_mesh<R,I> &mesh,
+                   int64_t chnl,
+                   T inside_val,
+                   T outside_val,
+                   Voxelize_Mesh_Opts opts){
+    for(const auto &img : imgs.images){
+        if(!isininc(0, chnl, img.channels - 1)){
+            throw std::invalid_argument("Channel is not present in all images");
+        }
+    }
+    for(const auto &v : mesh.vertices){
+        if(!v.isfinite()) throw std::invalid_argument("Mesh contains non-finite vertices");
+    }
+    if(imgs.images.empty()) return;
+
+    const bool conservative = (opts.inclusivity == Voxelize_Mesh_Opts::Inclusivity::Conservative);
+    const bool parity = (opts.fillrule == Voxelize_Mesh_Opts::FillRule::Parity);
+    const bool write_outside = (opts.overwrite == Voxelize_Mesh_Opts::Overwrite::All);
+
+    // Fan-triangulate the faces.
+    std::vector<std::array<I,3>> tris;
+    for(const auto &f : mesh.faces){
+        if(f.size() < 3) continue;
+        for(size_t j = 1; (j + 1) < f.size(); ++j){
+            for(const auto v : { f[0], f[j], f[j + 1] }){
+                if(mesh.vertices.size() <= static_cast<size_t>(v)){
+                    throw std::invalid_argument("Face refers to a non-existent vertex");
+                }
+            }
+            tris.push_back({{ f[0], f[j], f[j + 1] }});
+        }
+    }
+
+    // Images parallel to the first image use a common normal, so triangles can be bucketed by their extent along it.
+    // Other images consider every triangle.
+    struct img_slicing {
+        planar_image<T,R> *img;
+        vec3<R> normal;
+        R offset;    // The normal's projection of the image's voxel centre plane.
+        R half;      // Half-thickness of the slab that is rasterized.
+        bool bucketed;
+        std::vector<size_t> tris;
+    };
+    std::vector<img_slicing> slicings;
+    const auto ref_normal = imgs.images.front().row_unit.Cross(imgs.images.front().col_unit).unit();
+    if(!ref_normal.isfinite()){
+        throw std::invalid_argument("Unable to determine image orientation");
+    }
+    for(auto &img : imgs.images){
+        img_slicing s;
+        s.img = std::addressof(img);
+        s.normal = img.row_unit.Cross(img.col_unit).unit();
+        if(!s.normal.isfinite()){
+            throw std::invalid_argument("Unable to determine image orientation");
+        }
+        s.bucketed = ( (static_cast<R>(1) - std::abs(s.normal.Dot(ref_normal))) < static_cast<R>(1E-10) );
+        if(s.bucketed) s.normal = ref_normal;
+        s.offset = s.normal.Dot(img.anchor + img.offset);
+        s.half = conservative ? (img.pxl_dz * static_cast<R>(0.5)) : static_cast<R>(0);
+        slicings.push_back(std::move(s));
+    }
+
+    {
+        std::vector<std::pair<R, size_t>> ordered;
+        R max_half = static_cast<R>(0);
+        for(size_t i = 0; i < slicings.size(); ++i){
+            if(!slicings[i].bucketed) continue;
+            ordered.emplace_back(slicings[i].offset, i);
+            max_half = std::max(max_half, slicings[i].half);
+        }
+        std::sort(std::begin(ordered), std::end(ordered));
+
+        for(size_t t = 0; t < tris.size(); ++t){
+            R lo = std::numeric_limits<R>::infinity();
+            R hi = -lo;
+            for(const auto v : tris[t]){
+                const auto d = ref_normal.Dot(mesh.vertices[v]);
+                lo = std::min(lo, d);
+                hi = std::max(hi, d);
+            }
+            auto it = std::lower_bound(std::begin(ordered), std::end(ordered), lo - max_half,
+                                       [](const std::pair<R,size_t> &p, R val){ return (p.first < val); });
+            for( ; (it != std::end(ordered)) && (it->first <= (hi + max_half)); ++it){
+                auto &s = slicings[it->second];
+                if( ((lo - s.half) <= s.offset)
+                &&  (s.offset <= (hi + s.half)) ){
+                    s.tris.push_back(t);
+                }
+            }
+        }
+    }
+
+    parallel_over_slices(static_cast<int64_t>(slicings.size()), [&](int64_t i){
+        auto &s = slicings[i];
+        auto &img = *(s.img);
+        const int64_t N_r = img.rows;
+        const int64_t N_c = img.columns;
+        if((N_r < 1) || (N_c < 1)) return;
+
+        const auto origin = img.anchor + img.offset;
+        const auto row_unit = img.row_unit.unit();
+        const auto col_unit = img.col_unit.unit();
+        const auto to_img = [&](const vec3<R> &p) -> std::array<R,2> {
+            const auto d = p - origin;
+            return {{ d.Dot(row_unit) / img.pxl_dx, d.Dot(col_unit) / img.pxl_dy }}; // (column, row) coordinates.
+        };
+        const auto height = [&](I v) -> R {
+            return s.normal.Dot(mesh.vertices[v]) - s.offset;
+        };
+
+        std::vector<uint8_t> mask(static_cast<size_t>(N_r * N_c), 0);
+        std::vector<std::vector<std::pair<R, int64_t>>> row_crossings(static_cast<size_t>(N_r));
+
+        const auto process = [&](const std::array<I,3> &tri){
+            const std::array<R,3> d = {{ height(tri[0]), height(tri[1]), height(tri[2]) }};
+
+            // Slice with the voxel centre plane. Vertices lying exactly in the plane are treated as being above it,
+            // and edge intersections are computed in a canonical order, so neighbouring triangles always agree.
+            std::vector<vec3<R>> cut;
+            for(int e = 0; e < 3; ++e){
+                auto u = e;
+                auto w = (e + 1) % 3;
+                if((static_cast<R>(0) <= d[u]) == (static_cast<R>(0) <= d[w])) continue;
+                if(tri[w] < tri[u]) std::swap(u, w);
+                const auto &A = mesh.vertices[tri[u]];
+                const auto &B = mesh.vertices[tri[w]];
+                cut.push_back( A + (B - A) * (d[u] / (d[u] - d[w])) );
+            }
+            if(cut.size() == 2){
+                // Orient the segment so the interior is to its left (for outward-oriented faces).
+                const auto &A = mesh.vertices[tri[0]];
+                const auto &B = mesh.vertices[tri[1]];
+                const auto &C = mesh.vertices[tri[2]];
+                const auto dir = s.normal.Cross( (B - A).Cross(C - A) );
+                if((cut[1] - cut[0]).Dot(dir) < static_cast<R>(0)) std::swap(cut[0], cut[1]);
+
+                const auto p = to_img(cut[0]);
+                const auto q = to_img(cut[1]);
+                const int64_t sign = (p[1] < q[1]) ? 1 : -1;
+                const R lo = std::min(p[1], q[1]);
+                const R hi = std::max(p[1], q[1]);
+
+                // Rows r with lo < r <= hi are crossed, which avoids double-counting shared endpoints.
+                const int64_t r_lo = std::max<int64_t>(0, static_cast<int64_t>(std::floor(lo)) + 1);
+                const int64_t r_hi = std::min<int64_t>(N_r - 1, static_cast<int64_t>(std::floor(hi)));
+                for(int64_t r = r_lo; r <= r_hi; ++r){
+                    const R x = p[0] + (static_cast<R>(r) - p[1]) * (q[0] - p[0]) / (q[1] - p[1]);
+                    row_crossings[r].emplace_back(x, sign);
+                }
+            }
+
+            // Rasterize the portion of the triangle within the slab, marking every voxel it touches.
+            if(conservative){
+                if( (s.half < *std::min_element(std::begin(d), std::end(d)))
+                ||  (*std::max_element(std::begin(d), std::end(d)) < -s.half) ) return;
+
+                std::vector<std::pair<vec3<R>, R>> poly;
+                for(int e = 0; e < 3; ++e) poly.emplace_back(mesh.vertices[tri[e]], d[e]);
+                for(const R sgn : { static_cast<R>(1), static_cast<R>(-1) }){
+                    // Keep the part where sgn * d <= half.
+                    std::vector<std::pair<vec3<R>, R>> clipped;
+                    for(size_t j = 0; j < poly.size(); ++j){
+                        const auto &P = poly[j];
+                        const auto &Q = poly[(j + 1) % poly.size()];
+                        const R fp = sgn * P.second - s.half;
+                        const R fq = sgn * Q.second - s.half;
+                        if(fp <= static_cast<R>(0)) clipped.push_back(P);
+                        if((fp < static_cast<R>(0)) != (fq < static_cast<R>(0))
+                        && (fp != static_cast<R>(0)) && (fq != static_cast<R>(0))){
+                            const R t = fp / (fp - fq);
+                            clipped.emplace_back( P.first + (Q.first - P.first) * t,
+                                                  P.second + (Q.second - P.second) * t );
+                        }
+                    }
+                    poly.swap(clipped);
+                    if(poly.empty()) return;
+                }
+
+                std::vector<std::array<R,2>> pts;
+                R y_min = std::numeric_limits<R>::infinity();
+                R y_max = -y_min;
+                for(const auto &P : poly){
+                    pts.push_back(to_img(P.first));
+                    y_min = std::min(y_min, pts.back()[1]);
+                    y_max = std::max(y_max, pts.back()[1]);
+                }
+                const int64_t r_lo = std::max<int64_t>(0, static_cast<int64_t>(std::ceil(y_min - static_cast<R>(0.5))));
+                const int64_t r_hi = std::min<int64_t>(N_r - 1, static_cast<int64_t>(std::floor(y_max + static_cast<R>(0.5))));
+                for(int64_t r = r_lo; r <= r_hi; ++r){
+                    // The polygon is convex, so its extent within the row is found from the vertices within the row
+                    // and the edge intersections with the row boundaries.
+                    const R b_lo = static_cast<R>(r) - static_cast<R>(0.5);
+                    const R b_hi = static_cast<R>(r) + static_cast<R>(0.5);
+                    R x_min = std::numeric_limits<R>::infinity();
+                    R x_max = -x_min;
+                    for(size_t j = 0; j < pts.size(); ++j){
+                        const auto &P = pts[j];
+                        const auto &Q = pts[(j + 1) % pts.size()];
+                        if((b_lo <= P[1]) && (P[1] <= b_hi)){
+                            x_min = std::min(x_min, P[0]);
+                            x_max = std::max(x_max, P[0]);
+                        }
+                        for(const R b : { b_lo, b_hi }){
+                            if( (std::min(P[1], Q[1]) < b)
+                            &&  (b < std::max(P[1], Q[1])) ){
+                                const R x = P[0] + (b - P[1]) * (Q[0] - P[0]) / (Q[1] - P[1]);
+                                x_min = std::min(x_min, x);
+                                x_max = std::max(x_max, x);
+                            }
+                        }
+                    }
+                    if(!(x_min <= x_max)) continue;
+                    const int64_t c_lo = std::max<int64_t>(0, static_cast<int64_t>(std::ceil(x_min - static_cast<R>(0.5))));
+                    const int64_t c_hi = std::min<int64_t>(N_c - 1, static_cast<int64_t>(std::floor(x_max + static_cast<R>(0.5))));
+                    for(int64_t c = c_lo; c <= c_hi; ++c) mask[r * N_c + c] = 1;
+                }
+            }
+        };
+
+        if(s.bucketed){
+            for(const auto t : s.tris) process(tris[t]);
+        }else{
+            for(const auto &tri : tris) process(tri);
+        }
+
+        // Fill each row by scanline.
+        for(int64_t r = 0; r < N_r; ++r){
+            auto &xs = row_crossings[r];
+            std::sort(std::begin(xs), std::end(xs));
+            size_t j = 0;
+            int64_t w = 0;
+            for(int64_t c = 0; c < N_c; ++c){
+                while((j < xs.size()) && (xs[j].first < static_cast<R>(c))){
+                    w += parity ? 1 : xs[j].second;
+                    ++j;
+                }
+                const bool inside = parity ? ((w % 2) != 0) : (w != 0);
+                if(inside) mask[r * N_c + c] = 1;
+            }
+        }
+
+        for(int64_t r = 0; r < N_r; ++r){
+            for(int64_t c = 0; c < N_c; ++c){
+                if(mask[r * N_c + c] != 0){
+                    img.reference(r, c, chnl) = inside_val;
+                }else if(write_outside){
+                    img.reference(r, c, chnl) = outside_val;
+                }
+            }
+        }
+    });
+    return;
+}
+
+#ifndef YGOR_IMAGES_MESHES_DISABLE_ALL_SPECIALIZATIONS
+    template void Voxelize_Mesh(planar_image_collection<uint8_t ,double> &, const fv_surface_mesh<double, uint32_t> &, int64_t, uint8_t , uint8_t , Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<uint16_t,double> &, const fv_surface_mesh<double, uint32_t> &, int64_t, uint16_t, uint16_t, Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<uint32_t,double> &, const fv_surface_mesh<double, uint32_t> &, int64_t, uint32_t, uint32_t, Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<uint64_t,double> &, const fv_surface_mesh<double, uint32_t> &, int64_t, uint64_t, uint64_t, Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<float   ,double> &, const fv_surface_mesh<double, uint32_t> &, int64_t, float   , float   , Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<double  ,double> &, const fv_surface_mesh<double, uint32_t> &, int64_t, double  , double  , Voxelize_Mesh_Opts);
+
+    template void Voxelize_Mesh(planar_image_collection<uint8_t ,double> &, const fv_surface_mesh<double, uint64_t> &, int64_t, uint8_t , uint8_t , Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<uint16_t,double> &, const fv_surface_mesh<double, uint64_t> &, int64_t, uint16_t, uint16_t, Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<uint32_t,double> &, const fv_surface_mesh<double, uint64_t> &, int64_t, uint32_t, uint32_t, Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<uint64_t,double> &, const fv_surface_mesh<double, uint64_t> &, int64_t, uint64_t, uint64_t, Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<float   ,double> &, const fv_surface_mesh<double, uint64_t> &, int64_t, float   , float   , Voxelize_Mesh_Opts);
+    template void Voxelize_Mesh(planar_image_collection<double  ,double> &, const fv_surface_mesh<double, uint64_t> &, int64_t, double  , double  , Voxelize_Mesh_Opts);
+#endif
@@ -0,0 +1,161 @@
+//YgorImagesMeshes.h - Routines that convert between image volumes and surface meshes.
+
+#pragma once
+#ifndef YGOR_IMAGES_MESHES_HDR_GRD_H
+#define YGOR_IMAGES_MESHES_HDR_GRD_H
+
+#include <cstdint>
+
+#include "YgorMath.h"
+#include "YgorImages.h"
+
+
+//A "parameter object" for the Signed_Distance_From_Mesh() function.
+struct Signed_Distance_From_Mesh_Opts {
+    double narrow_band = 2.0; // Voxels nearer to the surface than this many voxel widths (the largest of pxl_dx,
+                              // pxl_dy, and the image separation) receive exact distances.
+
+    enum class
+    Propagation {     // Controls how distances are computed outside of the narrow band.
+        FastSweeping, // Solve the eikonal equation |grad(d)| = 1 outward from the narrow band. First-order accurate.
+        Exact,        // Compute exact distances for every voxel. Considerably slower for large volumes.
+    } propagation = Propagation::FastSweeping;
+
+    int64_t max_sweep_iterations = 4; // Each iteration comprises eight directional sweeps. Iteration halts early
+                                      // when an iteration leaves every voxel unchanged.
+};
+
+// Fill a channel of a regular grid of images with the signed distance to a closed surface mesh. Distances are negative
+// inside the mesh, positive outside, and use the same units as the image geometry (i.e., not voxel units).
+//
+// Voxel centres within the narrow band are assigned exact distances using a bounding volume hierarchy. Distances are
+// then propagated outward using the fast sweeping method described in:
+//   Zhao H. A fast sweeping method for eikonal equations. Mathematics of Computation. 2005;74(250):603-627.
+// Sweeps are performed concurrently by processing rows along hyperplanes (rows on a given plane are independent), as
+// described in:
+//   Detrixhe M, Gibou F, Min C. A parallel fast sweeping method for the eikonal equation. Journal of Computational
+//   Physics. 2013;237:46-55.
+//
+// Inside/outside classification is performed for whole rows of voxels at once by casting a single ray along the row and
+// counting crossings. Rows that graze an edge or vertex are re-evaluated with a perturbed ray, and finally voxel-by-
+// voxel.
+//
+// Note: The images must form a regular grid (see Images_Form_Regular_Grid()) and all must contain the channel.
+//
+// Note: When fast sweeping is used, distances beyond the narrow band are only first-order accurate (typically within
+//       a voxel width or two). Signs are unaffected.
+//
+template <class T, class R, class I>
+void Signed_Distance_From_Mesh(planar_image_collection<T,R> &imgs,
+                               const fv_surface_mesh<R,I> &mesh,
+                               int64_t chnl,
+                               Signed_Distance_From_Mesh_Opts opts = Signed_Distance_From_Mesh_Opts());
+
+
+//A "parameter object" for the Marching_Squares() and Marching_Cubes() functions.
+struct Isosurface_Opts {
+    double threshold = 0.5; // The iso-value.
+
+    enum class
+    Interior {  // Controls which voxels are considered to be 'inside' the surface.
+        Above,  // Voxels with values >= threshold are inside.
+        Below,  // Voxels with values <= threshold are inside. (Useful for signed distance maps.)
+    } interior = Interior::Above;
+};
+
+// Extract closed iso-contours from a single image using marching squares.
+//
+// Contour vertices are linearly interpolated between voxel centres, and each voxel edge contributes at most one vertex.
+// Voxels beyond the image, and non-finite voxels, are treated as being outside. Contours are therefore always closed;
+// where the interior touches the image border, the contour follows the outer edge of the border voxels.
+//
+// Contours are oriented with the interior to the left, i.e., outer boundaries are counter-clockwise and holes are
+// clockwise when viewed along the image normal (row_unit x col_unit). Ambiguous (saddle) cells are resolved by always
+// separating the diagonally-opposite interior voxels.
+//
+template <class T, class R>
+contour_collection<R>
+Marching_Squares(const planar_image<T,R> &img,
+                 int64_t chnl,
+                 Isosurface_Opts opts = Isosurface_Opts());
+
+// Extract iso-contours from every image in a collection. Images are processed concurrently. Contours are returned in
+// the same order as the images.
+template <class T, class R>
+contour_collection<R>
+Marching_Squares(const planar_image_collection<T,R> &imgs,
+                 int64_t chnl,
+                 Isosurface_Opts opts = Isosurface_Opts());
+
+// Extract a watertight iso-surface from a regular grid of images using marching cubes, as described in:
+//   Lorensen WE, Cline HE. Marching cubes: a high resolution 3D surface construction algorithm. ACM SIGGRAPH Computer
+//   Graphics. 1987;21(4):163-169.
+//
+// Rather than the classic case table, which can leave holes where neighbouring cubes disagree about ambiguous faces,
+// the per-case triangulation is derived from the face rule used by Marching_Squares(). Neighbouring cubes therefore
+// always agree, and the surface intersects each image exactly along the corresponding marching squares contours.
+//
+// As with Marching_Squares(), voxels beyond the grid and non-finite voxels are treated as being outside, so the surface
+// is always closed. Every edge is shared by exactly two faces, faces are consistently oriented with normals pointing
+// from the interior to the exterior, and each voxel edge contributes at most one vertex. (No post-hoc duplicate vertex
+// merging is needed.) Vertices can coincide, producing degenerate faces, where voxel values exactly equal the
+// threshold.
+//
+// Slabs between adjacent images are processed concurrently. The index type of the mesh must be provided explicitly,
+// e.g., 'Marching_Cubes<uint64_t>(imgs, 0)'.
+//
+// Note: The images must form a regular grid (see Images_Form_Regular_Grid()) and all must contain the channel.
+//
+// Note: The involved_faces index is not populated.
+//
+template <class I, class T, class R>
+fv_surface_mesh<R,I>
+Marching_Cubes(const planar_image_collection<T,R> &imgs,
+               int64_t chnl,
+               Isosurface_Opts opts = Isosurface_Opts());
+
+
+//A "parameter object" for the Voxelize_Mesh() function.
+struct Voxelize_Mesh_Opts {
+    enum class
+    Inclusivity {     // Controls which voxels are considered to be within the mesh.
+        Centre,       // Voxels whose centre is within the mesh.
+        Conservative, // Voxels that overlap the mesh interior at all, i.e., also voxels intersected by the surface.
+    } inclusivity = Inclusivity::Centre;
+
+    enum class
+    FillRule {   // Controls how nested or overlapping parts of the mesh are handled.
+        Parity,  // Even-odd rule. Nested parts toggle (e.g., enclosed cavities are excluded). Face orientation is ignored.
+        Winding, // Non-zero winding rule. Overlapping parts are merged. Faces must be consistently oriented.
+    } fillrule = FillRule::Parity;
+
+    enum class
+    Overwrite {     // Controls which voxels are written.
+        All,        // Write the inside value to voxels within the mesh and the outside value to all others.
+        InsideOnly, // Write the inside value to voxels within the mesh, leaving all others unaltered.
+    } overwrite = Overwrite::All;
+};
+
+// Voxelize a closed surface mesh directly into a channel of every image in a collection.
+//
+// Each image is treated as a slab of voxels with thickness pxl_dz centred on the image plane. Triangles are sliced by
+// the plane containing the voxel centres, and each row of voxels is then filled by scanline using the selected rule.
+// For conservative voxelization, triangles are also clipped to the slab and rasterized so every voxel they touch is
+// included.
+//
+// Slicing is consistent for vertices and edges lying exactly in the image plane, so cross-sections of closed meshes are
+// always closed. Images are processed concurrently, need not form a regular grid, and need not be parallel (though
+// parallel images are processed more efficiently).
+//
+// This routine is equivalent to, but considerably faster than, slicing the mesh into contours and then using
+// Mutate_Voxels().
+//
+template <class T, class R, class I>
+void Voxelize_Mesh(planar_image_collection<T,R> &imgs,
+                   const fv_surface_mesh<R,I> &mesh,
+                   int64_t chnl,
+                   T inside_val,
+                   T outside_val,
+                   Voxelize_Mesh_Opts opts = Voxelize_Mesh_Opts());
+
+#endif // YGOR_IMAGES_MESHES_HDR_GRD_H
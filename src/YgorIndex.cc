@@ -3,6 +3,7 @@
 #include <algorithm>   //Needed for std::reverse.
 #include <any>
 #include <cmath>       //Needed for fabs, signbit, sqrt, etc...
+#include <cstdint>
 #include <limits>      //Needed for std::numeric_limits::max().
 #include <memory>
 #include <utility>     //Needed for std::pair.
@@ -101,23 +102,23 @@ vec3<T> canonical_max(const vec3<T> &a, const vec3<T> &b){
 
 //------------------------------------------------------ index_entry --------------------------------------------------------
 
-template <class T>
-index_entry<T>::index_entry() : box(), aux_data() { }
+template <class T, class Payload>
+index_entry<T, Payload>::index_entry() : box(), aux_data() { }
 
-template <class T>
-index_entry<T>::index_entry(const index_bbox<T> &b) : box(b), aux_data() { }
+template <class T, class Payload>
+index_entry<T, Payload>::index_entry(const index_bbox<T> &b) : box(b), aux_data() { }
 
-template <class T>
-index_entry<T>::index_entry(const index_bbox<T> &b, std::any data) : box(b), aux_data(std::move(data)) { }
+template <class T, class Payload>
+index_entry<T, Payload>::index_entry(const index_bbox<T> &b, Payload data) : box(b), aux_data(std::move(data)) { }
 
-template <class T>
-index_entry<T>::index_entry(const vec3<T> &p) : box(p, p), aux_data() { }
+template <class T, class Payload>
+index_entry<T, Payload>::index_entry(const vec3<T> &p) : box(p, p), aux_data() { }
 
-template <class T>
-index_entry<T>::index_entry(const vec3<T> &p, std::any data) : box(p, p), aux_data(std::move(data)) { }
+template <class T, class Payload>
+index_entry<T, Payload>::index_entry(const vec3<T> &p, Payload data) : box(p, p), aux_data(std::move(data)) { }
 
-template <class T>
-bool index_entry<T>::operator==(const index_entry &other) const {
+template <class T, class Payload>
+bool index_entry<T, Payload>::operator==(const index_entry &other) const {
     return box == other.box;
 }
 
@@ -289,42 +290,44 @@ bool index_bbox<T>::operator==(const index_bbox &other) const {
 
 //------------------------------------------------------ index_node_base ----------------------------------------------------
 
-template <class T>
-index_node_base<T>::index_node_base() : parent(nullptr) { }
+template <class T, class Payload>
+index_node_base<T, Payload>::index_node_base() : parent(nullptr) { }
 
 //------------------------------------------------------ index_internal_node ------------------------------------------------
 
-template <class T>
-index_internal_node<T>::index_internal_node() : index_node_base<T>() { }
+template <class T, class Payload>
+index_internal_node<T, Payload>::index_internal_node() : index_node_base<T, Payload>() { }
 
-template <class T>
-bool index_internal_node<T>::is_leaf() const {
+template <class T, class Payload>
+bool index_internal_node<T, Payload>::is_leaf() const {
     return false;
 }
 
 //------------------------------------------------------ index_leaf_node ----------------------------------------------------
 
-template <class T>
-index_leaf_node<T>::index_leaf_node() : index_node_base<T>() { }
+template <class T, class Payload>
+index_leaf_node<T, Payload>::index_leaf_node() : index_node_base<T, Payload>() { }
 
-template <class T>
-bool index_leaf_node<T>::is_leaf() const {
+template <class T, class Payload>
+bool index_leaf_node<T, Payload>::is_leaf() const {
     return true;
 }
 
 #ifndef YGOR_INDEX_DISABLE_ALL_SPECIALIZATIONS
-    template struct index_entry<float>;
-    template struct index_entry<double>;
-
     template struct index_bbox<float>;
     template struct index_bbox<double>;
 
-    template struct index_node_base<float>;
-    template struct index_node_base<double>;
-
-    template struct index_internal_node<float>;
-    template struct index_internal_node<double>;
-
-    template struct index_leaf_node<float>;
-    template struct index_leaf_node<double>;
+    #define YGOR_INDEX_INSTANTIATE_PAYLOAD(T, P) \
+        template struct index_entry<T, P>; \
+        template struct index_node_base<T, P>; \
+        template struct index_internal_node<T, P>; \
+        template struct index_leaf_node<T, P>;
+
+    YGOR_INDEX_INSTANTIATE_PAYLOAD(float,  std::any)
+    YGOR_INDEX_INSTANTIATE_PAYLOAD(double, std::any)
+    YGOR_INDEX_INSTANTIATE_PAYLOAD(float,  uint32_t)
+    YGOR_INDEX_INSTANTIATE_PAYLOAD(double, uint32_t)
+    YGOR_INDEX_INSTANTIATE_PAYLOAD(float,  uint64_t)
+    YGOR_INDEX_INSTANTIATE_PAYLOAD(double, uint64_t)
+    #undef YGOR_INDEX_INSTANTIATE_PAYLOAD
 #endif
@@ -7,6 +7,7 @@
 #include <stddef.h>
 #include <any>
 #include <cmath>
+#include <cstdint>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -20,9 +21,10 @@
 //---------------------------------------------------------------------------------------------------------------------------
 
 // Forward declarations.
-template <class T> struct index_node_base;
-template <class T> struct index_internal_node;
-template <class T> struct index_leaf_node;
+template <class T, class Payload = std::any> struct index_entry;
+template <class T, class Payload = std::any> struct index_node_base;
+template <class T, class Payload = std::any> struct index_internal_node;
+template <class T, class Payload = std::any> struct index_leaf_node;
 
 // A bounding box in 3D space defined by min and max corners.
 template <class T> struct index_bbox {
@@ -84,23 +86,29 @@ template <class T> struct index_bbox {
 };
 
 // An entry in a spatial index consisting of a spatial bounding box and optional auxiliary data.
-template <class T> struct index_entry {
+//
+// The auxiliary data is type-erased by default. A plain type (e.g., an integer identifier) can be used instead to avoid
+// type-erased copies and any_cast when results are retrieved. Explicit instantiations are provided for std::any,
+// uint32_t, and uint64_t payloads.
+template <class T, class Payload> struct index_entry {
+    using payload_type = Payload;
+
     index_bbox<T> box;
-    std::any aux_data;
+    Payload aux_data;
 
     index_entry();
     index_entry(const index_bbox<T> &b);
-    index_entry(const index_bbox<T> &b, std::any data);
+    index_entry(const index_bbox<T> &b, Payload data);
     index_entry(const vec3<T> &p);
-    index_entry(const vec3<T> &p, std::any data);
+    index_entry(const vec3<T> &p, Payload data);
 
     bool operator==(const index_entry &other) const;
 };
 
 // Base class for all nodes in a spatial index.
-template <class T> struct index_node_base {
+template <class T, class Payload> struct index_node_base {
     index_bbox<T> bounds;
-    index_internal_node<T>* parent;  // Raw pointer for parent (ownership is top-down)
+    index_internal_node<T, Payload>* parent;  // Raw pointer for parent (ownership is top-down)
 
     index_node_base();
     virtual ~index_node_base() = default;
@@ -108,16 +116,16 @@ template <class T> struct index_node_base {
 };
 
 // Internal node containing references to child nodes.
-template <class T> struct index_internal_node : public index_node_base<T> {
-    std::vector<std::unique_ptr<index_node_base<T>>> children;
+template <class T, class Payload> struct index_internal_node : public index_node_base<T, Payload> {
+    std::vector<std::unique_ptr<index_node_base<T, Payload>>> children;
 
     index_internal_node();
     bool is_leaf() const override;
 };
 
 // Leaf node containing actual data entries.
-template <class T> struct index_leaf_node : public index_node_base<T> {
-    std::vector<index_entry<T>> entries;
+template <class T, class Payload> struct index_leaf_node : public index_node_base<T, Payload> {
+    std::vector<index_entry<T, Payload>> entries;
 
     index_leaf_node();
     bool is_leaf() const override;
@@ -0,0 +1,696 @@
+//YgorIndexBVH.cc.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorMath.h"
+#include "YgorIndex.h"
+#include "YgorIndexBVH.h"
+
+//#ifndef YGOR_INDEX_BVH_DISABLE_ALL_SPECIALIZATIONS
+//    #define YGOR_INDEX_BVH_DISABLE_ALL_SPECIALIZATIONS
+//#endif
+
+namespace {
+
+// A lightweight axis-aligned box used during construction. Unlike index_bbox, it starts out empty and uses plain
+// floating-point comparisons, which is sufficient for conservative bounds and considerably cheaper.
+template <class T>
+struct bvh_aabb {
+    vec3<T> min = vec3<T>( std::numeric_limits<T>::infinity(),
+                           std::numeric_limits<T>::infinity(),
+                           std::numeric_limits<T>::infinity() );
+    vec3<T> max = vec3<T>(-std::numeric_limits<T>::infinity(),
+                          -std::numeric_limits<T>::infinity(),
+                          -std::numeric_limits<T>::infinity() );
+
+    void expand(const vec3<T> &p){
+        min.x = std::min(min.x, p.x);
+        min.y = std::min(min.y, p.y);
+        min.z = std::min(min.z, p.z);
+        max.x = std::max(max.x, p.x);
+        max.y = std::max(max.y, p.y);
+        max.z = std::max(max.z, p.z);
+    }
+
+    void expand(const bvh_aabb &b){
+        min.x = std::min(min.x, b.min.x);
+        min.y = std::min(min.y, b.min.y);
+        min.z = std::min(min.z, b.min.z);
+        max.x = std::max(max.x, b.max.x);
+        max.y = std::max(max.y, b.max.y);
+        max.z = std::max(max.z, b.max.z);
+    }
+
+    T surface_area() const {
+        if(max.x < min.x) return static_cast<T>(0);
+        const auto dx = max.x - min.x;
+        const auto dy = max.y - min.y;
+        const auto dz = max.z - min.z;
+        return static_cast<T>(2) * (dx * dy + dy * dz + dz * dx);
+    }
+
+    index_bbox<T> to_bbox() const {
+        index_bbox<T> out;
+        out.min = min;
+        out.max = max;
+        return out;
+    }
+};
+
+template <class T>
+T get_coord(const vec3<T> &p, int axis){
+    if(axis == 0) return p.x;
+    if(axis == 1) return p.y;
+    return p.z;
+}
+
+template <class T>
+T box_sq_dist(const index_bbox<T> &b, const vec3<T> &p){
+    const T dx = std::max( std::max(b.min.x - p.x, static_cast<T>(0)), p.x - b.max.x );
+    const T dy = std::max( std::max(b.min.y - p.y, static_cast<T>(0)), p.y - b.max.y );
+    const T dz = std::max( std::max(b.min.z - p.z, static_cast<T>(0)), p.z - b.max.z );
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// Slab test. Returns the entry parameter if the ray overlaps the box within [0, t_max].
+//
+// Note: NaNs (from 0 * inf) are ignored by std::min/std::max here, which is conservative.
+template <class T>
+bool ray_box(const vec3<T> &origin, const vec3<T> &inv_dir, const index_bbox<T> &b, T t_max, T &t_entry){
+    T t0 = static_cast<T>(0);
+    T t1 = t_max;
+    for(int axis = 0; axis < 3; ++axis){
+        const T o = get_coord(origin, axis);
+        const T inv = get_coord(inv_dir, axis);
+        T t_near = (get_coord(b.min, axis) - o) * inv;
+        T t_far  = (get_coord(b.max, axis) - o) * inv;
+        if(t_far < t_near) std::swap(t_near, t_far);
+        t0 = std::max(t0, t_near);
+        t1 = std::min(t1, t_far);
+        if(t1 < t0) return false;
+    }
+    t_entry = t0;
+    return true;
+}
+
+// Moller-Trumbore ray-triangle intersection. The parameter t is only meaningful when true is returned.
+template <class T>
+bool ray_triangle(const vec3<T> &origin, const vec3<T> &dir, const std::array<vec3<T>,3> &tri, T &t){
+    const auto e1 = tri[1] - tri[0];
+    const auto e2 = tri[2] - tri[0];
+    const auto pv = dir.Cross(e2);
+    const T det = e1.Dot(pv);
+    if( (det == static_cast<T>(0)) || !std::isfinite(det) ) return false;
+    const T inv_det = static_cast<T>(1) / det;
+
+    const auto tv = origin - tri[0];
+    const T u = tv.Dot(pv) * inv_det;
+    if( (u < static_cast<T>(0)) || (static_cast<T>(1) < u) ) return false;
+
+    const auto qv = tv.Cross(e1);
+    const T v = dir.Dot(qv) * inv_det;
+    if( (v < static_cast<T>(0)) || (static_cast<T>(1) < (u + v)) ) return false;
+
+    t = e2.Dot(qv) * inv_det;
+    return std::isfinite(t);
+}
+
+template <class T>
+vec3<T> closest_point_on_segment(const vec3<T> &p, const vec3<T> &a, const vec3<T> &b){
+    const auto ab = b - a;
+    const T denom = ab.Dot(ab);
+    if(!(static_cast<T>(0) < denom)) return a;
+    const T t = std::clamp( (p - a).Dot(ab) / denom, static_cast<T>(0), static_cast<T>(1) );
+    return a + ab * t;
+}
+
+// Closest point on a triangle via Voronoi region classification. See section 5.1.5 of:
+//   Ericson C. Real-Time Collision Detection. CRC Press; 2004.
+template <class T>
+vec3<T> closest_point_on_triangle(const vec3<T> &p, const std::array<vec3<T>,3> &tri){
+    const auto &a = tri[0];
+    const auto &b = tri[1];
+    const auto &c = tri[2];
+    const auto ab = b - a;
+    const auto ac = c - a;
+    const auto ap = p - a;
+    const T zero = static_cast<T>(0);
+
+    const T d1 = ab.Dot(ap);
+    const T d2 = ac.Dot(ap);
+    if( (d1 <= zero) && (d2 <= zero) ) return a;
+
+    const auto bp = p - b;
+    const T d3 = ab.Dot(bp);
+    const T d4 = ac.Dot(bp);
+    if( (zero <= d3) && (d4 <= d3) ) return b;
+
+    vec3<T> out;
+    const T vc = d1 * d4 - d3 * d2;
+    const auto cp = p - c;
+    const T d5 = ab.Dot(cp);
+    const T d6 = ac.Dot(cp);
+    const T vb = d5 * d2 - d1 * d6;
+    const T va = d3 * d6 - d5 * d4;
+    if( (vc <= zero) && (zero <= d1) && (d3 <= zero) ){
+        out = a + ab * (d1 / (d1 - d3));
+    }else if( (zero <= d6) && (d5 <= d6) ){
+        return c;
+    }else if( (vb <= zero) && (zero <= d2) && (d6 <= zero) ){
+        out = a + ac * (d2 / (d2 - d6));
+    }else if( (va <= zero) && (zero <= (d4 - d3)) && (zero <= (d5 - d6)) ){
+        out = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }else{
+        const T denom = static_cast<T>(1) / (va + vb + vc);
+        out = a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    // Degenerate (zero-area) triangles can produce non-finite results, so fall back to the edges.
+    if(!out.isfinite()){
+        const auto p_ab = closest_point_on_segment(p, a, b);
+        const auto p_bc = closest_point_on_segment(p, b, c);
+        const auto p_ca = closest_point_on_segment(p, c, a);
+        out = p_ab;
+        if( (p_bc - p).sq_length() < (out - p).sq_length() ) out = p_bc;
+        if( (p_ca - p).sq_length() < (out - p).sq_length() ) out = p_ca;
+    }
+    return out;
+}
+
+// Invoke f(begin, end) over contiguous chunks of [0, N) concurrently.
+inline void parallel_over_chunks(size_t N, const std::function<void(size_t, size_t)> &f){
+    const size_t n_threads = std::max<size_t>(1UL, std::thread::hardware_concurrency());
+    const size_t min_chunk = 256;
+    const size_t n_chunks = std::max<size_t>(1UL, std::min(n_threads, (N + min_chunk - 1) / min_chunk));
+    if(n_chunks <= 1UL){
+        f(0UL, N);
+        return;
+    }
+    const size_t chunk = (N + n_chunks - 1) / n_chunks;
+    std::vector<std::future<void>> futures;
+    for(size_t begin = 0; begin < N; begin += chunk){
+        const size_t end = std::min(N, begin + chunk);
+        futures.emplace_back( std::async(std::launch::async, f, begin, end) );
+    }
+    for(auto &fut : futures) fut.get();
+    return;
+}
+
+template <class T>
+struct bvh_build_context {
+    const std::vector<bvh_aabb<T>> &boxes;
+    const std::vector<vec3<T>> &centroids;
+    std::vector<uint32_t> &order;
+    size_t max_leaf_size;
+    size_t n_bins;
+    size_t parallel_depth;
+};
+
+// Build the subtree for order[begin, end) by appending nodes to 'out' in depth-first order.
+template <class T, class N>
+void bvh_build_into(bvh_build_context<T> &ctx, size_t begin, size_t end, size_t depth, std::vector<N> &out){
+    const size_t n = end - begin;
+    const size_t node_idx = out.size();
+    out.push_back(N{ index_bbox<T>(), 0U, 0U });
+
+    bvh_aabb<T> bounds;
+    bvh_aabb<T> c_bounds;
+    for(size_t i = begin; i < end; ++i){
+        bounds.expand(ctx.boxes[ctx.order[i]]);
+        c_bounds.expand(ctx.centroids[ctx.order[i]]);
+    }
+
+    const auto make_leaf = [&](){
+        out[node_idx] = N{ bounds.to_bbox(), static_cast<uint32_t>(begin), static_cast<uint32_t>(n) };
+    };
+    if(n <= ctx.max_leaf_size){
+        make_leaf();
+        return;
+    }
+
+    // Evaluate the binned SAH along every axis.
+    const auto bin_of = [&ctx, &c_bounds](uint32_t prim, int axis, T scale) -> size_t {
+        const T c = get_coord(ctx.centroids[prim], axis) - get_coord(c_bounds.min, axis);
+        const auto b = static_cast<int64_t>(c * scale);
+        return static_cast<size_t>( std::clamp<int64_t>(b, 0, static_cast<int64_t>(ctx.n_bins) - 1) );
+    };
+
+    T best_cost = std::numeric_limits<T>::infinity();
+    int best_axis = -1;
+    size_t best_bin = 0;
+    T best_scale = static_cast<T>(0);
+    std::vector<bvh_aabb<T>> bin_boxes(ctx.n_bins);
+    std::vector<size_t> bin_counts(ctx.n_bins);
+    std::vector<T> right_areas(ctx.n_bins);
+    std::vector<size_t> right_counts(ctx.n_bins);
+    for(int axis = 0; axis < 3; ++axis){
+        const T extent = get_coord(c_bounds.max, axis) - get_coord(c_bounds.min, axis);
+        if(!(static_cast<T>(0) < extent)) continue;
+        const T scale = static_cast<T>(ctx.n_bins) / extent;
+
+        std::fill(std::begin(bin_boxes), std::end(bin_boxes), bvh_aabb<T>());
+        std::fill(std::begin(bin_counts), std::end(bin_counts), 0UL);
+        for(size_t i = begin; i < end; ++i){
+            const auto prim = ctx.order[i];
+            const auto b = bin_of(prim, axis, scale);
+            bin_boxes[b].expand(ctx.boxes[prim]);
+            ++bin_counts[b];
+        }
+
+        bvh_aabb<T> acc;
+        size_t count = 0;
+        for(size_t b = ctx.n_bins - 1; 0 < b; --b){
+            acc.expand(bin_boxes[b]);
+            count += bin_counts[b];
+            right_areas[b] = acc.surface_area();
+            right_counts[b] = count;
+        }
+
+        acc = bvh_aabb<T>();
+        count = 0;
+        for(size_t b = 0; (b + 1) < ctx.n_bins; ++b){
+            acc.expand(bin_boxes[b]);
+            count += bin_counts[b];
+            if( (count == 0) || (right_counts[b + 1] == 0) ) continue;
+            const T cost = acc.surface_area() * static_cast<T>(count)
+                         + right_areas[b + 1] * static_cast<T>(right_counts[b + 1]);
+            if(cost < best_cost){
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+                best_scale = scale;
+            }
+        }
+    }
+
+    size_t mid = begin + n / 2;
+    if(best_axis < 0){
+        // All centroids coincide. Split arbitrarily so leaves remain small.
+    }else{
+        // Compare against the cost of making a leaf, assuming traversal and intersection costs are equal.
+        const T parent_area = bounds.surface_area();
+        const T split_cost = (static_cast<T>(0) < parent_area) ? static_cast<T>(1) + best_cost / parent_area
+                                                              : static_cast<T>(n);
+        if( (static_cast<T>(n) <= split_cost) && (n <= (4UL * ctx.max_leaf_size)) ){
+            make_leaf();
+            return;
+        }
+
+        const auto it = std::partition( std::next(std::begin(ctx.order), begin),
+                                        std::next(std::begin(ctx.order), end),
+                                        [&](uint32_t prim){ return bin_of(prim, best_axis, best_scale) <= best_bin; } );
+        mid = static_cast<size_t>( std::distance(std::begin(ctx.order), it) );
+        if( (mid == begin) || (mid == end) ) mid = begin + n / 2;
+    }
+
+    // Build the children. Upper levels are built concurrently; only these levels require copying nodes.
+    if( (depth < ctx.parallel_depth) && (4096UL <= n) ){
+        auto left_fut = std::async(std::launch::async, [&ctx, begin, mid, depth](){
+            std::vector<N> l_out;
+            bvh_build_into<T,N>(ctx, begin, mid, depth + 1, l_out);
+            return l_out;
+        });
+        std::vector<N> right;
+        bvh_build_into<T,N>(ctx, mid, end, depth + 1, right);
+        auto left = left_fut.get();
+
+        out[node_idx] = N{ bounds.to_bbox(), static_cast<uint32_t>(1UL + left.size()), 0U };
+        out.insert(std::end(out), std::begin(left), std::end(left));
+        out.insert(std::end(out), std::begin(right), std::end(right));
+    }else{
+        bvh_build_into<T,N>(ctx, begin, mid, depth + 1, out);
+        const auto right_offset = static_cast<uint32_t>(out.size() - node_idx);
+        bvh_build_into<T,N>(ctx, mid, end, depth + 1, out);
+        out[node_idx] = N{ bounds.to_bbox(), right_offset, 0U };
+    }
+    return;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------------------------------------------
+//------------------------ mesh_bvh: bounding volume hierarchy over fv_surface_mesh triangles -------------------------------
+//---------------------------------------------------------------------------------------------------------------------------
+
+//------------------------------------------------------ bvh_node -----------------------------------------------------------
+
+template <class T, class I>
+bool mesh_bvh<T,I>::bvh_node::is_leaf() const {
+    return (this->count != 0U);
+}
+
+//------------------------------------------------------ Constructors -------------------------------------------------------
+
+template <class T, class I>
+mesh_bvh<T,I>::mesh_bvh(size_t max_leaf_size, size_t sah_bins)
+    : max_leaf_size(std::max<size_t>(1UL, max_leaf_size)),
+      sah_bins(std::max<size_t>(2UL, sah_bins)) { }
+
+template <class T, class I>
+mesh_bvh<T,I>::mesh_bvh(const fv_surface_mesh<T,I> &mesh, size_t max_leaf_size, size_t sah_bins)
+    : mesh_bvh(max_leaf_size, sah_bins) {
+    this->build(mesh);
+}
+
+//------------------------------------------------------ Member functions ---------------------------------------------------
+
+template <class T, class I>
+void mesh_bvh<T,I>::build(const fv_surface_mesh<T,I> &mesh){
+    this->clear();
+
+    // Fan-triangulate all faces.
+    std::vector<std::array<vec3<T>,3>> tris;
+    std::vector<size_t> tri_faces;
+    tris.reserve(mesh.faces.size());
+    tri_faces.reserve(mesh.faces.size());
+    for(size_t f = 0; f < mesh.faces.size(); ++f){
+        const auto &face = mesh.faces[f];
+        for(size_t k = 1; (k + 1) < face.size(); ++k){
+            tris.push_back({{ mesh.vertices.at(face[0]),
+                              mesh.vertices.at(face[k]),
+                              mesh.vertices.at(face[k + 1]) }});
+            tri_faces.push_back(f);
+        }
+    }
+    if(tris.empty()) return;
+    if(static_cast<size_t>(std::numeric_limits<uint32_t>::max()) <= tris.size()){
+        throw std::invalid_argument("Too many triangles for mesh_bvh");
+    }
+    for(const auto &tri : tris){
+        if(!tri[0].isfinite() || !tri[1].isfinite() || !tri[2].isfinite()){
+            throw std::invalid_argument("Cannot index non-finite vertex in mesh_bvh");
+        }
+    }
+
+    const size_t N = tris.size();
+    std::vector<bvh_aabb<T>> boxes(N);
+    std::vector<vec3<T>> centroids(N);
+    for(size_t i = 0; i < N; ++i){
+        boxes[i].expand(tris[i][0]);
+        boxes[i].expand(tris[i][1]);
+        boxes[i].expand(tris[i][2]);
+        centroids[i] = (tris[i][0] + tris[i][1] + tris[i][2]) / static_cast<T>(3);
+    }
+    std::vector<uint32_t> order(N);
+    std::iota(std::begin(order), std::end(order), 0U);
+
+    // Build subtrees concurrently down to roughly one subtree per thread.
+    size_t parallel_depth = 0;
+    for(auto n = std::thread::hardware_concurrency(); 1U < n; n /= 2U) ++parallel_depth;
+
+    bvh_build_context<T> ctx{ boxes, centroids, order, this->max_leaf_size, this->sah_bins, parallel_depth + 1 };
+    this->nodes.reserve(2UL * N / this->max_leaf_size + 1UL);
+    bvh_build_into<T,bvh_node>(ctx, 0UL, N, 0UL, this->nodes);
+
+    // Reorder the triangles so leaves refer to contiguous ranges.
+    this->triangles.reserve(N);
+    this->triangle_faces.reserve(N);
+    for(const auto &i : order){
+        this->triangles.push_back(tris[i]);
+        this->triangle_faces.push_back(tri_faces[i]);
+    }
+    return;
+}
+
+template <class T, class I>
+void mesh_bvh<T,I>::clear(){
+    this->nodes.clear();
+    this->triangles.clear();
+    this->triangle_faces.clear();
+    return;
+}
+
+template <class T, class I>
+size_t mesh_bvh<T,I>::get_size() const {
+    return this->triangles.size();
+}
+
+template <class T, class I>
+const std::vector<typename mesh_bvh<T,I>::bvh_node> & mesh_bvh<T,I>::get_nodes() const {
+    return this->nodes;
+}
+
+template <class T, class I>
+typename mesh_bvh<T,I>::bbox mesh_bvh<T,I>::get_bounds() const {
+    if(this->nodes.empty()) return bbox();
+    return this->nodes.front().bounds;
+}
+
+template <class T, class I>
+std::optional<typename mesh_bvh<T,I>::closest_point_result>
+mesh_bvh<T,I>::closest_point(const vec3<T> &point, T max_distance) const {
+    std::optional<closest_point_result> out;
+    if(this->nodes.empty() || !point.isfinite()) return out;
+
+    T best_sq = (std::isfinite(max_distance)) ? max_distance * max_distance
+                                              : std::numeric_limits<T>::infinity();
+
+    std::vector<std::pair<uint32_t, T>> stack;
+    stack.reserve(64);
+    stack.emplace_back(0U, box_sq_dist(this->nodes.front().bounds, point));
+    while(!stack.empty()){
+        const auto [i, d_sq] = stack.back();
+        stack.pop_back();
+        if(best_sq <= d_sq) continue;
+
+        const auto &node = this->nodes[i];
+        if(node.is_leaf()){
+            for(size_t k = node.offset; k < (node.offset + node.count); ++k){
+                const auto q = closest_point_on_triangle(point, this->triangles[k]);
+                const T sq = (q - point).sq_length();
+                if(sq < best_sq){
+                    best_sq = sq;
+                    out = closest_point_result{ q, std::sqrt(sq), this->triangle_faces[k] };
+                }
+            }
+        }else{
+            const uint32_t l = i + 1U;
+            const uint32_t r = i + node.offset;
+            const T d_l = box_sq_dist(this->nodes[l].bounds, point);
+            const T d_r = box_sq_dist(this->nodes[r].bounds, point);
+
+            // Push the farther child first so the nearer child is visited first.
+            if(d_l <= d_r){
+                if(d_r < best_sq) stack.emplace_back(r, d_r);
+                if(d_l < best_sq) stack.emplace_back(l, d_l);
+            }else{
+                if(d_l < best_sq) stack.emplace_back(l, d_l);
+                if(d_r < best_sq) stack.emplace_back(r, d_r);
+            }
+        }
+    }
+    return out;
+}
+
+template <class T, class I>
+std::optional<typename mesh_bvh<T,I>::ray_hit>
+mesh_bvh<T,I>::ray_cast(const vec3<T> &origin, const vec3<T> &dir, T t_max) const {
+    std::optional<ray_hit> out;
+    if( this->nodes.empty()
+    ||  !origin.isfinite()
+    ||  !dir.isfinite()
+    ||  !(static_cast<T>(0) < dir.sq_length()) ) return out;
+
+    const vec3<T> inv_dir( static_cast<T>(1) / dir.x,
+                           static_cast<T>(1) / dir.y,
+                           static_cast<T>(1) / dir.z );
+    T best_t = t_max;
+
+    std::vector<std::pair<uint32_t, T>> stack;
+    stack.reserve(64);
+    T t_entry = static_cast<T>(0);
+    if(!ray_box(origin, inv_dir, this->nodes.front().bounds, best_t, t_entry)) return out;
+    stack.emplace_back(0U, t_entry);
+    while(!stack.empty()){
+        const auto [i, t_node] = stack.back();
+        stack.pop_back();
+        if(best_t < t_node) continue;
+
+        const auto &node = this->nodes[i];
+        if(node.is_leaf()){
+            for(size_t k = node.offset; k < (node.offset + node.count); ++k){
+                T t = static_cast<T>(0);
+                if( ray_triangle(origin, dir, this->triangles[k], t)
+                &&  (static_cast<T>(0) < t)
+                &&  ( (t < best_t) || (!out && (t <= best_t)) ) ){
+                    best_t = t;
+                    out = ray_hit{ origin + dir * t, t, this->triangle_faces[k] };
+                }
+            }
+        }else{
+            const uint32_t l = i + 1U;
+            const uint32_t r = i + node.offset;
+            T t_l = static_cast<T>(0);
+            T t_r = static_cast<T>(0);
+            const bool hit_l = ray_box(origin, inv_dir, this->nodes[l].bounds, best_t, t_l);
+            const bool hit_r = ray_box(origin, inv_dir, this->nodes[r].bounds, best_t, t_r);
+            if(hit_l && hit_r){
+                if(t_l <= t_r){
+                    stack.emplace_back(r, t_r);
+                    stack.emplace_back(l, t_l);
+                }else{
+                    stack.emplace_back(l, t_l);
+                    stack.emplace_back(r, t_r);
+                }
+            }else if(hit_l){
+                stack.emplace_back(l, t_l);
+            }else if(hit_r){
+                stack.emplace_back(r, t_r);
+            }
+        }
+    }
+    return out;
+}
+
+template <class T, class I>
+size_t mesh_bvh<T,I>::count_ray_intersections(const vec3<T> &origin, const vec3<T> &dir) const {
+    size_t count = 0;
+    if( this->nodes.empty()
+    ||  !origin.isfinite()
+    ||  !dir.isfinite()
+    ||  !(static_cast<T>(0) < dir.sq_length()) ) return count;
+
+    const vec3<T> inv_dir( static_cast<T>(1) / dir.x,
+                           static_cast<T>(1) / dir.y,
+                           static_cast<T>(1) / dir.z );
+    const auto inf = std::numeric_limits<T>::infinity();
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0U);
+    while(!stack.empty()){
+        const auto i = stack.back();
+        stack.pop_back();
+
+        const auto &node = this->nodes[i];
+        T t_entry = static_cast<T>(0);
+        if(!ray_box(origin, inv_dir, node.bounds, inf, t_entry)) continue;
+
+        if(node.is_leaf()){
+            for(size_t k = node.offset; k < (node.offset + node.count); ++k){
+                T t = static_cast<T>(0);
+                if( ray_triangle(origin, dir, this->triangles[k], t)
+                &&  (static_cast<T>(0) < t) ){
+                    ++count;
+                }
+            }
+        }else{
+            stack.push_back(i + node.offset);
+            stack.push_back(i + 1U);
+        }
+    }
+    return count;
+}
+
+template <class T, class I>
+std::vector<typename mesh_bvh<T,I>::ray_hit>
+mesh_bvh<T,I>::ray_intersections(const vec3<T> &origin, const vec3<T> &dir, T t_max) const {
+    std::vector<ray_hit> out;
+    if( this->nodes.empty()
+    ||  !origin.isfinite()
+    ||  !dir.isfinite()
+    ||  !(static_cast<T>(0) < dir.sq_length()) ) return out;
+
+    const vec3<T> inv_dir( static_cast<T>(1) / dir.x,
+                           static_cast<T>(1) / dir.y,
+                           static_cast<T>(1) / dir.z );
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0U);
+    while(!stack.empty()){
+        const auto i = stack.back();
+        stack.pop_back();
+
+        const auto &node = this->nodes[i];
+        T t_entry = static_cast<T>(0);
+        if(!ray_box(origin, inv_dir, node.bounds, t_max, t_entry)) continue;
+
+        if(node.is_leaf()){
+            for(size_t k = node.offset; k < (node.offset + node.count); ++k){
+                T t = static_cast<T>(0);
+                if( ray_triangle(origin, dir, this->triangles[k], t)
+                &&  (static_cast<T>(0) < t)
+                &&  (t <= t_max) ){
+                    out.push_back( ray_hit{ origin + dir * t, t, this->triangle_faces[k] } );
+                }
+            }
+        }else{
+            stack.push_back(i + node.offset);
+            stack.push_back(i + 1U);
+        }
+    }
+    std::sort(std::begin(out), std::end(out),
+              [](const ray_hit &l, const ray_hit &r){ return (l.t < r.t); });
+    return out;
+}
+
+template <class T, class I>
+bool mesh_bvh<T,I>::is_inside(const vec3<T> &point) const {
+    // Directions are deliberately irregular to avoid aligning with typical mesh edges and image axes.
+    const std::array<vec3<T>,3> dirs = {{ vec3<T>( static_cast<T>( 0.5773502691896258), static_cast<T>( 0.5727652155277355), static_cast<T>( 0.5819018898047542) ),
+                                          vec3<T>( static_cast<T>(-0.6418833420432870), static_cast<T>( 0.3114285196451622), static_cast<T>(-0.7007411563052396) ),
+                                          vec3<T>( static_cast<T>( 0.2309438640735421), static_cast<T>(-0.9183226312475937), static_cast<T>( 0.3214728473632513) ) }};
+    int64_t votes = 0;
+    for(const auto &d : dirs){
+        if((this->count_ray_intersections(point, d) % 2UL) == 1UL) ++votes;
+    }
+    return (2 <= votes);
+}
+
+template <class T, class I>
+T mesh_bvh<T,I>::signed_distance(const vec3<T> &point) const {
+    const auto cp = this->closest_point(point);
+    if(!cp) return std::numeric_limits<T>::quiet_NaN();
+    if(cp->distance == static_cast<T>(0)) return static_cast<T>(0);
+    return (this->is_inside(point)) ? -(cp->distance) : cp->distance;
+}
+
+template <class T, class I>
+std::vector<std::optional<typename mesh_bvh<T,I>::closest_point_result>>
+mesh_bvh<T,I>::closest_points(const std::vector<vec3<T>> &points, T max_distance) const {
+    std::vector<std::optional<closest_point_result>> out(points.size());
+    parallel_over_chunks(points.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i) out[i] = this->closest_point(points[i], max_distance);
+    });
+    return out;
+}
+
+template <class T, class I>
+std::vector<std::optional<typename mesh_bvh<T,I>::ray_hit>>
+mesh_bvh<T,I>::ray_casts(const std::vector<line<T>> &rays, T t_max) const {
+    std::vector<std::optional<ray_hit>> out(rays.size());
+    parallel_over_chunks(rays.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i) out[i] = this->ray_cast(rays[i].R_0, rays[i].U_0, t_max);
+    });
+    return out;
+}
+
+template <class T, class I>
+std::vector<T> mesh_bvh<T,I>::signed_distances(const std::vector<vec3<T>> &points) const {
+    std::vector<T> out(points.size());
+    parallel_over_chunks(points.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i) out[i] = this->signed_distance(points[i]);
+    });
+    return out;
+}
+
+#ifndef YGOR_INDEX_BVH_DISABLE_ALL_SPECIALIZATIONS
+    template class mesh_bvh<float , uint32_t>;
+    template class mesh_bvh<float , uint64_t>;
+    template class mesh_bvh<double, uint32_t>;
+    template class mesh_bvh<double, uint64_t>;
+#endif
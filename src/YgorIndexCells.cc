@@ -5,7 +5,10 @@
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <limits>
+#include <numeric>
+#include <tuple>
 #include <stdexcept>
 #include <utility>
 #include <vector>
@@ -25,33 +28,88 @@
 
 //------------------------------------------------------ Private helpers ----------------------------------------------------
 
-template <class T>
-typename cells_index<T>::cell_t cells_index<T>::make_cell(const vec3<T> &v) const {
-    return { static_cast<int64_t>(std::floor(v.x * inv_cell_size)),
-             static_cast<int64_t>(std::floor(v.y * inv_cell_size)),
-             static_cast<int64_t>(std::floor(v.z * inv_cell_size)) };
+template <class T, class Payload>
+typename cells_index<T, Payload>::cell_t cells_index<T, Payload>::make_cell(const vec3<T> &v) const {
+    // Clamp so that distant query points do not overflow. Cells this far away cannot be occupied anyway.
+    const T lim = static_cast<T>(static_cast<int64_t>(1) << 52);
+    return { static_cast<int64_t>(std::clamp(std::floor(v.x * inv_cell_size), -lim, lim)),
+             static_cast<int64_t>(std::clamp(std::floor(v.y * inv_cell_size), -lim, lim)),
+             static_cast<int64_t>(std::clamp(std::floor(v.z * inv_cell_size), -lim, lim)) };
 }
 
-template <class T>
-void cells_index<T>::update_bounds(const vec3<T> &point) {
+template <class T, class Payload>
+void cells_index<T, Payload>::update_bounds(const vec3<T> &point) {
+    const auto c = make_cell(point);
     if(!bounds_initialized){
         bounds = bbox(point, point);
         bounds_initialized = true;
+        cell_min = c;
+        cell_max = c;
     }else{
         bounds.expand(point);
+        cell_min = { std::min(cell_min.x, c.x), std::min(cell_min.y, c.y), std::min(cell_min.z, c.z) };
+        cell_max = { std::max(cell_max.x, c.x), std::max(cell_max.y, c.y), std::max(cell_max.z, c.z) };
+    }
+}
+
+template <class T, class Payload>
+size_t cells_index<T, Payload>::find_compacted_cell(const cell_t &c) const {
+    const auto &table = compacted.table;
+    const size_t N_cells = compacted.cells.size();
+    if(table.empty()) return N_cells;
+
+    const size_t mask = table.size() - 1;
+    for(size_t slot = cell_hash_t{}(c) & mask; ; slot = (slot + 1) & mask){
+        const auto id = table[slot];
+        if(id == 0) return N_cells;
+        if(compacted.cells[id - 1] == c) return static_cast<size_t>(id - 1);
     }
 }
 
+template <class T, class Payload>
+template <class F>
+bool cells_index<T, Payload>::visit_cell(const cell_t &c, F &&f) const {
+    const size_t i = find_compacted_cell(c);
+    if(i < compacted.cells.size()){
+        for(size_t j = compacted.offsets[i]; j < compacted.offsets[i + 1]; ++j){
+            if(!f(compacted.entries[j])) return false;
+        }
+    }
+    if(!bins.empty()){
+        const auto it = bins.find(c);
+        if(it != std::end(bins)){
+            for(const auto &e : it->second){
+                if(!f(e)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <class T, class Payload>
+template <class F>
+bool cells_index<T, Payload>::visit_all_cells(F &&f) const {
+    for(size_t i = 0; i < compacted.cells.size(); ++i){
+        const auto begin = std::next(compacted.entries.begin(), static_cast<std::ptrdiff_t>(compacted.offsets[i]));
+        const auto end = std::next(compacted.entries.begin(), static_cast<std::ptrdiff_t>(compacted.offsets[i + 1]));
+        if(!f(compacted.cells[i], begin, end)) return false;
+    }
+    for(const auto &bin : bins){
+        if(!f(bin.first, bin.second.begin(), bin.second.end())) return false;
+    }
+    return true;
+}
+
 //------------------------------------------------------ Constructors -------------------------------------------------------
 
-template <class T>
-cells_index<T>::cells_index() : cell_size(static_cast<T>(1)),
+template <class T, class Payload>
+cells_index<T, Payload>::cells_index() : cell_size(static_cast<T>(1)),
                                 inv_cell_size(static_cast<T>(1)),
                                 entry_count(0),
                                 bounds_initialized(false) { }
 
-template <class T>
-cells_index<T>::cells_index(T cs) : cell_size(cs),
+template <class T, class Payload>
+cells_index<T, Payload>::cells_index(T cs) : cell_size(cs),
                                     entry_count(0),
                                     bounds_initialized(false) {
     if(!(static_cast<T>(0) < cs)){
@@ -60,18 +118,18 @@ cells_index<T>::cells_index(T cs) : cell_size(cs),
     inv_cell_size = static_cast<T>(1) / cs;
 }
 
-template <class T>
-cells_index<T>::~cells_index() = default;
+template <class T, class Payload>
+cells_index<T, Payload>::~cells_index() = default;
 
 //------------------------------------------------------ Member functions ---------------------------------------------------
 
-template <class T>
-void cells_index<T>::insert(const vec3<T> &point) {
-    insert(point, std::any{});
+template <class T, class Payload>
+void cells_index<T, Payload>::insert(const vec3<T> &point) {
+    insert(point, Payload{});
 }
 
-template <class T>
-void cells_index<T>::insert(const vec3<T> &point, std::any aux_data) {
+template <class T, class Payload>
+void cells_index<T, Payload>::insert(const vec3<T> &point, Payload aux_data) {
     if(!point.isfinite()){
         throw std::invalid_argument("Cannot insert non-finite point into cells_index");
     }
@@ -82,33 +140,64 @@ void cells_index<T>::insert(const vec3<T> &point, std::any aux_data) {
     update_bounds(point);
 }
 
-template <class T>
-std::vector<typename cells_index<T>::entry> cells_index<T>::search(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<typename cells_index<T, Payload>::entry> cells_index<T, Payload>::search(const bbox &query_box) const {
     std::vector<entry> results;
-    
-    const auto c_min = make_cell(query_box.min);
-    const auto c_max = make_cell(query_box.max);
+    search(query_box, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void cells_index<T, Payload>::search(const bbox &query_box, const visitor &f) const {
+    if(entry_count == 0) return;
+
+    // Only occupied cells need to be considered.
+    const auto q_min = make_cell(query_box.min);
+    const auto q_max = make_cell(query_box.max);
+    const cell_t c_min = { std::max(q_min.x, cell_min.x), std::max(q_min.y, cell_min.y), std::max(q_min.z, cell_min.z) };
+    const cell_t c_max = { std::min(q_max.x, cell_max.x), std::min(q_max.y, cell_max.y), std::min(q_max.z, cell_max.z) };
+    if((c_max.x < c_min.x) || (c_max.y < c_min.y) || (c_max.z < c_min.z)) return;
+
+    // Entries are points, so plain comparisons suffice (and are exact).
+    const auto visit_entry = [&](const entry &e){
+        const auto &p = e.box.min;
+        const bool inside = (query_box.min.x <= p.x) && (p.x <= query_box.max.x)
+                         && (query_box.min.y <= p.y) && (p.y <= query_box.max.y)
+                         && (query_box.min.z <= p.z) && (p.z <= query_box.max.z);
+        return !inside || f(e);
+    };
+
+    // When the query spans more cells than are occupied, it is cheaper to check every occupied cell.
+    const double N_query_cells = static_cast<double>(c_max.x - c_min.x + 1)
+                               * static_cast<double>(c_max.y - c_min.y + 1)
+                               * static_cast<double>(c_max.z - c_min.z + 1);
+    if(static_cast<double>(compacted.cells.size() + bins.size()) < N_query_cells){
+        visit_all_cells([&](const cell_t &c, auto begin, auto end){
+            if( (c.x < c_min.x) || (c_max.x < c.x)
+            ||  (c.y < c_min.y) || (c_max.y < c.y)
+            ||  (c.z < c_min.z) || (c_max.z < c.z) ) return true;
+            for(auto it = begin; it != end; ++it){
+                if(!visit_entry(*it)) return false;
+            }
+            return true;
+        });
+        return;
+    }
     
     for(int64_t cx = c_min.x; cx <= c_max.x; ++cx){
         for(int64_t cy = c_min.y; cy <= c_max.y; ++cy){
             for(int64_t cz = c_min.z; cz <= c_max.z; ++cz){
-                const cell_t c = { cx, cy, cz };
-                const auto it = bins.find(c);
-                if(it == std::end(bins)) continue;
-                
-                for(const auto &e : it->second){
-                    if(e.box.intersects(query_box)){
-                        results.push_back(e);
-                    }
-                }
+                if(!visit_cell({ cx, cy, cz }, visit_entry)) return;
             }
         }
     }
-    return results;
 }
 
-template <class T>
-std::vector<vec3<T>> cells_index<T>::search_points(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<vec3<T>> cells_index<T, Payload>::search_points(const bbox &query_box) const {
     auto entries = search(query_box);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -120,25 +209,29 @@ std::vector<vec3<T>> cells_index<T>::search_points(const bbox &query_box) const
     return results;
 }
 
-template <class T>
-std::vector<typename cells_index<T>::entry> cells_index<T>::search_radius(const vec3<T> &center, T radius) const {
+template <class T, class Payload>
+std::vector<typename cells_index<T, Payload>::entry> cells_index<T, Payload>::search_radius(const vec3<T> &center, T radius) const {
+    std::vector<entry> results;
+    search_radius(center, radius, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void cells_index<T, Payload>::search_radius(const vec3<T> &center, T radius, const visitor &f) const {
     vec3<T> offset(radius, radius, radius);
     bbox query_box(center - offset, center + offset);
     
-    auto candidates = search(query_box);
-    
-    std::vector<entry> results;
-    T radius_sq = radius * radius;
-    for(const auto& e : candidates){
-        if(e.box.squared_distance_to(center) <= radius_sq){
-            results.push_back(e);
-        }
-    }
-    return results;
+    const T radius_sq = radius * radius;
+    search(query_box, [&](const entry &e){
+        return (radius_sq < e.box.min.sq_dist(center)) || f(e);
+    });
 }
 
-template <class T>
-std::vector<vec3<T>> cells_index<T>::search_radius_points(const vec3<T> &center, T radius) const {
+template <class T, class Payload>
+std::vector<vec3<T>> cells_index<T, Payload>::search_radius_points(const vec3<T> &center, T radius) const {
     auto entries = search_radius(center, radius);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -150,67 +243,101 @@ std::vector<vec3<T>> cells_index<T>::search_radius_points(const vec3<T> &center,
     return results;
 }
 
-template <class T>
-std::vector<typename cells_index<T>::entry> cells_index<T>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
-    if(k == 0 || entry_count == 0) return {};
-    
-    // Expand search radius until we find at least k results.
-    // Start with one cell neighbourhood and double until sufficient.
-    T search_radius = cell_size;
-    std::vector<std::pair<T, entry>> candidates;
-    
-    for(int attempt = 0; attempt < 64; ++attempt){
-        candidates.clear();
-        
-        vec3<T> offset(search_radius, search_radius, search_radius);
-        bbox query_box(query_point - offset, query_point + offset);
-        
-        const auto c_min = make_cell(query_box.min);
-        const auto c_max = make_cell(query_box.max);
-        
-        for(int64_t cx = c_min.x; cx <= c_max.x; ++cx){
-            for(int64_t cy = c_min.y; cy <= c_max.y; ++cy){
-                for(int64_t cz = c_min.z; cz <= c_max.z; ++cz){
-                    const cell_t c = { cx, cy, cz };
-                    const auto it = bins.find(c);
-                    if(it == std::end(bins)) continue;
-                    
-                    for(const auto &e : it->second){
-                        T dist_sq = e.box.squared_distance_to(query_point);
-                        candidates.emplace_back(dist_sq, e);
-                    }
+template <class T, class Payload>
+std::vector<typename cells_index<T, Payload>::entry> cells_index<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
+    std::vector<entry> results;
+    nearest_neighbors(query_point, k, [&](const entry &e, T){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void cells_index<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const {
+    if(k == 0 || entry_count == 0) return;
+
+    // A max-heap of the best candidates found so far.
+    std::vector<std::pair<T, const entry*>> best;
+    const auto cmp = [](const std::pair<T, const entry*> &a, const std::pair<T, const entry*> &b){
+        return a.first < b.first;
+    };
+    const auto consider = [&](const entry &e){
+        const T dist_sq = query_point.sq_dist(e.box.min);
+        if(best.size() < k){
+            best.emplace_back(dist_sq, &e);
+            std::push_heap(best.begin(), best.end(), cmp);
+        }else if(dist_sq < best.front().first){
+            std::pop_heap(best.begin(), best.end(), cmp);
+            best.back() = std::make_pair(dist_sq, &e);
+            std::push_heap(best.begin(), best.end(), cmp);
+        }
+        return true;
+    };
+
+    // Visit cells in rings (shells of cells at a given Chebyshev distance) around the query cell. Rings nearer than the
+    // occupied cells are empty, so they are skipped.
+    const auto q = make_cell(query_point);
+    const auto ring_of = [&](const cell_t &c) -> int64_t {
+        return std::max({ std::abs(c.x - q.x), std::abs(c.y - q.y), std::abs(c.z - q.z) });
+    };
+    const auto gap = [](int64_t x, int64_t lo, int64_t hi) -> int64_t {
+        return std::max({ static_cast<int64_t>(0), lo - x, x - hi });
+    };
+    const int64_t r_min = std::max({ gap(q.x, cell_min.x, cell_max.x),
+                                     gap(q.y, cell_min.y, cell_max.y),
+                                     gap(q.z, cell_min.z, cell_max.z) });
+    const int64_t r_max = std::max({ std::abs(q.x - cell_min.x), std::abs(q.x - cell_max.x),
+                                     std::abs(q.y - cell_min.y), std::abs(q.y - cell_max.y),
+                                     std::abs(q.z - cell_min.z), std::abs(q.z - cell_max.z) });
+    const double N_occupied = static_cast<double>(compacted.cells.size() + bins.size());
+
+    for(int64_t r = r_min; r <= r_max; ++r){
+        // Entries in ring r + 1 and beyond are separated from the query point by at least r whole cells. The bound is
+        // slightly relaxed to guard against roundoff when assigning points to cells.
+        if(k <= best.size()){
+            const T reach = static_cast<T>(r - 1) * cell_size * (static_cast<T>(1) - static_cast<T>(16) * std::numeric_limits<T>::epsilon());
+            if((static_cast<T>(0) < reach) && (best.front().first < reach * reach)) break;
+        }
+
+        const cell_t lo = { std::max(q.x - r, cell_min.x), std::max(q.y - r, cell_min.y), std::max(q.z - r, cell_min.z) };
+        const cell_t hi = { std::min(q.x + r, cell_max.x), std::min(q.y + r, cell_max.y), std::min(q.z + r, cell_max.z) };
+
+        // When the remaining rings span more cells than are occupied, finish by checking every occupied cell instead.
+        const double N_ring_cells = static_cast<double>(hi.x - lo.x + 1)
+                                  * static_cast<double>(hi.y - lo.y + 1)
+                                  * static_cast<double>(hi.z - lo.z + 1);
+        if(N_occupied < N_ring_cells){
+            visit_all_cells([&](const cell_t &c, auto begin, auto end){
+                if(r <= ring_of(c)){
+                    for(auto it = begin; it != end; ++it) consider(*it);
                 }
-            }
+                return true;
+            });
+            break;
         }
-        
-        if(candidates.size() >= k) break;
-        search_radius *= static_cast<T>(2);
-    }
-    
-    // If we still don't have enough, scan all bins.
-    if(candidates.size() < k){
-        candidates.clear();
-        for(const auto &bin : bins){
-            for(const auto &e : bin.second){
-                T dist_sq = e.box.squared_distance_to(query_point);
-                candidates.emplace_back(dist_sq, e);
+
+        for(int64_t cx = lo.x; cx <= hi.x; ++cx){
+            for(int64_t cy = lo.y; cy <= hi.y; ++cy){
+                const bool on_shell = (std::abs(cx - q.x) == r) || (std::abs(cy - q.y) == r);
+                if(on_shell){
+                    for(int64_t cz = lo.z; cz <= hi.z; ++cz) visit_cell({ cx, cy, cz }, consider);
+                }else{
+                    if(cell_min.z <= (q.z - r)) visit_cell({ cx, cy, q.z - r }, consider);
+                    if((0 < r) && ((q.z + r) <= cell_max.z)) visit_cell({ cx, cy, q.z + r }, consider);
+                }
             }
         }
     }
-    
-    std::sort(candidates.begin(), candidates.end(),
-              [](const auto& a, const auto& b){ return a.first < b.first; });
-    
-    std::vector<entry> results;
-    size_t count = std::min(k, candidates.size());
-    for(size_t i = 0; i < count; ++i){
-        results.push_back(candidates[i].second);
+
+    std::sort_heap(best.begin(), best.end(), cmp);
+    for(const auto &p : best){
+        if(!f(*(p.second), p.first)) return;
     }
-    return results;
 }
 
-template <class T>
-std::vector<vec3<T>> cells_index<T>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
+template <class T, class Payload>
+std::vector<vec3<T>> cells_index<T, Payload>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
     auto entries = nearest_neighbors(query_point, k);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -222,48 +349,157 @@ std::vector<vec3<T>> cells_index<T>::nearest_neighbors_points(const vec3<T> &que
     return results;
 }
 
-template <class T>
-bool cells_index<T>::contains(const vec3<T> &point) const {
+template <class T, class Payload>
+bool cells_index<T, Payload>::contains(const vec3<T> &point) const {
+    if(entry_count == 0) return false;
     const auto c = make_cell(point);
+    const bbox point_box(point, point);
     
     // Scan 3x3x3 neighbourhood to handle boundary cases.
+    bool found = false;
     for(int64_t dx = -1L; dx <= 1L; ++dx){
         for(int64_t dy = -1L; dy <= 1L; ++dy){
             for(int64_t dz = -1L; dz <= 1L; ++dz){
-                const cell_t c_n = { c.x + dx, c.y + dy, c.z + dz };
-                const auto it = bins.find(c_n);
-                if(it == std::end(bins)) continue;
-                
-                for(const auto &e : it->second){
-                    if(e.box == bbox(point, point)){
-                        return true;
-                    }
-                }
+                visit_cell({ c.x + dx, c.y + dy, c.z + dz }, [&](const entry &e){
+                    found = (e.box == point_box);
+                    return !found;
+                });
+                if(found) return true;
             }
         }
     }
     return false;
 }
 
-template <class T>
-void cells_index<T>::clear() {
+template <class T, class Payload>
+void cells_index<T, Payload>::compact() {
+    // Gather all entries and assign each to a cell.
+    std::vector<entry> all;
+    all.reserve(entry_count);
+    std::move(compacted.entries.begin(), compacted.entries.end(), std::back_inserter(all));
+    for(auto &bin : bins){
+        std::move(bin.second.begin(), bin.second.end(), std::back_inserter(all));
+    }
+    bins.clear();
+    compacted = static_layout_t();
+
+    const size_t N = all.size();
+    if(N == 0) return;
+    if(static_cast<size_t>(std::numeric_limits<uint32_t>::max()) <= N){
+        throw std::runtime_error("Too many entries to compact cells_index");
+    }
+
+    const auto table_size_for = [](size_t n){
+        size_t size = 16;
+        while(size < 2 * n) size *= 2;
+        return size;
+    };
+
+    // Number the distinct cells in order of first appearance, using a temporary hash table.
+    std::vector<cell_t> cells;
+    std::vector<uint32_t> entry_cell(N);
+    {
+        std::vector<uint32_t> table(table_size_for(N), 0);
+        const size_t mask = table.size() - 1;
+        for(size_t i = 0; i < N; ++i){
+            const auto c = make_cell(all[i].box.min);
+            size_t slot = cell_hash_t{}(c) & mask;
+            while((table[slot] != 0) && !(cells[table[slot] - 1] == c)) slot = (slot + 1) & mask;
+            if(table[slot] == 0){
+                cells.push_back(c);
+                table[slot] = static_cast<uint32_t>(cells.size());
+            }
+            entry_cell[i] = table[slot] - 1;
+        }
+    }
+    const size_t N_cells = cells.size();
+
+    // Order the cells along a Morton curve, falling back to lexicographic order if the occupied range is too large.
+    std::vector<uint32_t> cell_order(N_cells);
+    std::iota(cell_order.begin(), cell_order.end(), static_cast<uint32_t>(0));
+    const int64_t max_span = std::max({ cell_max.x - cell_min.x, cell_max.y - cell_min.y, cell_max.z - cell_min.z });
+    if(max_span < (static_cast<int64_t>(1) << 21)){
+        const auto spread = [](uint64_t x){
+            x &= 0x1FFFFFULL;
+            x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+            x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+            x = (x | (x <<  8)) & 0x100F00F00F00F00FULL;
+            x = (x | (x <<  4)) & 0x10C30C30C30C30C3ULL;
+            x = (x | (x <<  2)) & 0x1249249249249249ULL;
+            return x;
+        };
+        std::vector<uint64_t> keys(N_cells);
+        for(size_t i = 0; i < N_cells; ++i){
+            const auto &c = cells[i];
+            keys[i] = (spread(static_cast<uint64_t>(c.x - cell_min.x)) << 2)
+                    | (spread(static_cast<uint64_t>(c.y - cell_min.y)) << 1)
+                    |  spread(static_cast<uint64_t>(c.z - cell_min.z));
+        }
+        std::sort(cell_order.begin(), cell_order.end(), [&](uint32_t a, uint32_t b){ return keys[a] < keys[b]; });
+    }else{
+        std::sort(cell_order.begin(), cell_order.end(), [&](uint32_t a, uint32_t b){
+            const auto &l = cells[a];
+            const auto &r = cells[b];
+            return std::make_tuple(l.x, l.y, l.z) < std::make_tuple(r.x, r.y, r.z);
+        });
+    }
+    std::vector<uint32_t> cell_rank(N_cells);
+    for(size_t i = 0; i < N_cells; ++i) cell_rank[cell_order[i]] = static_cast<uint32_t>(i);
+
+    // Counting sort the entries by cell.
+    compacted.cells.resize(N_cells);
+    compacted.offsets.assign(N_cells + 1, 0);
+    for(size_t i = 0; i < N_cells; ++i) compacted.cells[i] = cells[cell_order[i]];
+    for(size_t i = 0; i < N; ++i) ++compacted.offsets[cell_rank[entry_cell[i]] + 1];
+    std::partial_sum(compacted.offsets.begin(), compacted.offsets.end(), compacted.offsets.begin());
+
+    std::vector<uint32_t> next(compacted.offsets.begin(), compacted.offsets.end() - 1);
+    compacted.entries.resize(N);
+    for(size_t i = 0; i < N; ++i){
+        compacted.entries[next[cell_rank[entry_cell[i]]]++] = std::move(all[i]);
+    }
+
+    // Index the cells.
+    compacted.table.assign(table_size_for(N_cells), 0);
+    const size_t mask = compacted.table.size() - 1;
+    for(size_t i = 0; i < N_cells; ++i){
+        size_t slot = cell_hash_t{}(compacted.cells[i]) & mask;
+        while(compacted.table[slot] != 0) slot = (slot + 1) & mask;
+        compacted.table[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+template <class T, class Payload>
+size_t cells_index<T, Payload>::get_staged_size() const {
+    size_t N = 0;
+    for(const auto &bin : bins) N += bin.second.size();
+    return N;
+}
+
+template <class T, class Payload>
+void cells_index<T, Payload>::clear() {
     bins.clear();
+    compacted = static_layout_t();
     entry_count = 0;
     bounds_initialized = false;
     bounds = bbox();
 }
 
-template <class T>
-size_t cells_index<T>::get_size() const {
+template <class T, class Payload>
+size_t cells_index<T, Payload>::get_size() const {
     return entry_count;
 }
 
-template <class T>
-typename cells_index<T>::bbox cells_index<T>::get_bounds() const {
+template <class T, class Payload>
+typename cells_index<T, Payload>::bbox cells_index<T, Payload>::get_bounds() const {
     return bounds;
 }
 
 #ifndef YGOR_INDEX_CELLS_DISABLE_ALL_SPECIALIZATIONS
-    template class cells_index<float>;
-    template class cells_index<double>;
+    template class cells_index<float , std::any>;
+    template class cells_index<double, std::any>;
+    template class cells_index<float , uint32_t>;
+    template class cells_index<double, uint32_t>;
+    template class cells_index<float , uint64_t>;
+    template class cells_index<double, uint64_t>;
 #endif
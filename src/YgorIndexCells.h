@@ -27,12 +27,19 @@
 // Space is divided into uniform cubic cells of a user-specified width (cell_size).
 // Each cell stores the entries that fall within it.
 //
+// Entries are initially held in a dynamic hash map of cells. Calling compact() moves all entries into a static layout:
+// a single contiguous array grouped by cell, with cells in Morton (Z-order) order and a cell offset table located via an
+// open-addressing hash table. This avoids a separate allocation per cell, considerably reducing memory usage and improving
+// query locality. Entries inserted afterward are held in the dynamic map, which acts as a staging area, and both are
+// searched until the next call to compact().
+//
 // The index supports efficient spatial queries such as:
 //  - Range queries (find all objects within a region)
-//  - Nearest neighbor queries (via local neighbourhood scan)
+//  - Nearest neighbor queries (via expanding rings of cells)
 //  - Radius queries
 //
-// Users can optionally associate auxiliary data (via std::any) with each inserted point.
+// Users can optionally associate auxiliary data with each inserted point. By default this is a std::any, but a plain
+// payload type (e.g., a uint32_t id) can be provided as the second template parameter to avoid type erasure.
 // This auxiliary data is not used during spatial queries but can be retrieved after lookups.
 //
 // Example usage:
@@ -45,11 +52,17 @@
 //        auto points = idx.search_points(query_box);
 //
 
-template <class T> class cells_index {
+template <class T, class Payload = std::any> class cells_index {
     public:
         using value_type = T;
-        using entry = index_entry<T>;
+        using payload_type = Payload;
+        using entry = index_entry<T, Payload>;
         using bbox = index_bbox<T>;
+
+        // Callbacks for the visitor-style queries. Entries are passed by reference, avoiding copies. Returning false stops
+        // the query early.
+        using visitor = std::function<bool(const entry &)>;
+        using distance_visitor = std::function<bool(const entry &, T)>; // Also receives the squared distance.
         
         //--------------------------------------------------- Data members -------------------------------------------------
     private:
@@ -62,23 +75,56 @@ template <class T> class cells_index {
             }
         };
         struct cell_hash_t {
+            // Coordinates are mixed sequentially using the splitmix64 finalizer, so structured (e.g., planar or
+            // axis-aligned) arrangements of cells are spread evenly.
+            static uint64_t mix(uint64_t h){
+                h ^= h >> 30U;
+                h *= 0xBF58476D1CE4E5B9ULL;
+                h ^= h >> 27U;
+                h *= 0x94D049BB133111EBULL;
+                h ^= h >> 31U;
+                return h;
+            }
             std::size_t operator()(const cell_t &c) const {
-                const auto h0 = std::hash<int64_t>{}(c.x);
-                const auto h1 = std::hash<int64_t>{}(c.y);
-                const auto h2 = std::hash<int64_t>{}(c.z);
-                return h0 ^ (h1 << 1U) ^ (h2 << 2U);
+                uint64_t h = mix(static_cast<uint64_t>(c.x));
+                h = mix(h + static_cast<uint64_t>(c.y));
+                h = mix(h + static_cast<uint64_t>(c.z));
+                return static_cast<std::size_t>(h);
             }
         };
+
+        // Entries compacted into a contiguous, read-only layout.
+        struct static_layout_t {
+            std::vector<cell_t> cells;      // Occupied cells, in Morton order.
+            std::vector<uint32_t> offsets;  // The entries of cells[i] are entries[offsets[i]] up to entries[offsets[i+1]].
+            std::vector<entry> entries;     // Grouped by cell.
+            std::vector<uint32_t> table;    // Open-addressing hash table holding (cell index + 1), or zero for empty slots.
+                                            // The size is a power of two.
+        };
         
         T cell_size;
         T inv_cell_size;
-        std::unordered_map<cell_t, std::vector<entry>, cell_hash_t> bins;
+        std::unordered_map<cell_t, std::vector<entry>, cell_hash_t> bins; // The dynamic staging area.
+        static_layout_t compacted;
         size_t entry_count;
         bbox bounds;
         bool bounds_initialized;
+        cell_t cell_min;                    // The range of occupied cells. Only valid when bounds are initialized.
+        cell_t cell_max;
         
         cell_t make_cell(const vec3<T> &v) const;
         void update_bounds(const vec3<T> &point);
+
+        // Locate a cell in the static layout. Returns the number of cells if the cell is not present.
+        size_t find_compacted_cell(const cell_t &c) const;
+
+        // Visit the entries in a cell, in both the static layout and the staging area. Returns false if f stopped early.
+        template <class F>
+        bool visit_cell(const cell_t &c, F &&f) const;
+
+        // Visit every occupied cell. Returns false if f stopped early.
+        template <class F>
+        bool visit_all_cells(F &&f) const;
         
     public:
         //--------------------------------------------------- Constructors -------------------------------------------------
@@ -96,7 +142,7 @@ template <class T> class cells_index {
         void insert(const vec3<T> &point);
         
         // Insert a point with auxiliary data into the index.
-        void insert(const vec3<T> &point, std::any aux_data);
+        void insert(const vec3<T> &point, Payload aux_data);
         
         // Search for all entries within a bounding box.
         std::vector<entry> search(const bbox &query_box) const;
@@ -106,11 +152,23 @@ template <class T> class cells_index {
         
         // Search for all entries within a given radius of a center point.
         std::vector<entry> search_radius(const vec3<T> &center, T radius) const;
+
+        // Visit all entries fully or partially within a bounding box.
+        void search(const bbox &query_box, const visitor &f) const;
+
+        // Visit all entries fully or partially within a given radius of a center point.
+        void search_radius(const vec3<T> &center, T radius, const visitor &f) const;
+
+        // Visit the k nearest neighbor entries to a query point, in order of increasing distance.
+        void nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const;
         
         // Search for all points within a given radius of a center point (returns points only).
         std::vector<vec3<T>> search_radius_points(const vec3<T> &center, T radius) const;
         
-        // Find the k nearest neighbor entries to a query point.
+        // Find the k nearest neighbor entries to a query point, in order of increasing distance.
+        //
+        // Cells are visited in rings of increasing distance from the query point until no unvisited cell can hold a
+        // nearer entry.
         std::vector<entry> nearest_neighbors(const vec3<T> &query_point, size_t k) const;
         
         // Find the k nearest neighbor points to a query point (returns points only).
@@ -118,6 +176,12 @@ template <class T> class cells_index {
         
         // Check if the index contains a specific point.
         bool contains(const vec3<T> &point) const;
+
+        // Move all entries, including any in the staging area, into the static layout.
+        void compact();
+
+        // Get the number of entries in the dynamic staging area, i.e., inserted since the last call to compact().
+        size_t get_staged_size() const;
         
         // Remove all entries from the index.
         void clear();
@@ -2,10 +2,21 @@
 
 #include <algorithm>
 #include <any>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <future>
+#include <istream>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <ostream>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -13,6 +24,7 @@
 #include "YgorMath.h"
 #include "YgorIndex.h"
 #include "YgorIndexKDTree.h"
+#include "YgorIndexMapped.h"
 
 //#ifndef YGOR_INDEX_KDTREE_DISABLE_ALL_SPECIALIZATIONS
 //    #define YGOR_INDEX_KDTREE_DISABLE_ALL_SPECIALIZATIONS
@@ -22,129 +34,424 @@
 //---------------------------- kdtree: kd-tree spatial indexing data structure ----------------------------------------------
 //---------------------------------------------------------------------------------------------------------------------------
 
-//------------------------------------------------------ kdtree_node --------------------------------------------------------
+//------------------------------------------------------ Private helpers ----------------------------------------------------
 
-template <class T>
-kdtree<T>::kdtree_node::kdtree_node() : split_axis(0) { }
+namespace {
+    constexpr size_t kdtree_max_leaf_size = 64;
 
-template <class T>
-kdtree<T>::kdtree_node::kdtree_node(const entry &e, int axis) : data(e), split_axis(axis) { }
+    // Subtrees with fewer entries are not worth building on a separate thread.
+    constexpr size_t kdtree_parallel_threshold = 50'000;
 
-//------------------------------------------------------ Private helpers ----------------------------------------------------
+    // Number of pairs found by a join that are collected before they are passed to the visitor.
+    constexpr size_t kdtree_join_batch_size = 1024;
+
+    // Distribute tasks over the hardware threads, including the calling thread.
+    template <class F>
+    void kdtree_run_workers(bool parallel, F &&worker){
+        const size_t N_threads = parallel ? std::max<size_t>(1, std::thread::hardware_concurrency()) : 1;
+        std::vector<std::future<void>> futs;
+        for(size_t t = 1; t < N_threads; ++t){
+            futs.emplace_back(std::async(std::launch::async, [&](){ worker(); }));
+        }
+        worker();
+        for(auto &f : futs) f.get();
+        return;
+    }
+
+    // Plain comparisons are exact for finite coordinates, so these are equivalent to the index_bbox members but are
+    // considerably cheaper on the hot paths.
+    template <class T>
+    T fast_sq_dist(const vec3<T> &p, const index_bbox<T> &b){
+        const T zero = static_cast<T>(0);
+        const T dx = std::max(std::max(b.min.x - p.x, p.x - b.max.x), zero);
+        const T dy = std::max(std::max(b.min.y - p.y, p.y - b.max.y), zero);
+        const T dz = std::max(std::max(b.min.z - p.z, p.z - b.max.z), zero);
+        return dx * dx + dy * dy + dz * dz;
+    }
 
-template <class T>
-T kdtree<T>::get_coord(const vec3<T> &point, int axis) {
+    template <class T>
+    T fast_sq_dist(const index_bbox<T> &a, const index_bbox<T> &b){
+        const T zero = static_cast<T>(0);
+        const T dx = std::max(std::max(b.min.x - a.max.x, a.min.x - b.max.x), zero);
+        const T dy = std::max(std::max(b.min.y - a.max.y, a.min.y - b.max.y), zero);
+        const T dz = std::max(std::max(b.min.z - a.max.z, a.min.z - b.max.z), zero);
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    // Assemble a bbox from coordinates that are already ordered, bypassing the (robust, but costly) constructor.
+    template <class T>
+    index_bbox<T> ordered_bbox(const vec3<T> &min, const vec3<T> &max){
+        index_bbox<T> box;
+        box.min = min;
+        box.max = max;
+        return box;
+    }
+
+    template <class T>
+    bool fast_intersects(const index_bbox<T> &a, const index_bbox<T> &b){
+        return (a.min.x <= b.max.x) && (b.min.x <= a.max.x)
+            && (a.min.y <= b.max.y) && (b.min.y <= a.max.y)
+            && (a.min.z <= b.max.z) && (b.min.z <= a.max.z);
+    }
+
+    template <class T>
+    bool fast_contains(const index_bbox<T> &outer, const index_bbox<T> &inner){
+        return (outer.min.x <= inner.min.x) && (inner.max.x <= outer.max.x)
+            && (outer.min.y <= inner.min.y) && (inner.max.y <= outer.max.y)
+            && (outer.min.z <= inner.min.z) && (inner.max.z <= outer.max.z);
+    }
+}
+
+template <class T, class Payload>
+T kdtree<T, Payload>::get_coord(const vec3<T> &point, int axis) {
     if(axis == 0) return point.x;
     if(axis == 1) return point.y;
     return point.z;
 }
 
-template <class T>
-T kdtree<T>::point_to_bbox_sq_dist(const vec3<T> &point, const bbox &box) {
-    return box.squared_distance_to(point);
+template <class T, class Payload>
+T kdtree<T, Payload>::point_to_bbox_sq_dist(const vec3<T> &point, const bbox &box) {
+    return fast_sq_dist(point, box);
+}
+
+template <class T, class Payload>
+size_t kdtree<T, Payload>::node_count(size_t N) const {
+    if(N <= leaf_size) return 1;
+    const size_t N_left = N / 2;
+    return 1 + node_count(N_left) + node_count(N - N_left);
 }
 
-template <class T>
-std::unique_ptr<typename kdtree<T>::kdtree_node>
-kdtree<T>::build(std::vector<entry> &entries, size_t begin, size_t end, int depth) const {
-    if(begin >= end) return nullptr;
+template <class T, class Payload>
+void kdtree<T, Payload>::build_subtree(tree_data &t, std::vector<size_t> &order, const std::vector<vec3<T>> &centres,
+                              size_t node, size_t begin, size_t end, int64_t spawn_depth) const {
+    const auto &coords = t.coords;
+    auto &n = t.nodes[node];
+    n.begin = begin;
+    n.end = end;
+    n.right = 0;
+
+    const T inf = std::numeric_limits<T>::infinity();
+    vec3<T> lo(inf, inf, inf);
+    vec3<T> hi(-inf, -inf, -inf);
+    vec3<T> c_lo = lo;
+    vec3<T> c_hi = hi;
+    for(size_t i = begin; i < end; ++i){
+        const size_t j = order[i];
+        lo.x = std::min(lo.x, coords.min_x[j]);
+        lo.y = std::min(lo.y, coords.min_y[j]);
+        lo.z = std::min(lo.z, coords.min_z[j]);
+        hi.x = std::max(hi.x, coords.max_x[j]);
+        hi.y = std::max(hi.y, coords.max_y[j]);
+        hi.z = std::max(hi.z, coords.max_z[j]);
+        const auto &c = centres[j];
+        c_lo.x = std::min(c_lo.x, c.x);
+        c_lo.y = std::min(c_lo.y, c.y);
+        c_lo.z = std::min(c_lo.z, c.z);
+        c_hi.x = std::max(c_hi.x, c.x);
+        c_hi.y = std::max(c_hi.y, c.y);
+        c_hi.z = std::max(c_hi.z, c.z);
+    }
+    n.node_bounds = bbox(lo, hi);
+    if((end - begin) <= leaf_size) return;
 
-    const int axis = depth % 3;
+    // Split along the axis with the widest spread.
+    const auto extent = c_hi - c_lo;
+    const int axis = (extent.y < extent.x) ? ((extent.z < extent.x) ? 0 : 2)
+                                           : ((extent.z < extent.y) ? 1 : 2);
     const size_t mid = begin + (end - begin) / 2;
-    auto mid_it = entries.begin() + static_cast<std::ptrdiff_t>(mid);
-    std::nth_element(entries.begin() + static_cast<std::ptrdiff_t>(begin),
-                     mid_it,
-                     entries.begin() + static_cast<std::ptrdiff_t>(end),
-                     [axis](const entry &a, const entry &b){
-                         return get_coord(a.box.center(), axis) < get_coord(b.box.center(), axis);
+    std::nth_element(order.begin() + static_cast<std::ptrdiff_t>(begin),
+                     order.begin() + static_cast<std::ptrdiff_t>(mid),
+                     order.begin() + static_cast<std::ptrdiff_t>(end),
+                     [axis,&centres](size_t a, size_t b){
+                         return get_coord(centres[a], axis) < get_coord(centres[b], axis);
                      });
 
-    auto node = std::make_unique<kdtree_node>(entries[mid], axis);
+    const size_t left = node + 1;
+    const size_t right = left + node_count(mid - begin);
+    n.right = right;
+
+    if((0 < spawn_depth) && (kdtree_parallel_threshold <= (end - begin))){
+        auto fut = std::async(std::launch::async, [&](){
+            this->build_subtree(t, order, centres, left, begin, mid, spawn_depth - 1);
+        });
+        this->build_subtree(t, order, centres, right, mid, end, spawn_depth - 1);
+        fut.get();
+    }else{
+        this->build_subtree(t, order, centres, left, begin, mid, spawn_depth - 1);
+        this->build_subtree(t, order, centres, right, mid, end, spawn_depth - 1);
+    }
+    return;
+}
 
-    node->node_bounds = entries[begin].box;
-    for(size_t i = begin + 1; i < end; ++i){
-        node->node_bounds.expand(entries[i].box);
+template <class T, class Payload>
+std::shared_ptr<typename kdtree<T, Payload>::tree_data> kdtree<T, Payload>::build_tree(std::vector<entry> entries) const {
+    auto t = std::make_shared<tree_data>();
+    auto &coords = t->coords;
+    const size_t N = entries.size();
+    if(N == 0) return t;
+
+    const auto fill_coords = [&](){
+        for(auto *v : { &coords.min_x, &coords.min_y, &coords.min_z, &coords.max_x, &coords.max_y, &coords.max_z }){
+            v->clear();
+            v->reserve(N);
+        }
+        for(const auto &e : t->entries){
+            coords.min_x.push_back(e.box.min.x);
+            coords.min_y.push_back(e.box.min.y);
+            coords.min_z.push_back(e.box.min.z);
+            coords.max_x.push_back(e.box.max.x);
+            coords.max_y.push_back(e.box.max.y);
+            coords.max_z.push_back(e.box.max.z);
+        }
+    };
+    t->entries = std::move(entries);
+    fill_coords();
+
+    std::vector<vec3<T>> centres;
+    centres.reserve(N);
+    for(size_t i = 0; i < N; ++i){
+        centres.emplace_back((coords.min_x[i] + coords.max_x[i]) / static_cast<T>(2),
+                             (coords.min_y[i] + coords.max_y[i]) / static_cast<T>(2),
+                             (coords.min_z[i] + coords.max_z[i]) / static_cast<T>(2));
     }
 
-    node->left  = build(entries, begin, mid, depth + 1);
-    node->right = build(entries, mid + 1, end, depth + 1);
+    std::vector<size_t> order(N);
+    std::iota(std::begin(order), std::end(order), static_cast<size_t>(0));
+
+    int64_t spawn_depth = 0;
+    const auto N_threads = std::thread::hardware_concurrency();
+    while((static_cast<int64_t>(1) << spawn_depth) < static_cast<int64_t>(N_threads)) ++spawn_depth;
 
-    return node;
+    t->nodes.resize(node_count(N));
+    build_subtree(*t, order, centres, 0, 0, N, spawn_depth);
+
+    // Store the entries in leaf order.
+    std::vector<entry> ordered;
+    ordered.reserve(N);
+    for(const auto i : order) ordered.push_back(std::move(t->entries[i]));
+    t->entries.swap(ordered);
+    fill_coords();
+    return t;
 }
 
-template <class T>
-void kdtree<T>::ensure_built() const {
-    if(tree_built) return;
+template <class T, class Payload>
+void kdtree<T, Payload>::ensure_built() const {
+    // In double-buffered mode, queries use the most recently published tree.
+    if(mode == build_mode::double_buffered) return;
 
-    root.reset();
+    if(tree_built.load(std::memory_order_acquire)) return;
+    std::lock_guard<std::mutex> lock(build_mutex);
+    if(tree_built.load(std::memory_order_relaxed)) return;
 
-    if(!pending_entries.empty()){
-        root = build(pending_entries, 0, pending_entries.size(), 0);
-    }
+    // Insertions cannot overlap queries in this mode, so nothing else refers to the current tree.
+    std::vector<entry> entries;
+    if(tree != nullptr) entries = std::move(tree->entries);
+    entries.reserve(entries.size() + pending_entries.size());
+    std::move(std::begin(pending_entries), std::end(pending_entries), std::back_inserter(entries));
+    pending_entries.clear();
+    tree = build_tree(std::move(entries));
 
-    tree_built = true;
+    tree_built.store(true, std::memory_order_release);
 }
 
-template <class T>
-void kdtree<T>::search_recursive(const kdtree_node* node, const bbox &query_box,
-                                  std::vector<entry> &results) const {
-    if((node == nullptr) || !node->node_bounds.intersects(query_box)) return;
-
-    if(node->data.box.intersects(query_box)){
-        results.push_back(node->data);
+template <class T, class Payload>
+typename kdtree<T, Payload>::tree_view kdtree<T, Payload>::acquire() const {
+    tree_view v;
+    if(mode == build_mode::double_buffered){
+        v.keep_alive = std::atomic_load(&tree);
+        v.tree = v.keep_alive.get();
+    }else{
+        ensure_built();
+        v.tree = tree.get();
     }
+    return v;
+}
 
-    search_recursive(node->left.get(), query_box, results);
-    search_recursive(node->right.get(), query_box, results);
+template <class T, class Payload>
+void kdtree<T, Payload>::leaf_sq_dists(const tree_data &t, const kdtree_node &leaf, const vec3<T> &point, T *out) {
+    const auto &coords = t.coords;
+    const T *min_x = coords.min_x.data() + leaf.begin;
+    const T *min_y = coords.min_y.data() + leaf.begin;
+    const T *min_z = coords.min_z.data() + leaf.begin;
+    const T *max_x = coords.max_x.data() + leaf.begin;
+    const T *max_y = coords.max_y.data() + leaf.begin;
+    const T *max_z = coords.max_z.data() + leaf.begin;
+    const size_t N = leaf.end - leaf.begin;
+    const T zero = static_cast<T>(0);
+
+    // Branch-free so the loop can be vectorized.
+    for(size_t i = 0; i < N; ++i){
+        const T dx = std::max(std::max(min_x[i] - point.x, point.x - max_x[i]), zero);
+        const T dy = std::max(std::max(min_y[i] - point.y, point.y - max_y[i]), zero);
+        const T dz = std::max(std::max(min_z[i] - point.z, point.z - max_z[i]), zero);
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+    return;
 }
 
-template <class T>
-void kdtree<T>::nearest_recursive(const kdtree_node* node, const vec3<T> &query_point, size_t k,
-                                   std::vector<std::pair<T, entry>> &best) const {
-    if(node == nullptr) return;
+template <class T, class Payload>
+void kdtree<T, Payload>::leaf_sq_dists(const tree_data &t, const kdtree_node &leaf, const bbox &box, T *out) {
+    const auto &coords = t.coords;
+    const T *min_x = coords.min_x.data() + leaf.begin;
+    const T *min_y = coords.min_y.data() + leaf.begin;
+    const T *min_z = coords.min_z.data() + leaf.begin;
+    const T *max_x = coords.max_x.data() + leaf.begin;
+    const T *max_y = coords.max_y.data() + leaf.begin;
+    const T *max_z = coords.max_z.data() + leaf.begin;
+    const size_t N = leaf.end - leaf.begin;
+    const T zero = static_cast<T>(0);
+
+    for(size_t i = 0; i < N; ++i){
+        const T dx = std::max(std::max(min_x[i] - box.max.x, box.min.x - max_x[i]), zero);
+        const T dy = std::max(std::max(min_y[i] - box.max.y, box.min.y - max_y[i]), zero);
+        const T dz = std::max(std::max(min_z[i] - box.max.z, box.min.z - max_z[i]), zero);
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+    return;
+}
 
-    if(best.size() == k){
-        const T min_dist_sq = point_to_bbox_sq_dist(query_point, node->node_bounds);
-        if(min_dist_sq >= best.front().first) return;
+template <class T, class Payload>
+bool kdtree<T, Payload>::join_recursive(const tree_data &a, size_t node_a, const tree_data &b, size_t node_b, T max_sq_dist,
+                                        join_batch &batch, const join_flush &flush) {
+    const auto &n_a = a.nodes[node_a];
+    const auto &n_b = b.nodes[node_b];
+    if(max_sq_dist < fast_sq_dist(n_a.node_bounds, n_b.node_bounds)) return true;
+
+    if((n_a.right == 0) && (n_b.right == 0)){
+        std::array<T, kdtree_max_leaf_size> dists;
+        for(size_t i = n_a.begin; i < n_a.end; ++i){
+            const auto box_a = ordered_bbox(vec3<T>(a.coords.min_x[i], a.coords.min_y[i], a.coords.min_z[i]),
+                                            vec3<T>(a.coords.max_x[i], a.coords.max_y[i], a.coords.max_z[i]));
+            if(max_sq_dist < fast_sq_dist(box_a, n_b.node_bounds)) continue;
+            leaf_sq_dists(b, n_b, box_a, dists.data());
+            for(size_t j = n_b.begin; j < n_b.end; ++j){
+                if(dists[j - n_b.begin] <= max_sq_dist){
+                    batch.emplace_back(i, j);
+                    if((kdtree_join_batch_size <= batch.size()) && !flush(batch)) return false;
+                }
+            }
+        }
+        return true;
     }
 
-    const T dist_sq = node->data.box.squared_distance_to(query_point);
+    // Split the larger subtree.
+    const bool split_a = (n_b.right == 0) || ((n_a.right != 0) && ((n_b.end - n_b.begin) <= (n_a.end - n_a.begin)));
+    if(split_a){
+        return join_recursive(a, node_a + 1, b, node_b, max_sq_dist, batch, flush)
+            && join_recursive(a, n_a.right, b, node_b, max_sq_dist, batch, flush);
+    }
+    return join_recursive(a, node_a, b, node_b + 1, max_sq_dist, batch, flush)
+        && join_recursive(a, node_a, b, n_b.right, max_sq_dist, batch, flush);
+}
 
-    if(best.size() < k){
-        best.emplace_back(dist_sq, node->data);
-        std::push_heap(best.begin(), best.end(),
-                       [](const auto &a, const auto &b){ return a.first < b.first; });
-    }else if(dist_sq < best.front().first){
-        std::pop_heap(best.begin(), best.end(),
-                      [](const auto &a, const auto &b){ return a.first < b.first; });
-        best.back() = std::make_pair(dist_sq, node->data);
-        std::push_heap(best.begin(), best.end(),
-                       [](const auto &a, const auto &b){ return a.first < b.first; });
+template <class T, class Payload>
+void kdtree<T, Payload>::join_nearest_recursive(const tree_data &a, const kdtree_node &leaf_a, const tree_data &b, size_t node_b,
+                                                size_t k, std::vector<std::vector<std::pair<T, size_t>>> &best) {
+    const auto cmp = [](const std::pair<T, size_t> &l, const std::pair<T, size_t> &r){ return l.first < r.first; };
+    const auto &n = b.nodes[node_b];
+
+    // The subtree can be skipped if it is farther than the current k-th nearest entry of every query.
+    const T node_dist_sq = fast_sq_dist(leaf_a.node_bounds, n.node_bounds);
+    bool prune = true;
+    for(const auto &h : best){
+        if((h.size() < k) || !(h.front().first < node_dist_sq)){
+            prune = false;
+            break;
+        }
+    }
+    if(prune) return;
+
+    if(n.right == 0){
+        std::array<T, kdtree_max_leaf_size> dists;
+        for(size_t i = leaf_a.begin; i < leaf_a.end; ++i){
+            auto &h = best[i - leaf_a.begin];
+            const auto box_a = ordered_bbox(vec3<T>(a.coords.min_x[i], a.coords.min_y[i], a.coords.min_z[i]),
+                                            vec3<T>(a.coords.max_x[i], a.coords.max_y[i], a.coords.max_z[i]));
+            if((k <= h.size()) && (h.front().first < fast_sq_dist(box_a, n.node_bounds))) continue;
+
+            leaf_sq_dists(b, n, box_a, dists.data());
+            for(size_t j = n.begin; j < n.end; ++j){
+                const T dist_sq = dists[j - n.begin];
+                if(h.size() < k){
+                    h.emplace_back(dist_sq, j);
+                    std::push_heap(h.begin(), h.end(), cmp);
+                }else if(dist_sq < h.front().first){
+                    std::pop_heap(h.begin(), h.end(), cmp);
+                    h.back() = std::make_pair(dist_sq, j);
+                    std::push_heap(h.begin(), h.end(), cmp);
+                }
+            }
+        }
+        return;
     }
 
-    const int axis = node->split_axis;
-    const T split_val = get_coord(node->data.box.center(), axis);
-    const T query_val = get_coord(query_point, axis);
-    const T diff = query_val - split_val;
+    // Visit the nearer child first.
+    size_t near_child = node_b + 1;
+    size_t far_child = n.right;
+    if(fast_sq_dist(leaf_a.node_bounds, b.nodes[far_child].node_bounds)
+       < fast_sq_dist(leaf_a.node_bounds, b.nodes[near_child].node_bounds)){
+        std::swap(near_child, far_child);
+    }
+    join_nearest_recursive(a, leaf_a, b, near_child, k, best);
+    join_nearest_recursive(a, leaf_a, b, far_child, k, best);
+    return;
+}
 
-    const kdtree_node* near_subtree = (diff <= static_cast<T>(0)) ? node->left.get() : node->right.get();
-    const kdtree_node* far_subtree  = (diff <= static_cast<T>(0)) ? node->right.get() : node->left.get();
+template <class T, class Payload>
+void kdtree<T, Payload>::nearest_recursive(const tree_data &t, size_t node, const vec3<T> &query_point, size_t k,
+                                  bool points_only, std::vector<std::pair<T, size_t>> &best) {
+    const auto &nodes = t.nodes;
+    const auto cmp = [](const std::pair<T, size_t> &a, const std::pair<T, size_t> &b){ return a.first < b.first; };
+    const auto &n = nodes[node];
+
+    if(n.right == 0){
+        std::array<T, kdtree_max_leaf_size> dists;
+        leaf_sq_dists(t, n, query_point, dists.data());
+        for(size_t i = n.begin; i < n.end; ++i){
+            if( points_only
+            && ( (t.coords.min_x[i] != t.coords.max_x[i])
+              || (t.coords.min_y[i] != t.coords.max_y[i])
+              || (t.coords.min_z[i] != t.coords.max_z[i]) ) ) continue;
+
+            const T dist_sq = dists[i - n.begin];
+            if(best.size() < k){
+                best.emplace_back(dist_sq, i);
+                std::push_heap(best.begin(), best.end(), cmp);
+            }else if(dist_sq < best.front().first){
+                std::pop_heap(best.begin(), best.end(), cmp);
+                best.back() = std::make_pair(dist_sq, i);
+                std::push_heap(best.begin(), best.end(), cmp);
+            }
+        }
+        return;
+    }
 
-    nearest_recursive(near_subtree, query_point, k, best);
+    // Visit the nearer child first.
+    size_t near_child = node + 1;
+    size_t far_child = n.right;
+    T near_dist_sq = point_to_bbox_sq_dist(query_point, nodes[near_child].node_bounds);
+    T far_dist_sq = point_to_bbox_sq_dist(query_point, nodes[far_child].node_bounds);
+    if(far_dist_sq < near_dist_sq){
+        std::swap(near_child, far_child);
+        std::swap(near_dist_sq, far_dist_sq);
+    }
 
-    const T split_dist_sq = diff * diff;
-    if(best.size() < k || split_dist_sq < best.front().first){
-        nearest_recursive(far_subtree, query_point, k, best);
+    if(best.size() < k || near_dist_sq < best.front().first){
+        nearest_recursive(t, near_child, query_point, k, points_only, best);
     }
+    if(best.size() < k || far_dist_sq < best.front().first){
+        nearest_recursive(t, far_child, query_point, k, points_only, best);
+    }
+    return;
 }
 
-template <class T>
-void kdtree<T>::update_bounds(const vec3<T> &point) {
+template <class T, class Payload>
+void kdtree<T, Payload>::update_bounds(const vec3<T> &point) {
     update_bounds(bbox(point, point));
 }
 
-template <class T>
-void kdtree<T>::update_bounds(const bbox &bb) {
+template <class T, class Payload>
+void kdtree<T, Payload>::update_bounds(const bbox &bb) {
     if(!bounds_initialized){
         bounds = bb;
         bounds_initialized = true;
@@ -155,54 +462,100 @@ void kdtree<T>::update_bounds(const bbox &bb) {
 
 //------------------------------------------------------ Constructors -------------------------------------------------------
 
-template <class T>
-kdtree<T>::kdtree() : entry_count(0), bounds_initialized(false), tree_built(true) { }
+template <class T, class Payload>
+kdtree<T, Payload>::kdtree() : kdtree(16) { }
+
+template <class T, class Payload>
+kdtree<T, Payload>::kdtree(size_t leaf_size, build_mode mode)
+  : leaf_size(std::clamp<size_t>(leaf_size, 1, kdtree_max_leaf_size)), mode(mode), frozen(false),
+    entry_count(0), bounds_initialized(false), tree_built(true) { }
 
-template <class T>
-kdtree<T>::~kdtree() = default;
+template <class T, class Payload>
+kdtree<T, Payload>::~kdtree() = default;
 
 //------------------------------------------------------ Member functions ---------------------------------------------------
 
-template <class T>
-void kdtree<T>::insert(const vec3<T> &point) {
-    insert(point, std::any{});
+template <class T, class Payload>
+void kdtree<T, Payload>::insert(const vec3<T> &point) {
+    insert(point, Payload{});
 }
 
-template <class T>
-void kdtree<T>::insert(const vec3<T> &point, std::any aux_data) {
+template <class T, class Payload>
+void kdtree<T, Payload>::insert(const vec3<T> &point, Payload aux_data) {
     insert(bbox(point, point), std::move(aux_data));
 }
 
-template <class T>
-void kdtree<T>::insert(const bbox &bb) {
-    insert(bb, std::any{});
+template <class T, class Payload>
+void kdtree<T, Payload>::insert(const bbox &bb) {
+    insert(bb, Payload{});
 }
 
-template <class T>
-void kdtree<T>::insert(const bbox &bb, std::any aux_data) {
+template <class T, class Payload>
+void kdtree<T, Payload>::insert(const bbox &bb, Payload aux_data) {
     if(!bb.isfinite()){
         throw std::invalid_argument("Cannot insert non-finite bbox into kdtree");
     }
 
+    std::lock_guard<std::mutex> lock(build_mutex);
+    if(frozen){
+        throw std::runtime_error("Cannot insert into a frozen kdtree");
+    }
     pending_entries.emplace_back(bb, std::move(aux_data));
     update_bounds(bb);
     ++entry_count;
-    tree_built = false;
+    tree_built.store(false, std::memory_order_relaxed);
 }
 
-template <class T>
-std::vector<typename kdtree<T>::entry> kdtree<T>::search(const bbox &query_box) const {
-    ensure_built();
-
+template <class T, class Payload>
+std::vector<typename kdtree<T, Payload>::entry> kdtree<T, Payload>::search(const bbox &query_box) const {
     std::vector<entry> results;
-    if(root != nullptr){
-        search_recursive(root.get(), query_box, results);
-    }
+    search(query_box, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
     return results;
 }
 
-template <class T>
-std::vector<vec3<T>> kdtree<T>::search_points(const bbox &query_box) const {
+template <class T, class Payload>
+void kdtree<T, Payload>::search(const bbox &query_box, const visitor &f) const {
+    const auto v = acquire();
+    if((v.tree == nullptr) || v.tree->nodes.empty()) return;
+    const auto &nodes = v.tree->nodes;
+    const auto &entries = v.tree->entries;
+    const auto &coords = v.tree->coords;
+
+    std::vector<size_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while(!stack.empty()){
+        const size_t node = stack.back();
+        const auto &n = nodes[node];
+        stack.pop_back();
+        if(!fast_intersects(n.node_bounds, query_box)) continue;
+
+        if(n.right != 0){
+            stack.push_back(n.right);
+            stack.push_back(node + 1);
+
+        }else if(fast_contains(query_box, n.node_bounds)){
+            for(size_t i = n.begin; i < n.end; ++i){
+                if(!f(entries[i])) return;
+            }
+        }else{
+            for(size_t i = n.begin; i < n.end; ++i){
+                if( (coords.min_x[i] <= query_box.max.x) && (query_box.min.x <= coords.max_x[i])
+                &&  (coords.min_y[i] <= query_box.max.y) && (query_box.min.y <= coords.max_y[i])
+                &&  (coords.min_z[i] <= query_box.max.z) && (query_box.min.z <= coords.max_z[i]) ){
+                    if(!f(entries[i])) return;
+                }
+            }
+        }
+    }
+    return;
+}
+
+template <class T, class Payload>
+std::vector<vec3<T>> kdtree<T, Payload>::search_points(const bbox &query_box) const {
     auto entries = search(query_box);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -214,8 +567,8 @@ std::vector<vec3<T>> kdtree<T>::search_points(const bbox &query_box) const {
     return results;
 }
 
-template <class T>
-std::vector<typename kdtree<T>::bbox> kdtree<T>::search_bboxes(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<typename kdtree<T, Payload>::bbox> kdtree<T, Payload>::search_bboxes(const bbox &query_box) const {
     auto entries = search(query_box);
     std::vector<bbox> results;
     results.reserve(entries.size());
@@ -225,8 +578,8 @@ std::vector<typename kdtree<T>::bbox> kdtree<T>::search_bboxes(const bbox &query
     return results;
 }
 
-template <class T>
-std::vector<typename kdtree<T>::bbox> kdtree<T>::search_bboxes(const vec3<T> &query_point) const {
+template <class T, class Payload>
+std::vector<typename kdtree<T, Payload>::bbox> kdtree<T, Payload>::search_bboxes(const vec3<T> &query_point) const {
     auto entries = search(bbox(query_point, query_point));
     std::vector<bbox> results;
     results.reserve(entries.size());
@@ -238,25 +591,50 @@ std::vector<typename kdtree<T>::bbox> kdtree<T>::search_bboxes(const vec3<T> &qu
     return results;
 }
 
-template <class T>
-std::vector<typename kdtree<T>::entry> kdtree<T>::search_radius(const vec3<T> &center, T radius) const {
-    vec3<T> offset(radius, radius, radius);
-    bbox query_box(center - offset, center + offset);
-
-    auto candidates = search(query_box);
-
+template <class T, class Payload>
+std::vector<typename kdtree<T, Payload>::entry> kdtree<T, Payload>::search_radius(const vec3<T> &center, T radius) const {
     std::vector<entry> results;
+    search_radius(center, radius, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void kdtree<T, Payload>::search_radius(const vec3<T> &center, T radius, const visitor &f) const {
+    const auto v = acquire();
+    if((v.tree == nullptr) || v.tree->nodes.empty() || !(static_cast<T>(0) <= radius)) return;
+    const auto &nodes = v.tree->nodes;
     const T radius_sq = radius * radius;
-    for(const auto& e : candidates){
-        if(e.box.squared_distance_to(center) <= radius_sq){
-            results.push_back(e);
+
+    std::array<T, kdtree_max_leaf_size> dists;
+    std::vector<size_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while(!stack.empty()){
+        const size_t node = stack.back();
+        const auto &n = nodes[node];
+        stack.pop_back();
+        if(radius_sq < point_to_bbox_sq_dist(center, n.node_bounds)) continue;
+
+        if(n.right != 0){
+            stack.push_back(n.right);
+            stack.push_back(node + 1);
+        }else{
+            leaf_sq_dists(*v.tree, n, center, dists.data());
+            for(size_t i = n.begin; i < n.end; ++i){
+                if(dists[i - n.begin] <= radius_sq){
+                    if(!f(v.tree->entries[i])) return;
+                }
+            }
         }
     }
-    return results;
+    return;
 }
 
-template <class T>
-std::vector<vec3<T>> kdtree<T>::search_radius_points(const vec3<T> &center, T radius) const {
+template <class T, class Payload>
+std::vector<vec3<T>> kdtree<T, Payload>::search_radius_points(const vec3<T> &center, T radius) const {
     auto entries = search_radius(center, radius);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -268,52 +646,178 @@ std::vector<vec3<T>> kdtree<T>::search_radius_points(const vec3<T> &center, T ra
     return results;
 }
 
-template <class T>
-std::vector<typename kdtree<T>::entry> kdtree<T>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
-    ensure_built();
+template <class T, class Payload>
+std::vector<typename kdtree<T, Payload>::entry> kdtree<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
+    std::vector<entry> results;
+    nearest_neighbors(query_point, k, [&](const entry &e, T){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
 
-    std::vector<std::pair<T, entry>> best;
+template <class T, class Payload>
+void kdtree<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const {
+    const auto v = acquire();
+    if(k == 0 || (v.tree == nullptr) || v.tree->nodes.empty()){
+        return;
+    }
 
-    std::vector<entry> results;
-    if(k == 0 || root == nullptr){
+    std::vector<std::pair<T, size_t>> best;
+    best.reserve(std::min(k, v.tree->entries.size()) + 1);
+    nearest_recursive(*v.tree, 0, query_point, k, false, best);
+
+    std::sort(best.begin(), best.end(),
+              [](const auto &a, const auto &b){ return a.first < b.first; });
+
+    for(const auto &pair : best){
+        if(!f(v.tree->entries[pair.second], pair.first)) return;
+    }
+    return;
+}
+
+template <class T, class Payload>
+std::vector<vec3<T>> kdtree<T, Payload>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
+    const auto v = acquire();
+
+    std::vector<vec3<T>> results;
+    if(k == 0 || (v.tree == nullptr) || v.tree->nodes.empty()){
         return results;
     }
 
-    best.reserve(k + 1);
-    nearest_recursive(root.get(), query_point, k, best);
+    std::vector<std::pair<T, size_t>> best;
+    best.reserve(std::min(k, v.tree->entries.size()) + 1);
+    nearest_recursive(*v.tree, 0, query_point, k, true, best);
 
     std::sort(best.begin(), best.end(),
               [](const auto &a, const auto &b){ return a.first < b.first; });
 
     results.reserve(best.size());
     for(const auto &pair : best){
-        results.push_back(pair.second);
+        results.push_back(v.tree->entries[pair.second].box.min);
     }
     return results;
 }
 
-template <class T>
-std::vector<vec3<T>> kdtree<T>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
-    if(k == 0) return {};
-    auto entries = nearest_neighbors(query_point, entry_count);
-    std::vector<vec3<T>> results;
-    results.reserve(std::min(k, entries.size()));
-    for(const auto& e : entries){
-        if(!e.box.has_extent()){
-            results.push_back(e.box.min);
-            if(results.size() == k) break;
+template <class T, class Payload>
+void kdtree<T, Payload>::join_within_distance(const kdtree &other, T distance, const pair_visitor &f) const {
+    const auto v_a = acquire();
+    const auto v_b = other.acquire();
+    if( (v_a.tree == nullptr) || v_a.tree->nodes.empty()
+    ||  (v_b.tree == nullptr) || v_b.tree->nodes.empty()
+    ||  !(static_cast<T>(0) <= distance) ) return;
+    const auto &t_a = *v_a.tree;
+    const auto &t_b = *v_b.tree;
+    const T max_sq_dist = distance * distance;
+
+    // Divide the join into independent pairs of subtrees by repeatedly splitting the largest pair.
+    const size_t N_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    const bool parallel = (1 < N_threads) && (kdtree_parallel_threshold <= (t_a.entries.size() + t_b.entries.size()));
+    std::vector<std::pair<size_t, size_t>> tasks = {{ 0, 0 }};
+    while(parallel && (tasks.size() < 16 * N_threads)){
+        const auto task_size = [&](const std::pair<size_t, size_t> &p){
+            const auto &n_a = t_a.nodes[p.first];
+            const auto &n_b = t_b.nodes[p.second];
+            return ((n_a.right == 0) && (n_b.right == 0)) ? 0 : (n_a.end - n_a.begin) + (n_b.end - n_b.begin);
+        };
+        const auto largest = std::max_element(tasks.begin(), tasks.end(), [&](const auto &l, const auto &r){
+            return task_size(l) < task_size(r);
+        });
+        if(task_size(*largest) == 0) break;
+
+        const auto [node_a, node_b] = *largest;
+        tasks.erase(largest);
+        const auto &n_a = t_a.nodes[node_a];
+        const auto &n_b = t_b.nodes[node_b];
+        const bool split_a = (n_b.right == 0) || ((n_a.right != 0) && ((n_b.end - n_b.begin) <= (n_a.end - n_a.begin)));
+        const std::array<std::pair<size_t, size_t>, 2> children = split_a
+            ? std::array<std::pair<size_t, size_t>, 2>{{ { node_a + 1, node_b }, { n_a.right, node_b } }}
+            : std::array<std::pair<size_t, size_t>, 2>{{ { node_a, node_b + 1 }, { node_a, n_b.right } }};
+        for(const auto &c : children){
+            if(!(max_sq_dist < fast_sq_dist(t_a.nodes[c.first].node_bounds, t_b.nodes[c.second].node_bounds))){
+                tasks.push_back(c);
+            }
         }
     }
-    return results;
+
+    std::mutex visitor_mutex;
+    std::atomic<bool> stopped(false);
+    std::atomic<size_t> next_task(0);
+    const join_flush flush = [&](join_batch &batch){
+        std::lock_guard<std::mutex> lock(visitor_mutex);
+        for(const auto &p : batch){
+            if(stopped.load(std::memory_order_relaxed)) break;
+            if(!f(t_a.entries[p.first], t_b.entries[p.second])) stopped.store(true);
+        }
+        batch.clear();
+        return !stopped.load(std::memory_order_relaxed);
+    };
+    kdtree_run_workers(parallel, [&](){
+        join_batch batch;
+        batch.reserve(kdtree_join_batch_size);
+        for(size_t i = next_task++; (i < tasks.size()) && !stopped.load(); i = next_task++){
+            if(!join_recursive(t_a, tasks[i].first, t_b, tasks[i].second, max_sq_dist, batch, flush)) return;
+        }
+        if(!batch.empty()) flush(batch);
+    });
+    return;
 }
 
-template <class T>
-bool kdtree<T>::contains(const vec3<T> &point) const {
+template <class T, class Payload>
+void kdtree<T, Payload>::join_nearest_neighbors(const kdtree &other, size_t k, const pair_distance_visitor &f) const {
+    const auto v_a = acquire();
+    const auto v_b = other.acquire();
+    if( (k == 0)
+    ||  (v_a.tree == nullptr) || v_a.tree->nodes.empty()
+    ||  (v_b.tree == nullptr) || v_b.tree->nodes.empty() ) return;
+    const auto &t_a = *v_a.tree;
+    const auto &t_b = *v_b.tree;
+
+    std::vector<size_t> leaves;
+    for(size_t node = 0; node < t_a.nodes.size(); ++node){
+        if(t_a.nodes[node].right == 0) leaves.push_back(node);
+    }
+
+    const size_t N_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    const bool parallel = (1 < N_threads) && (kdtree_parallel_threshold <= t_a.entries.size());
+    std::mutex visitor_mutex;
+    std::atomic<bool> stopped(false);
+    std::atomic<size_t> next_leaf(0);
+    kdtree_run_workers(parallel, [&](){
+        std::vector<std::vector<std::pair<T, size_t>>> best;
+        for(size_t l = next_leaf++; (l < leaves.size()) && !stopped.load(); l = next_leaf++){
+            const auto &leaf = t_a.nodes[leaves[l]];
+            best.resize(leaf.end - leaf.begin);
+            for(auto &h : best){
+                h.clear();
+                h.reserve(std::min(k, t_b.entries.size()) + 1);
+            }
+            join_nearest_recursive(t_a, leaf, t_b, 0, k, best);
+            for(auto &h : best){
+                std::sort(h.begin(), h.end(), [](const auto &l, const auto &r){ return l.first < r.first; });
+            }
+
+            std::lock_guard<std::mutex> lock(visitor_mutex);
+            for(size_t i = leaf.begin; (i < leaf.end) && !stopped.load(); ++i){
+                for(const auto &p : best[i - leaf.begin]){
+                    if(!f(t_a.entries[i], t_b.entries[p.second], p.first)){
+                        stopped.store(true);
+                        break;
+                    }
+                }
+            }
+        }
+    });
+    return;
+}
+
+template <class T, class Payload>
+bool kdtree<T, Payload>::contains(const vec3<T> &point) const {
     return contains(bbox(point, point));
 }
 
-template <class T>
-bool kdtree<T>::contains(const bbox &bb) const {
+template <class T, class Payload>
+bool kdtree<T, Payload>::contains(const bbox &bb) const {
     auto results = search(bb);
     for(const auto &result : results){
         if(result.box == bb){
@@ -323,27 +827,214 @@ bool kdtree<T>::contains(const bbox &bb) const {
     return false;
 }
 
-template <class T>
-void kdtree<T>::clear() {
-    root.reset();
+template <class T, class Payload>
+void kdtree<T, Payload>::build() {
+    if(mode == build_mode::lazy){
+        ensure_built();
+        return;
+    }
+
+    // Copy rather than move the current entries, since queries may still be using the current tree.
+    std::vector<entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(build_mutex);
+        const auto current = std::atomic_load(&tree);
+        if(pending_entries.empty() && (current != nullptr)) return;
+        if(current != nullptr) entries = current->entries;
+        entries.reserve(entries.size() + pending_entries.size());
+        std::move(std::begin(pending_entries), std::end(pending_entries), std::back_inserter(entries));
+        pending_entries.clear();
+
+        // Build while holding the lock so concurrent build() calls publish trees in order. Insertions wait, but
+        // queries continue to use the current tree.
+        std::atomic_store(&tree, build_tree(std::move(entries)));
+    }
+    return;
+}
+
+template <class T, class Payload>
+void kdtree<T, Payload>::freeze() {
+    build();
+    std::lock_guard<std::mutex> lock(build_mutex);
+    frozen = true;
+}
+
+template <class T, class Payload>
+void kdtree<T, Payload>::thaw() {
+    std::lock_guard<std::mutex> lock(build_mutex);
+    frozen = false;
+}
+
+template <class T, class Payload>
+bool kdtree<T, Payload>::is_frozen() const {
+    std::lock_guard<std::mutex> lock(build_mutex);
+    return frozen;
+}
+
+template <class T, class Payload>
+void kdtree<T, Payload>::clear() {
+    std::lock_guard<std::mutex> lock(build_mutex);
+    if(frozen){
+        throw std::runtime_error("Cannot clear a frozen kdtree");
+    }
+    std::atomic_store(&tree, std::shared_ptr<tree_data>());
     pending_entries.clear();
     entry_count = 0;
     bounds_initialized = false;
     bounds = bbox();
-    tree_built = true;
+    tree_built.store(true, std::memory_order_relaxed);
 }
 
-template <class T>
-size_t kdtree<T>::get_size() const {
+template <class T, class Payload>
+size_t kdtree<T, Payload>::get_size() const {
+    // In double-buffered mode, staged entries are not counted until they are published.
+    if(mode == build_mode::double_buffered){
+        const auto v = acquire();
+        return (v.tree == nullptr) ? 0 : v.tree->entries.size();
+    }
+    std::lock_guard<std::mutex> lock(build_mutex);
     return entry_count;
 }
 
-template <class T>
-typename kdtree<T>::bbox kdtree<T>::get_bounds() const {
+template <class T, class Payload>
+typename kdtree<T, Payload>::bbox kdtree<T, Payload>::get_bounds() const {
+    if(mode == build_mode::double_buffered){
+        const auto v = acquire();
+        return ((v.tree == nullptr) || v.tree->entries.empty()) ? bbox() : v.tree->nodes.front().node_bounds;
+    }
+    std::lock_guard<std::mutex> lock(build_mutex);
     return bounds;
 }
 
+template <class T, class Payload>
+bool kdtree<T, Payload>::write_to(std::ostream &os) const {
+    if constexpr (!std::is_trivially_copyable<Payload>::value){
+        return false;
+    }else{
+        using mapped = mapped_index<T, Payload>;
+        const auto v = acquire();
+        const std::vector<entry> none;
+        const auto &entries = (v.tree == nullptr) ? none : v.tree->entries;
+
+        // Renumber the nodes breadth-first so that siblings are adjacent.
+        std::vector<typename mapped::node> flat;
+        if((v.tree != nullptr) && !v.tree->nodes.empty()){
+            const auto &nodes = v.tree->nodes;
+            flat.reserve(nodes.size());
+            std::vector<size_t> source;
+            source.reserve(nodes.size());
+            source.push_back(0);
+            for(size_t i = 0; i < source.size(); ++i){
+                const auto &n = nodes[source[i]];
+                typename mapped::node f;
+                f.min[0] = n.node_bounds.min.x;
+                f.min[1] = n.node_bounds.min.y;
+                f.min[2] = n.node_bounds.min.z;
+                f.max[0] = n.node_bounds.max.x;
+                f.max[1] = n.node_bounds.max.y;
+                f.max[2] = n.node_bounds.max.z;
+                f.begin = n.begin;
+                f.end = n.end;
+                f.first_child = 0;
+                f.child_count = 0;
+                if(n.right != 0){
+                    f.first_child = source.size();
+                    f.child_count = 2;
+                    source.push_back(source[i] + 1);
+                    source.push_back(n.right);
+                }
+                flat.push_back(f);
+            }
+        }
+        return mapped::write(os, mapped_index_kind::kdtree, static_cast<uint32_t>(leaf_size), flat, entries);
+    }
+}
+
+template <class T, class Payload>
+bool kdtree<T, Payload>::read_from(std::istream &is) {
+    if constexpr (!std::is_trivially_copyable<Payload>::value){
+        return false;
+    }else{
+        using mapped = mapped_index<T, Payload>;
+        std::vector<uint64_t> storage;
+        if(!mapped::read(is, storage)) return false;
+
+        auto t = std::make_shared<tree_data>();
+        size_t stored_leaf_size = 0;
+        bbox stored_bounds;
+        try{
+            const mapped m(storage.data(), storage.size() * sizeof(uint64_t));
+            stored_leaf_size = m.get_parameter();
+            if( (m.get_kind() != mapped_index_kind::kdtree)
+            ||  (stored_leaf_size < 1)
+            ||  (kdtree_max_leaf_size < stored_leaf_size) ) return false;
+
+            const size_t N = m.get_size();
+            auto &coords = t->coords;
+            for(auto *c : { &coords.min_x, &coords.min_y, &coords.min_z, &coords.max_x, &coords.max_y, &coords.max_z }){
+                c->reserve(N);
+            }
+            t->entries.reserve(N);
+            for(size_t i = 0; i < N; ++i){
+                t->entries.push_back(m.get_entry(i));
+                const auto &b = t->entries.back().box;
+                coords.min_x.push_back(b.min.x);
+                coords.min_y.push_back(b.min.y);
+                coords.min_z.push_back(b.min.z);
+                coords.max_x.push_back(b.max.x);
+                coords.max_y.push_back(b.max.y);
+                coords.max_z.push_back(b.max.z);
+            }
+
+            // Restore the depth-first node order, where the left child immediately follows its parent.
+            const auto *flat = m.get_nodes();
+            const size_t N_nodes = m.get_node_count();
+            t->nodes.reserve(N_nodes);
+            const auto restore = [&](const auto &self, size_t i) -> bool {
+                const auto &f = flat[i];
+                if( (N_nodes <= t->nodes.size())
+                ||  ((f.child_count != 0) && (f.child_count != 2))
+                ||  ((f.child_count == 0) && (kdtree_max_leaf_size < (f.end - f.begin))) ) return false;
+
+                const size_t node = t->nodes.size();
+                kdtree_node n;
+                n.node_bounds = ordered_bbox(vec3<T>(f.min[0], f.min[1], f.min[2]),
+                                             vec3<T>(f.max[0], f.max[1], f.max[2]));
+                n.begin = f.begin;
+                n.end = f.end;
+                n.right = 0;
+                t->nodes.push_back(n);
+                if(f.child_count == 0) return true;
+                if(!self(self, f.first_child)) return false;
+                t->nodes[node].right = t->nodes.size();
+                return self(self, f.first_child + 1);
+            };
+            if( (0 < N_nodes)
+            &&  (!restore(restore, 0) || (t->nodes.size() != N_nodes)) ) return false;
+            stored_bounds = m.get_bounds();
+
+        }catch(const std::exception &){
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(build_mutex);
+        if(frozen) return false;
+        leaf_size = stored_leaf_size;
+        entry_count = t->entries.size();
+        bounds_initialized = (entry_count != 0);
+        bounds = bounds_initialized ? stored_bounds : bbox();
+        pending_entries.clear();
+        std::atomic_store(&tree, t);
+        tree_built.store(true, std::memory_order_release);
+        return true;
+    }
+}
+
 #ifndef YGOR_INDEX_KDTREE_DISABLE_ALL_SPECIALIZATIONS
-    template class kdtree<float>;
-    template class kdtree<double>;
+    template class kdtree<float , std::any>;
+    template class kdtree<double, std::any>;
+    template class kdtree<float , uint32_t>;
+    template class kdtree<double, uint32_t>;
+    template class kdtree<float , uint64_t>;
+    template class kdtree<double, uint64_t>;
 #endif
@@ -6,9 +6,13 @@
 
 #include <stddef.h>
 #include <any>
+#include <atomic>
 #include <cmath>
+#include <functional>
+#include <iosfwd>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -21,16 +25,20 @@
 //---------------------------- kdtree: kd-tree spatial indexing data structure ----------------------------------------------
 //---------------------------------------------------------------------------------------------------------------------------
 //This class implements a kd-tree for spatial indexing of objects in 3D space.
-// Core construction and axis-cycling behavior follows Bentley's original kd-tree:
+// Core construction follows Bentley's original kd-tree:
 //   Bentley JL. Multidimensional binary search trees used for associative searching.
 //   Communications of the ACM. 1975;18(9):509-517.
-// The kd-tree recursively partitions space by cycling through the x, y, and z axes.
-// At each level, the splitting axis alternates (depth % 3), and the median point
-// along that axis is chosen as the partitioning element.
+// The kd-tree recursively partitions entries at the median of their centres along the
+// axis with the widest spread, stopping when a node holds no more than a small 'bucket'
+// of entries. Bucketing follows Friedman et al. (below).
 //
 // The tree is built by bulk-loading: all points are inserted first, and the tree
 // is constructed via a balanced median-split algorithm. Incremental insertions
-// trigger a rebuild of the tree.
+// trigger a rebuild of the tree. Large subtrees are built concurrently.
+//
+// Nodes are stored contiguously in depth-first order, and entries are stored in leaf
+// order so every leaf refers to a contiguous range. The bounds of the entries are also
+// stored as separate coordinate arrays so leaves can be scanned using vector instructions.
 //
 // The index supports efficient spatial queries such as:
 //  - Range queries (find all objects within a region)
@@ -40,9 +48,21 @@
 //   Friedman JH, Bentley JL, Finkel RA. An algorithm for finding best matches in
 //   logarithmic expected time. ACM Trans Math Softw. 1977;3(3):209-226.
 //
-// Users can optionally associate auxiliary data (via std::any) with each inserted point.
+// Users can optionally associate auxiliary data with each inserted point. By default this is a std::any, but a plain
+// payload type (e.g., a uint32_t id) can be provided as the second template parameter to avoid type erasure.
 // This auxiliary data is not used during spatial queries but can be retrieved after lookups.
 //
+// Thread safety: const member functions can be called concurrently. The first query after
+// an insertion rebuilds the tree, and concurrent queries wait for this rebuild to complete.
+// Calling build() or freeze() beforehand avoids the wait, after which queries acquire no
+// locks. Insertions must not overlap queries or other insertions, unless the tree uses the
+// double-buffered mode. In this mode, insertions (from any thread) are staged and only
+// become visible to queries after build() is called. Queries continue to use the previous
+// tree, without waiting, while a new tree is built.
+//
+// Trees with trivially-copyable payloads can be serialized to a flat binary form that can
+// later be read back without rebuilding, or mmap'd and queried in place via mapped_index.
+//
 // Example usage:
 //        kdtree<double> tree;
 //        
@@ -53,43 +73,105 @@
 //        auto points = tree.search_points(query_box);
 //
 
-template <class T> class kdtree {
+template <class T, class Payload = std::any> class kdtree {
     public:
         using value_type = T;
-        using entry = index_entry<T>;
+        using payload_type = Payload;
+        using entry = index_entry<T, Payload>;
         using bbox = index_bbox<T>;
+
+        // Callbacks for the visitor-style queries. Entries are passed by reference, avoiding copies. Returning false stops
+        // the query early.
+        using visitor = std::function<bool(const entry &)>;
+        using distance_visitor = std::function<bool(const entry &, T)>; // Also receives the squared distance.
+
+        // Callbacks for joins between two trees. They receive an entry from this tree and an entry from the other tree.
+        using pair_visitor = std::function<bool(const entry &, const entry &)>;
+        using pair_distance_visitor = std::function<bool(const entry &, const entry &, T)>; // Also receives the squared distance.
         
+        enum class build_mode {
+            lazy,            // Queries rebuild the tree as needed.
+            double_buffered, // Insertions are staged and only become visible after build().
+        };
+
     private:
+        // Internal nodes are followed immediately by their left child. Leaves have no children (right == 0).
         struct kdtree_node {
-            entry data;
-            int split_axis;  // 0 = x, 1 = y, 2 = z
             bbox node_bounds; // Bounding box of all entries in this subtree.
-            std::unique_ptr<kdtree_node> left;
-            std::unique_ptr<kdtree_node> right;
-            
-            kdtree_node();
-            explicit kdtree_node(const entry &e, int axis);
+            size_t begin;     // The range of entries within this subtree.
+            size_t end;
+            size_t right;     // Index of the right child, or zero for leaves.
         };
-        
-        mutable std::unique_ptr<kdtree_node> root;
-        mutable std::vector<entry> pending_entries;  // All entries backing the index; the kd-tree is (re)built from this collection.
+
+        // Entry bounds in leaf order, stored as separate coordinate arrays.
+        struct leaf_coords {
+            std::vector<T> min_x, min_y, min_z;
+            std::vector<T> max_x, max_y, max_z;
+        };
+
+        // A fully-built tree. Trees are not altered after construction.
+        struct tree_data {
+            std::vector<kdtree_node> nodes;
+            std::vector<entry> entries; // Stored in leaf order.
+            leaf_coords coords;
+        };
+
+        // A tree being queried. In double-buffered mode, the tree is kept alive for the duration of the query.
+        struct tree_view {
+            std::shared_ptr<const tree_data> keep_alive;
+            const tree_data *tree = nullptr;
+        };
+
+        size_t leaf_size;
+        build_mode mode;
+        bool frozen;
+        mutable std::shared_ptr<tree_data> tree;
+        mutable std::vector<entry> pending_entries;  // Entries that have not yet been incorporated into the tree.
         size_t entry_count;
         bbox bounds;
         bool bounds_initialized;
-        mutable bool tree_built;
+        mutable std::atomic<bool> tree_built;
+        mutable std::mutex build_mutex;              // Serializes (re)builds, and insertions in double-buffered mode.
         
-        // Build a balanced kd-tree from a range of entries.
-        std::unique_ptr<kdtree_node> build(std::vector<entry> &entries, size_t begin, size_t end, int depth) const;
+        // The number of nodes needed for a subtree containing the given number of entries.
+        size_t node_count(size_t N) const;
+
+        // Build a balanced subtree from a range of entries, writing nodes starting at the given index.
+        void build_subtree(tree_data &t, std::vector<size_t> &order, const std::vector<vec3<T>> &centres,
+                           size_t node, size_t begin, size_t end, int64_t spawn_depth) const;
+
+        // Build a tree from a collection of entries.
+        std::shared_ptr<tree_data> build_tree(std::vector<entry> entries) const;
         
         // Ensure the tree is built from pending entries.
         void ensure_built() const;
+
+        // Acquire the tree for querying.
+        tree_view acquire() const;
         
-        // Recursively search for entries within a bounding box.
-        void search_recursive(const kdtree_node* node, const bbox &query_box, std::vector<entry> &results) const;
-        
-        // Recursively search for nearest neighbors.
-        void nearest_recursive(const kdtree_node* node, const vec3<T> &query_point, size_t k,
-                               std::vector<std::pair<T, entry>> &best) const;
+        // Compute the squared distances from a point to the entries in a leaf.
+        static void leaf_sq_dists(const tree_data &t, const kdtree_node &leaf, const vec3<T> &point, T *out);
+
+        // Compute the squared distances from a bbox to the entries in a leaf.
+        static void leaf_sq_dists(const tree_data &t, const kdtree_node &leaf, const bbox &box, T *out);
+
+        // Pairs of entry indices found by a join, which are passed to the visitor in batches.
+        using join_batch = std::vector<std::pair<size_t, size_t>>;
+        using join_flush = std::function<bool(join_batch &)>;
+
+        // Recursively find all pairs of entries from two subtrees separated by no more than the given squared distance.
+        // The batch is flushed whenever it fills. Returns false if the join should stop.
+        static bool join_recursive(const tree_data &a, size_t node_a, const tree_data &b, size_t node_b, T max_sq_dist,
+                                   join_batch &batch, const join_flush &flush);
+
+        // Recursively find the k nearest entries in tree b for every entry in a leaf of tree a. A max-heap of (squared
+        // distance, entry index) pairs is maintained for each entry in the leaf.
+        static void join_nearest_recursive(const tree_data &a, const kdtree_node &leaf_a, const tree_data &b, size_t node_b,
+                                           size_t k, std::vector<std::vector<std::pair<T, size_t>>> &best);
+
+        // Recursively search for nearest neighbors. Only entries without spatial extent are considered if requested.
+        static void nearest_recursive(const tree_data &t, size_t node, const vec3<T> &query_point, size_t k,
+                                      bool points_only, std::vector<std::pair<T, size_t>> &best);
         
         // Get the coordinate of a point along a given axis.
         static T get_coord(const vec3<T> &point, int axis);
@@ -104,6 +186,8 @@ template <class T> class kdtree {
     public:
         //--------------------------------------------------- Constructors -------------------------------------------------
         kdtree();
+        explicit kdtree(size_t leaf_size, // Maximum number of entries per leaf. Clamped to [1, 64].
+                        build_mode mode = build_mode::lazy);
         ~kdtree();
         
         // Delete copy constructor and assignment to prevent accidental copying.
@@ -116,13 +200,13 @@ template <class T> class kdtree {
         void insert(const vec3<T> &point);
         
         // Insert a point with auxiliary data into the tree.
-        void insert(const vec3<T> &point, std::any aux_data);
+        void insert(const vec3<T> &point, Payload aux_data);
 
         // Insert a bbox into the tree (without auxiliary data).
         void insert(const bbox &bb);
 
         // Insert a bbox with auxiliary data into the tree.
-        void insert(const bbox &bb, std::any aux_data);
+        void insert(const bbox &bb, Payload aux_data);
         
         // Search for all entries fully or partially within a bounding box.
         std::vector<entry> search(const bbox &query_box) const;
@@ -140,6 +224,15 @@ template <class T> class kdtree {
         
         // Search for all entries fully or partially within a given radius of a center point.
         std::vector<entry> search_radius(const vec3<T> &center, T radius) const;
+
+        // Visit all entries fully or partially within a bounding box.
+        void search(const bbox &query_box, const visitor &f) const;
+
+        // Visit all entries fully or partially within a given radius of a center point.
+        void search_radius(const vec3<T> &center, T radius, const visitor &f) const;
+
+        // Visit the k nearest neighbor entries to a query point, in order of increasing distance.
+        void nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const;
         
         // Search for all points within a given radius of a center point (returns points only).
         // This function will only return bboxes that represent a single point (i.e., no spatial extent),
@@ -154,20 +247,63 @@ template <class T> class kdtree {
         // disregarding bboxes with a volume.
         std::vector<vec3<T>> nearest_neighbors_points(const vec3<T> &query_point, size_t k) const;
         
+        // Visit all pairs of entries, one from this tree and one from the other tree, separated by no more than the given
+        // distance. For entries with a spatial extent, the distance between their bboxes is used.
+        //
+        // Both trees are traversed simultaneously, so pairs of subtrees that are too far apart are skipped altogether.
+        // Large joins are split over multiple threads, but the visitor is never invoked concurrently. Pairs are visited
+        // in no particular order. The other tree can be this tree, in which case every entry is paired with itself.
+        void join_within_distance(const kdtree &other, T distance, const pair_visitor &f) const;
+
+        // For every entry in this tree, visit the k nearest entries in the other tree, in order of increasing distance.
+        //
+        // Queries are processed a leaf at a time, sharing a single traversal of the other tree. Large joins are split
+        // over multiple threads, but the visitor is never invoked concurrently. The neighbors of each entry are visited
+        // consecutively, but entries are visited in no particular order.
+        void join_nearest_neighbors(const kdtree &other, size_t k, const pair_distance_visitor &f) const;
+        
         // Check if the tree contains a specific point.
         bool contains(const vec3<T> &point) const;
 
         // Check if the tree contains a specific bbox.
         bool contains(const bbox &bb) const;
         
+        // Build the tree now, incorporating all prior insertions. In double-buffered mode, this publishes the new tree
+        // once complete; queries issued in the meantime use the previous tree.
+        void build();
+
+        // Build the tree and forbid further modification, so all subsequent queries are lock-free.
+        void freeze();
+
+        // Permit modification of a frozen tree.
+        void thaw();
+
+        // Check whether the tree is frozen.
+        bool is_frozen() const;
+
         // Remove all entries from the tree.
         void clear();
         
-        // Get the number of entries in the tree.
+        // Get the number of entries in the tree. In double-buffered mode, this is the number in the tree seen by
+        // queries, so staged entries are only counted once build() has published them.
         size_t get_size() const;
         
-        // Get the bounding box of all entries in the tree.
+        // Get the bounding box of all entries in the tree. In double-buffered mode, only published entries are included.
         bbox get_bounds() const;
+
+        // Write the tree, as currently seen by queries, to a binary stream in the flat form described in
+        // YgorIndexMapped.h.
+        //
+        // Returns false if the payload type is not trivially copyable (e.g., std::any) or if the stream enters a fail
+        // state.
+        bool write_to(std::ostream &os) const;
+
+        // Replace the contents of the tree with a tree previously written by write_to(). The tree is restored exactly,
+        // including the leaf size, without being rebuilt.
+        //
+        // Returns false, leaving the tree unaltered, if the payload type is not trivially copyable, the tree is frozen,
+        // or the stream does not contain a valid serialized kdtree of the same coordinate and payload types.
+        bool read_from(std::istream &is);
 };
 
 #endif // YGOR_INDEX_KDTREE_H_
@@ -0,0 +1,576 @@
+//YgorIndexLinearOctree.cc.
+
+#include <algorithm>
+#include <any>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorMath.h"
+#include "YgorIndex.h"
+#include "YgorIndexLinearOctree.h"
+
+//#ifndef YGOR_INDEX_LINEAR_OCTREE_DISABLE_ALL_SPECIALIZATIONS
+//    #define YGOR_INDEX_LINEAR_OCTREE_DISABLE_ALL_SPECIALIZATIONS
+//#endif
+
+//---------------------------------------------------------------------------------------------------------------------------
+//------------------------- linear_octree: Morton-ordered octree stored in flat arrays --------------------------------------
+//---------------------------------------------------------------------------------------------------------------------------
+
+//------------------------------------------------------ Private helpers ----------------------------------------------------
+
+namespace {
+    // Inputs with fewer entries are not worth splitting across threads.
+    constexpr size_t linear_octree_parallel_threshold = 50'000;
+
+    // Invoke f(begin, end) over contiguous chunks of [0, N), one per hardware thread.
+    template <class F>
+    void linear_octree_parallel_for(size_t N, F f){
+        const size_t N_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        if((N < linear_octree_parallel_threshold) || (N_threads == 1)){
+            f(static_cast<size_t>(0), N);
+            return;
+        }
+        const size_t chunk = (N + N_threads - 1) / N_threads;
+        std::vector<std::future<void>> futs;
+        for(size_t begin = 0; begin < N; begin += chunk){
+            const size_t end = std::min(N, begin + chunk);
+            futs.emplace_back(std::async(std::launch::async, [begin,end,&f](){ f(begin, end); }));
+        }
+        for(auto &fut : futs) fut.get();
+        return;
+    }
+
+    // Spread the lower 21 bits of x so there are two zero bits between each.
+    uint64_t spread_bits(uint64_t x){
+        x &= 0x1FFFFFULL;
+        x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+        x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+        x = (x | (x <<  8)) & 0x100F00F00F00F00FULL;
+        x = (x | (x <<  4)) & 0x10C30C30C30C30C3ULL;
+        x = (x | (x <<  2)) & 0x1249249249249249ULL;
+        return x;
+    }
+
+    // Plain comparisons are exact for finite coordinates, so these are equivalent to the index_bbox members but are
+    // considerably cheaper on the hot paths.
+    template <class T>
+    T fast_sq_dist(const vec3<T> &p, const index_bbox<T> &b){
+        const T zero = static_cast<T>(0);
+        const T dx = std::max(std::max(b.min.x - p.x, p.x - b.max.x), zero);
+        const T dy = std::max(std::max(b.min.y - p.y, p.y - b.max.y), zero);
+        const T dz = std::max(std::max(b.min.z - p.z, p.z - b.max.z), zero);
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    template <class T>
+    bool fast_intersects(const index_bbox<T> &a, const index_bbox<T> &b){
+        return (a.min.x <= b.max.x) && (b.min.x <= a.max.x)
+            && (a.min.y <= b.max.y) && (b.min.y <= a.max.y)
+            && (a.min.z <= b.max.z) && (b.min.z <= a.max.z);
+    }
+
+    template <class T>
+    bool fast_contains(const index_bbox<T> &outer, const index_bbox<T> &inner){
+        return (outer.min.x <= inner.min.x) && (inner.max.x <= outer.max.x)
+            && (outer.min.y <= inner.min.y) && (inner.max.y <= outer.max.y)
+            && (outer.min.z <= inner.min.z) && (inner.max.z <= outer.max.z);
+    }
+
+    template <class T>
+    void fast_expand(index_bbox<T> &a, const index_bbox<T> &b){
+        a.min.x = std::min(a.min.x, b.min.x); a.max.x = std::max(a.max.x, b.max.x);
+        a.min.y = std::min(a.min.y, b.min.y); a.max.y = std::max(a.max.y, b.max.y);
+        a.min.z = std::min(a.min.z, b.min.z); a.max.z = std::max(a.max.z, b.max.z);
+    }
+
+    template <class T>
+    bool has_no_extent(const index_bbox<T> &b){
+        return (b.min.x == b.max.x) && (b.min.y == b.max.y) && (b.min.z == b.max.z);
+    }
+
+} // namespace
+
+template <class T, class Payload>
+bool linear_octree<T, Payload>::linear_octree_node::is_leaf() const {
+    return (this->child_count == 0);
+}
+
+template <class T, class Payload>
+uint64_t linear_octree<T, Payload>::morton_key(const vec3<T> &point) const {
+    const T max_cell = static_cast<T>((static_cast<uint32_t>(1) << key_bits) - 1);
+    const auto quantize = [&](T x, T x_origin) -> uint64_t {
+        const T q = std::clamp((x - x_origin) * this->scale, static_cast<T>(0), max_cell);
+        return static_cast<uint64_t>(q);
+    };
+    return (spread_bits(quantize(point.x, origin.x)) << 2)
+         | (spread_bits(quantize(point.y, origin.y)) << 1)
+         |  spread_bits(quantize(point.z, origin.z));
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::sort_centres(const std::vector<vec3<T>> &centres) {
+    const size_t N = centres.size();
+
+    // Use a cubic grid so octree cells remain cubic.
+    vec3<T> lo = centres.front();
+    vec3<T> hi = centres.front();
+    for(const auto &c : centres){
+        lo.x = std::min(lo.x, c.x); hi.x = std::max(hi.x, c.x);
+        lo.y = std::min(lo.y, c.y); hi.y = std::max(hi.y, c.y);
+        lo.z = std::min(lo.z, c.z); hi.z = std::max(hi.z, c.z);
+    }
+    const T extent = std::max({ hi.x - lo.x, hi.y - lo.y, hi.z - lo.z });
+    const T max_cell = static_cast<T>((static_cast<uint32_t>(1) << key_bits) - 1);
+    this->origin = lo;
+    this->scale = (static_cast<T>(0) < extent) ? (max_cell / extent) : static_cast<T>(0);
+    if(!std::isfinite(this->scale)) this->scale = static_cast<T>(0);
+
+    this->keys.resize(N);
+    this->order.resize(N);
+    linear_octree_parallel_for(N, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i){
+            this->keys[i] = this->morton_key(centres[i]);
+            this->order[i] = static_cast<uint32_t>(i);
+        }
+    });
+    this->radix_sort();
+    return;
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::radix_sort() {
+    const size_t N = this->keys.size();
+    this->scratch_keys.resize(N);
+    this->scratch_order.resize(N);
+
+    constexpr int digit_bits = 8;
+    constexpr size_t N_buckets = static_cast<size_t>(1) << digit_bits;
+    constexpr int total_bits = 3 * key_bits;
+
+    // The input is split into one chunk per thread. Each chunk is histogrammed and scattered independently, with the
+    // output offsets arranged so the sort remains stable.
+    const size_t N_threads = ((N < linear_octree_parallel_threshold) ? 1
+                                                                     : std::max<size_t>(1, std::thread::hardware_concurrency()));
+    const size_t chunk = (N + N_threads - 1) / N_threads;
+    const size_t N_chunks = (N == 0) ? 0 : (N + chunk - 1) / chunk;
+    std::vector<std::array<size_t, N_buckets>> counts(N_chunks);
+
+    const auto for_each_chunk = [&](auto f){
+        if(N_chunks <= 1){
+            if(N_chunks == 1) f(static_cast<size_t>(0));
+            return;
+        }
+        std::vector<std::future<void>> futs;
+        for(size_t c = 0; c < N_chunks; ++c){
+            futs.emplace_back(std::async(std::launch::async, [c,&f](){ f(c); }));
+        }
+        for(auto &fut : futs) fut.get();
+    };
+
+    for(int shift = 0; shift < total_bits; shift += digit_bits){
+        for_each_chunk([&](size_t c){
+            auto &cnt = counts[c];
+            cnt.fill(0);
+            const size_t end = std::min(N, (c + 1) * chunk);
+            for(size_t i = c * chunk; i < end; ++i){
+                ++cnt[(this->keys[i] >> shift) & (N_buckets - 1)];
+            }
+        });
+
+        // Skip passes where every key shares the same digit.
+        bool trivial = false;
+        for(size_t d = 0; d < N_buckets; ++d){
+            size_t total = 0;
+            for(const auto &cnt : counts) total += cnt[d];
+            if(total == N){
+                trivial = true;
+                break;
+            }
+            if(total != 0) break;
+        }
+        if(trivial) continue;
+
+        // Convert the counts into output offsets.
+        size_t offset = 0;
+        for(size_t d = 0; d < N_buckets; ++d){
+            for(auto &cnt : counts){
+                const size_t n = cnt[d];
+                cnt[d] = offset;
+                offset += n;
+            }
+        }
+
+        for_each_chunk([&](size_t c){
+            auto &pos = counts[c];
+            const size_t end = std::min(N, (c + 1) * chunk);
+            for(size_t i = c * chunk; i < end; ++i){
+                const size_t j = pos[(this->keys[i] >> shift) & (N_buckets - 1)]++;
+                this->scratch_keys[j] = this->keys[i];
+                this->scratch_order[j] = this->order[i];
+            }
+        });
+        this->keys.swap(this->scratch_keys);
+        this->order.swap(this->scratch_order);
+    }
+    return;
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::build_nodes() {
+    this->nodes.clear();
+    const size_t N = this->entries.size();
+    if(N == 0) return;
+
+    // Split nodes breadth-first. Entries in each child form a contiguous run of keys sharing the child's prefix.
+    linear_octree_node root_node;
+    root_node.key = 0;
+    root_node.begin = 0;
+    root_node.end = static_cast<uint32_t>(N);
+    root_node.first_child = 0;
+    root_node.child_count = 0;
+    root_node.level = 0;
+    this->nodes.push_back(root_node);
+
+    for(size_t i = 0; i < this->nodes.size(); ++i){
+        const auto n = this->nodes[i];
+        if( ((n.end - n.begin) <= this->max_leaf_size)
+        ||  (n.level == key_bits) ) continue;
+
+        const int shift = 3 * (key_bits - 1 - static_cast<int>(n.level));
+        const auto first_child = static_cast<uint32_t>(this->nodes.size());
+        uint8_t child_count = 0;
+        for(uint32_t b = n.begin; b < n.end; ){
+            const uint64_t prefix = this->keys[b] >> shift;
+            const uint64_t prefix_end = (prefix + 1) << shift;
+            const auto e = static_cast<uint32_t>(std::lower_bound(this->keys.begin() + b, this->keys.begin() + n.end, prefix_end)
+                                                 - this->keys.begin());
+            linear_octree_node child;
+            child.key = prefix << shift;
+            child.begin = b;
+            child.end = e;
+            child.first_child = 0;
+            child.child_count = 0;
+            child.level = static_cast<uint8_t>(n.level + 1);
+            this->nodes.push_back(child);
+            ++child_count;
+            b = e;
+        }
+        this->nodes[i].first_child = first_child;
+        this->nodes[i].child_count = child_count;
+    }
+
+    // Compute bounds bottom-up. Children always follow their parent, so leaves can be handled concurrently and then
+    // internal nodes in reverse order.
+    linear_octree_parallel_for(this->nodes.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i){
+            auto &n = this->nodes[i];
+            if(!n.is_leaf()) continue;
+            n.bounds = this->entries[n.begin].box;
+            for(size_t j = n.begin + 1; j < n.end; ++j) fast_expand(n.bounds, this->entries[j].box);
+        }
+    });
+    for(size_t i = this->nodes.size(); 0 < i; --i){
+        auto &n = this->nodes[i - 1];
+        if(n.is_leaf()) continue;
+        n.bounds = this->nodes[n.first_child].bounds;
+        for(size_t c = 1; c < n.child_count; ++c) fast_expand(n.bounds, this->nodes[n.first_child + c].bounds);
+    }
+    return;
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::nearest_recursive(size_t node, const vec3<T> &query_point, size_t k, bool points_only,
+                                                  std::vector<std::pair<T, size_t>> &best) const {
+    const auto cmp = [](const std::pair<T, size_t> &a, const std::pair<T, size_t> &b){ return a.first < b.first; };
+    const auto &n = this->nodes[node];
+
+    if(n.is_leaf()){
+        for(size_t i = n.begin; i < n.end; ++i){
+            const auto &box = this->entries[i].box;
+            if(points_only && !has_no_extent(box)) continue;
+
+            const T dist_sq = fast_sq_dist(query_point, box);
+            if(best.size() < k){
+                best.emplace_back(dist_sq, i);
+                std::push_heap(best.begin(), best.end(), cmp);
+            }else if(dist_sq < best.front().first){
+                std::pop_heap(best.begin(), best.end(), cmp);
+                best.back() = std::make_pair(dist_sq, i);
+                std::push_heap(best.begin(), best.end(), cmp);
+            }
+        }
+        return;
+    }
+
+    // Visit nearer children first.
+    std::array<std::pair<T, size_t>, 8> children;
+    for(size_t c = 0; c < n.child_count; ++c){
+        const size_t child = n.first_child + c;
+        children[c] = std::make_pair(fast_sq_dist(query_point, this->nodes[child].bounds), child);
+    }
+    std::sort(children.begin(), children.begin() + n.child_count, cmp);
+    for(size_t c = 0; c < n.child_count; ++c){
+        if( (k <= best.size()) && !(children[c].first < best.front().first) ) break;
+        this->nearest_recursive(children[c].second, query_point, k, points_only, best);
+    }
+    return;
+}
+
+//------------------------------------------------------ Constructors -------------------------------------------------------
+
+template <class T, class Payload>
+linear_octree<T, Payload>::linear_octree(size_t max_leaf_size)
+  : max_leaf_size(std::max<size_t>(1, max_leaf_size)), origin(vec3<T>(0, 0, 0)), scale(static_cast<T>(0)) { }
+
+//------------------------------------------------------ Member functions ---------------------------------------------------
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::build(std::vector<entry> unsorted) {
+    for(const auto &e : unsorted){
+        if(!e.box.isfinite()){
+            throw std::invalid_argument("Cannot insert non-finite bbox into linear_octree");
+        }
+    }
+    if(static_cast<size_t>(std::numeric_limits<uint32_t>::max()) <= unsorted.size()){
+        throw std::invalid_argument("Too many entries for linear_octree");
+    }
+
+    this->clear();
+    const size_t N = unsorted.size();
+    if(N == 0) return;
+
+    this->scratch_centres.resize(N);
+    for(size_t i = 0; i < N; ++i){
+        const auto &b = unsorted[i].box;
+        this->scratch_centres[i] = vec3<T>((b.min.x + b.max.x) / static_cast<T>(2),
+                                           (b.min.y + b.max.y) / static_cast<T>(2),
+                                           (b.min.z + b.max.z) / static_cast<T>(2));
+    }
+    this->sort_centres(this->scratch_centres);
+
+    this->entries.resize(N);
+    linear_octree_parallel_for(N, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i) this->entries[i] = std::move(unsorted[this->order[i]]);
+    });
+    this->build_nodes();
+    return;
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::build(const std::vector<vec3<T>> &points) {
+    for(const auto &p : points){
+        if(!p.isfinite()){
+            throw std::invalid_argument("Cannot insert non-finite point into linear_octree");
+        }
+    }
+    if(static_cast<size_t>(std::numeric_limits<uint32_t>::max()) <= points.size()){
+        throw std::invalid_argument("Too many entries for linear_octree");
+    }
+
+    this->clear();
+    const size_t N = points.size();
+    if(N == 0) return;
+
+    this->sort_centres(points);
+
+    this->entries.resize(N);
+    linear_octree_parallel_for(N, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i){
+            const auto j = this->order[i];
+            auto &e = this->entries[i];
+            e.box.min = points[j];
+            e.box.max = points[j];
+            if constexpr (std::is_integral_v<Payload>){
+                e.aux_data = static_cast<Payload>(j);
+            }else{
+                e.aux_data = Payload{};
+            }
+        }
+    });
+    this->build_nodes();
+    return;
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::clear() {
+    this->nodes.clear();
+    this->entries.clear();
+    this->keys.clear();
+    return;
+}
+
+template <class T, class Payload>
+size_t linear_octree<T, Payload>::get_size() const {
+    return this->entries.size();
+}
+
+template <class T, class Payload>
+typename linear_octree<T, Payload>::bbox linear_octree<T, Payload>::get_bounds() const {
+    if(this->nodes.empty()) return bbox();
+    return this->nodes.front().bounds;
+}
+
+template <class T, class Payload>
+const std::vector<typename linear_octree<T, Payload>::linear_octree_node> &
+linear_octree<T, Payload>::get_nodes() const {
+    return this->nodes;
+}
+
+template <class T, class Payload>
+const std::vector<typename linear_octree<T, Payload>::entry> &
+linear_octree<T, Payload>::get_entries() const {
+    return this->entries;
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::search(const bbox &query_box, const visitor &f) const {
+    if(this->nodes.empty()) return;
+
+    std::vector<uint32_t> stack;
+    stack.reserve(8 * key_bits);
+    stack.push_back(0);
+    while(!stack.empty()){
+        const auto &n = this->nodes[stack.back()];
+        stack.pop_back();
+        if(!fast_intersects(n.bounds, query_box)) continue;
+
+        if(fast_contains(query_box, n.bounds)){
+            for(size_t i = n.begin; i < n.end; ++i){
+                if(!f(this->entries[i])) return;
+            }
+        }else if(n.is_leaf()){
+            for(size_t i = n.begin; i < n.end; ++i){
+                const auto &e = this->entries[i];
+                if(fast_intersects(e.box, query_box) && !f(e)) return;
+            }
+        }else{
+            for(size_t c = n.child_count; 0 < c; --c) stack.push_back(n.first_child + static_cast<uint32_t>(c - 1));
+        }
+    }
+    return;
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::search_radius(const vec3<T> &center, T radius, const visitor &f) const {
+    if(this->nodes.empty() || !(static_cast<T>(0) <= radius)) return;
+    const T radius_sq = radius * radius;
+
+    std::vector<uint32_t> stack;
+    stack.reserve(8 * key_bits);
+    stack.push_back(0);
+    while(!stack.empty()){
+        const auto &n = this->nodes[stack.back()];
+        stack.pop_back();
+        if(radius_sq < fast_sq_dist(center, n.bounds)) continue;
+
+        if(n.is_leaf()){
+            for(size_t i = n.begin; i < n.end; ++i){
+                const auto &e = this->entries[i];
+                if((fast_sq_dist(center, e.box) <= radius_sq) && !f(e)) return;
+            }
+        }else{
+            for(size_t c = n.child_count; 0 < c; --c) stack.push_back(n.first_child + static_cast<uint32_t>(c - 1));
+        }
+    }
+    return;
+}
+
+template <class T, class Payload>
+void linear_octree<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const {
+    if(this->nodes.empty() || (k == 0)) return;
+
+    std::vector<std::pair<T, size_t>> best;
+    best.reserve(std::min(k, this->entries.size()));
+    this->nearest_recursive(0, query_point, k, false, best);
+    std::sort_heap(best.begin(), best.end(),
+                   [](const std::pair<T, size_t> &a, const std::pair<T, size_t> &b){ return a.first < b.first; });
+    for(const auto &p : best){
+        if(!f(this->entries[p.second], p.first)) return;
+    }
+    return;
+}
+
+template <class T, class Payload>
+std::vector<typename linear_octree<T, Payload>::entry> linear_octree<T, Payload>::search(const bbox &query_box) const {
+    std::vector<entry> results;
+    this->search(query_box, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+std::vector<vec3<T>> linear_octree<T, Payload>::search_points(const bbox &query_box) const {
+    std::vector<vec3<T>> results;
+    this->search(query_box, [&](const entry &e){
+        if(has_no_extent(e.box)) results.push_back(e.box.min);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+std::vector<typename linear_octree<T, Payload>::entry>
+linear_octree<T, Payload>::search_radius(const vec3<T> &center, T radius) const {
+    std::vector<entry> results;
+    this->search_radius(center, radius, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+std::vector<vec3<T>> linear_octree<T, Payload>::search_radius_points(const vec3<T> &center, T radius) const {
+    std::vector<vec3<T>> results;
+    this->search_radius(center, radius, [&](const entry &e){
+        if(has_no_extent(e.box)) results.push_back(e.box.min);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+std::vector<typename linear_octree<T, Payload>::entry>
+linear_octree<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
+    std::vector<entry> results;
+    this->nearest_neighbors(query_point, k, [&](const entry &e, T){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+std::vector<vec3<T>> linear_octree<T, Payload>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
+    std::vector<vec3<T>> results;
+    if(this->nodes.empty() || (k == 0)) return results;
+
+    std::vector<std::pair<T, size_t>> best;
+    this->nearest_recursive(0, query_point, k, true, best);
+    std::sort_heap(best.begin(), best.end(),
+                   [](const std::pair<T, size_t> &a, const std::pair<T, size_t> &b){ return a.first < b.first; });
+    results.reserve(best.size());
+    for(const auto &p : best) results.push_back(this->entries[p.second].box.min);
+    return results;
+}
+
+#ifndef YGOR_INDEX_LINEAR_OCTREE_DISABLE_ALL_SPECIALIZATIONS
+    template class linear_octree<float , std::any>;
+    template class linear_octree<double, std::any>;
+    template class linear_octree<float , uint32_t>;
+    template class linear_octree<double, uint32_t>;
+    template class linear_octree<float , uint64_t>;
+    template class linear_octree<double, uint64_t>;
+#endif
@@ -0,0 +1,166 @@
+//YgorIndexLinearOctree.h
+
+#pragma once
+#ifndef YGOR_INDEX_LINEAR_OCTREE_H_
+#define YGOR_INDEX_LINEAR_OCTREE_H_
+
+#include <stddef.h>
+#include <any>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorMath.h"
+#include "YgorIndex.h"
+
+
+//---------------------------------------------------------------------------------------------------------------------------
+//------------------------- linear_octree: Morton-ordered octree stored in flat arrays --------------------------------------
+//---------------------------------------------------------------------------------------------------------------------------
+//This class implements a linear octree for spatial indexing of (mostly) point data in 3D space.
+//
+// Rather than linking nodes with pointers, entries are encoded as 63-bit Morton (Z-order) keys by quantizing their
+// centres onto a 2^21 grid spanning the data. Entries are sorted by key using a parallel radix sort, so every octree
+// cell corresponds to a contiguous range of entries. Nodes are then stored in a single flat array in breadth-first order,
+// with the children of each node stored contiguously.
+//
+// Compared with the pointer-based octree, construction is considerably faster and can make use of multiple threads,
+// and queries have much better locality. Entries with a spatial extent are supported (they are keyed by their centre and
+// node bounds enclose the full extent), but the index works best for points.
+//
+// The index is static: there is no incremental insertion. Instead, the whole index is rebuilt, which is cheap enough to
+// do every frame for dynamic point sets. Storage is reused between rebuilds.
+//
+// Queries are const and can be issued from multiple threads simultaneously, but not concurrently with build() or
+// clear().
+//
+// Example usage:
+//        linear_octree<double, uint32_t> tree;
+//        tree.build(points); // Payloads are the index of each point.
+//
+//        auto nearby = tree.search_radius(vec3<double>(1.0, 2.0, 3.0), 5.0);
+//        tree.nearest_neighbors(q, 10, [](const auto &e, double sq_dist){ ...; return true; });
+//
+
+template <class T, class Payload = std::any> class linear_octree {
+    public:
+        using value_type = T;
+        using payload_type = Payload;
+        using entry = index_entry<T, Payload>;
+        using bbox = index_bbox<T>;
+
+        // Callbacks for the visitor-style queries. Entries are passed by reference, avoiding copies. Returning false stops
+        // the query early.
+        using visitor = std::function<bool(const entry &)>;
+        using distance_visitor = std::function<bool(const entry &, T)>; // Also receives the squared distance.
+
+        // A node in the flattened octree.
+        struct linear_octree_node {
+            bbox bounds;          // Tight bounds of all entries in this subtree.
+            uint64_t key;         // Morton key prefix shared by all entries in this subtree.
+            uint32_t begin;       // The range of (sorted) entries within this subtree.
+            uint32_t end;
+            uint32_t first_child; // Index of the first child. Zero for leaves.
+            uint8_t child_count;  // Number of (non-empty) children. Zero for leaves.
+            uint8_t level;        // Depth of the node. The root is at level 0.
+
+            bool is_leaf() const;
+        };
+
+        // Morton keys use this many bits per axis, and this is also the maximum depth of the tree.
+        static constexpr int key_bits = 21;
+
+    private:
+        std::vector<linear_octree_node> nodes;
+        std::vector<entry> entries;     // Sorted by Morton key.
+        std::vector<uint64_t> keys;     // The Morton key of each (sorted) entry.
+
+        // Scratch storage reused between builds.
+        std::vector<vec3<T>> scratch_centres;
+        std::vector<uint64_t> scratch_keys;
+        std::vector<uint32_t> order;    // The original index of each sorted entry.
+        std::vector<uint32_t> scratch_order;
+
+        size_t max_leaf_size;
+        vec3<T> origin;                 // The minimum corner of the quantization grid.
+        T scale;                        // Grid cells per unit length.
+
+        // Compute the quantization grid and Morton keys for the given entry centres, then sort them. Afterward, 'keys'
+        // holds the sorted keys and 'order' holds the corresponding permutation.
+        void sort_centres(const std::vector<vec3<T>> &centres);
+
+        // Sort the keys, and the permutation, in-place using a parallel least-significant-digit radix sort.
+        void radix_sort();
+
+        // Build the nodes from the sorted keys and entries.
+        void build_nodes();
+
+        // Recursively find the k nearest entries, maintaining a max-heap of (squared distance, entry index) pairs.
+        void nearest_recursive(size_t node, const vec3<T> &query_point, size_t k, bool points_only,
+                               std::vector<std::pair<T, size_t>> &best) const;
+
+    public:
+        //--------------------------------------------------- Constructors -------------------------------------------------
+        explicit linear_octree(size_t max_leaf_size = 16);
+
+        //--------------------------------------------------- Member functions ---------------------------------------------
+
+        // Discard any existing contents and index the given entries.
+        void build(std::vector<entry> entries);
+
+        // Discard any existing contents and index the given points. Payloads are default-constructed, except for
+        // integral payload types which are assigned the index of the corresponding point.
+        void build(const std::vector<vec3<T>> &points);
+
+        // Remove all entries and nodes. Storage is retained for later rebuilds.
+        void clear();
+
+        // Get the number of entries indexed.
+        size_t get_size() const;
+
+        // Get the bounding box of all entries.
+        bbox get_bounds() const;
+
+        // Get the flattened nodes, root first. Empty if no entries are indexed.
+        const std::vector<linear_octree_node> & get_nodes() const;
+
+        // Get the entries, in Morton order.
+        const std::vector<entry> & get_entries() const;
+
+        // Compute the Morton key of a point. Only meaningful for points within the bounds of the indexed entries.
+        uint64_t morton_key(const vec3<T> &point) const;
+
+        // Search for all entries fully or partially within a bounding box.
+        std::vector<entry> search(const bbox &query_box) const;
+
+        // Search for all points within a bounding box (returns points only, no aux data).
+        // This function will only return bboxes that represent a single point (i.e., no spatial extent),
+        // disregarding bboxes with a volume.
+        std::vector<vec3<T>> search_points(const bbox &query_box) const;
+
+        // Search for all entries fully or partially within a given radius of a center point.
+        std::vector<entry> search_radius(const vec3<T> &center, T radius) const;
+
+        // Search for all points within a given radius of a center point (returns points only).
+        std::vector<vec3<T>> search_radius_points(const vec3<T> &center, T radius) const;
+
+        // Find the k nearest neighbor entries to a query point, in order of increasing distance.
+        std::vector<entry> nearest_neighbors(const vec3<T> &query_point, size_t k) const;
+
+        // Find the k nearest neighbor points to a query point (returns points only).
+        std::vector<vec3<T>> nearest_neighbors_points(const vec3<T> &query_point, size_t k) const;
+
+        // Visit all entries fully or partially within a bounding box.
+        void search(const bbox &query_box, const visitor &f) const;
+
+        // Visit all entries fully or partially within a given radius of a center point.
+        void search_radius(const vec3<T> &center, T radius, const visitor &f) const;
+
+        // Visit the k nearest neighbor entries to a query point, in order of increasing distance.
+        void nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const;
+};
+
+#endif // YGOR_INDEX_LINEAR_OCTREE_H_
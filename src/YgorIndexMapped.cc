@@ -0,0 +1,495 @@
+//YgorIndexMapped.cc.
+
+#include <algorithm>
+#include <any>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorMath.h"
+#include "YgorIndex.h"
+#include "YgorIndexMapped.h"
+
+//#ifndef YGOR_INDEX_MAPPED_DISABLE_ALL_SPECIALIZATIONS
+//    #define YGOR_INDEX_MAPPED_DISABLE_ALL_SPECIALIZATIONS
+//#endif
+
+//---------------------------------------------------------------------------------------------------------------------------
+//------------------------- mapped_index: serialized spatial indices that can be queried in place ---------------------------
+//---------------------------------------------------------------------------------------------------------------------------
+
+//------------------------------------------------------ Private helpers ----------------------------------------------------
+
+namespace {
+    constexpr char mapped_index_magic[8] = { 'Y', 'G', 'O', 'R', 'I', 'D', 'X', '\0' };
+    constexpr uint32_t mapped_index_byte_order = 0x01020304;
+
+    // Counts beyond this are certainly corrupt, and rejecting them up front avoids overflow when computing offsets.
+    constexpr uint64_t mapped_index_max_count = static_cast<uint64_t>(1) << 48;
+
+    static_assert(sizeof(mapped_index_header) == 64, "The header layout must not depend on the platform");
+
+    uint64_t align8(uint64_t offset){
+        return (offset + 7) & ~static_cast<uint64_t>(7);
+    }
+
+    // Byte offsets of each section, relative to the start of the buffer.
+    struct mapped_layout {
+        uint64_t nodes;
+        uint64_t coords[6];
+        uint64_t payloads;
+        uint64_t end;
+    };
+
+    template <class T, class Payload>
+    bool compute_layout(uint64_t N_nodes, uint64_t N_entries, mapped_layout &l){
+        if( (mapped_index_max_count < N_nodes)
+        ||  (mapped_index_max_count < N_entries) ) return false;
+
+        uint64_t offset = sizeof(mapped_index_header);
+        l.nodes = offset;
+        offset = align8(offset + N_nodes * sizeof(mapped_index_node<T>));
+        for(auto &c : l.coords){
+            c = offset;
+            offset = align8(offset + N_entries * sizeof(T));
+        }
+        l.payloads = offset;
+        l.end = align8(offset + N_entries * sizeof(Payload));
+        return true;
+    }
+
+    uint64_t rotl64(uint64_t x, int r){
+        return (x << r) | (x >> (64 - r));
+    }
+
+    // Mixing constants and rounds follow xxHash64.
+    constexpr uint64_t checksum_p1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t checksum_p2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t checksum_p3 = 0x165667B19E3779F9ULL;
+
+    uint64_t checksum_round(uint64_t acc, uint64_t word){
+        return rotl64(acc + word * checksum_p2, 31) * checksum_p1;
+    }
+
+    uint64_t load_word(const unsigned char *p){
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        return w;
+    }
+
+    template <class T>
+    bool node_intersects(const mapped_index_node<T> &n, const index_bbox<T> &b){
+        return (n.min[0] <= b.max.x) && (b.min.x <= n.max[0])
+            && (n.min[1] <= b.max.y) && (b.min.y <= n.max[1])
+            && (n.min[2] <= b.max.z) && (b.min.z <= n.max[2]);
+    }
+
+    template <class T>
+    bool node_within(const mapped_index_node<T> &n, const index_bbox<T> &b){
+        return (b.min.x <= n.min[0]) && (n.max[0] <= b.max.x)
+            && (b.min.y <= n.min[1]) && (n.max[1] <= b.max.y)
+            && (b.min.z <= n.min[2]) && (n.max[2] <= b.max.z);
+    }
+
+    template <class T>
+    T node_sq_dist(const mapped_index_node<T> &n, const vec3<T> &p){
+        const T zero = static_cast<T>(0);
+        const T dx = std::max(std::max(n.min[0] - p.x, p.x - n.max[0]), zero);
+        const T dy = std::max(std::max(n.min[1] - p.y, p.y - n.max[1]), zero);
+        const T dz = std::max(std::max(n.min[2] - p.z, p.z - n.max[2]), zero);
+        return dx * dx + dy * dy + dz * dz;
+    }
+}
+
+uint64_t mapped_index_checksum(const void *data, size_t size){
+    const auto *p = static_cast<const unsigned char *>(data);
+    const auto *end = p + size;
+
+    // Four independent lanes keep the multipliers busy.
+    uint64_t h;
+    if(32 <= size){
+        uint64_t v1 = checksum_p1 + checksum_p2;
+        uint64_t v2 = checksum_p2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - checksum_p1;
+        for( ; (p + 32) <= end; p += 32){
+            v1 = checksum_round(v1, load_word(p));
+            v2 = checksum_round(v2, load_word(p + 8));
+            v3 = checksum_round(v3, load_word(p + 16));
+            v4 = checksum_round(v4, load_word(p + 24));
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        for(const auto v : { v1, v2, v3, v4 }){
+            h = (h ^ checksum_round(0, v)) * checksum_p1 + checksum_p3;
+        }
+    }else{
+        h = checksum_p3;
+    }
+    h += static_cast<uint64_t>(size);
+
+    for( ; (p + 8) <= end; p += 8){
+        h = rotl64(h ^ checksum_round(0, load_word(p)), 27) * checksum_p1 + checksum_p3;
+    }
+    for( ; p < end; ++p){
+        h = rotl64(h ^ (static_cast<uint64_t>(*p) * checksum_p3), 11) * checksum_p1;
+    }
+
+    // Final avalanche.
+    h ^= h >> 33;
+    h *= checksum_p2;
+    h ^= h >> 29;
+    h *= checksum_p3;
+    h ^= h >> 32;
+    return h;
+}
+
+template <class T, class Payload>
+typename mapped_index<T, Payload>::bbox mapped_index<T, Payload>::entry_bbox(size_t i) const {
+    // Bounds were ordered when they were indexed, so the (robust, but costly) bbox constructor is not needed.
+    bbox b;
+    b.min = vec3<T>(coords[0][i], coords[1][i], coords[2][i]);
+    b.max = vec3<T>(coords[3][i], coords[4][i], coords[5][i]);
+    return b;
+}
+
+template <class T, class Payload>
+T mapped_index<T, Payload>::entry_sq_dist(size_t i, const vec3<T> &p) const {
+    const T zero = static_cast<T>(0);
+    const T dx = std::max(std::max(coords[0][i] - p.x, p.x - coords[3][i]), zero);
+    const T dy = std::max(std::max(coords[1][i] - p.y, p.y - coords[4][i]), zero);
+    const T dz = std::max(std::max(coords[2][i] - p.z, p.z - coords[5][i]), zero);
+    return dx * dx + dy * dy + dz * dz;
+}
+
+//------------------------------------------------------ Constructors -------------------------------------------------------
+
+template <class T, class Payload>
+mapped_index<T, Payload>::mapped_index(const void *data, size_t size, bool verify_checksum){
+    if(data == nullptr){
+        throw std::invalid_argument("No serialized index provided");
+    }
+    if((reinterpret_cast<uintptr_t>(data) % 8) != 0){
+        throw std::invalid_argument("Serialized index is not suitably aligned");
+    }
+    if(size < sizeof(mapped_index_header)){
+        throw std::runtime_error("Serialized index is truncated");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if(std::memcmp(header.magic, mapped_index_magic, sizeof(mapped_index_magic)) != 0){
+        throw std::runtime_error("Buffer does not contain a serialized index");
+    }
+    if(header.version != format_version){
+        throw std::runtime_error("Serialized index has an unsupported format version");
+    }
+    if(header.byte_order != mapped_index_byte_order){
+        throw std::runtime_error("Serialized index was written with a different byte order");
+    }
+    if( (header.value_size != sizeof(T))
+    ||  (header.payload_size != sizeof(Payload)) ){
+        throw std::runtime_error("Serialized index was written with different coordinate or payload types");
+    }
+
+    mapped_layout l;
+    if( !compute_layout<T, Payload>(header.node_count, header.entry_count, l)
+    ||  ((l.end - sizeof(mapped_index_header)) != header.body_size) ){
+        throw std::runtime_error("Serialized index header is inconsistent");
+    }
+    if(size < l.end){
+        throw std::runtime_error("Serialized index is truncated");
+    }
+
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    if( verify_checksum
+    &&  (mapped_index_checksum(bytes + sizeof(mapped_index_header), header.body_size) != header.checksum) ){
+        throw std::runtime_error("Serialized index checksum mismatch");
+    }
+
+    nodes = reinterpret_cast<const node *>(bytes + l.nodes);
+    for(size_t c = 0; c < 6; ++c) coords[c] = reinterpret_cast<const T *>(bytes + l.coords[c]);
+    payloads = reinterpret_cast<const Payload *>(bytes + l.payloads);
+
+    // Validate the node structure so queries can never stray outside the buffer. Children must follow their parent,
+    // which also rules out cycles.
+    const uint64_t N_nodes = header.node_count;
+    const uint64_t N = header.entry_count;
+    if((N_nodes == 0) != (N == 0)){
+        throw std::runtime_error("Serialized index structure is invalid");
+    }
+    if( (0 < N_nodes)
+    &&  ((nodes[0].begin != 0) || (nodes[0].end != N)) ){
+        throw std::runtime_error("Serialized index structure is invalid");
+    }
+    for(uint64_t i = 0; i < N_nodes; ++i){
+        const auto &n = nodes[i];
+        if( (n.end < n.begin)
+        ||  (N < n.end)
+        ||  ( (0 < n.child_count)
+           && ( (n.first_child <= i)
+             || (N_nodes < n.first_child)
+             || ((N_nodes - n.first_child) < n.child_count) ) ) ){
+            throw std::runtime_error("Serialized index structure is invalid");
+        }
+    }
+}
+
+//------------------------------------------------------ Member functions ---------------------------------------------------
+
+template <class T, class Payload>
+bool mapped_index<T, Payload>::write(std::ostream &os, mapped_index_kind kind, uint32_t parameter,
+                                     const std::vector<node> &nodes, const std::vector<entry> &entries){
+    mapped_index_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, mapped_index_magic, sizeof(mapped_index_magic));
+    h.version = format_version;
+    h.byte_order = mapped_index_byte_order;
+    h.kind = static_cast<uint32_t>(kind);
+    h.value_size = static_cast<uint32_t>(sizeof(T));
+    h.payload_size = static_cast<uint32_t>(sizeof(Payload));
+    h.parameter = parameter;
+    h.node_count = nodes.size();
+    h.entry_count = entries.size();
+
+    mapped_layout l;
+    if(!compute_layout<T, Payload>(h.node_count, h.entry_count, l)) return false;
+    h.body_size = l.end - sizeof(mapped_index_header);
+
+    // Assemble the whole buffer so the checksum can be computed before anything is written. Padding is zeroed.
+    std::vector<uint64_t> storage(l.end / 8, 0);
+    auto *bytes = reinterpret_cast<unsigned char *>(storage.data());
+    if(!nodes.empty()) std::memcpy(bytes + l.nodes, nodes.data(), nodes.size() * sizeof(node));
+    T *c[6];
+    for(size_t j = 0; j < 6; ++j) c[j] = reinterpret_cast<T *>(bytes + l.coords[j]);
+    auto *p = reinterpret_cast<Payload *>(bytes + l.payloads);
+    for(size_t i = 0; i < entries.size(); ++i){
+        const auto &b = entries[i].box;
+        c[0][i] = b.min.x;
+        c[1][i] = b.min.y;
+        c[2][i] = b.min.z;
+        c[3][i] = b.max.x;
+        c[4][i] = b.max.y;
+        c[5][i] = b.max.z;
+        std::memcpy(static_cast<void *>(p + i), &(entries[i].aux_data), sizeof(Payload));
+    }
+    h.checksum = mapped_index_checksum(bytes + sizeof(mapped_index_header), h.body_size);
+    std::memcpy(bytes, &h, sizeof(h));
+
+    os.write(reinterpret_cast<const char *>(bytes), static_cast<std::streamsize>(l.end));
+    os.flush();
+    return !os.fail();
+}
+
+template <class T, class Payload>
+bool mapped_index<T, Payload>::read(std::istream &is, std::vector<uint64_t> &storage){
+    mapped_index_header h;
+    if(!is.read(reinterpret_cast<char *>(&h), sizeof(h))) return false;
+    if( (std::memcmp(h.magic, mapped_index_magic, sizeof(mapped_index_magic)) != 0)
+    ||  (h.version != format_version)
+    ||  (h.byte_order != mapped_index_byte_order)
+    ||  (h.value_size != sizeof(T))
+    ||  (h.payload_size != sizeof(Payload)) ) return false;
+
+    // Confirm the claimed size before allocating anything.
+    mapped_layout l;
+    if( !compute_layout<T, Payload>(h.node_count, h.entry_count, l)
+    ||  ((l.end - sizeof(mapped_index_header)) != h.body_size) ) return false;
+
+    storage.assign(l.end / 8, 0);
+    auto *bytes = reinterpret_cast<char *>(storage.data());
+    std::memcpy(bytes, &h, sizeof(h));
+    const auto N_body = static_cast<std::streamsize>(h.body_size);
+    return static_cast<bool>(is.read(bytes + sizeof(h), N_body));
+}
+
+template <class T, class Payload>
+mapped_index_kind mapped_index<T, Payload>::get_kind() const {
+    return static_cast<mapped_index_kind>(header.kind);
+}
+
+template <class T, class Payload>
+uint32_t mapped_index<T, Payload>::get_parameter() const {
+    return header.parameter;
+}
+
+template <class T, class Payload>
+size_t mapped_index<T, Payload>::get_size() const {
+    return static_cast<size_t>(header.entry_count);
+}
+
+template <class T, class Payload>
+typename mapped_index<T, Payload>::bbox mapped_index<T, Payload>::get_bounds() const {
+    bbox b;
+    if(header.node_count != 0){
+        b.min = vec3<T>(nodes[0].min[0], nodes[0].min[1], nodes[0].min[2]);
+        b.max = vec3<T>(nodes[0].max[0], nodes[0].max[1], nodes[0].max[2]);
+    }
+    return b;
+}
+
+template <class T, class Payload>
+size_t mapped_index<T, Payload>::get_node_count() const {
+    return static_cast<size_t>(header.node_count);
+}
+
+template <class T, class Payload>
+const typename mapped_index<T, Payload>::node * mapped_index<T, Payload>::get_nodes() const {
+    return nodes;
+}
+
+template <class T, class Payload>
+typename mapped_index<T, Payload>::entry mapped_index<T, Payload>::get_entry(size_t i) const {
+    entry e;
+    e.box = entry_bbox(i);
+    std::memcpy(static_cast<void *>(&e.aux_data), payloads + i, sizeof(Payload));
+    return e;
+}
+
+template <class T, class Payload>
+std::vector<typename mapped_index<T, Payload>::entry> mapped_index<T, Payload>::search(const bbox &query_box) const {
+    std::vector<entry> results;
+    search(query_box, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+std::vector<typename mapped_index<T, Payload>::entry> mapped_index<T, Payload>::search_radius(const vec3<T> &center, T radius) const {
+    std::vector<entry> results;
+    search_radius(center, radius, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+std::vector<typename mapped_index<T, Payload>::entry> mapped_index<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
+    std::vector<entry> results;
+    nearest_neighbors(query_point, k, [&](const entry &e, T){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void mapped_index<T, Payload>::search(const bbox &query_box, const visitor &f) const {
+    if(header.node_count == 0) return;
+
+    std::vector<size_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while(!stack.empty()){
+        const auto &n = nodes[stack.back()];
+        stack.pop_back();
+        if(!node_intersects(n, query_box)) continue;
+
+        // Entries within a subtree are contiguous, so a fully-enclosed subtree can be reported without descending.
+        if(node_within(n, query_box)){
+            for(size_t i = n.begin; i < n.end; ++i){
+                if(!f(get_entry(i))) return;
+            }
+        }else if(n.child_count != 0){
+            for(size_t c = n.child_count; 0 < c; --c) stack.push_back(n.first_child + c - 1);
+        }else{
+            for(size_t i = n.begin; i < n.end; ++i){
+                if( (coords[0][i] <= query_box.max.x) && (query_box.min.x <= coords[3][i])
+                &&  (coords[1][i] <= query_box.max.y) && (query_box.min.y <= coords[4][i])
+                &&  (coords[2][i] <= query_box.max.z) && (query_box.min.z <= coords[5][i]) ){
+                    if(!f(get_entry(i))) return;
+                }
+            }
+        }
+    }
+    return;
+}
+
+template <class T, class Payload>
+void mapped_index<T, Payload>::search_radius(const vec3<T> &center, T radius, const visitor &f) const {
+    if((header.node_count == 0) || !(static_cast<T>(0) <= radius)) return;
+    const T radius_sq = radius * radius;
+
+    std::vector<size_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while(!stack.empty()){
+        const auto &n = nodes[stack.back()];
+        stack.pop_back();
+        if(radius_sq < node_sq_dist(n, center)) continue;
+
+        if(n.child_count != 0){
+            for(size_t c = n.child_count; 0 < c; --c) stack.push_back(n.first_child + c - 1);
+        }else{
+            for(size_t i = n.begin; i < n.end; ++i){
+                if(entry_sq_dist(i, center) <= radius_sq){
+                    if(!f(get_entry(i))) return;
+                }
+            }
+        }
+    }
+    return;
+}
+
+template <class T, class Payload>
+void mapped_index<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const {
+    if((k == 0) || (header.node_count == 0)) return;
+
+    // Best-first traversal, which suits any node fan-out. Nodes are visited in order of increasing distance until the
+    // nearest remaining node is no closer than the k-th best entry.
+    using dist_index = std::pair<T, size_t>;
+    const auto cmp = [](const dist_index &a, const dist_index &b){ return a.first < b.first; };
+    std::priority_queue<dist_index, std::vector<dist_index>, std::greater<dist_index>> queue;
+    std::vector<dist_index> best; // A max-heap.
+    best.reserve(std::min<size_t>(k, header.entry_count) + 1);
+
+    queue.emplace(node_sq_dist(nodes[0], query_point), 0);
+    while(!queue.empty()){
+        const auto [node_dist_sq, node_index] = queue.top();
+        queue.pop();
+        if((best.size() == k) && !(node_dist_sq < best.front().first)) break;
+
+        const auto &n = nodes[node_index];
+        if(n.child_count != 0){
+            for(size_t c = 0; c < n.child_count; ++c){
+                const size_t child = n.first_child + c;
+                const T dist_sq = node_sq_dist(nodes[child], query_point);
+                if((best.size() < k) || (dist_sq < best.front().first)) queue.emplace(dist_sq, child);
+            }
+            continue;
+        }
+
+        for(size_t i = n.begin; i < n.end; ++i){
+            const T dist_sq = entry_sq_dist(i, query_point);
+            if(best.size() < k){
+                best.emplace_back(dist_sq, i);
+                std::push_heap(best.begin(), best.end(), cmp);
+            }else if(dist_sq < best.front().first){
+                std::pop_heap(best.begin(), best.end(), cmp);
+                best.back() = std::make_pair(dist_sq, i);
+                std::push_heap(best.begin(), best.end(), cmp);
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), cmp);
+    for(const auto &b : best){
+        if(!f(get_entry(b.second), b.first)) return;
+    }
+    return;
+}
+
+#ifndef YGOR_INDEX_MAPPED_DISABLE_ALL_SPECIALIZATIONS
+    template class mapped_index<float , uint32_t>;
+    template class mapped_index<double, uint32_t>;
+    template class mapped_index<float , uint64_t>;
+    template class mapped_index<double, uint64_t>;
+#endif
@@ -0,0 +1,183 @@
+//YgorIndexMapped.h
+
+#pragma once
+#ifndef YGOR_INDEX_MAPPED_H_
+#define YGOR_INDEX_MAPPED_H_
+
+#include <stddef.h>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <type_traits>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorMath.h"
+#include "YgorIndex.h"
+
+
+//---------------------------------------------------------------------------------------------------------------------------
+//------------------------- mapped_index: serialized spatial indices that can be queried in place ---------------------------
+//---------------------------------------------------------------------------------------------------------------------------
+//This class provides read-only queries over the flat, serialized form of a kdtree or rtree.
+//
+// The serialized form is a single contiguous buffer that contains no pointers, so it can be written to a file and later
+// mmap'd (or read into memory) and queried directly, without any deserialization or rebuilding. The layout is:
+//
+//   - A fixed-size header (mapped_index_header) identifying the format version, the byte order, the kind of index, the
+//     sizes of the coordinate and payload types, the number of nodes and entries, and a checksum of the remainder.
+//   - The nodes (mapped_index_node), root first. The children of each internal node are stored contiguously and are
+//     referred to by their offset in the node array. Entries are stored in leaf order, so the entries within every
+//     subtree form a contiguous range.
+//   - The entry bounds, stored as six separate coordinate arrays (min x, y, z, then max x, y, z).
+//   - The entry payloads.
+//
+// Every section starts on an 8-byte boundary, relative to the start of the buffer. Payloads are copied bytewise, so only
+// trivially-copyable payloads (e.g., integer identifiers) are supported; std::any payloads cannot be serialized. The
+// payload type defaults to uint64_t, which can hold an identifier or an index into external storage.
+//
+// Buffers are validated when a mapped_index is constructed. Buffers written by a different format version, on a machine
+// with a different byte order, or with different coordinate or payload types are rejected, as are buffers whose checksum
+// or node structure is inconsistent. Checksum verification touches the entire buffer, so it can optionally be skipped for
+// trusted buffers when only a handful of queries will be performed.
+//
+// Queries are const and can be issued from multiple threads simultaneously. The buffer is not copied, so it must outlive
+// the mapped_index.
+//
+// Example usage:
+//        kdtree<double, uint32_t> tree;
+//        ...
+//        std::ofstream ofs("atlas.idx", std::ios::binary);
+//        tree.write_to(ofs);
+//
+//        // Later, with the file mapped (e.g., via mmap) at 'addr':
+//        mapped_index<double, uint32_t> idx(addr, file_size);
+//        idx.nearest_neighbors(q, 10, [](const auto &e, double sq_dist){ ...; return true; });
+//
+
+// The kind of index that was serialized. Either kind can be queried via mapped_index, but an index can only be read back
+// into the kind of index that wrote it.
+enum class mapped_index_kind : uint32_t {
+    kdtree = 1,
+    rtree  = 2,
+};
+
+// The header at the start of every serialized index.
+struct mapped_index_header {
+    char magic[8];          // "YGORIDX" followed by a null byte.
+    uint32_t version;       // The format version.
+    uint32_t byte_order;    // 0x01020304 in the byte order of the writer.
+    uint32_t kind;          // A mapped_index_kind.
+    uint32_t value_size;    // sizeof(T).
+    uint32_t payload_size;  // sizeof(Payload).
+    uint32_t parameter;     // An index-specific parameter: the leaf size of a kdtree, or the node capacity of an rtree.
+    uint64_t node_count;
+    uint64_t entry_count;
+    uint64_t body_size;     // The number of bytes following the header.
+    uint64_t checksum;      // A checksum of the bytes following the header.
+};
+
+// A node in a serialized index.
+template <class T> struct mapped_index_node {
+    T min[3];               // Bounds of all entries in this subtree.
+    T max[3];
+    uint64_t begin;         // The range of entries within this subtree.
+    uint64_t end;
+    uint64_t first_child;   // Offset of the first child in the node array. Unused for leaves.
+    uint64_t child_count;   // Number of children. Zero for leaves.
+};
+
+// Compute the checksum used by the serialized form. This is a fast, non-cryptographic 64-bit hash intended only to detect
+// accidental corruption.
+uint64_t mapped_index_checksum(const void *data, size_t size);
+
+template <class T, class Payload = uint64_t> class mapped_index {
+    static_assert(std::is_trivially_copyable<Payload>::value, "Only trivially-copyable payloads can be serialized");
+    static_assert(alignof(Payload) <= 8, "Payloads cannot require more than 8-byte alignment");
+
+    public:
+        using value_type = T;
+        using payload_type = Payload;
+        using entry = index_entry<T, Payload>;
+        using bbox = index_bbox<T>;
+        using node = mapped_index_node<T>;
+
+        // Callbacks for the visitor-style queries. Entries are assembled on the fly, so the reference is only valid
+        // for the duration of the callback. Returning false stops the query early.
+        using visitor = std::function<bool(const entry &)>;
+        using distance_visitor = std::function<bool(const entry &, T)>; // Also receives the squared distance.
+
+        // The current format version. Buffers with any other version are rejected.
+        static constexpr uint32_t format_version = 1;
+
+    private:
+        mapped_index_header header;
+        const node *nodes;
+        const T *coords[6];     // min x, y, z, then max x, y, z.
+        const Payload *payloads;
+
+        // Assemble the bbox of an entry.
+        bbox entry_bbox(size_t i) const;
+
+        // Compute the squared distance from a point to an entry.
+        T entry_sq_dist(size_t i, const vec3<T> &point) const;
+
+    public:
+        //--------------------------------------------------- Constructors -------------------------------------------------
+
+        // Validate and wrap a serialized index. The buffer must be 8-byte aligned (as page-aligned mappings and
+        // std::vector<uint64_t> storage are). Throws if the buffer is not a valid serialized index for these types.
+        mapped_index(const void *data, size_t size, bool verify_checksum = true);
+
+        //--------------------------------------------------- Member functions ---------------------------------------------
+
+        // Serialize an index, given its nodes (root first) and entries (in leaf order). Returns false if the stream
+        // could not be written.
+        static bool write(std::ostream &os, mapped_index_kind kind, uint32_t parameter,
+                          const std::vector<node> &nodes, const std::vector<entry> &entries);
+
+        // Read a serialized index from a stream into suitably-aligned storage. The header is checked, but the buffer is
+        // not otherwise validated until a mapped_index is constructed over it. Returns false on failure.
+        static bool read(std::istream &is, std::vector<uint64_t> &storage);
+
+        // Get the kind of index that was serialized.
+        mapped_index_kind get_kind() const;
+
+        // Get the index-specific parameter that was serialized.
+        uint32_t get_parameter() const;
+
+        // Get the number of entries.
+        size_t get_size() const;
+
+        // Get the bounding box of all entries.
+        bbox get_bounds() const;
+
+        // Get the number of nodes.
+        size_t get_node_count() const;
+
+        // Get the nodes, root first.
+        const node * get_nodes() const;
+
+        // Get an entry, in leaf order.
+        entry get_entry(size_t i) const;
+
+        // Search for all entries fully or partially within a bounding box.
+        std::vector<entry> search(const bbox &query_box) const;
+
+        // Search for all entries fully or partially within a given radius of a center point.
+        std::vector<entry> search_radius(const vec3<T> &center, T radius) const;
+
+        // Find the k nearest neighbor entries to a query point, in order of increasing distance.
+        std::vector<entry> nearest_neighbors(const vec3<T> &query_point, size_t k) const;
+
+        // Visit all entries fully or partially within a bounding box.
+        void search(const bbox &query_box, const visitor &f) const;
+
+        // Visit all entries fully or partially within a given radius of a center point.
+        void search_radius(const vec3<T> &center, T radius, const visitor &f) const;
+
+        // Visit the k nearest neighbor entries to a query point, in order of increasing distance.
+        void nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const;
+};
+
+#endif // YGOR_INDEX_MAPPED_H_
@@ -4,6 +4,7 @@
 #include <any>
 #include <array>
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <optional>
@@ -26,21 +27,21 @@
 
 //------------------------------------------------------ octree_node --------------------------------------------------------
 
-template <class T>
-octree<T>::octree_node::octree_node() : is_leaf(true) { }
+template <class T, class Payload>
+octree<T, Payload>::octree_node::octree_node() : is_leaf(true) { }
 
-template <class T>
-octree<T>::octree_node::octree_node(const bbox &b) : bounds(b), is_leaf(true) { }
+template <class T, class Payload>
+octree<T, Payload>::octree_node::octree_node(const bbox &b) : bounds(b), is_leaf(true) { }
 
 //------------------------------------------------------ Private helpers ----------------------------------------------------
 
-template <class T>
-T octree<T>::point_to_bbox_sq_dist(const vec3<T> &point, const bbox &box) {
+template <class T, class Payload>
+T octree<T, Payload>::point_to_bbox_sq_dist(const vec3<T> &point, const bbox &box) {
     return box.squared_distance_to(point);
 }
 
-template <class T>
-int octree<T>::get_octant(const bbox &node_bounds, const vec3<T> &point) const {
+template <class T, class Payload>
+int octree<T, Payload>::get_octant(const bbox &node_bounds, const vec3<T> &point) const {
     const auto mid = node_bounds.center();
 
     int octant = 0;
@@ -50,8 +51,8 @@ int octree<T>::get_octant(const bbox &node_bounds, const vec3<T> &point) const {
     return octant;
 }
 
-template <class T>
-std::optional<int> octree<T>::get_octant(const bbox &node_bounds, const bbox &entry_box) const {
+template <class T, class Payload>
+std::optional<int> octree<T, Payload>::get_octant(const bbox &node_bounds, const bbox &entry_box) const {
     const auto mid = node_bounds.center();
 
     const bool fits_left_x = entry_box.max.x <= mid.x;
@@ -73,8 +74,8 @@ std::optional<int> octree<T>::get_octant(const bbox &node_bounds, const bbox &en
     return octant;
 }
 
-template <class T>
-typename octree<T>::bbox octree<T>::get_octant_bounds(const bbox &parent_bounds, int octant) const {
+template <class T, class Payload>
+typename octree<T, Payload>::bbox octree<T, Payload>::get_octant_bounds(const bbox &parent_bounds, int octant) const {
     const auto mid = parent_bounds.center();
 
     vec3<T> new_min, new_max;
@@ -91,8 +92,8 @@ typename octree<T>::bbox octree<T>::get_octant_bounds(const bbox &parent_bounds,
     return bbox(new_min, new_max);
 }
 
-template <class T>
-void octree<T>::subdivide(octree_node* node, size_t depth) {
+template <class T, class Payload>
+void octree<T, Payload>::subdivide(octree_node* node, size_t depth) {
     node->is_leaf = false;
 
     for(int i = 0; i < 8; ++i){
@@ -112,8 +113,8 @@ void octree<T>::subdivide(octree_node* node, size_t depth) {
     }
 }
 
-template <class T>
-void octree<T>::insert_into_node(octree_node* node, const entry &e, size_t depth) {
+template <class T, class Payload>
+void octree<T, Payload>::insert_into_node(octree_node* node, const entry &e, size_t depth) {
     if(node->is_leaf){
         node->entries.push_back(e);
 
@@ -130,32 +131,33 @@ void octree<T>::insert_into_node(octree_node* node, const entry &e, size_t depth
     }
 }
 
-template <class T>
-void octree<T>::search_recursive(const octree_node* node, const bbox &query_box, std::vector<entry> &results) const {
-    if((node == nullptr) || !node->bounds.intersects(query_box)) return;
+template <class T, class Payload>
+bool octree<T, Payload>::search_recursive(const octree_node* node, const bbox &query_box, const visitor &f) const {
+    if((node == nullptr) || !node->bounds.intersects(query_box)) return true;
 
     for(const auto &e : node->entries){
-        if(e.box.intersects(query_box)){
-            results.push_back(e);
+        if(e.box.intersects(query_box) && !f(e)){
+            return false;
         }
     }
 
-    if(node->is_leaf) return;
+    if(node->is_leaf) return true;
 
     for(int i = 0; i < 8; ++i){
         if(node->children[i] != nullptr){
-            search_recursive(node->children[i].get(), query_box, results);
+            if(!search_recursive(node->children[i].get(), query_box, f)) return false;
         }
     }
+    return true;
 }
 
-template <class T>
-void octree<T>::collect_all(const octree_node* node, std::vector<std::pair<T, entry>> &results, const vec3<T> &query_point) const {
+template <class T, class Payload>
+void octree<T, Payload>::collect_all(const octree_node* node, std::vector<std::pair<T, const entry*>> &results, const vec3<T> &query_point) const {
     if(node == nullptr) return;
 
     for(const auto &e : node->entries){
         const T dist_sq = point_to_bbox_sq_dist(query_point, e.box);
-        results.emplace_back(dist_sq, e);
+        results.emplace_back(dist_sq, &e);
     }
 
     if(node->is_leaf) return;
@@ -167,13 +169,13 @@ void octree<T>::collect_all(const octree_node* node, std::vector<std::pair<T, en
     }
 }
 
-template <class T>
-void octree<T>::update_bounds(const vec3<T> &point) {
+template <class T, class Payload>
+void octree<T, Payload>::update_bounds(const vec3<T> &point) {
     update_bounds(bbox(point, point));
 }
 
-template <class T>
-void octree<T>::update_bounds(const bbox &bb) {
+template <class T, class Payload>
+void octree<T, Payload>::update_bounds(const bbox &bb) {
     if(!bounds_initialized){
         bounds = bb;
         bounds_initialized = true;
@@ -184,20 +186,20 @@ void octree<T>::update_bounds(const bbox &bb) {
 
 //------------------------------------------------------ Constructors -------------------------------------------------------
 
-template <class T>
-octree<T>::octree() : max_entries_per_node(8), max_depth(21), entry_count(0),
+template <class T, class Payload>
+octree<T, Payload>::octree() : max_entries_per_node(8), max_depth(21), entry_count(0),
                       bounds_initialized(false) { }
 
-template <class T>
-octree<T>::octree(size_t max_entries) : max_entries_per_node(max_entries), max_depth(21),
+template <class T, class Payload>
+octree<T, Payload>::octree(size_t max_entries) : max_entries_per_node(max_entries), max_depth(21),
                                         entry_count(0), bounds_initialized(false) {
     if(max_entries_per_node < 1){
         throw std::invalid_argument("Maximum entries per node must be at least 1");
     }
 }
 
-template <class T>
-octree<T>::octree(size_t max_entries, size_t max_tree_depth)
+template <class T, class Payload>
+octree<T, Payload>::octree(size_t max_entries, size_t max_tree_depth)
     : max_entries_per_node(max_entries), max_depth(max_tree_depth),
       entry_count(0), bounds_initialized(false) {
     if(max_entries_per_node < 1){
@@ -205,28 +207,28 @@ octree<T>::octree(size_t max_entries, size_t max_tree_depth)
     }
 }
 
-template <class T>
-octree<T>::~octree() = default;
+template <class T, class Payload>
+octree<T, Payload>::~octree() = default;
 
 //------------------------------------------------------ Member functions ---------------------------------------------------
 
-template <class T>
-void octree<T>::insert(const vec3<T> &point) {
-    insert(point, std::any{});
+template <class T, class Payload>
+void octree<T, Payload>::insert(const vec3<T> &point) {
+    insert(point, Payload{});
 }
 
-template <class T>
-void octree<T>::insert(const vec3<T> &point, std::any aux_data) {
+template <class T, class Payload>
+void octree<T, Payload>::insert(const vec3<T> &point, Payload aux_data) {
     insert(bbox(point, point), std::move(aux_data));
 }
 
-template <class T>
-void octree<T>::insert(const bbox &bb) {
-    insert(bb, std::any{});
+template <class T, class Payload>
+void octree<T, Payload>::insert(const bbox &bb) {
+    insert(bb, Payload{});
 }
 
-template <class T>
-void octree<T>::insert(const bbox &bb, std::any aux_data) {
+template <class T, class Payload>
+void octree<T, Payload>::insert(const bbox &bb, Payload aux_data) {
     if(!bb.isfinite()){
         throw std::invalid_argument("Cannot insert non-finite bbox into octree");
     }
@@ -295,17 +297,25 @@ void octree<T>::insert(const bbox &bb, std::any aux_data) {
     ++entry_count;
 }
 
-template <class T>
-std::vector<typename octree<T>::entry> octree<T>::search(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<typename octree<T, Payload>::entry> octree<T, Payload>::search(const bbox &query_box) const {
     std::vector<entry> results;
+    search(query_box, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void octree<T, Payload>::search(const bbox &query_box, const visitor &f) const {
     if(root != nullptr){
-        search_recursive(root.get(), query_box, results);
+        search_recursive(root.get(), query_box, f);
     }
-    return results;
 }
 
-template <class T>
-std::vector<vec3<T>> octree<T>::search_points(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<vec3<T>> octree<T, Payload>::search_points(const bbox &query_box) const {
     auto entries = search(query_box);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -317,8 +327,8 @@ std::vector<vec3<T>> octree<T>::search_points(const bbox &query_box) const {
     return results;
 }
 
-template <class T>
-std::vector<typename octree<T>::bbox> octree<T>::search_bboxes(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<typename octree<T, Payload>::bbox> octree<T, Payload>::search_bboxes(const bbox &query_box) const {
     auto entries = search(query_box);
     std::vector<bbox> results;
     results.reserve(entries.size());
@@ -328,8 +338,8 @@ std::vector<typename octree<T>::bbox> octree<T>::search_bboxes(const bbox &query
     return results;
 }
 
-template <class T>
-std::vector<typename octree<T>::bbox> octree<T>::search_bboxes(const vec3<T> &query_point) const {
+template <class T, class Payload>
+std::vector<typename octree<T, Payload>::bbox> octree<T, Payload>::search_bboxes(const vec3<T> &query_point) const {
     auto entries = search(bbox(query_point, query_point));
     std::vector<bbox> results;
     results.reserve(entries.size());
@@ -341,25 +351,29 @@ std::vector<typename octree<T>::bbox> octree<T>::search_bboxes(const vec3<T> &qu
     return results;
 }
 
-template <class T>
-std::vector<typename octree<T>::entry> octree<T>::search_radius(const vec3<T> &center, T radius) const {
+template <class T, class Payload>
+std::vector<typename octree<T, Payload>::entry> octree<T, Payload>::search_radius(const vec3<T> &center, T radius) const {
+    std::vector<entry> results;
+    search_radius(center, radius, [&](const entry &e){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void octree<T, Payload>::search_radius(const vec3<T> &center, T radius, const visitor &f) const {
     vec3<T> offset(radius, radius, radius);
     bbox query_box(center - offset, center + offset);
 
-    auto candidates = search(query_box);
-
-    std::vector<entry> results;
     const T radius_sq = radius * radius;
-    for(const auto& e : candidates){
-        if(point_to_bbox_sq_dist(center, e.box) <= radius_sq){
-            results.push_back(e);
-        }
-    }
-    return results;
+    search(query_box, [&](const entry &e){
+        return (radius_sq < point_to_bbox_sq_dist(center, e.box)) || f(e);
+    });
 }
 
-template <class T>
-std::vector<vec3<T>> octree<T>::search_radius_points(const vec3<T> &center, T radius) const {
+template <class T, class Payload>
+std::vector<vec3<T>> octree<T, Payload>::search_radius_points(const vec3<T> &center, T radius) const {
     auto entries = search_radius(center, radius);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -371,17 +385,26 @@ std::vector<vec3<T>> octree<T>::search_radius_points(const vec3<T> &center, T ra
     return results;
 }
 
-template <class T>
-std::vector<typename octree<T>::entry> octree<T>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
-    std::vector<std::pair<T, entry>> all_entries;
+template <class T, class Payload>
+std::vector<typename octree<T, Payload>::entry> octree<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
+    std::vector<entry> results;
+    nearest_neighbors(query_point, k, [&](const entry &e, T){
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void octree<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const {
+    std::vector<std::pair<T, const entry*>> all_entries;
 
     if(root != nullptr){
         collect_all(root.get(), all_entries, query_point);
     }
 
-    std::vector<entry> results;
     if(k == 0 || all_entries.empty()){
-        return results;
+        return;
     }
 
     const auto cmp = [](const auto &a, const auto &b){
@@ -397,35 +420,31 @@ std::vector<typename octree<T>::entry> octree<T>::nearest_neighbors(const vec3<T
 
     std::sort(all_entries.begin(), all_entries.end(), cmp);
 
-    results.reserve(all_entries.size());
     for(const auto &pair : all_entries){
-        results.push_back(pair.second);
+        if(!f(*(pair.second), pair.first)) return;
     }
-    return results;
 }
 
-template <class T>
-std::vector<vec3<T>> octree<T>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
-    if(k == 0) return {};
-    auto entries = nearest_neighbors(query_point, entry_count);
+template <class T, class Payload>
+std::vector<vec3<T>> octree<T, Payload>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
     std::vector<vec3<T>> results;
-    results.reserve(std::min(k, entries.size()));
-    for(const auto& e : entries){
+    if(k == 0) return results;
+    nearest_neighbors(query_point, entry_count, [&](const entry &e, T){
         if(!e.box.has_extent()){
             results.push_back(e.box.min);
-            if(results.size() == k) break;
         }
-    }
+        return (results.size() < k);
+    });
     return results;
 }
 
-template <class T>
-bool octree<T>::contains(const vec3<T> &point) const {
+template <class T, class Payload>
+bool octree<T, Payload>::contains(const vec3<T> &point) const {
     return contains(bbox(point, point));
 }
 
-template <class T>
-bool octree<T>::contains(const bbox &bb) const {
+template <class T, class Payload>
+bool octree<T, Payload>::contains(const bbox &bb) const {
     if(root == nullptr) return false;
 
     auto results = search(bb);
@@ -437,25 +456,29 @@ bool octree<T>::contains(const bbox &bb) const {
     return false;
 }
 
-template <class T>
-void octree<T>::clear() {
+template <class T, class Payload>
+void octree<T, Payload>::clear() {
     root.reset();
     entry_count = 0;
     bounds_initialized = false;
     bounds = bbox();
 }
 
-template <class T>
-size_t octree<T>::get_size() const {
+template <class T, class Payload>
+size_t octree<T, Payload>::get_size() const {
     return entry_count;
 }
 
-template <class T>
-typename octree<T>::bbox octree<T>::get_bounds() const {
+template <class T, class Payload>
+typename octree<T, Payload>::bbox octree<T, Payload>::get_bounds() const {
     return bounds;
 }
 
 #ifndef YGOR_INDEX_OCTREE_DISABLE_ALL_SPECIALIZATIONS
-    template class octree<float>;
-    template class octree<double>;
+    template class octree<float , std::any>;
+    template class octree<double, std::any>;
+    template class octree<float , uint32_t>;
+    template class octree<double, uint32_t>;
+    template class octree<float , uint64_t>;
+    template class octree<double, uint64_t>;
 #endif
@@ -8,6 +8,7 @@
 #include <any>
 #include <array>
 #include <cmath>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <optional>
@@ -31,7 +32,8 @@
 //  - Nearest neighbor queries
 //  - Radius queries
 //
-// Users can optionally associate auxiliary data (via std::any) with each inserted point.
+// Users can optionally associate auxiliary data with each inserted point. By default this is a std::any, but a plain
+// payload type (e.g., a uint32_t id) can be provided as the second template parameter to avoid type erasure.
 // This auxiliary data is not used during spatial queries but can be retrieved after lookups.
 //
 // Example usage:
@@ -44,11 +46,17 @@
 //        auto points = tree.search_points(query_box);
 //
 
-template <class T> class octree {
+template <class T, class Payload = std::any> class octree {
     public:
         using value_type = T;
-        using entry = index_entry<T>;
+        using payload_type = Payload;
+        using entry = index_entry<T, Payload>;
         using bbox = index_bbox<T>;
+
+        // Callbacks for the visitor-style queries. Entries are passed by reference, avoiding copies. Returning false stops
+        // the query early.
+        using visitor = std::function<bool(const entry &)>;
+        using distance_visitor = std::function<bool(const entry &, T)>; // Also receives the squared distance.
         
     private:
         struct octree_node {
@@ -83,11 +91,11 @@ template <class T> class octree {
         // Subdivide a leaf node into eight children.
         void subdivide(octree_node* node, size_t depth);
         
-        // Search recursively for entries within a bounding box.
-        void search_recursive(const octree_node* node, const bbox &query_box, std::vector<entry> &results) const;
+        // Search recursively for entries within a bounding box. Returns false if the visitor stopped the search.
+        bool search_recursive(const octree_node* node, const bbox &query_box, const visitor &f) const;
         
         // Collect all entries from a node and its descendants.
-        void collect_all(const octree_node* node, std::vector<std::pair<T, entry>> &results, const vec3<T> &query_point) const;
+        void collect_all(const octree_node* node, std::vector<std::pair<T, const entry*>> &results, const vec3<T> &query_point) const;
         
         // Update the overall bounding box.
         void update_bounds(const vec3<T> &point);
@@ -113,13 +121,13 @@ template <class T> class octree {
         void insert(const vec3<T> &point);
         
         // Insert a point with auxiliary data into the tree.
-        void insert(const vec3<T> &point, std::any aux_data);
+        void insert(const vec3<T> &point, Payload aux_data);
 
         // Insert a bbox into the tree (without auxiliary data).
         void insert(const bbox &bb);
 
         // Insert a bbox with auxiliary data into the tree.
-        void insert(const bbox &bb, std::any aux_data);
+        void insert(const bbox &bb, Payload aux_data);
         
         // Search for all entries fully or partially within a bounding box.
         std::vector<entry> search(const bbox &query_box) const;
@@ -137,6 +145,15 @@ template <class T> class octree {
         
         // Search for all entries fully or partially within a given radius of a center point.
         std::vector<entry> search_radius(const vec3<T> &center, T radius) const;
+
+        // Visit all entries fully or partially within a bounding box.
+        void search(const bbox &query_box, const visitor &f) const;
+
+        // Visit all entries fully or partially within a given radius of a center point.
+        void search_radius(const vec3<T> &center, T radius, const visitor &f) const;
+
+        // Visit the k nearest neighbor entries to a query point, in order of increasing distance.
+        void nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const;
         
         // Search for all points within a given radius of a center point (returns points only).
         // This function will only return bboxes that represent a single point (i.e., no spatial extent),
@@ -2,11 +2,19 @@
 
 #include <algorithm>   //Needed for std::reverse.
 #include <any>
+#include <array>
+#include <atomic>
 #include <cmath>       //Needed for fabs, signbit, sqrt, etc...
 #include <functional>  //Needed for passing kernel functions to integration schemes.
+#include <future>
+#include <iterator>
 #include <limits>      //Needed for std::numeric_limits::max().
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <utility>     //Needed for std::pair.
 #include <vector>
 #include <cstdint>
@@ -15,6 +23,7 @@
 #include "YgorMath.h"
 #include "YgorIndex.h"
 #include "YgorIndexRTree.h"
+#include "YgorIndexMapped.h"
 
 //#ifndef YGOR_INDEX_RTREE_DISABLE_ALL_SPECIALIZATIONS
 //    #define YGOR_INDEX_RTREE_DISABLE_ALL_SPECIALIZATIONS
@@ -24,19 +33,231 @@
 //---------------------------------- rtree: R*-tree spatial indexing data structure -----------------------------------------
 //---------------------------------------------------------------------------------------------------------------------------
 
+//------------------------------------------------------ Private helpers ----------------------------------------------------
+
+namespace {
+    // Ranges with fewer elements are not worth sorting on a separate thread.
+    constexpr size_t rtree_parallel_threshold = 50'000;
+
+    // Number of pairs found by a join that are collected before they are passed to the visitor.
+    constexpr size_t rtree_join_batch_size = 1024;
+
+    // Number of times a range can be split in half so that every hardware thread receives a piece.
+    int64_t rtree_spawn_depth(){
+        int64_t spawn_depth = 0;
+        const auto N_threads = std::thread::hardware_concurrency();
+        while((static_cast<int64_t>(1) << spawn_depth) < static_cast<int64_t>(N_threads)) ++spawn_depth;
+        return spawn_depth;
+    }
+
+    // Merge sort where the halves are sorted concurrently.
+    template <class It, class Cmp>
+    void rtree_parallel_sort(It begin, It end, Cmp cmp, int64_t spawn_depth){
+        const auto N = static_cast<size_t>(std::distance(begin, end));
+        if((spawn_depth <= 0) || (N < rtree_parallel_threshold)){
+            std::sort(begin, end, cmp);
+            return;
+        }
+        const auto mid = std::next(begin, static_cast<std::ptrdiff_t>(N / 2));
+        auto fut = std::async(std::launch::async, [=](){
+            rtree_parallel_sort(begin, mid, cmp, spawn_depth - 1);
+        });
+        rtree_parallel_sort(mid, end, cmp, spawn_depth - 1);
+        fut.get();
+        std::inplace_merge(begin, mid, end, cmp);
+        return;
+    }
+
+    template <class T>
+    T rtree_get_coord(const vec3<T> &v, int axis){
+        return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+    }
+
+    // Sort-Tile-Recursive ordering of the given centres. Consecutive runs of 'capacity' items in the returned order form
+    // the tiles.
+    //
+    // Slabs and runs are sized in multiples of the capacity, so every tile is full except for the final one.
+    template <class T>
+    std::vector<size_t> rtree_str_order(const std::vector<vec3<T>> &centres, size_t capacity){
+        const size_t N = centres.size();
+        std::vector<size_t> order(N);
+        std::iota(std::begin(order), std::end(order), static_cast<size_t>(0));
+
+        const auto N_tiles = (N + capacity - 1) / capacity;
+        auto S = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(N_tiles))));
+        while((S * S * S) < N_tiles) ++S;
+        const size_t slab_size = S * S * capacity;
+        const size_t run_size = S * capacity;
+
+        const auto by_axis = [&centres](int axis){
+            return [axis,&centres](size_t a, size_t b){
+                return rtree_get_coord(centres[a], axis) < rtree_get_coord(centres[b], axis);
+            };
+        };
+
+        const auto spawn_depth = rtree_spawn_depth();
+        rtree_parallel_sort(order.begin(), order.end(), by_axis(0), spawn_depth);
+
+        // Slabs are independent, so distribute them across threads.
+        const auto sort_slab = [&](size_t slab){
+            const size_t s_begin = slab * slab_size;
+            const size_t s_end = std::min(N, s_begin + slab_size);
+            std::sort(order.begin() + static_cast<std::ptrdiff_t>(s_begin),
+                      order.begin() + static_cast<std::ptrdiff_t>(s_end), by_axis(1));
+            for(size_t r_begin = s_begin; r_begin < s_end; r_begin += run_size){
+                const size_t r_end = std::min(s_end, r_begin + run_size);
+                std::sort(order.begin() + static_cast<std::ptrdiff_t>(r_begin),
+                          order.begin() + static_cast<std::ptrdiff_t>(r_end), by_axis(2));
+            }
+        };
+        const size_t N_slabs = (N + slab_size - 1) / slab_size;
+        const size_t N_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        if((N < rtree_parallel_threshold) || (N_threads == 1) || (N_slabs == 1)){
+            for(size_t slab = 0; slab < N_slabs; ++slab) sort_slab(slab);
+        }else{
+            std::vector<std::future<void>> futs;
+            for(size_t t = 0; t < N_threads; ++t){
+                futs.emplace_back(std::async(std::launch::async, [&,t](){
+                    for(size_t slab = t; slab < N_slabs; slab += N_threads) sort_slab(slab);
+                }));
+            }
+            for(auto &f : futs) f.get();
+        }
+        return order;
+    }
+
+    // Position along a 3D Hilbert curve with 21 bits of resolution per axis. Uses the transpose-based algorithm from:
+    //   Skilling J. Programming the Hilbert curve. AIP Conference Proceedings. 2004;707(1):381-387.
+    uint64_t rtree_hilbert_key(std::array<uint32_t, 3> X){
+        constexpr int bits = 21;
+        constexpr uint32_t M = static_cast<uint32_t>(1) << (bits - 1);
+
+        // Inverse undo.
+        for(uint32_t Q = M; Q > 1; Q >>= 1){
+            const uint32_t P = Q - 1;
+            for(auto &x : X){
+                if(x & Q){
+                    X[0] ^= P;
+                }else{
+                    const uint32_t t = (X[0] ^ x) & P;
+                    X[0] ^= t;
+                    x ^= t;
+                }
+            }
+        }
+
+        // Gray encode.
+        X[1] ^= X[0];
+        X[2] ^= X[1];
+        uint32_t t = 0;
+        for(uint32_t Q = M; Q > 1; Q >>= 1){
+            if(X[2] & Q) t ^= Q - 1;
+        }
+        for(auto &x : X) x ^= t;
+
+        // Interleave the transposed bits.
+        uint64_t key = 0;
+        for(int b = bits - 1; 0 <= b; --b){
+            for(const auto &x : X){
+                key = (key << 1) | static_cast<uint64_t>((x >> b) & 1U);
+            }
+        }
+        return key;
+    }
+
+    // Order the given centres along a Hilbert curve spanning their extent.
+    template <class T>
+    std::vector<size_t> rtree_hilbert_order(const std::vector<vec3<T>> &centres){
+        const size_t N = centres.size();
+        vec3<T> lo = centres.front();
+        vec3<T> hi = centres.front();
+        for(const auto &c : centres){
+            lo.x = std::min(lo.x, c.x); hi.x = std::max(hi.x, c.x);
+            lo.y = std::min(lo.y, c.y); hi.y = std::max(hi.y, c.y);
+            lo.z = std::min(lo.z, c.z); hi.z = std::max(hi.z, c.z);
+        }
+
+        const double max_cell = static_cast<double>((static_cast<uint32_t>(1) << 21) - 1);
+        const auto quantize = [max_cell](T x, T x_lo, T x_hi) -> uint32_t {
+            const double w = static_cast<double>(x_hi) - static_cast<double>(x_lo);
+            if(!(0.0 < w)) return 0U;
+            const double f = (static_cast<double>(x) - static_cast<double>(x_lo)) / w;
+            return static_cast<uint32_t>(std::clamp(f * max_cell, 0.0, max_cell));
+        };
+
+        std::vector<std::pair<uint64_t, size_t>> keyed(N);
+        for(size_t i = 0; i < N; ++i){
+            const auto &c = centres[i];
+            keyed[i].first = rtree_hilbert_key({{ quantize(c.x, lo.x, hi.x),
+                                                  quantize(c.y, lo.y, hi.y),
+                                                  quantize(c.z, lo.z, hi.z) }});
+            keyed[i].second = i;
+        }
+        rtree_parallel_sort(keyed.begin(), keyed.end(), std::less<>(), rtree_spawn_depth());
+
+        std::vector<size_t> order(N);
+        for(size_t i = 0; i < N; ++i) order[i] = keyed[i].second;
+        return order;
+    }
+
+    // Split N consecutive items into groups holding 'capacity' items each. If the final group would hold fewer than
+    // 'min_size' items, the final two groups are balanced instead. Returns the group boundaries.
+    std::vector<size_t> rtree_pack_groups(size_t N, size_t capacity, size_t min_size){
+        std::vector<size_t> bounds;
+        for(size_t i = 0; i < N; i += capacity) bounds.push_back(i);
+        bounds.push_back(N);
+
+        const size_t N_groups = bounds.size() - 1;
+        if(2 <= N_groups){
+            const size_t last = N - bounds[N_groups - 1];
+            if(last < min_size){
+                const size_t pair_begin = bounds[N_groups - 2];
+                bounds[N_groups - 1] = pair_begin + (N - pair_begin + 1) / 2;
+            }
+        }
+        return bounds;
+    }
+
+    // Plain comparisons are exact for finite coordinates, so these are equivalent to the index_bbox members but are
+    // considerably cheaper when packing many nodes or descending the tree.
+    template <class T>
+    void rtree_fast_expand(index_bbox<T> &a, const index_bbox<T> &b){
+        a.min.x = std::min(a.min.x, b.min.x); a.max.x = std::max(a.max.x, b.max.x);
+        a.min.y = std::min(a.min.y, b.min.y); a.max.y = std::max(a.max.y, b.max.y);
+        a.min.z = std::min(a.min.z, b.min.z); a.max.z = std::max(a.max.z, b.max.z);
+    }
+
+    template <class T>
+    T rtree_fast_sq_dist(const index_bbox<T> &a, const index_bbox<T> &b){
+        const T zero = static_cast<T>(0);
+        const T dx = std::max(std::max(b.min.x - a.max.x, a.min.x - b.max.x), zero);
+        const T dy = std::max(std::max(b.min.y - a.max.y, a.min.y - b.max.y), zero);
+        const T dz = std::max(std::max(b.min.z - a.max.z, a.min.z - b.max.z), zero);
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    template <class T>
+    bool rtree_fast_contains(const index_bbox<T> &outer, const index_bbox<T> &inner){
+        return (outer.min.x <= inner.min.x) && (inner.max.x <= outer.max.x)
+            && (outer.min.y <= inner.min.y) && (inner.max.y <= outer.max.y)
+            && (outer.min.z <= inner.min.z) && (inner.max.z <= outer.max.z);
+    }
+
+} // namespace
+
 //------------------------------------------------------ Constructors -------------------------------------------------------
 
 // R*-tree reinsertion percentage (fraction of entries to reinsert on overflow).
 // Beckmann et al. recommend 30% for optimal R*-tree performance.
 constexpr double RTREE_REINSERT_FRACTION = 0.3;
 
-template <class T>
-rtree<T>::rtree() : root(std::make_unique<leaf_node>()),
+template <class T, class Payload>
+rtree<T, Payload>::rtree() : root(std::make_unique<leaf_node>()),
                     max_entries(8), min_entries(4), height(0), entry_count(0),
                     reinsert_count(3), in_reinsertion(false) { }
 
-template <class T>
-rtree<T>::rtree(size_t max_node_entries)
+template <class T, class Payload>
+rtree<T, Payload>::rtree(size_t max_node_entries)
     : max_entries(max_node_entries), min_entries(max_node_entries / 2),
       height(0), entry_count(0), in_reinsertion(false) {
     if(max_entries < 2) {
@@ -47,28 +268,28 @@ rtree<T>::rtree(size_t max_node_entries)
     root = std::make_unique<leaf_node>();
 }
 
-template <class T>
-rtree<T>::~rtree() = default;
+template <class T, class Payload>
+rtree<T, Payload>::~rtree() = default;
 
 //------------------------------------------------------ Member functions ---------------------------------------------------
 
-template <class T>
-void rtree<T>::insert(const vec3<T> &point) {
-    insert(point, std::any{});
+template <class T, class Payload>
+void rtree<T, Payload>::insert(const vec3<T> &point) {
+    insert(point, Payload{});
 }
 
-template <class T>
-void rtree<T>::insert(const vec3<T> &point, std::any aux_data) {
+template <class T, class Payload>
+void rtree<T, Payload>::insert(const vec3<T> &point, Payload aux_data) {
     insert(bbox(point, point), std::move(aux_data));
 }
 
-template <class T>
-void rtree<T>::insert(const bbox &bb) {
-    insert(bb, std::any{});
+template <class T, class Payload>
+void rtree<T, Payload>::insert(const bbox &bb) {
+    insert(bb, Payload{});
 }
 
-template <class T>
-void rtree<T>::insert(const bbox &bb, std::any aux_data) {
+template <class T, class Payload>
+void rtree<T, Payload>::insert(const bbox &bb, Payload aux_data) {
     if(!bb.isfinite()) {
         throw std::invalid_argument("Cannot insert non-finite bbox into rtree");
     }
@@ -77,8 +298,296 @@ void rtree<T>::insert(const bbox &bb, std::any aux_data) {
     insert_entry_at_leaf(entry(bb, std::move(aux_data)));
 }
 
-template <class T>
-void rtree<T>::insert_entry_at_leaf(const entry &e) {
+template <class T, class Payload>
+bool rtree<T, Payload>::remove(const bbox &bb) {
+    return remove(bb, [](const entry &) { return true; });
+}
+
+template <class T, class Payload>
+bool rtree<T, Payload>::remove(const bbox &bb, const visitor &matches) {
+    const auto [leaf, pos] = find_entry(root.get(), bb, matches);
+    if(leaf == nullptr) {
+        return false;
+    }
+
+    leaf->entries.erase(leaf->entries.begin() + static_cast<std::ptrdiff_t>(pos));
+    entry_count--;
+    condense_tree(leaf);
+    return true;
+}
+
+template <class T, class Payload>
+bool rtree<T, Payload>::remove(const vec3<T> &point) {
+    return remove(bbox(point, point));
+}
+
+template <class T, class Payload>
+bool rtree<T, Payload>::update(const bbox &old_box, const bbox &new_box, Payload aux_data) {
+    return update(old_box, new_box, std::move(aux_data), [](const entry &) { return true; });
+}
+
+template <class T, class Payload>
+bool rtree<T, Payload>::update(const bbox &old_box, const bbox &new_box, Payload aux_data, const visitor &matches) {
+    if(!new_box.isfinite()) {
+        throw std::invalid_argument("Cannot insert non-finite bbox into rtree");
+    }
+
+    const auto [leaf, pos] = find_entry(root.get(), old_box, matches);
+    if(leaf == nullptr) {
+        return false;
+    }
+
+    if(rtree_fast_contains(leaf->bounds, new_box)) {
+        // The parent's view of this leaf remains valid, so adjust in place. Bounds can only shrink.
+        leaf->entries[pos] = entry(new_box, std::move(aux_data));
+        for(node_base* node = leaf; node != nullptr; node = node->parent) {
+            update_bounds(node);
+        }
+        return true;
+    }
+
+    leaf->entries.erase(leaf->entries.begin() + static_cast<std::ptrdiff_t>(pos));
+    entry_count--;
+    condense_tree(leaf);
+
+    in_reinsertion = false;
+    insert_entry_at_leaf(entry(new_box, std::move(aux_data)));
+    return true;
+}
+
+template <class T, class Payload>
+std::pair<typename rtree<T, Payload>::leaf_node*, size_t>
+rtree<T, Payload>::find_entry(node_base* node, const bbox &bb, const visitor &matches) {
+    if(!rtree_fast_contains(node->bounds, bb)) {
+        return { nullptr, 0 };
+    }
+
+    if(node->is_leaf()) {
+        leaf_node* leaf = static_cast<leaf_node*>(node);
+        for(size_t i = 0; i < leaf->entries.size(); ++i) {
+            if((leaf->entries[i].box == bb) && matches(leaf->entries[i])) {
+                return { leaf, i };
+            }
+        }
+        return { nullptr, 0 };
+    }
+
+    internal_node* internal = static_cast<internal_node*>(node);
+    for(auto& child : internal->children) {
+        const auto found = find_entry(child.get(), bb, matches);
+        if(found.first != nullptr) {
+            return found;
+        }
+    }
+    return { nullptr, 0 };
+}
+
+template <class T, class Payload>
+void rtree<T, Payload>::condense_tree(leaf_node* leaf) {
+    std::vector<entry> orphaned_entries;
+    std::vector<std::pair<std::unique_ptr<node_base>, size_t>> orphaned_subtrees;
+
+    // Walk up to the root, detaching under-full nodes.
+    node_base* node = leaf;
+    size_t node_height = 0;
+    while(node != root.get()) {
+        internal_node* parent = node->parent;
+
+        const size_t occupancy = node->is_leaf() ? static_cast<leaf_node*>(node)->entries.size()
+                                                 : static_cast<internal_node*>(node)->children.size();
+        if(occupancy < min_entries) {
+            auto it = std::find_if(parent->children.begin(), parent->children.end(),
+                                   [node](const std::unique_ptr<node_base> &c) { return c.get() == node; });
+            if(it == parent->children.end()) {
+                throw std::logic_error("Node not found in its parent; rtree is corrupt");
+            }
+            std::unique_ptr<node_base> detached = std::move(*it);
+            parent->children.erase(it);
+            detached->parent = nullptr;
+
+            if(detached->is_leaf()) {
+                auto& entries = static_cast<leaf_node*>(detached.get())->entries;
+                std::move(entries.begin(), entries.end(), std::back_inserter(orphaned_entries));
+            } else {
+                auto& children = static_cast<internal_node*>(detached.get())->children;
+                for(auto& child : children) {
+                    child->parent = nullptr;
+                    orphaned_subtrees.emplace_back(std::move(child), node_height - 1);
+                }
+            }
+        } else {
+            update_bounds(node);
+        }
+
+        node = parent;
+        ++node_height;
+    }
+    update_bounds(root.get());
+
+    // A root left without children is replaced by an empty leaf.
+    if(!root->is_leaf() && static_cast<internal_node*>(root.get())->children.empty()) {
+        root = std::make_unique<leaf_node>();
+        height = 0;
+    }
+
+    // Reinsert the orphans. Subtrees are reinserted whole so their leaves remain on the leaf level.
+    for(auto& subtree : orphaned_subtrees) {
+        insert_subtree(std::move(subtree.first), subtree.second);
+    }
+    entry_count -= orphaned_entries.size();
+    for(const auto& e : orphaned_entries) {
+        in_reinsertion = false;
+        insert_entry_at_leaf(e);
+    }
+
+    // Shorten the tree while the root has a single child.
+    while(!root->is_leaf() && (static_cast<internal_node*>(root.get())->children.size() == 1)) {
+        std::unique_ptr<node_base> child = std::move(static_cast<internal_node*>(root.get())->children.front());
+        child->parent = nullptr;
+        root = std::move(child);
+        height--;
+    }
+}
+
+template <class T, class Payload>
+void rtree<T, Payload>::insert_subtree(std::unique_ptr<node_base> subtree, size_t subtree_height) {
+    // If the tree is no taller than the subtree there is no suitable parent, so reinsert the entries individually.
+    if(height <= subtree_height) {
+        std::vector<entry> entries;
+        std::function<void(node_base*)> collect = [&](node_base* node) {
+            if(node->is_leaf()) {
+                auto& leaf_entries = static_cast<leaf_node*>(node)->entries;
+                std::move(leaf_entries.begin(), leaf_entries.end(), std::back_inserter(entries));
+            } else {
+                for(auto& child : static_cast<internal_node*>(node)->children) {
+                    collect(child.get());
+                }
+            }
+        };
+        collect(subtree.get());
+
+        entry_count -= entries.size();
+        for(const auto& e : entries) {
+            in_reinsertion = false;
+            insert_entry_at_leaf(e);
+        }
+        return;
+    }
+
+    const size_t parent_level = height - subtree_height - 1;
+    internal_node* parent = static_cast<internal_node*>(choose_subtree(root.get(), subtree->bounds, parent_level, 0));
+    subtree->parent = parent;
+    parent->children.push_back(std::move(subtree));
+    update_bounds(parent);
+
+    if(parent->children.size() > max_entries) {
+        auto split_result = overflow_treatment(parent, parent == root.get());
+        adjust_tree(parent, std::move(split_result));
+    } else {
+        adjust_tree(parent, nullptr);
+    }
+}
+
+template <class T, class Payload>
+void rtree<T, Payload>::bulk_load(std::vector<entry> entries, bulk_load_method method) {
+    for(const auto &e : entries) {
+        if(!e.box.isfinite()) {
+            throw std::invalid_argument("Cannot insert non-finite bbox into rtree");
+        }
+    }
+
+    clear();
+    const size_t N = entries.size();
+    if(N == 0) {
+        return;
+    }
+
+    const auto centre_of = [](const bbox &b) {
+        return vec3<T>((b.min.x + b.max.x) / static_cast<T>(2),
+                       (b.min.y + b.max.y) / static_cast<T>(2),
+                       (b.min.z + b.max.z) / static_cast<T>(2));
+    };
+
+    // Order the items on a level so that consecutive groups are spatially compact.
+    // For Hilbert packing, the upper levels simply retain the order of the level below.
+    const auto order_level = [&](const std::vector<vec3<T>> &centres, bool is_leaf_level) {
+        if(method == bulk_load_method::hilbert) {
+            if(is_leaf_level) {
+                return rtree_hilbert_order(centres);
+            }
+            std::vector<size_t> order(centres.size());
+            std::iota(std::begin(order), std::end(order), static_cast<size_t>(0));
+            return order;
+        }
+        return rtree_str_order(centres, max_entries);
+    };
+
+    // Pack the leaves.
+    std::vector<std::unique_ptr<node_base>> level;
+    {
+        std::vector<vec3<T>> centres;
+        centres.reserve(N);
+        for(const auto &e : entries) {
+            centres.push_back(centre_of(e.box));
+        }
+        const auto order = order_level(centres, true);
+        const auto groups = rtree_pack_groups(N, max_entries, min_entries);
+
+        level.reserve(groups.size() - 1);
+        for(size_t g = 0; (g + 1) < groups.size(); ++g) {
+            auto leaf = std::make_unique<leaf_node>();
+            leaf->entries.reserve(groups[g + 1] - groups[g]);
+            for(size_t i = groups[g]; i < groups[g + 1]; ++i) {
+                leaf->entries.push_back(std::move(entries[order[i]]));
+            }
+            leaf->bounds = leaf->entries.front().box;
+            for(const auto &e : leaf->entries) {
+                rtree_fast_expand(leaf->bounds, e.box);
+            }
+            level.push_back(std::move(leaf));
+        }
+    }
+    entries.clear();
+
+    // Pack the internal levels until a single root remains.
+    size_t level_count = 0;
+    while(1 < level.size()) {
+        std::vector<vec3<T>> centres;
+        centres.reserve(level.size());
+        for(const auto &n : level) {
+            centres.push_back(centre_of(n->bounds));
+        }
+        const auto order = order_level(centres, false);
+        const auto groups = rtree_pack_groups(level.size(), max_entries, min_entries);
+
+        std::vector<std::unique_ptr<node_base>> next_level;
+        next_level.reserve(groups.size() - 1);
+        for(size_t g = 0; (g + 1) < groups.size(); ++g) {
+            auto internal = std::make_unique<internal_node>();
+            internal->children.reserve(groups[g + 1] - groups[g]);
+            for(size_t i = groups[g]; i < groups[g + 1]; ++i) {
+                auto &child = level[order[i]];
+                child->parent = internal.get();
+                internal->children.push_back(std::move(child));
+            }
+            internal->bounds = internal->children.front()->bounds;
+            for(const auto &child : internal->children) {
+                rtree_fast_expand(internal->bounds, child->bounds);
+            }
+            next_level.push_back(std::move(internal));
+        }
+        level.swap(next_level);
+        ++level_count;
+    }
+
+    root = std::move(level.front());
+    root->parent = nullptr;
+    height = level_count;
+    entry_count = N;
+}
+
+template <class T, class Payload>
+void rtree<T, Payload>::insert_entry_at_leaf(const entry &e) {
     leaf_node* leaf = choose_leaf(e.box);
 
     leaf->entries.push_back(e);
@@ -96,8 +605,8 @@ void rtree<T>::insert_entry_at_leaf(const entry &e) {
     }
 }
 
-template <class T>
-typename rtree<T>::node_base* rtree<T>::choose_subtree(node_base* node, const bbox &entry_box,
+template <class T, class Payload>
+typename rtree<T, Payload>::node_base* rtree<T, Payload>::choose_subtree(node_base* node, const bbox &entry_box,
                                                        size_t target_level, size_t current_level) {
     if(current_level == target_level) {
         return node;
@@ -173,13 +682,13 @@ typename rtree<T>::node_base* rtree<T>::choose_subtree(node_base* node, const bb
     return choose_subtree(best_child, entry_box, target_level, current_level + 1);
 }
 
-template <class T>
-typename rtree<T>::leaf_node* rtree<T>::choose_leaf(const bbox &entry_box) {
+template <class T, class Payload>
+typename rtree<T, Payload>::leaf_node* rtree<T, Payload>::choose_leaf(const bbox &entry_box) {
     return static_cast<leaf_node*>(choose_subtree(root.get(), entry_box, height, 0));
 }
 
-template <class T>
-std::unique_ptr<typename rtree<T>::node_base> rtree<T>::overflow_treatment(node_base* node, bool is_root) {
+template <class T, class Payload>
+std::unique_ptr<typename rtree<T, Payload>::node_base> rtree<T, Payload>::overflow_treatment(node_base* node, bool is_root) {
     if(!is_root && !in_reinsertion && node->is_leaf()) {
         in_reinsertion = true;
         reinsert_leaf(static_cast<leaf_node*>(node));
@@ -192,8 +701,8 @@ std::unique_ptr<typename rtree<T>::node_base> rtree<T>::overflow_treatment(node_
     return split_internal_node(static_cast<internal_node*>(node));
 }
 
-template <class T>
-void rtree<T>::reinsert_leaf(leaf_node* node) {
+template <class T, class Payload>
+void rtree<T, Payload>::reinsert_leaf(leaf_node* node) {
     const vec3<T> center = node->bounds.center();
 
     std::vector<std::pair<T, entry>> sorted_entries;
@@ -226,8 +735,8 @@ void rtree<T>::reinsert_leaf(leaf_node* node) {
     }
 }
 
-template <class T>
-std::unique_ptr<typename rtree<T>::leaf_node> rtree<T>::split_leaf_node(leaf_node* node) {
+template <class T, class Payload>
+std::unique_ptr<typename rtree<T, Payload>::leaf_node> rtree<T, Payload>::split_leaf_node(leaf_node* node) {
     auto new_leaf = std::make_unique<leaf_node>();
 
     std::vector<bbox> entry_boxes;
@@ -266,8 +775,48 @@ std::unique_ptr<typename rtree<T>::leaf_node> rtree<T>::split_leaf_node(leaf_nod
     return new_leaf;
 }
 
-template <class T>
-int rtree<T>::choose_split_axis(const std::vector<bbox> &entries) const {
+template <class T, class Payload>
+bool rtree<T, Payload>::join_recursive(const node_base* a, const node_base* b, T max_sq_dist,
+                                       join_batch &batch, const join_flush &flush) const {
+    if(max_sq_dist < rtree_fast_sq_dist(a->bounds, b->bounds)) return true;
+
+    if(a->is_leaf() && b->is_leaf()){
+        const auto &entries_a = static_cast<const leaf_node*>(a)->entries;
+        const auto &entries_b = static_cast<const leaf_node*>(b)->entries;
+        for(const auto &e_a : entries_a){
+            if(max_sq_dist < rtree_fast_sq_dist(e_a.box, b->bounds)) continue;
+            for(const auto &e_b : entries_b){
+                if(rtree_fast_sq_dist(e_a.box, e_b.box) <= max_sq_dist){
+                    batch.emplace_back(&e_a, &e_b);
+                    if((rtree_join_batch_size <= batch.size()) && !flush(batch)) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Descend both trees together where possible, otherwise descend whichever has not yet reached the leaves.
+    if(!a->is_leaf() && !b->is_leaf()){
+        for(const auto &c_a : static_cast<const internal_node*>(a)->children){
+            if(max_sq_dist < rtree_fast_sq_dist(c_a->bounds, b->bounds)) continue;
+            for(const auto &c_b : static_cast<const internal_node*>(b)->children){
+                if(!join_recursive(c_a.get(), c_b.get(), max_sq_dist, batch, flush)) return false;
+            }
+        }
+    }else if(!a->is_leaf()){
+        for(const auto &c_a : static_cast<const internal_node*>(a)->children){
+            if(!join_recursive(c_a.get(), b, max_sq_dist, batch, flush)) return false;
+        }
+    }else{
+        for(const auto &c_b : static_cast<const internal_node*>(b)->children){
+            if(!join_recursive(a, c_b.get(), max_sq_dist, batch, flush)) return false;
+        }
+    }
+    return true;
+}
+
+template <class T, class Payload>
+int rtree<T, Payload>::choose_split_axis(const std::vector<bbox> &entries) const {
     T min_margin_sum = std::numeric_limits<T>::max();
     int best_axis = 0;
 
@@ -349,8 +898,8 @@ int rtree<T>::choose_split_axis(const std::vector<bbox> &entries) const {
     return best_axis;
 }
 
-template <class T>
-size_t rtree<T>::choose_split_index(const std::vector<bbox> &entries, int axis) const {
+template <class T, class Payload>
+size_t rtree<T, Payload>::choose_split_index(const std::vector<bbox> &entries, int axis) const {
     T min_overlap = std::numeric_limits<T>::max();
     T min_volume = std::numeric_limits<T>::max();
     size_t best_k = (entries.size() + 1) / 2;
@@ -404,8 +953,8 @@ size_t rtree<T>::choose_split_index(const std::vector<bbox> &entries, int axis)
     return best_k;
 }
 
-template <class T>
-void rtree<T>::adjust_tree(node_base* node, std::unique_ptr<node_base> split_node_ptr) {
+template <class T, class Payload>
+void rtree<T, Payload>::adjust_tree(node_base* node, std::unique_ptr<node_base> split_node_ptr) {
     while(node != root.get()) {
         internal_node* parent = node->parent;
 
@@ -452,8 +1001,8 @@ void rtree<T>::adjust_tree(node_base* node, std::unique_ptr<node_base> split_nod
     }
 }
 
-template <class T>
-std::unique_ptr<typename rtree<T>::internal_node> rtree<T>::split_internal_node(internal_node* node) {
+template <class T, class Payload>
+std::unique_ptr<typename rtree<T, Payload>::internal_node> rtree<T, Payload>::split_internal_node(internal_node* node) {
     auto new_internal = std::make_unique<internal_node>();
 
     std::vector<bbox> child_boxes;
@@ -498,17 +1047,25 @@ std::unique_ptr<typename rtree<T>::internal_node> rtree<T>::split_internal_node(
     return new_internal;
 }
 
-template <class T>
-std::vector<typename rtree<T>::entry> rtree<T>::search(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<typename rtree<T, Payload>::entry> rtree<T, Payload>::search(const bbox &query_box) const {
     std::vector<entry> results;
+    search(query_box, [&](const entry &e) {
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void rtree<T, Payload>::search(const bbox &query_box, const visitor &f) const {
     if(root != nullptr) {
-        search_recursive(root.get(), query_box, results);
+        search_recursive(root.get(), query_box, f);
     }
-    return results;
 }
 
-template <class T>
-std::vector<vec3<T>> rtree<T>::search_points(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<vec3<T>> rtree<T, Payload>::search_points(const bbox &query_box) const {
     auto entries = search(query_box);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -520,8 +1077,8 @@ std::vector<vec3<T>> rtree<T>::search_points(const bbox &query_box) const {
     return results;
 }
 
-template <class T>
-std::vector<typename rtree<T>::bbox> rtree<T>::search_bboxes(const bbox &query_box) const {
+template <class T, class Payload>
+std::vector<typename rtree<T, Payload>::bbox> rtree<T, Payload>::search_bboxes(const bbox &query_box) const {
     auto entries = search(query_box);
     std::vector<bbox> results;
     results.reserve(entries.size());
@@ -531,8 +1088,8 @@ std::vector<typename rtree<T>::bbox> rtree<T>::search_bboxes(const bbox &query_b
     return results;
 }
 
-template <class T>
-std::vector<typename rtree<T>::bbox> rtree<T>::search_bboxes(const vec3<T> &query_point) const {
+template <class T, class Payload>
+std::vector<typename rtree<T, Payload>::bbox> rtree<T, Payload>::search_bboxes(const vec3<T> &query_point) const {
     auto entries = search(bbox(query_point, query_point));
     std::vector<bbox> results;
     results.reserve(entries.size());
@@ -544,47 +1101,53 @@ std::vector<typename rtree<T>::bbox> rtree<T>::search_bboxes(const vec3<T> &quer
     return results;
 }
 
-template <class T>
-void rtree<T>::search_recursive(const node_base* node, const bbox &query_box, std::vector<entry> &results) const {
+template <class T, class Payload>
+bool rtree<T, Payload>::search_recursive(const node_base* node, const bbox &query_box, const visitor &f) const {
     if(!node->bounds.intersects(query_box)) {
-        return;
+        return true;
     }
 
     if(node->is_leaf()) {
         const leaf_node* leaf = static_cast<const leaf_node*>(node);
         for(const auto& e : leaf->entries) {
-            if(e.box.intersects(query_box)) {
-                results.push_back(e);
+            if(e.box.intersects(query_box) && !f(e)) {
+                return false;
             }
         }
     } else {
         const internal_node* internal = static_cast<const internal_node*>(node);
         for(const auto& child : internal->children) {
-            search_recursive(child.get(), query_box, results);
+            if(!search_recursive(child.get(), query_box, f)) {
+                return false;
+            }
         }
     }
+    return true;
 }
 
-template <class T>
-std::vector<typename rtree<T>::entry> rtree<T>::search_radius(const vec3<T> &center, T radius) const {
+template <class T, class Payload>
+std::vector<typename rtree<T, Payload>::entry> rtree<T, Payload>::search_radius(const vec3<T> &center, T radius) const {
+    std::vector<entry> results;
+    search_radius(center, radius, [&](const entry &e) {
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void rtree<T, Payload>::search_radius(const vec3<T> &center, T radius, const visitor &f) const {
     vec3<T> offset(radius, radius, radius);
     bbox query_box(center - offset, center + offset);
 
-    auto candidates = search(query_box);
-
-    std::vector<entry> results;
     const T radius_sq = radius * radius;
-    for(const auto& e : candidates) {
-        if(e.box.squared_distance_to(center) <= radius_sq) {
-            results.push_back(e);
-        }
-    }
-
-    return results;
+    search(query_box, [&](const entry &e) {
+        return (radius_sq < e.box.squared_distance_to(center)) || f(e);
+    });
 }
 
-template <class T>
-std::vector<vec3<T>> rtree<T>::search_radius_points(const vec3<T> &center, T radius) const {
+template <class T, class Payload>
+std::vector<vec3<T>> rtree<T, Payload>::search_radius_points(const vec3<T> &center, T radius) const {
     auto entries = search_radius(center, radius);
     std::vector<vec3<T>> results;
     results.reserve(entries.size());
@@ -596,15 +1159,25 @@ std::vector<vec3<T>> rtree<T>::search_radius_points(const vec3<T> &center, T rad
     return results;
 }
 
-template <class T>
-std::vector<typename rtree<T>::entry> rtree<T>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
-    std::vector<std::pair<T, entry>> all_entries;
+template <class T, class Payload>
+std::vector<typename rtree<T, Payload>::entry> rtree<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k) const {
+    std::vector<entry> results;
+    nearest_neighbors(query_point, k, [&](const entry &e, T) {
+        results.push_back(e);
+        return true;
+    });
+    return results;
+}
+
+template <class T, class Payload>
+void rtree<T, Payload>::nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const {
+    std::vector<std::pair<T, const entry*>> all_entries;
 
     std::function<void(const node_base*)> collect_all = [&](const node_base* node) {
         if(node->is_leaf()) {
             const leaf_node* leaf = static_cast<const leaf_node*>(node);
             for(const auto& e : leaf->entries) {
-                all_entries.emplace_back(e.box.squared_distance_to(query_point), e);
+                all_entries.emplace_back(e.box.squared_distance_to(query_point), &e);
             }
         } else {
             const internal_node* internal = static_cast<const internal_node*>(node);
@@ -621,37 +1194,106 @@ std::vector<typename rtree<T>::entry> rtree<T>::nearest_neighbors(const vec3<T>
     std::sort(all_entries.begin(), all_entries.end(),
               [](const auto& a, const auto& b) { return a.first < b.first; });
 
-    std::vector<entry> results;
     const size_t count = std::min(k, all_entries.size());
     for(size_t i = 0; i < count; ++i) {
-        results.push_back(all_entries[i].second);
+        if(!f(*(all_entries[i].second), all_entries[i].first)) {
+            return;
+        }
     }
-
-    return results;
 }
 
-template <class T>
-std::vector<vec3<T>> rtree<T>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
-    if(k == 0) return {};
-    auto entries = nearest_neighbors(query_point, entry_count);
+template <class T, class Payload>
+std::vector<vec3<T>> rtree<T, Payload>::nearest_neighbors_points(const vec3<T> &query_point, size_t k) const {
     std::vector<vec3<T>> results;
-    results.reserve(std::min(k, entries.size()));
-    for(const auto& e : entries) {
+    if(k == 0) return results;
+    nearest_neighbors(query_point, entry_count, [&](const entry &e, T) {
         if(!e.box.has_extent()) {
             results.push_back(e.box.min);
-            if(results.size() == k) break;
         }
-    }
+        return (results.size() < k);
+    });
     return results;
 }
 
-template <class T>
-bool rtree<T>::contains(const vec3<T> &point) const {
+template <class T, class Payload>
+void rtree<T, Payload>::join_intersecting(const rtree &other, const pair_visitor &f) const {
+    join_within_distance(other, static_cast<T>(0), f);
+}
+
+template <class T, class Payload>
+void rtree<T, Payload>::join_within_distance(const rtree &other, T distance, const pair_visitor &f) const {
+    if((entry_count == 0) || (other.entry_count == 0) || !(static_cast<T>(0) <= distance)) return;
+    const T max_sq_dist = distance * distance;
+
+    // Divide the join into independent pairs of subtrees by descending level by level.
+    using task_t = std::pair<const node_base*, const node_base*>;
+    const size_t N_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    const bool parallel = (1 < N_threads) && (rtree_parallel_threshold <= (entry_count + other.entry_count));
+    std::vector<task_t> tasks = {{ root.get(), other.root.get() }};
+    while(parallel && (tasks.size() < 16 * N_threads)){
+        std::vector<task_t> next;
+        bool split_any = false;
+        for(const auto &t : tasks){
+            const auto a = t.first;
+            const auto b = t.second;
+            std::vector<const node_base*> children_a = { a };
+            std::vector<const node_base*> children_b = { b };
+            if(!a->is_leaf()){
+                children_a.clear();
+                for(const auto &c : static_cast<const internal_node*>(a)->children) children_a.push_back(c.get());
+            }
+            if(!b->is_leaf()){
+                children_b.clear();
+                for(const auto &c : static_cast<const internal_node*>(b)->children) children_b.push_back(c.get());
+            }
+            split_any = split_any || !a->is_leaf() || !b->is_leaf();
+            for(const auto c_a : children_a){
+                for(const auto c_b : children_b){
+                    if(!(max_sq_dist < rtree_fast_sq_dist(c_a->bounds, c_b->bounds))) next.emplace_back(c_a, c_b);
+                }
+            }
+        }
+        tasks.swap(next);
+        if(!split_any) break;
+    }
+
+    std::mutex visitor_mutex;
+    std::atomic<bool> stopped(false);
+    std::atomic<size_t> next_task(0);
+    const join_flush flush = [&](join_batch &batch){
+        std::lock_guard<std::mutex> lock(visitor_mutex);
+        for(const auto &p : batch){
+            if(stopped.load(std::memory_order_relaxed)) break;
+            if(!f(*(p.first), *(p.second))) stopped.store(true);
+        }
+        batch.clear();
+        return !stopped.load(std::memory_order_relaxed);
+    };
+    const auto worker = [&](){
+        join_batch batch;
+        batch.reserve(rtree_join_batch_size);
+        for(size_t i = next_task++; (i < tasks.size()) && !stopped.load(); i = next_task++){
+            if(!join_recursive(tasks[i].first, tasks[i].second, max_sq_dist, batch, flush)) return;
+        }
+        if(!batch.empty()) flush(batch);
+    };
+
+    std::vector<std::future<void>> futs;
+    for(size_t t = 1; parallel && (t < N_threads); ++t){
+        futs.emplace_back(std::async(std::launch::async, worker));
+    }
+    worker();
+    for(auto &fut : futs) fut.get();
+    return;
+}
+
+template <class T, class Payload>
+bool rtree<T, Payload>::contains(const vec3<T> &point) const {
     return contains(bbox(point, point));
 }
 
-template <class T>
-bool rtree<T>::contains(const bbox &bb) const {
+template <class T, class Payload>
+bool rtree<T, Payload>::contains(const bbox &bb) const {
     auto results = search(bb);
     for(const auto& result : results) {
         if(result.box == bb) {
@@ -661,16 +1303,16 @@ bool rtree<T>::contains(const bbox &bb) const {
     return false;
 }
 
-template <class T>
-void rtree<T>::clear() {
+template <class T, class Payload>
+void rtree<T, Payload>::clear() {
     root = std::make_unique<leaf_node>();
     height = 0;
     entry_count = 0;
     in_reinsertion = false;
 }
 
-template <class T>
-void rtree<T>::update_bounds(node_base* node) {
+template <class T, class Payload>
+void rtree<T, Payload>::update_bounds(node_base* node) {
     if(node->is_leaf()) {
         leaf_node* leaf = static_cast<leaf_node*>(node);
         if(!leaf->entries.empty()) {
@@ -694,18 +1336,18 @@ void rtree<T>::update_bounds(node_base* node) {
     }
 }
 
-template <class T>
-size_t rtree<T>::get_size() const {
+template <class T, class Payload>
+size_t rtree<T, Payload>::get_size() const {
     return entry_count;
 }
 
-template <class T>
-size_t rtree<T>::get_height() const {
+template <class T, class Payload>
+size_t rtree<T, Payload>::get_height() const {
     return compute_height(root.get());
 }
 
-template <class T>
-size_t rtree<T>::compute_height(const node_base* node) const {
+template <class T, class Payload>
+size_t rtree<T, Payload>::compute_height(const node_base* node) const {
     if(node == nullptr || node->is_leaf()) {
         return 0;
     }
@@ -718,22 +1360,151 @@ size_t rtree<T>::compute_height(const node_base* node) const {
     return 1 + compute_height(internal->children.front().get());
 }
 
-template <class T>
-typename rtree<T>::bbox rtree<T>::get_bounds() const {
+template <class T, class Payload>
+typename rtree<T, Payload>::bbox rtree<T, Payload>::get_bounds() const {
     if(root != nullptr) {
         return root->bounds;
     }
     return bbox();
 }
 
-template <class T>
-T rtree<T>::bbox_axis_center(const bbox &b, int axis) const {
+template <class T, class Payload>
+bool rtree<T, Payload>::write_to(std::ostream &os) const {
+    if constexpr (!std::is_trivially_copyable<Payload>::value){
+        return false;
+    }else{
+        using mapped = mapped_index<T, Payload>;
+        std::vector<typename mapped::node> flat;
+        std::vector<entry> entries;
+        if((root != nullptr) && (entry_count != 0)){
+            // Number the nodes breadth-first so that siblings are adjacent.
+            std::vector<const node_base*> source;
+            source.push_back(root.get());
+            for(size_t i = 0; i < source.size(); ++i){
+                const node_base* n = source[i];
+                typename mapped::node f;
+                f.min[0] = n->bounds.min.x;
+                f.min[1] = n->bounds.min.y;
+                f.min[2] = n->bounds.min.z;
+                f.max[0] = n->bounds.max.x;
+                f.max[1] = n->bounds.max.y;
+                f.max[2] = n->bounds.max.z;
+                f.begin = 0;
+                f.end = 0;
+                f.first_child = 0;
+                f.child_count = 0;
+                if(!n->is_leaf()){
+                    const auto &children = static_cast<const internal_node*>(n)->children;
+                    f.first_child = source.size();
+                    f.child_count = children.size();
+                    for(const auto &child : children) source.push_back(child.get());
+                }
+                flat.push_back(f);
+            }
+
+            // Store the entries depth-first, so the entries within every subtree are contiguous.
+            entries.reserve(entry_count);
+            const auto assign = [&](const auto &self, size_t i) -> void {
+                flat[i].begin = entries.size();
+                if(flat[i].child_count == 0){
+                    const auto &leaf_entries = static_cast<const leaf_node*>(source[i])->entries;
+                    entries.insert(entries.end(), leaf_entries.begin(), leaf_entries.end());
+                }else{
+                    for(size_t c = 0; c < flat[i].child_count; ++c) self(self, flat[i].first_child + c);
+                }
+                flat[i].end = entries.size();
+            };
+            assign(assign, 0);
+        }
+        return mapped::write(os, mapped_index_kind::rtree, static_cast<uint32_t>(max_entries), flat, entries);
+    }
+}
+
+template <class T, class Payload>
+bool rtree<T, Payload>::read_from(std::istream &is) {
+    if constexpr (!std::is_trivially_copyable<Payload>::value){
+        return false;
+    }else{
+        using mapped = mapped_index<T, Payload>;
+        std::vector<uint64_t> storage;
+        if(!mapped::read(is, storage)) return false;
+
+        std::unique_ptr<node_base> new_root;
+        size_t stored_capacity = 0;
+        size_t stored_size = 0;
+        try{
+            const mapped m(storage.data(), storage.size() * sizeof(uint64_t));
+            stored_capacity = m.get_parameter();
+            stored_size = m.get_size();
+            if( (m.get_kind() != mapped_index_kind::rtree)
+            ||  (stored_capacity < 2) ) return false;
+
+            // Rebuild the nodes, confirming that every leaf is on the same level.
+            const auto *flat = m.get_nodes();
+            const size_t N_nodes = m.get_node_count();
+            size_t N_restored = 0;
+            size_t leaf_level = std::numeric_limits<size_t>::max();
+            const auto restore = [&](const auto &self, size_t i, size_t level) -> std::unique_ptr<node_base> {
+                const auto &f = flat[i];
+                if(N_nodes <= N_restored++) return nullptr;
+
+                std::unique_ptr<node_base> n;
+                if(f.child_count == 0){
+                    if(leaf_level == std::numeric_limits<size_t>::max()) leaf_level = level;
+                    if(leaf_level != level) return nullptr;
+
+                    auto leaf = std::make_unique<leaf_node>();
+                    leaf->entries.reserve(f.end - f.begin);
+                    for(size_t j = f.begin; j < f.end; ++j) leaf->entries.push_back(m.get_entry(j));
+                    n = std::move(leaf);
+                }else{
+                    auto internal = std::make_unique<internal_node>();
+                    internal->children.reserve(f.child_count);
+                    for(size_t c = 0; c < f.child_count; ++c){
+                        auto child = self(self, f.first_child + c, level + 1);
+                        if(child == nullptr) return nullptr;
+                        child->parent = internal.get();
+                        internal->children.push_back(std::move(child));
+                    }
+                    n = std::move(internal);
+                }
+                n->bounds.min = vec3<T>(f.min[0], f.min[1], f.min[2]);
+                n->bounds.max = vec3<T>(f.max[0], f.max[1], f.max[2]);
+                return n;
+            };
+            if(0 < N_nodes){
+                new_root = restore(restore, 0, 0);
+                if((new_root == nullptr) || (N_restored != N_nodes)) return false;
+            }
+
+        }catch(const std::exception &){
+            return false;
+        }
+
+        clear();
+        if(new_root != nullptr) root = std::move(new_root);
+        max_entries = stored_capacity;
+        min_entries = stored_capacity / 2;
+        reinsert_count = std::max(static_cast<size_t>(1),
+                                  static_cast<size_t>(max_entries * RTREE_REINSERT_FRACTION));
+        height = compute_height(root.get());
+        entry_count = stored_size;
+        return true;
+    }
+}
+
+template <class T, class Payload>
+T rtree<T, Payload>::bbox_axis_center(const bbox &b, int axis) const {
     if(axis == 0) return (b.min.x + b.max.x) / static_cast<T>(2);
     if(axis == 1) return (b.min.y + b.max.y) / static_cast<T>(2);
     return (b.min.z + b.max.z) / static_cast<T>(2);
 }
 
 #ifndef YGOR_INDEX_RTREE_DISABLE_ALL_SPECIALIZATIONS
-    template class rtree<float>;
-    template class rtree<double>;
+    template class rtree<float , std::any>;
+    template class rtree<double, std::any>;
+    template class rtree<float , uint32_t>;
+    template class rtree<double, uint32_t>;
+    template class rtree<float , uint64_t>;
+    template class rtree<double, uint64_t>;
 #endif
@@ -40,9 +40,13 @@
 //  - Nearest neighbor queries
 //  - Intersection queries
 //
-// Users can optionally associate auxiliary data (via std::any) with each inserted point.
+// Users can optionally associate auxiliary data with each inserted point. By default this is a std::any, but a plain
+// payload type (e.g., a uint32_t id) can be provided as the second template parameter to avoid type erasure.
 // This auxiliary data is not used during spatial queries but can be retrieved after lookups.
 //
+// Trees with trivially-copyable payloads can be serialized to a flat binary form that can later be read back without
+// reinsertion, or mmap'd and queried in place via mapped_index.
+//
 // Example usage:
 //        rtree<double> tree;
 //        
@@ -60,14 +64,23 @@
 //        auto points = tree.search_points(query_box);  // std::vector<vec3<T>>
 //    
 
-template <class T> class rtree {
+template <class T, class Payload = std::any> class rtree {
     public:
         using value_type = T;
-        using entry = index_entry<T>;
+        using payload_type = Payload;
+        using entry = index_entry<T, Payload>;
         using bbox = index_bbox<T>;
-        using node_base = index_node_base<T>;
-        using internal_node = index_internal_node<T>;
-        using leaf_node = index_leaf_node<T>;
+
+        // Callbacks for the visitor-style queries. Entries are passed by reference, avoiding copies. Returning false stops
+        // the query early.
+        using visitor = std::function<bool(const entry &)>;
+        using distance_visitor = std::function<bool(const entry &, T)>; // Also receives the squared distance.
+
+        // Callback for joins between two trees. It receives an entry from this tree and an entry from the other tree.
+        using pair_visitor = std::function<bool(const entry &, const entry &)>;
+        using node_base = index_node_base<T, Payload>;
+        using internal_node = index_internal_node<T, Payload>;
+        using leaf_node = index_leaf_node<T, Payload>;
         
         //--------------------------------------------------- Data members -------------------------------------------------
         std::unique_ptr<node_base> root;
@@ -97,13 +110,49 @@ template <class T> class rtree {
         void insert(const vec3<T> &point);
         
         // Insert a point with auxiliary data into the tree.
-        void insert(const vec3<T> &point, std::any aux_data);
+        void insert(const vec3<T> &point, Payload aux_data);
         
         // Insert a bbox into the tree (without auxiliary data).
         void insert(const bbox &bb);
 
         // Insert a bbox with auxiliary data into the tree.
-        void insert(const bbox &bb, std::any aux_data);
+        void insert(const bbox &bb, Payload aux_data);
+
+        // Remove a single entry with exactly the given bbox. Returns false if no such entry exists.
+        //
+        // Nodes left with fewer than the minimum number of entries are dissolved and their contents are reinserted, so
+        // the tree remains balanced.
+        bool remove(const bbox &bb);
+
+        // Remove a single entry with exactly the given bbox for which the predicate returns true (e.g., to select an
+        // entry by its auxiliary data). Returns false if no such entry exists.
+        bool remove(const bbox &bb, const visitor &matches);
+
+        // Remove a single point. Returns false if the point is not present.
+        bool remove(const vec3<T> &point);
+
+        // Replace a single entry with exactly the given bbox. Returns false, leaving the tree unaltered, if no such entry
+        // exists.
+        //
+        // When the new bbox stays within the bounds of the containing leaf, the entry is adjusted in place. Otherwise the
+        // entry is removed and the replacement is inserted.
+        bool update(const bbox &old_box, const bbox &new_box, Payload aux_data);
+
+        // As above, but only entries for which the predicate returns true are considered.
+        bool update(const bbox &old_box, const bbox &new_box, Payload aux_data, const visitor &matches);
+
+        // Packing orders for bulk loading.
+        enum class bulk_load_method {
+            sort_tile_recursive, // Tile entries into slabs along x, then y, then z (Leutenegger et al., 1997).
+            hilbert,             // Order entries along a Hilbert curve through their centres (Kamel and Faloutsos, 1994).
+        };
+
+        // Replace the contents of the tree with the given entries.
+        //
+        // Nodes are packed bottom-up, so construction is considerably faster than repeated insertion and the resulting
+        // nodes are full (only the final node on each level may hold fewer entries, but never fewer than the minimum).
+        // Sorting is performed concurrently for large inputs. The tree remains valid for later incremental insertion.
+        void bulk_load(std::vector<entry> entries, bulk_load_method method = bulk_load_method::sort_tile_recursive);
 
         // Search for all entries fully or partially within a bounding box.
         std::vector<entry> search(const bbox &query_box) const;
@@ -121,6 +170,15 @@ template <class T> class rtree {
         
         // Search for all entries fully or partially within a given radius of a center point.
         std::vector<entry> search_radius(const vec3<T> &center, T radius) const;
+
+        // Visit all entries fully or partially within a bounding box.
+        void search(const bbox &query_box, const visitor &f) const;
+
+        // Visit all entries fully or partially within a given radius of a center point.
+        void search_radius(const vec3<T> &center, T radius, const visitor &f) const;
+
+        // Visit the k nearest neighbor entries to a query point, in order of increasing distance.
+        void nearest_neighbors(const vec3<T> &query_point, size_t k, const distance_visitor &f) const;
         
         // Search for all points within a given radius of a center point (returns points only).
         // This function will only return bboxes that represent a single point (i.e., no spatial extent),
@@ -135,6 +193,17 @@ template <class T> class rtree {
         // disregarding bboxes with a volume.
         std::vector<vec3<T>> nearest_neighbors_points(const vec3<T> &query_point, size_t k) const;
         
+        // Visit all pairs of entries, one from this tree and one from the other tree, whose bboxes intersect.
+        //
+        // Both trees are traversed simultaneously, so pairs of subtrees that do not overlap are skipped altogether.
+        // Large joins are split over multiple threads, but the visitor is never invoked concurrently. Pairs are visited
+        // in no particular order. The other tree can be this tree, in which case every entry is paired with itself.
+        void join_intersecting(const rtree &other, const pair_visitor &f) const;
+
+        // Visit all pairs of entries, one from this tree and one from the other tree, whose bboxes are separated by no
+        // more than the given distance. Otherwise as above.
+        void join_within_distance(const rtree &other, T distance, const pair_visitor &f) const;
+        
         // Check if the tree contains a specific point.
         bool contains(const vec3<T> &point) const;
 
@@ -152,6 +221,19 @@ template <class T> class rtree {
         
         // Get the bounding box of all entries in the tree.
         bbox get_bounds() const;
+
+        // Write the tree to a binary stream in the flat form described in YgorIndexMapped.h.
+        //
+        // Returns false if the payload type is not trivially copyable (e.g., std::any) or if the stream enters a fail
+        // state.
+        bool write_to(std::ostream &os) const;
+
+        // Replace the contents of the tree with a tree previously written by write_to(). The node structure and the
+        // node capacity are restored exactly.
+        //
+        // Returns false, leaving the tree unaltered, if the payload type is not trivially copyable or the stream does
+        // not contain a valid serialized rtree of the same coordinate and payload types.
+        bool read_from(std::istream &is);
         
     private:
         //--------------------------------------------------- Helper functions ---------------------------------------------
@@ -178,11 +260,32 @@ template <class T> class rtree {
         // Split a leaf node.
         std::unique_ptr<leaf_node> split_leaf_node(leaf_node* node);
         
+        // Locate the leaf and position of an entry with exactly the given bbox that satisfies the predicate.
+        // Returns a nullptr leaf if there is no such entry.
+        std::pair<leaf_node*, size_t> find_entry(node_base* node, const bbox &bb, const visitor &matches);
+
+        // After removing an entry from a leaf, dissolve under-full nodes along the path to the root, reinsert their
+        // contents, and shorten the tree if the root is left with a single child.
+        void condense_tree(leaf_node* leaf);
+
+        // Reinsert a detached subtree so that its leaves are on the leaf level. 'subtree_height' is the number of levels
+        // below the root of the subtree.
+        void insert_subtree(std::unique_ptr<node_base> subtree, size_t subtree_height);
+
         // Adjust the tree after insertion (propagate changes upward).
         void adjust_tree(node_base* node, std::unique_ptr<node_base> split_node);
         
-        // Recursively search for entries within a bounding box.
-        void search_recursive(const node_base* node, const bbox &query_box, std::vector<entry> &results) const;
+        // Recursively visit entries within a bounding box. Returns false if the visitor stopped the search.
+        bool search_recursive(const node_base* node, const bbox &query_box, const visitor &f) const;
+        
+        // Pairs of entries found by a join, which are passed to the visitor in batches.
+        using join_batch = std::vector<std::pair<const entry*, const entry*>>;
+        using join_flush = std::function<bool(join_batch &)>;
+
+        // Recursively find all pairs of entries from two subtrees whose bboxes are separated by no more than the given
+        // squared distance. The batch is flushed whenever it fills. Returns false if the join should stop.
+        bool join_recursive(const node_base* a, const node_base* b, T max_sq_dist,
+                            join_batch &batch, const join_flush &flush) const;
         
         // Compute the axis along which to split (for R*-tree split algorithm).
         int choose_split_axis(const std::vector<bbox> &entries) const;
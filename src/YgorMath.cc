@@ -18,6 +18,7 @@
 #include <string>      //Needed for stringification routines.
 #include <tuple>       //Needed for Spearman's Rank Correlation Coeff, other statistical routines.
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <random>
@@ -33,6 +34,7 @@
 #include "YgorPlot.h"    //A wrapper used for producing plots of contours.
 #include "YgorStats.h"
 #include "YgorString.h"
+#include "YgorThreadPool.h"
 #include "YgorBase64.h"   //Used for samples_1D metadata serialization.
 
 #include "YgorMathIOOBJ.h"
@@ -8038,20 +8040,113 @@ fv_surface_mesh<T,I>::slice_with_planes(const std::list<plane<T>> &planes) const
         return output;
     }
 
-    // Process each plane separately.
-    size_t plane_index = 0;
-    for(const auto &the_plane : planes){
+    const std::vector<plane<T>> l_planes(std::begin(planes), std::end(planes));
+    const size_t N_planes = l_planes.size();
+    const size_t N_faces = this->faces.size();
+
+    // When all planes are (anti-)parallel, sweep along the common normal. Each face is bucketed by its extent along the
+    // normal so it is only visited for the planes it can possibly cross. Bucketing is conservative, so the result is
+    // identical to visiting every face for every plane.
+    bool use_sweep = (2UL <= N_planes);
+    std::vector<std::vector<size_t>> candidate_faces;
+    if(use_sweep){
+        const auto N_len = l_planes.front().N_0.length();
+        use_sweep = std::isfinite(N_len) && (static_cast<T>(0) < N_len);
+        const vec3<T> n_hat = (use_sweep) ? l_planes.front().N_0 / N_len : vec3<T>();
+
+        // Offsets of the planes along the common normal.
+        std::vector<T> offsets;
+        offsets.reserve(N_planes);
+        T max_dn = static_cast<T>(0); // Largest deviation of any plane normal from the common normal.
+        T max_R = static_cast<T>(0);
+        for(const auto &p : l_planes){
+            if(!use_sweep) break;
+            const auto u = p.N_0.unit();
+            const T dn = std::min( (u - n_hat).length(), (u + n_hat).length() );
+            const T o = n_hat.Dot(p.R_0);
+            use_sweep = std::isfinite(dn) && std::isfinite(o) && (dn < static_cast<T>(1E-3));
+            max_dn = std::max(max_dn, dn);
+            max_R = std::max(max_R, p.R_0.length());
+            offsets.push_back(o);
+        }
+
+        // Projections of the vertices onto the common normal.
+        std::vector<T> projs;
+        T max_V = static_cast<T>(0);
+        if(use_sweep){
+            projs.reserve(this->vertices.size());
+            for(const auto &v : this->vertices){
+                const T s = n_hat.Dot(v);
+                if(!std::isfinite(s)){
+                    use_sweep = false;
+                    break;
+                }
+                projs.push_back(s);
+                max_V = std::max(max_V, v.length());
+            }
+        }
+
+        if(use_sweep){
+            // Padding covers both the normal deviation and floating-point round-off in the signed distances.
+            const T pad = (max_dn + static_cast<T>(64) * std::numeric_limits<T>::epsilon())
+                        * (max_V + max_R + static_cast<T>(1));
+
+            std::vector<size_t> order(N_planes);
+            std::iota(std::begin(order), std::end(order), static_cast<size_t>(0));
+            std::sort(std::begin(order), std::end(order),
+                      [&offsets](size_t a, size_t b){ return offsets[a] < offsets[b]; });
+            std::vector<T> sorted_offsets;
+            sorted_offsets.reserve(N_planes);
+            for(const auto &i : order) sorted_offsets.push_back(offsets[i]);
+
+            // Faces are visited in order, so each bucket remains sorted by face index.
+            candidate_faces.resize(N_planes);
+            for(size_t face_idx = 0; face_idx < N_faces; ++face_idx){
+                const auto &face = this->faces[face_idx];
+                if(face.size() < 2) continue;
+
+                T min_s = std::numeric_limits<T>::infinity();
+                T max_s = -std::numeric_limits<T>::infinity();
+                for(const auto &v_idx : face){
+                    const T s = projs.at(v_idx);
+                    min_s = std::min(min_s, s);
+                    max_s = std::max(max_s, s);
+                }
+                const auto lo = std::lower_bound(std::begin(sorted_offsets), std::end(sorted_offsets), min_s - pad);
+                const auto hi = std::upper_bound(lo, std::end(sorted_offsets), max_s + pad);
+                for(auto it = lo; it != hi; ++it){
+                    const auto plane_idx = order[ std::distance(std::begin(sorted_offsets), it) ];
+                    candidate_faces[plane_idx].push_back(face_idx);
+                }
+            }
+        }
+    }
+
+    using edge_t = std::pair<I,I>;
+    struct edge_hash {
+        size_t operator()(const edge_t &e) const {
+            const auto h_a = static_cast<uint64_t>(std::hash<I>()(e.first));
+            const auto h_b = static_cast<uint64_t>(std::hash<I>()(e.second));
+            return static_cast<size_t>((h_a * 0x9E3779B97F4A7C15ULL) ^ (h_b + 0x7F4A7C159E3779B9ULL + (h_a << 6) + (h_a >> 2)));
+        }
+    };
+
+    // Process a single plane, returning the contours found.
+    const auto slice_plane = [&](size_t plane_index) -> std::list<contour_of_points<T>> {
+        std::list<contour_of_points<T>> contours;
+        const auto &the_plane = l_planes[plane_index];
+
         // For each face, find edges that cross the plane and compute intersection points.
-        // Store edge intersections using a map keyed by ordered vertex pairs to avoid duplicates.
+        // Store edge intersections using a table keyed by ordered vertex pairs to avoid duplicates.
         // Each intersection point is associated with the faces that share the edge.
-        std::map<std::pair<I,I>, vec3<T>> edge_intersections;
+        std::unordered_map<edge_t, vec3<T>, edge_hash> edge_intersections;
         // Map from edge to the faces containing that edge.
-        std::map<std::pair<I,I>, std::vector<size_t>> edge_to_faces;
+        std::unordered_map<edge_t, std::vector<size_t>, edge_hash> edge_to_faces;
 
-        for(size_t face_idx = 0; face_idx < this->faces.size(); ++face_idx){
+        const auto visit_face = [&](size_t face_idx){
             const auto &face = this->faces[face_idx];
             const auto N_verts = face.size();
-            if(N_verts < 2) continue;
+            if(N_verts < 2) return;
 
             // Check each edge of the face.
             for(size_t j = 0; j < N_verts; ++j){
@@ -8086,24 +8181,36 @@ fv_surface_mesh<T,I>::slice_with_planes(const std::list<plane<T>> &planes) const
                     }
                 }
             }
+            return;
+        };
+
+        if(use_sweep){
+            for(const auto &face_idx : candidate_faces[plane_index]) visit_face(face_idx);
+        }else{
+            for(size_t face_idx = 0; face_idx < N_faces; ++face_idx) visit_face(face_idx);
         }
 
         // If no intersections found for this plane, continue to next plane.
         if(edge_intersections.empty()){
-            ++plane_index;
-            continue;
+            return contours;
         }
 
+        // Contours are traced starting from edges in sorted order so the output does not depend on hash table layout.
+        std::vector<edge_t> sorted_edges;
+        sorted_edges.reserve(edge_intersections.size());
+        for(const auto &ei_pair : edge_intersections) sorted_edges.push_back(ei_pair.first);
+        std::sort(std::begin(sorted_edges), std::end(sorted_edges));
+
         // Build a graph of intersection points connected via shared faces.
         // Each face that has exactly 2 edge intersections contributes a connection.
         // We use face indices to find which edges are connected (share a face).
 
         // Build a map from each intersecting edge to its adjacent edges (via shared faces).
         // For a manifold mesh, each face should have exactly 0 or 2 intersecting edges.
-        std::map<std::pair<I,I>, std::set<std::pair<I,I>>> edge_adjacency;
+        std::unordered_map<edge_t, std::set<edge_t>, edge_hash> edge_adjacency;
 
         // For each face, collect all its intersecting edges.
-        std::map<size_t, std::vector<std::pair<I,I>>> face_to_edges;
+        std::unordered_map<size_t, std::vector<edge_t>> face_to_edges;
         for(const auto &ef_pair : edge_to_faces){
             for(const auto &face_idx : ef_pair.second){
                 face_to_edges[face_idx].push_back(ef_pair.first);
@@ -8125,10 +8232,9 @@ fv_surface_mesh<T,I>::slice_with_planes(const std::list<plane<T>> &planes) const
 
         // Trace contours using the edge adjacency graph.
         // Use a set to track which edges have been visited.
-        std::set<std::pair<I,I>> visited_edges;
+        std::unordered_set<edge_t, edge_hash> visited_edges;
 
-        for(const auto &ei_pair : edge_intersections){
-            const auto &start_edge = ei_pair.first;
+        for(const auto &start_edge : sorted_edges){
             if(visited_edges.find(start_edge) != visited_edges.end()){
                 continue; // Already part of a contour.
             }
@@ -8234,12 +8340,34 @@ fv_surface_mesh<T,I>::slice_with_planes(const std::list<plane<T>> &planes) const
             contour.metadata["PlaneIndex"] = std::to_string(plane_index);
 
             // Add the contour to the output collection.
-            output.contours.push_back(contour);
+            contours.push_back(contour);
         }
+        return contours;
+    };
 
-        ++plane_index;
+    // Planes are independent, so they are processed concurrently. Results are gathered in plane order.
+    std::vector<std::list<contour_of_points<T>>> results(N_planes);
+    std::vector<std::exception_ptr> errors(N_planes);
+    if(N_planes == 1UL){
+        results.front() = slice_plane(0UL);
+    }else{
+        work_queue<std::function<void()>> wq;
+        for(size_t plane_index = 0; plane_index < N_planes; ++plane_index){
+            wq.submit_task([&, plane_index](){
+                try{
+                    results[plane_index] = slice_plane(plane_index);
+                }catch(...){
+                    errors[plane_index] = std::current_exception();
+                }
+            });
+        }
+        // Note: the destructor waits for all submitted tasks to complete.
     }
 
+    for(size_t plane_index = 0; plane_index < N_planes; ++plane_index){
+        if(errors[plane_index]) std::rethrow_exception(errors[plane_index]);
+        output.contours.splice( std::end(output.contours), results[plane_index] );
+    }
     return output;
 }
 #ifndef YGORMATH_DISABLE_ALL_SPECIALIZATIONS
@@ -753,6 +753,10 @@ template <class T, class I>   class fv_surface_mesh {
         // and assembles them into contours. The algorithm handles meshes with inconsistent face
         // orientations, holes, and topological defects.
         //
+        // When all planes are parallel (e.g., image slice planes), faces are bucketed by their extent along the common
+        // normal so each face is only visited for the planes it crosses. Planes are processed concurrently. Neither
+        // affects the output.
+        //
         // Note: Returns a contour_collection containing all contours from all planes.
         // Each contour's metadata will contain a key "PlaneIndex" indicating which plane it came from.
         contour_collection<T> slice_with_planes(const std::list<plane<T>> &planes) const;
@@ -2,15 +2,24 @@
 //
 
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <istream>
 #include <limits>
 #include <map>
-#include <sstream>
+#include <mutex>
+#include <ostream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <cctype>
 
@@ -19,135 +28,392 @@
 #include "YgorMathIOCSV.h"
 
 
+namespace {
+
+// Number of blocks that may wait between pipeline stages.
+constexpr size_t pipeline_depth = 2;
+
+// A bounded, closable queue of blocks passed between pipeline stages.
+//
+// Blocks are exchanged by swapping, so their buffers are never copied.
 template <class T>
-csv_load_result<T>
-ReadNumArrayFromCSV(std::istream &is,
-                    bool has_header,
-                    csv_non_numeric_callback_t non_numeric_cb){
+class block_channel {
+    private:
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<num_array<T>> blocks;
+        size_t capacity;
+        bool closed = false;
 
-    csv_load_result<T> result;
-    std::map<std::string, int64_t> &string_to_int = result.string_to_int;
-    std::map<int64_t, std::string> &int_to_string = result.int_to_string;
-    std::map<int64_t, std::vector<std::pair<int64_t, int64_t>>> &int_to_locations = result.int_to_locations;
-    int64_t next_mapped_int = 1; // Start with non-zero value in case zero confuses/weights classifier.
-
-    // Default callback for non-numeric tokens.
-    const auto default_cb = [&](const std::string &token, int64_t row, int64_t col) -> double {
-        // Case-insensitive comparison for NaN.
-        std::string lower;
-        lower.reserve(token.size());
-        for(const auto &ch : token){
-            lower.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(ch))));
+    public:
+        explicit block_channel(size_t capacity) : capacity(capacity) {}
+
+        // Wait for space and enqueue the block, leaving an empty block behind. Returns false if the channel is closed.
+        bool push(num_array<T> &block){
+            std::unique_lock<std::mutex> lock(this->m);
+            this->cv.wait(lock, [&](){ return this->closed || (this->blocks.size() < this->capacity); });
+            if(this->closed) return false;
+            this->blocks.emplace_back();
+            this->blocks.back().swap(block);
+            this->cv.notify_all();
+            return true;
         }
 
-        if(lower.empty() || lower == "nan"){
-            return static_cast<double>(std::numeric_limits<T>::quiet_NaN());
+        // Wait for and dequeue a block. Returns false once the channel is closed and drained.
+        bool pop(num_array<T> &block){
+            std::unique_lock<std::mutex> lock(this->m);
+            this->cv.wait(lock, [&](){ return this->closed || !this->blocks.empty(); });
+            if(this->blocks.empty()) return false;
+            block.swap(this->blocks.front());
+            this->blocks.pop_front();
+            this->cv.notify_all();
+            return true;
         }
-        if(lower == "inf" || lower == "+inf"){
-            return static_cast<double>(std::numeric_limits<T>::infinity());
+
+        // Stop accepting blocks. Blocks already enqueued can still be dequeued.
+        void close(){
+            std::lock_guard<std::mutex> lock(this->m);
+            this->closed = true;
+            this->cv.notify_all();
         }
-        if(lower == "-inf"){
-            return static_cast<double>(-std::numeric_limits<T>::infinity());
+
+        // Stop accepting blocks and discard any that are enqueued.
+        void abort(){
+            std::lock_guard<std::mutex> lock(this->m);
+            this->closed = true;
+            this->blocks.clear();
+            this->cv.notify_all();
         }
+};
+
+double seconds_since(std::chrono::steady_clock::time_point t0){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
 
-        // Map distinct strings to distinct integers (case sensitive on the original token).
-        auto it = string_to_int.find(token);
-        if(it == string_to_int.end()){
-            string_to_int[token] = next_mapped_int;
-            int_to_string[next_mapped_int] = token;
-            it = string_to_int.find(token);
-            ++next_mapped_int;
+} // namespace
+
+
+template <class T>
+csv_block_reader<T>::csv_block_reader(std::istream &is,
+                                      bool has_header,
+                                      csv_non_numeric_callback_t non_numeric_cb,
+                                      bool record_locations,
+                                      int64_t max_mapped_strings)
+    : is(is),
+      has_header(has_header),
+      non_numeric_cb(std::move(non_numeric_cb)),
+      record_locations(record_locations),
+      max_mapped_strings(max_mapped_strings) {
+    if(max_mapped_strings < 0){
+        throw std::invalid_argument("The maximum number of mapped strings cannot be negative.");
+    }
+}
+#ifndef YGORMATHIOCSV_DISABLE_ALL_SPECIALIZATIONS
+    template csv_block_reader<float >::csv_block_reader(std::istream &, bool, csv_non_numeric_callback_t, bool, int64_t);
+    template csv_block_reader<double>::csv_block_reader(std::istream &, bool, csv_non_numeric_callback_t, bool, int64_t);
+#endif
+
+
+template <class T>
+double csv_block_reader<T>::map_non_numeric(const std::string &token, int64_t row, int64_t col){
+    // Case-insensitive comparison for NaN.
+    std::string lower;
+    lower.reserve(token.size());
+    for(const auto &ch : token){
+        lower.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(ch))));
+    }
+
+    if(lower.empty() || lower == "nan"){
+        return static_cast<double>(std::numeric_limits<T>::quiet_NaN());
+    }
+    if(lower == "inf" || lower == "+inf"){
+        return static_cast<double>(std::numeric_limits<T>::infinity());
+    }
+    if(lower == "-inf"){
+        return static_cast<double>(-std::numeric_limits<T>::infinity());
+    }
+
+    // Map distinct strings to distinct integers (case sensitive on the original token).
+    auto it = this->string_to_int.find(token);
+    if(it == this->string_to_int.end()){
+        if(this->max_mapped_strings <= static_cast<int64_t>(this->string_to_int.size())){
+            return static_cast<double>(std::numeric_limits<T>::quiet_NaN());
         }
-        int_to_locations[it->second].emplace_back(row, col);
-        return static_cast<double>(it->second);
-    };
+        it = this->string_to_int.emplace(token, this->next_mapped_int).first;
+        this->int_to_string[this->next_mapped_int] = token;
+        ++this->next_mapped_int;
+    }
+    if(this->record_locations){
+        this->int_to_locations[it->second].emplace_back(row, col);
+    }
+    return static_cast<double>(it->second);
+}
+#ifndef YGORMATHIOCSV_DISABLE_ALL_SPECIALIZATIONS
+    template double csv_block_reader<float >::map_non_numeric(const std::string &, int64_t, int64_t);
+    template double csv_block_reader<double>::map_non_numeric(const std::string &, int64_t, int64_t);
+#endif
 
-    const auto &cb = non_numeric_cb ? non_numeric_cb : default_cb;
 
-    // Helper to trim leading/trailing whitespace from a token.
-    const auto trim = [](const std::string &s) -> std::string {
-        const auto begin = s.find_first_not_of(" \t\r\n");
-        if(begin == std::string::npos) return "";
-        const auto end = s.find_last_not_of(" \t\r\n");
-        return s.substr(begin, end - begin + 1);
+template <class T>
+bool csv_block_reader<T>::parse_line(){
+    const auto is_space = [](char ch) -> bool {
+        return (ch == ' ') || (ch == '\t') || (ch == '\r') || (ch == '\n');
     };
+    const std::string &l = this->line;
+    if(std::all_of(l.begin(), l.end(), is_space)) return false;
 
-    std::vector<std::vector<T>> rows;
-    std::string line;
-    bool first_data_line = true;
-    char delimiter = ',';
-
-    while(std::getline(is, line)){
-        if( trim(line).empty() ) continue;
-        if(first_data_line){
-            // Auto-detect delimiter from first non-empty line.
-            if(line.find('\t') != std::string::npos){
-                delimiter = '\t';
-            }
-            if(has_header){
-                first_data_line = false;
-                continue;
-            }
-            first_data_line = false;
+    if(this->first_data_line){
+        // Auto-detect delimiter from first non-empty line.
+        if(l.find('\t') != std::string::npos){
+            this->delimiter = '\t';
         }
+        this->first_data_line = false;
+        if(this->has_header) return false;
+    }
 
-        const int64_t row_idx = static_cast<int64_t>(rows.size());
-        std::vector<T> vals;
-        std::stringstream ss(line);
-        std::string token;
-        int64_t col_idx = 0;
-        while(std::getline(ss, token, delimiter)){
-            const std::string trimmed = trim(token);
-            // First try to parse as a number.
-            bool parsed = false;
-            if(!trimmed.empty()){
-                try{
-                    size_t pos = 0;
-                    const double val = std::stod(trimmed, &pos);
-                    if(pos == trimmed.size()){
-                        vals.push_back(static_cast<T>(val));
-                        parsed = true;
-                    }
-                }catch(const std::invalid_argument &){
-                }catch(const std::out_of_range &){
-                }
-            }
-            if(!parsed){
-                // Use the callback for non-numeric tokens.
-                const double mapped_val = cb(trimmed, row_idx, col_idx);
-                vals.push_back(static_cast<T>(mapped_val));
+    const int64_t row_idx = this->n_rows_read;
+    int64_t col_idx = 0;
+    std::string token;
+    size_t pos = 0;
+    while(true){
+        size_t end = l.find(this->delimiter, pos);
+        const bool last = (end == std::string::npos);
+        if(last) end = l.size();
+
+        // Like std::getline, ignore the empty field after a trailing delimiter.
+        if(last && (pos == end) && (0 < col_idx)) break;
+
+        // Trim leading/trailing whitespace from the token.
+        size_t b = pos;
+        size_t e = end;
+        while((b < e) && is_space(l[b])) ++b;
+        while((b < e) && is_space(l[e - 1])) --e;
+        token.assign(l, b, e - b);
+
+        // First try to parse as a number, which must consume the whole token.
+        bool parsed = false;
+        if(!token.empty()){
+            errno = 0;
+            char *parse_end = nullptr;
+            const double val = std::strtod(token.c_str(), &parse_end);
+            if( (parse_end == token.c_str() + token.size())
+            &&  (errno != ERANGE) ){
+                this->vals.push_back(static_cast<T>(val));
+                parsed = true;
             }
-            ++col_idx;
         }
-        if(!vals.empty()){
-            rows.push_back(vals);
+        if(!parsed){
+            // Use the callback for non-numeric tokens.
+            const double mapped_val = this->non_numeric_cb ? this->non_numeric_cb(token, row_idx, col_idx)
+                                                           : this->map_non_numeric(token, row_idx, col_idx);
+            this->vals.push_back(static_cast<T>(mapped_val));
         }
+        ++col_idx;
+
+        if(last) break;
+        pos = end + 1;
     }
+    return true;
+}
+#ifndef YGORMATHIOCSV_DISABLE_ALL_SPECIALIZATIONS
+    template bool csv_block_reader<float >::parse_line();
+    template bool csv_block_reader<double>::parse_line();
+#endif
 
-    if(rows.empty()){
-        throw std::runtime_error("No data rows found in CSV/TSV input.");
+
+template <class T>
+bool csv_block_reader<T>::read_block(int64_t max_rows, num_array<T> &block){
+    if(max_rows <= 0){
+        throw std::invalid_argument("Number of rows per block must be positive.");
     }
 
-    const int64_t n_rows = static_cast<int64_t>(rows.size());
-    const int64_t n_cols = static_cast<int64_t>(rows.front().size());
+    // Values are gathered row by row, and transposed into the (column-major) block at the end.
+    this->vals.clear();
+    int64_t n_rows = 0;
+    while( (n_rows < max_rows)
+    &&     std::getline(this->is, this->line) ){
+        const size_t n_before = this->vals.size();
+        if(!this->parse_line()) continue;
 
-    for(int64_t r = 0; r < n_rows; ++r){
-        if(static_cast<int64_t>(rows[r].size()) != n_cols){
-            throw std::runtime_error("Row " + std::to_string(r) + " has "
-                + std::to_string(rows[r].size()) + " columns, expected " + std::to_string(n_cols) + ".");
+        const int64_t n_vals = static_cast<int64_t>(this->vals.size() - n_before);
+        if(this->n_cols < 0){
+            this->n_cols = n_vals;
+        }else if(n_vals != this->n_cols){
+            throw std::runtime_error("Row " + std::to_string(this->n_rows_read) + " has "
+                + std::to_string(n_vals) + " columns, expected " + std::to_string(this->n_cols) + ".");
         }
+        ++n_rows;
+        ++this->n_rows_read;
     }
+    if(n_rows == 0) return false;
 
-    result.data = num_array<T>(n_rows, n_cols, static_cast<T>(0));
+    if( (block.num_rows() != n_rows)
+    ||  (block.num_cols() != this->n_cols) ){
+        num_array<T>(n_rows, this->n_cols, static_cast<T>(0)).swap(block);
+    }
+    T *out = &*block.begin();
+    const T *in = this->vals.data();
     for(int64_t r = 0; r < n_rows; ++r){
-        for(int64_t c = 0; c < n_cols; ++c){
-            result.data.coeff(r, c) = rows[r][c];
+        for(int64_t c = 0; c < this->n_cols; ++c){
+            out[c * n_rows + r] = *in++;
         }
     }
+    return true;
+}
+#ifndef YGORMATHIOCSV_DISABLE_ALL_SPECIALIZATIONS
+    template bool csv_block_reader<float >::read_block(int64_t, num_array<float > &);
+    template bool csv_block_reader<double>::read_block(int64_t, num_array<double> &);
+#endif
+
+
+template <class T>
+int64_t csv_block_reader<T>::get_n_cols() const {
+    return this->n_cols;
+}
+#ifndef YGORMATHIOCSV_DISABLE_ALL_SPECIALIZATIONS
+    template int64_t csv_block_reader<float >::get_n_cols() const;
+    template int64_t csv_block_reader<double>::get_n_cols() const;
+#endif
 
+
+template <class T>
+int64_t csv_block_reader<T>::get_n_rows_read() const {
+    return this->n_rows_read;
+}
+#ifndef YGORMATHIOCSV_DISABLE_ALL_SPECIALIZATIONS
+    template int64_t csv_block_reader<float >::get_n_rows_read() const;
+    template int64_t csv_block_reader<double>::get_n_rows_read() const;
+#endif
+
+
+template <class T>
+csv_load_result<T>
+ReadNumArrayFromCSV(std::istream &is,
+                    bool has_header,
+                    csv_non_numeric_callback_t non_numeric_cb){
+
+    csv_block_reader<T> reader(is, has_header, std::move(non_numeric_cb));
+    csv_load_result<T> result;
+    if(!reader.read_block(std::numeric_limits<int64_t>::max(), result.data)){
+        throw std::runtime_error("No data rows found in CSV/TSV input.");
+    }
+    result.string_to_int.swap(reader.string_to_int);
+    result.int_to_string.swap(reader.int_to_string);
+    result.int_to_locations.swap(reader.int_to_locations);
     return result;
 }
 #ifndef YGORMATHIOCSV_DISABLE_ALL_SPECIALIZATIONS
     template csv_load_result<float > ReadNumArrayFromCSV(std::istream &, bool, csv_non_numeric_callback_t);
     template csv_load_result<double> ReadNumArrayFromCSV(std::istream &, bool, csv_non_numeric_callback_t);
 #endif
+
+
+template <class T>
+csv_scoring_stats
+ScoreCSVStream(std::istream &is,
+               std::ostream &os,
+               const std::function<num_array<T>(const num_array<T> &)> &score,
+               int64_t block_rows,
+               bool has_header,
+               csv_non_numeric_callback_t non_numeric_cb){
+
+    if(block_rows <= 0){
+        throw std::invalid_argument("Number of rows per block must be positive.");
+    }
+    if(!score){
+        throw std::invalid_argument("A scoring function must be provided.");
+    }
+    const auto t_start = std::chrono::steady_clock::now();
+
+    csv_scoring_stats stats;
+    csv_block_reader<T> reader(is, has_header, std::move(non_numeric_cb), false, csv_stream_max_mapped_strings);
+    block_channel<T> to_score(pipeline_depth);
+    block_channel<T> to_write(pipeline_depth);
+
+    // Stage 1: read and parse blocks.
+    std::exception_ptr read_error;
+    std::thread reader_thread([&](){
+        try{
+            num_array<T> block;
+            while(true){
+                const auto t0 = std::chrono::steady_clock::now();
+                const bool got = reader.read_block(block_rows, block);
+                stats.read_seconds += seconds_since(t0);
+                if(!got || !to_score.push(block)) break;
+            }
+        }catch(...){
+            read_error = std::current_exception();
+        }
+        to_score.close();
+    });
+
+    // Stage 3: format and write scores.
+    std::exception_ptr write_error;
+    std::thread writer_thread([&](){
+        try{
+            num_array<T> scores;
+            while(to_write.pop(scores)){
+                const auto t0 = std::chrono::steady_clock::now();
+                const int64_t n = scores.num_rows();
+                const T *s = &*scores.cbegin();
+                for(int64_t r = 0; r < n; ++r){
+                    os << s[r] << '\n';
+                }
+                if(!os){
+                    throw std::runtime_error("Unable to write scores to the output stream.");
+                }
+                stats.write_seconds += seconds_since(t0);
+            }
+            const auto t0 = std::chrono::steady_clock::now();
+            os.flush();
+            if(!os){
+                throw std::runtime_error("Unable to write scores to the output stream.");
+            }
+            stats.write_seconds += seconds_since(t0);
+        }catch(...){
+            write_error = std::current_exception();
+            to_write.abort();
+        }
+    });
+
+    // Stage 2: score blocks on the calling thread, so the scorer need not be thread-safe.
+    std::exception_ptr score_error;
+    try{
+        num_array<T> block;
+        while(to_score.pop(block)){
+            const auto t0 = std::chrono::steady_clock::now();
+            num_array<T> scores = score(block);
+            stats.score_seconds += seconds_since(t0);
+            if( (scores.num_rows() != block.num_rows())
+            ||  (scores.num_cols() != 1) ){
+                throw std::runtime_error("Scoring a block of " + std::to_string(block.num_rows())
+                    + " rows produced a " + std::to_string(scores.num_rows()) + "x"
+                    + std::to_string(scores.num_cols()) + " matrix; expected one score per row.");
+            }
+            stats.n_rows += block.num_rows();
+            ++stats.n_blocks;
+            if(!to_write.push(scores)) break;
+        }
+    }catch(...){
+        score_error = std::current_exception();
+    }
+
+    // Release the reader if scoring stopped early, and let the writer drain what has been scored.
+    to_score.abort();
+    to_write.close();
+    reader_thread.join();
+    writer_thread.join();
+
+    if(read_error) std::rethrow_exception(read_error);
+    if(score_error) std::rethrow_exception(score_error);
+    if(write_error) std::rethrow_exception(write_error);
+
+    stats.wall_seconds = seconds_since(t_start);
+    return stats;
+}
+#ifndef YGORMATHIOCSV_DISABLE_ALL_SPECIALIZATIONS
+    template csv_scoring_stats ScoreCSVStream(std::istream &, std::ostream &,
+        const std::function<num_array<float >(const num_array<float > &)> &, int64_t, bool, csv_non_numeric_callback_t);
+    template csv_scoring_stats ScoreCSVStream(std::istream &, std::ostream &,
+        const std::function<num_array<double>(const num_array<double> &)> &, int64_t, bool, csv_non_numeric_callback_t);
+#endif
@@ -1,6 +1,7 @@
 //YgorMathIOCSV.h - Written by hal clark in 2026.
 //
-// Routines for reading tabular CSV/TSV data into num_array.
+// Routines for reading tabular CSV/TSV data into num_array, either all at once or in blocks of rows for inputs too
+// large to hold in memory.
 //
 
 #pragma once
@@ -13,6 +14,7 @@
 #include <istream>
 #include <limits>
 #include <map>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -84,4 +86,123 @@ ReadNumArrayFromCSV(std::istream &is,
                     csv_non_numeric_callback_t non_numeric_cb = {});
 
 
+// Incrementally read a CSV or TSV stream in blocks of rows.
+//
+// Rows are parsed exactly as ReadNumArrayFromCSV() parses them, including delimiter detection, header handling, and
+// the treatment of non-numeric tokens, but only one block of rows is held in memory at a time. Mappings made by the
+// default non-numeric callback persist across blocks, and row indices passed to callbacks count from the start of
+// the stream.
+//
+// The default callback's mappings grow with the input: int_to_locations gains an entry for every non-numeric cell,
+// and string_to_int and int_to_string for every distinct token. For long inputs, recording locations can be disabled
+// and the number of distinct tokens mapped can be capped; once the cap is reached, tokens not already mapped are
+// read as NaN.
+//
+template <class T>
+class csv_block_reader {
+    private:
+        std::istream &is;
+        bool has_header;
+        csv_non_numeric_callback_t non_numeric_cb;
+
+        bool first_data_line = true;
+        char delimiter = ',';
+        int64_t n_cols = -1;
+        int64_t n_rows_read = 0;
+        int64_t next_mapped_int = 1; // Start with non-zero value in case zero confuses/weights classifier.
+        bool record_locations;
+        int64_t max_mapped_strings;
+
+        std::string line;
+        std::vector<T> vals;
+
+        // Parse a single line, appending its values to vals. Returns false if the line is skipped.
+        bool parse_line();
+
+        // The default non-numeric callback.
+        double map_non_numeric(const std::string &token, int64_t row, int64_t col);
+
+    public:
+        // Mappings made by the default non-numeric callback, as in csv_load_result.
+        std::map<std::string, int64_t> string_to_int;
+        std::map<int64_t, std::string> int_to_string;
+        std::map<int64_t, std::vector<std::pair<int64_t, int64_t>>> int_to_locations;
+
+        // The stream must outlive the reader. Parameters are as for ReadNumArrayFromCSV(), and additionally:
+        //   record_locations: If false, int_to_locations is not populated.
+        //   max_mapped_strings: The maximum number of distinct tokens the default callback maps to integers.
+        //
+        // Throws:
+        //   std::invalid_argument if max_mapped_strings is negative.
+        csv_block_reader(std::istream &is,
+                         bool has_header = false,
+                         csv_non_numeric_callback_t non_numeric_cb = {},
+                         bool record_locations = true,
+                         int64_t max_mapped_strings = std::numeric_limits<int64_t>::max());
+
+        // Read up to max_rows rows into block, which is resized (only) if its shape differs.
+        //
+        // Returns false, leaving block untouched, if no rows remain.
+        //
+        // Throws:
+        //   std::invalid_argument if max_rows is not positive.
+        //   std::runtime_error if a row's column count differs from that of the first row.
+        bool read_block(int64_t max_rows, num_array<T> &block);
+
+        // Get the number of columns, or -1 if no rows have been read.
+        int64_t get_n_cols() const;
+
+        // Get the number of rows read so far.
+        int64_t get_n_rows_read() const;
+};
+
+
+// Statistics reported by ScoreCSVStream().
+struct csv_scoring_stats {
+    int64_t n_rows = 0;
+    int64_t n_blocks = 0;
+    double read_seconds = 0.0;   // Time spent reading and parsing input.
+    double score_seconds = 0.0;  // Time spent scoring.
+    double write_seconds = 0.0;  // Time spent formatting and writing output.
+    double wall_seconds = 0.0;   // Elapsed time overall.
+};
+
+
+// The maximum number of distinct non-numeric tokens ScoreCSVStream() maps to integers.
+constexpr int64_t csv_stream_max_mapped_strings = 65536;
+
+
+// Score a CSV or TSV stream in blocks of rows, writing one score per line to the output stream.
+//
+// Reading (and parsing), scoring, and writing run concurrently as a three-stage pipeline, so each stage overlaps with
+// the others. At most a few blocks are in flight at once, so memory use is bounded by the block size regardless of
+// the length of the input. Scores are written in input order, formatted as 'os << score' would format them.
+//
+// Without a user-provided callback, non-numeric tokens are mapped as by ReadNumArrayFromCSV(), and a token maps to the
+// same value in every block. To keep memory bounded, the locations of mapped tokens are not recorded, and at most
+// csv_stream_max_mapped_strings distinct tokens are mapped; further distinct tokens are read as NaN.
+//
+// Parameters:
+//   is: Input stream, parsed as by ReadNumArrayFromCSV().
+//   os: Output stream for the scores.
+//   score: Scores a block of rows (an NxM matrix), returning an Nx1 matrix. Called from a single thread.
+//   block_rows: Maximum number of rows per block.
+//   has_header, non_numeric_cb: As for ReadNumArrayFromCSV().
+//
+// Returns:
+//   Statistics about the run. An input with no data rows scores nothing.
+//
+// Throws:
+//   Rethrows the first exception thrown by any stage, after stopping the others.
+//   std::runtime_error if score returns the wrong shape, or if the output stream fails.
+//
+template <class T>
+csv_scoring_stats
+ScoreCSVStream(std::istream &is,
+               std::ostream &os,
+               const std::function<num_array<T>(const num_array<T> &)> &score,
+               int64_t block_rows = 65536,
+               bool has_header = false,
+               csv_non_numeric_callback_t non_numeric_cb = {});
+
 #endif // YGOR_MATH_IO_CSV_HDR_GRD_H
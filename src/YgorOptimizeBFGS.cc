@@ -16,18 +16,40 @@
 #include "YgorDefinitions.h"
 #include "YgorOptimizeBFGS.h"
 #include "YgorLog.h"
+#include "YgorThreadPool.h"
+
+
+std::vector<double>
+bfgs_optimizer::gradient(const std::vector<double> &params) const {
+    if(!this->grad_f){
+        return this->approx_gradient(params);
+    }
+    auto grad = this->grad_f(params);
+    if(grad.size() != params.size()){
+        throw std::runtime_error("bfgs_optimizer: 'grad_f' returned a gradient of the wrong size");
+    }
+    return grad;
+}
 
 
 std::vector<double>
 bfgs_optimizer::approx_gradient(const std::vector<double> &params) const {
     const auto N = params.size();
+    const double h = this->fd_step;
+
+    // Evaluations are ordered (p + h e_0, p - h e_0, p + h e_1, ...).
+    const auto f_evals = parallel_evaluate<double>(static_cast<int64_t>(2UL * N), params,
+        [&](std::vector<double> &scratch, int64_t k) -> double {
+            const auto i = static_cast<size_t>(k / 2);
+            scratch[i] = (k % 2 == 0) ? params[i] + h : params[i] - h;
+            const double out = this->f(scratch);
+            scratch[i] = params[i]; // restore
+            return out;
+        }, this->f_is_thread_safe ? this->n_threads : 1);
+
     std::vector<double> grad(N, 0.0);
     for(size_t i = 0UL; i < N; ++i){
-        auto p_fwd = params;
-        auto p_bck = params;
-        p_fwd[i] += this->fd_step;
-        p_bck[i] -= this->fd_step;
-        grad[i] = (this->f(p_fwd) - this->f(p_bck)) / (2.0 * this->fd_step);
+        grad[i] = (f_evals[2UL * i] - f_evals[2UL * i + 1UL]) / (2.0 * h);
     }
     return grad;
 }
@@ -163,7 +185,7 @@ bfgs_optimizer::optimize() const {
     auto params = this->initial_params;
     clamp_params(params);
     double cost = this->f(params);
-    auto grad = this->approx_gradient(params);
+    auto grad = this->gradient(params);
 
     bfgs_result result;
     result.iterations = 0;
@@ -245,7 +267,7 @@ bfgs_optimizer::optimize() const {
         }
 
         const double new_cost = this->f(params);
-        auto new_grad = this->approx_gradient(params);
+        auto new_grad = this->gradient(params);
 
         // Compute gradient difference y = new_grad - grad.
         std::vector<double> y(N);
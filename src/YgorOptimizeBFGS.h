@@ -67,6 +67,18 @@ class bfgs_optimizer {
         // Step size used for finite-difference gradient approximation.
         double fd_step = 1.0e-6;
 
+        // Optional analytic gradient of f, returning one partial derivative per parameter. If set, it is used instead
+        // of finite differences of f.
+        std::function<std::vector<double>(const std::vector<double> &)> grad_f;
+
+        // Whether f (and grad_f, if set) may be called concurrently from multiple threads. If so, the function
+        // evaluations needed for each finite-difference approximation are distributed over n_threads threads.
+        // The results do not depend on the number of threads.
+        bool f_is_thread_safe = false;
+
+        // Number of threads used when f_is_thread_safe is set. Zero uses all hardware threads.
+        int64_t n_threads = 0;
+
         // Initial step size for line search.
         double line_search_step = 1.0;
 
@@ -80,6 +92,9 @@ class bfgs_optimizer {
         bfgs_result optimize() const;
 
     private:
+        // Evaluate the gradient of the cost function at params, using grad_f if set and approx_gradient otherwise.
+        std::vector<double> gradient(const std::vector<double> &params) const;
+
         // Approximate the gradient of the cost function at params using central finite differences.
         std::vector<double> approx_gradient(const std::vector<double> &params) const;
 
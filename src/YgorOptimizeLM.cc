@@ -12,10 +12,12 @@
 #include <limits>
 #include <numeric>
 #include <algorithm>
+#include <utility>
 
 #include "YgorDefinitions.h"
 #include "YgorOptimizeLM.h"
 #include "YgorLog.h"
+#include "YgorThreadPool.h"
 
 
 void
@@ -34,27 +36,57 @@ lm_optimizer::clamp_to_bounds(std::vector<double> &p) const {
 }
 
 
+std::vector<double>
+lm_optimizer::gradient(const std::vector<double> &params,
+                       double f0) const {
+    if(!this->grad_f){
+        return this->approx_gradient(params, f0);
+    }
+    auto grad = this->grad_f(params);
+    if(grad.size() != params.size()){
+        throw std::runtime_error("lm_optimizer: 'grad_f' returned a gradient of the wrong size");
+    }
+    return grad;
+}
+
+
 std::vector<double>
 lm_optimizer::approx_gradient(const std::vector<double> &params,
                              double f0) const {
     const auto N = params.size();
+    const double h = this->fd_step;
+
+    // Evaluations are ordered (p + h e_0, p - h e_0, p + h e_1, ...). Steps that are blocked by a bound are not
+    // evaluated, and the gradient falls back to a one-sided difference.
+    const auto f_evals = parallel_evaluate<double>(static_cast<int64_t>(2UL * N), params,
+        [&](std::vector<double> &scratch, int64_t k) -> double {
+            const auto i = static_cast<size_t>(k / 2);
+            scratch[i] = (k % 2 == 0) ? params[i] + h : params[i] - h;
+            this->clamp_to_bounds(scratch);
+            const double out = (scratch[i] != params[i]) ? this->f(scratch) : f0;
+            scratch[i] = params[i]; // restore
+            return out;
+        }, this->f_is_thread_safe ? this->n_threads : 1);
+
     std::vector<double> grad(N, 0.0);
     for(size_t i = 0UL; i < N; ++i){
         auto p_fwd = params;
         auto p_bck = params;
-        p_fwd[i] += this->fd_step;
-        p_bck[i] -= this->fd_step;
+        p_fwd[i] += h;
+        p_bck[i] -= h;
         this->clamp_to_bounds(p_fwd);
         this->clamp_to_bounds(p_bck);
 
         const double x_fwd = p_fwd[i] - params[i];
         const double x_bck = params[i] - p_bck[i];
+        const double f_fwd = f_evals[2UL * i];
+        const double f_bck = f_evals[2UL * i + 1UL];
         if((x_fwd > 0.0) && (x_bck > 0.0)){
-            grad[i] = (this->f(p_fwd) - this->f(p_bck)) / (x_fwd + x_bck);
+            grad[i] = (f_fwd - f_bck) / (x_fwd + x_bck);
         }else if(x_fwd > 0.0){
-            grad[i] = (this->f(p_fwd) - f0) / x_fwd;
+            grad[i] = (f_fwd - f0) / x_fwd;
         }else if(x_bck > 0.0){
-            grad[i] = (f0 - this->f(p_bck)) / x_bck;
+            grad[i] = (f0 - f_bck) / x_bck;
         }else{
             grad[i] = 0.0;
         }
@@ -65,54 +97,127 @@ lm_optimizer::approx_gradient(const std::vector<double> &params,
 
 std::vector<std::vector<double>>
 lm_optimizer::approx_hessian(const std::vector<double> &params,
-                             double f0) const {
+                             double f0,
+                             const std::vector<double> &grad0) const {
     const auto N = params.size();
     const double h = this->fd_step;
     const double h2 = h * h;
+    const int64_t n_threads = this->f_is_thread_safe ? this->n_threads : 1;
     std::vector<std::vector<double>> hess(N, std::vector<double>(N, 0.0));
 
-    // Use a single scratch vector and perturb/restore indices in-place to avoid
-    // O(N) whole-vector copies per function evaluation in the inner loop.
-    auto scratch = params;
+    // The distance actually stepped forward and backward along each parameter, after clamping to the bounds.
+    std::vector<double> x_fwd(N, 0.0);
+    std::vector<double> x_bck(N, 0.0);
     for(size_t i = 0UL; i < N; ++i){
-        // Diagonal element: second-order central difference.
-        scratch[i] = params[i] + h;
-        this->clamp_to_bounds(scratch);
-        const double x_fwd = scratch[i] - params[i];
-        const double f_fwd = this->f(scratch);
-        scratch[i] = params[i] - h;
-        this->clamp_to_bounds(scratch);
-        const double x_bck = params[i] - scratch[i];
-        const double f_bck = this->f(scratch);
-        scratch[i] = params[i]; // restore
-        if((x_fwd > 0.0) && (x_bck > 0.0)){
-            hess[i][i] = 2.0 * (x_bck * f_fwd - (x_fwd + x_bck) * f0 + x_fwd * f_bck)
-                       / (x_fwd * x_bck * (x_fwd + x_bck));
-        }else{
-            hess[i][i] = 0.0;
+        auto p = params;
+        p[i] = params[i] + h;
+        this->clamp_to_bounds(p);
+        x_fwd[i] = p[i] - params[i];
+        p[i] = params[i] - h;
+        this->clamp_to_bounds(p);
+        x_bck[i] = params[i] - p[i];
+    }
+
+    // Each perturbation perturbs/restores indices of the scratch vector in-place to avoid O(N) whole-vector copies
+    // per function evaluation.
+    if(this->grad_f){
+        // Column j is the central difference of the gradient along parameter j. Evaluations are ordered
+        // (p + h e_0, p - h e_0, p + h e_1, ...).
+        const auto g_evals = parallel_evaluate<std::vector<double>>(static_cast<int64_t>(2UL * N), params,
+            [&](std::vector<double> &scratch, int64_t k) -> std::vector<double> {
+                const auto j = static_cast<size_t>(k / 2);
+                scratch[j] = (k % 2 == 0) ? params[j] + h : params[j] - h;
+                this->clamp_to_bounds(scratch);
+                auto out = (scratch[j] != params[j]) ? this->grad_f(scratch) : grad0;
+                scratch[j] = params[j]; // restore
+                if(out.size() != N){
+                    throw std::runtime_error("lm_optimizer: 'grad_f' returned a gradient of the wrong size");
+                }
+                return out;
+            }, n_threads);
+
+        for(size_t j = 0UL; j < N; ++j){
+            const auto &g_fwd = g_evals[2UL * j];
+            const auto &g_bck = g_evals[2UL * j + 1UL];
+            const double dx = x_fwd[j] + x_bck[j];
+            for(size_t i = 0UL; i < N; ++i){
+                hess[i][j] = (dx > 0.0) ? (g_fwd[i] - g_bck[i]) / dx : 0.0;
+            }
         }
 
-        // Off-diagonal elements: mixed partial central difference.
+        // Symmetrize, since the differences along each parameter need not agree exactly.
+        for(size_t i = 0UL; i < N; ++i){
+            for(size_t j = i + 1UL; j < N; ++j){
+                const double mixed = 0.5 * (hess[i][j] + hess[j][i]);
+                hess[i][j] = mixed;
+                hess[j][i] = mixed;
+            }
+        }
+        return hess;
+    }
+
+    // Evaluations are ordered with the diagonal perturbations (p + h e_0, p - h e_0, p + h e_1, ...) first, followed
+    // by the four corners (++, +-, --, -+) of each off-diagonal pair (i, j) with i < j.
+    std::vector<std::pair<size_t, size_t>> pairs;
+    pairs.reserve(N * (N - 1UL) / 2UL);
+    for(size_t i = 0UL; i < N; ++i){
         for(size_t j = i + 1UL; j < N; ++j){
-            scratch[i] = params[i] + h;  scratch[j] = params[j] + h;
-            this->clamp_to_bounds(scratch);
-            const double f_pp = this->f(scratch);
-            scratch[j] = params[j] - h;
-            this->clamp_to_bounds(scratch);
-            const double f_pm = this->f(scratch);
-            scratch[i] = params[i] - h;
-            this->clamp_to_bounds(scratch);
-            const double f_mm = this->f(scratch);
-            scratch[j] = params[j] + h;
-            this->clamp_to_bounds(scratch);
-            const double f_mp = this->f(scratch);
-            scratch[i] = params[i]; // restore
-            scratch[j] = params[j]; // restore
+            pairs.emplace_back(i, j);
+        }
+    }
+    const int64_t n_diag = static_cast<int64_t>(2UL * N);
+    const int64_t n_evals = n_diag + 4 * static_cast<int64_t>(pairs.size());
+    const auto f_evals = parallel_evaluate<double>(n_evals, params,
+        [&](std::vector<double> &scratch, int64_t k) -> double {
+            double out = f0;
+            if(k < n_diag){
+                const auto i = static_cast<size_t>(k / 2);
+                const bool fwd = (k % 2 == 0);
+                // Steps blocked by a bound are not needed, since the diagonal element is then zero.
+                if(fwd ? (x_fwd[i] > 0.0) : (x_bck[i] > 0.0)){
+                    scratch[i] = fwd ? params[i] + h : params[i] - h;
+                    this->clamp_to_bounds(scratch);
+                    out = this->f(scratch);
+                    scratch[i] = params[i]; // restore
+                }
+            }else{
+                const auto [i, j] = pairs[static_cast<size_t>((k - n_diag) / 4)];
+                const auto corner = (k - n_diag) % 4;
+                scratch[i] = (corner == 0 || corner == 1) ? params[i] + h : params[i] - h;
+                scratch[j] = (corner == 0 || corner == 3) ? params[j] + h : params[j] - h;
+                this->clamp_to_bounds(scratch);
+                // Corners where both steps are blocked by bounds are the current parameters.
+                if((scratch[i] != params[i]) || (scratch[j] != params[j])){
+                    out = this->f(scratch);
+                }
+                scratch[i] = params[i]; // restore
+                scratch[j] = params[j]; // restore
+            }
+            return out;
+        }, n_threads);
 
-            hess[i][j] = (f_pp - f_pm - f_mp + f_mm) / (4.0 * h2);
-            hess[j][i] = hess[i][j];
+    for(size_t i = 0UL; i < N; ++i){
+        // Diagonal element: second-order central difference.
+        const double f_fwd = f_evals[2UL * i];
+        const double f_bck = f_evals[2UL * i + 1UL];
+        if((x_fwd[i] > 0.0) && (x_bck[i] > 0.0)){
+            hess[i][i] = 2.0 * (x_bck[i] * f_fwd - (x_fwd[i] + x_bck[i]) * f0 + x_fwd[i] * f_bck)
+                       / (x_fwd[i] * x_bck[i] * (x_fwd[i] + x_bck[i]));
+        }else{
+            hess[i][i] = 0.0;
         }
     }
+    for(size_t q = 0UL; q < pairs.size(); ++q){
+        // Off-diagonal elements: mixed partial central difference.
+        const auto [i, j] = pairs[q];
+        const auto base = static_cast<size_t>(n_diag) + 4UL * q;
+        const double f_pp = f_evals[base + 0UL];
+        const double f_pm = f_evals[base + 1UL];
+        const double f_mm = f_evals[base + 2UL];
+        const double f_mp = f_evals[base + 3UL];
+        hess[i][j] = (f_pp - f_pm - f_mp + f_mm) / (4.0 * h2);
+        hess[j][i] = hess[i][j];
+    }
     return hess;
 }
 
@@ -178,7 +283,7 @@ lm_optimizer::optimize() const {
     auto params = this->initial_params;
     this->clamp_to_bounds(params);
     double cost = this->f(params);
-    auto grad = this->approx_gradient(params, cost);
+    auto grad = this->gradient(params, cost);
 
     double lambda = this->initial_lambda;
 
@@ -215,8 +320,8 @@ lm_optimizer::optimize() const {
         }
 
         // Build the approximate Hessian H = approx_hessian + lambda * I.
-        // Pass the current cost to avoid a redundant f(params) evaluation.
-        auto H = this->approx_hessian(params, cost);
+        // Pass the current cost and gradient to avoid redundant evaluations.
+        auto H = this->approx_hessian(params, cost, grad);
         for(size_t i = 0UL; i < N; ++i){
             H[i][i] += lambda;
         }
@@ -286,7 +391,7 @@ lm_optimizer::optimize() const {
             const double prev_cost = cost;
             params = trial;
             cost = trial_cost;
-            grad = this->approx_gradient(params, cost);
+            grad = this->gradient(params, cost);
             lambda *= this->lambda_decrease_factor;
 
             ++(result.iterations);
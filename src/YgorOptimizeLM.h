@@ -78,6 +78,19 @@ class lm_optimizer {
         // Step size used for finite-difference gradient approximation.
         double fd_step = 1.0e-6;
 
+        // Optional analytic gradient of f, returning one partial derivative per parameter. If set, it is used instead
+        // of finite differences of f. The Hessian is then
+        // approximated using finite differences of grad_f rather than f.
+        std::function<std::vector<double>(const std::vector<double> &)> grad_f;
+
+        // Whether f (and grad_f, if set) may be called concurrently from multiple threads. If so, the function
+        // evaluations needed for each finite-difference approximation are distributed over n_threads threads.
+        // The results do not depend on the number of threads.
+        bool f_is_thread_safe = false;
+
+        // Number of threads used when f_is_thread_safe is set. Zero uses all hardware threads.
+        int64_t n_threads = 0;
+
         // Initial damping parameter.
         double initial_lambda = 1.0e-3;
 
@@ -97,16 +110,21 @@ class lm_optimizer {
         // Clamp parameter vector to configured bounds, if present.
         void clamp_to_bounds(std::vector<double> &params) const;
 
+        // Evaluate the gradient of the cost function at params, using grad_f if set and approx_gradient otherwise.
+        std::vector<double> gradient(const std::vector<double> &params,
+                                     double f0) const;
+
         // Approximate the gradient of the cost function at params using finite differences.
         // The caller provides f(params) to avoid a redundant function evaluation.
         std::vector<double> approx_gradient(const std::vector<double> &params,
                                             double f0) const;
 
-        // Approximate the Hessian of the cost function at params using central finite differences.
-        // The caller provides the current cost f(params) to avoid a redundant function evaluation,
-        // since the optimizer already tracks this value and f may be expensive to compute.
+        // Approximate the Hessian of the cost function at params using central finite differences of f, or of
+        // grad_f if set. The caller provides the current cost f(params) and gradient to avoid redundant function
+        // evaluations, since the optimizer already tracks these values and f may be expensive to compute.
         std::vector<std::vector<double>> approx_hessian(const std::vector<double> &params,
-                                                        double f0) const;
+                                                        double f0,
+                                                        const std::vector<double> &grad0) const;
 };
 
 #endif // YGOR_OPTIMIZE_LM_HDR_GRD_H
@@ -38,6 +38,72 @@
 
 
 //--------------------------------------------- "Building block" routine ----------------------------------------------------
+namespace {
+
+// Interpolate the percentile (as described for Stats::Percentile()) of the n = distance(first, last) >= 2 elements.
+// The range is partially reordered to select the two elements that are needed.
+template <class It>
+typename std::iterator_traits<It>::value_type
+select_percentile(It first, It last, double frac){
+    using T = typename std::iterator_traits<It>::value_type;
+
+    const auto N = static_cast<int64_t>(std::distance(first, last)) - 1;
+    const auto M = frac * N;
+    const auto MP = std::floor(M); // The integer part of M.
+    const auto R = M - MP; // The extra bit (remainder).
+
+    const auto MP_int = static_cast<int64_t>(MP);
+
+    auto L_it = std::next(first, MP_int);
+    std::nth_element(first, L_it, last);
+    if(MP_int == N) return *L_it;
+
+    // The next-largest element is the smallest of those following the selected element.
+    const T R_val = *std::min_element(std::next(L_it), last);
+
+    return static_cast<T>( (1.0 - R)*(*L_it) + R*R_val );
+}
+
+template <class C>
+typename C::value_type
+container_percentile(C &in, double frac){
+    return select_percentile(in.begin(), in.end(), frac);
+}
+
+// Lists cannot be selected from efficiently, and yspan's iterators do not support selection, so these are sorted.
+template <class C>
+typename C::value_type
+sorted_container_percentile(C &in, double frac){
+    using T = typename C::value_type;
+    Ygor_Container_Sort(in);
+
+    const auto N = static_cast<int64_t>(in.size()) - 1;
+    const auto M = frac * N;
+    const auto MP = std::floor(M); // The integer part of M.
+    const auto R = M - MP; // The extra bit (remainder).
+
+    const auto MP_int = static_cast<int64_t>(MP);
+
+    if(MP_int == N) return in.back();
+
+    auto L_it = std::next(in.begin(), MP_int);
+    auto R_it = std::next(L_it);
+
+    return static_cast<T>( (1.0 - R)*(*L_it) + R*(*R_it) );
+}
+
+template <class T>
+T container_percentile(std::list<T> &in, double frac){
+    return sorted_container_percentile(in, frac);
+}
+
+template <class T>
+T container_percentile(yspan<T> &in, double frac){
+    return sorted_container_percentile(in, frac);
+}
+
+} // namespace
+
 
 
 template <class C> typename C::value_type Stats::Min(C in){
@@ -314,24 +380,7 @@ template <class C> typename C::value_type Stats::Percentile(C in, double frac){
         YLOGERR("Invalid argument provided: frac must be [0,1]");
     }
 
-    auto sort_low_to_high = [](T l, T r) -> bool {
-        return l < r;
-    };
-    Ygor_Container_Sort(in, sort_low_to_high);
-
-    const auto N = static_cast<int64_t>(in.size()) - 1;
-    const auto M = frac * N;
-    const auto MP = std::floor(M); // The integer part of M.
-    const auto R = M - MP; // The extra bit (remainder).
-   
-    const auto MP_int = static_cast<int64_t>(MP);
-
-    if(MP_int == N) return in.back();
-
-    auto L_it = std::next(in.begin(), MP_int);
-    auto R_it = std::next(L_it);
-
-    return static_cast<T>( (1.0 - R)*(*L_it) + R*(*R_it) );
+    return container_percentile(in, frac);
 }
 #ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
     template double   Stats::Percentile(std::list<double>     in, double frac);
@@ -533,7 +582,193 @@ template <class C> typename C::value_type Stats::Unbiased_Var_Est(C in){
     template int64_t  Stats::Unbiased_Var_Est(yspan<int64_t>        in);
 #endif
 
+//------------------------------------------ Contiguous range overloads -----------------------------------------------------
+template <class T> T Stats::Min(const T *first, const T *last){
+    if(first == last){
+        if(std::numeric_limits<T>::has_quiet_NaN){
+            return std::numeric_limits<T>::quiet_NaN();
+        }else{
+            YLOGERR("Cannot find minimum of zero elements and cannot emit NaN. Cannot continue");
+        }
+    }
+
+    Stats::Running_MinMax<T> rmm;
+    for(auto it = first; it != last; ++it) rmm.Digest(*it);
+    return rmm.Current_Min();
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template double   Stats::Min(const double   *first, const double   *last);
+    template float    Stats::Min(const float    *first, const float    *last);
+    template uint8_t  Stats::Min(const uint8_t  *first, const uint8_t  *last);
+    template int8_t   Stats::Min(const int8_t   *first, const int8_t   *last);
+    template uint16_t Stats::Min(const uint16_t *first, const uint16_t *last);
+    template int16_t  Stats::Min(const int16_t  *first, const int16_t  *last);
+    template uint32_t Stats::Min(const uint32_t *first, const uint32_t *last);
+    template int32_t  Stats::Min(const int32_t  *first, const int32_t  *last);
+    template uint64_t Stats::Min(const uint64_t *first, const uint64_t *last);
+    template int64_t  Stats::Min(const int64_t  *first, const int64_t  *last);
+#endif
+
+
+template <class T> T Stats::Max(const T *first, const T *last){
+    if(first == last){
+        if(std::numeric_limits<T>::has_quiet_NaN){
+            return std::numeric_limits<T>::quiet_NaN();
+        }else{
+            YLOGERR("Cannot find maximum of zero elements and cannot emit NaN. Cannot continue");
+        }
+    }
+
+    Stats::Running_MinMax<T> rmm;
+    for(auto it = first; it != last; ++it) rmm.Digest(*it);
+    return rmm.Current_Max();
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template double   Stats::Max(const double   *first, const double   *last);
+    template float    Stats::Max(const float    *first, const float    *last);
+    template uint8_t  Stats::Max(const uint8_t  *first, const uint8_t  *last);
+    template int8_t   Stats::Max(const int8_t   *first, const int8_t   *last);
+    template uint16_t Stats::Max(const uint16_t *first, const uint16_t *last);
+    template int16_t  Stats::Max(const int16_t  *first, const int16_t  *last);
+    template uint32_t Stats::Max(const uint32_t *first, const uint32_t *last);
+    template int32_t  Stats::Max(const int32_t  *first, const int32_t  *last);
+    template uint64_t Stats::Max(const uint64_t *first, const uint64_t *last);
+    template int64_t  Stats::Max(const int64_t  *first, const int64_t  *last);
+#endif
+
+
+template <class T> T Stats::Mean(const T *first, const T *last){
+    if(first == last){
+        if(std::numeric_limits<T>::has_quiet_NaN){
+            return std::numeric_limits<T>::quiet_NaN();
+        }else{
+            YLOGERR("Cannot find mean of zero elements and cannot emit NaN. Cannot continue");
+        }
+    }
+
+    Stats::Running_Sum<T> rs;
+    for(auto it = first; it != last; ++it) rs.Digest(*it);
+    return rs.Current_Sum() / static_cast<T>(std::distance(first, last));
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template double   Stats::Mean(const double   *first, const double   *last);
+    template float    Stats::Mean(const float    *first, const float    *last);
+    template uint8_t  Stats::Mean(const uint8_t  *first, const uint8_t  *last);
+    template int8_t   Stats::Mean(const int8_t   *first, const int8_t   *last);
+    template uint16_t Stats::Mean(const uint16_t *first, const uint16_t *last);
+    template int16_t  Stats::Mean(const int16_t  *first, const int16_t  *last);
+    template uint32_t Stats::Mean(const uint32_t *first, const uint32_t *last);
+    template int32_t  Stats::Mean(const int32_t  *first, const int32_t  *last);
+    template uint64_t Stats::Mean(const uint64_t *first, const uint64_t *last);
+    template int64_t  Stats::Mean(const int64_t  *first, const int64_t  *last);
+#endif
+
+
+template <class T> T Stats::Percentile_In_Place(T *first, T *last, double frac){
+    if(first == last){
+        if(std::numeric_limits<T>::has_quiet_NaN){
+            return std::numeric_limits<T>::quiet_NaN();
+        }else{
+            YLOGERR("Cannot find percentile of zero elements and cannot emit NaN. Cannot continue");
+        }
+    }else if(std::next(first) == last){
+        return *first;
+    }else if(!isininc(static_cast<T>(0),frac,static_cast<T>(1))){
+        YLOGERR("Invalid argument provided: frac must be [0,1]");
+    }
+    return select_percentile(first, last, frac);
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template double   Stats::Percentile_In_Place(double   *first, double   *last, double frac);
+    template float    Stats::Percentile_In_Place(float    *first, float    *last, double frac);
+    template uint8_t  Stats::Percentile_In_Place(uint8_t  *first, uint8_t  *last, double frac);
+    template int8_t   Stats::Percentile_In_Place(int8_t   *first, int8_t   *last, double frac);
+    template uint16_t Stats::Percentile_In_Place(uint16_t *first, uint16_t *last, double frac);
+    template int16_t  Stats::Percentile_In_Place(int16_t  *first, int16_t  *last, double frac);
+    template uint32_t Stats::Percentile_In_Place(uint32_t *first, uint32_t *last, double frac);
+    template int32_t  Stats::Percentile_In_Place(int32_t  *first, int32_t  *last, double frac);
+    template uint64_t Stats::Percentile_In_Place(uint64_t *first, uint64_t *last, double frac);
+    template int64_t  Stats::Percentile_In_Place(int64_t  *first, int64_t  *last, double frac);
+#endif
+
+
+template <class T> T Stats::Percentile(const T *first, const T *last, double frac){
+    std::vector<T> working(first, last);
+    return Stats::Percentile_In_Place(working.data(), working.data() + working.size(), frac);
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template double   Stats::Percentile(const double   *first, const double   *last, double frac);
+    template float    Stats::Percentile(const float    *first, const float    *last, double frac);
+    template uint8_t  Stats::Percentile(const uint8_t  *first, const uint8_t  *last, double frac);
+    template int8_t   Stats::Percentile(const int8_t   *first, const int8_t   *last, double frac);
+    template uint16_t Stats::Percentile(const uint16_t *first, const uint16_t *last, double frac);
+    template int16_t  Stats::Percentile(const int16_t  *first, const int16_t  *last, double frac);
+    template uint32_t Stats::Percentile(const uint32_t *first, const uint32_t *last, double frac);
+    template int32_t  Stats::Percentile(const int32_t  *first, const int32_t  *last, double frac);
+    template uint64_t Stats::Percentile(const uint64_t *first, const uint64_t *last, double frac);
+    template int64_t  Stats::Percentile(const int64_t  *first, const int64_t  *last, double frac);
+#endif
+
+
+template <class T> T Stats::Median(const T *first, const T *last){
+    return Stats::Percentile(first, last, 0.5);
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template double   Stats::Median(const double   *first, const double   *last);
+    template float    Stats::Median(const float    *first, const float    *last);
+    template uint8_t  Stats::Median(const uint8_t  *first, const uint8_t  *last);
+    template int8_t   Stats::Median(const int8_t   *first, const int8_t   *last);
+    template uint16_t Stats::Median(const uint16_t *first, const uint16_t *last);
+    template int16_t  Stats::Median(const int16_t  *first, const int16_t  *last);
+    template uint32_t Stats::Median(const uint32_t *first, const uint32_t *last);
+    template int32_t  Stats::Median(const int32_t  *first, const int32_t  *last);
+    template uint64_t Stats::Median(const uint64_t *first, const uint64_t *last);
+    template int64_t  Stats::Median(const int64_t  *first, const int64_t  *last);
+#endif
+
 //----------------------------------------- Running Accumulators and Tallies ----------------------------------------------
+namespace {
+
+// Blocks are digested in runs of this many values.
+constexpr int64_t digest_run_length = 128;
+
+// Sum a run of values using several independent partial sums, which the compiler can vectorize. The error of each
+// partial sum grows with its length, so runs are kept short.
+template <class T>
+T run_sum(const T *x, int64_t n){
+    constexpr int64_t lanes = 8;
+    T partial[lanes] = {};
+    int64_t i = 0;
+    for( ; (i + lanes) <= n; i += lanes){
+        for(int64_t l = 0; l < lanes; ++l) partial[l] += x[i + l];
+    }
+    for( ; i < n; ++i) partial[i % lanes] += x[i];
+    return ((partial[0] + partial[1]) + (partial[2] + partial[3]))
+         + ((partial[4] + partial[5]) + (partial[6] + partial[7]));
+}
+
+// Sum the squared deviations of a run of values from the given mean, as for run_sum().
+template <class T>
+T run_sum_sq_dev(const T *x, int64_t n, T mean){
+    constexpr int64_t lanes = 8;
+    T partial[lanes] = {};
+    int64_t i = 0;
+    for( ; (i + lanes) <= n; i += lanes){
+        for(int64_t l = 0; l < lanes; ++l){
+            const T d = x[i + l] - mean;
+            partial[l] += d * d;
+        }
+    }
+    for( ; i < n; ++i){
+        const T d = x[i] - mean;
+        partial[i % lanes] += d * d;
+    }
+    return ((partial[0] + partial[1]) + (partial[2] + partial[3]))
+         + ((partial[4] + partial[5]) + (partial[6] + partial[7]));
+}
+
+} // namespace
+
 template <typename T>
 Stats::Running_MinMax<T>::Running_MinMax() : PresentMin(std::numeric_limits<T>::max()),
                                              PresentMax(std::numeric_limits<T>::lowest()) { }
@@ -558,6 +793,38 @@ void Stats::Running_MinMax<T>::Digest(T in){
     template void Stats::Running_MinMax<int64_t >::Digest(int64_t  in);
 #endif
 
+template <typename T>
+void Stats::Running_MinMax<T>::Digest(const T *first, const T *last){
+    T l_min = this->PresentMin;
+    T l_max = this->PresentMax;
+    for(auto it = first; it != last; ++it){
+        l_min = std::min<T>(l_min, *it);
+        l_max = std::max<T>(l_max, *it);
+    }
+    this->PresentMin = l_min;
+    this->PresentMax = l_max;
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_MinMax<double  >::Digest(const double   *first, const double   *last);
+    template void Stats::Running_MinMax<float   >::Digest(const float    *first, const float    *last);
+    template void Stats::Running_MinMax<uint64_t>::Digest(const uint64_t *first, const uint64_t *last);
+    template void Stats::Running_MinMax<int64_t >::Digest(const int64_t  *first, const int64_t  *last);
+#endif
+
+template <typename T>
+void Stats::Running_MinMax<T>::Merge(const Stats::Running_MinMax<T> &other){
+    this->PresentMin = std::min<T>(this->PresentMin, other.PresentMin);
+    this->PresentMax = std::max<T>(this->PresentMax, other.PresentMax);
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_MinMax<double  >::Merge(const Stats::Running_MinMax<double  > &other);
+    template void Stats::Running_MinMax<float   >::Merge(const Stats::Running_MinMax<float   > &other);
+    template void Stats::Running_MinMax<uint64_t>::Merge(const Stats::Running_MinMax<uint64_t> &other);
+    template void Stats::Running_MinMax<int64_t >::Merge(const Stats::Running_MinMax<int64_t > &other);
+#endif
+
 template <typename T>
 T Stats::Running_MinMax<T>::Current_Min(void) const {
     if(this->PresentMin > this->PresentMax){
@@ -659,6 +926,38 @@ void Stats::Running_Sum<T>::Digest(T in){
     template void Stats::Running_Sum<int64_t >::Digest(int64_t  in);
 #endif
 
+template <typename T>
+void Stats::Running_Sum<T>::Digest(const T *first, const T *last){
+    for(auto it = first; it != last; ){
+        const auto n = std::min<int64_t>(digest_run_length, static_cast<int64_t>(std::distance(it, last)));
+        this->Digest(run_sum(it, n));
+        it += n;
+    }
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_Sum<double  >::Digest(const double   *first, const double   *last);
+    template void Stats::Running_Sum<float   >::Digest(const float    *first, const float    *last);
+    template void Stats::Running_Sum<uint64_t>::Digest(const uint64_t *first, const uint64_t *last);
+    template void Stats::Running_Sum<int64_t >::Digest(const int64_t  *first, const int64_t  *last);
+#endif
+
+template <typename T>
+void Stats::Running_Sum<T>::Merge(const Stats::Running_Sum<T> &other){
+    // Read the other accumulator first, in case it is this accumulator.
+    const T other_sum = other.PresentSum;
+    const T other_compen = other.PresentCompen;
+    this->Digest(other_sum);
+    this->Digest(static_cast<T>(0) - other_compen);
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_Sum<double  >::Merge(const Stats::Running_Sum<double  > &other);
+    template void Stats::Running_Sum<float   >::Merge(const Stats::Running_Sum<float   > &other);
+    template void Stats::Running_Sum<uint64_t>::Merge(const Stats::Running_Sum<uint64_t> &other);
+    template void Stats::Running_Sum<int64_t >::Merge(const Stats::Running_Sum<int64_t > &other);
+#endif
+
 template <typename T>
 T Stats::Running_Sum<T>::Current_Sum(void) const {
     //There is potentially a small compensation term and the large sum term. In the general case the
@@ -720,6 +1019,76 @@ void Stats::Running_Variance<T>::Digest(T in){
     template void Stats::Running_Variance<float >::Digest(float  in);
 #endif
 
+template <typename T>
+void Stats::Running_Variance<T>::Digest(const T *first, const T *last){
+    // Blocks are summarized in chunks small enough that the second pass reads from cache.
+    constexpr int64_t chunk_length = 4096;
+    for(auto it = first; it != last; ){
+        const auto n = std::min<int64_t>(chunk_length, static_cast<int64_t>(std::distance(it, last)));
+
+        Stats::Running_Sum<T> sum;
+        sum.Digest(it, it + n);
+        const T mean = sum.Current_Sum() / static_cast<T>(n);
+
+        Stats::Running_Sum<T> m2;
+        for(int64_t i = 0; i < n; i += digest_run_length){
+            m2.Digest(run_sum_sq_dev(it + i, std::min<int64_t>(digest_run_length, n - i), mean));
+        }
+
+        Stats::Running_Variance<T> chunk;
+        chunk.Count = static_cast<uint64_t>(n);
+        chunk.Mean.Digest(mean);
+        chunk.M2 = m2;
+        this->Merge(chunk);
+
+        it += n;
+    }
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_Variance<double>::Digest(const double *first, const double *last);
+    template void Stats::Running_Variance<float >::Digest(const float  *first, const float  *last);
+#endif
+
+template <typename T>
+void Stats::Running_Variance<T>::Merge(const Stats::Running_Variance<T> &other){
+    if(other.Count == 0ULL) return;
+    if(this->Count == 0ULL){
+        *this = other;
+        return;
+    }
+
+    // Read the other accumulator first, in case it is this accumulator.
+    const uint64_t other_count = other.Count;
+    const Stats::Running_Sum<T> other_m2 = other.M2;
+    const T mean_a = this->Mean.Current_Sum();
+    const T mean_b = other.Mean.Current_Sum();
+
+    const T n_a = static_cast<T>(this->Count);
+    const T n_b = static_cast<T>(other_count);
+    const T n = n_a + n_b;
+    const T delta = mean_b - mean_a;
+
+    this->Mean.Digest(delta * (n_b / n));
+    this->M2.Merge(other_m2);
+    this->M2.Digest(delta * delta * (n_a * (n_b / n)));
+    this->Count += other_count;
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_Variance<double>::Merge(const Stats::Running_Variance<double> &other);
+    template void Stats::Running_Variance<float >::Merge(const Stats::Running_Variance<float > &other);
+#endif
+
+template <typename T>
+uint64_t Stats::Running_Variance<T>::Current_Count(void) const {
+    return this->Count;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template uint64_t Stats::Running_Variance<double>::Current_Count(void) const;
+    template uint64_t Stats::Running_Variance<float >::Current_Count(void) const;
+#endif
+
 template <typename T>
 T Stats::Running_Variance<T>::Current_Mean(void) const {
     if(this->Count == 0ULL){
@@ -772,6 +1141,215 @@ T Stats::Running_Variance<T>::Current_Sample_Variance(void) const {
 #endif
 
 
+// Implements the merging t-digest with the k_1 scale function,
+//   k(q) = (compression / (2 pi)) * asin(2q - 1),
+// which limits each centroid to span at most one unit of k. Centroids are therefore small near q = 0 and q = 1.
+//
+// Digested values are buffered and periodically merged with the centroids in a single sorted pass. The digest is
+// queried by interpolating between the centroids, treating each centroid's mean as the value at the average rank of
+// the values it holds. The minimum and maximum are tracked exactly and anchor the interpolation at the extremes.
+
+namespace {
+
+// The largest quantile that a centroid starting at quantile q0 may extend to.
+double tdigest_quantile_limit(double q0, double compression){
+    const double pi = 3.14159265358979323846;
+    const double k0 = compression / (2.0 * pi) * std::asin(2.0 * q0 - 1.0);
+    const double angle = (k0 + 1.0) * (2.0 * pi) / compression;
+    if(pi * 0.5 <= angle) return 1.0;
+    return 0.5 * (1.0 + std::sin(angle));
+}
+
+} // namespace
+
+template <typename T>
+Stats::Running_Quantiles<T>::Running_Quantiles(double compression) : Compression(compression),
+                                                                     Centroid_Weight(0.0),
+                                                                     Unmerged_Weight(0.0),
+                                                                     Merge_Descending(false),
+                                                                     PresentMin(std::numeric_limits<T>::max()),
+                                                                     PresentMax(std::numeric_limits<T>::lowest()) {
+    if(!std::isfinite(compression) || !(0.0 < compression)){
+        throw std::invalid_argument("Compression must be positive");
+    }
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template Stats::Running_Quantiles<double>::Running_Quantiles(double compression);
+    template Stats::Running_Quantiles<float >::Running_Quantiles(double compression);
+#endif
+
+template <typename T>
+void Stats::Running_Quantiles<T>::Merge_Unmerged(){
+    if(this->Unmerged.empty()) return;
+
+    // The centroids are already sorted, so only the new values need to be sorted.
+    auto &all = this->Unmerged;
+    std::sort(all.begin(), all.end());
+    const auto n_unmerged = static_cast<std::ptrdiff_t>(all.size());
+    all.insert(all.end(), this->Centroids.begin(), this->Centroids.end());
+    std::inplace_merge(all.begin(), std::next(all.begin(), n_unmerged), all.end());
+
+    // Alternate the direction of successive passes, which would otherwise bias the centroids toward one end.
+    if(this->Merge_Descending) std::reverse(all.begin(), all.end());
+
+    const double total = this->Centroid_Weight + this->Unmerged_Weight;
+    this->Centroids.clear();
+
+    double q0_weight = 0.0; // Weight preceding the current centroid.
+    double q_limit = tdigest_quantile_limit(0.0, this->Compression);
+    auto current = all.front();
+    for(auto it = std::next(all.begin()); it != all.end(); ++it){
+        const double proposed = current.second + it->second;
+        if((q0_weight + proposed) / total <= q_limit){
+            current.first += (it->first - current.first) * (it->second / proposed);
+            current.second = proposed;
+        }else{
+            this->Centroids.push_back(current);
+            q0_weight += current.second;
+            q_limit = tdigest_quantile_limit(q0_weight / total, this->Compression);
+            current = *it;
+        }
+    }
+    this->Centroids.push_back(current);
+    if(this->Merge_Descending) std::reverse(this->Centroids.begin(), this->Centroids.end());
+    this->Merge_Descending = !this->Merge_Descending;
+
+    this->Centroid_Weight = total;
+    this->Unmerged.clear();
+    this->Unmerged_Weight = 0.0;
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_Quantiles<double>::Merge_Unmerged();
+    template void Stats::Running_Quantiles<float >::Merge_Unmerged();
+#endif
+
+template <typename T>
+void Stats::Running_Quantiles<T>::Digest(T in){
+    if(!std::isfinite(in)) return;
+
+    this->PresentMin = std::min<T>(this->PresentMin, in);
+    this->PresentMax = std::max<T>(this->PresentMax, in);
+    this->Unmerged.emplace_back(static_cast<double>(in), 1.0);
+    this->Unmerged_Weight += 1.0;
+
+    // Buffering amortizes the cost of sorting over many values.
+    if(static_cast<double>(this->Unmerged.size()) >= 5.0 * this->Compression) this->Merge_Unmerged();
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_Quantiles<double>::Digest(double in);
+    template void Stats::Running_Quantiles<float >::Digest(float  in);
+#endif
+
+template <typename T>
+void Stats::Running_Quantiles<T>::Digest(const T *first, const T *last){
+    for(auto it = first; it != last; ++it) this->Digest(*it);
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_Quantiles<double>::Digest(const double *first, const double *last);
+    template void Stats::Running_Quantiles<float >::Digest(const float  *first, const float  *last);
+#endif
+
+template <typename T>
+void Stats::Running_Quantiles<T>::Merge(const Stats::Running_Quantiles<T> &other){
+    if(&other == this){
+        const Stats::Running_Quantiles<T> copy(other);
+        this->Merge(copy);
+        return;
+    }
+
+    this->PresentMin = std::min<T>(this->PresentMin, other.PresentMin);
+    this->PresentMax = std::max<T>(this->PresentMax, other.PresentMax);
+    this->Unmerged.insert(this->Unmerged.end(), other.Centroids.begin(), other.Centroids.end());
+    this->Unmerged.insert(this->Unmerged.end(), other.Unmerged.begin(), other.Unmerged.end());
+    this->Unmerged_Weight += other.Centroid_Weight + other.Unmerged_Weight;
+    this->Merge_Unmerged();
+    return;
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::Running_Quantiles<double>::Merge(const Stats::Running_Quantiles<double> &other);
+    template void Stats::Running_Quantiles<float >::Merge(const Stats::Running_Quantiles<float > &other);
+#endif
+
+template <typename T>
+uint64_t Stats::Running_Quantiles<T>::Current_Count(void) const {
+    return static_cast<uint64_t>(this->Centroid_Weight + this->Unmerged_Weight);
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template uint64_t Stats::Running_Quantiles<double>::Current_Count(void) const;
+    template uint64_t Stats::Running_Quantiles<float >::Current_Count(void) const;
+#endif
+
+template <typename T>
+T Stats::Running_Quantiles<T>::Current_Percentile(double frac) const {
+    if(!isininc(0.0, frac, 1.0)){
+        throw std::invalid_argument("Invalid argument provided: frac must be [0,1]");
+    }
+    if(!this->Unmerged.empty()){
+        Stats::Running_Quantiles<T> merged(*this);
+        merged.Merge_Unmerged();
+        return merged.Current_Percentile(frac);
+    }
+    if(this->Centroids.empty()){
+        // Figure out how to report the failure.
+        if(std::numeric_limits<T>::has_quiet_NaN){
+            return std::numeric_limits<T>::quiet_NaN();
+        }else{
+            throw std::runtime_error("Not enough data digested to provide percentile and cannot emit NaN");
+        }
+    }
+
+    // Locate the target rank among the centroids' average ranks, with the extrema at the first and last ranks.
+    const auto &c = this->Centroids;
+    const double last_rank = this->Centroid_Weight - 1.0;
+    const double p = frac * last_rank;
+    const auto interpolate = [](double l, double r, double t) -> double {
+        return (1.0 - t) * l + t * r;
+    };
+
+    double out = 0.0;
+    double rank_before = 0.0;
+    double prev_rank = 0.0;
+    double prev_mean = static_cast<double>(this->PresentMin);
+    bool found = false;
+    for(const auto &centroid : c){
+        const double rank = rank_before + (centroid.second - 1.0) * 0.5;
+        if(p <= rank){
+            out = (prev_rank < rank) ? interpolate(prev_mean, centroid.first, (p - prev_rank) / (rank - prev_rank))
+                                     : centroid.first;
+            found = true;
+            break;
+        }
+        rank_before += centroid.second;
+        prev_rank = rank;
+        prev_mean = centroid.first;
+    }
+    if(!found){
+        out = (prev_rank < last_rank) ? interpolate(prev_mean, static_cast<double>(this->PresentMax),
+                                                    (p - prev_rank) / (last_rank - prev_rank))
+                                      : prev_mean;
+    }
+
+    out = std::clamp(out, static_cast<double>(this->PresentMin), static_cast<double>(this->PresentMax));
+    return static_cast<T>(out);
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template double Stats::Running_Quantiles<double>::Current_Percentile(double frac) const;
+    template float  Stats::Running_Quantiles<float >::Current_Percentile(double frac) const;
+#endif
+
+template <typename T>
+T Stats::Running_Quantiles<T>::Current_Median(void) const {
+    return this->Current_Percentile(0.5);
+}
+#ifndef YGORSTATS_DISABLE_ALL_SPECIALIZATIONS
+    template double Stats::Running_Quantiles<double>::Current_Median(void) const;
+    template float  Stats::Running_Quantiles<float >::Current_Median(void) const;
+#endif
+
+
 //--------------------------------------------- P-value (and related) routines ----------------------------------------------
 double Stats::P_From_StudT_1Tail(double tval, double dof){
     //This routine is applicable to any Student's t-test. 
@@ -8,6 +8,7 @@
 #include <array>
 #include <cstdint>
 #include <list>
+#include <utility>
 #include <vector>
 
 #include "YgorDefinitions.h"
@@ -29,9 +30,31 @@ template <class C> typename C::value_type Median(C in);
 template <class C> typename C::value_type Mean(C in);
 template <class C> typename C::value_type Unbiased_Var_Est(C in);
 
+// Note: Percentile() and Median() locate the necessary elements by selection (in linear time) rather than sorting,
+// except for std::list and yspan which are sorted. The input is taken by value, so the caller's container is not
+// modified (except for yspan, which sorts the underlying elements).
+
+// Overloads for contiguous ranges [first, last), which avoid copying the input. The range is only read.
+//
+// Mean() uses compensated summation in the order given, rather than summing by increasing magnitude as Mean(C) does,
+// since that would need a sorted copy.
+template <class T> T Min(const T *first, const T *last);
+template <class T> T Max(const T *first, const T *last);
+template <class T> T Mean(const T *first, const T *last);
+
+// Percentiles of a contiguous range, defined exactly as for Percentile(C, frac). Percentile() selects from a single
+// working copy of the range. Percentile_In_Place() avoids the copy by partially reordering the range itself, which is
+// worthwhile for very large inputs that can be modified.
+template <class T> T Percentile(const T *first, const T *last, double frac);
+template <class T> T Median(const T *first, const T *last);
+template <class T> T Percentile_In_Place(T *first, T *last, double frac);
+
 //-----------------------------------------------------------------------------------------------------------
 //----------------------------------- Running Accumulators and Tallies --------------------------------------
 //-----------------------------------------------------------------------------------------------------------
+// The accumulators below can digest values one at a time or a contiguous block [first, last) at once, which is
+// considerably faster. Accumulators that digested separate parts of the data (e.g., different image slices, on
+// different threads; see parallel_reduce() in YgorThreadPool.h) can be combined with Merge().
 template <class C>
 class Running_MinMax {
     private:
@@ -42,6 +65,10 @@ class Running_MinMax {
         Running_MinMax();
 
         void Digest(C in);
+        void Digest(const C *first, const C *last);
+
+        // Incorporate the values digested by another accumulator.
+        void Merge(const Running_MinMax<C> &other);
 
         C Current_Min(void) const;
         C Current_Max(void) const;
@@ -50,6 +77,9 @@ class Running_MinMax {
 
 // Implements Kahan (i.e., compensated) summation. Note that the user should attempt to sum the smallest-magnitude
 // inputs first otherwise serious loss of precision may occur.
+//
+// Blocks are digested by summing short runs of values with several independent (vectorizable) partial sums, and
+// then digesting each run's sum. This is slightly less accurate than digesting every value individually.
 template <class C>
 class Running_Sum {
     private:
@@ -60,6 +90,10 @@ class Running_Sum {
         Running_Sum();
 
         void Digest(C in);
+        void Digest(const C *first, const C *last);
+
+        // Incorporate the sum of another accumulator, including its compensation term.
+        void Merge(const Running_Sum<C> &other);
 
         C Current_Sum(void) const;
 };
@@ -67,6 +101,10 @@ class Running_Sum {
 
 // Implements Welford's algorithm for running variance calculation. Uses compensated summation internally
 // to minimize floating-point numerical issues.
+//
+// Accumulators are merged using the pairwise update of Chan, Golub, and LeVeque (1979), which is numerically stable
+// even when the parts have very different means or sizes. Blocks are digested by computing the block's mean and sum
+// of squared deviations in two passes and merging the result.
 template <class C>
 class Running_Variance {
     private:
@@ -78,6 +116,12 @@ class Running_Variance {
         Running_Variance();
 
         void Digest(C in);
+        void Digest(const C *first, const C *last);
+
+        // Incorporate the values digested by another accumulator.
+        void Merge(const Running_Variance<C> &other);
+
+        uint64_t Current_Count(void) const;
 
         C Current_Mean(void) const;
         C Current_Variance(void) const;  // Population variance (divide by N).
@@ -85,6 +129,47 @@ class Running_Variance {
 };
 
 
+// Estimates percentiles of a stream of values in a single pass using a merging t-digest, which summarizes the values
+// with a bounded number of weighted centroids. See:
+//   Dunning T, Ertl O. Computing extremely accurate quantiles using t-digests. arXiv:1902.04023. 2019.
+//
+// Centroids near the extremes hold fewer values than those near the median, so tail percentiles (e.g., the D98 and
+// D2 of a dose-volume histogram) are estimated accurately. Memory use is proportional to the compression parameter,
+// regardless of the number of values digested. Accumulators that digested separate parts of the data (e.g., on
+// separate threads) can be merged.
+//
+// Percentiles follow the definition used by Percentile(), and are exact as long as no centroid holds more than one
+// value, which is always the case for fewer than about compression/2 values. Non-finite values are ignored.
+template <class C>
+class Running_Quantiles {
+    private:
+        double Compression;
+        std::vector<std::pair<double,double>> Centroids; // (mean, weight), sorted by mean.
+        std::vector<std::pair<double,double>> Unmerged;  // Digested but not yet incorporated into the centroids.
+        double Centroid_Weight;  // Total weight of the centroids.
+        double Unmerged_Weight;
+        bool Merge_Descending;  // Direction of the next merging pass.
+        C PresentMin;
+        C PresentMax;
+
+        void Merge_Unmerged();
+
+    public:
+        // Larger compression gives more accurate estimates using more memory. Must be positive.
+        explicit Running_Quantiles(double compression = 200.0);
+
+        void Digest(C in);
+        void Digest(const C *first, const C *last);
+
+        // Incorporate the values digested by another accumulator.
+        void Merge(const Running_Quantiles<C> &other);
+
+        uint64_t Current_Count(void) const;
+        C Current_Percentile(double frac) const;  // frac in [0,1], as for Percentile().
+        C Current_Median(void) const;
+};
+
+
 //-----------------------------------------------------------------------------------------------------------
 //------------------------------------ Statistical Support Routines -----------------------------------------
 //-----------------------------------------------------------------------------------------------------------
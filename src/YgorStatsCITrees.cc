@@ -8,6 +8,7 @@
 #include <limits>
 #include <numeric>
 #include <algorithm>
+#include <utility>
 
 #include "YgorDefinitions.h"
 #include "YgorStatsCITrees.h"
@@ -25,7 +26,9 @@ Stats::ConditionalInferenceTrees<T>::ConditionalInferenceTrees(int64_t max_depth
       alpha(alpha),
       n_permutations(n_permutations),
       n_features_trained(-1),
-      random_seed(random_seed) {
+      random_seed(random_seed),
+      n_threads(0),
+      selection_test(SelectionTest::sequential) {
 
     if(max_depth <= 0){
         throw std::invalid_argument("Maximum depth must be positive");
@@ -67,8 +70,10 @@ void Stats::ConditionalInferenceTrees<T>::fit(const num_array<T> &X, const num_a
     std::iota(sample_indices.begin(), sample_indices.end(), 0);
 
     // Build the tree.
+    MaxTypeTest<T> test(this->selection_test, this->n_permutations, this->alpha, this->n_threads);
     std::mt19937 rng(this->random_seed);
-    this->root = build_tree(X, y, sample_indices, 0, rng);
+    this->root = build_tree(X, y, sample_indices, 0, test, rng);
+    this->compile_trees();
 }
 #ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
     template void Stats::ConditionalInferenceTrees<double>::fit(const num_array<double> &, const num_array<double> &);
@@ -83,6 +88,7 @@ Stats::ConditionalInferenceTrees<T>::build_tree(
     const num_array<T> &y,
     const std::vector<int64_t> &sample_indices,
     int64_t depth,
+    MaxTypeTest<T> &test,
     std::mt19937 &rng) {
 
     auto node = std::make_unique<TreeNode>();
@@ -112,7 +118,7 @@ Stats::ConditionalInferenceTrees<T>::build_tree(
     int64_t best_feature = -1;
     T best_pvalue = static_cast<T>(1);
 
-    if(!select_variable(X, y, sample_indices, best_feature, best_pvalue, rng)){
+    if(!select_variable(X, y, sample_indices, best_feature, best_pvalue, test, rng)){
         // No significant variable found, create leaf.
         node->is_leaf = true;
         node->value = mean;
@@ -149,18 +155,20 @@ Stats::ConditionalInferenceTrees<T>::build_tree(
     node->is_leaf = false;
     node->split_feature = best_feature;
     node->split_threshold = best_threshold;
-    node->left = build_tree(X, y, left_indices, depth + 1, rng);
-    node->right = build_tree(X, y, right_indices, depth + 1, rng);
+    node->left = build_tree(X, y, left_indices, depth + 1, test, rng);
+    node->right = build_tree(X, y, right_indices, depth + 1, test, rng);
 
     return node;
 }
 #ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
     template std::unique_ptr<typename Stats::ConditionalInferenceTrees<double>::TreeNode>
         Stats::ConditionalInferenceTrees<double>::build_tree(const num_array<double> &, const num_array<double> &,
-                                                             const std::vector<int64_t> &, int64_t, std::mt19937 &);
+                                                             const std::vector<int64_t> &, int64_t,
+                                                             Stats::MaxTypeTest<double> &, std::mt19937 &);
     template std::unique_ptr<typename Stats::ConditionalInferenceTrees<float>::TreeNode>
         Stats::ConditionalInferenceTrees<float>::build_tree(const num_array<float> &, const num_array<float> &,
-                                                            const std::vector<int64_t> &, int64_t, std::mt19937 &);
+                                                            const std::vector<int64_t> &, int64_t,
+                                                            Stats::MaxTypeTest<float> &, std::mt19937 &);
 #endif
 
 
@@ -171,6 +179,7 @@ bool Stats::ConditionalInferenceTrees<T>::select_variable(
     const std::vector<int64_t> &sample_indices,
     int64_t &best_feature,
     T &best_pvalue,
+    MaxTypeTest<T> &test,
     std::mt19937 &rng) {
     //
     // Variable selection via a permutation-based max-type global test, following
@@ -188,8 +197,8 @@ bool Stats::ConditionalInferenceTrees<T>::select_variable(
     // the permutation distribution of c_max. This naturally controls for multiple
     // testing across features, avoiding selection bias.
     //
-    // This permutation-based variant avoids the need to compute the incomplete gamma
-    // function that would be required for the asymptotic chi-squared approximation.
+    // The permutations can stop early once the outcome of the test is clear, or be replaced
+    // by an asymptotic approximation (see MaxTypeTest and SelectionTest).
     //
 
     const int64_t n_features = X.num_cols();
@@ -279,64 +288,29 @@ bool Stats::ConditionalInferenceTrees<T>::select_variable(
         return false;
     }
 
-    // Permutation test using shared permutations for all features (global max-type test).
-    // For each permutation, shuffle y_dev, compute the standardized statistic for all valid
-    // features, take the maximum, and compare against the observed maximum.
-    std::vector<T> y_dev_perm(y_dev);
-    int64_t count_ge = 0;
-
-    // Early-exit parameters: check after early_check permutations.
-    const int64_t early_check = std::min(static_cast<int64_t>(100), this->n_permutations);
-
-    for(int64_t k = 0; k < this->n_permutations; ++k){
-        std::shuffle(y_dev_perm.begin(), y_dev_perm.end(), rng);
-
-        // Compute the max standardized statistic across all valid features for this permutation.
-        T perm_max = static_cast<T>(0);
-        for(int64_t j = 0; j < n_features; ++j){
-            if(!feature_valid[j]) continue;
-
-            T perm_stat = static_cast<T>(0);
-            for(int64_t i = 0; i < n_samples; ++i){
-                perm_stat += x_dev[j][i] * y_dev_perm[i];
-            }
-            perm_stat = std::abs(perm_stat) * inv_sqrt_x_ss[j];
-
-            if(perm_stat > perm_max){
-                perm_max = perm_stat;
-            }
-        }
-
-        if(perm_max >= obs_max){
-            ++count_ge;
-        }
-
-        // Early exit: after early_check permutations, if the global test is clearly
-        // non-significant, skip the remaining permutations.
-        if(k + 1 == early_check && early_check < this->n_permutations){
-            const T early_pvalue = static_cast<T>(count_ge + 1) / static_cast<T>(early_check + 1);
-            // If the estimated p-value is much larger than alpha, exit early.
-            // Use a conservative threshold: 2x alpha.
-            if(early_pvalue > static_cast<T>(2) * this->alpha){
-                best_pvalue = early_pvalue;
-                return true;
-            }
-        }
+    // Global max-type test using shared permutations for all valid features. The test draws from its own random
+    // number streams, seeded here so the tree remains reproducible.
+    std::vector<const T *> valid_x_dev;
+    std::vector<T> valid_inv_sqrt_x_ss;
+    for(int64_t j = 0; j < n_features; ++j){
+        if(!feature_valid[j]) continue;
+        valid_x_dev.push_back(x_dev[j].data());
+        valid_inv_sqrt_x_ss.push_back(inv_sqrt_x_ss[j]);
     }
-
-    // Global p-value from the permutation distribution of the max statistic.
-    // Uses the formula (b+1)/(B+1) per Davison & Hinkley (1997) for valid permutation p-values.
-    best_pvalue = static_cast<T>(count_ge + 1) / static_cast<T>(this->n_permutations + 1);
+    const uint64_t seed = (static_cast<uint64_t>(rng()) << 32) | static_cast<uint64_t>(rng());
+    best_pvalue = test.pvalue(valid_x_dev, valid_inv_sqrt_x_ss, y_dev, y_ss, obs_max, seed);
 
     return true;
 }
 #ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
     template bool Stats::ConditionalInferenceTrees<double>::select_variable(
         const num_array<double> &, const num_array<double> &,
-        const std::vector<int64_t> &, int64_t &, double &, std::mt19937 &);
+        const std::vector<int64_t> &, int64_t &, double &,
+        Stats::MaxTypeTest<double> &, std::mt19937 &);
     template bool Stats::ConditionalInferenceTrees<float>::select_variable(
         const num_array<float> &, const num_array<float> &,
-        const std::vector<int64_t> &, int64_t &, float &, std::mt19937 &);
+        const std::vector<int64_t> &, int64_t &, float &,
+        Stats::MaxTypeTest<float> &, std::mt19937 &);
 #endif
 
 
@@ -520,7 +494,7 @@ T Stats::ConditionalInferenceTrees<T>::predict(const num_array<T> &x) const {
         throw std::invalid_argument("Input features must match training data features");
     }
 
-    return predict_tree(this->root.get(), x);
+    return this->flat_tree.predict(&*x.cbegin(), x.num_cols(), false);
 }
 #ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
     template double Stats::ConditionalInferenceTrees<double>::predict(const num_array<double> &) const;
@@ -529,22 +503,32 @@ T Stats::ConditionalInferenceTrees<T>::predict(const num_array<T> &x) const {
 
 
 template <class T>
-T Stats::ConditionalInferenceTrees<T>::predict_tree(const TreeNode *node, const num_array<T> &x) const {
-    if(node->is_leaf){
-        return node->value;
+num_array<T> Stats::ConditionalInferenceTrees<T>::predict_batch(const num_array<T> &X) const {
+    if(!this->root){
+        throw std::runtime_error("Model has not been fitted yet");
     }
+    if(X.num_cols() != this->n_features_trained){
+        throw std::invalid_argument("Input features must match training data features");
+    }
+    return this->flat_tree.predict_batch(X, false, this->n_threads);
+}
+#ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template num_array<double> Stats::ConditionalInferenceTrees<double>::predict_batch(const num_array<double> &) const;
+    template num_array<float> Stats::ConditionalInferenceTrees<float>::predict_batch(const num_array<float> &) const;
+#endif
 
-    // Traverse tree based on feature value.
-    const T feature_val = x.read_coeff(0, node->split_feature);
-    if(feature_val <= node->split_threshold){
-        return predict_tree(node->left.get(), x);
-    }else{
-        return predict_tree(node->right.get(), x);
+
+template <class T>
+void Stats::ConditionalInferenceTrees<T>::compile_trees() {
+    this->flat_tree.clear();
+    if(this->root){
+        this->flat_tree.add_tree(this->root.get());
     }
+    return;
 }
 #ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
-    template double Stats::ConditionalInferenceTrees<double>::predict_tree(const TreeNode *, const num_array<double> &) const;
-    template float Stats::ConditionalInferenceTrees<float>::predict_tree(const TreeNode *, const num_array<float> &) const;
+    template void Stats::ConditionalInferenceTrees<double>::compile_trees();
+    template void Stats::ConditionalInferenceTrees<float>::compile_trees();
 #endif
 
 
@@ -568,6 +552,46 @@ int64_t Stats::ConditionalInferenceTrees<T>::get_n_permutations() const {
 #endif
 
 
+template <class T>
+void Stats::ConditionalInferenceTrees<T>::set_n_threads(int64_t n) {
+    this->n_threads = n;
+}
+#ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::ConditionalInferenceTrees<double>::set_n_threads(int64_t);
+    template void Stats::ConditionalInferenceTrees<float>::set_n_threads(int64_t);
+#endif
+
+
+template <class T>
+int64_t Stats::ConditionalInferenceTrees<T>::get_n_threads() const {
+    return this->n_threads;
+}
+#ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template int64_t Stats::ConditionalInferenceTrees<double>::get_n_threads() const;
+    template int64_t Stats::ConditionalInferenceTrees<float>::get_n_threads() const;
+#endif
+
+
+template <class T>
+void Stats::ConditionalInferenceTrees<T>::set_selection_test(Stats::SelectionTest test) {
+    this->selection_test = test;
+}
+#ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::ConditionalInferenceTrees<double>::set_selection_test(Stats::SelectionTest);
+    template void Stats::ConditionalInferenceTrees<float>::set_selection_test(Stats::SelectionTest);
+#endif
+
+
+template <class T>
+Stats::SelectionTest Stats::ConditionalInferenceTrees<T>::get_selection_test() const {
+    return this->selection_test;
+}
+#ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template Stats::SelectionTest Stats::ConditionalInferenceTrees<double>::get_selection_test() const;
+    template Stats::SelectionTest Stats::ConditionalInferenceTrees<float>::get_selection_test() const;
+#endif
+
+
 template <class T>
 bool Stats::ConditionalInferenceTrees<T>::write_tree_node(std::ostream &os, const TreeNode *node) const {
     if(node == nullptr){
@@ -723,8 +747,10 @@ bool Stats::ConditionalInferenceTrees<T>::read_from(std::istream &is) {
     is >> label;
     if(is.fail() || label != "begin_tree") return false;
 
+    this->flat_tree.clear();
     this->root = read_tree_node(is);
     if(!this->root) return false;
+    this->compile_trees();
 
     is >> label;
     if(is.fail() || label != "end_tree") return false;
@@ -740,3 +766,75 @@ bool Stats::ConditionalInferenceTrees<T>::read_from(std::istream &is) {
     template bool Stats::ConditionalInferenceTrees<double>::read_from(std::istream &);
     template bool Stats::ConditionalInferenceTrees<float>::read_from(std::istream &);
 #endif
+
+
+template <class T>
+bool Stats::ConditionalInferenceTrees<T>::write_binary(std::ostream &os) const {
+    if(!this->root || (this->n_features_trained <= 0)){
+        return false;
+    }
+    BinaryModelSection s;
+    s.put(this->max_depth);
+    s.put(this->min_samples_split);
+    s.put(this->alpha);
+    s.put(this->n_permutations);
+    s.put(this->random_seed);
+    return this->flat_tree.write_binary(os, BinaryModelKind::conditional_inference_trees,
+                                        this->n_features_trained, s.str());
+}
+#ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::ConditionalInferenceTrees<double>::write_binary(std::ostream &) const;
+    template bool Stats::ConditionalInferenceTrees<float>::write_binary(std::ostream &) const;
+#endif
+
+
+template <class T>
+bool Stats::ConditionalInferenceTrees<T>::read_binary(std::istream &is) {
+    try{
+    FlatForest<T> flat;
+    int64_t n_features = 0;
+    std::string bytes;
+    if(!flat.read_binary(is, BinaryModelKind::conditional_inference_trees, n_features, bytes)) return false;
+
+    // Read parameters.
+    BinaryModelSection s(bytes);
+    int64_t l_max_depth = 0;
+    int64_t l_min_samples_split = 0;
+    T l_alpha = static_cast<T>(0);
+    int64_t l_n_permutations = 0;
+    uint64_t l_random_seed = 0;
+    if( !s.get(l_max_depth)
+    ||  !s.get(l_min_samples_split)
+    ||  !s.get(l_alpha)
+    ||  !s.get(l_n_permutations)
+    ||  !s.get(l_random_seed)
+    ||  !s.at_end() ) return false;
+
+    // Validate hyperparameter invariants, as read_from() does.
+    if( (l_max_depth <= 0)
+    ||  (l_min_samples_split < 2)
+    ||  !(static_cast<T>(0) < l_alpha && l_alpha < static_cast<T>(1))
+    ||  (l_n_permutations <= 0)
+    ||  (n_features <= 0)
+    ||  (flat.get_n_trees() != 1) ) return false;
+
+    auto l_root = flat.template expand_tree<TreeNode>(0);
+
+    this->max_depth = l_max_depth;
+    this->min_samples_split = l_min_samples_split;
+    this->alpha = l_alpha;
+    this->n_permutations = l_n_permutations;
+    this->n_features_trained = n_features;
+    this->random_seed = l_random_seed;
+    this->root = std::move(l_root);
+    this->flat_tree = std::move(flat);
+    return true;
+
+    }catch(const std::exception &){
+        return false;
+    }
+}
+#ifndef YGOR_STATS_CI_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::ConditionalInferenceTrees<double>::read_binary(std::istream &);
+    template bool Stats::ConditionalInferenceTrees<float>::read_binary(std::istream &);
+#endif
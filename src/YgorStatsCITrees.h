@@ -20,6 +20,8 @@
 
 #include "YgorDefinitions.h"
 #include "YgorMath.h"
+#include "YgorStatsFlatTrees.h"
+#include "YgorStatsPermutationTests.h"
 
 namespace Stats {
 
@@ -32,7 +34,9 @@ namespace Stats {
 // Key features:
 //  - Permutation-based testing for variable selection (avoids selection bias)
 //  - Statistical significance threshold (alpha) as stopping criterion
-//  - Early-exit optimization for clearly non-significant variables
+//  - Sequential stopping of the permutation test once its outcome is clear, or an asymptotic
+//    approximation that avoids permutations entirely (see SelectionTest)
+//  - Permutations evaluated concurrently, with results independent of the number of threads
 //
 template <class T>
 class ConditionalInferenceTrees {
@@ -51,12 +55,15 @@ class ConditionalInferenceTrees {
         };
 
         std::unique_ptr<TreeNode> root;       // Root of the decision tree.
+        FlatForest<T> flat_tree;              // Flattened copy of the tree, for batch prediction.
         int64_t max_depth;                    // Maximum depth of the tree.
         int64_t min_samples_split;            // Minimum samples required to split a node.
         T alpha;                              // Significance threshold for stopping.
         int64_t n_permutations;               // Number of permutations for testing.
         int64_t n_features_trained;           // Number of features the model was trained on.
         uint64_t random_seed;                 // Random seed for reproducibility.
+        int64_t n_threads;                    // Number of threads for permutation tests. Zero uses all hardware threads.
+        SelectionTest selection_test;         // How the p-value of the variable selection test is estimated.
 
         // Build the conditional inference tree recursively.
         std::unique_ptr<TreeNode> build_tree(
@@ -64,6 +71,7 @@ class ConditionalInferenceTrees {
             const num_array<T> &y,
             const std::vector<int64_t> &sample_indices,
             int64_t depth,
+            MaxTypeTest<T> &test,
             std::mt19937 &rng
         );
 
@@ -77,6 +85,7 @@ class ConditionalInferenceTrees {
             const std::vector<int64_t> &sample_indices,
             int64_t &best_feature,
             T &best_pvalue,
+            MaxTypeTest<T> &test,
             std::mt19937 &rng
         );
 
@@ -107,8 +116,8 @@ class ConditionalInferenceTrees {
             const std::vector<int64_t> &right_indices
         );
 
-        // Predict using the tree from a given node.
-        T predict_tree(const TreeNode *node, const num_array<T> &x) const;
+        // Rebuild the flattened copy of the tree. Called whenever the tree changes.
+        void compile_trees();
 
         // Serialization helpers.
         bool write_tree_node(std::ostream &os, const TreeNode *node) const;
@@ -160,12 +169,45 @@ class ConditionalInferenceTrees {
         //   std::runtime_error if model has not been fitted yet.
         T predict(const num_array<T> &x) const;
 
+        // Predict scalar outputs for many samples at once.
+        //
+        // Equivalent to calling predict() on each row of X, and the results are bit-identical, but
+        // much faster for large inputs: the tree is evaluated from a flattened, contiguous form, rows
+        // are processed in cache-sized blocks, and blocks are distributed over threads (see set_n_threads()).
+        //
+        // Parameters:
+        //   X: NxM matrix of input features (M must match the number of features used in fit()).
+        //
+        // Returns:
+        //   Nx1 matrix of predicted values.
+        //
+        // Throws:
+        //   std::invalid_argument if X has the wrong number of features.
+        //   std::runtime_error if model has not been fitted yet.
+        num_array<T> predict_batch(const num_array<T> &X) const;
+
         // Get the significance threshold (alpha).
         T get_alpha() const;
 
         // Get the number of permutations.
         int64_t get_n_permutations() const;
 
+        // Set the number of threads used to evaluate permutation tests during fitting and by predict_batch().
+        // Zero (the default) uses all hardware threads. Neither the fitted tree nor the predictions depend on
+        // the number of threads.
+        void set_n_threads(int64_t n);
+
+        // Get the number of threads.
+        int64_t get_n_threads() const;
+
+        // Set how the p-value of the variable selection test is estimated (default: sequential).
+        // The number of permutations is the upper limit for the sequential test and unused by the
+        // asymptotic test. This is a fitting option, and is not serialized.
+        void set_selection_test(SelectionTest test);
+
+        // Get the variable selection test.
+        SelectionTest get_selection_test() const;
+
         // Write the model to a text stream.
         //
         // Serializes all data members, parameters, and tree structure to a human-readable
@@ -190,6 +232,31 @@ class ConditionalInferenceTrees {
         // Returns:
         //   true on success, false if the stream format is invalid or enters a fail state.
         bool read_from(std::istream &is);
+
+        // Write the model in the binary model format (see YgorStatsFlatTrees.h).
+        //
+        // The binary format holds the same information as write_to(), but loads much faster since
+        // the trees are stored as flattened node arrays that are read in bulk rather than parsed.
+        // Binary models are specific to the floating-point type and byte order of the writer.
+        //
+        // Parameters:
+        //   os: Output stream to write to. Should be opened in binary mode.
+        //
+        // Returns:
+        //   true on success, false if the model has not been fitted or the stream enters a fail state.
+        bool write_binary(std::ostream &os) const;
+
+        // Read a model from a binary stream.
+        //
+        // Restores a model previously written by write_binary(). The model is only modified if
+        // reading succeeds. Use Stats::is_binary_model() to distinguish binary and text models.
+        //
+        // Parameters:
+        //   is: Input stream to read from. Should be opened in binary mode.
+        //
+        // Returns:
+        //   true on success, false if the stream does not hold a valid binary model of this kind.
+        bool read_binary(std::istream &is);
 };
 
 } //namespace Stats.
@@ -2,7 +2,6 @@
 
 #include <cmath>
 #include <cstdint>
-#include <map>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -10,10 +9,57 @@
 #include <limits>
 #include <numeric>
 #include <algorithm>
+#include <utility>
+#include <exception>
+#include <functional>
+#include <thread>
 
 #include "YgorDefinitions.h"
 #include "YgorStatsConditionalForests.h"
 #include "YgorLog.h"
+#include "YgorThreadPool.h"
+
+
+namespace {
+
+// Derive an independent random number stream for each (tree, feature) pair, so pairs can be evaluated in any order.
+std::mt19937_64 make_pair_rng(uint64_t random_seed, int64_t tree_index, int64_t feature){
+    const auto t = static_cast<uint64_t>(tree_index);
+    const auto f = static_cast<uint64_t>(feature);
+    std::seed_seq seq{ static_cast<uint32_t>(random_seed), static_cast<uint32_t>(random_seed >> 32),
+                       static_cast<uint32_t>(t), static_cast<uint32_t>(t >> 32),
+                       static_cast<uint32_t>(f), static_cast<uint32_t>(f >> 32) };
+    return std::mt19937_64(seq);
+}
+
+// Run count independent tasks using up to n_workers threads. The first exception thrown by any task is rethrown.
+void run_tasks(int64_t n_workers, int64_t count, const std::function<void(int64_t)> &task){
+    std::vector<std::exception_ptr> errors(count);
+    const auto guarded = [&](int64_t i){
+        try{
+            task(i);
+        }catch(...){
+            errors[i] = std::current_exception();
+        }
+    };
+
+    n_workers = std::min(n_workers, count);
+    if(n_workers <= 1){
+        for(int64_t i = 0; i < count; ++i) guarded(i);
+    }else{
+        work_queue<std::function<void()>> wq(static_cast<unsigned int>(n_workers));
+        for(int64_t i = 0; i < count; ++i){
+            wq.submit_task([&, i](){ guarded(i); });
+        }
+        // Note: the destructor waits for all submitted tasks to complete.
+    }
+    for(const auto &e : errors){
+        if(e) std::rethrow_exception(e);
+    }
+    return;
+}
+
+} // namespace
 
 
 template <class T>
@@ -36,6 +82,8 @@ Stats::ConditionalRandomForests<T>::ConditionalRandomForests(int64_t n_trees,
       n_features_trained(-1),
       random_seed(random_seed),
       correlation_threshold(correlation_threshold),
+      n_threads(0),
+      selection_test(SelectionTest::sequential),
       importance_method(ConditionalImportanceMethod::none) {
 
     if(n_trees <= 0){
@@ -85,8 +133,10 @@ void Stats::ConditionalRandomForests<T>::fit(const num_array<T> &X, const num_ar
     // Clear any existing trees and importance data.
     this->trees.clear();
     this->trees.reserve(this->n_trees);
+    this->flat_trees.clear();
     this->feature_importances.clear();
     this->oob_indices_per_tree.clear();
+    this->conditioning_grids.clear();
 
     if(this->importance_method != ConditionalImportanceMethod::none){
         this->oob_indices_per_tree.reserve(this->n_trees);
@@ -102,6 +152,7 @@ void Stats::ConditionalRandomForests<T>::fit(const num_array<T> &X, const num_ar
     std::iota(all_indices.begin(), all_indices.end(), 0);
 
     // Build each tree with subsampling without replacement.
+    MaxTypeTest<T> test(this->selection_test, this->n_permutations, this->alpha, this->n_threads);
     std::mt19937 rng(this->random_seed);
 
     for(int64_t t = 0; t < this->n_trees; ++t){
@@ -128,9 +179,14 @@ void Stats::ConditionalRandomForests<T>::fit(const num_array<T> &X, const num_ar
         }
 
         // Build a conditional inference tree on the subsample.
-        auto tree = build_tree(X, y, subsample_indices, 0, rng);
+        auto tree = build_tree(X, y, subsample_indices, 0, test, rng);
         this->trees.push_back(std::move(tree));
     }
+    this->compile_trees();
+
+    if(this->importance_method == ConditionalImportanceMethod::conditional){
+        this->compute_conditioning_grids(X);
+    }
 }
 #ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
     template void Stats::ConditionalRandomForests<double>::fit(const num_array<double> &, const num_array<double> &);
@@ -145,6 +201,7 @@ Stats::ConditionalRandomForests<T>::build_tree(
     const num_array<T> &y,
     const std::vector<int64_t> &sample_indices,
     int64_t depth,
+    MaxTypeTest<T> &test,
     std::mt19937 &rng) {
 
     auto node = std::make_unique<TreeNode>();
@@ -174,7 +231,7 @@ Stats::ConditionalRandomForests<T>::build_tree(
     int64_t best_feature = -1;
     T best_pvalue = static_cast<T>(1);
 
-    if(!select_variable(X, y, sample_indices, best_feature, best_pvalue, rng)){
+    if(!select_variable(X, y, sample_indices, best_feature, best_pvalue, test, rng)){
         node->is_leaf = true;
         node->value = mean;
         return node;
@@ -209,18 +266,20 @@ Stats::ConditionalRandomForests<T>::build_tree(
     node->is_leaf = false;
     node->split_feature = best_feature;
     node->split_threshold = best_threshold;
-    node->left = build_tree(X, y, left_indices, depth + 1, rng);
-    node->right = build_tree(X, y, right_indices, depth + 1, rng);
+    node->left = build_tree(X, y, left_indices, depth + 1, test, rng);
+    node->right = build_tree(X, y, right_indices, depth + 1, test, rng);
 
     return node;
 }
 #ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
     template std::unique_ptr<typename Stats::ConditionalRandomForests<double>::TreeNode>
         Stats::ConditionalRandomForests<double>::build_tree(const num_array<double> &, const num_array<double> &,
-                                                             const std::vector<int64_t> &, int64_t, std::mt19937 &);
+                                                             const std::vector<int64_t> &, int64_t,
+                                                             Stats::MaxTypeTest<double> &, std::mt19937 &);
     template std::unique_ptr<typename Stats::ConditionalRandomForests<float>::TreeNode>
         Stats::ConditionalRandomForests<float>::build_tree(const num_array<float> &, const num_array<float> &,
-                                                            const std::vector<int64_t> &, int64_t, std::mt19937 &);
+                                                            const std::vector<int64_t> &, int64_t,
+                                                            Stats::MaxTypeTest<float> &, std::mt19937 &);
 #endif
 
 
@@ -231,6 +290,7 @@ bool Stats::ConditionalRandomForests<T>::select_variable(
     const std::vector<int64_t> &sample_indices,
     int64_t &best_feature,
     T &best_pvalue,
+    MaxTypeTest<T> &test,
     std::mt19937 &rng) {
     //
     // Variable selection via a permutation-based max-type global test, following
@@ -242,6 +302,8 @@ bool Stats::ConditionalRandomForests<T>::select_variable(
     // This is the same method used in ConditionalInferenceTrees. When max_features > 0,
     // only a random subset of features is evaluated (for computational efficiency in
     // large forests), but the permutation-based testing is still used for variable selection.
+    // The permutations can stop early once the outcome of the test is clear, or be replaced
+    // by an asymptotic approximation (see MaxTypeTest and SelectionTest).
     //
 
     const int64_t n_features = X.num_cols();
@@ -350,56 +412,28 @@ bool Stats::ConditionalRandomForests<T>::select_variable(
 
     best_feature = candidate_features[best_candidate_idx];
 
-    // Permutation test using shared permutations for all candidate features.
-    std::vector<T> y_dev_perm(y_dev);
-    int64_t count_ge = 0;
-
-    const int64_t early_check = std::min(static_cast<int64_t>(100), this->n_permutations);
-
-    for(int64_t k = 0; k < this->n_permutations; ++k){
-        std::shuffle(y_dev_perm.begin(), y_dev_perm.end(), rng);
-
-        T perm_max = static_cast<T>(0);
-        for(int64_t c = 0; c < n_candidates; ++c){
-            if(!feature_valid[c]) continue;
-
-            T perm_stat = static_cast<T>(0);
-            for(int64_t i = 0; i < n_samples; ++i){
-                perm_stat += x_dev[c][i] * y_dev_perm[i];
-            }
-            perm_stat = std::abs(perm_stat) * inv_sqrt_x_ss[c];
-
-            if(perm_stat > perm_max){
-                perm_max = perm_stat;
-            }
-        }
-
-        if(perm_max >= obs_max){
-            ++count_ge;
-        }
-
-        // Early exit for clearly non-significant tests.
-        if(k + 1 == early_check && early_check < this->n_permutations){
-            const T early_pvalue = static_cast<T>(count_ge + 1) / static_cast<T>(early_check + 1);
-            if(early_pvalue > static_cast<T>(2) * this->alpha){
-                best_pvalue = early_pvalue;
-                return true;
-            }
-        }
+    // Global max-type test using shared permutations for all valid candidate features.
+    std::vector<const T *> valid_x_dev;
+    std::vector<T> valid_inv_sqrt_x_ss;
+    for(int64_t c = 0; c < n_candidates; ++c){
+        if(!feature_valid[c]) continue;
+        valid_x_dev.push_back(x_dev[c].data());
+        valid_inv_sqrt_x_ss.push_back(inv_sqrt_x_ss[c]);
     }
-
-    // Global p-value: (b+1)/(B+1) per Davison & Hinkley (1997).
-    best_pvalue = static_cast<T>(count_ge + 1) / static_cast<T>(this->n_permutations + 1);
+    const uint64_t seed = (static_cast<uint64_t>(rng()) << 32) | static_cast<uint64_t>(rng());
+    best_pvalue = test.pvalue(valid_x_dev, valid_inv_sqrt_x_ss, y_dev, y_ss, obs_max, seed);
 
     return true;
 }
 #ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
     template bool Stats::ConditionalRandomForests<double>::select_variable(
         const num_array<double> &, const num_array<double> &,
-        const std::vector<int64_t> &, int64_t &, double &, std::mt19937 &);
+        const std::vector<int64_t> &, int64_t &, double &,
+        Stats::MaxTypeTest<double> &, std::mt19937 &);
     template bool Stats::ConditionalRandomForests<float>::select_variable(
         const num_array<float> &, const num_array<float> &,
-        const std::vector<int64_t> &, int64_t &, float &, std::mt19937 &);
+        const std::vector<int64_t> &, int64_t &, float &,
+        Stats::MaxTypeTest<float> &, std::mt19937 &);
 #endif
 
 
@@ -536,12 +570,7 @@ T Stats::ConditionalRandomForests<T>::predict(const num_array<T> &x) const {
         throw std::invalid_argument("Input features must match training data features");
     }
 
-    T sum = static_cast<T>(0);
-    for(const auto &tree : this->trees){
-        sum += predict_tree(tree.get(), x);
-    }
-
-    return sum / static_cast<T>(this->trees.size());
+    return this->flat_trees.predict(&*x.cbegin(), x.num_cols(), true);
 }
 #ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
     template double Stats::ConditionalRandomForests<double>::predict(const num_array<double> &) const;
@@ -550,21 +579,32 @@ T Stats::ConditionalRandomForests<T>::predict(const num_array<T> &x) const {
 
 
 template <class T>
-T Stats::ConditionalRandomForests<T>::predict_tree(const TreeNode *node, const num_array<T> &x) const {
-    if(node->is_leaf){
-        return node->value;
+num_array<T> Stats::ConditionalRandomForests<T>::predict_batch(const num_array<T> &X) const {
+    if(this->trees.empty()){
+        throw std::runtime_error("Model has not been fitted yet");
     }
+    if(X.num_cols() != this->n_features_trained){
+        throw std::invalid_argument("Input features must match training data features");
+    }
+    return this->flat_trees.predict_batch(X, true, this->n_threads);
+}
+#ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template num_array<double> Stats::ConditionalRandomForests<double>::predict_batch(const num_array<double> &) const;
+    template num_array<float> Stats::ConditionalRandomForests<float>::predict_batch(const num_array<float> &) const;
+#endif
 
-    const T feature_val = x.read_coeff(0, node->split_feature);
-    if(feature_val <= node->split_threshold){
-        return predict_tree(node->left.get(), x);
-    }else{
-        return predict_tree(node->right.get(), x);
+
+template <class T>
+void Stats::ConditionalRandomForests<T>::compile_trees() {
+    this->flat_trees.clear();
+    for(const auto &tree : this->trees){
+        this->flat_trees.add_tree(tree.get());
     }
+    return;
 }
 #ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
-    template double Stats::ConditionalRandomForests<double>::predict_tree(const TreeNode *, const num_array<double> &) const;
-    template float Stats::ConditionalRandomForests<float>::predict_tree(const TreeNode *, const num_array<float> &) const;
+    template void Stats::ConditionalRandomForests<double>::compile_trees();
+    template void Stats::ConditionalRandomForests<float>::compile_trees();
 #endif
 
 
@@ -608,6 +648,46 @@ T Stats::ConditionalRandomForests<T>::get_correlation_threshold() const {
 #endif
 
 
+template <class T>
+void Stats::ConditionalRandomForests<T>::set_n_threads(int64_t n) {
+    this->n_threads = n;
+}
+#ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::ConditionalRandomForests<double>::set_n_threads(int64_t);
+    template void Stats::ConditionalRandomForests<float>::set_n_threads(int64_t);
+#endif
+
+
+template <class T>
+int64_t Stats::ConditionalRandomForests<T>::get_n_threads() const {
+    return this->n_threads;
+}
+#ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template int64_t Stats::ConditionalRandomForests<double>::get_n_threads() const;
+    template int64_t Stats::ConditionalRandomForests<float>::get_n_threads() const;
+#endif
+
+
+template <class T>
+void Stats::ConditionalRandomForests<T>::set_selection_test(Stats::SelectionTest test) {
+    this->selection_test = test;
+}
+#ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::ConditionalRandomForests<double>::set_selection_test(Stats::SelectionTest);
+    template void Stats::ConditionalRandomForests<float>::set_selection_test(Stats::SelectionTest);
+#endif
+
+
+template <class T>
+Stats::SelectionTest Stats::ConditionalRandomForests<T>::get_selection_test() const {
+    return this->selection_test;
+}
+#ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template Stats::SelectionTest Stats::ConditionalRandomForests<double>::get_selection_test() const;
+    template Stats::SelectionTest Stats::ConditionalRandomForests<float>::get_selection_test() const;
+#endif
+
+
 template <class T>
 void Stats::ConditionalRandomForests<T>::set_importance_method(Stats::ConditionalImportanceMethod method) {
     if(this->n_features_trained != -1){
@@ -642,6 +722,102 @@ std::vector<T> Stats::ConditionalRandomForests<T>::get_feature_importances() con
 #endif
 
 
+template <class T>
+void Stats::ConditionalRandomForests<T>::compute_conditioning_grids(const num_array<T> &X) {
+    // Per Strobl et al. (2008), the conditioning set Z for feature Xj consists of all other features whose absolute
+    // Pearson correlation with Xj exceeds the correlation_threshold. Each conditioning variable is "cut at its median"
+    // over the training data.
+    const int64_t n_samples = X.num_rows();
+    const int64_t n_features = X.num_cols();
+
+    int64_t n_workers = this->n_threads;
+    if(n_workers <= 0){
+        n_workers = std::max<int64_t>(1, static_cast<int64_t>(std::thread::hardware_concurrency()));
+    }
+
+    // Extract each feature's deviations from its mean, and its standard deviation.
+    std::vector<std::vector<T>> feat_dev(n_features, std::vector<T>(n_samples));
+    std::vector<T> feat_sd(n_features, static_cast<T>(0));
+    for(int64_t f = 0; f < n_features; ++f){
+        T fsum = static_cast<T>(0);
+        for(int64_t i = 0; i < n_samples; ++i){
+            fsum += X.read_coeff(i, f);
+        }
+        const T feat_mean = fsum / static_cast<T>(n_samples);
+
+        T sq_dev_sum = static_cast<T>(0);
+        for(int64_t i = 0; i < n_samples; ++i){
+            const T dev = X.read_coeff(i, f) - feat_mean;
+            feat_dev[f][i] = dev;
+            sq_dev_sum += dev * dev;
+        }
+        feat_sd[f] = std::sqrt(sq_dev_sum / static_cast<T>(n_samples));
+    }
+
+    // Compute pairwise absolute Pearson correlations and build conditioning sets. Each pair is only computed once.
+    std::vector<std::vector<T>> corr(n_features, std::vector<T>(n_features, static_cast<T>(0)));
+    run_tasks(n_workers, n_features, [&](int64_t j){
+        if(feat_sd[j] <= static_cast<T>(0)) return;
+        for(int64_t k = j + 1; k < n_features; ++k){
+            if(feat_sd[k] <= static_cast<T>(0)) continue;
+            T cov_sum = static_cast<T>(0);
+            for(int64_t i = 0; i < n_samples; ++i){
+                cov_sum += feat_dev[j][i] * feat_dev[k][i];
+            }
+            corr[j][k] = cov_sum / (static_cast<T>(n_samples) * feat_sd[j] * feat_sd[k]);
+        }
+    });
+
+    // Limit the number of conditioning variables used to form the grid to avoid an excessive number of cells
+    // (2^n_cond cells). With many conditioning variables, cells become too sparse for meaningful within-cell
+    // permutation.
+    const size_t max_cond_vars = 10;
+
+    std::vector<ConditioningGrid> grids(n_features);
+    std::vector<bool> needs_median(n_features, false);
+    for(int64_t j = 0; j < n_features; ++j){
+        for(int64_t k = 0; (k < n_features) && (grids[j].variables.size() < max_cond_vars); ++k){
+            if(k == j) continue;
+            const T r = (j < k) ? corr[j][k] : corr[k][j];
+            if(std::abs(r) > this->correlation_threshold){
+                grids[j].variables.push_back(k);
+                needs_median[k] = true;
+            }
+        }
+    }
+
+    // Compute the medians of the conditioning variables.
+    std::vector<T> medians(n_features, static_cast<T>(0));
+    run_tasks(n_workers, n_features, [&](int64_t f){
+        if(!needs_median[f]) return;
+        std::vector<T> vals(n_samples);
+        for(int64_t i = 0; i < n_samples; ++i){
+            vals[i] = X.read_coeff(i, f);
+        }
+        const auto mid = vals.begin() + n_samples / 2;
+        std::nth_element(vals.begin(), mid, vals.end());
+        if(n_samples % 2 == 0){
+            const T lower = *std::max_element(vals.begin(), mid);
+            medians[f] = (lower + *mid) / static_cast<T>(2);
+        }else{
+            medians[f] = *mid;
+        }
+    });
+    for(auto &grid : grids){
+        for(const auto cv : grid.variables){
+            grid.medians.push_back(medians[cv]);
+        }
+    }
+
+    this->conditioning_grids = std::move(grids);
+    return;
+}
+#ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::ConditionalRandomForests<double>::compute_conditioning_grids(const num_array<double> &);
+    template void Stats::ConditionalRandomForests<float>::compute_conditioning_grids(const num_array<float> &);
+#endif
+
+
 template <class T>
 void Stats::ConditionalRandomForests<T>::compute_importance(
     const num_array<T> &X, const num_array<T> &y) {
@@ -668,226 +844,140 @@ void Stats::ConditionalRandomForests<T>::compute_importance(
     if(this->oob_indices_per_tree.size() != static_cast<size_t>(this->n_trees)){
         throw std::runtime_error("OOB indices not available; model may not have been fitted with importance enabled");
     }
-
-    this->feature_importances.assign(n_features, static_cast<T>(0));
-
-    std::mt19937 rng(this->random_seed + 1);
-    int64_t n_trees_with_oob = 0;
-
-    // Pre-extract feature columns for correlation computation (conditional method).
-    // Also precompute the feature correlation matrix for the conditional method.
-    // Per Strobl et al. (2008), the conditioning set Z for feature Xj consists
-    // of all other features whose absolute Pearson correlation with Xj exceeds
-    // the correlation_threshold.
-    std::vector<std::vector<int64_t>> conditioning_sets;
-    if(this->importance_method == ConditionalImportanceMethod::conditional){
-        // Precompute feature means and standard deviations.
-        std::vector<T> feat_mean(n_features, static_cast<T>(0));
-        std::vector<T> feat_sd(n_features, static_cast<T>(0));
-        for(int64_t f = 0; f < n_features; ++f){
-            T fsum = static_cast<T>(0);
-            for(int64_t i = 0; i < n_samples; ++i){
-                fsum += X.read_coeff(i, f);
-            }
-            feat_mean[f] = fsum / static_cast<T>(n_samples);
-
-            T sq_dev_sum = static_cast<T>(0);
-            for(int64_t i = 0; i < n_samples; ++i){
-                const T dev = X.read_coeff(i, f) - feat_mean[f];
-                sq_dev_sum += dev * dev;
+    for(const auto &oob : this->oob_indices_per_tree){
+        for(const auto idx : oob){
+            if(idx < 0 || n_samples <= idx){
+                throw std::invalid_argument("OOB indices do not match the training data");
             }
-            feat_sd[f] = std::sqrt(sq_dev_sum / static_cast<T>(n_samples));
         }
+    }
 
-        // Compute pairwise absolute Pearson correlations and build conditioning sets.
-        conditioning_sets.resize(n_features);
-        for(int64_t j = 0; j < n_features; ++j){
-            for(int64_t k = 0; k < n_features; ++k){
-                if(k == j) continue;
-                if(feat_sd[j] <= static_cast<T>(0) || feat_sd[k] <= static_cast<T>(0)) continue;
+    const bool conditional = (this->importance_method == ConditionalImportanceMethod::conditional);
+    if(conditional && (this->conditioning_grids.size() != static_cast<size_t>(n_features))){
+        // Models read from a stream, or fitted before the method was set, have no grids yet.
+        this->compute_conditioning_grids(X);
+    }
 
-                // Compute Pearson correlation between features j and k.
-                T cov_sum = static_cast<T>(0);
-                for(int64_t i = 0; i < n_samples; ++i){
-                    cov_sum += (X.read_coeff(i, j) - feat_mean[j]) *
-                               (X.read_coeff(i, k) - feat_mean[k]);
-                }
-                const T corr = cov_sum / (static_cast<T>(n_samples) * feat_sd[j] * feat_sd[k]);
+    int64_t n_workers = this->n_threads;
+    if(n_workers <= 0){
+        n_workers = std::max<int64_t>(1, static_cast<int64_t>(std::thread::hardware_concurrency()));
+    }
 
-                if(std::abs(corr) > this->correlation_threshold){
-                    conditioning_sets[j].push_back(k);
+    // Assign every sample to a cell of each feature's grid, encoded in binary over the conditioning variables: for
+    // each conditioning variable, 0 if below or equal to the median, 1 if above.
+    std::vector<std::vector<uint32_t>> cells(conditional ? n_features : 0);
+    if(conditional){
+        run_tasks(n_workers, n_features, [&](int64_t feat){
+            const auto &grid = this->conditioning_grids[feat];
+            if(grid.variables.empty()) return;
+            auto &c = cells[feat];
+            c.assign(n_samples, 0);
+            for(size_t v = 0; v < grid.variables.size(); ++v){
+                const int64_t cv = grid.variables[v];
+                for(int64_t i = 0; i < n_samples; ++i){
+                    if(X.read_coeff(i, cv) > grid.medians[v]){
+                        c[i] |= (static_cast<uint32_t>(1) << v);
+                    }
                 }
             }
-        }
+        });
     }
 
-    // Preallocate a single row buffer for predictions.
-    num_array<T> x_row(1, n_features);
+    // Gather the OOB samples of a tree in row-major order, and score a tree on them.
+    const auto gather_rows = [&](const std::vector<int64_t> &oob, std::vector<T> &rows){
+        const int64_t n_oob = static_cast<int64_t>(oob.size());
+        rows.resize(n_oob * n_features);
+        for(int64_t f = 0; f < n_features; ++f){
+            for(int64_t i = 0; i < n_oob; ++i){
+                rows[i * n_features + f] = X.read_coeff(oob[i], f);
+            }
+        }
+    };
+    const auto oob_ssr = [&](int64_t t, const std::vector<int64_t> &oob, const std::vector<T> &rows){
+        const int64_t n_oob = static_cast<int64_t>(oob.size());
+        std::vector<T> preds(n_oob);
+        this->flat_trees.predict_tree(t, rows.data(), n_oob, n_features, preds.data());
+        T ssr = static_cast<T>(0);
+        for(int64_t i = 0; i < n_oob; ++i){
+            const T residual = y.read_coeff(oob[i], 0) - preds[i];
+            ssr += residual * residual;
+        }
+        return ssr;
+    };
 
-    for(int64_t t = 0; t < this->n_trees; ++t){
+    // Compute the baseline OOB SSR of each tree.
+    std::vector<T> baseline_ssr(this->n_trees, static_cast<T>(0));
+    run_tasks(n_workers, this->n_trees, [&](int64_t t){
+        const auto &oob = this->oob_indices_per_tree[t];
+        if(oob.empty()) return;
+        std::vector<T> rows;
+        gather_rows(oob, rows);
+        baseline_ssr[t] = oob_ssr(t, oob, rows);
+    });
+
+    // Compute the increase in OOB SSR for each (tree, feature) pair.
+    std::vector<T> increase(this->n_trees * n_features, static_cast<T>(0));
+    run_tasks(n_workers, this->n_trees * n_features, [&](int64_t pair){
+        const int64_t t = pair / n_features;
+        const int64_t feat = pair % n_features;
         const auto &oob = this->oob_indices_per_tree[t];
         const int64_t n_oob = static_cast<int64_t>(oob.size());
-        if(n_oob == 0) continue;
-        ++n_trees_with_oob;
+        if(n_oob == 0) return;
 
-        // Compute baseline OOB SSR for this tree.
-        T baseline_ssr = static_cast<T>(0);
-        for(const auto idx : oob){
-            for(int64_t f = 0; f < n_features; ++f){
-                x_row.coeff(0, f) = X.read_coeff(idx, f);
-            }
-            const T pred = predict_tree(this->trees[t].get(), x_row);
-            const T residual = y.read_coeff(idx, 0) - pred;
-            baseline_ssr += residual * residual;
+        auto rng = make_pair_rng(this->random_seed + 1, t, feat);
+        std::vector<T> permuted_vals(n_oob);
+        for(int64_t i = 0; i < n_oob; ++i){
+            permuted_vals[i] = X.read_coeff(oob[i], feat);
         }
 
-        // For each feature, compute importance.
-        for(int64_t feat = 0; feat < n_features; ++feat){
-            if(this->importance_method == ConditionalImportanceMethod::permutation){
-                // Standard (marginal) permutation importance.
-                std::vector<T> permuted_vals;
-                permuted_vals.reserve(n_oob);
-                for(const auto idx : oob){
-                    permuted_vals.push_back(X.read_coeff(idx, feat));
-                }
-                std::shuffle(permuted_vals.begin(), permuted_vals.end(), rng);
+        if(!conditional || this->conditioning_grids[feat].variables.empty()){
+            // Standard (marginal) permutation importance. Also used by the conditional method when there are no
+            // conditioning variables.
+            std::shuffle(permuted_vals.begin(), permuted_vals.end(), rng);
 
-                T permuted_ssr = static_cast<T>(0);
-                for(int64_t i = 0; i < n_oob; ++i){
-                    for(int64_t ff = 0; ff < n_features; ++ff){
-                        x_row.coeff(0, ff) = X.read_coeff(oob[i], ff);
-                    }
-                    x_row.coeff(0, feat) = permuted_vals[i];
-                    const T pred = predict_tree(this->trees[t].get(), x_row);
-                    const T residual = y.read_coeff(oob[i], 0) - pred;
-                    permuted_ssr += residual * residual;
+        }else{
+            // Conditional permutation importance (Strobl et al. 2008): permute Xj independently within each cell of
+            // the grid. Cells are visited in order of their encoding.
+            const auto &c = cells[feat];
+            std::vector<int64_t> order(n_oob);
+            std::iota(order.begin(), order.end(), static_cast<int64_t>(0));
+            std::stable_sort(order.begin(), order.end(), [&](int64_t a, int64_t b){
+                return c[oob[a]] < c[oob[b]];
+            });
+
+            std::vector<T> cell_vals;
+            for(int64_t begin = 0; begin < n_oob; ){
+                int64_t end = begin + 1;
+                while( (end < n_oob) && (c[oob[order[end]]] == c[oob[order[begin]]]) ) ++end;
+                if(1 < (end - begin)){
+                    cell_vals.clear();
+                    for(int64_t k = begin; k < end; ++k) cell_vals.push_back(permuted_vals[order[k]]);
+                    std::shuffle(cell_vals.begin(), cell_vals.end(), rng);
+                    for(int64_t k = begin; k < end; ++k) permuted_vals[order[k]] = cell_vals[k - begin];
                 }
+                begin = end;
+            }
+        }
 
-                this->feature_importances[feat] += (permuted_ssr - baseline_ssr) / static_cast<T>(n_oob);
-
-            }else{
-                // Conditional permutation importance (Strobl et al. 2008).
-                //
-                // Algorithm:
-                //   1. Identify the conditioning set Z for feature Xj (already precomputed).
-                //   2. For each OOB sample, determine its grid cell based on the quantile
-                //      bins of the conditioning variables.
-                //   3. Within each grid cell, permute Xj values independently.
-                //   4. Compute the increase in OOB SSR.
-
-                const auto &cond_set = conditioning_sets[feat];
-
-                if(cond_set.empty()){
-                    // No conditioning variables: fall back to standard permutation.
-                    std::vector<T> permuted_vals;
-                    permuted_vals.reserve(n_oob);
-                    for(const auto idx : oob){
-                        permuted_vals.push_back(X.read_coeff(idx, feat));
-                    }
-                    std::shuffle(permuted_vals.begin(), permuted_vals.end(), rng);
-
-                    T permuted_ssr = static_cast<T>(0);
-                    for(int64_t i = 0; i < n_oob; ++i){
-                        for(int64_t ff = 0; ff < n_features; ++ff){
-                            x_row.coeff(0, ff) = X.read_coeff(oob[i], ff);
-                        }
-                        x_row.coeff(0, feat) = permuted_vals[i];
-                        const T pred = predict_tree(this->trees[t].get(), x_row);
-                        const T residual = y.read_coeff(oob[i], 0) - pred;
-                        permuted_ssr += residual * residual;
-                    }
-
-                    this->feature_importances[feat] += (permuted_ssr - baseline_ssr) / static_cast<T>(n_oob);
-
-                }else{
-                    // Conditional permutation per Strobl et al. (2008):
-                    // Partition OOB samples into grid cells based on bisection of each
-                    // conditioning variable at its median. Per Strobl et al. (2008, Section
-                    // "Conditional permutation importance"), the conditioning variables are
-                    // "cut at their median" and Xj is permuted within the resulting cells.
-                    //
-                    // Each OOB sample is assigned a cell index as a binary encoding over
-                    // conditioning variables: for each conditioning variable, 0 if below or
-                    // equal to the median, 1 if above.
-
-                    // Compute medians for conditioning variables using the full training data.
-                    std::vector<T> cond_medians(cond_set.size());
-                    for(size_t c = 0; c < cond_set.size(); ++c){
-                        const int64_t cv = cond_set[c];
-                        std::vector<T> vals(n_samples);
-                        for(int64_t i = 0; i < n_samples; ++i){
-                            vals[i] = X.read_coeff(i, cv);
-                        }
-                        std::sort(vals.begin(), vals.end());
-                        if(n_samples % 2 == 0){
-                            cond_medians[c] = (vals[n_samples / 2 - 1] + vals[n_samples / 2]) / static_cast<T>(2);
-                        }else{
-                            cond_medians[c] = vals[n_samples / 2];
-                        }
-                    }
-
-                    // Limit the number of conditioning variables used to form the grid
-                    // to avoid an excessive number of cells (2^n_cond cells). With many
-                    // conditioning variables, cells become too sparse for meaningful
-                    // within-cell permutation.
-                    const size_t max_cond_vars = std::min<size_t>(cond_set.size(), 10);
-
-                    // Assign each OOB sample to a grid cell.
-                    std::map<int64_t, std::vector<int64_t>> cell_to_oob_local_indices;
-                    for(int64_t i = 0; i < n_oob; ++i){
-                        int64_t cell_id = 0;
-                        for(size_t c = 0; c < max_cond_vars; ++c){
-                            const int64_t cv = cond_set[c];
-                            if(X.read_coeff(oob[i], cv) > cond_medians[c]){
-                                cell_id |= (static_cast<int64_t>(1) << c);
-                            }
-                        }
-                        cell_to_oob_local_indices[cell_id].push_back(i);
-                    }
-
-                    // Within each cell, permute the feature values independently.
-                    std::vector<T> permuted_feat_vals(n_oob);
-                    for(int64_t i = 0; i < n_oob; ++i){
-                        permuted_feat_vals[i] = X.read_coeff(oob[i], feat);
-                    }
-
-                    for(auto &[cell_id, local_indices] : cell_to_oob_local_indices){
-                        (void)cell_id;
-                        if(local_indices.size() <= 1) continue;
-
-                        // Extract feature values for this cell.
-                        std::vector<T> cell_vals;
-                        cell_vals.reserve(local_indices.size());
-                        for(const auto li : local_indices){
-                            cell_vals.push_back(X.read_coeff(oob[li], feat));
-                        }
-                        std::shuffle(cell_vals.begin(), cell_vals.end(), rng);
-
-                        // Write back permuted values.
-                        for(size_t v = 0; v < local_indices.size(); ++v){
-                            permuted_feat_vals[local_indices[v]] = cell_vals[v];
-                        }
-                    }
-
-                    // Compute permuted SSR.
-                    T permuted_ssr = static_cast<T>(0);
-                    for(int64_t i = 0; i < n_oob; ++i){
-                        for(int64_t ff = 0; ff < n_features; ++ff){
-                            x_row.coeff(0, ff) = X.read_coeff(oob[i], ff);
-                        }
-                        x_row.coeff(0, feat) = permuted_feat_vals[i];
-                        const T pred = predict_tree(this->trees[t].get(), x_row);
-                        const T residual = y.read_coeff(oob[i], 0) - pred;
-                        permuted_ssr += residual * residual;
-                    }
+        std::vector<T> rows;
+        gather_rows(oob, rows);
+        for(int64_t i = 0; i < n_oob; ++i){
+            rows[i * n_features + feat] = permuted_vals[i];
+        }
+        const T permuted_ssr = oob_ssr(t, oob, rows);
+        increase[pair] = (permuted_ssr - baseline_ssr[t]) / static_cast<T>(n_oob);
+    });
 
-                    this->feature_importances[feat] += (permuted_ssr - baseline_ssr) / static_cast<T>(n_oob);
-                }
-            }
+    // Average across trees, accumulating in tree order.
+    this->feature_importances.assign(n_features, static_cast<T>(0));
+    int64_t n_trees_with_oob = 0;
+    for(int64_t t = 0; t < this->n_trees; ++t){
+        if(this->oob_indices_per_tree[t].empty()) continue;
+        ++n_trees_with_oob;
+        for(int64_t f = 0; f < n_features; ++f){
+            this->feature_importances[f] += increase[t * n_features + f];
         }
     }
-
-    // Average across trees.
     if(n_trees_with_oob > 0){
         for(int64_t f = 0; f < n_features; ++f){
             this->feature_importances[f] /= static_cast<T>(n_trees_with_oob);
@@ -1123,6 +1213,8 @@ bool Stats::ConditionalRandomForests<T>::read_from(std::istream &is) {
     if(n_actual_trees < 0 || n_actual_trees > 1'000'000) return false;
 
     this->trees.clear();
+    this->flat_trees.clear();
+    this->conditioning_grids.clear();
     this->trees.reserve(n_actual_trees);
     for(int64_t t_idx = 0; t_idx < n_actual_trees; ++t_idx){
         int64_t tree_idx;
@@ -1136,6 +1228,7 @@ bool Stats::ConditionalRandomForests<T>::read_from(std::istream &is) {
         is >> label;
         if(is.fail() || label != "end_tree") return false;
     }
+    this->compile_trees();
 
     // Validate invariants.
     if(n_actual_trees != this->n_trees){
@@ -1158,3 +1251,117 @@ bool Stats::ConditionalRandomForests<T>::read_from(std::istream &is) {
     template bool Stats::ConditionalRandomForests<double>::read_from(std::istream &);
     template bool Stats::ConditionalRandomForests<float>::read_from(std::istream &);
 #endif
+
+
+template <class T>
+bool Stats::ConditionalRandomForests<T>::write_binary(std::ostream &os) const {
+    if(this->trees.empty() || (this->n_features_trained <= 0)){
+        return false;
+    }
+    BinaryModelSection s;
+    s.put(this->n_trees);
+    s.put(this->max_depth);
+    s.put(this->min_samples_split);
+    s.put(this->alpha);
+    s.put(this->n_permutations);
+    s.put(this->max_features);
+    s.put(this->subsample_fraction);
+    s.put(this->correlation_threshold);
+    s.put(this->random_seed);
+    s.put(static_cast<int32_t>(this->importance_method));
+    s.put(this->feature_importances);
+    s.put(static_cast<uint64_t>(this->oob_indices_per_tree.size()));
+    for(const auto &oob : this->oob_indices_per_tree){
+        s.put(oob);
+    }
+    return this->flat_trees.write_binary(os, BinaryModelKind::conditional_random_forests,
+                                         this->n_features_trained, s.str());
+}
+#ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::ConditionalRandomForests<double>::write_binary(std::ostream &) const;
+    template bool Stats::ConditionalRandomForests<float>::write_binary(std::ostream &) const;
+#endif
+
+
+template <class T>
+bool Stats::ConditionalRandomForests<T>::read_binary(std::istream &is) {
+    try{
+    FlatForest<T> flat;
+    int64_t n_features = 0;
+    std::string bytes;
+    if(!flat.read_binary(is, BinaryModelKind::conditional_random_forests, n_features, bytes)) return false;
+
+    // Read parameters and auxiliary data.
+    BinaryModelSection s(bytes);
+    int64_t l_n_trees = 0;
+    int64_t l_max_depth = 0;
+    int64_t l_min_samples_split = 0;
+    T l_alpha = static_cast<T>(0);
+    int64_t l_n_permutations = 0;
+    int64_t l_max_features = 0;
+    T l_subsample_fraction = static_cast<T>(0);
+    T l_correlation_threshold = static_cast<T>(0);
+    uint64_t l_random_seed = 0;
+    int32_t imp_method_int = 0;
+    std::vector<T> l_feature_importances;
+    uint64_t n_oob_sets = 0;
+    std::vector<std::vector<int64_t>> l_oob_indices_per_tree;
+    if( !s.get(l_n_trees)
+    ||  !s.get(l_max_depth)
+    ||  !s.get(l_min_samples_split)
+    ||  !s.get(l_alpha)
+    ||  !s.get(l_n_permutations)
+    ||  !s.get(l_max_features)
+    ||  !s.get(l_subsample_fraction)
+    ||  !s.get(l_correlation_threshold)
+    ||  !s.get(l_random_seed)
+    ||  !s.get(imp_method_int)
+    ||  !s.get(l_feature_importances)
+    ||  !s.get(n_oob_sets) ) return false;
+    if(1'000'000 < n_oob_sets) return false;
+    l_oob_indices_per_tree.resize(n_oob_sets);
+    for(auto &oob : l_oob_indices_per_tree){
+        if(!s.get(oob)) return false;
+    }
+    if(!s.at_end()) return false;
+
+    // Validate invariants, as read_from() does.
+    if(imp_method_int < 0 || imp_method_int > 2) return false;
+    const auto l_importance_method = static_cast<ConditionalImportanceMethod>(imp_method_int);
+    if(n_features <= 0) return false;
+    if(l_n_trees != flat.get_n_trees()) return false;
+    if( (l_importance_method != ConditionalImportanceMethod::none)
+    &&  (static_cast<int64_t>(l_oob_indices_per_tree.size()) != l_n_trees) ) return false;
+
+    std::vector<std::unique_ptr<TreeNode>> l_trees;
+    l_trees.reserve(l_n_trees);
+    for(int64_t t = 0; t < l_n_trees; ++t){
+        l_trees.push_back(flat.template expand_tree<TreeNode>(t));
+    }
+
+    this->n_trees = l_n_trees;
+    this->max_depth = l_max_depth;
+    this->min_samples_split = l_min_samples_split;
+    this->alpha = l_alpha;
+    this->n_permutations = l_n_permutations;
+    this->max_features = l_max_features;
+    this->subsample_fraction = l_subsample_fraction;
+    this->correlation_threshold = l_correlation_threshold;
+    this->n_features_trained = n_features;
+    this->random_seed = l_random_seed;
+    this->importance_method = l_importance_method;
+    this->feature_importances = std::move(l_feature_importances);
+    this->oob_indices_per_tree = std::move(l_oob_indices_per_tree);
+    this->trees = std::move(l_trees);
+    this->flat_trees = std::move(flat);
+    this->conditioning_grids.clear();
+    return true;
+
+    }catch(const std::exception &){
+        return false;
+    }
+}
+#ifndef YGOR_STATS_CONDITIONAL_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::ConditionalRandomForests<double>::read_binary(std::istream &);
+    template bool Stats::ConditionalRandomForests<float>::read_binary(std::istream &);
+#endif
@@ -28,6 +28,8 @@
 
 #include "YgorDefinitions.h"
 #include "YgorMath.h"
+#include "YgorStatsFlatTrees.h"
+#include "YgorStatsPermutationTests.h"
 
 namespace Stats {
 
@@ -94,6 +96,7 @@ class ConditionalRandomForests {
         };
 
         std::vector<std::unique_ptr<TreeNode>> trees;  // Ensemble of decision trees.
+        FlatForest<T> flat_trees;     // Flattened copy of the trees, for batch prediction.
         int64_t n_trees;              // Number of trees in the forest.
         int64_t max_depth;            // Maximum depth of each tree.
         int64_t min_samples_split;    // Minimum samples required to split a node.
@@ -104,17 +107,28 @@ class ConditionalRandomForests {
         int64_t n_features_trained;   // Number of features the model was trained on.
         uint64_t random_seed;         // Random seed for reproducibility.
         T correlation_threshold;      // Threshold for identifying conditioning variables.
+        int64_t n_threads;            // Number of threads for permutation tests. Zero uses all hardware threads.
+        SelectionTest selection_test; // How the p-value of the variable selection test is estimated.
 
         ConditionalImportanceMethod importance_method; // Variable importance method.
         std::vector<T> feature_importances; // Computed feature importances.
         std::vector<std::vector<int64_t>> oob_indices_per_tree; // OOB sample indices per tree.
 
+        // The grid within which a feature is permuted by the conditional importance method: each conditioning
+        // variable is cut at its median, and each combination of sides forms a cell.
+        struct ConditioningGrid {
+            std::vector<int64_t> variables;   // Conditioning variables forming the grid (at most 10).
+            std::vector<T> medians;           // Median of each conditioning variable over the training data.
+        };
+        std::vector<ConditioningGrid> conditioning_grids; // Per feature. Derived in fit(); not serialized.
+
         // Build a single conditional inference tree on a subsample.
         std::unique_ptr<TreeNode> build_tree(
             const num_array<T> &X,
             const num_array<T> &y,
             const std::vector<int64_t> &sample_indices,
             int64_t depth,
+            MaxTypeTest<T> &test,
             std::mt19937 &rng
         );
 
@@ -126,6 +140,7 @@ class ConditionalRandomForests {
             const std::vector<int64_t> &sample_indices,
             int64_t &best_feature,
             T &best_pvalue,
+            MaxTypeTest<T> &test,
             std::mt19937 &rng
         );
 
@@ -147,8 +162,11 @@ class ConditionalRandomForests {
             const std::vector<int64_t> &right_indices
         );
 
-        // Predict using a single tree.
-        T predict_tree(const TreeNode *node, const num_array<T> &x) const;
+        // Derive the conditioning grids used by the conditional importance method from the training data.
+        void compute_conditioning_grids(const num_array<T> &X);
+
+        // Rebuild the flattened copy of the trees. Called whenever the trees change.
+        void compile_trees();
 
         // Serialization helpers.
         bool write_tree_node(std::ostream &os, const TreeNode *node) const;
@@ -212,6 +230,23 @@ class ConditionalRandomForests {
         //   std::runtime_error if model has not been fitted yet.
         T predict(const num_array<T> &x) const;
 
+        // Predict scalar outputs for many samples at once.
+        //
+        // Equivalent to calling predict() on each row of X, and the results are bit-identical, but
+        // much faster for large inputs: trees are evaluated from a flattened, contiguous form, rows
+        // are processed in cache-sized blocks, and blocks are distributed over threads (see set_n_threads()).
+        //
+        // Parameters:
+        //   X: NxM matrix of input features (M must match the number of features used in fit()).
+        //
+        // Returns:
+        //   Nx1 matrix of predicted values.
+        //
+        // Throws:
+        //   std::invalid_argument if X has the wrong number of features.
+        //   std::runtime_error if model has not been fitted yet.
+        num_array<T> predict_batch(const num_array<T> &X) const;
+
         // Get number of trees in the forest.
         int64_t get_n_trees() const;
 
@@ -224,6 +259,22 @@ class ConditionalRandomForests {
         // Get the correlation threshold for conditional importance.
         T get_correlation_threshold() const;
 
+        // Set the number of threads used to evaluate permutation tests during fitting, to compute
+        // importances, and by predict_batch(). Zero (the default) uses all hardware threads. Neither the
+        // fitted forest, the importances, nor the predictions depend on the number of threads.
+        void set_n_threads(int64_t n);
+
+        // Get the number of threads.
+        int64_t get_n_threads() const;
+
+        // Set how the p-value of the variable selection test is estimated (default: sequential).
+        // The number of permutations is the upper limit for the sequential test and unused by the
+        // asymptotic test. This is a fitting option, and is not serialized.
+        void set_selection_test(SelectionTest test);
+
+        // Get the variable selection test.
+        SelectionTest get_selection_test() const;
+
         // Set the variable importance estimation method.
         //
         // Must be called before fit(). If not called, defaults to ConditionalImportanceMethod::none.
@@ -245,7 +296,11 @@ class ConditionalRandomForests {
         // algorithm is used, which permutes each feature only within groups defined by correlated
         // conditioning variables.
         //
-        // Must be called after fit() with the same training data.
+        // Must be called after fit() with the same training data. The correlation analysis and
+        // conditioning grids are derived once per fit (or on first use, for models read from a
+        // stream). Each (tree, feature) pair is evaluated independently, from its own random number
+        // stream, and pairs are distributed over threads (see set_n_threads()), so the importances
+        // do not depend on the number of threads.
         //
         // Parameters:
         //   X: NxM training data matrix (must match the data used in fit()).
@@ -278,6 +333,31 @@ class ConditionalRandomForests {
         // Returns:
         //   true on success, false if the stream format is invalid or enters a fail state.
         bool read_from(std::istream &is);
+
+        // Write the model in the binary model format (see YgorStatsFlatTrees.h).
+        //
+        // The binary format holds the same information as write_to(), but loads much faster since
+        // the trees are stored as flattened node arrays that are read in bulk rather than parsed.
+        // Binary models are specific to the floating-point type and byte order of the writer.
+        //
+        // Parameters:
+        //   os: Output stream to write to. Should be opened in binary mode.
+        //
+        // Returns:
+        //   true on success, false if the model has not been fitted or the stream enters a fail state.
+        bool write_binary(std::ostream &os) const;
+
+        // Read a model from a binary stream.
+        //
+        // Restores a model previously written by write_binary(). The model is only modified if
+        // reading succeeds. Use Stats::is_binary_model() to distinguish binary and text models.
+        //
+        // Parameters:
+        //   is: Input stream to read from. Should be opened in binary mode.
+        //
+        // Returns:
+        //   true on success, false if the stream does not hold a valid binary model of this kind.
+        bool read_binary(std::istream &is);
 };
 
 } //namespace Stats.
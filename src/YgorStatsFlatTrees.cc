@@ -0,0 +1,474 @@
+//YgorStatsFlatTrees.cc - A part of Ygor, 2026. Written by hal clark.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorMath.h"
+#include "YgorIndexMapped.h"    // For mapped_index_checksum().
+#include "YgorStatsFlatTrees.h"
+#include "YgorThreadPool.h"
+
+//#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+//    #define YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+//#endif
+
+
+namespace {
+
+// Number of rows evaluated together. The transposed block (rows x features) and the accumulators should stay in cache
+// while every tree is walked over them.
+constexpr int64_t block_rows = 256;
+
+// Number of trees walked in lockstep for each row.
+constexpr int64_t lockstep_trees = 4;
+
+template <class T>
+inline const typename Stats::FlatForest<T>::Node *
+descend(const typename Stats::FlatForest<T>::Node *root, const T *features){
+    const auto *n = root;
+    while(0 <= n->feature){
+        n = (features[n->feature] <= n->value) ? (n + 1) : (root + n->right);
+    }
+    return n;
+}
+
+const char binary_model_magic[8] = { 'Y', 'G', 'O', 'R', 'M', 'D', 'L', '\0' };
+constexpr uint32_t binary_model_byte_order = 0x01020304;
+
+uint64_t align8(uint64_t x){
+    return (x + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Byte offsets of the sections of a binary model.
+struct binary_layout {
+    uint64_t section;
+    uint64_t offsets;
+    uint64_t nodes;
+    uint64_t end;
+};
+
+template <class T>
+bool compute_binary_layout(uint64_t n_trees, uint64_t n_nodes, uint64_t section_size, binary_layout &l){
+    // Reject sizes that could overflow, or that no real model could have.
+    const uint64_t limit = static_cast<uint64_t>(1) << 40;
+    if( (limit <= n_trees) || (limit <= n_nodes) || (limit <= section_size) ) return false;
+
+    l.section = sizeof(Stats::BinaryModelHeader);
+    l.offsets = align8(l.section + section_size);
+    l.nodes = l.offsets + n_trees * sizeof(uint64_t);
+    l.end = align8(l.nodes + n_nodes * sizeof(typename Stats::FlatForest<T>::Node));
+    return true;
+}
+
+// Read bytes from the current position of a stream, then restore the position.
+bool peek_bytes(std::istream &is, char *buf, std::streamsize n){
+    const auto start = is.tellg();
+    if(start == std::streampos(-1)) return false;
+    is.read(buf, n);
+    const bool ok = (is.gcount() == n);
+    is.clear();
+    is.seekg(start);
+    return ok && !is.fail();
+}
+
+// Verify that nodes[begin, end) hold exactly one tree in pre-order. Iterative, so malformed input cannot exhaust the
+// stack.
+template <class T>
+bool valid_tree(const typename Stats::FlatForest<T>::Node *nodes, uint64_t begin, uint64_t end, uint64_t n_features){
+    std::vector<std::pair<uint64_t, bool>> pending; // Internal nodes, and whether their left subtree is complete.
+    uint64_t pos = begin;
+    while(true){
+        if(end <= pos) return false;
+        const auto &n = nodes[pos];
+        if(n.feature < -1) return false;
+        if(0 <= n.feature){
+            if(n_features <= static_cast<uint64_t>(n.feature)) return false;
+            pending.emplace_back(pos, false);
+            ++pos;
+            continue;
+        }
+
+        // A leaf completes a subtree. Unwind to the next right subtree, if any.
+        ++pos;
+        while(!pending.empty() && pending.back().second) pending.pop_back();
+        if(pending.empty()) break;
+        if(static_cast<uint64_t>(nodes[pending.back().first].right) != (pos - begin)) return false;
+        pending.back().second = true;
+    }
+    return (pos == end);
+}
+
+} // namespace
+
+
+bool Stats::is_binary_model(std::istream &is){
+    char magic[sizeof(binary_model_magic)];
+    return peek_bytes(is, magic, sizeof(magic))
+        && (std::memcmp(magic, binary_model_magic, sizeof(magic)) == 0);
+}
+
+
+bool Stats::peek_binary_model_header(std::istream &is, Stats::BinaryModelHeader &header){
+    Stats::BinaryModelHeader h;
+    if( !peek_bytes(is, reinterpret_cast<char *>(&h), sizeof(h))
+    ||  (std::memcmp(h.magic, binary_model_magic, sizeof(binary_model_magic)) != 0) ) return false;
+    header = h;
+    return true;
+}
+
+
+template <class T>
+void Stats::FlatForest<T>::clear(){
+    this->nodes.clear();
+    this->tree_offsets.clear();
+    this->max_feature = -1;
+    return;
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::FlatForest<double>::clear();
+    template void Stats::FlatForest<float>::clear();
+#endif
+
+
+template <class T>
+int64_t Stats::FlatForest<T>::get_n_trees() const {
+    return static_cast<int64_t>(this->tree_offsets.size());
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template int64_t Stats::FlatForest<double>::get_n_trees() const;
+    template int64_t Stats::FlatForest<float>::get_n_trees() const;
+#endif
+
+
+template <class T>
+int64_t Stats::FlatForest<T>::get_n_nodes() const {
+    return static_cast<int64_t>(this->nodes.size());
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template int64_t Stats::FlatForest<double>::get_n_nodes() const;
+    template int64_t Stats::FlatForest<float>::get_n_nodes() const;
+#endif
+
+
+template <class T>
+void Stats::FlatForest<T>::evaluate_rows(const T *rows, int64_t n, int64_t n_cols, bool average, T *acc, T *out) const {
+    const int64_t n_trees = this->get_n_trees();
+    const Node *base = this->nodes.data();
+
+    // Without averaging, the first tree's prediction is used directly rather than added to zero, so the output of a
+    // single tree is exactly its leaf value (including the sign of zero).
+    int64_t t = 0;
+    if(average){
+        for(int64_t r = 0; r < n; ++r) acc[r] = static_cast<T>(0);
+    }else{
+        const Node *root = base + this->tree_offsets[0];
+        for(int64_t r = 0; r < n; ++r) acc[r] = descend<T>(root, rows + r * n_cols)->value;
+        t = 1;
+    }
+
+    for( ; (t + lockstep_trees) <= n_trees; t += lockstep_trees){
+        const Node *root0 = base + this->tree_offsets[t + 0];
+        const Node *root1 = base + this->tree_offsets[t + 1];
+        const Node *root2 = base + this->tree_offsets[t + 2];
+        const Node *root3 = base + this->tree_offsets[t + 3];
+        for(int64_t r = 0; r < n; ++r){
+            const T *f = rows + r * n_cols;
+            const Node *n0 = root0;
+            const Node *n1 = root1;
+            const Node *n2 = root2;
+            const Node *n3 = root3;
+            while( (0 <= n0->feature) || (0 <= n1->feature) || (0 <= n2->feature) || (0 <= n3->feature) ){
+                if(0 <= n0->feature) n0 = (f[n0->feature] <= n0->value) ? (n0 + 1) : (root0 + n0->right);
+                if(0 <= n1->feature) n1 = (f[n1->feature] <= n1->value) ? (n1 + 1) : (root1 + n1->right);
+                if(0 <= n2->feature) n2 = (f[n2->feature] <= n2->value) ? (n2 + 1) : (root2 + n2->right);
+                if(0 <= n3->feature) n3 = (f[n3->feature] <= n3->value) ? (n3 + 1) : (root3 + n3->right);
+            }
+            T sum = acc[r];
+            sum += n0->value;
+            sum += n1->value;
+            sum += n2->value;
+            sum += n3->value;
+            acc[r] = sum;
+        }
+    }
+    for( ; t < n_trees; ++t){
+        const Node *root = base + this->tree_offsets[t];
+        for(int64_t r = 0; r < n; ++r) acc[r] += descend<T>(root, rows + r * n_cols)->value;
+    }
+
+    // Multiply by the reciprocal explicitly. A division inside the loop may or may not be rewritten this way when
+    // fast-math optimizations are enabled, which would make the result depend on n.
+    if(average){
+        const T inv_n_trees = static_cast<T>(1) / static_cast<T>(n_trees);
+        for(int64_t r = 0; r < n; ++r) out[r] = acc[r] * inv_n_trees;
+    }else{
+        for(int64_t r = 0; r < n; ++r) out[r] = acc[r];
+    }
+    return;
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::FlatForest<double>::evaluate_rows(const double *, int64_t, int64_t, bool, double *, double *) const;
+    template void Stats::FlatForest<float>::evaluate_rows(const float *, int64_t, int64_t, bool, float *, float *) const;
+#endif
+
+
+template <class T>
+T Stats::FlatForest<T>::predict(const T *features, int64_t n_features, bool average) const {
+    if(this->tree_offsets.empty()){
+        throw std::runtime_error("No trees are available for prediction");
+    }
+    if(n_features <= this->max_feature){
+        throw std::invalid_argument("Input has fewer features than the trees reference");
+    }
+    T acc;
+    T out;
+    this->evaluate_rows(features, 1, n_features, average, &acc, &out);
+    return out;
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template double Stats::FlatForest<double>::predict(const double *, int64_t, bool) const;
+    template float Stats::FlatForest<float>::predict(const float *, int64_t, bool) const;
+#endif
+
+
+template <class T>
+void Stats::FlatForest<T>::predict_tree(int64_t tree, const T *rows, int64_t n, int64_t n_cols, T *out) const {
+    if( (tree < 0) || (this->get_n_trees() <= tree) ){
+        throw std::out_of_range("Tree does not exist");
+    }
+    if(n_cols <= this->max_feature){
+        throw std::invalid_argument("Input has fewer features than the trees reference");
+    }
+    const Node *root = this->nodes.data() + this->tree_offsets[tree];
+    for(int64_t r = 0; r < n; ++r) out[r] = descend<T>(root, rows + r * n_cols)->value;
+    return;
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::FlatForest<double>::predict_tree(int64_t, const double *, int64_t, int64_t, double *) const;
+    template void Stats::FlatForest<float>::predict_tree(int64_t, const float *, int64_t, int64_t, float *) const;
+#endif
+
+
+template <class T>
+num_array<T> Stats::FlatForest<T>::predict_batch(const num_array<T> &X, bool average, int64_t n_threads) const {
+    if(this->tree_offsets.empty()){
+        throw std::runtime_error("No trees are available for prediction");
+    }
+    const int64_t n_rows = X.num_rows();
+    const int64_t n_cols = X.num_cols();
+    if(n_cols <= this->max_feature){
+        throw std::invalid_argument("Input has fewer features than the trees reference");
+    }
+
+    num_array<T> out(n_rows, 1);
+    const T *x = &*X.cbegin();
+    T *o = &*out.begin();
+
+    const auto eval_block = [&](int64_t block, std::vector<T> &rows, std::vector<T> &acc){
+        const int64_t r_begin = block * block_rows;
+        const int64_t n = std::min(block_rows, n_rows - r_begin);
+
+        // Transpose the block so each row's features are contiguous. X is column-major.
+        rows.resize(n * n_cols);
+        for(int64_t c = 0; c < n_cols; ++c){
+            const T *col = x + c * n_rows + r_begin;
+            for(int64_t r = 0; r < n; ++r) rows[r * n_cols + c] = col[r];
+        }
+        acc.resize(n);
+        this->evaluate_rows(rows.data(), n, n_cols, average, acc.data(), o + r_begin);
+    };
+
+    const int64_t n_blocks = (n_rows + block_rows - 1) / block_rows;
+    int64_t n_workers = (0 < n_threads) ? n_threads
+                                        : static_cast<int64_t>(std::max(1U, std::thread::hardware_concurrency()));
+    n_workers = std::min(n_workers, n_blocks);
+
+    if(n_workers <= 1){
+        std::vector<T> rows;
+        std::vector<T> acc;
+        for(int64_t b = 0; b < n_blocks; ++b) eval_block(b, rows, acc);
+
+    }else{
+        // Workers claim blocks dynamically, since the cost of a block depends on the paths its rows take.
+        std::atomic<int64_t> next_block(0);
+        std::vector<std::exception_ptr> errors(n_workers);
+        {
+            work_queue<std::function<void()>> wq(static_cast<unsigned int>(n_workers));
+            for(int64_t w = 0; w < n_workers; ++w){
+                wq.submit_task([&, w](){
+                    try{
+                        std::vector<T> rows;
+                        std::vector<T> acc;
+                        for(int64_t b = next_block++; b < n_blocks; b = next_block++) eval_block(b, rows, acc);
+                    }catch(...){
+                        errors[w] = std::current_exception();
+                    }
+                });
+            }
+            // Note: the destructor waits for all submitted tasks to complete.
+        }
+        for(const auto &e : errors){
+            if(e) std::rethrow_exception(e);
+        }
+    }
+    return out;
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template num_array<double> Stats::FlatForest<double>::predict_batch(const num_array<double> &, bool, int64_t) const;
+    template num_array<float> Stats::FlatForest<float>::predict_batch(const num_array<float> &, bool, int64_t) const;
+#endif
+
+
+template <class T>
+bool Stats::FlatForest<T>::write_binary(std::ostream &os,
+                                        Stats::BinaryModelKind kind,
+                                        int64_t n_features,
+                                        const std::string &section) const {
+    if(n_features < 0) return false;
+
+    BinaryModelHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, binary_model_magic, sizeof(binary_model_magic));
+    h.version = binary_format_version;
+    h.byte_order = binary_model_byte_order;
+    h.kind = static_cast<uint32_t>(kind);
+    h.value_size = static_cast<uint32_t>(sizeof(T));
+    h.n_features = static_cast<uint64_t>(n_features);
+    h.n_trees = this->tree_offsets.size();
+    h.n_nodes = this->nodes.size();
+    h.section_size = section.size();
+
+    binary_layout l;
+    if(!compute_binary_layout<T>(h.n_trees, h.n_nodes, h.section_size, l)) return false;
+    h.body_size = l.end - sizeof(BinaryModelHeader);
+
+    // Assemble the whole buffer so the checksum can be computed before anything is written. Padding is zeroed.
+    std::vector<uint64_t> storage(l.end / 8, 0);
+    auto *bytes = reinterpret_cast<unsigned char *>(storage.data());
+    if(!section.empty()) std::memcpy(bytes + l.section, section.data(), section.size());
+    if(!this->tree_offsets.empty()){
+        std::memcpy(bytes + l.offsets, this->tree_offsets.data(), this->tree_offsets.size() * sizeof(uint64_t));
+    }
+    if(!this->nodes.empty()){
+        std::memcpy(bytes + l.nodes, this->nodes.data(), this->nodes.size() * sizeof(Node));
+    }
+    h.checksum = mapped_index_checksum(bytes + sizeof(BinaryModelHeader), h.body_size);
+    std::memcpy(bytes, &h, sizeof(h));
+
+    os.write(reinterpret_cast<const char *>(bytes), static_cast<std::streamsize>(l.end));
+    os.flush();
+    return !os.fail();
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::FlatForest<double>::write_binary(std::ostream &, Stats::BinaryModelKind, int64_t, const std::string &) const;
+    template bool Stats::FlatForest<float>::write_binary(std::ostream &, Stats::BinaryModelKind, int64_t, const std::string &) const;
+#endif
+
+
+template <class T>
+bool Stats::FlatForest<T>::read_binary(const void *data,
+                                       size_t size,
+                                       Stats::BinaryModelKind kind,
+                                       int64_t &n_features,
+                                       std::string &section){
+    if( (data == nullptr)
+    ||  (size < sizeof(BinaryModelHeader))
+    ||  ((reinterpret_cast<uintptr_t>(data) % 8) != 0) ) return false;
+    const auto *bytes = static_cast<const unsigned char *>(data);
+
+    BinaryModelHeader h;
+    std::memcpy(&h, bytes, sizeof(h));
+    binary_layout l;
+    if( (std::memcmp(h.magic, binary_model_magic, sizeof(binary_model_magic)) != 0)
+    ||  (h.version != binary_format_version)
+    ||  (h.byte_order != binary_model_byte_order)
+    ||  (h.kind != static_cast<uint32_t>(kind))
+    ||  (h.value_size != sizeof(T))
+    ||  (static_cast<uint64_t>(std::numeric_limits<int32_t>::max()) < h.n_features)
+    ||  !compute_binary_layout<T>(h.n_trees, h.n_nodes, h.section_size, l)
+    ||  ((l.end - sizeof(BinaryModelHeader)) != h.body_size)
+    ||  (size < l.end)
+    ||  (mapped_index_checksum(bytes + sizeof(BinaryModelHeader), h.body_size) != h.checksum) ) return false;
+
+    // Verify the tree structure, so evaluation can never step outside the node array or the features.
+    const auto *offsets = reinterpret_cast<const uint64_t *>(bytes + l.offsets);
+    const auto *n = reinterpret_cast<const Node *>(bytes + l.nodes);
+    if( (h.n_trees == 0) != (h.n_nodes == 0) ) return false;
+    for(uint64_t t = 0; t < h.n_trees; ++t){
+        const uint64_t begin = offsets[t];
+        const uint64_t end = ((t + 1) < h.n_trees) ? offsets[t + 1] : h.n_nodes;
+        if( ((t == 0) && (begin != 0))
+        ||  (end <= begin)
+        ||  (h.n_nodes < end)
+        ||  (static_cast<uint64_t>(std::numeric_limits<uint32_t>::max()) < (end - begin))
+        ||  !valid_tree<T>(n, begin, end, h.n_features) ) return false;
+    }
+
+    std::vector<Node> new_nodes(n, n + h.n_nodes);
+    std::vector<uint64_t> new_offsets(offsets, offsets + h.n_trees);
+    int64_t new_max_feature = -1;
+    for(const auto &node : new_nodes){
+        new_max_feature = std::max(new_max_feature, static_cast<int64_t>(node.feature));
+    }
+
+    section.assign(reinterpret_cast<const char *>(bytes + l.section), static_cast<size_t>(h.section_size));
+    n_features = static_cast<int64_t>(h.n_features);
+    this->nodes = std::move(new_nodes);
+    this->tree_offsets = std::move(new_offsets);
+    this->max_feature = new_max_feature;
+    return true;
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::FlatForest<double>::read_binary(const void *, size_t, Stats::BinaryModelKind, int64_t &, std::string &);
+    template bool Stats::FlatForest<float>::read_binary(const void *, size_t, Stats::BinaryModelKind, int64_t &, std::string &);
+#endif
+
+
+template <class T>
+bool Stats::FlatForest<T>::read_binary(std::istream &is,
+                                       Stats::BinaryModelKind kind,
+                                       int64_t &n_features,
+                                       std::string &section){
+    BinaryModelHeader h;
+    if(!is.read(reinterpret_cast<char *>(&h), sizeof(h))) return false;
+
+    // Confirm the claimed size before allocating anything.
+    binary_layout l;
+    if( (std::memcmp(h.magic, binary_model_magic, sizeof(binary_model_magic)) != 0)
+    ||  (h.version != binary_format_version)
+    ||  !compute_binary_layout<T>(h.n_trees, h.n_nodes, h.section_size, l)
+    ||  ((l.end - sizeof(BinaryModelHeader)) != h.body_size) ) return false;
+
+    // When the stream is seekable, also confirm that it actually holds that many bytes.
+    const auto here = is.tellg();
+    if(here != std::streampos(-1)){
+        is.seekg(0, std::ios::end);
+        const auto stop = is.tellg();
+        is.seekg(here);
+        if( (stop != std::streampos(-1))
+        &&  (static_cast<uint64_t>(stop - here) < h.body_size) ) return false;
+    }
+
+    std::vector<uint64_t> storage(l.end / 8, 0);
+    auto *bytes = reinterpret_cast<char *>(storage.data());
+    std::memcpy(bytes, &h, sizeof(h));
+    if(!is.read(bytes + sizeof(h), static_cast<std::streamsize>(h.body_size))) return false;
+    return this->read_binary(storage.data(), l.end, kind, n_features, section);
+}
+#ifndef YGOR_STATS_FLAT_TREES_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::FlatForest<double>::read_binary(std::istream &, Stats::BinaryModelKind, int64_t &, std::string &);
+    template bool Stats::FlatForest<float>::read_binary(std::istream &, Stats::BinaryModelKind, int64_t &, std::string &);
+#endif
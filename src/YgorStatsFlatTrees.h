@@ -0,0 +1,330 @@
+//YgorStatsFlatTrees.h - A part of Ygor, 2026. Written by hal clark.
+//
+// A compiled, read-only form of binary decision trees for fast batch inference.
+//
+// The tree-based regressors (StochasticForests, ConditionalRandomForests, ConditionalInferenceTrees) build their trees
+// as linked std::unique_ptr nodes, which is convenient during fitting but slow to evaluate: every level of every tree
+// is a dependent pointer load from a different allocation. FlatForest stores all trees in a single contiguous array in
+// pre-order, so the left child of a node always immediately follows it and only the right child needs an offset.
+//
+// The flattened trees also form the core of a binary model format, which loads far faster than the regressors' text
+// format because the node arrays are read in bulk rather than parsed.
+//
+
+#pragma once
+
+#ifndef YGOR_STATS_FLAT_TREES_HDR_GRD_H
+#define YGOR_STATS_FLAT_TREES_HDR_GRD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorMath.h"
+
+namespace Stats {
+
+//-----------------------------------------------------------------------------------------------------------
+//------------------------------------------- Binary Model Format -------------------------------------------
+//-----------------------------------------------------------------------------------------------------------
+// The tree-based regressors can be written in a binary format (see their write_binary() and read_binary()). A binary
+// model is a single contiguous buffer with the following layout:
+//
+//   - A fixed-size header (BinaryModelHeader) identifying the format version, the byte order, the kind of model, the
+//     size of the floating-point type, the number of features, trees, and nodes, and a checksum of the remainder.
+//   - A model-specific section holding the model's parameters and auxiliary data (e.g., importances).
+//   - The offset of each tree's root in the node array, as uint64_t.
+//   - The flattened nodes (FlatForest<T>::Node) of all trees, each tree in pre-order.
+//
+// Every section starts on an 8-byte boundary, relative to the start of the buffer, so the node array can be used in
+// place from a mapped file. Models written by a different format version, on a machine with a different byte order,
+// or with a different floating-point type are rejected, as are models whose checksum or tree structure is
+// inconsistent.
+//
+
+// The kind of model stored in a binary model.
+enum class BinaryModelKind : uint32_t {
+    stochastic_forests          = 1,
+    conditional_random_forests  = 2,
+    conditional_inference_trees = 3,
+};
+
+// The header at the start of every binary model.
+struct BinaryModelHeader {
+    char magic[8];          // "YGORMDL" followed by a null byte.
+    uint32_t version;       // The format version.
+    uint32_t byte_order;    // 0x01020304 in the byte order of the writer.
+    uint32_t kind;          // A BinaryModelKind.
+    uint32_t value_size;    // sizeof(T).
+    uint64_t n_features;    // The number of features the model was trained on.
+    uint64_t n_trees;
+    uint64_t n_nodes;
+    uint64_t section_size;  // The size of the model-specific section, excluding padding.
+    uint64_t body_size;     // The number of bytes following the header.
+    uint64_t checksum;      // A checksum of the bytes following the header.
+};
+
+// Check whether a stream is positioned at the start of a binary model. Nothing is consumed, so the stream must be
+// seekable (e.g., a file). Streams holding a text model, or nothing at all, return false.
+bool is_binary_model(std::istream &is);
+
+// Read the header of a binary model without consuming it. Returns false if the stream does not hold a binary model.
+bool peek_binary_model_header(std::istream &is, BinaryModelHeader &header);
+
+// The model-specific section of a binary model. Values are stored bytewise, in the writer's byte order, and must be
+// read back in the order they were written. Vectors are prefixed with their length.
+class BinaryModelSection {
+    private:
+        std::vector<char> bytes;
+        size_t pos = 0;
+
+    public:
+        BinaryModelSection() = default;
+        explicit BinaryModelSection(const std::string &b) : bytes(b.begin(), b.end()) {}
+
+        // Get the encoded section.
+        std::string str() const { return std::string(this->bytes.begin(), this->bytes.end()); }
+
+        // Check whether every value has been read.
+        bool at_end() const { return (this->pos == this->bytes.size()); }
+
+        template <class V>
+        void put(const V &v){
+            static_assert(std::is_trivially_copyable<V>::value, "Only trivially-copyable values can be stored");
+            const auto *p = reinterpret_cast<const char *>(&v);
+            this->bytes.insert(this->bytes.end(), p, p + sizeof(V));
+        }
+
+        template <class V>
+        void put(const std::vector<V> &v){
+            static_assert(std::is_trivially_copyable<V>::value, "Only trivially-copyable values can be stored");
+            this->put(static_cast<uint64_t>(v.size()));
+            const auto *p = reinterpret_cast<const char *>(v.data());
+            this->bytes.insert(this->bytes.end(), p, p + v.size() * sizeof(V));
+        }
+
+        // Read a value. Returns false if the section is exhausted.
+        template <class V>
+        bool get(V &v){
+            static_assert(std::is_trivially_copyable<V>::value, "Only trivially-copyable values can be stored");
+            if((this->bytes.size() - this->pos) < sizeof(V)) return false;
+            std::memcpy(static_cast<void *>(&v), this->bytes.data() + this->pos, sizeof(V));
+            this->pos += sizeof(V);
+            return true;
+        }
+
+        template <class V>
+        bool get(std::vector<V> &v){
+            static_assert(std::is_trivially_copyable<V>::value, "Only trivially-copyable values can be stored");
+            uint64_t n = 0;
+            if( !this->get(n)
+            ||  (((this->bytes.size() - this->pos) / sizeof(V)) < n) ) return false;
+            v.resize(static_cast<size_t>(n));
+            if(n != 0) std::memcpy(static_cast<void *>(v.data()), this->bytes.data() + this->pos, n * sizeof(V));
+            this->pos += n * sizeof(V);
+            return true;
+        }
+};
+
+
+//-----------------------------------------------------------------------------------------------------------
+//-------------------------------------------- Flattened Forest ---------------------------------------------
+//-----------------------------------------------------------------------------------------------------------
+// A collection of flattened binary regression trees.
+//
+// Trees are evaluated as the linked trees they were built from: a sample goes left when its feature value is <= the
+// threshold (so NaNs go right), and predictions from multiple trees are summed in tree order.
+//
+// Batch evaluation processes rows in blocks that are transposed into a small row-major buffer for cache reuse, walks
+// several trees in lockstep for each row so their independent loads overlap, and distributes row blocks over threads.
+// Single-row and batch evaluation share the same arithmetic, so their results are bit-identical regardless of
+// blocking or threading.
+//
+template <class T>
+class FlatForest {
+    public:
+        // A flattened node. Leaves have feature == -1 and store the prediction in value; internal nodes store the
+        // split threshold in value. The left child of an internal node is the next node, and the right child is at
+        // offset 'right' from the tree's root.
+        struct Node {
+            T value;
+            int32_t feature;
+            uint32_t right;
+        };
+
+    private:
+        std::vector<Node> nodes;              // All trees, each in pre-order.
+        std::vector<uint64_t> tree_offsets;   // Offset of each tree's root in nodes.
+        int64_t max_feature = -1;             // Largest feature index referenced by any tree.
+
+        // Append the subtree rooted at node, returning its offset relative to the tree root.
+        template <class TreeNode>
+        uint64_t append(const TreeNode *node, uint64_t root_offset);
+
+        // Rebuild the linked subtree rooted at node.
+        template <class TreeNode>
+        std::unique_ptr<TreeNode> expand(const Node *root, const Node *node) const;
+
+        // Evaluate all trees for n rows stored contiguously in row-major order, using acc (n elements) as scratch.
+        //
+        // Both single-row and batch prediction use this routine, so the floating-point operations performed for a
+        // row are the same no matter how many rows are evaluated together, even when the compiler is permitted to
+        // reassociate arithmetic (e.g., -ffast-math).
+        void evaluate_rows(const T *rows, int64_t n, int64_t n_cols, bool average, T *acc, T *out) const;
+
+    public:
+        // Remove all trees.
+        void clear();
+
+        // Flatten and append a linked tree. The node type must provide is_leaf, value, split_feature, split_threshold,
+        // and left/right pointer-like children (as the regressors' internal TreeNode types do).
+        //
+        // Throws std::invalid_argument if the tree is malformed or too large to flatten.
+        template <class TreeNode>
+        void add_tree(const TreeNode *root);
+
+        // Get the number of trees.
+        int64_t get_n_trees() const;
+
+        // Get the total number of nodes across all trees.
+        int64_t get_n_nodes() const;
+
+        // Evaluate all trees for a single sample with n_features contiguous features.
+        //
+        // If average is true, the output is the sum of the tree predictions (starting from zero, in tree order)
+        // multiplied by the reciprocal of the number of trees, as the forests average their trees. Otherwise, the output is the plain sum of
+        // the tree predictions (which, for a single tree, is the leaf value itself).
+        //
+        // Throws std::runtime_error if there are no trees, and std::invalid_argument if the trees reference features
+        // beyond n_features.
+        T predict(const T *features, int64_t n_features, bool average) const;
+
+        // Evaluate a single tree for n rows of n_cols features, stored contiguously in row-major order, writing the
+        // leaf values to out.
+        //
+        // Throws std::out_of_range if the tree does not exist, and std::invalid_argument if the trees reference
+        // features beyond n_cols.
+        void predict_tree(int64_t tree, const T *rows, int64_t n, int64_t n_cols, T *out) const;
+
+        // Evaluate all trees for every row of X (an NxM matrix), exactly as predict() would for each row.
+        //
+        // Uses up to n_threads threads; if n_threads <= 0, all available hardware threads are used.
+        //
+        // Returns an Nx1 matrix. Throws as predict() does.
+        num_array<T> predict_batch(const num_array<T> &X, bool average, int64_t n_threads) const;
+
+        // Rebuild a linked tree, the inverse of add_tree().
+        template <class TreeNode>
+        std::unique_ptr<TreeNode> expand_tree(int64_t tree) const;
+
+        // The current binary model format version. Models with any other version are rejected.
+        static constexpr uint32_t binary_format_version = 1;
+
+        // Write the trees in the binary model format, along with a model-specific section. Returns false if the stream
+        // could not be written.
+        bool write_binary(std::ostream &os, BinaryModelKind kind, int64_t n_features, const std::string &section) const;
+
+        // Load trees from a binary model held in memory, e.g., a mapped file. The buffer must be 8-byte aligned. The
+        // model must be of the given kind and floating-point type, and its checksum and tree structure are verified.
+        // The number of features and the model-specific section are returned.
+        //
+        // Returns false, leaving the trees unchanged, if the buffer is not a valid binary model.
+        bool read_binary(const void *data, size_t size, BinaryModelKind kind, int64_t &n_features, std::string &section);
+
+        // Load trees from a stream holding a binary model, as above.
+        bool read_binary(std::istream &is, BinaryModelKind kind, int64_t &n_features, std::string &section);
+};
+
+
+template <class T>
+template <class TreeNode>
+uint64_t FlatForest<T>::append(const TreeNode *node, uint64_t root_offset){
+    if(node == nullptr){
+        throw std::invalid_argument("Encountered a missing tree node");
+    }
+    const uint64_t offset = static_cast<uint64_t>(this->nodes.size()) - root_offset;
+    if(std::numeric_limits<uint32_t>::max() <= offset){
+        throw std::invalid_argument("Tree is too large to flatten");
+    }
+
+    Node n;
+    if(node->is_leaf){
+        n.value = node->value;
+        n.feature = -1;
+        n.right = 0;
+        this->nodes.push_back(n);
+        return offset;
+    }
+
+    if( (node->split_feature < 0)
+    ||  (static_cast<int64_t>(std::numeric_limits<int32_t>::max()) < node->split_feature) ){
+        throw std::invalid_argument("Tree node has an invalid split feature");
+    }
+    n.value = node->split_threshold;
+    n.feature = static_cast<int32_t>(node->split_feature);
+    this->max_feature = std::max(this->max_feature, node->split_feature);
+    n.right = 0;
+    this->nodes.push_back(n);
+    const uint64_t index = static_cast<uint64_t>(this->nodes.size()) - 1;
+
+    this->append(node->left.get(), root_offset);
+    const auto right = this->append(node->right.get(), root_offset);
+    this->nodes[index].right = static_cast<uint32_t>(right);
+    return offset;
+}
+
+
+template <class T>
+template <class TreeNode>
+void FlatForest<T>::add_tree(const TreeNode *root){
+    const auto root_offset = static_cast<uint64_t>(this->nodes.size());
+    const auto prev_max_feature = this->max_feature;
+    try{
+        this->append(root, root_offset);
+    }catch(const std::exception &){
+        this->nodes.resize(root_offset);
+        this->max_feature = prev_max_feature;
+        throw;
+    }
+    this->tree_offsets.push_back(root_offset);
+    return;
+}
+
+
+template <class T>
+template <class TreeNode>
+std::unique_ptr<TreeNode> FlatForest<T>::expand(const Node *root, const Node *node) const {
+    auto out = std::make_unique<TreeNode>();
+    if(node->feature < 0){
+        out->is_leaf = true;
+        out->value = node->value;
+        return out;
+    }
+    out->is_leaf = false;
+    out->split_feature = static_cast<int64_t>(node->feature);
+    out->split_threshold = node->value;
+    out->left = this->expand<TreeNode>(root, node + 1);
+    out->right = this->expand<TreeNode>(root, root + node->right);
+    return out;
+}
+
+
+template <class T>
+template <class TreeNode>
+std::unique_ptr<TreeNode> FlatForest<T>::expand_tree(int64_t tree) const {
+    const Node *root = this->nodes.data() + this->tree_offsets.at(tree);
+    return this->expand<TreeNode>(root, root);
+}
+
+} //namespace Stats.
+
+#endif // YGOR_STATS_FLAT_TREES_HDR_GRD_H
@@ -0,0 +1,246 @@
+//YgorStatsPermutationTests.cc - A part of Ygor, 2026. Written by hal clark.
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "YgorDefinitions.h"
+#include "YgorStatsPermutationTests.h"
+#include "YgorThreadPool.h"
+
+//#ifndef YGOR_STATS_PERMUTATION_TESTS_DISABLE_ALL_SPECIALIZATIONS
+//    #define YGOR_STATS_PERMUTATION_TESTS_DISABLE_ALL_SPECIALIZATIONS
+//#endif
+
+
+namespace {
+
+// Number of permutations drawn from each random number stream.
+constexpr int64_t permutation_batch_size = 32;
+
+// Batches involving fewer multiply-adds than this are not worth handing to another thread.
+constexpr double min_parallel_batch_work = 32768.0;
+
+// Error rates of the sequential probability ratio test.
+constexpr double sprt_error_rate = 0.001;
+
+// Derive the seed of a batch's random number stream (the SplitMix64 finalizer).
+uint64_t batch_seed(uint64_t seed, int64_t batch){
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (static_cast<uint64_t>(batch) + 1ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+} // namespace
+
+
+template <class T>
+struct Stats::MaxTypeTest<T>::Workers {
+    std::mutex m;
+    std::condition_variable cv;
+    int64_t n_helpers;
+    work_queue<std::function<void()>> wq; // Declared last, so tasks finish before the members they use are destroyed.
+
+    explicit Workers(int64_t n) : n_helpers(n), wq(static_cast<unsigned int>(n)) {}
+};
+
+
+template <class T>
+Stats::MaxTypeTest<T>::MaxTypeTest(Stats::SelectionTest method, int64_t n_permutations, T alpha, int64_t n_threads)
+    : method(method),
+      n_permutations(n_permutations),
+      alpha(alpha),
+      n_threads(n_threads) {
+
+    if(n_permutations <= 0){
+        throw std::invalid_argument("Number of permutations must be positive");
+    }
+    if(alpha <= static_cast<T>(0) || static_cast<T>(1) <= alpha){
+        throw std::invalid_argument("Alpha must be in the range (0, 1)");
+    }
+    if(this->n_threads <= 0){
+        this->n_threads = std::max<int64_t>(1, static_cast<int64_t>(std::thread::hardware_concurrency()));
+    }
+}
+#ifndef YGOR_STATS_PERMUTATION_TESTS_DISABLE_ALL_SPECIALIZATIONS
+    template Stats::MaxTypeTest<double>::MaxTypeTest(Stats::SelectionTest, int64_t, double, int64_t);
+    template Stats::MaxTypeTest<float>::MaxTypeTest(Stats::SelectionTest, int64_t, float, int64_t);
+#endif
+
+
+template <class T>
+Stats::MaxTypeTest<T>::~MaxTypeTest() = default;
+#ifndef YGOR_STATS_PERMUTATION_TESTS_DISABLE_ALL_SPECIALIZATIONS
+    template Stats::MaxTypeTest<double>::~MaxTypeTest();
+    template Stats::MaxTypeTest<float>::~MaxTypeTest();
+#endif
+
+
+template <class T>
+void Stats::MaxTypeTest<T>::evaluate_batch(int64_t batch,
+                                           uint64_t seed,
+                                           const std::vector<const T *> &x_dev,
+                                           const std::vector<T> &inv_sqrt_x_ss,
+                                           const std::vector<T> &y_dev,
+                                           T obs_max,
+                                           std::vector<uint8_t> &exceeded) const {
+    const int64_t first = batch * permutation_batch_size;
+    const int64_t count = std::min(permutation_batch_size, this->n_permutations - first);
+    const int64_t n_features = static_cast<int64_t>(x_dev.size());
+    const int64_t n_samples = static_cast<int64_t>(y_dev.size());
+
+    std::mt19937_64 rng(batch_seed(seed, batch));
+    std::vector<T> y_perm(y_dev);
+    exceeded.assign(count, 0);
+
+    for(int64_t k = 0; k < count; ++k){
+        std::shuffle(y_perm.begin(), y_perm.end(), rng);
+
+        // Only whether the maximum reaches the observed statistic matters, so stop at the first feature that does.
+        for(int64_t j = 0; j < n_features; ++j){
+            const T *x = x_dev[j];
+            T perm_stat = static_cast<T>(0);
+            for(int64_t i = 0; i < n_samples; ++i){
+                perm_stat += x[i] * y_perm[i];
+            }
+            if(obs_max <= std::abs(perm_stat) * inv_sqrt_x_ss[j]){
+                exceeded[k] = 1;
+                break;
+            }
+        }
+    }
+    return;
+}
+#ifndef YGOR_STATS_PERMUTATION_TESTS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::MaxTypeTest<double>::evaluate_batch(int64_t, uint64_t, const std::vector<const double *> &,
+        const std::vector<double> &, const std::vector<double> &, double, std::vector<uint8_t> &) const;
+    template void Stats::MaxTypeTest<float>::evaluate_batch(int64_t, uint64_t, const std::vector<const float *> &,
+        const std::vector<float> &, const std::vector<float> &, float, std::vector<uint8_t> &) const;
+#endif
+
+
+template <class T>
+T Stats::MaxTypeTest<T>::pvalue(const std::vector<const T *> &x_dev,
+                                const std::vector<T> &inv_sqrt_x_ss,
+                                const std::vector<T> &y_dev,
+                                T y_ss,
+                                T obs_max,
+                                uint64_t seed){
+    const int64_t n_features = static_cast<int64_t>(x_dev.size());
+    const int64_t n_samples = static_cast<int64_t>(y_dev.size());
+    if(static_cast<int64_t>(inv_sqrt_x_ss.size()) != n_features){
+        throw std::invalid_argument("Feature deviations and scale factors differ in number");
+    }
+    if( (n_features == 0)
+    ||  (n_samples < 2)
+    ||  !(static_cast<T>(0) < y_ss) ){
+        return static_cast<T>(1);
+    }
+
+    if(this->method == SelectionTest::asymptotic){
+        // Under permutation, sum_i x_dev_i * y_dev_i has mean zero and variance SS_X * SS_Y / (n - 1).
+        const double z = static_cast<double>(obs_max)
+                       * std::sqrt(static_cast<double>(n_samples - 1) / static_cast<double>(y_ss));
+        const double p_min = std::erfc(z / std::sqrt(2.0));
+        const double p = std::min(1.0, static_cast<double>(n_features) * p_min);
+        return std::max(static_cast<T>(p), std::numeric_limits<T>::min());
+    }
+
+    // Wald's SPRT of H0: p = alpha/2 against H1: p = 2*alpha, applied to the sequence of exceedances.
+    const bool sequential = (this->method == SelectionTest::sequential);
+    const double p0 = static_cast<double>(this->alpha) * 0.5;
+    const double p1 = std::min(static_cast<double>(this->alpha) * 2.0, (1.0 + static_cast<double>(this->alpha)) * 0.5);
+    const double llr_exceeded = std::log(p1 / p0);
+    const double llr_not_exceeded = std::log((1.0 - p1) / (1.0 - p0));
+    const double llr_insignificant = std::log((1.0 - sprt_error_rate) / sprt_error_rate);
+    const double llr_significant = -llr_insignificant;
+
+    // Determine how many batches to evaluate at once.
+    const int64_t n_batches = (this->n_permutations + permutation_batch_size - 1) / permutation_batch_size;
+    const double batch_work = static_cast<double>(n_samples) * static_cast<double>(n_features)
+                            * static_cast<double>(permutation_batch_size);
+    int64_t wave = 1;
+    if( (1 < this->n_threads)
+    &&  (1 < n_batches)
+    &&  (min_parallel_batch_work <= batch_work) ){
+        if(!this->workers) this->workers = std::make_unique<Workers>(this->n_threads - 1);
+        wave = std::min(this->workers->n_helpers + 1, n_batches);
+    }
+
+    std::vector<std::vector<uint8_t>> results(wave);
+    std::vector<std::exception_ptr> errors(wave);
+    int64_t count_ge = 0;
+    int64_t k = 0;
+    double llr = 0.0;
+
+    for(int64_t first = 0; first < n_batches; first += wave){
+        const int64_t w = std::min(wave, n_batches - first);
+
+        const auto run = [&](int64_t b){
+            try{
+                this->evaluate_batch(first + b, seed, x_dev, inv_sqrt_x_ss, y_dev, obs_max, results[b]);
+            }catch(...){
+                errors[b] = std::current_exception();
+            }
+        };
+
+        if(w == 1){
+            run(0);
+        }else{
+            int64_t pending = w - 1;
+            for(int64_t b = 1; b < w; ++b){
+                this->workers->wq.submit_task([&, b](){
+                    run(b);
+                    std::lock_guard<std::mutex> lock(this->workers->m);
+                    --pending;
+                    this->workers->cv.notify_all();
+                });
+            }
+            run(0);
+            std::unique_lock<std::mutex> lock(this->workers->m);
+            this->workers->cv.wait(lock, [&](){ return (pending == 0); });
+        }
+        for(auto &e : errors){
+            if(e) std::rethrow_exception(e);
+        }
+
+        // Consume the results in permutation order, so the outcome does not depend on the wave size.
+        for(int64_t b = 0; b < w; ++b){
+            for(const auto e : results[b]){
+                ++k;
+                count_ge += e;
+                if(!sequential) continue;
+
+                llr += (e != 0) ? llr_exceeded : llr_not_exceeded;
+                const T estimate = static_cast<T>(count_ge + 1) / static_cast<T>(k + 1);
+                if(llr_insignificant <= llr){
+                    return std::max(estimate, this->alpha);
+                }
+                if(llr <= llr_significant){
+                    return std::min(estimate, std::nextafter(this->alpha, static_cast<T>(0)));
+                }
+            }
+        }
+    }
+
+    // Global p-value: (b+1)/(B+1) per Davison & Hinkley (1997).
+    return static_cast<T>(count_ge + 1) / static_cast<T>(k + 1);
+}
+#ifndef YGOR_STATS_PERMUTATION_TESTS_DISABLE_ALL_SPECIALIZATIONS
+    template double Stats::MaxTypeTest<double>::pvalue(const std::vector<const double *> &, const std::vector<double> &,
+                                                       const std::vector<double> &, double, double, uint64_t);
+    template float Stats::MaxTypeTest<float>::pvalue(const std::vector<const float *> &, const std::vector<float> &,
+                                                     const std::vector<float> &, float, float, uint64_t);
+#endif
+
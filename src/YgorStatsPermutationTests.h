@@ -0,0 +1,110 @@
+//YgorStatsPermutationTests.h - A part of Ygor, 2026. Written by hal clark.
+//
+// The global max-type test of independence used for variable selection by the conditional inference regressors
+// (ConditionalInferenceTrees, ConditionalRandomForests). See:
+//   Hothorn T, Hornik K, Zeileis A. Unbiased recursive partitioning: A conditional inference framework. Journal of
+//   Computational and Graphical Statistics. 2006 Sep 1;15(3):651-74.
+//
+// The permutation distribution dominates the cost of fitting these models, so permutations are evaluated in batches
+// that can be distributed over threads, and can be stopped as soon as the outcome of the test is clear.
+//
+
+#pragma once
+
+#ifndef YGOR_STATS_PERMUTATION_TESTS_HDR_GRD_H
+#define YGOR_STATS_PERMUTATION_TESTS_HDR_GRD_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "YgorDefinitions.h"
+
+namespace Stats {
+
+// Method used to estimate the p-value of the global test at each node.
+//
+//   permutation: All permutations are evaluated, and the p-value is (b+1)/(B+1), where b of the B permutations
+//                produced a statistic at least as large as the observed statistic (Davison & Hinkley, 1997).
+//
+//   sequential:  Permutations are evaluated one at a time, and stop as soon as Wald's sequential probability ratio
+//                test decides between p <= alpha/2 and p >= 2*alpha, with error rates of 0.001. Clearly significant
+//                or insignificant nodes need tens of permutations rather than the full number, which remains the
+//                upper limit. When the test stops early, the running estimate (b+1)/(k+1) after k permutations is
+//                reported, limited to the side of alpha the test decided on. Borderline nodes use all permutations
+//                and get the same p-value as the permutation method.
+//
+//   asymptotic:  No permutations. Each standardized statistic is asymptotically normal under the null hypothesis
+//                (its permutation variance is known exactly), so each feature's two-sided p-value is computed from
+//                the normal distribution and the smallest is Bonferroni-adjusted for the number of features. This is
+//                slightly conservative when features are correlated, and inaccurate for very small nodes.
+//
+enum class SelectionTest : int { permutation = 0, sequential = 1, asymptotic = 2 };
+
+// The global max-type test of independence between a response and a set of features.
+//
+// For each feature j, the statistic is the standardized linear association
+//   c_j = |sum_i (X_{ij} - Xbar_j)(Y_i - Ybar)| / sqrt(SS_Xj),
+// and the global test uses c_max = max_j c_j, which controls for testing many features at once.
+//
+// Permutations are drawn in fixed-size batches, each from its own random number stream derived from the seed passed
+// to pvalue(), and results are consumed in batch order. The p-value therefore depends only on the seed, not on the
+// number of threads or the order in which batches complete.
+//
+template <class T>
+class MaxTypeTest {
+    private:
+        struct Workers;
+
+        SelectionTest method;
+        int64_t n_permutations;
+        T alpha;
+        int64_t n_threads;
+        std::unique_ptr<Workers> workers; // Created on first use.
+
+        // Evaluate the permutations of one batch, storing whether each exceeded the observed statistic.
+        void evaluate_batch(int64_t batch,
+                            uint64_t seed,
+                            const std::vector<const T *> &x_dev,
+                            const std::vector<T> &inv_sqrt_x_ss,
+                            const std::vector<T> &y_dev,
+                            T obs_max,
+                            std::vector<uint8_t> &exceeded) const;
+
+    public:
+        // Parameters:
+        //   method: How the p-value is estimated.
+        //   n_permutations: The (maximum) number of permutations. Must be positive.
+        //   alpha: Significance threshold, in (0, 1). Only used by the sequential method.
+        //   n_threads: Number of threads used to evaluate permutations. Zero uses all hardware threads.
+        //              Small tests are always evaluated on the calling thread.
+        MaxTypeTest(SelectionTest method, int64_t n_permutations, T alpha, int64_t n_threads);
+        ~MaxTypeTest();
+
+        MaxTypeTest(const MaxTypeTest &) = delete;
+        MaxTypeTest &operator=(const MaxTypeTest &) = delete;
+
+        // Estimate the p-value of the global test.
+        //
+        // Parameters:
+        //   x_dev: For each feature with nonzero variance, the deviations from the feature's mean. Each must hold
+        //          y_dev.size() values.
+        //   inv_sqrt_x_ss: For each feature in x_dev, 1/sqrt(SS_Xj).
+        //   y_dev: The deviations of the response from its mean.
+        //   y_ss: The sum of squares of y_dev. Must be positive.
+        //   obs_max: The observed statistic c_max.
+        //   seed: Seeds the random number streams of the permutations.
+        //
+        // Returns:
+        //   The estimated p-value, in (0, 1].
+        T pvalue(const std::vector<const T *> &x_dev,
+                 const std::vector<T> &inv_sqrt_x_ss,
+                 const std::vector<T> &y_dev,
+                 T y_ss,
+                 T obs_max,
+                 uint64_t seed);
+};
+
+} //namespace Stats.
+
+#endif // YGOR_STATS_PERMUTATION_TESTS_HDR_GRD_H
@@ -12,10 +12,64 @@
 #include <limits>
 #include <numeric>
 #include <algorithm>
+#include <exception>
+#include <thread>
 
 #include "YgorDefinitions.h"
 #include "YgorStatsStochasticForests.h"
 #include "YgorLog.h"
+#include "YgorThreadPool.h"
+
+
+namespace {
+
+// Derive an independent random number stream for each tree from the forest's seed, so trees can be built in any order.
+std::mt19937_64 make_tree_rng(uint64_t random_seed, int64_t tree_index){
+    const auto t = static_cast<uint64_t>(tree_index);
+    std::seed_seq seq{ static_cast<uint32_t>(random_seed), static_cast<uint32_t>(random_seed >> 32),
+                       static_cast<uint32_t>(t), static_cast<uint32_t>(t >> 32) };
+    return std::mt19937_64(seq);
+}
+
+// Run count independent tasks using up to n_workers threads. The first exception thrown by any task is rethrown.
+void run_tasks(int64_t n_workers, int64_t count, const std::function<void(int64_t)> &task){
+    std::vector<std::exception_ptr> errors(count);
+    const auto guarded = [&](int64_t i){
+        try{
+            task(i);
+        }catch(...){
+            errors[i] = std::current_exception();
+        }
+    };
+
+    n_workers = std::min(n_workers, count);
+    if(n_workers <= 1){
+        for(int64_t i = 0; i < count; ++i) guarded(i);
+    }else{
+        work_queue<std::function<void()>> wq(static_cast<unsigned int>(n_workers));
+        for(int64_t i = 0; i < count; ++i){
+            wq.submit_task([&, i](){ guarded(i); });
+        }
+        // Note: the destructor waits for all submitted tasks to complete.
+    }
+    for(const auto &e : errors){
+        if(e) std::rethrow_exception(e);
+    }
+    return;
+}
+
+// Number of bins used by the histogram split method. Bin indices must fit in a uint8_t.
+constexpr int64_t n_histogram_bins = 256;
+
+// A threshold separating two consecutive distinct values. The midpoint is used unless it rounds up to the larger value,
+// in which case the smaller value is used so the threshold still separates them.
+template <class T>
+T separating_threshold(T lower, T upper){
+    const T mid = (lower + upper) / static_cast<T>(2);
+    return (mid < upper) ? mid : lower;
+}
+
+} // namespace
 
 
 template <class T>
@@ -30,6 +84,8 @@ Stats::StochasticForests<T>::StochasticForests(int64_t n_trees,
       max_features(max_features),
       n_features_trained(-1),
       random_seed(random_seed),
+      n_threads(0),
+      split_method(SplitMethod::exact),
       importance_method(ImportanceMethod::none) {
     
     if(n_trees <= 0){
@@ -75,24 +131,72 @@ void Stats::StochasticForests<T>::fit(const num_array<T> &X, const num_array<T>
     
     // Clear any existing trees and importance data.
     this->trees.clear();
-    this->trees.reserve(this->n_trees);
+    this->flat_trees.clear();
     this->feature_importances.clear();
     this->oob_indices_per_tree.clear();
     this->gini_importances_raw.clear();
 
-    // Initialize importance tracking if needed.
-    if(this->importance_method == ImportanceMethod::gini){
-        this->gini_importances_raw.assign(n_features, static_cast<T>(0));
+    const bool track_gini = (this->importance_method == ImportanceMethod::gini);
+    const bool track_oob = (this->importance_method == ImportanceMethod::permutation);
+
+    int64_t n_workers = this->n_threads;
+    if(n_workers <= 0){
+        n_workers = std::max<int64_t>(1, static_cast<int64_t>(std::thread::hardware_concurrency()));
     }
-    if(this->importance_method == ImportanceMethod::permutation){
-        this->oob_indices_per_tree.reserve(this->n_trees);
+
+    // Prepare the data shared by all trees.
+    TrainingContext ctx;
+    ctx.X = &X;
+    ctx.y = &y;
+    ctx.n_samples = n_samples;
+    ctx.n_features = n_features;
+    ctx.effective_max_features = effective_max_features;
+    ctx.subtract_histograms = false;
+
+    T y_sum = static_cast<T>(0);
+    for(int64_t i = 0; i < n_samples; ++i){
+        y_sum += y.read_coeff(i, 0);
     }
-    
-    // Build each tree with bootstrap sampling.
-    std::mt19937_64 rng(this->random_seed);
-    std::uniform_int_distribution<int64_t> sample_dist(0, n_samples - 1);
-    
-    for(int64_t t = 0; t < this->n_trees; ++t){
+    const T y_mean = y_sum / static_cast<T>(n_samples);
+    ctx.y_centred.resize(n_samples);
+    for(int64_t i = 0; i < n_samples; ++i){
+        ctx.y_centred[i] = y.read_coeff(i, 0) - y_mean;
+    }
+
+    if(this->split_method == SplitMethod::histogram){
+        ctx.bins.resize(n_features);
+        ctx.bin_thresholds.resize(n_features);
+        run_tasks(n_workers, n_features, [&](int64_t f){ bin_feature(ctx, f); });
+
+        // Carrying histograms for every feature only pays off when most features are considered at each split.
+        ctx.subtract_histograms = (n_features <= 2 * effective_max_features);
+
+    }else if(n_samples <= static_cast<int64_t>(std::numeric_limits<uint32_t>::max())){
+        ctx.sorted_indices.resize(n_features);
+        ctx.sorted_values.resize(n_features);
+        run_tasks(n_workers, n_features, [&](int64_t f){
+            auto &order = ctx.sorted_indices[f];
+            order.resize(n_samples);
+            std::iota(order.begin(), order.end(), static_cast<uint32_t>(0));
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){
+                return X.read_coeff(a, f) < X.read_coeff(b, f);
+            });
+            auto &values = ctx.sorted_values[f];
+            values.reserve(n_samples);
+            for(const auto i : order) values.push_back(X.read_coeff(i, f));
+        });
+    }
+
+    // Trees are independent, so they are built concurrently. Each tree writes only to its own slots, which are combined
+    // afterward in tree order.
+    std::vector<std::unique_ptr<TreeNode>> new_trees(this->n_trees);
+    std::vector<std::vector<int64_t>> new_oob(track_oob ? this->n_trees : 0);
+    std::vector<std::vector<T>> gini_per_tree(track_gini ? this->n_trees : 0);
+
+    run_tasks(n_workers, this->n_trees, [&](int64_t t){
+        auto rng = make_tree_rng(this->random_seed, t);
+        std::uniform_int_distribution<int64_t> sample_dist(0, n_samples - 1);
+
         // Bootstrap sampling: sample with replacement.
         std::vector<int64_t> bootstrap_indices;
         bootstrap_indices.reserve(n_samples);
@@ -101,23 +205,44 @@ void Stats::StochasticForests<T>::fit(const num_array<T> &X, const num_array<T>
         }
 
         // Track OOB indices for permutation importance.
-        if(this->importance_method == ImportanceMethod::permutation){
+        if(track_oob){
             std::vector<bool> in_bag(n_samples, false);
             for(const auto idx : bootstrap_indices){
                 in_bag[idx] = true;
             }
-            std::vector<int64_t> oob;
+            auto &oob = new_oob[t];
             for(int64_t i = 0; i < n_samples; ++i){
                 if(!in_bag[i]){
                     oob.push_back(i);
                 }
             }
-            this->oob_indices_per_tree.push_back(std::move(oob));
         }
-        
+
+        std::vector<T> *gini = nullptr;
+        if(track_gini){
+            gini_per_tree[t].assign(n_features, static_cast<T>(0));
+            gini = &(gini_per_tree[t]);
+        }
+
+        TreeScratch scratch;
+        if(!ctx.sorted_indices.empty()){
+            scratch.multiplicity.assign(n_samples, 0);
+        }
+
         // Build a tree using the bootstrap sample.
-        auto tree = build_tree(X, y, bootstrap_indices, 0, effective_max_features, rng);
-        this->trees.push_back(std::move(tree));
+        new_trees[t] = build_tree(ctx, scratch, bootstrap_indices, 0, rng, gini, Histograms());
+    });
+
+    this->trees = std::move(new_trees);
+    this->compile_trees();
+    this->oob_indices_per_tree = std::move(new_oob);
+    if(track_gini){
+        this->gini_importances_raw.assign(n_features, static_cast<T>(0));
+        for(const auto &g : gini_per_tree){
+            for(int64_t f = 0; f < n_features; ++f){
+                this->gini_importances_raw[f] += g[f];
+            }
+        }
     }
 
     // Finalize Gini importances: normalize to sum to 1.
@@ -144,18 +269,91 @@ void Stats::StochasticForests<T>::fit(const num_array<T> &X, const num_array<T>
 #endif
 
 
+template <class T>
+void Stats::StochasticForests<T>::bin_feature(TrainingContext &ctx, int64_t feature) const {
+    const auto &X = *(ctx.X);
+    const int64_t n_samples = ctx.n_samples;
+
+    std::vector<T> values;
+    values.reserve(n_samples);
+    for(int64_t i = 0; i < n_samples; ++i){
+        values.push_back(X.read_coeff(i, feature));
+    }
+    std::sort(values.begin(), values.end());
+
+    int64_t n_distinct = (n_samples == 0) ? 0 : 1;
+    for(int64_t i = 0; (i + 1) < n_samples; ++i){
+        if(values[i] != values[i + 1]) ++n_distinct;
+    }
+
+    // Separate every distinct value if possible. Otherwise place thresholds at (approximately) equal-count quantiles.
+    auto &thresholds = ctx.bin_thresholds[feature];
+    thresholds.clear();
+    const double per_bin = static_cast<double>(n_samples) / static_cast<double>(n_histogram_bins);
+    for(int64_t i = 0; (i + 1) < n_samples; ++i){
+        if(values[i] == values[i + 1]) continue;
+        if( (n_distinct <= n_histogram_bins)
+        ||  ( (per_bin * static_cast<double>(thresholds.size() + 1) <= static_cast<double>(i + 1))
+           && (static_cast<int64_t>(thresholds.size()) < (n_histogram_bins - 1)) ) ){
+            thresholds.push_back(separating_threshold(values[i], values[i + 1]));
+        }
+    }
+
+    // A value falls into the bin of the first threshold that is not less than it, so values in bins up to and including
+    // b are exactly those no greater than thresholds[b].
+    auto &bins = ctx.bins[feature];
+    bins.resize(n_samples);
+    for(int64_t i = 0; i < n_samples; ++i){
+        const auto it = std::lower_bound(thresholds.begin(), thresholds.end(), X.read_coeff(i, feature));
+        bins[i] = static_cast<uint8_t>(std::distance(thresholds.begin(), it));
+    }
+    return;
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::StochasticForests<double>::bin_feature(TrainingContext &, int64_t) const;
+    template void Stats::StochasticForests<float>::bin_feature(TrainingContext &, int64_t) const;
+#endif
+
+
+template <class T>
+void Stats::StochasticForests<T>::fill_histograms(const TrainingContext &ctx,
+                                                  const std::vector<int64_t> &sample_indices,
+                                                  Histograms &h) const {
+    h.assign(ctx.n_features * n_histogram_bins, BinStats{ 0, static_cast<T>(0) });
+    for(int64_t f = 0; f < ctx.n_features; ++f){
+        const uint8_t *col = ctx.bins[f].data();
+        BinStats *hf = h.data() + f * n_histogram_bins;
+        for(const auto idx : sample_indices){
+            auto &b = hf[col[idx]];
+            ++b.count;
+            b.sum += ctx.y_centred[idx];
+        }
+    }
+    return;
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::StochasticForests<double>::fill_histograms(const TrainingContext &, const std::vector<int64_t> &,
+                                                                    Histograms &) const;
+    template void Stats::StochasticForests<float>::fill_histograms(const TrainingContext &, const std::vector<int64_t> &,
+                                                                   Histograms &) const;
+#endif
+
+
 template <class T>
 std::unique_ptr<typename Stats::StochasticForests<T>::TreeNode>
 Stats::StochasticForests<T>::build_tree(
-    const num_array<T> &X,
-    const num_array<T> &y,
+    const TrainingContext &ctx,
+    TreeScratch &scratch,
     const std::vector<int64_t> &sample_indices,
     int64_t depth,
-    int64_t effective_max_features,
-    std::mt19937_64 &rng) {
-    
+    std::mt19937_64 &rng,
+    std::vector<T> *gini_accumulator,
+    Histograms histograms) {
+
+    const auto &X = *(ctx.X);
+    const auto &y = *(ctx.y);
     auto node = std::make_unique<TreeNode>();
-    
+
     // Check stopping criteria.
     const int64_t n_samples = sample_indices.size();
     if(n_samples == 0){
@@ -163,50 +361,72 @@ Stats::StochasticForests<T>::build_tree(
         node->value = static_cast<T>(0);
         return node;
     }
-    
+
     // Compute mean for potential leaf node.
     T sum = static_cast<T>(0);
     for(const auto idx : sample_indices){
         sum += y.read_coeff(idx, 0);
     }
     const T mean = sum / static_cast<T>(n_samples);
-    
+
     // Create leaf if stopping criteria met.
     if(depth >= this->max_depth || n_samples < this->min_samples_split){
         node->is_leaf = true;
         node->value = mean;
         return node;
     }
-    
+
     // Find best split using random feature selection.
+    if(ctx.subtract_histograms && histograms.empty()){
+        fill_histograms(ctx, sample_indices, histograms);
+    }
     int64_t best_feature;
     T best_threshold;
+    int64_t best_bin;
     T best_score;
-    std::vector<int64_t> left_indices, right_indices;
-    
-    if(!find_best_split(X, y, sample_indices, effective_max_features, 
-                       best_feature, best_threshold, best_score,
-                       left_indices, right_indices, rng)){
+    if(!find_best_split(ctx, scratch, sample_indices, histograms,
+                        best_feature, best_threshold, best_bin, best_score, rng)){
         // Could not find a valid split, create leaf.
         node->is_leaf = true;
         node->value = mean;
         return node;
     }
-    
+
+    // Partition the samples. Bins are equivalent to, but cheaper than, comparing feature values with the threshold.
+    std::vector<int64_t> left_indices, right_indices;
+    if(this->split_method == SplitMethod::histogram){
+        const uint8_t *col = ctx.bins[best_feature].data();
+        for(const auto idx : sample_indices){
+            if(static_cast<int64_t>(col[idx]) <= best_bin){
+                left_indices.push_back(idx);
+            }else{
+                right_indices.push_back(idx);
+            }
+        }
+    }else{
+        for(const auto idx : sample_indices){
+            if(X.read_coeff(idx, best_feature) <= best_threshold){
+                left_indices.push_back(idx);
+            }else{
+                right_indices.push_back(idx);
+            }
+        }
+    }
+
     // If split doesn't actually separate samples, create leaf.
     if(left_indices.empty() || right_indices.empty()){
         node->is_leaf = true;
         node->value = mean;
         return node;
     }
-    
+
     // Create internal node and recursively build children.
     node->is_leaf = false;
     node->split_feature = best_feature;
     node->split_threshold = best_threshold;
 
     // Accumulate Gini importance (weighted impurity decrease).
-    if(this->importance_method == ImportanceMethod::gini){
+    if(gini_accumulator != nullptr){
         // Compute parent variance.
         T sum_sq_dev = static_cast<T>(0);
         for(const auto idx : sample_indices){
@@ -217,206 +437,256 @@ Stats::StochasticForests<T>::build_tree(
         // best_score is -weighted_child_var, so impurity decrease = parent_var + best_score.
         const T impurity_decrease = parent_var + best_score;
         if(impurity_decrease > static_cast<T>(0)){
-            this->gini_importances_raw[best_feature] += static_cast<T>(n_samples) * impurity_decrease;
+            (*gini_accumulator)[best_feature] += static_cast<T>(n_samples) * impurity_decrease;
         }
     }
 
-    node->left = build_tree(X, y, left_indices, depth + 1, effective_max_features, rng);
-    node->right = build_tree(X, y, right_indices, depth + 1, effective_max_features, rng);
-    
+    // Compute the histograms of the smaller child directly, and derive those of the larger child by subtraction. This
+    // is skipped when both children will be leaves.
+    Histograms left_histograms, right_histograms;
+    if(ctx.subtract_histograms){
+        const auto can_split = [&](const std::vector<int64_t> &indices){
+            return ((depth + 1) < this->max_depth)
+                && (this->min_samples_split <= static_cast<int64_t>(indices.size()));
+        };
+        if(can_split(left_indices) || can_split(right_indices)){
+            const bool left_is_smaller = (left_indices.size() <= right_indices.size());
+            auto &smaller = left_is_smaller ? left_histograms : right_histograms;
+            auto &larger = left_is_smaller ? right_histograms : left_histograms;
+            fill_histograms(ctx, left_is_smaller ? left_indices : right_indices, smaller);
+            larger = std::move(histograms);
+            for(size_t b = 0; b < larger.size(); ++b){
+                larger[b].count -= smaller[b].count;
+                larger[b].sum -= smaller[b].sum;
+            }
+        }
+    }
+    Histograms().swap(histograms);
+
+    node->left = build_tree(ctx, scratch, left_indices, depth + 1, rng, gini_accumulator, std::move(left_histograms));
+    node->right = build_tree(ctx, scratch, right_indices, depth + 1, rng, gini_accumulator, std::move(right_histograms));
+
     return node;
 }
 #ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
     template std::unique_ptr<typename Stats::StochasticForests<double>::TreeNode>
-        Stats::StochasticForests<double>::build_tree(const num_array<double> &, const num_array<double> &,
-                                               const std::vector<int64_t> &, int64_t, int64_t, std::mt19937_64 &);
+        Stats::StochasticForests<double>::build_tree(const TrainingContext &, TreeScratch &,
+                                               const std::vector<int64_t> &, int64_t, std::mt19937_64 &,
+                                               std::vector<double> *, Histograms);
     template std::unique_ptr<typename Stats::StochasticForests<float>::TreeNode>
-        Stats::StochasticForests<float>::build_tree(const num_array<float> &, const num_array<float> &,
-                                              const std::vector<int64_t> &, int64_t, int64_t, std::mt19937_64 &);
+        Stats::StochasticForests<float>::build_tree(const TrainingContext &, TreeScratch &,
+                                              const std::vector<int64_t> &, int64_t, std::mt19937_64 &,
+                                              std::vector<float> *, Histograms);
 #endif
 
 
 template <class T>
 bool Stats::StochasticForests<T>::find_best_split(
-    const num_array<T> &X,
-    const num_array<T> &y,
+    const TrainingContext &ctx,
+    TreeScratch &scratch,
     const std::vector<int64_t> &sample_indices,
-    int64_t effective_max_features,
+    const Histograms &histograms,
     int64_t &best_feature,
     T &best_threshold,
+    int64_t &best_bin,
     T &best_score,
-    std::vector<int64_t> &left_indices,
-    std::vector<int64_t> &right_indices,
     std::mt19937_64 &rng) {
-    
-    const int64_t n_features = X.num_cols();
-    
+
+    const auto &X = *(ctx.X);
+    const int64_t n_features = ctx.n_features;
+    const int64_t n_samples = sample_indices.size();
+
     // Randomly select features to consider (feature randomness).
-    std::vector<int64_t> feature_indices;
-    for(int64_t f = 0; f < n_features; ++f){
-        feature_indices.push_back(f);
-    }
+    auto &feature_indices = scratch.feature_indices;
+    feature_indices.resize(n_features);
+    std::iota(feature_indices.begin(), feature_indices.end(), static_cast<int64_t>(0));
     std::shuffle(feature_indices.begin(), feature_indices.end(), rng);
-    
+
     // Only consider effective_max_features random features.
-    const int64_t n_features_to_try = std::min(effective_max_features, n_features);
-    
-    best_score = -std::numeric_limits<T>::infinity();
+    const int64_t n_features_to_try = std::min(ctx.effective_max_features, n_features);
+
+    // The weighted variance of the children is
+    //
+    //   (1/n) * ( sum(c^2) - S_left^2/n_left - S_right^2/n_right ),
+    //
+    // where c are the centred outputs and S are their sums in each child. The first term is common to all splits, so
+    // candidates are ranked by the remaining terms (the 'gain') using running sums.
+    T sum_sq = static_cast<T>(0);
+    for(const auto idx : sample_indices){
+        const T c = ctx.y_centred[idx];
+        sum_sq += c * c;
+    }
+
+    T best_gain = -std::numeric_limits<T>::infinity();
     bool found_split = false;
-    
-    // Clear output vectors.
-    left_indices.clear();
-    right_indices.clear();
-    
-    // Try each randomly selected feature.
-    for(int64_t f_idx = 0; f_idx < n_features_to_try; ++f_idx){
-        const int64_t feature = feature_indices[f_idx];
-        
-        // Collect unique feature values from samples to use as potential thresholds.
-        std::vector<T> feature_values;
-        feature_values.reserve(sample_indices.size());
-        for(const auto idx : sample_indices){
-            feature_values.push_back(X.read_coeff(idx, feature));
+    const auto consider = [&](int64_t n_left, T sum_left, T sum_total, int64_t feature, T threshold, int64_t bin){
+        const int64_t n_right = n_samples - n_left;
+        const T sum_right = sum_total - sum_left;
+        const T gain = (sum_left * sum_left) / static_cast<T>(n_left)
+                     + (sum_right * sum_right) / static_cast<T>(n_right);
+        if(gain > best_gain){
+            best_gain = gain;
+            best_feature = feature;
+            best_threshold = threshold;
+            best_bin = bin;
+            found_split = true;
         }
-        
-        // Sort to find potential split points.
-        std::sort(feature_values.begin(), feature_values.end());
-        
-        // Try midpoints between consecutive unique values as thresholds.
-        for(size_t i = 0; i + 1 < feature_values.size(); ++i){
-            // Skip if values are identical (no split point).
-            if(feature_values[i] == feature_values[i + 1]){
-                continue;
-            }
-            
-            const T threshold = (feature_values[i] + feature_values[i + 1]) / static_cast<T>(2);
-            
-            // Split samples.
-            std::vector<int64_t> temp_left, temp_right;
-            for(const auto idx : sample_indices){
-                if(X.read_coeff(idx, feature) <= threshold){
-                    temp_left.push_back(idx);
-                }else{
-                    temp_right.push_back(idx);
+    };
+
+    if(this->split_method == SplitMethod::histogram){
+        for(int64_t f_idx = 0; f_idx < n_features_to_try; ++f_idx){
+            const int64_t feature = feature_indices[f_idx];
+            const auto &thresholds = ctx.bin_thresholds[feature];
+
+            // Use the node's histograms if available, otherwise accumulate them for this feature only.
+            const BinStats *h = nullptr;
+            if(!histograms.empty()){
+                h = histograms.data() + feature * n_histogram_bins;
+            }else{
+                auto &local = scratch.histograms;
+                local.assign(n_histogram_bins, BinStats{ 0, static_cast<T>(0) });
+                const uint8_t *col = ctx.bins[feature].data();
+                for(const auto idx : sample_indices){
+                    auto &b = local[col[idx]];
+                    ++b.count;
+                    b.sum += ctx.y_centred[idx];
                 }
+                h = local.data();
             }
-            
-            // Skip if split doesn't separate samples.
-            if(temp_left.empty() || temp_right.empty()){
-                continue;
+
+            const int64_t n_bins = static_cast<int64_t>(thresholds.size()) + 1;
+            T sum_total = static_cast<T>(0);
+            for(int64_t b = 0; b < n_bins; ++b) sum_total += h[b].sum;
+
+            int64_t n_left = 0;
+            T sum_left = static_cast<T>(0);
+            for(int64_t b = 0; (b + 1) < n_bins; ++b){
+                // Empty bins do not alter the partition.
+                if(h[b].count == 0) continue;
+                n_left += h[b].count;
+                sum_left += h[b].sum;
+                if(n_samples <= n_left) break;
+                consider(n_left, sum_left, sum_total, feature, thresholds[b], b);
             }
-            
-            // Compute variance reduction.
-            const T score = compute_variance_reduction(y, temp_left, temp_right);
-            
-            if(score > best_score){
-                best_score = score;
-                best_feature = feature;
-                best_threshold = threshold;
-                left_indices = temp_left;
-                right_indices = temp_right;
-                found_split = true;
+        }
+
+    }else{
+        // Visiting the presorted samples costs O(N) for a node with n samples, whereas sorting costs O(n log n), so
+        // only large nodes use the presorted order.
+        const int64_t N = ctx.n_samples;
+        const bool use_presorted = !ctx.sorted_indices.empty()
+                                && (N < (n_samples * static_cast<int64_t>(std::log2(n_samples + 1))) / 2);
+        if(use_presorted){
+            for(const auto idx : sample_indices) ++scratch.multiplicity[idx];
+        }
+
+        T sum_total = static_cast<T>(0);
+        for(const auto idx : sample_indices) sum_total += ctx.y_centred[idx];
+
+        auto &pairs = scratch.pairs;
+        for(int64_t f_idx = 0; f_idx < n_features_to_try; ++f_idx){
+            const int64_t feature = feature_indices[f_idx];
+
+            // Collect the (feature value, output) pairs in order of increasing feature value.
+            pairs.clear();
+            if(use_presorted){
+                const auto &order = ctx.sorted_indices[feature];
+                const auto &values = ctx.sorted_values[feature];
+                for(int64_t j = 0; j < N; ++j){
+                    const auto idx = order[j];
+                    for(uint32_t m = scratch.multiplicity[idx]; 0 < m; --m){
+                        pairs.emplace_back(values[j], ctx.y_centred[idx]);
+                    }
+                }
+            }else{
+                for(const auto idx : sample_indices){
+                    pairs.emplace_back(X.read_coeff(idx, feature), ctx.y_centred[idx]);
+                }
+                std::sort(pairs.begin(), pairs.end(),
+                          [](const std::pair<T, T> &a, const std::pair<T, T> &b){ return a.first < b.first; });
+            }
+
+            // Try thresholds between consecutive distinct values.
+            T sum_left = static_cast<T>(0);
+            for(int64_t i = 0; (i + 1) < n_samples; ++i){
+                sum_left += pairs[i].second;
+                if(pairs[i].first == pairs[i + 1].first) continue;
+                consider(i + 1, sum_left, sum_total, feature,
+                         separating_threshold(pairs[i].first, pairs[i + 1].first), -1);
             }
         }
+
+        if(use_presorted){
+            for(const auto idx : sample_indices) scratch.multiplicity[idx] = 0;
+        }
+    }
+
+    if(found_split){
+        best_score = -std::max(sum_sq - best_gain, static_cast<T>(0)) / static_cast<T>(n_samples);
     }
-    
     return found_split;
 }
 #ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
-    template bool Stats::StochasticForests<double>::find_best_split(const num_array<double> &, const num_array<double> &,
-                                                               const std::vector<int64_t> &, int64_t, int64_t &, double &, double &,
-                                                               std::vector<int64_t> &, std::vector<int64_t> &,
+    template bool Stats::StochasticForests<double>::find_best_split(const TrainingContext &, TreeScratch &,
+                                                               const std::vector<int64_t> &, const Histograms &,
+                                                               int64_t &, double &, int64_t &, double &,
                                                                std::mt19937_64 &);
-    template bool Stats::StochasticForests<float>::find_best_split(const num_array<float> &, const num_array<float> &,
-                                                              const std::vector<int64_t> &, int64_t, int64_t &, float &, float &,
-                                                              std::vector<int64_t> &, std::vector<int64_t> &,
+    template bool Stats::StochasticForests<float>::find_best_split(const TrainingContext &, TreeScratch &,
+                                                              const std::vector<int64_t> &, const Histograms &,
+                                                              int64_t &, float &, int64_t &, float &,
                                                               std::mt19937_64 &);
 #endif
 
 
 template <class T>
-T Stats::StochasticForests<T>::compute_variance_reduction(
-    const num_array<T> &y,
-    const std::vector<int64_t> &left_indices,
-    const std::vector<int64_t> &right_indices) {
-    
-    const int64_t n_left = left_indices.size();
-    const int64_t n_right = right_indices.size();
-    const int64_t n_total = n_left + n_right;
-    
-    if(n_total == 0) return static_cast<T>(0);
-    
-    // Compute variance for left child using numerically stable two-pass algorithm.
-    // First pass: compute mean.
-    T left_sum = static_cast<T>(0);
-    for(const auto idx : left_indices){
-        left_sum += y.read_coeff(idx, 0);
-    }
-    const T left_mean = left_sum / static_cast<T>(n_left);
-    
-    // Second pass: compute variance using deviations from mean.
-    T left_sum_sq_dev = static_cast<T>(0);
-    for(const auto idx : left_indices){
-        const T dev = y.read_coeff(idx, 0) - left_mean;
-        left_sum_sq_dev += dev * dev;
+T Stats::StochasticForests<T>::predict(const num_array<T> &x) const {
+    // Validate input.
+    if(x.num_rows() != 1){
+        throw std::invalid_argument("Input x must be a 1xM matrix (row vector)");
     }
-    const T left_var = left_sum_sq_dev / static_cast<T>(n_left);
-    
-    // Compute variance for right child using same two-pass algorithm.
-    T right_sum = static_cast<T>(0);
-    for(const auto idx : right_indices){
-        right_sum += y.read_coeff(idx, 0);
+    if(this->trees.empty()){
+        throw std::runtime_error("Model has not been fitted yet");
     }
-    const T right_mean = right_sum / static_cast<T>(n_right);
-    
-    T right_sum_sq_dev = static_cast<T>(0);
-    for(const auto idx : right_indices){
-        const T dev = y.read_coeff(idx, 0) - right_mean;
-        right_sum_sq_dev += dev * dev;
+    if(x.num_cols() != this->n_features_trained){
+        throw std::invalid_argument("Input features must match training data features");
     }
-    const T right_var = right_sum_sq_dev / static_cast<T>(n_right);
-    
-    // Compute weighted variance of children (lower is better for splits).
-    const T weighted_child_var = (static_cast<T>(n_left) * left_var + 
-                                  static_cast<T>(n_right) * right_var) / static_cast<T>(n_total);
     
-    // Return negative weighted variance so higher scores are better.
-    return -weighted_child_var;
+    // Average predictions from all trees (ensemble), using the flattened trees.
+    return this->flat_trees.predict(&*x.cbegin(), x.num_cols(), true);
 }
 #ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
-    template double Stats::StochasticForests<double>::compute_variance_reduction(const num_array<double> &,
-                                                                           const std::vector<int64_t> &,
-                                                                           const std::vector<int64_t> &);
-    template float Stats::StochasticForests<float>::compute_variance_reduction(const num_array<float> &,
-                                                                         const std::vector<int64_t> &,
-                                                                         const std::vector<int64_t> &);
+    template double Stats::StochasticForests<double>::predict(const num_array<double> &) const;
+    template float Stats::StochasticForests<float>::predict(const num_array<float> &) const;
 #endif
 
 
 template <class T>
-T Stats::StochasticForests<T>::predict(const num_array<T> &x) const {
-    // Validate input.
-    if(x.num_rows() != 1){
-        throw std::invalid_argument("Input x must be a 1xM matrix (row vector)");
-    }
+num_array<T> Stats::StochasticForests<T>::predict_batch(const num_array<T> &X) const {
     if(this->trees.empty()){
         throw std::runtime_error("Model has not been fitted yet");
     }
-    if(x.num_cols() != this->n_features_trained){
+    if(X.num_cols() != this->n_features_trained){
         throw std::invalid_argument("Input features must match training data features");
     }
-    
-    // Average predictions from all trees (ensemble).
-    T sum = static_cast<T>(0);
+    return this->flat_trees.predict_batch(X, true, this->n_threads);
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template num_array<double> Stats::StochasticForests<double>::predict_batch(const num_array<double> &) const;
+    template num_array<float> Stats::StochasticForests<float>::predict_batch(const num_array<float> &) const;
+#endif
+
+
+template <class T>
+void Stats::StochasticForests<T>::compile_trees() {
+    this->flat_trees.clear();
     for(const auto &tree : this->trees){
-        sum += predict_tree(tree.get(), x);
+        this->flat_trees.add_tree(tree.get());
     }
-    
-    return sum / static_cast<T>(this->trees.size());
+    return;
 }
 #ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
-    template double Stats::StochasticForests<double>::predict(const num_array<double> &) const;
-    template float Stats::StochasticForests<float>::predict(const num_array<float> &) const;
+    template void Stats::StochasticForests<double>::compile_trees();
+    template void Stats::StochasticForests<float>::compile_trees();
 #endif
 
 
@@ -450,6 +720,46 @@ int64_t Stats::StochasticForests<T>::get_n_trees() const {
 #endif
 
 
+template <class T>
+void Stats::StochasticForests<T>::set_n_threads(int64_t n) {
+    this->n_threads = n;
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::StochasticForests<double>::set_n_threads(int64_t);
+    template void Stats::StochasticForests<float>::set_n_threads(int64_t);
+#endif
+
+
+template <class T>
+int64_t Stats::StochasticForests<T>::get_n_threads() const {
+    return this->n_threads;
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template int64_t Stats::StochasticForests<double>::get_n_threads() const;
+    template int64_t Stats::StochasticForests<float>::get_n_threads() const;
+#endif
+
+
+template <class T>
+void Stats::StochasticForests<T>::set_split_method(Stats::SplitMethod method) {
+    this->split_method = method;
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template void Stats::StochasticForests<double>::set_split_method(Stats::SplitMethod);
+    template void Stats::StochasticForests<float>::set_split_method(Stats::SplitMethod);
+#endif
+
+
+template <class T>
+Stats::SplitMethod Stats::StochasticForests<T>::get_split_method() const {
+    return this->split_method;
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template Stats::SplitMethod Stats::StochasticForests<double>::get_split_method() const;
+    template Stats::SplitMethod Stats::StochasticForests<float>::get_split_method() const;
+#endif
+
+
 template <class T>
 void Stats::StochasticForests<T>::set_importance_method(Stats::ImportanceMethod method) {
     // According to the documentation, this must be called before fit().
@@ -798,6 +1108,7 @@ bool Stats::StochasticForests<T>::read_from(std::istream &is) {
     if(n_actual_trees < 0 || n_actual_trees > 1'000'000) return false;
     
     this->trees.clear();
+    this->flat_trees.clear();
     this->trees.reserve(n_actual_trees);
     for(int64_t t = 0; t < n_actual_trees; ++t){
         int64_t tree_idx;
@@ -811,6 +1122,7 @@ bool Stats::StochasticForests<T>::read_from(std::istream &is) {
         is >> label;
         if(is.fail() || label != "end_tree") return false;
     }
+    this->compile_trees();
 
     // Validate invariants between the deserialized data and the model configuration.
     // The number of serialized trees must match the configured forest size.
@@ -835,4 +1147,104 @@ bool Stats::StochasticForests<T>::read_from(std::istream &is) {
 #ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
     template bool Stats::StochasticForests<double>::read_from(std::istream &);
     template bool Stats::StochasticForests<float>::read_from(std::istream &);
-#endif
\ No newline at end of file
+#endif
+
+
+template <class T>
+bool Stats::StochasticForests<T>::write_binary(std::ostream &os) const {
+    if(this->trees.empty() || (this->n_features_trained <= 0)){
+        return false;
+    }
+    BinaryModelSection s;
+    s.put(this->n_trees);
+    s.put(this->max_depth);
+    s.put(this->min_samples_split);
+    s.put(this->max_features);
+    s.put(this->random_seed);
+    s.put(static_cast<int32_t>(this->importance_method));
+    s.put(this->feature_importances);
+    s.put(static_cast<uint64_t>(this->oob_indices_per_tree.size()));
+    for(const auto &oob : this->oob_indices_per_tree){
+        s.put(oob);
+    }
+    s.put(this->gini_importances_raw);
+    return this->flat_trees.write_binary(os, BinaryModelKind::stochastic_forests, this->n_features_trained, s.str());
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::StochasticForests<double>::write_binary(std::ostream &) const;
+    template bool Stats::StochasticForests<float>::write_binary(std::ostream &) const;
+#endif
+
+
+template <class T>
+bool Stats::StochasticForests<T>::read_binary(std::istream &is) {
+    try{
+    FlatForest<T> flat;
+    int64_t n_features = 0;
+    std::string bytes;
+    if(!flat.read_binary(is, BinaryModelKind::stochastic_forests, n_features, bytes)) return false;
+
+    // Read parameters and auxiliary data.
+    BinaryModelSection s(bytes);
+    int64_t l_n_trees = 0;
+    int64_t l_max_depth = 0;
+    int64_t l_min_samples_split = 0;
+    int64_t l_max_features = 0;
+    uint64_t l_random_seed = 0;
+    int32_t imp_method_int = 0;
+    std::vector<T> l_feature_importances;
+    uint64_t n_oob_sets = 0;
+    std::vector<std::vector<int64_t>> l_oob_indices_per_tree;
+    std::vector<T> l_gini_importances_raw;
+    if( !s.get(l_n_trees)
+    ||  !s.get(l_max_depth)
+    ||  !s.get(l_min_samples_split)
+    ||  !s.get(l_max_features)
+    ||  !s.get(l_random_seed)
+    ||  !s.get(imp_method_int)
+    ||  !s.get(l_feature_importances)
+    ||  !s.get(n_oob_sets) ) return false;
+    if(1'000'000 < n_oob_sets) return false;
+    l_oob_indices_per_tree.resize(n_oob_sets);
+    for(auto &oob : l_oob_indices_per_tree){
+        if(!s.get(oob)) return false;
+    }
+    if( !s.get(l_gini_importances_raw)
+    ||  !s.at_end() ) return false;
+
+    // Validate invariants, as read_from() does.
+    if(imp_method_int < 0 || imp_method_int > 2) return false;
+    const auto l_importance_method = static_cast<ImportanceMethod>(imp_method_int);
+    if(n_features <= 0) return false;
+    if(l_n_trees != flat.get_n_trees()) return false;
+    if( (l_importance_method == ImportanceMethod::permutation)
+    &&  (static_cast<int64_t>(l_oob_indices_per_tree.size()) != l_n_trees) ) return false;
+
+    std::vector<std::unique_ptr<TreeNode>> l_trees;
+    l_trees.reserve(l_n_trees);
+    for(int64_t t = 0; t < l_n_trees; ++t){
+        l_trees.push_back(flat.template expand_tree<TreeNode>(t));
+    }
+
+    this->n_trees = l_n_trees;
+    this->max_depth = l_max_depth;
+    this->min_samples_split = l_min_samples_split;
+    this->max_features = l_max_features;
+    this->n_features_trained = n_features;
+    this->random_seed = l_random_seed;
+    this->importance_method = l_importance_method;
+    this->feature_importances = std::move(l_feature_importances);
+    this->oob_indices_per_tree = std::move(l_oob_indices_per_tree);
+    this->gini_importances_raw = std::move(l_gini_importances_raw);
+    this->trees = std::move(l_trees);
+    this->flat_trees = std::move(flat);
+    return true;
+
+    }catch(const std::exception &){
+        return false;
+    }
+}
+#ifndef YGOR_STATS_STOCHASTIC_FORESTS_DISABLE_ALL_SPECIALIZATIONS
+    template bool Stats::StochasticForests<double>::read_binary(std::istream &);
+    template bool Stats::StochasticForests<float>::read_binary(std::istream &);
+#endif
@@ -15,9 +15,11 @@
 #include <vector>
 #include <random>
 #include <memory>
+#include <utility>
 
 #include "YgorDefinitions.h"
 #include "YgorMath.h"
+#include "YgorStatsFlatTrees.h"
 
 namespace Stats {
 
@@ -46,6 +48,25 @@ namespace Stats {
 //
 enum class ImportanceMethod : int { none = 0, gini = 1, permutation = 2 };
 
+// Split finding method for StochasticForests.
+//
+// Two options are available:
+//
+//   exact:       Every threshold between consecutive distinct feature values is considered
+//                (default). Features are presorted once per fit, so large nodes are visited in
+//                sorted order without sorting, and only small nodes are sorted directly. All
+//                thresholds of a feature are then evaluated in a single pass using running sums.
+//
+//   histogram:   Each feature is quantized once per fit into at most 256 quantile bins, stored
+//                as uint8_t columns, and only thresholds between bins are considered. Nodes are
+//                split by accumulating per-bin statistics. When most features are considered at
+//                each split, the histograms of the larger child are derived by subtracting those
+//                of the smaller child from the parent's. Features with no more than 256
+//                distinct values are binned losslessly, so exactly the same thresholds as the
+//                exact method are considered.
+//
+enum class SplitMethod : int { exact = 0, histogram = 1 };
+
 //-----------------------------------------------------------------------------------------------------------
 //--------------------------------------- Stochastic Forest Regressor ---------------------------------------
 //-----------------------------------------------------------------------------------------------------------
@@ -77,53 +98,100 @@ class StochasticForests {
         };
 
         std::vector<std::unique_ptr<TreeNode>> trees;  // Ensemble of decision trees.
+        FlatForest<T> flat_trees;     // Flattened copy of the trees, for batch prediction.
         int64_t n_trees;              // Number of trees in the forest.
         int64_t max_depth;            // Maximum depth of each tree.
         int64_t min_samples_split;    // Minimum samples required to split a node.
         int64_t max_features;         // Number of features to consider for each split.
         int64_t n_features_trained;   // Number of features the model was trained on (for validation).
         uint64_t random_seed;         // Random seed for reproducibility.
+        int64_t n_threads;            // Number of threads for fitting and batch prediction. Zero uses all hardware threads.
+        SplitMethod split_method;     // Split finding method.
 
         ImportanceMethod importance_method; // Variable importance method.
         std::vector<T> feature_importances; // Computed feature importances.
         std::vector<std::vector<int64_t>> oob_indices_per_tree; // OOB sample indices per tree (for permutation).
         std::vector<T> gini_importances_raw; // Raw accumulated Gini impurity decreases per feature.
         
+        // Per-bin statistics for the histogram split method.
+        struct BinStats {
+            int64_t count;
+            T sum;                    // Sum of the (centred) outputs.
+        };
+        using Histograms = std::vector<BinStats>;  // 256 bins for each feature.
+
+        // Training data and derived structures, prepared once per fit() and shared by all trees.
+        struct TrainingContext {
+            const num_array<T> *X;
+            const num_array<T> *y;
+            int64_t n_samples;
+            int64_t n_features;
+            int64_t effective_max_features;
+            std::vector<T> y_centred;                  // Outputs less their mean, keeping running sums well-conditioned.
+
+            // Exact method: sample indices and feature values for each feature, ordered by value.
+            std::vector<std::vector<uint32_t>> sorted_indices;
+            std::vector<std::vector<T>> sorted_values;
+
+            // Histogram method: the bin of each sample for each feature, and the threshold that separates each bin
+            // from the next.
+            std::vector<std::vector<uint8_t>> bins;
+            std::vector<std::vector<T>> bin_thresholds;
+            bool subtract_histograms;                  // Whether nodes carry histograms for every feature.
+        };
+
+        // Scratch storage reused by all nodes of a single tree.
+        struct TreeScratch {
+            std::vector<int64_t> feature_indices;
+            std::vector<uint32_t> multiplicity;        // Number of times each sample appears in the current node.
+            std::vector<std::pair<T, T>> pairs;        // (feature value, centred output) pairs.
+            Histograms histograms;
+        };
+
+        // Quantize a feature for the histogram split method.
+        void bin_feature(TrainingContext &ctx, int64_t feature) const;
+
+        // Compute the histograms of every feature for the given samples.
+        void fill_histograms(const TrainingContext &ctx, const std::vector<int64_t> &sample_indices,
+                             Histograms &h) const;
+
         // Build a single decision tree using bootstrap sampling.
+        //
+        // If provided, weighted impurity decreases are accumulated per feature into gini_accumulator. Trees do not
+        // modify any shared state, so multiple trees can be built concurrently. When histogram subtraction is used,
+        // histograms holds the histograms of this node (or is empty if they have not been computed).
         std::unique_ptr<TreeNode> build_tree(
-            const num_array<T> &X,
-            const num_array<T> &y,
+            const TrainingContext &ctx,
+            TreeScratch &scratch,
             const std::vector<int64_t> &sample_indices,
             int64_t depth,
-            int64_t effective_max_features,
-            std::mt19937_64 &rng
+            std::mt19937_64 &rng,
+            std::vector<T> *gini_accumulator,
+            Histograms histograms
         );
-        
+
         // Find the best split for a node using random feature selection.
-        // Returns the split indices along with the best split parameters.
+        //
+        // The best score is the negated weighted variance of the children. For the histogram method, the best bin is
+        // also provided; samples in bins up to and including it go left.
         bool find_best_split(
-            const num_array<T> &X,
-            const num_array<T> &y,
+            const TrainingContext &ctx,
+            TreeScratch &scratch,
             const std::vector<int64_t> &sample_indices,
-            int64_t effective_max_features,
+            const Histograms &histograms,
             int64_t &best_feature,
             T &best_threshold,
+            int64_t &best_bin,
             T &best_score,
-            std::vector<int64_t> &left_indices,
-            std::vector<int64_t> &right_indices,
             std::mt19937_64 &rng
         );
         
-        // Compute variance reduction (impurity) for regression.
-        T compute_variance_reduction(
-            const num_array<T> &y,
-            const std::vector<int64_t> &left_indices,
-            const std::vector<int64_t> &right_indices
-        );
-        
         // Predict using a single tree.
         T predict_tree(const TreeNode *node, const num_array<T> &x) const;
 
+        // Rebuild the flattened copy of the trees. Called whenever the trees change.
+        void compile_trees();
+
         // Serialization helpers.
         bool write_tree_node(std::ostream &os, const TreeNode *node) const;
         std::unique_ptr<TreeNode> read_tree_node(std::istream &is);
@@ -152,6 +220,11 @@ class StochasticForests {
         // of the training data, and at each split, only a random subset of features is
         // considered (feature randomness).
         //
+        // Trees are built concurrently (see set_n_threads()). Each tree draws from its own
+        // random number stream derived from the random seed and the tree's index, and
+        // per-tree results are combined in tree order, so the fitted model is identical
+        // regardless of the number of threads.
+        //
         // If the importance method is set to gini, impurity decreases are accumulated during
         // tree building and Gini importances are available via get_feature_importances() after
         // this call returns. If the importance method is set to permutation, out-of-bag sample
@@ -179,10 +252,44 @@ class StochasticForests {
         //   std::invalid_argument if x is not a row vector or has wrong number of features.
         //   std::runtime_error if model has not been fitted yet.
         T predict(const num_array<T> &x) const;
+
+        // Predict scalar outputs for many samples at once.
+        //
+        // Equivalent to calling predict() on each row of X, and the results are bit-identical, but
+        // much faster for large inputs: trees are evaluated from a flattened, contiguous form, rows
+        // are processed in cache-sized blocks, and blocks are distributed over threads (see set_n_threads()).
+        //
+        // Parameters:
+        //   X: NxM matrix of input features (M must match the number of features used in fit()).
+        //
+        // Returns:
+        //   Nx1 matrix of predicted values.
+        //
+        // Throws:
+        //   std::invalid_argument if X has the wrong number of features.
+        //   std::runtime_error if model has not been fitted yet.
+        num_array<T> predict_batch(const num_array<T> &X) const;
         
         // Get number of trees in the forest.
         int64_t get_n_trees() const;
 
+        // Set the number of threads used to build trees during fit() and by predict_batch().
+        //
+        // If <= 0, all available hardware threads are used (default). Neither the fitted model nor
+        // the predictions depend on the number of threads.
+        void set_n_threads(int64_t n);
+
+        // Get the number of threads used by fit() and predict_batch().
+        int64_t get_n_threads() const;
+
+        // Set the split finding method.
+        //
+        // Must be called before fit(). If not called, defaults to SplitMethod::exact.
+        void set_split_method(SplitMethod method);
+
+        // Get the split finding method.
+        SplitMethod get_split_method() const;
+
         // Set the variable importance estimation method.
         //
         // Must be called before fit(). If not called, defaults to ImportanceMethod::none.
@@ -245,6 +352,31 @@ class StochasticForests {
         // Returns:
         //   true on success, false if the stream format is invalid or enters a fail state.
         bool read_from(std::istream &is);
+
+        // Write the model in the binary model format (see YgorStatsFlatTrees.h).
+        //
+        // The binary format holds the same information as write_to(), but loads much faster since
+        // the trees are stored as flattened node arrays that are read in bulk rather than parsed.
+        // Binary models are specific to the floating-point type and byte order of the writer.
+        //
+        // Parameters:
+        //   os: Output stream to write to. Should be opened in binary mode.
+        //
+        // Returns:
+        //   true on success, false if the model has not been fitted or the stream enters a fail state.
+        bool write_binary(std::ostream &os) const;
+
+        // Read a model from a binary stream.
+        //
+        // Restores a model previously written by write_binary(). The model is only modified if
+        // reading succeeds. Use Stats::is_binary_model() to distinguish binary and text models.
+        //
+        // Parameters:
+        //   is: Input stream to read from. Should be opened in binary mode.
+        //
+        // Returns:
+        //   true on success, false if the stream does not hold a valid binary model of this kind.
+        bool read_binary(std::istream &is);
 };
 
 } //namespace Stats.
@@ -7,7 +7,12 @@
 #include <thread>
 #include <atomic>
 #include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <list>
+#include <stdexcept>
+#include <vector>
 
 
 // Multi-threaded work queue for offloading processing tasks.
@@ -145,3 +150,119 @@ class work_queue {
 };
 
 
+// Parallel reduction over the index range [0, count).
+//
+// The range is split into consecutive chunks of chunk_size indices (the last may be shorter). Each chunk is
+// accumulated into its own copy of 'init' by calling 'accumulate(acc, first, last)' for the chunk's range
+// [first, last), and the chunk accumulators are then combined in chunk order by calling 'merge(acc, chunk_acc)'.
+// Chunks are distributed over up to n_workers threads (including the calling thread); if n_workers <= 0, all
+// available hardware threads are used. Since every chunk starts from a copy of it, 'init' should normally be an empty
+// accumulator.
+//
+// Since the chunks and the order in which they are merged do not depend on the number of threads, neither does the
+// result. Accumulators like Stats::Running_Variance, which provide Digest() and Merge(), are intended to be used as:
+//
+//     const auto rv = parallel_reduce(data.size(), 65536, Stats::Running_Variance<double>(),
+//         [&](auto &acc, int64_t first, int64_t last){ acc.Digest(data.data() + first, data.data() + last); },
+//         [](auto &acc, const auto &other){ acc.Merge(other); });
+//
+// The first exception thrown by 'accumulate' (in chunk order) is rethrown after all chunks have finished.
+//
+template <class A, class Accumulate, class Merge>
+A parallel_reduce(int64_t count,
+                  int64_t chunk_size,
+                  const A &init,
+                  Accumulate accumulate,
+                  Merge merge,
+                  int64_t n_workers = 0){
+    if(chunk_size <= 0){
+        throw std::invalid_argument("Chunk size must be positive");
+    }
+    if(count <= 0) return init;
+
+    const int64_t n_chunks = (count + chunk_size - 1) / chunk_size;
+    if(n_workers <= 0){
+        n_workers = std::max<int64_t>(1, static_cast<int64_t>(std::thread::hardware_concurrency()));
+    }
+    n_workers = std::min(n_workers, n_chunks);
+
+    std::vector<A> accs(n_chunks, init);
+    std::vector<std::exception_ptr> errors(n_chunks);
+    std::atomic<int64_t> next_chunk(0);
+    const auto work = [&](){
+        for(int64_t c = next_chunk++; c < n_chunks; c = next_chunk++){
+            try{
+                const int64_t first = c * chunk_size;
+                const int64_t last = std::min(count, first + chunk_size);
+                accumulate(accs[c], first, last);
+            }catch(...){
+                errors[c] = std::current_exception();
+            }
+        }
+    };
+
+    if(n_workers == 1){
+        work();
+    }else{
+        std::mutex m;
+        std::condition_variable cv;
+        int64_t pending = n_workers - 1;
+        {
+            work_queue<std::function<void(void)>> wq(static_cast<unsigned int>(n_workers - 1));
+            for(int64_t w = 1; w < n_workers; ++w){
+                wq.submit_task([&](){
+                    work();
+                    std::lock_guard<std::mutex> lock(m);
+                    --pending;
+                    cv.notify_all();
+                });
+            }
+            work();
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&](){ return (pending == 0); });
+        }
+    }
+
+    for(const auto &e : errors){
+        if(e) std::rethrow_exception(e);
+    }
+    A out = accs.front();
+    for(int64_t c = 1; c < n_chunks; ++c){
+        merge(out, accs[c]);
+    }
+    return out;
+}
+
+
+// Parallel evaluation over the index range [0, count), returning eval(scratch, k) for each index k in order.
+//
+// Each chunk of indices is evaluated with its own copy 'scratch' of 'scratch_init', which eval may modify, e.g., to
+// perturb a parameter vector in-place rather than copying it for every evaluation. Indices are distributed over up to
+// n_workers threads (including the calling thread); if n_workers <= 0, all available hardware threads are used.
+// The results are ordered by index, so they do not depend on the number of threads as long as eval(scratch, k)
+// depends only on k; eval must therefore restore any changes it makes to scratch before returning.
+//
+// The first exception thrown by eval (in index order) is rethrown after all indices have finished.
+//
+template <class T, class S, class Eval>
+std::vector<T> parallel_evaluate(int64_t count,
+                                 const S &scratch_init,
+                                 Eval eval,
+                                 int64_t n_workers = 0){
+    if(n_workers <= 0){
+        n_workers = std::max<int64_t>(1, static_cast<int64_t>(std::thread::hardware_concurrency()));
+    }
+    const int64_t chunk_size = std::max<int64_t>(1, count / (4 * n_workers));
+    return parallel_reduce(count, chunk_size, std::vector<T>(),
+        [&](std::vector<T> &acc, int64_t first, int64_t last){
+            S scratch(scratch_init);
+            acc.reserve(static_cast<size_t>(last - first));
+            for(int64_t k = first; k < last; ++k){
+                acc.push_back(eval(scratch, k));
+            }
+        },
+        [](std::vector<T> &acc, const std::vector<T> &other){
+            acc.insert(std::end(acc), std::begin(other), std::end(other));
+        },
+        n_workers);
+}
@@ -0,0 +1,130 @@
+// Benchmark of mesh_bvh closest-point, ray-cast, and signed-distance queries against a brute-force scan over faces.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <YgorMath.h>
+#include <YgorIndexBVH.h>
+
+
+static fv_surface_mesh<double, uint64_t> make_uv_sphere(double radius, int64_t N_rings, int64_t N_segs){
+    fv_surface_mesh<double, uint64_t> mesh;
+    const double pi = std::acos(-1.0);
+    mesh.vertices.emplace_back(0.0, 0.0, -radius);
+    for(int64_t r = 1; r < N_rings; ++r){
+        const double theta = pi * static_cast<double>(r) / static_cast<double>(N_rings);
+        for(int64_t s = 0; s < N_segs; ++s){
+            const double phi = 2.0 * pi * static_cast<double>(s) / static_cast<double>(N_segs);
+            mesh.vertices.emplace_back( radius * std::sin(theta) * std::cos(phi),
+                                        radius * std::sin(theta) * std::sin(phi),
+                                       -radius * std::cos(theta) );
+        }
+    }
+    mesh.vertices.emplace_back(0.0, 0.0, radius);
+    const auto ring_vert = [&](int64_t r, int64_t s) -> uint64_t {
+        return static_cast<uint64_t>(1 + (r - 1) * N_segs + (s % N_segs));
+    };
+    const auto top = static_cast<uint64_t>(mesh.vertices.size() - 1);
+    for(int64_t s = 0; s < N_segs; ++s){
+        mesh.faces.push_back({ 0UL, ring_vert(1, s + 1), ring_vert(1, s) });
+        mesh.faces.push_back({ top, ring_vert(N_rings - 1, s), ring_vert(N_rings - 1, s + 1) });
+        for(int64_t r = 1; r < (N_rings - 1); ++r){
+            mesh.faces.push_back({ ring_vert(r, s), ring_vert(r, s + 1), ring_vert(r + 1, s + 1) });
+            mesh.faces.push_back({ ring_vert(r, s), ring_vert(r + 1, s + 1), ring_vert(r + 1, s) });
+        }
+    }
+    return mesh;
+}
+
+// Brute-force closest distance computed independently (projection onto each face plane, otherwise the nearest edge).
+static double brute_force_distance(const fv_surface_mesh<double, uint64_t> &mesh, const vec3<double> &p){
+    double best = std::numeric_limits<double>::infinity();
+    for(const auto &f : mesh.faces){
+        const auto &a = mesh.vertices[f[0]];
+        const auto &b = mesh.vertices[f[1]];
+        const auto &c = mesh.vertices[f[2]];
+        const auto ab = b - a;
+        const auto ac = c - a;
+        const auto n = ab.Cross(ac).unit();
+        const auto q = p - n * n.Dot(p - a);
+
+        // Barycentric test for the projected point, otherwise the nearest edge.
+        const auto v0 = ab; const auto v1 = ac; const auto v2 = q - a;
+        const double d00 = v0.Dot(v0), d01 = v0.Dot(v1), d11 = v1.Dot(v1), d20 = v2.Dot(v0), d21 = v2.Dot(v1);
+        const double denom = d00 * d11 - d01 * d01;
+        const double v = (d11 * d20 - d01 * d21) / denom;
+        const double w = (d00 * d21 - d01 * d20) / denom;
+        double d = std::numeric_limits<double>::infinity();
+        if( (0.0 <= v) && (0.0 <= w) && ((v + w) <= 1.0) ){
+            d = q.distance(p);
+        }else{
+            d = std::min({ line_segment<double>(a, b).Closest_Point_To(p).distance(p),
+                           line_segment<double>(b, c).Closest_Point_To(p).distance(p),
+                           line_segment<double>(c, a).Closest_Point_To(p).distance(p) });
+        }
+        best = std::min(best, d);
+    }
+    return best;
+}
+
+template <class F>
+static double time_ms(F f){
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+int main(int, char **){
+    std::mt19937 re(123456);
+    std::uniform_real_distribution<double> rd(-1.5, 1.5);
+
+    for(const int64_t N_rings : { 32, 128, 512 }){
+        const auto mesh = make_uv_sphere(1.0, N_rings, 2 * N_rings);
+
+        std::vector<vec3<double>> points;
+        for(size_t i = 0; i < 2000; ++i) points.emplace_back(rd(re), rd(re), rd(re));
+
+        mesh_bvh<double, uint64_t> bvh;
+        const auto build_ms = time_ms([&](){ bvh.build(mesh); });
+
+        std::vector<double> bvh_d(points.size());
+        const auto bvh_ms = time_ms([&](){
+            for(size_t i = 0; i < points.size(); ++i) bvh_d[i] = bvh.closest_point(points[i])->distance;
+        });
+
+        std::vector<double> batch_sd;
+        const auto batch_ms = time_ms([&](){ batch_sd = bvh.signed_distances(points); });
+
+        size_t hits = 0;
+        const auto ray_ms = time_ms([&](){
+            for(const auto &p : points) hits += (bvh.ray_cast(p, vec3<double>(0.3, -0.5, 0.8)) ? 1 : 0);
+        });
+
+        // Brute force is slow, so only evaluate a subset.
+        const size_t N_bf = std::min<size_t>(points.size(), 50);
+        double max_err = 0.0;
+        const auto bf_ms = time_ms([&](){
+            for(size_t i = 0; i < N_bf; ++i){
+                max_err = std::max(max_err, std::abs(brute_force_distance(mesh, points[i]) - bvh_d[i]));
+            }
+        });
+
+        std::cout << "faces = " << mesh.faces.size()
+                  << ", nodes = " << bvh.get_nodes().size()
+                  << ", build = " << build_ms << " ms"
+                  << ", closest point = " << (1000.0 * bvh_ms / points.size()) << " us/query"
+                  << ", batched signed distance = " << (1000.0 * batch_ms / points.size()) << " us/query"
+                  << ", ray cast = " << (1000.0 * ray_ms / points.size()) << " us/query (" << hits << " hits)"
+                  << ", brute force = " << (1000.0 * bf_ms / N_bf) << " us/query"
+                  << ", max |difference| = " << max_err
+                  << std::endl;
+    }
+    return 0;
+}
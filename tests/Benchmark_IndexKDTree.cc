@@ -0,0 +1,191 @@
+// Benchmark of kdtree build time and kNN/radius query latency against a node-per-entry, pointer-based kd-tree, and of
+// query throughput with concurrent readers.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <YgorMath.h>
+#include <YgorIndex.h>
+#include <YgorIndexKDTree.h>
+
+
+// A kd-tree with one heap-allocated node per entry, which alternates split axes. This mirrors the previous kdtree
+// implementation and serves as a baseline.
+struct pointer_kdtree {
+    struct node {
+        index_entry<double> data;
+        int axis = 0;
+        index_bbox<double> bounds;
+        std::unique_ptr<node> left;
+        std::unique_ptr<node> right;
+    };
+    std::unique_ptr<node> root;
+
+    static double coord(const vec3<double> &p, int axis){
+        return (axis == 0) ? p.x : ((axis == 1) ? p.y : p.z);
+    }
+
+    std::unique_ptr<node> build(std::vector<index_entry<double>> &entries, size_t begin, size_t end, int depth){
+        if(begin >= end) return nullptr;
+        const int axis = depth % 3;
+        const size_t mid = begin + (end - begin) / 2;
+        std::nth_element(entries.begin() + begin, entries.begin() + mid, entries.begin() + end,
+                         [axis](const index_entry<double> &a, const index_entry<double> &b){
+                             return coord(a.box.center(), axis) < coord(b.box.center(), axis);
+                         });
+        auto n = std::make_unique<node>();
+        n->data = entries[mid];
+        n->axis = axis;
+        n->bounds = entries[begin].box;
+        for(size_t i = begin + 1; i < end; ++i) n->bounds.expand(entries[i].box);
+        n->left = build(entries, begin, mid, depth + 1);
+        n->right = build(entries, mid + 1, end, depth + 1);
+        return n;
+    }
+
+    void nearest(const node *n, const vec3<double> &q, size_t k, std::vector<std::pair<double, const node*>> &best) const {
+        if(n == nullptr) return;
+        const auto cmp = [](const auto &a, const auto &b){ return a.first < b.first; };
+        if((best.size() == k) && (best.front().first <= n->bounds.squared_distance_to(q))) return;
+        const double d = n->data.box.squared_distance_to(q);
+        if(best.size() < k){
+            best.emplace_back(d, n);
+            std::push_heap(best.begin(), best.end(), cmp);
+        }else if(d < best.front().first){
+            std::pop_heap(best.begin(), best.end(), cmp);
+            best.back() = std::make_pair(d, n);
+            std::push_heap(best.begin(), best.end(), cmp);
+        }
+        const double diff = coord(q, n->axis) - coord(n->data.box.center(), n->axis);
+        const node *near = (diff <= 0.0) ? n->left.get() : n->right.get();
+        const node *far  = (diff <= 0.0) ? n->right.get() : n->left.get();
+        nearest(near, q, k, best);
+        if((best.size() < k) || ((diff * diff) < best.front().first)) nearest(far, q, k, best);
+    }
+
+    void radius(const node *n, const vec3<double> &q, double r_sq, std::vector<index_entry<double>> &out) const {
+        if((n == nullptr) || (r_sq < n->bounds.squared_distance_to(q))) return;
+        if(n->data.box.squared_distance_to(q) <= r_sq) out.push_back(n->data);
+        radius(n->left.get(), q, r_sq, out);
+        radius(n->right.get(), q, r_sq, out);
+    }
+};
+
+template <class F>
+static double time_ms(F f){
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+int main(int, char **){
+    std::mt19937 re(123456);
+    std::uniform_real_distribution<double> rd(0.0, 100.0);
+
+    const size_t N_queries = 20000;
+    const size_t k = 10;
+
+    for(const size_t N : { 10'000UL, 100'000UL, 1'000'000UL }){
+        std::vector<vec3<double>> points;
+        for(size_t i = 0; i < N; ++i) points.emplace_back(rd(re), rd(re), rd(re));
+        std::vector<vec3<double>> queries;
+        for(size_t i = 0; i < N_queries; ++i) queries.emplace_back(rd(re), rd(re), rd(re));
+
+        // Choose a radius that captures roughly 'k' points on average.
+        const double pi = std::acos(-1.0);
+        const double radius = std::cbrt(3.0 * static_cast<double>(k) * 1.0E6 / (4.0 * pi * static_cast<double>(N)));
+
+        // Baseline.
+        pointer_kdtree ref;
+        const auto ref_build_ms = time_ms([&](){
+            std::vector<index_entry<double>> entries;
+            entries.reserve(N);
+            for(size_t i = 0; i < N; ++i) entries.emplace_back(points[i], static_cast<uint64_t>(i));
+            ref.root = ref.build(entries, 0, entries.size(), 0);
+        });
+        size_t ref_checksum = 0;
+        const auto ref_knn_ms = time_ms([&](){
+            std::vector<std::pair<double, const pointer_kdtree::node*>> best;
+            for(const auto &q : queries){
+                best.clear();
+                ref.nearest(ref.root.get(), q, k, best);
+                ref_checksum += best.size();
+            }
+        });
+        size_t ref_found = 0;
+        const auto ref_radius_ms = time_ms([&](){
+            std::vector<index_entry<double>> out;
+            for(const auto &q : queries){
+                out.clear();
+                ref.radius(ref.root.get(), q, radius * radius, out);
+                ref_found += out.size();
+            }
+        });
+
+        for(const size_t leaf_size : { 8UL, 16UL, 32UL }){
+            kdtree<double> tree(leaf_size);
+            const auto build_ms = time_ms([&](){
+                for(size_t i = 0; i < N; ++i) tree.insert(points[i], static_cast<uint64_t>(i));
+                tree.search(tree.get_bounds()); // Force the build.
+            });
+            size_t checksum = 0;
+            const auto knn_ms = time_ms([&](){
+                for(const auto &q : queries) checksum += tree.nearest_neighbors(q, k).size();
+            });
+            size_t found = 0;
+            const auto radius_ms = time_ms([&](){
+                for(const auto &q : queries) found += tree.search_radius(q, radius).size();
+            });
+
+            std::cout << "N = " << N
+                      << ", leaf size = " << leaf_size
+                      << ", build = " << build_ms << " ms (baseline " << ref_build_ms << " ms)"
+                      << ", kNN (k = " << k << ") = " << (1000.0 * knn_ms / N_queries) << " us/query"
+                      << " (baseline " << (1000.0 * ref_knn_ms / N_queries) << ")"
+                      << ", radius = " << (1000.0 * radius_ms / N_queries) << " us/query"
+                      << " (baseline " << (1000.0 * ref_radius_ms / N_queries) << ")"
+                      << ", results agree = " << (((checksum == ref_checksum) && (found == ref_found)) ? "yes" : "no")
+                      << std::endl;
+        }
+    }
+
+    // Concurrent readers on a frozen tree.
+    {
+        const size_t N = 1'000'000;
+        kdtree<double> tree;
+        for(size_t i = 0; i < N; ++i) tree.insert(vec3<double>(rd(re), rd(re), rd(re)));
+        tree.freeze();
+
+        std::vector<vec3<double>> queries;
+        for(size_t i = 0; i < N_queries; ++i) queries.emplace_back(rd(re), rd(re), rd(re));
+
+        const size_t N_hw = std::max<size_t>(1, std::thread::hardware_concurrency());
+        for(size_t N_threads = 1; N_threads <= N_hw; N_threads *= 2){
+            const auto ms = time_ms([&](){
+                std::vector<std::thread> threads;
+                for(size_t t = 0; t < N_threads; ++t){
+                    threads.emplace_back([&](){
+                        size_t found = 0;
+                        for(const auto &q : queries) found += tree.nearest_neighbors_points(q, k).size();
+                        if(found != (k * queries.size())) std::cerr << "Unexpected result count" << std::endl;
+                    });
+                }
+                for(auto &t : threads) t.join();
+            });
+            std::cout << "N = " << N
+                      << ", reader threads = " << N_threads
+                      << ", kNN throughput = " << (static_cast<double>(N_threads * N_queries) / ms) << " queries/ms"
+                      << std::endl;
+        }
+    }
+    return 0;
+}
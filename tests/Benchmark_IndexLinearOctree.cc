@@ -0,0 +1,91 @@
+// Benchmark of linear_octree construction, per-frame rebuilds, and queries against the pointer-based octree.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <YgorMath.h>
+#include <YgorIndexOctree.h>
+#include <YgorIndexLinearOctree.h>
+
+
+template <class F>
+static double time_ms(F f){
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+int main(int, char **){
+    std::mt19937 re(123456);
+    std::uniform_real_distribution<double> rd(0.0, 100.0);
+    std::normal_distribution<double> rn(0.0, 0.1);
+
+    for(const size_t N : { 100'000, 1'000'000, 10'000'000 }){
+        std::vector<vec3<double>> points;
+        points.reserve(N);
+        for(size_t i = 0; i < N; ++i) points.emplace_back(rd(re), rd(re), rd(re));
+
+        std::vector<vec3<double>> queries;
+        for(size_t i = 0; i < 10'000; ++i) queries.emplace_back(rd(re), rd(re), rd(re));
+
+        linear_octree<double, uint32_t> lin(16);
+        const auto build_ms = time_ms([&](){ lin.build(points); });
+
+        // Jitter the points and rebuild, as would be done every frame for a dynamic point set.
+        for(auto &p : points) p += vec3<double>(rn(re), rn(re), rn(re));
+        const auto rebuild_ms = time_ms([&](){ lin.build(points); });
+
+        size_t found = 0;
+        const auto radius_ms = time_ms([&](){
+            for(const auto &q : queries){
+                lin.search_radius(q, 2.0, [&](const linear_octree<double, uint32_t>::entry &){
+                    ++found;
+                    return true;
+                });
+            }
+        });
+        const auto knn_ms = time_ms([&](){
+            for(const auto &q : queries) found += lin.nearest_neighbors(q, 10).size();
+        });
+
+        std::cout << "N = " << N
+                  << ", linear_octree: build = " << build_ms << " ms"
+                  << ", rebuild = " << rebuild_ms << " ms"
+                  << ", nodes = " << lin.get_nodes().size()
+                  << ", radius query = " << (1000.0 * radius_ms / queries.size()) << " us/query"
+                  << ", kNN (k = 10) = " << (1000.0 * knn_ms / queries.size()) << " us/query"
+                  << std::endl;
+
+        // The pointer-based octree is too slow to build for the largest inputs, and its kNN search is exhaustive, so
+        // only a few queries are evaluated.
+        if(N <= 1'000'000){
+            octree<double, uint32_t> ptr(16);
+            const auto ptr_build_ms = time_ms([&](){
+                for(size_t i = 0; i < N; ++i) ptr.insert(points[i], static_cast<uint32_t>(i));
+            });
+            const auto ptr_radius_ms = time_ms([&](){
+                for(const auto &q : queries){
+                    ptr.search_radius(q, 2.0, [&](const octree<double, uint32_t>::entry &){
+                        ++found;
+                        return true;
+                    });
+                }
+            });
+            const size_t N_knn = 100;
+            const auto ptr_knn_ms = time_ms([&](){
+                for(size_t i = 0; i < N_knn; ++i) found += ptr.nearest_neighbors(queries[i], 10).size();
+            });
+            std::cout << "N = " << N
+                      << ", octree: build = " << ptr_build_ms << " ms"
+                      << ", radius query = " << (1000.0 * ptr_radius_ms / queries.size()) << " us/query"
+                      << ", kNN (k = 10) = " << (1000.0 * ptr_knn_ms / N_knn) << " us/query"
+                      << std::endl;
+        }
+        if(found == 0) std::cout << "(no results)" << std::endl;
+    }
+    return 0;
+}
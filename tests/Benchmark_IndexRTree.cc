@@ -0,0 +1,101 @@
+// Benchmark of rtree construction by repeated insertion versus bulk loading, and of queries on the resulting trees.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <YgorMath.h>
+#include <YgorIndexRTree.h>
+
+
+using tree_t = rtree<double, uint64_t>;
+
+// Small randomly-oriented boxes resembling the bounding boxes of triangles on a surface.
+static std::vector<tree_t::entry> make_entries(size_t N, std::mt19937 &re){
+    std::uniform_real_distribution<double> rd(0.0, 100.0);
+    std::uniform_real_distribution<double> rs(0.0, 0.2);
+    std::vector<tree_t::entry> entries;
+    entries.reserve(N);
+    for(size_t i = 0; i < N; ++i){
+        const vec3<double> p(rd(re), rd(re), rd(re));
+        const vec3<double> s(rs(re), rs(re), rs(re));
+        entries.emplace_back(tree_t::bbox(p, p + s), static_cast<uint64_t>(i));
+    }
+    return entries;
+}
+
+template <class F>
+static double time_ms(F f){
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+int main(int, char **){
+    std::mt19937 re(123456);
+    std::uniform_real_distribution<double> rd(0.0, 100.0);
+
+    for(const size_t N : { 10'000, 100'000, 1'000'000 }){
+        const auto entries = make_entries(N, re);
+
+        std::vector<tree_t::bbox> queries;
+        for(size_t i = 0; i < 10'000; ++i){
+            const vec3<double> p(rd(re), rd(re), rd(re));
+            queries.emplace_back(p, p + vec3<double>(2.0, 2.0, 2.0));
+        }
+
+        const auto report = [&](const std::string &name, const tree_t &tree, double build_ms){
+            size_t found = 0;
+            const auto query_ms = time_ms([&](){
+                for(const auto &q : queries){
+                    tree.search(q, [&](const tree_t::entry &){
+                        ++found;
+                        return true;
+                    });
+                }
+            });
+            size_t in_radius = 0;
+            const auto radius_ms = time_ms([&](){
+                for(const auto &q : queries){
+                    tree.search_radius(q.min, 1.5, [&](const tree_t::entry &){
+                        ++in_radius;
+                        return true;
+                    });
+                }
+            });
+            std::cout << "N = " << N
+                      << ", " << name
+                      << ", build = " << build_ms << " ms"
+                      << ", height = " << tree.get_height()
+                      << ", box query = " << (1000.0 * query_ms / queries.size()) << " us/query (" << found << " found)"
+                      << ", radius query = " << (1000.0 * radius_ms / queries.size()) << " us/query (" << in_radius << " found)"
+                      << std::endl;
+        };
+
+        for(const size_t M : { 8, 16, 32 }){
+            // Repeated insertion becomes very slow for large trees and nodes, so only the smaller cases are evaluated.
+            if((N * M) <= 8'000'000){
+                tree_t tree(M);
+                const auto build_ms = time_ms([&](){
+                    for(const auto &e : entries) tree.insert(e.box, e.aux_data);
+                });
+                report("M = " + std::to_string(M) + ", repeated insert", tree, build_ms);
+            }
+            {
+                tree_t tree(M);
+                const auto build_ms = time_ms([&](){ tree.bulk_load(entries, tree_t::bulk_load_method::sort_tile_recursive); });
+                report("M = " + std::to_string(M) + ", STR bulk load", tree, build_ms);
+            }
+            {
+                tree_t tree(M);
+                const auto build_ms = time_ms([&](){ tree.bulk_load(entries, tree_t::bulk_load_method::hilbert); });
+                report("M = " + std::to_string(M) + ", Hilbert bulk load", tree, build_ms);
+            }
+        }
+    }
+    return 0;
+}
@@ -87,3 +87,10 @@ g++ -std=c++17 Test_MeshesBoolean.cc -o test_meshesboolean -lygor -pthread &
 g++ -std=c++17 Test_MeshesBoolean2.cc -o test_meshesboolean2 -lygor -pthread &
 g++ -std=c++17 Test_MeshesBoolean5.cc -o test_meshesboolean5 -lygor -pthread &
 wait
+
+g++ -std=c++17 -O2 Benchmark_IndexBVH.cc -o benchmark_indexbvh -lygor -pthread &
+g++ -std=c++17 -O2 Benchmark_IndexKDTree.cc -o benchmark_indexkdtree -lygor -pthread &
+g++ -std=c++17 -O2 Benchmark_IndexRTree.cc -o benchmark_indexrtree -lygor -pthread &
+g++ -std=c++17 -O2 Benchmark_IndexLinearOctree.cc -o benchmark_indexlinearoctree -lygor -pthread &
+wait
+
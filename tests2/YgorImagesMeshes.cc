@@ -0,0 +1,516 @@
+
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <tuple>
+#include <utility>
+
+#include <YgorMath.h>
+#include <YgorImages.h>
+#include <YgorIndexBVH.h>
+#include <YgorImagesMeshes.h>
+
+#include "doctest/doctest.h"
+
+
+// A UV sphere with the given radius and centre, with outward-facing triangles.
+static fv_surface_mesh<double, uint32_t> make_uv_sphere(const vec3<double> &centre, double radius, int64_t N_rings, int64_t N_segs){
+    fv_surface_mesh<double, uint32_t> mesh;
+    const double pi = std::acos(-1.0);
+    mesh.vertices.emplace_back(centre + vec3<double>(0.0, 0.0, -radius));
+    for(int64_t r = 1; r < N_rings; ++r){
+        const double theta = pi * static_cast<double>(r) / static_cast<double>(N_rings);
+        for(int64_t s = 0; s < N_segs; ++s){
+            const double phi = 2.0 * pi * static_cast<double>(s) / static_cast<double>(N_segs);
+            mesh.vertices.emplace_back(centre + vec3<double>( radius * std::sin(theta) * std::cos(phi),
+                                                              radius * std::sin(theta) * std::sin(phi),
+                                                             -radius * std::cos(theta) ));
+        }
+    }
+    mesh.vertices.emplace_back(centre + vec3<double>(0.0, 0.0, radius));
+    const auto ring_vert = [&](int64_t r, int64_t s) -> uint32_t {
+        return static_cast<uint32_t>(1 + (r - 1) * N_segs + (s % N_segs));
+    };
+    const auto top = static_cast<uint32_t>(mesh.vertices.size() - 1);
+    for(int64_t s = 0; s < N_segs; ++s){
+        mesh.faces.push_back({ 0U, ring_vert(1, s + 1), ring_vert(1, s) });
+        mesh.faces.push_back({ top, ring_vert(N_rings - 1, s), ring_vert(N_rings - 1, s + 1) });
+        for(int64_t r = 1; r < (N_rings - 1); ++r){
+            mesh.faces.push_back({ ring_vert(r, s), ring_vert(r, s + 1), ring_vert(r + 1, s + 1) });
+            mesh.faces.push_back({ ring_vert(r, s), ring_vert(r + 1, s + 1), ring_vert(r + 1, s) });
+        }
+    }
+    return mesh;
+}
+
+// A regular grid of images. Images are deliberately inserted in reverse order.
+static planar_image_collection<float, double> make_grid(int64_t rows, int64_t cols, int64_t imgs, int64_t chnls,
+                                                        double dx, double dy, double dz){
+    planar_image_collection<float, double> coll;
+    for(int64_t k = imgs - 1; 0 <= k; --k){
+        coll.images.emplace_back();
+        auto &img = coll.images.back();
+        img.init_buffer(rows, cols, chnls);
+        img.init_spatial(dx, dy, dz, vec3<double>(0.0, 0.0, 0.0), vec3<double>(0.0, 0.0, dz * static_cast<double>(k)));
+        img.init_orientation(vec3<double>(1.0, 0.0, 0.0), vec3<double>(0.0, 1.0, 0.0));
+        img.fill_pixels(0.0f);
+    }
+    return coll;
+}
+
+
+TEST_CASE( "Signed_Distance_From_Mesh" ){
+    const vec3<double> centre(5.1, 4.9, 5.05);
+    const double radius = 3.0;
+    const auto mesh = make_uv_sphere(centre, radius, 48, 96);
+    mesh_bvh<double, uint32_t> bvh(mesh);
+
+    auto coll = make_grid(20, 22, 21, 2, 0.5, 0.45, 0.5);
+
+    SUBCASE("exact propagation matches individual signed distance queries"){
+        Signed_Distance_From_Mesh_Opts opts;
+        opts.propagation = Signed_Distance_From_Mesh_Opts::Propagation::Exact;
+        Signed_Distance_From_Mesh(coll, mesh, 1, opts);
+
+        for(const auto &img : coll.images){
+            for(int64_t r = 0; r < img.rows; ++r){
+                for(int64_t c = 0; c < img.columns; ++c){
+                    const auto p = img.position(r, c);
+                    const auto expected = bvh.signed_distance(p);
+                    REQUIRE(std::abs(img.value(r, c, 1) - expected) < 1E-4);
+                    REQUIRE(img.value(r, c, 0) == 0.0f);
+                }
+            }
+        }
+    }
+
+    SUBCASE("fast sweeping approximates the true signed distance"){
+        Signed_Distance_From_Mesh(coll, mesh, 1);
+
+        double max_err = 0.0;
+        for(const auto &img : coll.images){
+            for(int64_t r = 0; r < img.rows; ++r){
+                for(int64_t c = 0; c < img.columns; ++c){
+                    const auto p = img.position(r, c);
+                    const auto expected = bvh.signed_distance(p);
+                    const auto actual = static_cast<double>(img.value(r, c, 1));
+
+                    // The sign should always be correct, and band voxels should be exact.
+                    if(1E-3 < std::abs(expected)) REQUIRE((actual < 0.0) == (expected < 0.0));
+                    if(std::abs(expected) < 1.0) REQUIRE(std::abs(actual - expected) < 1E-4);
+                    max_err = std::max(max_err, std::abs(actual - expected));
+                }
+            }
+        }
+        REQUIRE(max_err < 0.5);
+    }
+
+    SUBCASE("a mesh far from the images still yields exact distances"){
+        const auto far_mesh = make_uv_sphere(vec3<double>(50.0, 0.0, 0.0), 1.0, 12, 24);
+        mesh_bvh<double, uint32_t> far_bvh(far_mesh);
+        Signed_Distance_From_Mesh(coll, far_mesh, 0);
+
+        const auto &img = coll.images.front();
+        const auto p = img.position(3, 4);
+        REQUIRE(std::abs(img.value(3, 4, 0) - far_bvh.signed_distance(p)) < 1E-4);
+    }
+
+    SUBCASE("invalid inputs are rejected"){
+        REQUIRE_THROWS(Signed_Distance_From_Mesh(coll, mesh, 2));
+
+        fv_surface_mesh<double, uint32_t> empty;
+        REQUIRE_THROWS(Signed_Distance_From_Mesh(coll, empty, 0));
+
+        Signed_Distance_From_Mesh_Opts opts;
+        opts.narrow_band = -1.0;
+        REQUIRE_THROWS(Signed_Distance_From_Mesh(coll, mesh, 0, opts));
+
+        coll.images.back().offset += vec3<double>(0.0, 0.0, 0.1);
+        REQUIRE_THROWS(Signed_Distance_From_Mesh(coll, mesh, 0));
+    }
+}
+
+
+// Signed area of a contour in the z = const plane, positive when counter-clockwise about +z.
+static double signed_area_xy(const contour_of_points<double> &cop){
+    double area = 0.0;
+    for(auto it = std::begin(cop.points); it != std::end(cop.points); ++it){
+        auto next = std::next(it);
+        if(next == std::end(cop.points)) next = std::begin(cop.points);
+        area += it->x * next->y - next->x * it->y;
+    }
+    return 0.5 * area;
+}
+
+// Verify every edge is shared by exactly two consistently-oriented faces, and return the enclosed volume.
+static double check_watertight(const fv_surface_mesh<double, uint64_t> &mesh){
+    std::map<std::pair<uint64_t, uint64_t>, int64_t> directed_edges;
+    double volume = 0.0;
+    for(const auto &f : mesh.faces){
+        REQUIRE(f.size() == 3);
+        for(size_t i = 0; i < 3; ++i){
+            directed_edges[{ f[i], f[(i + 1) % 3] }] += 1;
+        }
+        const auto &a = mesh.vertices.at(f[0]);
+        const auto &b = mesh.vertices.at(f[1]);
+        const auto &c = mesh.vertices.at(f[2]);
+        volume += a.Dot(b.Cross(c)) / 6.0;
+    }
+    for(const auto &p : directed_edges){
+        REQUIRE(p.second == 1);
+        REQUIRE(directed_edges.count({ p.first.second, p.first.first }) == 1);
+    }
+    return volume;
+}
+
+
+TEST_CASE( "Marching_Squares" ){
+    auto coll = make_grid(30, 34, 3, 1, 0.5, 0.4, 1.0);
+    const vec3<double> centre(8.1, 6.2, 0.0);
+
+    SUBCASE("a disc yields a single counter-clockwise contour"){
+        auto &img = coll.images.front();
+        for(int64_t r = 0; r < img.rows; ++r){
+            for(int64_t c = 0; c < img.columns; ++c){
+                auto p = img.position(r, c);
+                p.z = 0.0;
+                img.reference(r, c, 0) = static_cast<float>(4.0 - p.distance(centre));
+            }
+        }
+        Isosurface_Opts opts;
+        opts.threshold = 0.0;
+        const auto cc = Marching_Squares(img, 0, opts);
+        REQUIRE(cc.contours.size() == 1);
+        const auto &cop = cc.contours.front();
+        REQUIRE(cop.closed);
+        const auto pi = std::acos(-1.0);
+        REQUIRE(std::abs(signed_area_xy(cop) - pi * 16.0) < 0.5);
+        for(const auto &p : cop.points){
+            REQUIRE(std::abs(vec3<double>(p.x, p.y, 0.0).distance(centre) - 4.0) < 0.05);
+        }
+
+        // Inverting the interior yields a clockwise hole plus a contour around the image border.
+        opts.interior = Isosurface_Opts::Interior::Below;
+        const auto cc2 = Marching_Squares(img, 0, opts);
+        REQUIRE(cc2.contours.size() == 2);
+        int64_t N_cw = 0;
+        double total = 0.0;
+        for(const auto &c : cc2.contours){
+            if(signed_area_xy(c) < 0.0) ++N_cw;
+            total += signed_area_xy(c);
+        }
+        REQUIRE(N_cw == 1);
+        REQUIRE(std::abs(total - (34 * 0.5 * 30 * 0.4 - pi * 16.0)) < 0.5);
+    }
+
+    SUBCASE("ambiguous cells separate diagonal voxels"){
+        auto &img = coll.images.front();
+        img.fill_pixels(0.0f);
+        img.reference(10, 10, 0) = 1.0f;
+        img.reference(11, 11, 0) = 1.0f;
+        const auto cc = Marching_Squares(img, 0);
+        REQUIRE(cc.contours.size() == 2);
+        for(const auto &c : cc.contours){
+            REQUIRE(c.points.size() == 4);
+            REQUIRE(std::abs(signed_area_xy(c) - 0.5 * 0.5 * 0.4) < 1E-6);
+        }
+    }
+
+    SUBCASE("images are processed independently and in order"){
+        int64_t n = 0;
+        for(auto &img : coll.images){
+            img.fill_pixels(0.0f);
+            for(int64_t i = 0; i <= n; ++i) img.reference(2, 2 + 3 * i, 0) = 1.0f;
+            ++n;
+        }
+        const auto cc = Marching_Squares(coll, 0);
+        REQUIRE(cc.contours.size() == 6);
+
+        auto it = std::begin(cc.contours);
+        for(const auto &img : coll.images){
+            for(const auto &c : Marching_Squares(img, 0).contours){
+                REQUIRE(it->points == c.points);
+                ++it;
+            }
+        }
+    }
+
+    SUBCASE("invalid channels are rejected"){
+        REQUIRE_THROWS(Marching_Squares(coll.images.front(), 1));
+    }
+}
+
+
+TEST_CASE( "Marching_Cubes" ){
+    auto coll = make_grid(20, 22, 18, 1, 0.5, 0.45, 0.6);
+    const vec3<double> centre(5.13, 4.61, 5.17); // Chosen so no voxel lies exactly on the sphere.
+    const double radius = 3.0;
+    const auto pi = std::acos(-1.0);
+
+    for(auto &img : coll.images){
+        for(int64_t r = 0; r < img.rows; ++r){
+            for(int64_t c = 0; c < img.columns; ++c){
+                img.reference(r, c, 0) = static_cast<float>(radius - img.position(r, c).distance(centre));
+            }
+        }
+    }
+
+    SUBCASE("a sphere yields a closed, outward-oriented surface"){
+        Isosurface_Opts opts;
+        opts.threshold = 0.0;
+        const auto mesh = Marching_Cubes<uint64_t>(coll, 0, opts);
+        REQUIRE(!mesh.faces.empty());
+
+        const auto volume = check_watertight(mesh);
+        const auto expected = 4.0 / 3.0 * pi * radius * radius * radius;
+        REQUIRE(std::abs(volume - expected) < 0.03 * expected); // Linear interpolation cuts inside the sphere.
+        for(const auto &v : mesh.vertices){
+            REQUIRE(std::abs(v.distance(centre) - radius) < 0.05);
+        }
+
+        // Vertices are unique without any merging.
+        const auto as_tuple = [](const vec3<double> &v){ return std::make_tuple(v.x, v.y, v.z); };
+        std::set<std::tuple<double,double,double>> unique;
+        for(const auto &v : mesh.vertices) unique.insert(as_tuple(v));
+        REQUIRE(unique.size() == mesh.vertices.size());
+
+        // The surface passes through the marching squares contours of each image.
+        const auto cc = Marching_Squares(coll, 0, opts);
+        for(const auto &c : cc.contours){
+            for(const auto &p : c.points){
+                const auto nearest = std::min_element(std::begin(mesh.vertices), std::end(mesh.vertices),
+                                                      [&](const vec3<double> &a, const vec3<double> &b){
+                                                          return (a.sq_dist(p) < b.sq_dist(p));
+                                                      });
+                REQUIRE(nearest->distance(p) < 1E-9);
+            }
+        }
+    }
+
+    SUBCASE("surfaces are closed where the interior touches the grid boundary"){
+        Isosurface_Opts opts;
+        opts.threshold = 0.0;
+        opts.interior = Isosurface_Opts::Interior::Below;
+        const auto mesh = Marching_Cubes<uint64_t>(coll, 0, opts);
+        const auto volume = check_watertight(mesh);
+
+        // The grid extends half a voxel beyond the outermost voxel centres.
+        const auto grid_volume = (22 * 0.5) * (20 * 0.45) * (18 * 0.6);
+        const auto sphere_volume = 4.0 / 3.0 * pi * radius * radius * radius;
+        REQUIRE(std::abs(volume - (grid_volume - sphere_volume)) < 0.03 * sphere_volume);
+    }
+
+    SUBCASE("noisy volumes yield closed surfaces"){
+        std::mt19937 re(314159);
+        std::uniform_real_distribution<float> rd(0.0f, 1.0f);
+        for(auto &img : coll.images){
+            for(auto &v : img.data) v = rd(re);
+        }
+        coll.images.front().reference(3, 4, 0) = std::numeric_limits<float>::quiet_NaN();
+        const auto mesh = Marching_Cubes<uint64_t>(coll, 0);
+        REQUIRE(!mesh.faces.empty());
+        REQUIRE(0.0 < check_watertight(mesh));
+    }
+
+    SUBCASE("signed distance maps can be converted back into surfaces"){
+        const auto sphere = make_uv_sphere(centre, radius, 48, 96);
+        Signed_Distance_From_Mesh(coll, sphere, 0);
+
+        Isosurface_Opts opts;
+        opts.threshold = 0.0;
+        opts.interior = Isosurface_Opts::Interior::Below;
+        const auto mesh = Marching_Cubes<uint64_t>(coll, 0, opts);
+        check_watertight(mesh);
+        for(const auto &v : mesh.vertices){
+            REQUIRE(std::abs(v.distance(centre) - radius) < 0.05);
+        }
+    }
+
+    SUBCASE("irregular grids are rejected"){
+        coll.images.back().offset += vec3<double>(0.0, 0.0, 0.1);
+        REQUIRE_THROWS(Marching_Cubes<uint64_t>(coll, 0));
+    }
+}
+
+
+TEST_CASE( "Voxelize_Mesh" ){
+    const vec3<double> centre(5.13, 4.61, 5.17);
+    const double radius = 3.0;
+    const auto mesh = make_uv_sphere(centre, radius, 48, 96);
+    mesh_bvh<double, uint32_t> bvh(mesh);
+
+    auto coll = make_grid(20, 22, 21, 2, 0.5, 0.45, 0.5);
+
+    SUBCASE("voxel centres are classified correctly"){
+        Voxelize_Mesh(coll, mesh, 1, 1.0f, 0.0f);
+        int64_t N_inside = 0;
+        for(const auto &img : coll.images){
+            for(int64_t r = 0; r < img.rows; ++r){
+                for(int64_t c = 0; c < img.columns; ++c){
+                    const auto p = img.position(r, c);
+                    const bool inside = (img.value(r, c, 1) == 1.0f);
+                    N_inside += inside ? 1 : 0;
+                    REQUIRE(img.value(r, c, 0) == 0.0f);
+                    if(std::abs(p.distance(centre) - radius) < 0.05) continue; // Avoid the faceted surface.
+                    REQUIRE(inside == bvh.is_inside(p));
+                }
+            }
+        }
+        REQUIRE(0 < N_inside);
+    }
+
+    SUBCASE("conservative voxelization includes every voxel touched by the surface"){
+        auto coll2 = coll;
+        Voxelize_Mesh(coll, mesh, 1, 1.0f, 0.0f);
+
+        Voxelize_Mesh_Opts opts;
+        opts.inclusivity = Voxelize_Mesh_Opts::Inclusivity::Conservative;
+        Voxelize_Mesh(coll2, mesh, 1, 1.0f, 0.0f, opts);
+
+        auto it = std::begin(coll.images);
+        for(const auto &img : coll2.images){
+            for(int64_t r = 0; r < img.rows; ++r){
+                for(int64_t c = 0; c < img.columns; ++c){
+                    const bool centre_inside = (it->value(r, c, 1) == 1.0f);
+                    const bool cons_inside = (img.value(r, c, 1) == 1.0f);
+                    if(centre_inside) REQUIRE(cons_inside);
+
+                    // Voxels the surface definitely passes through.
+                    const auto p = img.position(r, c);
+                    const double d = std::abs(p.distance(centre) - radius);
+                    if(d < 0.1) REQUIRE(cons_inside);
+
+                    // Voxels that are definitely beyond the surface.
+                    if((radius + 0.6) < p.distance(centre)) REQUIRE(!cons_inside);
+                }
+            }
+            ++it;
+        }
+    }
+
+    SUBCASE("parity and winding rules differ for overlapping parts"){
+        auto mesh2 = mesh;
+        const auto other = make_uv_sphere(centre + vec3<double>(2.0, 0.0, 0.0), radius, 48, 96);
+        const auto N_v = static_cast<uint32_t>(mesh2.vertices.size());
+        mesh2.vertices.insert(std::end(mesh2.vertices), std::begin(other.vertices), std::end(other.vertices));
+        for(auto f : other.faces){
+            for(auto &v : f) v += N_v;
+            mesh2.faces.push_back(f);
+        }
+        mesh_bvh<double, uint32_t> bvh2(other);
+
+        auto coll2 = coll;
+        Voxelize_Mesh(coll, mesh2, 1, 1.0f, 0.0f);
+        Voxelize_Mesh_Opts opts;
+        opts.fillrule = Voxelize_Mesh_Opts::FillRule::Winding;
+        Voxelize_Mesh(coll2, mesh2, 1, 1.0f, 0.0f, opts);
+
+        auto it = std::begin(coll2.images);
+        for(const auto &img : coll.images){
+            for(int64_t r = 0; r < img.rows; ++r){
+                for(int64_t c = 0; c < img.columns; ++c){
+                    const auto p = img.position(r, c);
+                    if(std::abs(p.distance(centre) - radius) < 0.05) continue;
+                    if(std::abs(p.distance(centre + vec3<double>(2.0, 0.0, 0.0)) - radius) < 0.05) continue;
+                    const bool in_a = bvh.is_inside(p);
+                    const bool in_b = bvh2.is_inside(p);
+                    REQUIRE((img.value(r, c, 1) == 1.0f) == (in_a != in_b));
+                    REQUIRE((it->value(r, c, 1) == 1.0f) == (in_a || in_b));
+                }
+            }
+            ++it;
+        }
+    }
+
+    SUBCASE("inverted inner surfaces create cavities"){
+        auto mesh2 = mesh;
+        const auto inner = make_uv_sphere(centre, 1.5, 24, 48);
+        const auto N_v = static_cast<uint32_t>(mesh2.vertices.size());
+        mesh2.vertices.insert(std::end(mesh2.vertices), std::begin(inner.vertices), std::end(inner.vertices));
+        for(auto f : inner.faces){
+            std::reverse(std::begin(f), std::end(f));
+            for(auto &v : f) v += N_v;
+            mesh2.faces.push_back(f);
+        }
+
+        for(const auto fillrule : { Voxelize_Mesh_Opts::FillRule::Parity, Voxelize_Mesh_Opts::FillRule::Winding }){
+            Voxelize_Mesh_Opts opts;
+            opts.fillrule = fillrule;
+            Voxelize_Mesh(coll, mesh2, 1, 1.0f, 0.0f, opts);
+            for(const auto &img : coll.images){
+                for(int64_t r = 0; r < img.rows; ++r){
+                    for(int64_t c = 0; c < img.columns; ++c){
+                        const auto dist = img.position(r, c).distance(centre);
+                        const bool inside = (img.value(r, c, 1) == 1.0f);
+                        if(dist < 1.4) REQUIRE(!inside);
+                        if((1.6 < dist) && (dist < (radius - 0.05))) REQUIRE(inside);
+                    }
+                }
+            }
+        }
+    }
+
+    SUBCASE("voxels outside the mesh can be left unaltered"){
+        for(auto &img : coll.images) img.fill_pixels(1, 7.0f);
+
+        Voxelize_Mesh_Opts opts;
+        opts.overwrite = Voxelize_Mesh_Opts::Overwrite::InsideOnly;
+        Voxelize_Mesh(coll, mesh, 1, 3.0f, 0.0f, opts);
+        for(const auto &img : coll.images){
+            for(int64_t r = 0; r < img.rows; ++r){
+                for(int64_t c = 0; c < img.columns; ++c){
+                    const auto p = img.position(r, c);
+                    if(std::abs(p.distance(centre) - radius) < 0.05) continue;
+                    REQUIRE(img.value(r, c, 1) == (bvh.is_inside(p) ? 3.0f : 7.0f));
+                }
+            }
+        }
+    }
+
+    SUBCASE("integer images and oblique images are supported"){
+        planar_image_collection<uint8_t, double> coll8;
+        const vec3<double> row_unit = vec3<double>(1.0, 0.3, 0.2).unit();
+        const vec3<double> col_unit = vec3<double>(0.0, 1.0, -1.5).Cross(row_unit).Cross(row_unit).unit() * -1.0;
+        for(int64_t k = 0; k < 3; ++k){
+            coll8.images.emplace_back();
+            auto &img = coll8.images.back();
+            img.init_buffer(25, 25, 1);
+            // The last image is not parallel to the others.
+            const auto ru = (k < 2) ? row_unit : vec3<double>(0.0, 1.0, 0.0);
+            const auto cu = (k < 2) ? col_unit : vec3<double>(0.0, 0.0, 1.0);
+            const auto n = ru.Cross(cu).unit();
+            img.init_spatial(0.4, 0.4, 0.4, vec3<double>(0.0, 0.0, 0.0),
+                             centre - ru * 5.0 - cu * 5.0 + n * (0.7 * static_cast<double>(k)));
+            img.init_orientation(ru, cu);
+            img.fill_pixels(0);
+        }
+        Voxelize_Mesh(coll8, mesh, 0, static_cast<uint8_t>(255), static_cast<uint8_t>(1));
+
+        int64_t N_inside = 0;
+        for(const auto &img : coll8.images){
+            for(int64_t r = 0; r < img.rows; ++r){
+                for(int64_t c = 0; c < img.columns; ++c){
+                    const auto p = img.position(r, c);
+                    const auto v = img.value(r, c, 0);
+                    REQUIRE(((v == 255) || (v == 1)));
+                    N_inside += (v == 255) ? 1 : 0;
+                    if(std::abs(p.distance(centre) - radius) < 0.05) continue;
+                    REQUIRE((v == 255) == bvh.is_inside(p));
+                }
+            }
+        }
+        REQUIRE(0 < N_inside);
+    }
+
+    SUBCASE("invalid inputs are rejected"){
+        REQUIRE_THROWS(Voxelize_Mesh(coll, mesh, 2, 1.0f, 0.0f));
+
+        auto bad = mesh;
+        bad.vertices[3].x = std::numeric_limits<double>::quiet_NaN();
+        REQUIRE_THROWS(Voxelize_Mesh(coll, bad, 0, 1.0f, 0.0f));
+    }
+}
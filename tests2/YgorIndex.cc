@@ -0,0 +1,122 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <YgorMath.h>
+#include <YgorIndex.h>
+#include <YgorIndexCells.h>
+#include <YgorIndexKDTree.h>
+#include <YgorIndexOctree.h>
+#include <YgorIndexRTree.h>
+
+#include "doctest/doctest.h"
+
+
+TEST_CASE_TEMPLATE( "spatial index typed payloads and visitors", index_t,
+                    kdtree<double, uint32_t>,
+                    rtree<double, uint32_t>,
+                    octree<double, uint32_t>,
+                    cells_index<double, uint32_t> ){
+    using entry_t = index_entry<double, uint32_t>;
+
+    // A 10x10 grid of points. Each payload encodes the point's grid position.
+    index_t idx;
+    std::vector<std::pair<vec3<double>, uint32_t>> points;
+    uint32_t id = 0;
+    for(int i = 0; i < 10; ++i){
+        for(int j = 0; j < 10; ++j){
+            const vec3<double> p(i, j, 0.5 * i);
+            idx.insert(p, id);
+            points.emplace_back(p, id);
+            ++id;
+        }
+    }
+    const index_bbox<double> query_box(vec3<double>(2.0, 2.0, -1.0), vec3<double>(5.0, 6.0, 10.0));
+
+    // The ids of the grid points with 2 <= i <= 5 and 2 <= j <= 6.
+    std::vector<uint32_t> in_box;
+    for(uint32_t i = 2; i <= 5; ++i){
+        for(uint32_t j = 2; j <= 6; ++j){
+            in_box.push_back(i * 10 + j);
+        }
+    }
+
+    SUBCASE("payloads are stored without type erasure"){
+        const auto results = idx.search(query_box);
+        REQUIRE(results.size() == 20);
+        for(const auto &e : results){
+            const auto &p = e.box.min;
+            REQUIRE(e.aux_data == static_cast<uint32_t>(p.x * 10.0 + p.y));
+        }
+    }
+
+    SUBCASE("visitors see exactly the matching entries"){
+        std::vector<uint32_t> ids;
+        idx.search(query_box, [&](const entry_t &e){
+            ids.push_back(e.aux_data);
+            return true;
+        });
+        std::sort(ids.begin(), ids.end());
+        REQUIRE(ids == in_box);
+
+        const vec3<double> c(4.0, 4.0, 2.0);
+        std::vector<uint32_t> expected;
+        for(const auto &[p, pid] : points){
+            if(p.distance(c) <= 1.5) expected.push_back(pid);
+        }
+        REQUIRE(!expected.empty());
+
+        ids.clear();
+        idx.search_radius(c, 1.5, [&](const entry_t &e){
+            REQUIRE(e.box.min.distance(c) <= 1.5);
+            ids.push_back(e.aux_data);
+            return true;
+        });
+        std::sort(ids.begin(), ids.end());
+        REQUIRE(ids == expected);
+    }
+
+    SUBCASE("returning false stops the query early"){
+        std::vector<uint32_t> ids;
+        idx.search(query_box, [&](const entry_t &e){
+            ids.push_back(e.aux_data);
+            return (ids.size() < 3);
+        });
+        REQUIRE(ids.size() == 3);
+        for(const auto i : ids){
+            REQUIRE(std::binary_search(in_box.begin(), in_box.end(), i));
+        }
+
+        size_t visited = 0;
+        idx.nearest_neighbors(vec3<double>(0.0, 0.0, 0.0), 50, [&](const entry_t &, double){
+            return (++visited < 5);
+        });
+        REQUIRE(visited == 5);
+    }
+
+    SUBCASE("nearest neighbor visitors receive the nearest entries in order of distance"){
+        const vec3<double> q(3.3, 7.1, 1.0);
+        auto by_dist = points;
+        std::sort(by_dist.begin(), by_dist.end(), [&](const auto &a, const auto &b){
+            return a.first.sq_dist(q) < b.first.sq_dist(q);
+        });
+        REQUIRE(by_dist[7].first.sq_dist(q) < by_dist[8].first.sq_dist(q));
+
+        std::vector<double> dists;
+        std::vector<uint32_t> ids;
+        idx.nearest_neighbors(q, 8, [&](const entry_t &e, double sq_dist){
+            REQUIRE(std::abs(sq_dist - e.box.min.sq_dist(q)) < 1E-12);
+            dists.push_back(sq_dist);
+            ids.push_back(e.aux_data);
+            return true;
+        });
+        REQUIRE(dists.size() == 8);
+        REQUIRE(std::is_sorted(dists.begin(), dists.end()));
+        for(size_t i = 0; i < 8; ++i){
+            REQUIRE(ids[i] == by_dist[i].second);
+        }
+    }
+}
@@ -0,0 +1,239 @@
+
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <cstdint>
+
+#include <YgorMath.h>
+#include <YgorIndex.h>
+#include <YgorIndexBVH.h>
+
+#include "doctest/doctest.h"
+
+
+// A UV sphere with the given radius, centred at the origin, with outward-facing triangles.
+static fv_surface_mesh<double, uint32_t> make_uv_sphere(double radius, int64_t N_rings, int64_t N_segs){
+    fv_surface_mesh<double, uint32_t> mesh;
+    const double pi = std::acos(-1.0);
+    mesh.vertices.emplace_back(0.0, 0.0, -radius);
+    for(int64_t r = 1; r < N_rings; ++r){
+        const double theta = pi * static_cast<double>(r) / static_cast<double>(N_rings);
+        for(int64_t s = 0; s < N_segs; ++s){
+            const double phi = 2.0 * pi * static_cast<double>(s) / static_cast<double>(N_segs);
+            mesh.vertices.emplace_back( radius * std::sin(theta) * std::cos(phi),
+                                        radius * std::sin(theta) * std::sin(phi),
+                                       -radius * std::cos(theta) );
+        }
+    }
+    mesh.vertices.emplace_back(0.0, 0.0, radius);
+    const auto ring_vert = [&](int64_t r, int64_t s) -> uint32_t {
+        return static_cast<uint32_t>(1 + (r - 1) * N_segs + (s % N_segs));
+    };
+    const auto top = static_cast<uint32_t>(mesh.vertices.size() - 1);
+    for(int64_t s = 0; s < N_segs; ++s){
+        mesh.faces.push_back({ 0U, ring_vert(1, s + 1), ring_vert(1, s) });
+        mesh.faces.push_back({ top, ring_vert(N_rings - 1, s), ring_vert(N_rings - 1, s + 1) });
+        for(int64_t r = 1; r < (N_rings - 1); ++r){
+            mesh.faces.push_back({ ring_vert(r, s), ring_vert(r, s + 1), ring_vert(r + 1, s + 1) });
+            mesh.faces.push_back({ ring_vert(r, s), ring_vert(r + 1, s + 1), ring_vert(r + 1, s) });
+        }
+    }
+    return mesh;
+}
+
+// A unit cube [0,1]^3 composed of quads.
+static fv_surface_mesh<double, uint32_t> make_quad_cube(){
+    fv_surface_mesh<double, uint32_t> mesh;
+    mesh.vertices = {{ vec3<double>(0.0, 0.0, 0.0), vec3<double>(1.0, 0.0, 0.0),
+                       vec3<double>(1.0, 1.0, 0.0), vec3<double>(0.0, 1.0, 0.0),
+                       vec3<double>(0.0, 0.0, 1.0), vec3<double>(1.0, 0.0, 1.0),
+                       vec3<double>(1.0, 1.0, 1.0), vec3<double>(0.0, 1.0, 1.0) }};
+    mesh.faces = {{ {0, 3, 2, 1}, {4, 5, 6, 7},
+                    {0, 1, 5, 4}, {2, 3, 7, 6},
+                    {0, 4, 7, 3}, {1, 2, 6, 5} }};
+    return mesh;
+}
+
+
+TEST_CASE( "mesh_bvh construction" ){
+    SUBCASE("empty mesh gives an empty hierarchy"){
+        fv_surface_mesh<double, uint32_t> mesh;
+        mesh_bvh<double, uint32_t> bvh(mesh);
+        REQUIRE(bvh.get_size() == 0);
+        REQUIRE(bvh.get_nodes().empty());
+        REQUIRE(!bvh.closest_point(vec3<double>(0.0, 0.0, 0.0)));
+        REQUIRE(!bvh.ray_cast(vec3<double>(0.0, 0.0, 0.0), vec3<double>(1.0, 0.0, 0.0)));
+        REQUIRE(std::isnan(bvh.signed_distance(vec3<double>(0.0, 0.0, 0.0))));
+    }
+
+    SUBCASE("polygonal faces are fan-triangulated"){
+        const auto mesh = make_quad_cube();
+        mesh_bvh<double, uint32_t> bvh(mesh);
+        REQUIRE(bvh.get_size() == 12);
+        REQUIRE(bvh.get_bounds().min == vec3<double>(0.0, 0.0, 0.0));
+        REQUIRE(bvh.get_bounds().max == vec3<double>(1.0, 1.0, 1.0));
+    }
+
+    SUBCASE("every node bounds its children and leaves cover all triangles"){
+        const auto mesh = make_uv_sphere(2.0, 20, 30);
+        mesh_bvh<double, uint32_t> bvh(mesh, 2, 8);
+        const auto &nodes = bvh.get_nodes();
+        REQUIRE(!nodes.empty());
+
+        size_t leaf_tris = 0;
+        for(size_t i = 0; i < nodes.size(); ++i){
+            const auto &n = nodes[i];
+            if(n.is_leaf()){
+                leaf_tris += n.count;
+                REQUIRE((n.offset + n.count) <= bvh.get_size());
+            }else{
+                const auto &l = nodes.at(i + 1);
+                const auto &r = nodes.at(i + n.offset);
+                REQUIRE(n.bounds.contains(l.bounds));
+                REQUIRE(n.bounds.contains(r.bounds));
+            }
+        }
+        REQUIRE(leaf_tris == bvh.get_size());
+    }
+
+    SUBCASE("non-finite vertices are rejected"){
+        auto mesh = make_quad_cube();
+        mesh.vertices[3].x = std::numeric_limits<double>::quiet_NaN();
+        mesh_bvh<double, uint32_t> bvh;
+        REQUIRE_THROWS(bvh.build(mesh));
+    }
+}
+
+
+TEST_CASE( "mesh_bvh queries" ){
+    const auto mesh = make_uv_sphere(1.0, 24, 36);
+    mesh_bvh<double, uint32_t> bvh(mesh);
+
+    std::mt19937 re(123456);
+    std::uniform_real_distribution<double> rd(-2.0, 2.0);
+    std::vector<vec3<double>> points;
+    for(size_t i = 0; i < 200; ++i) points.emplace_back(rd(re), rd(re), rd(re));
+
+    SUBCASE("closest point agrees with a brute-force scan"){
+        for(const auto &p : points){
+            const auto cp = bvh.closest_point(p);
+            REQUIRE(cp);
+
+            double best = std::numeric_limits<double>::infinity();
+            for(const auto &f : mesh.faces){
+                const auto &a = mesh.vertices[f[0]];
+                const auto &b = mesh.vertices[f[1]];
+                const auto &c = mesh.vertices[f[2]];
+
+                // Densely sample the triangle to bound the true distance from above.
+                const int64_t N = 12;
+                for(int64_t i = 0; i <= N; ++i){
+                    for(int64_t j = 0; (i + j) <= N; ++j){
+                        const double u = static_cast<double>(i) / N;
+                        const double v = static_cast<double>(j) / N;
+                        const auto q = a + (b - a) * u + (c - a) * v;
+                        best = std::min(best, q.distance(p));
+                    }
+                }
+            }
+            REQUIRE(cp->distance <= best + 1E-9);
+            REQUIRE(cp->distance >= best - 0.02);
+            REQUIRE(std::abs(cp->point.distance(p) - cp->distance) < 1E-9);
+        }
+    }
+
+    SUBCASE("closest point respects the maximum distance"){
+        const vec3<double> p(3.0, 0.0, 0.0);
+        REQUIRE(!bvh.closest_point(p, 1.5));
+        REQUIRE(bvh.closest_point(p, 2.5));
+    }
+
+    SUBCASE("ray casts hit the nearest surface"){
+        const auto hit = bvh.ray_cast(vec3<double>(-5.0, 0.01, 0.02), vec3<double>(1.0, 0.0, 0.0));
+        REQUIRE(hit);
+        REQUIRE(hit->point.x < -0.95);
+        REQUIRE(hit->point.x > -1.0001);
+        REQUIRE(std::abs(hit->t - (hit->point.x + 5.0)) < 1E-9);
+
+        // Rays pointing away miss.
+        REQUIRE(!bvh.ray_cast(vec3<double>(-5.0, 0.0, 0.0), vec3<double>(-1.0, 0.0, 0.0)));
+
+        // Limited rays miss.
+        REQUIRE(!bvh.ray_cast(vec3<double>(-5.0, 0.01, 0.02), vec3<double>(1.0, 0.0, 0.0), 3.0));
+
+        // Rays starting inside hit the far side.
+        const auto hit2 = bvh.ray_cast(vec3<double>(0.0, 0.01, 0.02), vec3<double>(0.0, 0.0, 2.0));
+        REQUIRE(hit2);
+        REQUIRE(hit2->point.z > 0.95);
+        REQUIRE(std::abs(hit2->t - (hit2->point.z - 0.02) / 2.0) < 1E-9);
+    }
+
+    SUBCASE("all ray intersections are reported in order"){
+        const vec3<double> origin(-5.0, 0.01, 0.02);
+        const vec3<double> dir(1.0, 0.0, 0.0);
+        const auto hits = bvh.ray_intersections(origin, dir);
+        REQUIRE(hits.size() == 2);
+        REQUIRE(hits[0].t < hits[1].t);
+        REQUIRE(hits[0].face == bvh.ray_cast(origin, dir)->face);
+        REQUIRE(hits[1].point.x > 0.95);
+        REQUIRE(hits.size() == bvh.count_ray_intersections(origin, dir));
+
+        // Limited rays only report nearby hits.
+        REQUIRE(bvh.ray_intersections(origin, dir, 5.0).size() == 1);
+    }
+
+    SUBCASE("inside/outside classification and signed distance"){
+        for(const auto &p : points){
+            const auto r = p.length();
+            if(std::abs(r - 1.0) < 0.05) continue; // Avoid the faceted surface.
+            REQUIRE(bvh.is_inside(p) == (r < 1.0));
+
+            const auto sd = bvh.signed_distance(p);
+            REQUIRE((sd < 0.0) == (r < 1.0));
+            REQUIRE(std::abs(std::abs(sd) - std::abs(r - 1.0)) < 0.02);
+        }
+    }
+
+    SUBCASE("batched queries match individual queries"){
+        const auto cps = bvh.closest_points(points);
+        const auto sds = bvh.signed_distances(points);
+        std::vector<line<double>> rays;
+        for(const auto &p : points) rays.emplace_back(p, p + vec3<double>(0.1, 0.7, -0.2));
+        const auto hits = bvh.ray_casts(rays);
+
+        REQUIRE(cps.size() == points.size());
+        REQUIRE(sds.size() == points.size());
+        REQUIRE(hits.size() == points.size());
+        for(size_t i = 0; i < points.size(); ++i){
+            const auto cp = bvh.closest_point(points[i]);
+            REQUIRE(cps[i]->face == cp->face);
+            REQUIRE(cps[i]->distance == cp->distance);
+            REQUIRE(sds[i] == bvh.signed_distance(points[i]));
+
+            const auto hit = bvh.ray_cast(rays[i].R_0, rays[i].U_0);
+            REQUIRE(static_cast<bool>(hits[i]) == static_cast<bool>(hit));
+            if(hit) REQUIRE(hits[i]->face == hit->face);
+        }
+    }
+
+    SUBCASE("original face indices are reported for polygonal faces"){
+        const auto cube = make_quad_cube();
+        mesh_bvh<double, uint32_t> cube_bvh(cube);
+
+        const auto cp = cube_bvh.closest_point(vec3<double>(0.5, 0.5, 2.0));
+        REQUIRE(cp);
+        REQUIRE(cp->face == 1);
+        REQUIRE(std::abs(cp->distance - 1.0) < 1E-12);
+
+        const auto hit = cube_bvh.ray_cast(vec3<double>(0.3, -1.0, 0.6), vec3<double>(0.0, 1.0, 0.0));
+        REQUIRE(hit);
+        REQUIRE(hit->face == 2);
+
+        REQUIRE(cube_bvh.is_inside(vec3<double>(0.25, 0.5, 0.75)));
+        REQUIRE(!cube_bvh.is_inside(vec3<double>(1.25, 0.5, 0.75)));
+        REQUIRE(std::abs(cube_bvh.signed_distance(vec3<double>(0.5, 0.5, 0.9)) + 0.1) < 1E-12);
+    }
+}
+
@@ -2,8 +2,10 @@
 #include <any>
 #include <limits>
 #include <vector>
+#include <cstdint>
 #include <algorithm>
 #include <cmath>
+#include <random>
 #include <string>
 
 #include <YgorMath.h>
@@ -481,3 +483,107 @@ TEST_CASE( "cells_index with float type" ){
         REQUIRE(std::any_cast<std::string>(results[0].aux_data) == "float_point");
     }
 }
+
+TEST_CASE( "cells_index compaction and nearest neighbors" ){
+    using index_t = cells_index<double, uint32_t>;
+    std::mt19937 re(4321);
+    std::uniform_real_distribution<double> rd(-10.0, 10.0);
+    std::normal_distribution<double> rn(0.0, 0.2);
+
+    // Uniform points, a tight cluster, and a planar grid (like the voxels of an image slice).
+    std::vector<vec3<double>> points;
+    for(int i = 0; i < 1000; ++i) points.emplace_back(rd(re), rd(re), rd(re));
+    for(int i = 0; i < 500; ++i) points.emplace_back(3.0 + rn(re), -2.0 + rn(re), 1.0 + rn(re));
+    for(int i = 0; i < 30; ++i){
+        for(int j = 0; j < 30; ++j) points.emplace_back(0.5 * i - 7.0, 0.5 * j - 7.0, 4.0);
+    }
+
+    const auto check_matches_brute_force = [&](const index_t &idx, size_t N){
+        REQUIRE(idx.get_size() == N);
+        std::mt19937 rq(99);
+        std::uniform_real_distribution<double> rqd(-15.0, 15.0);
+        for(int n = 0; n < 30; ++n){
+            vec3<double> q(rqd(rq), rqd(rq), rqd(rq));
+            if(n == 0) q = vec3<double>(1000.0, -2000.0, 5.0); // Far outside the data.
+
+            const index_bbox<double> box(q, q + vec3<double>(4.0, 2.0, 3.0));
+            std::vector<uint32_t> expected, found;
+            for(uint32_t i = 0; i < N; ++i) if(box.contains(points[i])) expected.push_back(i);
+            for(const auto &e : idx.search(box)) found.push_back(e.aux_data);
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == expected);
+
+            expected.clear();
+            found.clear();
+            for(uint32_t i = 0; i < N; ++i) if(points[i].sq_dist(q) <= 3.0 * 3.0) expected.push_back(i);
+            for(const auto &e : idx.search_radius(q, 3.0)) found.push_back(e.aux_data);
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == expected);
+
+            std::vector<double> dists;
+            for(uint32_t i = 0; i < N; ++i) dists.push_back(points[i].sq_dist(q));
+            std::sort(dists.begin(), dists.end());
+            for(const size_t k : { 1, 12, 200 }){
+                std::vector<double> knn_dists;
+                idx.nearest_neighbors(q, k, [&](const index_entry<double, uint32_t> &e, double sq_dist){
+                    REQUIRE(sq_dist == points.at(e.aux_data).sq_dist(q));
+                    knn_dists.push_back(sq_dist);
+                    return true;
+                });
+                REQUIRE(knn_dists.size() == k);
+                for(size_t i = 0; i < k; ++i) REQUIRE(knn_dists[i] == dists[i]);
+            }
+        }
+    };
+
+    const auto fill = [&](index_t &idx){
+        for(uint32_t i = 0; i < points.size(); ++i) idx.insert(points[i], i);
+    };
+
+    SUBCASE("compaction preserves query results"){
+        for(const double cell_size : { 0.3, 1.0, 50.0 }){
+            CAPTURE(cell_size);
+            index_t idx(cell_size);
+            fill(idx);
+            REQUIRE(idx.get_staged_size() == points.size());
+            check_matches_brute_force(idx, points.size());
+
+            idx.compact();
+            REQUIRE(idx.get_staged_size() == 0);
+            check_matches_brute_force(idx, points.size());
+
+            // Compacting again is harmless.
+            idx.compact();
+            check_matches_brute_force(idx, points.size());
+        }
+    }
+
+    SUBCASE("entries inserted after compaction are staged and found"){
+        index_t idx(1.0);
+        fill(idx);
+        const auto N = static_cast<uint32_t>(points.size());
+        idx.compact();
+        for(uint32_t i = 0; i < 200; ++i){
+            points.emplace_back(rd(re), rd(re), 0.1 * rd(re));
+            idx.insert(points.back(), N + i);
+        }
+        REQUIRE(idx.get_staged_size() == 200);
+        REQUIRE(idx.contains(points.back()));
+        check_matches_brute_force(idx, points.size());
+
+        idx.compact();
+        REQUIRE(idx.get_staged_size() == 0);
+        REQUIRE(idx.contains(points.back()));
+        check_matches_brute_force(idx, points.size());
+    }
+
+    SUBCASE("clearing discards the compacted entries"){
+        index_t idx(1.0);
+        fill(idx);
+        idx.compact();
+        idx.clear();
+        REQUIRE(idx.get_size() == 0);
+        REQUIRE(idx.nearest_neighbors(vec3<double>(0.0, 0.0, 0.0), 3).empty());
+        REQUIRE(!idx.contains(points.front()));
+    }
+}
@@ -1,10 +1,14 @@
 
 #include <any>
+#include <atomic>
 #include <limits>
 #include <vector>
+#include <cstdint>
 #include <algorithm>
 #include <cmath>
+#include <random>
 #include <string>
+#include <thread>
 
 #include <YgorMath.h>
 #include <YgorIndex.h>
@@ -950,4 +954,281 @@ TEST_CASE( "kdtree correctness cross-check" ){
         
         REQUIRE(kd_results.size() == brute_results.size());
     }
+
+    SUBCASE("bucketed trees match brute force for all leaf sizes"){
+        std::mt19937 re(20240601);
+        std::uniform_real_distribution<double> rd(-10.0, 10.0);
+        std::uniform_real_distribution<double> rs(0.0, 0.5);
+
+        // A mix of points and boxes, including duplicates.
+        std::vector<kdtree<double>::bbox> boxes;
+        for(int i = 0; i < 3000; ++i){
+            const vec3<double> p(rd(re), rd(re), rd(re));
+            if(i % 3 == 0){
+                boxes.emplace_back(p, p + vec3<double>(rs(re), rs(re), rs(re)));
+            }else{
+                boxes.emplace_back(p, p);
+            }
+            if(i % 50 == 0) boxes.push_back(boxes.back());
+        }
+
+        for(const size_t leaf_size : { 1UL, 8UL, 16UL, 32UL, 1000UL }){
+            kdtree<double> tree(leaf_size);
+            for(size_t i = 0; i < boxes.size(); ++i) tree.insert(boxes[i], static_cast<int>(i));
+
+            for(int q = 0; q < 25; ++q){
+                const vec3<double> query(rd(re), rd(re), rd(re));
+
+                std::vector<double> brute;
+                std::vector<double> brute_points;
+                for(const auto &b : boxes){
+                    brute.push_back(b.squared_distance_to(query));
+                    if(!b.has_extent()) brute_points.push_back(brute.back());
+                }
+                std::sort(brute.begin(), brute.end());
+                std::sort(brute_points.begin(), brute_points.end());
+
+                const size_t k = 12;
+                const auto nn = tree.nearest_neighbors(query, k);
+                REQUIRE(nn.size() == k);
+                for(size_t i = 0; i < k; ++i){
+                    REQUIRE(nn[i].box.squared_distance_to(query) == brute[i]);
+                    const auto idx = std::any_cast<int>(nn[i].aux_data);
+                    REQUIRE(nn[i].box == boxes.at(static_cast<size_t>(idx)));
+                }
+
+                const auto nnp = tree.nearest_neighbors_points(query, k);
+                REQUIRE(nnp.size() == k);
+                for(size_t i = 0; i < k; ++i){
+                    REQUIRE((nnp[i] - query).sq_length() == doctest::Approx(brute_points[i]));
+                }
+
+                const double radius = 2.5;
+                const auto within = tree.search_radius(query, radius);
+                const auto N_brute = std::count_if(brute.begin(), brute.end(),
+                                                   [&](double d){ return d <= radius * radius; });
+                REQUIRE(within.size() == static_cast<size_t>(N_brute));
+
+                const kdtree<double>::bbox query_box(query - vec3<double>(3.0, 2.0, 1.0),
+                                                     query + vec3<double>(1.0, 2.0, 3.0));
+                const auto found = tree.search(query_box);
+                const auto N_found = std::count_if(boxes.begin(), boxes.end(),
+                                                   [&](const kdtree<double>::bbox &b){ return b.intersects(query_box); });
+                REQUIRE(found.size() == static_cast<size_t>(N_found));
+            }
+
+            REQUIRE(tree.search_radius(vec3<double>(0.0, 0.0, 0.0), -1.0).empty());
+        }
+    }
+}
+
+TEST_CASE( "kdtree explicit build and thread safety" ){
+    std::mt19937 re(314159);
+    std::uniform_real_distribution<double> rd(-10.0, 10.0);
+    std::vector<vec3<double>> points;
+    for(int i = 0; i < 2000; ++i) points.emplace_back(rd(re), rd(re), rd(re));
+    std::vector<vec3<double>> queries;
+    for(int i = 0; i < 50; ++i) queries.emplace_back(rd(re), rd(re), rd(re));
+
+    SUBCASE("concurrent queries after insertion agree with sequential queries"){
+        kdtree<double> ref;
+        kdtree<double> tree;
+        for(const auto &p : points){
+            ref.insert(p);
+            tree.insert(p);
+        }
+
+        // The first queries trigger a rebuild, which must only happen once.
+        std::atomic<int64_t> mismatches(0);
+        std::vector<std::thread> threads;
+        for(int t = 0; t < 4; ++t){
+            threads.emplace_back([&](){
+                for(const auto &q : queries){
+                    const auto a = tree.nearest_neighbors_points(q, 7);
+                    const auto b = ref.nearest_neighbors_points(q, 7);
+                    if(a != b) ++mismatches;
+                    if(tree.search_radius(q, 3.0).size() != ref.search_radius(q, 3.0).size()) ++mismatches;
+                }
+            });
+        }
+        for(auto &t : threads) t.join();
+        REQUIRE(mismatches.load() == 0);
+    }
+
+    SUBCASE("frozen trees reject modification until thawed"){
+        kdtree<double> tree;
+        for(const auto &p : points) tree.insert(p);
+        tree.freeze();
+        REQUIRE(tree.is_frozen());
+        REQUIRE_THROWS(tree.insert(vec3<double>(0.0, 0.0, 0.0)));
+        REQUIRE_THROWS(tree.clear());
+        REQUIRE(tree.get_size() == points.size());
+        REQUIRE(tree.nearest_neighbors(queries.front(), 3).size() == 3);
+
+        tree.thaw();
+        REQUIRE(!tree.is_frozen());
+        tree.insert(vec3<double>(100.0, 100.0, 100.0));
+        REQUIRE(tree.contains(vec3<double>(100.0, 100.0, 100.0)));
+    }
+
+    SUBCASE("double-buffered trees only expose built entries"){
+        kdtree<double> tree(16, kdtree<double>::build_mode::double_buffered);
+        const kdtree<double>::bbox everything(vec3<double>(-20.0, -20.0, -20.0), vec3<double>(20.0, 20.0, 20.0));
+
+        REQUIRE(tree.search(everything).empty());
+        tree.insert(points[0]);
+        REQUIRE(tree.search(everything).empty());
+        REQUIRE(tree.get_size() == 0);
+        REQUIRE(tree.get_bounds() == kdtree<double>::bbox());
+        tree.build();
+        REQUIRE(tree.search(everything).size() == 1);
+        REQUIRE(tree.get_size() == 1);
+        REQUIRE(tree.get_bounds() == kdtree<double>::bbox(points[0], points[0]));
+        tree.insert(points[1]);
+        REQUIRE(tree.nearest_neighbors(points[1], 5).size() == 1);
+        REQUIRE(tree.get_size() == 1);
+        REQUIRE(tree.get_bounds() == kdtree<double>::bbox(points[0], points[0]));
+        tree.build();
+        REQUIRE(tree.nearest_neighbors(points[1], 5).size() == 2);
+        REQUIRE(tree.get_size() == 2);
+    }
+
+    SUBCASE("double-buffered trees accept insertions while being queried"){
+        kdtree<double> tree(16, kdtree<double>::build_mode::double_buffered);
+        const kdtree<double>::bbox everything(vec3<double>(-20.0, -20.0, -20.0), vec3<double>(20.0, 20.0, 20.0));
+        const size_t batch = 100;
+
+        std::atomic<bool> done(false);
+        std::atomic<int64_t> bad(0);
+        std::vector<std::thread> readers;
+        for(int t = 0; t < 3; ++t){
+            readers.emplace_back([&](){
+                size_t last = 0;
+                while(!done.load()){
+                    // Published trees only ever contain whole batches, and only grow.
+                    const auto N = tree.search(everything).size();
+                    if(((N % batch) != 0) || (N < last)) ++bad;
+                    last = N;
+                    const auto nn = tree.nearest_neighbors(queries.front(), 3);
+                    if((3 < nn.size()) || (nn.size() < std::min<size_t>(N, 3))) ++bad;
+                }
+            });
+        }
+        for(size_t i = 0; i < points.size(); ++i){
+            tree.insert(points[i]);
+            if(((i + 1) % batch) == 0) tree.build();
+        }
+        done.store(true);
+        for(auto &t : readers) t.join();
+
+        REQUIRE(bad.load() == 0);
+        REQUIRE(tree.search(everything).size() == points.size());
+    }
+}
+
+
+TEST_CASE( "kdtree joins" ){
+    using tree_t = kdtree<double, uint32_t>;
+    std::mt19937 re(2718);
+    std::uniform_real_distribution<double> rd(-5.0, 5.0);
+    std::uniform_real_distribution<double> rs(0.0, 0.3);
+
+    // Mostly points, with a few boxes.
+    std::vector<index_bbox<double>> boxes_a, boxes_b;
+    for(size_t i = 0; i < 700; ++i){
+        const vec3<double> p(rd(re), rd(re), rd(re));
+        const auto s = (i % 7 == 0) ? vec3<double>(rs(re), rs(re), rs(re)) : vec3<double>(0.0, 0.0, 0.0);
+        boxes_a.emplace_back(p, p + s);
+    }
+    for(size_t i = 0; i < 500; ++i){
+        const vec3<double> p(rd(re), rd(re), 0.5 * rd(re));
+        boxes_b.emplace_back(p, p);
+    }
+
+    tree_t tree_a(4);
+    tree_t tree_b;
+    for(uint32_t i = 0; i < boxes_a.size(); ++i) tree_a.insert(boxes_a[i], i);
+    for(uint32_t i = 0; i < boxes_b.size(); ++i) tree_b.insert(boxes_b[i], i);
+
+    const auto box_sq_dist = [](const index_bbox<double> &a, const index_bbox<double> &b){
+        const auto gap = [](double a_lo, double a_hi, double b_lo, double b_hi){
+            return std::max({ 0.0, b_lo - a_hi, a_lo - b_hi });
+        };
+        const double dx = gap(a.min.x, a.max.x, b.min.x, b.max.x);
+        const double dy = gap(a.min.y, a.max.y, b.min.y, b.max.y);
+        const double dz = gap(a.min.z, a.max.z, b.min.z, b.max.z);
+        return dx * dx + dy * dy + dz * dz;
+    };
+
+    SUBCASE("all pairs within a distance match brute force"){
+        for(const double d : { 0.0, 0.4, 1.5 }){
+            CAPTURE(d);
+            std::vector<std::pair<uint32_t, uint32_t>> expected, found;
+            for(uint32_t i = 0; i < boxes_a.size(); ++i){
+                for(uint32_t j = 0; j < boxes_b.size(); ++j){
+                    if(box_sq_dist(boxes_a[i], boxes_b[j]) <= d * d) expected.emplace_back(i, j);
+                }
+            }
+            tree_a.join_within_distance(tree_b, d, [&](const tree_t::entry &a, const tree_t::entry &b){
+                found.emplace_back(a.aux_data, b.aux_data);
+                return true;
+            });
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == expected);
+        }
+    }
+
+    SUBCASE("self joins pair every entry with itself"){
+        size_t self_pairs = 0;
+        size_t pairs = 0;
+        tree_b.join_within_distance(tree_b, 0.25, [&](const tree_t::entry &a, const tree_t::entry &b){
+            if(a.aux_data == b.aux_data) ++self_pairs;
+            ++pairs;
+            return true;
+        });
+        REQUIRE(self_pairs == boxes_b.size());
+        REQUIRE((pairs - self_pairs) % 2 == 0);
+    }
+
+    SUBCASE("k nearest neighbors match brute force"){
+        for(const size_t k : { 1, 5, 600 }){
+            CAPTURE(k);
+            std::vector<std::vector<double>> found(boxes_a.size());
+            tree_a.join_nearest_neighbors(tree_b, k, [&](const tree_t::entry &a, const tree_t::entry &b, double sq_dist){
+                REQUIRE(sq_dist == box_sq_dist(a.box, b.box));
+                found.at(a.aux_data).push_back(sq_dist);
+                return true;
+            });
+            for(size_t i = 0; i < boxes_a.size(); ++i){
+                std::vector<double> dists;
+                for(const auto &b : boxes_b) dists.push_back(box_sq_dist(boxes_a[i], b));
+                std::sort(dists.begin(), dists.end());
+                dists.resize(std::min(k, dists.size()));
+                REQUIRE(found[i] == dists);
+            }
+        }
+    }
+
+    SUBCASE("visitors can stop early"){
+        size_t visited = 0;
+        tree_a.join_within_distance(tree_b, 100.0, [&](const tree_t::entry &, const tree_t::entry &){
+            return (++visited < 10);
+        });
+        REQUIRE(visited == 10);
+
+        visited = 0;
+        tree_a.join_nearest_neighbors(tree_b, 3, [&](const tree_t::entry &, const tree_t::entry &, double){
+            return (++visited < 7);
+        });
+        REQUIRE(visited == 7);
+    }
+
+    SUBCASE("empty trees produce no pairs"){
+        tree_t empty;
+        size_t visited = 0;
+        empty.join_within_distance(tree_b, 1.0, [&](const tree_t::entry &, const tree_t::entry &){ ++visited; return true; });
+        tree_b.join_within_distance(empty, 1.0, [&](const tree_t::entry &, const tree_t::entry &){ ++visited; return true; });
+        tree_b.join_nearest_neighbors(empty, 1, [&](const tree_t::entry &, const tree_t::entry &, double){ ++visited; return true; });
+        REQUIRE(visited == 0);
+    }
 }
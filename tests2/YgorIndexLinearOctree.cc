@@ -0,0 +1,184 @@
+
+#include <any>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <YgorMath.h>
+#include <YgorIndex.h>
+#include <YgorIndexLinearOctree.h>
+
+#include "doctest/doctest.h"
+
+
+TEST_CASE( "linear_octree construction" ){
+    SUBCASE("empty index"){
+        linear_octree<double, uint32_t> tree;
+        REQUIRE(tree.get_size() == 0);
+        REQUIRE(tree.get_nodes().empty());
+        REQUIRE(tree.search(index_bbox<double>(vec3<double>(-1.0, -1.0, -1.0), vec3<double>(1.0, 1.0, 1.0))).empty());
+        REQUIRE(tree.nearest_neighbors(vec3<double>(0.0, 0.0, 0.0), 3).empty());
+
+        tree.build(std::vector<vec3<double>>());
+        REQUIRE(tree.get_size() == 0);
+        REQUIRE(tree.get_nodes().empty());
+    }
+
+    SUBCASE("integral payloads hold the index of each point"){
+        std::vector<vec3<double>> points;
+        for(int i = 0; i < 100; ++i) points.emplace_back(std::sin(i), std::cos(3.0 * i), 0.1 * i);
+        linear_octree<double, uint32_t> tree(4);
+        tree.build(points);
+        REQUIRE(tree.get_size() == points.size());
+        for(const auto &e : tree.get_entries()){
+            REQUIRE(e.box.min == points.at(e.aux_data));
+            REQUIRE(e.box.max == points.at(e.aux_data));
+        }
+    }
+
+    SUBCASE("nodes partition the Morton-ordered entries"){
+        std::mt19937 re(1);
+        std::uniform_real_distribution<double> rd(-5.0, 5.0);
+        std::vector<vec3<double>> points;
+        for(int i = 0; i < 2000; ++i) points.emplace_back(rd(re), rd(re), rd(re));
+        linear_octree<double, uint32_t> tree(8);
+        tree.build(points);
+
+        const auto &entries = tree.get_entries();
+        for(size_t i = 1; i < entries.size(); ++i){
+            REQUIRE(tree.morton_key(entries[i-1].box.min) <= tree.morton_key(entries[i].box.min));
+        }
+
+        const auto &nodes = tree.get_nodes();
+        REQUIRE(nodes.front().begin == 0);
+        REQUIRE(nodes.front().end == points.size());
+        size_t leaf_entries = 0;
+        for(const auto &n : nodes){
+            if(n.is_leaf()){
+                REQUIRE((n.end - n.begin) <= 8);
+                leaf_entries += (n.end - n.begin);
+            }else{
+                uint32_t next = n.begin;
+                for(size_t c = 0; c < n.child_count; ++c){
+                    const auto &child = nodes.at(n.first_child + c);
+                    REQUIRE(child.begin == next);
+                    REQUIRE(child.level == n.level + 1);
+                    REQUIRE(n.bounds.contains(child.bounds));
+                    next = child.end;
+                }
+                REQUIRE(next == n.end);
+            }
+            for(size_t i = n.begin; i < n.end; ++i) REQUIRE(n.bounds.contains(entries[i].box));
+        }
+        REQUIRE(leaf_entries == points.size());
+    }
+
+    SUBCASE("coincident points"){
+        std::vector<vec3<double>> points(100, vec3<double>(1.0, 2.0, 3.0));
+        linear_octree<double, uint32_t> tree(4);
+        tree.build(points);
+        REQUIRE(tree.get_size() == 100);
+        REQUIRE(tree.search_radius(vec3<double>(1.0, 2.0, 3.0), 0.0).size() == 100);
+        REQUIRE(tree.nearest_neighbors(vec3<double>(0.0, 0.0, 0.0), 7).size() == 7);
+    }
+
+    SUBCASE("non-finite inputs are rejected"){
+        linear_octree<double> tree;
+        std::vector<vec3<double>> points = {{ vec3<double>(0.0, 0.0, 0.0),
+                                              vec3<double>(std::numeric_limits<double>::quiet_NaN(), 0.0, 0.0) }};
+        REQUIRE_THROWS(tree.build(points));
+    }
+}
+
+TEST_CASE( "linear_octree queries match brute force" ){
+    std::mt19937 re(12345);
+    std::uniform_real_distribution<double> rd(-10.0, 10.0);
+    std::uniform_real_distribution<double> rs(0.0, 0.5);
+    std::normal_distribution<double> rn(0.0, 0.3);
+
+    // A mixture of uniform points, tight clusters, and boxes.
+    using tree_t = linear_octree<double, uint32_t>;
+    std::vector<tree_t::entry> entries;
+    for(uint32_t i = 0; i < 3000; ++i){
+        vec3<double> p(rd(re), rd(re), rd(re));
+        if(i % 3 == 0) p = vec3<double>(2.0 + rn(re), -3.0 + rn(re), rn(re));
+        const auto s = (i % 5 == 0) ? vec3<double>(rs(re), rs(re), rs(re)) : vec3<double>(0.0, 0.0, 0.0);
+        entries.emplace_back(index_bbox<double>(p, p + s), i);
+    }
+
+    for(const size_t leaf_size : { 1, 16, 5000 }){
+        CAPTURE(leaf_size);
+        tree_t tree(leaf_size);
+        tree.build(entries);
+        REQUIRE(tree.get_size() == entries.size());
+
+        for(size_t n = 0; n < 50; ++n){
+            const vec3<double> q(rd(re), rd(re), rd(re));
+
+            const index_bbox<double> box(q, q + vec3<double>(3.0, 1.0, 2.0));
+            std::vector<uint32_t> expected, found;
+            for(const auto &e : entries) if(e.box.intersects(box)) expected.push_back(e.aux_data);
+            for(const auto &e : tree.search(box)) found.push_back(e.aux_data);
+            std::sort(expected.begin(), expected.end());
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == expected);
+
+            expected.clear();
+            found.clear();
+            for(const auto &e : entries) if(e.box.squared_distance_to(q) <= 2.5 * 2.5) expected.push_back(e.aux_data);
+            for(const auto &e : tree.search_radius(q, 2.5)) found.push_back(e.aux_data);
+            std::sort(expected.begin(), expected.end());
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == expected);
+
+            std::vector<double> dists;
+            for(const auto &e : entries) dists.push_back(e.box.squared_distance_to(q));
+            std::sort(dists.begin(), dists.end());
+            std::vector<double> knn_dists;
+            tree.nearest_neighbors(q, 10, [&](const tree_t::entry &e, double sq_dist){
+                REQUIRE(sq_dist == e.box.squared_distance_to(q));
+                knn_dists.push_back(sq_dist);
+                return true;
+            });
+            REQUIRE(knn_dists.size() == 10);
+            for(size_t i = 0; i < knn_dists.size(); ++i) REQUIRE(knn_dists[i] == dists[i]);
+
+            // Points-only queries ignore entries with an extent.
+            for(const auto &p : tree.nearest_neighbors_points(q, 5)){
+                REQUIRE(tree.search_points(index_bbox<double>(p, p)).size() >= 1);
+            }
+        }
+    }
+
+    SUBCASE("visitors can stop early"){
+        tree_t tree;
+        tree.build(entries);
+        size_t visited = 0;
+        tree.search(tree.get_bounds(), [&](const tree_t::entry &){ return (++visited < 10); });
+        REQUIRE(visited == 10);
+    }
+
+    SUBCASE("rebuilding replaces the contents"){
+        tree_t tree;
+        tree.build(entries);
+        std::vector<vec3<double>> points;
+        for(int i = 0; i < 10; ++i) points.emplace_back(100.0 + i, 0.0, 0.0);
+        tree.build(points);
+        REQUIRE(tree.get_size() == 10);
+        REQUIRE(tree.search(index_bbox<double>(vec3<double>(-20.0, -20.0, -20.0), vec3<double>(20.0, 20.0, 20.0))).empty());
+        const auto nn = tree.nearest_neighbors(vec3<double>(104.2, 0.0, 0.0), 1);
+        REQUIRE(nn.size() == 1);
+        REQUIRE(nn.front().aux_data == 4);
+    }
+
+    SUBCASE("float coordinates"){
+        linear_octree<float> tree;
+        std::vector<vec3<float>> points;
+        for(int i = 0; i < 1000; ++i) points.emplace_back(static_cast<float>(i % 10), static_cast<float>((i / 10) % 10), static_cast<float>(i / 100));
+        tree.build(points);
+        REQUIRE(tree.search_radius_points(vec3<float>(5.0f, 5.0f, 5.0f), 1.0f).size() == 7);
+    }
+}
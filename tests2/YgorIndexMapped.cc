@@ -0,0 +1,200 @@
+
+#include <algorithm>
+#include <any>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <YgorMath.h>
+#include <YgorIndex.h>
+#include <YgorIndexKDTree.h>
+#include <YgorIndexRTree.h>
+#include <YgorIndexMapped.h>
+
+#include "doctest/doctest.h"
+
+
+namespace {
+    // Copy a serialized index into suitably-aligned storage, as a mapping would provide.
+    std::vector<uint64_t> to_storage(const std::string &s){
+        std::vector<uint64_t> storage((s.size() + 7) / 8, 0);
+        std::memcpy(storage.data(), s.data(), s.size());
+        return storage;
+    }
+
+    template <class I>
+    std::vector<uint32_t> sorted_ids(const std::vector<I> &entries){
+        std::vector<uint32_t> ids;
+        for(const auto &e : entries) ids.push_back(e.aux_data);
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+}
+
+TEST_CASE( "mapped_index serialization" ){
+    std::mt19937 re(42);
+    std::uniform_real_distribution<double> rd(-10.0, 10.0);
+    std::uniform_real_distribution<double> rs(0.0, 0.5);
+
+    using entry_t = index_entry<double, uint32_t>;
+    std::vector<entry_t> entries;
+    for(uint32_t i = 0; i < 2000; ++i){
+        const vec3<double> p(rd(re), rd(re), rd(re));
+        const auto s = (i % 4 == 0) ? vec3<double>(rs(re), rs(re), rs(re)) : vec3<double>(0.0, 0.0, 0.0);
+        entries.emplace_back(index_bbox<double>(p, p + s), i);
+    }
+
+    kdtree<double, uint32_t> kd(8);
+    for(const auto &e : entries) kd.insert(e.box, e.aux_data);
+    rtree<double, uint32_t> rt(16);
+    rt.bulk_load(entries);
+
+    std::stringstream kd_ss, rt_ss;
+    REQUIRE(kd.write_to(kd_ss));
+    REQUIRE(rt.write_to(rt_ss));
+    const auto kd_buf = to_storage(kd_ss.str());
+    const auto rt_buf = to_storage(rt_ss.str());
+
+    SUBCASE("queries in place match the original trees"){
+        const mapped_index<double, uint32_t> kd_m(kd_buf.data(), kd_ss.str().size());
+        const mapped_index<double, uint32_t> rt_m(rt_buf.data(), rt_ss.str().size());
+        REQUIRE(kd_m.get_kind() == mapped_index_kind::kdtree);
+        REQUIRE(rt_m.get_kind() == mapped_index_kind::rtree);
+        REQUIRE(kd_m.get_size() == entries.size());
+        REQUIRE(rt_m.get_size() == entries.size());
+        REQUIRE(kd_m.get_bounds() == kd.get_bounds());
+
+        for(size_t n = 0; n < 30; ++n){
+            const vec3<double> q(rd(re), rd(re), rd(re));
+            const index_bbox<double> box(q, q + vec3<double>(2.0, 3.0, 1.0));
+            REQUIRE(sorted_ids(kd_m.search(box)) == sorted_ids(kd.search(box)));
+            REQUIRE(sorted_ids(rt_m.search(box)) == sorted_ids(kd.search(box)));
+            REQUIRE(sorted_ids(kd_m.search_radius(q, 2.0)) == sorted_ids(kd.search_radius(q, 2.0)));
+            REQUIRE(sorted_ids(rt_m.search_radius(q, 2.0)) == sorted_ids(kd.search_radius(q, 2.0)));
+
+            std::vector<double> expected;
+            kd.nearest_neighbors(q, 7, [&](const entry_t &, double d){ expected.push_back(d); return true; });
+            for(const auto *m : { &kd_m, &rt_m }){
+                std::vector<double> found;
+                m->nearest_neighbors(q, 7, [&](const entry_t &e, double d){
+                    REQUIRE(d == e.box.squared_distance_to(q));
+                    found.push_back(d);
+                    return true;
+                });
+                REQUIRE(found == expected);
+            }
+        }
+
+        size_t visited = 0;
+        kd_m.search(kd_m.get_bounds(), [&](const entry_t &){ return (++visited < 10); });
+        REQUIRE(visited == 10);
+    }
+
+    SUBCASE("trees can be read back"){
+        kdtree<double, uint32_t> kd2;
+        REQUIRE(kd2.read_from(kd_ss));
+        REQUIRE(kd2.get_size() == kd.get_size());
+        REQUIRE(kd2.get_bounds() == kd.get_bounds());
+
+        rtree<double, uint32_t> rt2;
+        REQUIRE(rt2.read_from(rt_ss));
+        REQUIRE(rt2.get_size() == rt.get_size());
+        REQUIRE(rt2.get_height() == rt.get_height());
+
+        for(size_t n = 0; n < 20; ++n){
+            const vec3<double> q(rd(re), rd(re), rd(re));
+            REQUIRE(sorted_ids(kd2.search_radius(q, 3.0)) == sorted_ids(kd.search_radius(q, 3.0)));
+            REQUIRE(sorted_ids(rt2.search_radius(q, 3.0)) == sorted_ids(kd.search_radius(q, 3.0)));
+            REQUIRE(sorted_ids(kd2.nearest_neighbors(q, 5)) == sorted_ids(kd.nearest_neighbors(q, 5)));
+        }
+
+        // The restored trees remain modifiable.
+        kd2.insert(vec3<double>(100.0, 0.0, 0.0), 5000);
+        rt2.insert(vec3<double>(100.0, 0.0, 0.0), 5000);
+        REQUIRE(kd2.nearest_neighbors(vec3<double>(99.0, 0.0, 0.0), 1).front().aux_data == 5000);
+        REQUIRE(rt2.nearest_neighbors(vec3<double>(99.0, 0.0, 0.0), 1).front().aux_data == 5000);
+        REQUIRE(rt2.get_size() == entries.size() + 1);
+    }
+
+    SUBCASE("indexes are only read back into the same kind of index and types"){
+        kdtree<double, uint32_t> kd2;
+        REQUIRE(!kd2.read_from(rt_ss));
+        rtree<double, uint32_t> rt2;
+        REQUIRE(!rt2.read_from(kd_ss));
+
+        std::stringstream ss(kd_ss.str());
+        kdtree<float, uint32_t> kd_float;
+        REQUIRE(!kd_float.read_from(ss));
+        REQUIRE_THROWS(mapped_index<double, uint64_t>(kd_buf.data(), kd_ss.str().size()));
+    }
+
+    SUBCASE("corrupt or stale buffers are rejected"){
+        const auto size = kd_ss.str().size();
+
+        // Flip a single bit.
+        auto buf = kd_buf;
+        reinterpret_cast<unsigned char *>(buf.data())[size - 100] ^= 0x10;
+        REQUIRE_THROWS(mapped_index<double, uint32_t>(buf.data(), size));
+        REQUIRE_NOTHROW(mapped_index<double, uint32_t>(buf.data(), size, false));
+
+        std::string s = kd_ss.str();
+        s[size - 100] ^= 0x10;
+        std::stringstream ss(s);
+        kdtree<double, uint32_t> kd2;
+        REQUIRE(!kd2.read_from(ss));
+        REQUIRE(kd2.get_size() == 0);
+
+        // Change the version.
+        buf = kd_buf;
+        mapped_index_header h;
+        std::memcpy(&h, buf.data(), sizeof(h));
+        h.version += 1;
+        std::memcpy(buf.data(), &h, sizeof(h));
+        REQUIRE_THROWS(mapped_index<double, uint32_t>(buf.data(), size));
+
+        // Truncate.
+        REQUIRE_THROWS(mapped_index<double, uint32_t>(kd_buf.data(), size - 8));
+        std::stringstream truncated(kd_ss.str().substr(0, size / 2));
+        REQUIRE(!kd2.read_from(truncated));
+
+        // Break the node structure, with a matching checksum, so a child refers back to its parent.
+        buf = kd_buf;
+        auto *bytes = reinterpret_cast<unsigned char *>(buf.data());
+        auto *nodes = reinterpret_cast<mapped_index_node<double> *>(bytes + sizeof(mapped_index_header));
+        nodes[0].first_child = 0;
+        std::memcpy(&h, buf.data(), sizeof(h));
+        h.checksum = mapped_index_checksum(bytes + sizeof(h), h.body_size);
+        std::memcpy(buf.data(), &h, sizeof(h));
+        REQUIRE_THROWS(mapped_index<double, uint32_t>(buf.data(), size));
+    }
+
+    SUBCASE("empty trees and type-erased payloads"){
+        kdtree<float, uint64_t> kd_empty;
+        std::stringstream ss;
+        REQUIRE(kd_empty.write_to(ss));
+        const auto buf = to_storage(ss.str());
+        // The default payload type matches the tree's.
+        const mapped_index<float> m(buf.data(), ss.str().size());
+        REQUIRE(std::is_same<mapped_index<float>::payload_type, uint64_t>::value);
+        REQUIRE(m.get_size() == 0);
+        REQUIRE(m.search_radius(vec3<float>(0.0f, 0.0f, 0.0f), 1.0f).empty());
+        REQUIRE(m.nearest_neighbors(vec3<float>(0.0f, 0.0f, 0.0f), 3).empty());
+
+        kdtree<float, uint64_t> kd2;
+        kd2.insert(vec3<float>(1.0f, 2.0f, 3.0f), 7);
+        REQUIRE(kd2.read_from(ss));
+        REQUIRE(kd2.get_size() == 0);
+
+        kdtree<double> kd_any;
+        kd_any.insert(vec3<double>(1.0, 2.0, 3.0), std::string("label"));
+        std::stringstream ss_any;
+        REQUIRE(!kd_any.write_to(ss_any));
+        rtree<double> rt_any;
+        REQUIRE(!rt_any.write_to(ss_any));
+    }
+}
+
@@ -2,6 +2,7 @@
 #include <any>
 #include <limits>
 #include <vector>
+#include <cstdint>
 #include <algorithm>
 #include <cmath>
 #include <string>
@@ -705,3 +706,4 @@ TEST_CASE( "octree smart pointer memory management" ){
         REQUIRE(tree.get_size() == 0);
     }
 }
+
@@ -2,6 +2,9 @@
 #include <any>
 #include <limits>
 #include <vector>
+#include <cstdint>
+#include <functional>
+#include <random>
 #include <algorithm>
 #include <cmath>
 #include <string>
@@ -726,3 +729,370 @@ TEST_CASE( "rtree smart pointer memory management" ){
         REQUIRE(tree.get_size() == 0);
     }
 }
+
+// Verify the structural invariants of an rtree: uniform leaf depth matching the height, consistent parent pointers,
+// tight node bounds, and node occupancy within limits (including a root fan-out of at least two). Returns the number of
+// leaves.
+template <class T, class Payload>
+static size_t check_rtree_invariants(const rtree<T, Payload> &tree){
+    size_t N_leaves = 0;
+    size_t N_entries = 0;
+    std::function<void(const index_node_base<T, Payload>*, size_t)> check = [&](const index_node_base<T, Payload>* node, size_t depth){
+        const bool is_root = (node == tree.root.get());
+        if(node->is_leaf()){
+            const auto* leaf = static_cast<const index_leaf_node<T, Payload>*>(node);
+            REQUIRE(depth == tree.height);
+            REQUIRE(leaf->entries.size() <= tree.max_entries);
+            if(!is_root) REQUIRE(tree.min_entries <= leaf->entries.size());
+            if(!leaf->entries.empty()){
+                auto b = leaf->entries.front().box;
+                for(const auto &e : leaf->entries) b.expand(e.box);
+                REQUIRE(b == leaf->bounds);
+            }
+            N_entries += leaf->entries.size();
+            ++N_leaves;
+        }else{
+            const auto* internal = static_cast<const index_internal_node<T, Payload>*>(node);
+            REQUIRE(!internal->children.empty());
+            REQUIRE(internal->children.size() <= tree.max_entries);
+            if(!is_root) REQUIRE(tree.min_entries <= internal->children.size());
+            if(is_root) REQUIRE(2 <= internal->children.size());
+            auto b = internal->children.front()->bounds;
+            for(const auto &c : internal->children){
+                REQUIRE(c->parent == internal);
+                b.expand(c->bounds);
+                check(c.get(), depth + 1);
+            }
+            REQUIRE(b == internal->bounds);
+        }
+    };
+    REQUIRE(tree.root != nullptr);
+    REQUIRE(tree.root->parent == nullptr);
+    check(tree.root.get(), 0);
+    REQUIRE(N_entries == tree.get_size());
+    REQUIRE(tree.height == tree.get_height());
+    return N_leaves;
+}
+
+TEST_CASE( "rtree bulk loading" ){
+    using tree_t = rtree<double, uint32_t>;
+    std::mt19937 re(314159);
+    std::uniform_real_distribution<double> rd(-10.0, 10.0);
+    std::uniform_real_distribution<double> rs(0.0, 0.5);
+
+    const auto make_entries = [&](size_t N){
+        std::vector<tree_t::entry> entries;
+        for(size_t i = 0; i < N; ++i){
+            const vec3<double> p(rd(re), rd(re), rd(re));
+            const vec3<double> s = (i % 3 == 0) ? vec3<double>(0.0, 0.0, 0.0) : vec3<double>(rs(re), rs(re), rs(re));
+            entries.emplace_back(tree_t::bbox(p, p + s), static_cast<uint32_t>(i));
+        }
+        return entries;
+    };
+
+    const auto brute_force = [](const std::vector<tree_t::entry> &entries, const tree_t::bbox &q){
+        std::vector<uint32_t> ids;
+        for(const auto &e : entries){
+            if(e.box.intersects(q)) ids.push_back(e.aux_data);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    const auto tree_ids = [](const tree_t &tree, const tree_t::bbox &q){
+        std::vector<uint32_t> ids;
+        for(const auto &e : tree.search(q)) ids.push_back(e.aux_data);
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    for(const auto method : { tree_t::bulk_load_method::sort_tile_recursive, tree_t::bulk_load_method::hilbert }){
+        for(const size_t M : { 4, 8, 16 }){
+            for(const size_t N : { 0, 1, 3, 8, 9, 17, 100, 1000, 5000 }){
+                CAPTURE(static_cast<int>(method));
+                CAPTURE(M);
+                CAPTURE(N);
+                auto entries = make_entries(N);
+                tree_t tree(M);
+                tree.insert(vec3<double>(100.0, 100.0, 100.0), 999'999U); // Replaced by the bulk load.
+                tree.bulk_load(entries, method);
+                REQUIRE(tree.get_size() == N);
+
+                // Nodes are fully packed.
+                const auto N_leaves = check_rtree_invariants(tree);
+                REQUIRE(N_leaves == std::max<size_t>(1, (N + M - 1) / M));
+
+                for(size_t i = 0; i < 20; ++i){
+                    const vec3<double> p(rd(re), rd(re), rd(re));
+                    const tree_t::bbox q(p, p + vec3<double>(3.0, 2.0, 4.0));
+                    REQUIRE(tree_ids(tree, q) == brute_force(entries, q));
+                }
+
+                // The tree remains valid for incremental insertion.
+                auto more = make_entries(N / 2 + 5);
+                for(auto &e : more){
+                    e.aux_data += static_cast<uint32_t>(N);
+                    tree.insert(e.box, e.aux_data);
+                    entries.push_back(e);
+                }
+                REQUIRE(tree.get_size() == entries.size());
+                check_rtree_invariants(tree);
+                for(size_t i = 0; i < 20; ++i){
+                    const vec3<double> p(rd(re), rd(re), rd(re));
+                    const tree_t::bbox q(p, p + vec3<double>(3.0, 2.0, 4.0));
+                    REQUIRE(tree_ids(tree, q) == brute_force(entries, q));
+                }
+            }
+        }
+    }
+
+    SUBCASE("non-finite entries are rejected without altering the tree"){
+        tree_t tree;
+        tree.insert(vec3<double>(1.0, 2.0, 3.0), 7U);
+        std::vector<tree_t::entry> entries;
+        entries.emplace_back(vec3<double>(0.0, 0.0, 0.0), 0U);
+        entries.emplace_back(vec3<double>(std::numeric_limits<double>::infinity(), 0.0, 0.0), 1U);
+        REQUIRE_THROWS(tree.bulk_load(entries));
+        REQUIRE(tree.get_size() == 1);
+        REQUIRE(tree.contains(vec3<double>(1.0, 2.0, 3.0)));
+    }
+}
+
+TEST_CASE( "rtree removal and update" ){
+    using tree_t = rtree<double, uint32_t>;
+    std::mt19937 re(271828);
+    std::uniform_real_distribution<double> rd(-10.0, 10.0);
+    std::uniform_real_distribution<double> rs(0.0, 0.5);
+
+    const auto random_box = [&](){
+        const vec3<double> p(rd(re), rd(re), rd(re));
+        return tree_t::bbox(p, p + vec3<double>(rs(re), rs(re), rs(re)));
+    };
+    const auto all_ids = [](const tree_t &tree){
+        std::vector<uint32_t> ids;
+        tree.search(tree_t::bbox(vec3<double>(-100.0, -100.0, -100.0), vec3<double>(100.0, 100.0, 100.0)),
+                    [&](const tree_t::entry &e){
+                        ids.push_back(e.aux_data);
+                        return true;
+                    });
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    SUBCASE("removing entries"){
+        tree_t tree;
+        tree.insert(vec3<double>(1.0, 2.0, 3.0), 1U);
+        tree.insert(vec3<double>(1.0, 2.0, 3.0), 2U);
+        tree.insert(vec3<double>(4.0, 5.0, 6.0), 3U);
+
+        // Absent entries are not removed.
+        REQUIRE(!tree.remove(vec3<double>(0.0, 0.0, 0.0)));
+        REQUIRE(!tree.remove(tree_t::bbox(vec3<double>(1.0, 2.0, 3.0), vec3<double>(1.0, 2.0, 4.0))));
+        REQUIRE(tree.get_size() == 3);
+
+        // Duplicates can be selected by payload.
+        const tree_t::bbox dup(vec3<double>(1.0, 2.0, 3.0), vec3<double>(1.0, 2.0, 3.0));
+        REQUIRE(tree.remove(dup, [](const tree_t::entry &e){ return e.aux_data == 2U; }));
+        REQUIRE(all_ids(tree) == std::vector<uint32_t>{{ 1U, 3U }});
+        REQUIRE(!tree.remove(dup, [](const tree_t::entry &e){ return e.aux_data == 2U; }));
+
+        REQUIRE(tree.remove(vec3<double>(1.0, 2.0, 3.0)));
+        REQUIRE(tree.remove(vec3<double>(4.0, 5.0, 6.0)));
+        REQUIRE(tree.get_size() == 0);
+        REQUIRE(tree.get_height() == 0);
+        REQUIRE(all_ids(tree).empty());
+
+        // The emptied tree remains usable.
+        tree.insert(vec3<double>(7.0, 8.0, 9.0), 4U);
+        REQUIRE(all_ids(tree) == std::vector<uint32_t>{{ 4U }});
+    }
+
+    SUBCASE("random removals keep the tree balanced"){
+        for(const size_t M : { 2, 4, 8 }){
+            for(const bool bulk : { false, true }){
+                CAPTURE(M);
+                CAPTURE(bulk);
+                std::vector<tree_t::entry> entries;
+                for(uint32_t i = 0; i < 600; ++i) entries.emplace_back(random_box(), i);
+
+                tree_t tree(M);
+                if(bulk){
+                    tree.bulk_load(entries);
+                }else{
+                    for(const auto &e : entries) tree.insert(e.box, e.aux_data);
+                }
+                check_rtree_invariants(tree);
+
+                std::shuffle(entries.begin(), entries.end(), re);
+                while(!entries.empty()){
+                    const auto e = entries.back();
+                    entries.pop_back();
+                    REQUIRE(tree.remove(e.box, [&](const tree_t::entry &x){ return x.aux_data == e.aux_data; }));
+                    REQUIRE(tree.get_size() == entries.size());
+                    if(entries.size() % 37 == 0){
+                        check_rtree_invariants(tree);
+                        std::vector<uint32_t> expected;
+                        for(const auto &x : entries) expected.push_back(x.aux_data);
+                        std::sort(expected.begin(), expected.end());
+                        REQUIRE(all_ids(tree) == expected);
+                    }
+                }
+                check_rtree_invariants(tree);
+                REQUIRE(tree.get_height() == 0);
+            }
+        }
+    }
+
+    SUBCASE("updates move entries"){
+        std::vector<tree_t::entry> entries;
+        for(uint32_t i = 0; i < 500; ++i) entries.emplace_back(random_box(), i);
+        tree_t tree(4);
+        tree.bulk_load(entries);
+
+        // Absent entries are not updated and nothing is inserted.
+        REQUIRE(!tree.update(tree_t::bbox(vec3<double>(50.0, 50.0, 50.0), vec3<double>(51.0, 51.0, 51.0)),
+                             random_box(), 9999U));
+        REQUIRE(tree.get_size() == entries.size());
+
+        // Shrinking an entry keeps it within its leaf, so it is adjusted in place.
+        {
+            auto &e = entries[10];
+            const auto new_box = tree_t::bbox(e.box.min, e.box.min);
+            REQUIRE(tree.update(e.box, new_box, 5000U));
+            e = tree_t::entry(new_box, 5000U);
+            REQUIRE(tree.contains(new_box));
+            check_rtree_invariants(tree);
+        }
+
+        // Interleave in-place updates and relocations.
+        for(size_t n = 0; n < 1000; ++n){
+            auto &e = entries[n % entries.size()];
+            const bool small_move = (n % 2 == 0);
+            const auto shift = small_move ? vec3<double>(0.0, 0.0, 0.0) : vec3<double>(rd(re), rd(re), rd(re));
+            const tree_t::bbox new_box(e.box.min + shift, e.box.max + shift);
+            const uint32_t id = e.aux_data;
+            REQUIRE(tree.update(e.box, new_box, id + 10'000U, [&](const tree_t::entry &x){ return x.aux_data == id; }));
+            e = tree_t::entry(new_box, id + 10'000U);
+            REQUIRE(tree.get_size() == entries.size());
+        }
+        check_rtree_invariants(tree);
+
+        std::vector<uint32_t> expected;
+        for(const auto &x : entries) expected.push_back(x.aux_data);
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(all_ids(tree) == expected);
+        for(size_t i = 0; i < 20; ++i){
+            const auto q = random_box();
+            size_t N_expected = 0;
+            for(const auto &x : entries) N_expected += x.box.intersects(q) ? 1 : 0;
+            REQUIRE(tree.search(q).size() == N_expected);
+        }
+
+        // Non-finite replacements are rejected.
+        const auto inf = std::numeric_limits<double>::infinity();
+        REQUIRE_THROWS(tree.update(entries[0].box, tree_t::bbox(vec3<double>(0.0, 0.0, 0.0), vec3<double>(inf, 0.0, 0.0)), 1U));
+        REQUIRE(tree.get_size() == entries.size());
+    }
+}
+
+TEST_CASE( "rtree joins" ){
+    using tree_t = rtree<double, uint32_t>;
+    std::mt19937 re(1618);
+    std::uniform_real_distribution<double> rd(-5.0, 5.0);
+    std::uniform_real_distribution<double> rs(0.0, 0.6);
+
+    std::vector<index_bbox<double>> boxes_a, boxes_b;
+    for(size_t i = 0; i < 600; ++i){
+        const vec3<double> p(rd(re), rd(re), rd(re));
+        boxes_a.emplace_back(p, p + vec3<double>(rs(re), rs(re), rs(re)));
+    }
+    for(size_t i = 0; i < 400; ++i){
+        const vec3<double> p(rd(re), rd(re), rd(re));
+        const auto s = (i % 2 == 0) ? vec3<double>(rs(re), rs(re), rs(re)) : vec3<double>(0.0, 0.0, 0.0);
+        boxes_b.emplace_back(p, p + s);
+    }
+
+    // The trees have different heights.
+    tree_t tree_a(4);
+    tree_t tree_b(16);
+    for(uint32_t i = 0; i < boxes_a.size(); ++i) tree_a.insert(boxes_a[i], i);
+    std::vector<tree_t::entry> entries_b;
+    for(uint32_t i = 0; i < boxes_b.size(); ++i) entries_b.emplace_back(boxes_b[i], i);
+    tree_b.bulk_load(entries_b);
+    REQUIRE(tree_a.get_height() != tree_b.get_height());
+
+    const auto brute_force = [&](double d){
+        std::vector<std::pair<uint32_t, uint32_t>> expected;
+        for(uint32_t i = 0; i < boxes_a.size(); ++i){
+            for(uint32_t j = 0; j < boxes_b.size(); ++j){
+                const auto gap = [](double a_lo, double a_hi, double b_lo, double b_hi){
+                    return std::max({ 0.0, b_lo - a_hi, a_lo - b_hi });
+                };
+                const double dx = gap(boxes_a[i].min.x, boxes_a[i].max.x, boxes_b[j].min.x, boxes_b[j].max.x);
+                const double dy = gap(boxes_a[i].min.y, boxes_a[i].max.y, boxes_b[j].min.y, boxes_b[j].max.y);
+                const double dz = gap(boxes_a[i].min.z, boxes_a[i].max.z, boxes_b[j].min.z, boxes_b[j].max.z);
+                if((dx * dx + dy * dy + dz * dz) <= d * d) expected.emplace_back(i, j);
+            }
+        }
+        return expected;
+    };
+
+    SUBCASE("intersection joins match brute force"){
+        std::vector<std::pair<uint32_t, uint32_t>> expected, found;
+        for(uint32_t i = 0; i < boxes_a.size(); ++i){
+            for(uint32_t j = 0; j < boxes_b.size(); ++j){
+                if(boxes_a[i].intersects(boxes_b[j])) expected.emplace_back(i, j);
+            }
+        }
+        REQUIRE(expected == brute_force(0.0));
+
+        tree_a.join_intersecting(tree_b, [&](const tree_t::entry &a, const tree_t::entry &b){
+            found.emplace_back(a.aux_data, b.aux_data);
+            return true;
+        });
+        std::sort(found.begin(), found.end());
+        REQUIRE(found == expected);
+
+        // Swapping the trees swaps the pairs.
+        found.clear();
+        tree_b.join_intersecting(tree_a, [&](const tree_t::entry &b, const tree_t::entry &a){
+            found.emplace_back(a.aux_data, b.aux_data);
+            return true;
+        });
+        std::sort(found.begin(), found.end());
+        REQUIRE(found == expected);
+    }
+
+    SUBCASE("distance joins match brute force"){
+        for(const double d : { 0.2, 1.0 }){
+            CAPTURE(d);
+            std::vector<std::pair<uint32_t, uint32_t>> found;
+            tree_a.join_within_distance(tree_b, d, [&](const tree_t::entry &a, const tree_t::entry &b){
+                found.emplace_back(a.aux_data, b.aux_data);
+                return true;
+            });
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == brute_force(d));
+        }
+    }
+
+    SUBCASE("self joins and early stopping"){
+        size_t self_pairs = 0;
+        tree_a.join_intersecting(tree_a, [&](const tree_t::entry &a, const tree_t::entry &b){
+            if(a.aux_data == b.aux_data) ++self_pairs;
+            return true;
+        });
+        REQUIRE(self_pairs == boxes_a.size());
+
+        size_t visited = 0;
+        tree_a.join_within_distance(tree_b, 100.0, [&](const tree_t::entry &, const tree_t::entry &){
+            return (++visited < 10);
+        });
+        REQUIRE(visited == 10);
+
+        tree_t empty;
+        visited = 0;
+        empty.join_intersecting(tree_a, [&](const tree_t::entry &, const tree_t::entry &){ ++visited; return true; });
+        tree_a.join_intersecting(empty, [&](const tree_t::entry &, const tree_t::entry &){ ++visited; return true; });
+        REQUIRE(visited == 0);
+    }
+}
@@ -871,6 +871,69 @@ TEST_CASE( "fv_surface_mesh class" ){
         auto result = mesh.slice_with_planes(planes);
         REQUIRE(!result.contours.empty());
     }
+
+    SUBCASE("slice_with_planes with many parallel planes matches slicing one plane at a time"){
+        // Create a UV sphere.
+        fv_surface_mesh<double, uint32_t> mesh;
+        const int64_t N_rings = 24;
+        const int64_t N_segs = 32;
+        const double pi = std::acos(-1.0);
+        mesh.vertices.emplace_back(0.0, 0.0, -1.0);
+        for(int64_t r = 1; r < N_rings; ++r){
+            const double theta = pi * static_cast<double>(r) / static_cast<double>(N_rings);
+            for(int64_t s = 0; s < N_segs; ++s){
+                const double phi = 2.0 * pi * static_cast<double>(s) / static_cast<double>(N_segs);
+                mesh.vertices.emplace_back( std::sin(theta) * std::cos(phi),
+                                            std::sin(theta) * std::sin(phi),
+                                           -std::cos(theta) );
+            }
+        }
+        mesh.vertices.emplace_back(0.0, 0.0, 1.0);
+        const auto ring_vert = [&](int64_t r, int64_t s) -> uint32_t {
+            return static_cast<uint32_t>(1 + (r - 1) * N_segs + (s % N_segs));
+        };
+        const auto top = static_cast<uint32_t>(mesh.vertices.size() - 1);
+        for(int64_t s = 0; s < N_segs; ++s){
+            mesh.faces.push_back({ 0U, ring_vert(1, s + 1), ring_vert(1, s) });
+            mesh.faces.push_back({ top, ring_vert(N_rings - 1, s), ring_vert(N_rings - 1, s + 1) });
+            for(int64_t r = 1; r < (N_rings - 1); ++r){
+                mesh.faces.push_back({ ring_vert(r, s), ring_vert(r, s + 1), ring_vert(r + 1, s + 1) });
+                mesh.faces.push_back({ ring_vert(r, s), ring_vert(r + 1, s + 1), ring_vert(r + 1, s) });
+            }
+        }
+
+        // Include planes that coincide with vertex rings, planes outside the mesh, and an anti-parallel plane.
+        std::list<plane<double>> planes;
+        for(int64_t i = 0; i < 60; ++i){
+            const double z = -1.2 + 2.4 * static_cast<double>(i) / 59.0;
+            planes.emplace_back(vec3<double>(0.0, 0.0, 1.0), vec3<double>(0.3, -0.2, z));
+        }
+        planes.emplace_back(vec3<double>(0.0, 0.0, 1.0), mesh.vertices.at(ring_vert(6, 0)));
+        planes.emplace_back(vec3<double>(0.0, 0.0, -1.0), vec3<double>(0.0, 0.0, 0.25));
+
+        const auto result = mesh.slice_with_planes(planes);
+        REQUIRE(!result.contours.empty());
+
+        contour_collection<double> expected;
+        int64_t plane_index = 0;
+        for(const auto &p : planes){
+            auto single = mesh.slice_with_planes({ p });
+            for(auto &c : single.contours){
+                c.metadata["PlaneIndex"] = std::to_string(plane_index);
+            }
+            expected.contours.splice( std::end(expected.contours), single.contours );
+            ++plane_index;
+        }
+
+        REQUIRE(result.contours.size() == expected.contours.size());
+        auto r_it = std::begin(result.contours);
+        for(const auto &c : expected.contours){
+            REQUIRE(r_it->closed == c.closed);
+            REQUIRE(r_it->metadata == c.metadata);
+            REQUIRE(r_it->points == c.points);
+            ++r_it;
+        }
+    }
 }
 
 TEST_CASE( "Convex_Hull" ){
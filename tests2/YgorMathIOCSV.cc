@@ -1,8 +1,12 @@
 
 #include <cmath>
+#include <cstdint>
+#include <functional>
 #include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
 
 #include <YgorMath.h>
 #include <YgorMathIOCSV.h>
@@ -145,6 +149,223 @@ TEST_CASE( "ReadNumArrayFromCSV whitespace trimming" ){
 }
 
 
+TEST_CASE( "csv_block_reader blocks concatenate to a full read" ){
+    const std::string csv = "a,b,c\n"
+                            "1,red,3\n"
+                            "\n"
+                            "4,blue,nan\n"
+                            "7,red,9,\n"
+                            "10,green,-inf\n"
+                            "13,blue,15\n";
+
+    std::stringstream ss_full(csv);
+    const auto full = ReadNumArrayFromCSV<double>(ss_full, true);
+
+    for(int64_t block_rows : { 1, 2, 3, 5, 100 }){
+        std::stringstream ss(csv);
+        csv_block_reader<double> reader(ss, true);
+        num_array<double> block;
+        int64_t row = 0;
+        while(reader.read_block(block_rows, block)){
+            REQUIRE( 0 < block.num_rows() );
+            REQUIRE( block.num_rows() <= block_rows );
+            REQUIRE( block.num_cols() == 3 );
+            for(int64_t r = 0; r < block.num_rows(); ++r, ++row){
+                for(int64_t c = 0; c < 3; ++c){
+                    const double expected = full.data.read_coeff(row, c);
+                    const double actual = block.read_coeff(r, c);
+                    REQUIRE( ((expected == actual) || (std::isnan(expected) && std::isnan(actual))) );
+                }
+            }
+        }
+        REQUIRE( row == 5 );
+        REQUIRE( reader.get_n_rows_read() == 5 );
+        REQUIRE( reader.get_n_cols() == 3 );
+
+        // Mappings are shared across blocks, and locations use rows counted from the start of the input.
+        REQUIRE( reader.string_to_int == full.string_to_int );
+        REQUIRE( reader.int_to_string == full.int_to_string );
+        REQUIRE( reader.int_to_locations == full.int_to_locations );
+        REQUIRE( reader.int_to_locations.at(reader.string_to_int.at("blue")).back() == std::make_pair<int64_t, int64_t>(4, 1) );
+
+        // Exhausted readers keep returning false.
+        REQUIRE( !reader.read_block(block_rows, block) );
+    }
+}
+
+
+TEST_CASE( "csv_block_reader rejects bad input" ){
+    SUBCASE("inconsistent columns in a later block"){
+        std::stringstream ss("1,2\n3,4\n5,6,7\n");
+        csv_block_reader<double> reader(ss);
+        num_array<double> block;
+        REQUIRE( reader.read_block(2, block) );
+        REQUIRE_THROWS_AS( reader.read_block(2, block), std::runtime_error );
+    }
+    SUBCASE("non-positive block size"){
+        std::stringstream ss("1,2\n");
+        csv_block_reader<double> reader(ss);
+        num_array<double> block;
+        REQUIRE_THROWS_AS( reader.read_block(0, block), std::invalid_argument );
+    }
+    SUBCASE("empty input"){
+        std::stringstream ss(" \n\n");
+        csv_block_reader<float> reader(ss);
+        num_array<float> block;
+        REQUIRE( !reader.read_block(10, block) );
+        REQUIRE( reader.get_n_cols() == -1 );
+    }
+    SUBCASE("negative cap on mapped strings"){
+        std::stringstream ss("1,2\n");
+        REQUIRE_THROWS_AS( csv_block_reader<double>(ss, false, {}, true, -1), std::invalid_argument );
+    }
+}
+
+
+TEST_CASE( "csv_block_reader mappings stay bounded across blocks" ){
+    // Every row repeats the same few non-numeric tokens.
+    std::stringstream csv;
+    for(int64_t i = 0; i < 1000; ++i){
+        csv << i << ",NA," << ((i % 2 == 0) ? "red" : "blue") << ",?\n";
+    }
+
+    SUBCASE("locations are not recorded when disabled"){
+        std::stringstream ss(csv.str());
+        csv_block_reader<double> reader(ss, false, {}, false);
+        num_array<double> block;
+        int64_t n_blocks = 0;
+        while(reader.read_block(10, block)){
+            ++n_blocks;
+            REQUIRE( reader.int_to_locations.empty() );
+            REQUIRE( reader.string_to_int.size() == 4 );
+            REQUIRE( reader.int_to_string.size() == 4 );
+
+            // Tokens map to the same values in every block.
+            for(int64_t r = 0; r < block.num_rows(); ++r){
+                REQUIRE( block.read_coeff(r, 1) == static_cast<double>(reader.string_to_int.at("NA")) );
+                REQUIRE( block.read_coeff(r, 3) == static_cast<double>(reader.string_to_int.at("?")) );
+            }
+        }
+        REQUIRE( n_blocks == 100 );
+    }
+
+    SUBCASE("distinct tokens beyond the cap are read as NaN"){
+        std::stringstream ss(csv.str());
+        csv_block_reader<double> reader(ss, false, {}, false, 2);
+        num_array<double> block;
+        int64_t row = 0;
+        while(reader.read_block(10, block)){
+            REQUIRE( reader.string_to_int.size() == 2 );
+            REQUIRE( reader.int_to_string.size() == 2 );
+            for(int64_t r = 0; r < block.num_rows(); ++r, ++row){
+                REQUIRE( block.read_coeff(r, 1) == static_cast<double>(reader.string_to_int.at("NA")) );
+                if(row % 2 == 0){
+                    REQUIRE( block.read_coeff(r, 2) == static_cast<double>(reader.string_to_int.at("red")) );
+                }else{
+                    REQUIRE( std::isnan(block.read_coeff(r, 2)) );
+                }
+                REQUIRE( std::isnan(block.read_coeff(r, 3)) );
+            }
+        }
+        REQUIRE( reader.get_n_rows_read() == 1000 );
+    }
+}
+
+
+TEST_CASE( "ScoreCSVStream" ){
+    std::stringstream csv;
+    csv << "x\ty\n";
+    for(int64_t i = 0; i < 1000; ++i){
+        csv << (i * 0.25) << "\t" << (i % 7) << "\n";
+    }
+
+    const std::function<num_array<double>(const num_array<double> &)> score = [](const num_array<double> &X){
+        num_array<double> out(X.num_rows(), 1);
+        for(int64_t r = 0; r < X.num_rows(); ++r){
+            out.coeff(r, 0) = X.read_coeff(r, 0) * 3.0 - X.read_coeff(r, 1) / 7.0;
+        }
+        return out;
+    };
+
+    // The scores of all rows at once, written as the Predict tools write them.
+    std::stringstream ss_full(csv.str());
+    const auto full = ReadNumArrayFromCSV<double>(ss_full, true);
+    const auto full_scores = score(full.data);
+    std::stringstream expected;
+    for(int64_t r = 0; r < full_scores.num_rows(); ++r){
+        expected << full_scores.read_coeff(r, 0) << std::endl;
+    }
+
+    SUBCASE("output matches scoring all rows at once, for any block size"){
+        for(int64_t block_rows : { 1, 7, 64, 999, 1000, 65536 }){
+            std::stringstream in(csv.str());
+            std::stringstream out;
+            const auto stats = ScoreCSVStream<double>(in, out, score, block_rows, true);
+            REQUIRE( out.str() == expected.str() );
+            REQUIRE( stats.n_rows == 1000 );
+            REQUIRE( stats.n_blocks == (1000 + block_rows - 1) / block_rows );
+            REQUIRE( 0.0 <= stats.read_seconds );
+            REQUIRE( 0.0 <= stats.wall_seconds );
+        }
+    }
+
+    SUBCASE("non-numeric tokens are mapped consistently across blocks"){
+        std::stringstream labelled;
+        labelled << "x\ty\n";
+        for(int64_t i = 0; i < 1000; ++i){
+            labelled << (i * 0.25) << "\t" << ((i % 3 == 0) ? "NA" : "b") << "\n";
+        }
+        std::stringstream ss_labelled(labelled.str());
+        const auto labelled_full = ReadNumArrayFromCSV<double>(ss_labelled, true);
+        const auto labelled_scores = score(labelled_full.data);
+        std::stringstream labelled_expected;
+        for(int64_t r = 0; r < labelled_scores.num_rows(); ++r){
+            labelled_expected << labelled_scores.read_coeff(r, 0) << std::endl;
+        }
+
+        std::stringstream in(labelled.str());
+        std::stringstream out;
+        const auto stats = ScoreCSVStream<double>(in, out, score, 7, true);
+        REQUIRE( out.str() == labelled_expected.str() );
+        REQUIRE( stats.n_rows == 1000 );
+    }
+
+    SUBCASE("empty input scores nothing"){
+        std::stringstream in("x\ty\n");
+        std::stringstream out;
+        const auto stats = ScoreCSVStream<double>(in, out, score, 10, true);
+        REQUIRE( out.str().empty() );
+        REQUIRE( stats.n_rows == 0 );
+        REQUIRE( stats.n_blocks == 0 );
+    }
+
+    SUBCASE("errors from each stage are rethrown"){
+        std::stringstream bad_in(csv.str() + "1,2,3\n");
+        std::stringstream out;
+        REQUIRE_THROWS_AS( ScoreCSVStream<double>(bad_in, out, score, 64, true), std::runtime_error );
+
+        int64_t calls = 0;
+        const std::function<num_array<double>(const num_array<double> &)> failing = [&](const num_array<double> &X){
+            if(++calls == 3) throw std::logic_error("scoring failed");
+            return score(X);
+        };
+        std::stringstream in(csv.str());
+        REQUIRE_THROWS_AS( ScoreCSVStream<double>(in, out, failing, 64, true), std::logic_error );
+
+        const std::function<num_array<double>(const num_array<double> &)> misshapen = [](const num_array<double> &X){
+            return num_array<double>(X.num_rows(), 2);
+        };
+        std::stringstream in2(csv.str());
+        REQUIRE_THROWS_AS( ScoreCSVStream<double>(in2, out, misshapen, 64, true), std::runtime_error );
+
+        std::stringstream in3(csv.str());
+        std::stringstream closed_out;
+        closed_out.setstate(std::ios::badbit);
+        REQUIRE_THROWS_AS( ScoreCSVStream<double>(in3, closed_out, score, 64, true), std::runtime_error );
+    }
+}
+
+
 TEST_CASE( "num_array subarray basic" ){
     num_array<double> m(3, 4, 0.0);
     for(int64_t r = 0; r < 3; ++r){
@@ -4,6 +4,8 @@
 #include <chrono>
 #include <limits>
 #include <stdexcept>
+#include <atomic>
+#include <thread>
 
 #include <YgorOptimizeBFGS.h>
 
@@ -307,3 +309,103 @@ TEST_CASE( "bfgs_optimizer parameter bounds" ){
         REQUIRE( std::abs(result.params[0] - 5.0) < 1.0e-4 );
     }
 }
+
+
+TEST_CASE( "bfgs_optimizer concurrent evaluation and analytic gradients" ){
+    // A coupled 4D objective with its minimum at (1, 2, 3, 4).
+    const auto cost = [](const std::vector<double> &p) -> double {
+        double sum = 0.0;
+        for(size_t i = 0UL; i < p.size(); ++i){
+            const double d = p[i] - static_cast<double>(i + 1UL);
+            sum += d * d + 0.1 * d * d * d * d;
+        }
+        const double c = (p[0] - 1.0) * (p[1] - 2.0);
+        return sum + 0.5 * c * c;
+    };
+    const auto cost_grad = [](const std::vector<double> &p) -> std::vector<double> {
+        std::vector<double> g(p.size(), 0.0);
+        for(size_t i = 0UL; i < p.size(); ++i){
+            const double d = p[i] - static_cast<double>(i + 1UL);
+            g[i] = 2.0 * d + 0.4 * d * d * d;
+        }
+        const double c = (p[0] - 1.0) * (p[1] - 2.0);
+        g[0] += c * (p[1] - 2.0);
+        g[1] += c * (p[0] - 1.0);
+        return g;
+    };
+
+    bfgs_optimizer opt;
+    opt.f = cost;
+    opt.initial_params = {-2.0, 5.0, 0.0, 7.0};
+    opt.abs_tol = 1.0e-12;
+    opt.max_iterations = 500;
+    opt.log_interval = std::chrono::hours(1);
+
+    SUBCASE("concurrent evaluation gives the same result as sequential evaluation"){
+        const auto serial = opt.optimize();
+        opt.f_is_thread_safe = true;
+        for(const int64_t n_threads : { 2, 3, 8, 0 }){
+            opt.n_threads = n_threads;
+            const auto parallel = opt.optimize();
+            REQUIRE( parallel.params == serial.params );
+            REQUIRE( parallel.cost == serial.cost );
+            REQUIRE( parallel.iterations == serial.iterations );
+        }
+        REQUIRE( serial.converged );
+        REQUIRE( serial.cost < 1.0e-6 );
+    }
+
+    SUBCASE("cost functions that are not thread-safe are never called concurrently"){
+        std::atomic<int64_t> in_flight(0);
+        std::atomic<int64_t> max_in_flight(0);
+        opt.f = [&](const std::vector<double> &p) -> double {
+            const auto n = ++in_flight;
+            if(max_in_flight < n) max_in_flight = n;
+            std::this_thread::yield();
+            --in_flight;
+            return cost(p);
+        };
+        opt.n_threads = 8;
+        opt.max_iterations = 5;
+        opt.optimize();
+        REQUIRE( max_in_flight == 1 );
+    }
+
+    SUBCASE("exceptions thrown during concurrent evaluation are propagated"){
+        opt.f = [&](const std::vector<double> &p) -> double {
+            if(p[2] < -0.5) throw std::runtime_error("out of domain");
+            return cost(p);
+        };
+        opt.initial_params = {-2.0, 5.0, -0.5 + 1.0e-7, 7.0};
+        opt.f_is_thread_safe = true;
+        opt.n_threads = 4;
+        REQUIRE_THROWS_AS( opt.optimize(), std::runtime_error );
+    }
+
+    SUBCASE("an analytic gradient replaces finite differences"){
+        int64_t f_calls = 0;
+        opt.f = [&](const std::vector<double> &p) -> double {
+            ++f_calls;
+            return cost(p);
+        };
+        const auto fd = opt.optimize();
+        const auto fd_calls = f_calls;
+
+        f_calls = 0;
+        opt.grad_f = cost_grad;
+        const auto analytic = opt.optimize();
+        REQUIRE( analytic.converged );
+        REQUIRE( analytic.cost < 1.0e-6 );
+        for(size_t i = 0UL; i < 4UL; ++i){
+            REQUIRE( std::abs(analytic.params[i] - fd.params[i]) < 1.0e-2 );
+        }
+        REQUIRE( f_calls < fd_calls );
+    }
+
+    SUBCASE("throws when the analytic gradient has the wrong size"){
+        opt.grad_f = [](const std::vector<double> &) -> std::vector<double> {
+            return {1.0, 2.0};
+        };
+        REQUIRE_THROWS_AS( opt.optimize(), std::runtime_error );
+    }
+}
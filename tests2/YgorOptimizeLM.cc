@@ -4,6 +4,8 @@
 #include <chrono>
 #include <limits>
 #include <stdexcept>
+#include <atomic>
+#include <thread>
 
 #include <YgorOptimizeLM.h>
 
@@ -331,3 +333,145 @@ TEST_CASE( "lm_optimizer parameter bounds" ){
         REQUIRE( std::abs(result.params[0] - 4.0) < 0.05 );
     }
 }
+
+
+TEST_CASE( "lm_optimizer concurrent evaluation and analytic gradients" ){
+    // A coupled 4D objective with its unconstrained minimum at (1, 2, 3, 4).
+    const auto cost = [](const std::vector<double> &p) -> double {
+        double sum = 0.0;
+        for(size_t i = 0UL; i < p.size(); ++i){
+            const double d = p[i] - static_cast<double>(i + 1UL);
+            sum += d * d + 0.1 * d * d * d * d;
+        }
+        const double c = (p[0] - 1.0) * (p[1] - 2.0);
+        return sum + 0.5 * c * c;
+    };
+    const auto cost_grad = [](const std::vector<double> &p) -> std::vector<double> {
+        std::vector<double> g(p.size(), 0.0);
+        for(size_t i = 0UL; i < p.size(); ++i){
+            const double d = p[i] - static_cast<double>(i + 1UL);
+            g[i] = 2.0 * d + 0.4 * d * d * d;
+        }
+        const double c = (p[0] - 1.0) * (p[1] - 2.0);
+        g[0] += c * (p[1] - 2.0);
+        g[1] += c * (p[0] - 1.0);
+        return g;
+    };
+
+    // The lower bound on p[0] is active at the constrained minimum (1.5, 2, 3, 4), and the optimizer starts on it, so
+    // the finite differences along p[0] are one-sided.
+    lm_optimizer opt;
+    opt.f = cost;
+    opt.initial_params = {1.5, 5.0, 0.0, 7.0};
+    opt.lower_bounds = std::vector<double>{1.5, -10.0, -10.0, -10.0};
+    opt.upper_bounds = std::vector<double>{10.0, 10.0, 10.0, 10.0};
+    opt.abs_tol = 1.0e-12;
+    opt.max_iterations = 500;
+    opt.log_interval = std::chrono::hours(1);
+
+    SUBCASE("concurrent evaluation with active bounds gives the same result as sequential evaluation"){
+        const auto serial = opt.optimize();
+        REQUIRE( serial.converged );
+        REQUIRE( serial.params[0] == 1.5 );
+        REQUIRE( std::abs(serial.params[1] - 2.0) < 1.0e-3 );
+        REQUIRE( std::abs(serial.params[2] - 3.0) < 1.0e-3 );
+        REQUIRE( std::abs(serial.params[3] - 4.0) < 1.0e-3 );
+
+        opt.f_is_thread_safe = true;
+        for(const int64_t n_threads : { 2, 3, 8, 0 }){
+            opt.n_threads = n_threads;
+            const auto parallel = opt.optimize();
+            REQUIRE( parallel.params == serial.params );
+            REQUIRE( parallel.cost == serial.cost );
+            REQUIRE( parallel.iterations == serial.iterations );
+        }
+    }
+
+    SUBCASE("cost functions that are not thread-safe are never called concurrently"){
+        std::atomic<int64_t> in_flight(0);
+        std::atomic<int64_t> max_in_flight(0);
+        opt.f = [&](const std::vector<double> &p) -> double {
+            const auto n = ++in_flight;
+            if(max_in_flight < n) max_in_flight = n;
+            std::this_thread::yield();
+            --in_flight;
+            return cost(p);
+        };
+        opt.n_threads = 8;
+        opt.max_iterations = 5;
+        opt.optimize();
+        REQUIRE( max_in_flight == 1 );
+    }
+
+    SUBCASE("steps blocked by a bound are not evaluated"){
+        // With p[1] fixed by equal bounds, both of its steps are blocked, and neither would move away from the
+        // initial parameters.
+        const std::vector<double> start = {1.5, 2.5, 0.0, 7.0};
+        opt.initial_params = start;
+        opt.lower_bounds.value()[1] = 2.5;
+        opt.upper_bounds.value()[1] = 2.5;
+        opt.max_iterations = 1;
+
+        int64_t calls_at_start = 0;
+        opt.f = [&](const std::vector<double> &p) -> double {
+            if(p == start) ++calls_at_start;
+            return cost(p);
+        };
+        const auto result = opt.optimize();
+        REQUIRE( result.params[1] == 2.5 );
+        REQUIRE( result.cost < cost(start) );
+        REQUIRE( calls_at_start == 1 );
+    }
+
+    SUBCASE("exceptions thrown during concurrent evaluation are propagated"){
+        opt.f = [&](const std::vector<double> &p) -> double {
+            if(p[2] < -0.5) throw std::runtime_error("out of domain");
+            return cost(p);
+        };
+        opt.initial_params = {1.5, 5.0, -0.5 + 1.0e-7, 7.0};
+        opt.f_is_thread_safe = true;
+        opt.n_threads = 4;
+        REQUIRE_THROWS_AS( opt.optimize(), std::runtime_error );
+    }
+
+    SUBCASE("the Hessian from an analytic gradient matches the finite-difference Hessian"){
+        // Each accepted step solves (H + lambda I) delta = -g, so the steps taken agree only if the Hessians do.
+        // Without bounds every parameter uses central differences. The coupled parameters start off their optima, so
+        // the Hessian has nonzero off-diagonal elements. A larger step keeps the rounding error of the second
+        // differences of f small.
+        opt.lower_bounds.reset();
+        opt.upper_bounds.reset();
+        opt.initial_params = {2.5, 3.0, 2.0, 4.5};
+        opt.fd_step = 1.0e-4;
+        for(const int64_t n_iter : { 1, 2, 3 }){
+            opt.max_iterations = n_iter;
+            opt.grad_f = nullptr;
+            const auto fd = opt.optimize();
+
+            int64_t f_calls = 0;
+            opt.f = [&](const std::vector<double> &p) -> double {
+                ++f_calls;
+                return cost(p);
+            };
+            opt.grad_f = cost_grad;
+            const auto analytic = opt.optimize();
+            opt.f = cost;
+
+            REQUIRE( analytic.iterations == fd.iterations );
+            for(size_t i = 0UL; i < 4UL; ++i){
+                REQUIRE( fd.params[i] != opt.initial_params[i] );
+                REQUIRE( std::abs(analytic.params[i] - fd.params[i]) < 1.0e-6 );
+            }
+
+            // Neither the gradient nor the Hessian evaluates f: only the initial and trial parameters do.
+            REQUIRE( f_calls == 1 + analytic.iterations );
+        }
+    }
+
+    SUBCASE("throws when the analytic gradient has the wrong size"){
+        opt.grad_f = [](const std::vector<double> &) -> std::vector<double> {
+            return {1.0, 2.0};
+        };
+        REQUIRE_THROWS_AS( opt.optimize(), std::runtime_error );
+    }
+}
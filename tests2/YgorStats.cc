@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <limits>
 #include <cmath>
 #include <vector>
@@ -7,9 +8,12 @@
 #include <sstream>
 #include <string>
 #include <cstdint>
+#include <list>
+#include <stdexcept>
 
 #include <YgorStats.h>
 #include <YgorMath.h>
+#include <YgorThreadPool.h>
 
 #include "doctest/doctest.h"
 
@@ -751,3 +755,303 @@ TEST_CASE( "Running_Variance_float" ){
         REQUIRE( std::abs(rv.Current_Sample_Variance() - 32.0f/7.0f) < feps );
     }
 }
+
+
+TEST_CASE( "Percentile selection and contiguous range overloads" ){
+    std::mt19937 re(13579);
+    std::normal_distribution<double> rd(10.0, 3.0);
+
+    // Reference: the definition of Percentile() applied to a fully sorted copy.
+    const auto reference = [](std::vector<double> v, double frac) -> double {
+        std::sort(v.begin(), v.end());
+        const auto N = static_cast<int64_t>(v.size()) - 1;
+        const auto M = frac * N;
+        const auto MP = std::floor(M);
+        const auto R = M - MP;
+        const auto MP_int = static_cast<int64_t>(MP);
+        if(MP_int == N) return v.back();
+        return (1.0 - R) * v[MP_int] + R * v[MP_int + 1];
+    };
+
+    for(const size_t N : { 2, 3, 10, 101, 1000 }){
+        std::vector<double> v;
+        for(size_t i = 0; i < N; ++i) v.push_back(std::round(rd(re) * 4.0) / 4.0); // Include duplicates.
+        const std::vector<double> original = v;
+        const std::list<double> l(v.begin(), v.end());
+
+        for(const double frac : { 0.0, 0.02, 0.25, 0.5, 0.7, 0.98, 1.0 }){
+            const double expected = reference(v, frac);
+            REQUIRE( Stats::Percentile(v, frac) == expected );
+            REQUIRE( Stats::Percentile(l, frac) == expected );
+            REQUIRE( Stats::Percentile(v.data(), v.data() + v.size(), frac) == expected );
+
+            std::vector<double> scratch = v;
+            REQUIRE( Stats::Percentile_In_Place(scratch.data(), scratch.data() + scratch.size(), frac) == expected );
+        }
+        REQUIRE( Stats::Median(v.data(), v.data() + v.size()) == Stats::Median(v) );
+
+        // The range overloads only read the input.
+        REQUIRE( Stats::Min(v.data(), v.data() + v.size()) == Stats::Min(v) );
+        REQUIRE( Stats::Max(v.data(), v.data() + v.size()) == Stats::Max(v) );
+        REQUIRE( std::abs(Stats::Mean(v.data(), v.data() + v.size()) - Stats::Mean(v)) < 1.0e-12 );
+        REQUIRE( v == original );
+    }
+
+    SUBCASE("integer types"){
+        const std::vector<int32_t> v = { 5, 1, 4, 2, 3 };
+        REQUIRE( Stats::Median(v.data(), v.data() + v.size()) == 3 );
+        REQUIRE( Stats::Percentile(v.data(), v.data() + v.size(), 1.0) == 5 );
+        REQUIRE( Stats::Min(v.data(), v.data() + v.size()) == 1 );
+        REQUIRE( Stats::Mean(v.data(), v.data() + v.size()) == 3 );
+    }
+
+    SUBCASE("empty and single-element ranges"){
+        const std::vector<double> empty;
+        REQUIRE( std::isnan(Stats::Percentile(empty.data(), empty.data(), 0.5)) );
+        REQUIRE( std::isnan(Stats::Min(empty.data(), empty.data())) );
+        REQUIRE( std::isnan(Stats::Mean(empty.data(), empty.data())) );
+
+        const std::vector<double> one = { 7.0 };
+        REQUIRE( Stats::Percentile(one.data(), one.data() + 1, 0.3) == 7.0 );
+    }
+}
+
+
+TEST_CASE( "Running_Quantiles" ){
+    SUBCASE("small inputs are exact"){
+        std::mt19937 re(24680);
+        std::uniform_real_distribution<double> rd(-5.0, 5.0);
+        std::vector<double> v;
+        Stats::Running_Quantiles<double> rq;
+        for(int i = 0; i < 40; ++i){
+            v.push_back(rd(re));
+            rq.Digest(v.back());
+        }
+        REQUIRE( rq.Current_Count() == 40 );
+        for(const double frac : { 0.0, 0.01, 0.1, 0.5, 0.77, 0.99, 1.0 }){
+            REQUIRE( std::abs(rq.Current_Percentile(frac) - Stats::Percentile(v, frac)) < 1.0e-12 );
+        }
+        REQUIRE( std::abs(rq.Current_Median() - Stats::Median(v)) < 1.0e-12 );
+    }
+
+    SUBCASE("large inputs are accurate, especially in the tails"){
+        std::mt19937 re(97531);
+        std::lognormal_distribution<double> rd(0.0, 1.0);
+        const size_t N = 200000;
+        std::vector<double> v;
+        v.reserve(N);
+        Stats::Running_Quantiles<double> rq;
+        for(size_t i = 0; i < N; ++i){
+            v.push_back(rd(re));
+            rq.Digest(v.back());
+        }
+        std::vector<double> sorted = v;
+        std::sort(sorted.begin(), sorted.end());
+
+        // Compare the rank of each estimate with the requested rank.
+        for(const double frac : { 0.001, 0.02, 0.25, 0.5, 0.75, 0.98, 0.999 }){
+            const double est = rq.Current_Percentile(frac);
+            const double rank = static_cast<double>(std::lower_bound(sorted.begin(), sorted.end(), est) - sorted.begin())
+                              / static_cast<double>(N);
+            const double tolerance = (frac < 0.05 || 0.95 < frac) ? 0.0005 : 0.005;
+            REQUIRE( std::abs(rank - frac) < tolerance );
+        }
+        REQUIRE( rq.Current_Percentile(0.0) == sorted.front() );
+        REQUIRE( rq.Current_Percentile(1.0) == sorted.back() );
+    }
+
+    SUBCASE("merged accumulators match a single accumulator"){
+        std::mt19937 re(11223);
+        std::normal_distribution<double> rd(0.0, 1.0);
+        const size_t N = 100000;
+        Stats::Running_Quantiles<double> all;
+        std::vector<Stats::Running_Quantiles<double>> parts(4);
+        for(size_t i = 0; i < N; ++i){
+            const double x = rd(re);
+            all.Digest(x);
+            parts[i % parts.size()].Digest(x);
+        }
+        Stats::Running_Quantiles<double> merged;
+        for(const auto &p : parts) merged.Merge(p);
+
+        REQUIRE( merged.Current_Count() == N );
+        for(const double frac : { 0.0, 0.01, 0.1, 0.5, 0.9, 0.99, 1.0 }){
+            REQUIRE( std::abs(merged.Current_Percentile(frac) - all.Current_Percentile(frac)) < 0.01 );
+        }
+
+        // Merging with itself doubles the weight without changing the distribution.
+        merged.Merge(merged);
+        REQUIRE( merged.Current_Count() == 2 * N );
+        REQUIRE( std::abs(merged.Current_Median() - all.Current_Median()) < 0.01 );
+    }
+
+    SUBCASE("edge cases"){
+        Stats::Running_Quantiles<float> rq;
+        REQUIRE( std::isnan(rq.Current_Median()) );
+
+        rq.Digest(std::numeric_limits<float>::quiet_NaN());
+        rq.Digest(std::numeric_limits<float>::infinity());
+        REQUIRE( rq.Current_Count() == 0 );
+
+        rq.Digest(3.0f);
+        REQUIRE( rq.Current_Percentile(0.0) == 3.0f );
+        REQUIRE( rq.Current_Percentile(1.0) == 3.0f );
+        REQUIRE_THROWS( rq.Current_Percentile(1.5) );
+        REQUIRE_THROWS( Stats::Running_Quantiles<double>(0.0) );
+    }
+}
+
+
+TEST_CASE( "Running accumulator block digests and merges" ){
+    std::mt19937 re(4242);
+    std::normal_distribution<double> rd(100.0, 15.0);
+    const size_t N = 100003;
+    std::vector<double> v;
+    v.reserve(N);
+    for(size_t i = 0; i < N; ++i) v.push_back(rd(re));
+    const size_t split = 37001;
+
+    SUBCASE("Running_MinMax"){
+        Stats::Running_MinMax<double> one;
+        for(const auto &x : v) one.Digest(x);
+
+        Stats::Running_MinMax<double> a;
+        Stats::Running_MinMax<double> b;
+        Stats::Running_MinMax<double> empty;
+        a.Digest(v.data(), v.data() + split);
+        b.Digest(v.data() + split, v.data() + N);
+        a.Merge(b);
+        a.Merge(empty);
+        REQUIRE( a.Current_Min() == one.Current_Min() );
+        REQUIRE( a.Current_Max() == one.Current_Max() );
+    }
+
+    SUBCASE("Running_Sum"){
+        Stats::Running_Sum<double> one;
+        for(const auto &x : v) one.Digest(x);
+
+        Stats::Running_Sum<double> a;
+        Stats::Running_Sum<double> b;
+        a.Digest(v.data(), v.data() + split);
+        b.Digest(v.data() + split, v.data() + N);
+        a.Merge(b);
+        REQUIRE( std::abs(a.Current_Sum() - one.Current_Sum()) < 1.0e-12 * std::abs(one.Current_Sum()) );
+
+        const auto before = a.Current_Sum();
+        a.Merge(a);
+        REQUIRE( std::abs(a.Current_Sum() - 2.0 * before) < 1.0e-12 * std::abs(before) );
+
+        const std::vector<int64_t> ints = { 1, -2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+        Stats::Running_Sum<int64_t> rs;
+        rs.Digest(ints.data(), ints.data() + ints.size());
+        REQUIRE( rs.Current_Sum() == 62 );
+    }
+
+    SUBCASE("Running_Variance"){
+        Stats::Running_Variance<double> one;
+        for(const auto &x : v) one.Digest(x);
+
+        Stats::Running_Variance<double> block;
+        block.Digest(v.data(), v.data() + N);
+        REQUIRE( block.Current_Count() == N );
+        REQUIRE( std::abs(block.Current_Mean() - one.Current_Mean()) < 1.0e-12 * std::abs(one.Current_Mean()) );
+        REQUIRE( std::abs(block.Current_Variance() - one.Current_Variance()) < 1.0e-10 * one.Current_Variance() );
+
+        Stats::Running_Variance<double> a;
+        Stats::Running_Variance<double> b;
+        for(size_t i = 0; i < split; ++i) a.Digest(v[i]);
+        for(size_t i = split; i < N; ++i) b.Digest(v[i]);
+        a.Merge(b);
+        REQUIRE( a.Current_Count() == N );
+        REQUIRE( std::abs(a.Current_Mean() - one.Current_Mean()) < 1.0e-12 * std::abs(one.Current_Mean()) );
+        REQUIRE( std::abs(a.Current_Sample_Variance() - one.Current_Sample_Variance())
+                 < 1.0e-10 * one.Current_Sample_Variance() );
+
+        // Merging with itself doubles the count without changing the mean or population variance.
+        a.Merge(a);
+        REQUIRE( a.Current_Count() == 2 * N );
+        REQUIRE( std::abs(a.Current_Mean() - one.Current_Mean()) < 1.0e-12 * std::abs(one.Current_Mean()) );
+        REQUIRE( std::abs(a.Current_Variance() - one.Current_Variance()) < 1.0e-10 * one.Current_Variance() );
+
+        // Empty accumulators are identities.
+        Stats::Running_Variance<double> empty;
+        empty.Merge(block);
+        block.Merge(Stats::Running_Variance<double>());
+        REQUIRE( empty.Current_Mean() == block.Current_Mean() );
+        REQUIRE( empty.Current_Variance() == block.Current_Variance() );
+    }
+
+    SUBCASE("Running_Variance merges parts with very different means"){
+        // [2,4,4,4] and [5,5,7,9], offset by a large constant: mean 5 + offset, population variance 4.
+        const double offset = 1.0e9;
+        const std::vector<double> lo = { 2.0 + offset, 4.0 + offset, 4.0 + offset, 4.0 + offset };
+        const std::vector<double> hi = { 5.0 + offset, 5.0 + offset, 7.0 + offset, 9.0 + offset };
+        Stats::Running_Variance<double> a;
+        Stats::Running_Variance<double> b;
+        a.Digest(lo.data(), lo.data() + lo.size());
+        b.Digest(hi.data(), hi.data() + hi.size());
+        a.Merge(b);
+        REQUIRE( std::abs(a.Current_Mean() - (5.0 + offset)) < 1.0e-6 );
+        REQUIRE( std::abs(a.Current_Variance() - 4.0) < 1.0e-6 );
+    }
+
+    SUBCASE("float"){
+        std::vector<float> f(v.begin(), v.end());
+        Stats::Running_Variance<float> one;
+        for(const auto &x : f) one.Digest(x);
+        Stats::Running_Variance<float> block;
+        block.Digest(f.data(), f.data() + f.size());
+        REQUIRE( std::abs(block.Current_Mean() - one.Current_Mean()) < 1.0e-3f );
+        REQUIRE( std::abs(block.Current_Variance() - one.Current_Variance()) < 1.0e-2f );
+    }
+}
+
+
+TEST_CASE( "parallel_reduce" ){
+    std::mt19937 re(8642);
+    std::uniform_real_distribution<double> rd(-1.0, 3.0);
+    std::vector<double> v(250001);
+    for(auto &x : v) x = rd(re);
+    const auto n = static_cast<int64_t>(v.size());
+
+    const auto accumulate = [&](Stats::Running_Variance<double> &acc, int64_t first, int64_t last){
+        acc.Digest(v.data() + first, v.data() + last);
+    };
+    const auto merge = [](Stats::Running_Variance<double> &acc, const Stats::Running_Variance<double> &other){
+        acc.Merge(other);
+    };
+
+    SUBCASE("results do not depend on the number of threads"){
+        const auto ref = parallel_reduce(n, 10000, Stats::Running_Variance<double>(), accumulate, merge, 1);
+        REQUIRE( ref.Current_Count() == static_cast<uint64_t>(n) );
+        REQUIRE( std::abs(ref.Current_Mean() - 1.0) < 0.01 );
+        REQUIRE( std::abs(ref.Current_Variance() - 16.0 / 12.0) < 0.01 );
+
+        for(const int64_t n_workers : { 2, 3, 8, 0 }){
+            const auto out = parallel_reduce(n, 10000, Stats::Running_Variance<double>(), accumulate, merge, n_workers);
+            REQUIRE( out.Current_Count() == ref.Current_Count() );
+            REQUIRE( out.Current_Mean() == ref.Current_Mean() );
+            REQUIRE( out.Current_Variance() == ref.Current_Variance() );
+        }
+    }
+
+    SUBCASE("ranges are covered exactly once"){
+        const auto count = parallel_reduce(static_cast<int64_t>(1001), 7, static_cast<int64_t>(0),
+            [](int64_t &acc, int64_t first, int64_t last){ acc += last - first; },
+            [](int64_t &acc, const int64_t &other){ acc += other; }, 4);
+        REQUIRE( count == 1001 );
+
+        const auto none = parallel_reduce(static_cast<int64_t>(0), 7, static_cast<int64_t>(5),
+            [](int64_t &acc, int64_t first, int64_t last){ acc += last - first; },
+            [](int64_t &acc, const int64_t &other){ acc += other; }, 4);
+        REQUIRE( none == 5 );
+    }
+
+    SUBCASE("errors are rethrown"){
+        REQUIRE_THROWS_AS( parallel_reduce(n, 0, Stats::Running_Variance<double>(), accumulate, merge, 2),
+                           std::invalid_argument );
+        REQUIRE_THROWS_AS( parallel_reduce(static_cast<int64_t>(100), 10, static_cast<int64_t>(0),
+            [](int64_t &, int64_t first, int64_t){ if(first == 50) throw std::runtime_error("chunk failed"); },
+            [](int64_t &acc, const int64_t &other){ acc += other; }, 3), std::runtime_error );
+    }
+}
@@ -8,6 +8,7 @@
 #include <YgorStatsCITrees.h>
 
 #include "doctest/doctest.h"
+#include "YgorStatsTreeModels.h"
 
 
 TEST_CASE( "ConditionalInferenceTrees constructor" ){
@@ -919,3 +920,100 @@ TEST_CASE( "ConditionalInferenceTrees write_to and read_from with float" ){
         REQUIRE( pred_original == pred_loaded );
     }
 }
+
+
+TEST_CASE( "ConditionalInferenceTrees predict_batch" ){
+    num_array<double> X;
+    num_array<double> y;
+    tree_model_testing::make_training_data(400, X, y);
+
+    Stats::ConditionalInferenceTrees<double> model(8, 2, 0.05, 200, 11);
+    REQUIRE_THROWS( model.predict_batch(X) );
+    model.fit(X, y);
+    const auto X_test = tree_model_testing::make_test_inputs();
+
+    SUBCASE("results match a recursive walk of the trees"){
+        tree_model_testing::check_predict_batch(model, X_test);
+    }
+
+    SUBCASE("deserialized models predict identically"){
+        std::stringstream ss;
+        REQUIRE( model.write_to(ss) );
+        Stats::ConditionalInferenceTrees<double> model2;
+        REQUIRE( model2.read_from(ss) );
+        tree_model_testing::check_predict_batch(model2, X_test);
+
+        const auto p1 = model.predict_batch(X_test);
+        const auto p2 = model2.predict_batch(X_test);
+        for(int64_t i = 0; i < X_test.num_rows(); ++i){
+            REQUIRE( p1.read_coeff(i, 0) == p2.read_coeff(i, 0) );
+        }
+    }
+
+    SUBCASE("wrong number of features is rejected"){
+        num_array<double> X_bad(5, 2);
+        REQUIRE_THROWS( model.predict_batch(X_bad) );
+    }
+}
+
+
+TEST_CASE( "ConditionalInferenceTrees binary model format" ){
+    num_array<double> X;
+    num_array<double> y;
+    tree_model_testing::make_training_data(300, X, y);
+
+    Stats::ConditionalInferenceTrees<double> model(8, 2, 0.05, 200, 11);
+    tree_model_testing::check_binary_model_format(model, X, y,
+                                                  Stats::BinaryModelKind::conditional_inference_trees,
+                                                  Stats::BinaryModelKind::stochastic_forests);
+}
+
+
+TEST_CASE( "ConditionalInferenceTrees selection tests" ){
+    num_array<double> X(600, 3);
+    num_array<double> y(600, 1);
+    for(int64_t i = 0; i < 600; ++i){
+        X.coeff(i, 0) = std::sin(0.37 * i) * 4.0;
+        X.coeff(i, 1) = static_cast<double>(i % 9);
+        X.coeff(i, 2) = std::cos(0.05 * i);
+        y.coeff(i, 0) = (X.read_coeff(i, 0) < 0.0 ? -2.0 : 2.0) + 0.3 * std::sin(1.7 * i);
+    }
+
+    Stats::ConditionalInferenceTrees<double> model(6, 2, 0.05, 500, 11);
+    REQUIRE( model.get_selection_test() == Stats::SelectionTest::sequential );
+    REQUIRE( model.get_n_threads() == 0 );
+
+    SUBCASE("every method recovers the informative feature"){
+        for(const auto m : { Stats::SelectionTest::permutation,
+                             Stats::SelectionTest::sequential,
+                             Stats::SelectionTest::asymptotic }){
+            model.set_selection_test(m);
+            REQUIRE( model.get_selection_test() == m );
+            model.fit(X, y);
+
+            num_array<double> x(1, 3);
+            x.coeff(0, 1) = 4.0;
+            x.coeff(0, 2) = 0.0;
+            x.coeff(0, 0) = -3.0;
+            REQUIRE( model.predict(x) < -1.0 );
+            x.coeff(0, 0) = 3.0;
+            REQUIRE( model.predict(x) > 1.0 );
+        }
+    }
+
+    SUBCASE("fitted trees do not depend on the number of threads"){
+        for(const auto m : { Stats::SelectionTest::permutation, Stats::SelectionTest::sequential }){
+            model.set_selection_test(m);
+            std::string expected;
+            for(const int64_t n : { 1, 2, 4 }){
+                model.set_n_threads(n);
+                REQUIRE( model.get_n_threads() == n );
+                model.fit(X, y);
+                std::stringstream ss;
+                REQUIRE( model.write_to(ss) );
+                if(expected.empty()) expected = ss.str();
+                REQUIRE( ss.str() == expected );
+            }
+        }
+    }
+}
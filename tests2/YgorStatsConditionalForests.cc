@@ -2,11 +2,13 @@
 #include <cmath>
 #include <limits>
 #include <sstream>
+#include <string>
 
 #include <YgorMath.h>
 #include <YgorStatsConditionalForests.h>
 
 #include "doctest/doctest.h"
+#include "YgorStatsTreeModels.h"
 
 
 TEST_CASE( "ConditionalRandomForests constructor" ){
@@ -1217,3 +1219,96 @@ TEST_CASE( "ConditionalRandomForests importance compute with mismatched dimensio
         REQUIRE_THROWS( cf.compute_importance(X2, y2) );
     }
 }
+
+
+TEST_CASE( "ConditionalRandomForests predict_batch" ){
+    num_array<double> X;
+    num_array<double> y;
+    tree_model_testing::make_training_data(400, X, y);
+
+    Stats::ConditionalRandomForests<double> model(6, 6, 2, 0.05, 100, -1, 0.632, 0.2, 11);
+    REQUIRE_THROWS( model.predict_batch(X) );
+    model.fit(X, y);
+    const auto X_test = tree_model_testing::make_test_inputs();
+
+    SUBCASE("results match a recursive walk of the trees"){
+        tree_model_testing::check_predict_batch(model, X_test);
+    }
+
+    SUBCASE("deserialized models predict identically"){
+        std::stringstream ss;
+        REQUIRE( model.write_to(ss) );
+        Stats::ConditionalRandomForests<double> model2;
+        REQUIRE( model2.read_from(ss) );
+        tree_model_testing::check_predict_batch(model2, X_test);
+
+        const auto p1 = model.predict_batch(X_test);
+        const auto p2 = model2.predict_batch(X_test);
+        for(int64_t i = 0; i < X_test.num_rows(); ++i){
+            REQUIRE( p1.read_coeff(i, 0) == p2.read_coeff(i, 0) );
+        }
+    }
+
+    SUBCASE("wrong number of features is rejected"){
+        num_array<double> X_bad(5, 2);
+        REQUIRE_THROWS( model.predict_batch(X_bad) );
+    }
+}
+
+
+TEST_CASE( "ConditionalRandomForests binary model format" ){
+    num_array<double> X;
+    num_array<double> y;
+    tree_model_testing::make_training_data(300, X, y);
+
+    Stats::ConditionalRandomForests<double> model(6, 6, 2, 0.05, 100, -1, 0.632, 0.2, 11);
+    tree_model_testing::check_binary_model_format(model, X, y,
+                                                  Stats::BinaryModelKind::conditional_random_forests,
+                                                  Stats::BinaryModelKind::conditional_inference_trees);
+
+    // The importances are stored along with the trees.
+    std::stringstream bin;
+    REQUIRE( model.write_binary(bin) );
+    Stats::ConditionalRandomForests<double> model2;
+    REQUIRE( model2.read_binary(bin) );
+    REQUIRE( model2.get_feature_importances() == model.get_feature_importances() );
+}
+
+
+TEST_CASE( "ConditionalRandomForests importances do not depend on threads or cached grids" ){
+    num_array<double> X(300, 4);
+    num_array<double> y(300, 1);
+    for(int64_t i = 0; i < 300; ++i){
+        X.coeff(i, 0) = std::sin(0.37 * i) * 4.0;
+        X.coeff(i, 1) = X.read_coeff(i, 0) + 0.5 * std::cos(1.3 * i);  // Correlated with feature 0.
+        X.coeff(i, 2) = static_cast<double>(i % 9);
+        X.coeff(i, 3) = std::cos(0.05 * i);
+        y.coeff(i, 0) = X.read_coeff(i, 0) + 0.3 * X.read_coeff(i, 2);
+    }
+
+    for(const auto method : { Stats::ConditionalImportanceMethod::permutation,
+                              Stats::ConditionalImportanceMethod::conditional }){
+        Stats::ConditionalRandomForests<double> model(8, 6, 2, 0.05, 100, -1, 0.632, 0.2, 11);
+        model.set_importance_method(method);
+        model.set_n_threads(1);
+        model.fit(X, y);
+        model.compute_importance(X, y);
+        const auto expected = model.get_feature_importances();
+        REQUIRE( expected.size() == 4 );
+        REQUIRE( expected[0] > expected[3] );
+
+        for(const int64_t n : { 2, 5 }){
+            model.set_n_threads(n);
+            model.compute_importance(X, y);
+            REQUIRE( model.get_feature_importances() == expected );
+        }
+
+        // Grids are rebuilt on demand for deserialized models.
+        std::stringstream ss;
+        REQUIRE( model.write_to(ss) );
+        Stats::ConditionalRandomForests<double> model2;
+        REQUIRE( model2.read_from(ss) );
+        model2.compute_importance(X, y);
+        REQUIRE( model2.get_feature_importances() == expected );
+    }
+}
@@ -0,0 +1,135 @@
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <YgorStatsPermutationTests.h>
+
+#include "doctest/doctest.h"
+
+
+namespace {
+    // Centred features and response, and the statistics the test needs, for y = slope * x_0 + noise.
+    struct test_data {
+        std::vector<std::vector<double>> x_dev;
+        std::vector<const double *> x_ptrs;
+        std::vector<double> inv_sqrt_x_ss;
+        std::vector<double> y_dev;
+        double y_ss = 0.0;
+        double obs_max = 0.0;
+    };
+
+    test_data make_data(int64_t n_samples, int64_t n_features, double slope, uint64_t seed){
+        std::mt19937 re(seed);
+        std::normal_distribution<double> nd(0.0, 1.0);
+
+        test_data d;
+        d.x_dev.assign(n_features, std::vector<double>(n_samples));
+        for(auto &x : d.x_dev){
+            for(auto &v : x) v = nd(re);
+        }
+        d.y_dev.resize(n_samples);
+        for(int64_t i = 0; i < n_samples; ++i) d.y_dev[i] = slope * d.x_dev[0][i] + nd(re);
+
+        const auto centre = [](std::vector<double> &v){
+            double mean = 0.0;
+            for(const auto x : v) mean += x;
+            mean /= static_cast<double>(v.size());
+            double ss = 0.0;
+            for(auto &x : v){
+                x -= mean;
+                ss += x * x;
+            }
+            return ss;
+        };
+        d.y_ss = centre(d.y_dev);
+        for(auto &x : d.x_dev){
+            const double inv = 1.0 / std::sqrt(centre(x));
+            double xy = 0.0;
+            for(int64_t i = 0; i < n_samples; ++i) xy += x[i] * d.y_dev[i];
+            d.obs_max = std::max(d.obs_max, std::abs(xy) * inv);
+            d.inv_sqrt_x_ss.push_back(inv);
+            d.x_ptrs.push_back(x.data());
+        }
+        return d;
+    }
+
+    double pvalue(const test_data &d, Stats::SelectionTest method, int64_t n_permutations, int64_t n_threads,
+                  uint64_t seed = 7){
+        Stats::MaxTypeTest<double> test(method, n_permutations, 0.05, n_threads);
+        return test.pvalue(d.x_ptrs, d.inv_sqrt_x_ss, d.y_dev, d.y_ss, d.obs_max, seed);
+    }
+}
+
+TEST_CASE( "MaxTypeTest constructor validation" ){
+    REQUIRE_THROWS_AS( Stats::MaxTypeTest<double>(Stats::SelectionTest::permutation, 0, 0.05, 1), std::invalid_argument );
+    REQUIRE_THROWS_AS( Stats::MaxTypeTest<double>(Stats::SelectionTest::permutation, 100, 0.0, 1), std::invalid_argument );
+    REQUIRE_THROWS_AS( Stats::MaxTypeTest<float>(Stats::SelectionTest::sequential, 100, 1.0f, 1), std::invalid_argument );
+    REQUIRE_NOTHROW( Stats::MaxTypeTest<float>(Stats::SelectionTest::asymptotic, 1, 0.5f, 0) );
+}
+
+TEST_CASE( "MaxTypeTest p-values" ){
+    const auto strong = make_data(400, 3, 1.0, 1);
+    const auto none = make_data(400, 3, 0.0, 2);
+
+    SUBCASE("permutation p-values have the form (b+1)/(B+1)"){
+        for(const auto *d : { &strong, &none }){
+            const double p = pvalue(*d, Stats::SelectionTest::permutation, 999, 1);
+            REQUIRE( 0.0 < p );
+            REQUIRE( p <= 1.0 );
+            REQUIRE( std::abs(p * 1000.0 - std::round(p * 1000.0)) < 1e-6 );
+        }
+        REQUIRE( pvalue(strong, Stats::SelectionTest::permutation, 999, 1) == 1.0 / 1000.0 );
+    }
+
+    SUBCASE("all methods agree on clear outcomes"){
+        for(const auto m : { Stats::SelectionTest::permutation,
+                             Stats::SelectionTest::sequential,
+                             Stats::SelectionTest::asymptotic }){
+            REQUIRE( pvalue(strong, m, 1000, 1) < 0.05 );
+            REQUIRE( 0.05 <= pvalue(none, m, 1000, 1) );
+        }
+    }
+
+    SUBCASE("the sequential test stops early on clear outcomes"){
+        // Permutations are drawn from the same streams regardless of the limit, so a test that stops before reaching
+        // the smaller limit gives the same result with either limit.
+        REQUIRE( pvalue(none, Stats::SelectionTest::sequential, 1000, 1)
+                 == pvalue(none, Stats::SelectionTest::sequential, 50, 1) );
+        REQUIRE( pvalue(strong, Stats::SelectionTest::sequential, 1000, 1)
+                 == pvalue(strong, Stats::SelectionTest::sequential, 150, 1) );
+
+        // Without an early stop, the sequential and permutation tests are identical.
+        REQUIRE( pvalue(none, Stats::SelectionTest::sequential, 5, 1)
+                 == pvalue(none, Stats::SelectionTest::permutation, 5, 1) );
+    }
+
+    SUBCASE("the asymptotic test approximates the permutation test"){
+        for(uint64_t seed = 10; seed < 15; ++seed){
+            const auto d = make_data(500, 1, 0.05, seed);
+            const double p_perm = pvalue(d, Stats::SelectionTest::permutation, 4000, 1, seed);
+            const double p_asym = pvalue(d, Stats::SelectionTest::asymptotic, 4000, 1, seed);
+            REQUIRE( std::abs(p_perm - p_asym) < 0.04 );
+        }
+    }
+
+    SUBCASE("results do not depend on the number of threads"){
+        const auto weak = make_data(2000, 4, 0.04, 3);
+        for(const auto m : { Stats::SelectionTest::permutation, Stats::SelectionTest::sequential }){
+            for(const auto *d : { &strong, &none, &weak }){
+                const double p1 = pvalue(*d, m, 500, 1);
+                REQUIRE( p1 == pvalue(*d, m, 500, 3) );
+                REQUIRE( p1 == pvalue(*d, m, 500, 8) );
+            }
+        }
+    }
+
+    SUBCASE("degenerate inputs are not significant"){
+        Stats::MaxTypeTest<double> test(Stats::SelectionTest::permutation, 100, 0.05, 1);
+        REQUIRE( test.pvalue({}, {}, strong.y_dev, strong.y_ss, strong.obs_max, 1) == 1.0 );
+        REQUIRE( test.pvalue(strong.x_ptrs, strong.inv_sqrt_x_ss, strong.y_dev, 0.0, strong.obs_max, 1) == 1.0 );
+        REQUIRE_THROWS( test.pvalue(strong.x_ptrs, {}, strong.y_dev, strong.y_ss, strong.obs_max, 1) );
+    }
+}
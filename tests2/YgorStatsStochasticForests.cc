@@ -1,11 +1,14 @@
 
 #include <cmath>
 #include <limits>
+#include <sstream>
+#include <string>
 
 #include <YgorMath.h>
 #include <YgorStatsStochasticForests.h>
 
 #include "doctest/doctest.h"
+#include "YgorStatsTreeModels.h"
 
 
 TEST_CASE( "StochasticForests constructor" ){
@@ -290,6 +293,129 @@ TEST_CASE( "StochasticForests reproducibility with same seed" ){
 }
 
 
+TEST_CASE( "StochasticForests results do not depend on the number of threads" ){
+    num_array<double> X(60, 3);
+    num_array<double> y(60, 1);
+    for(int64_t i = 0; i < 60; ++i){
+        X.coeff(i, 0) = std::sin(0.3 * i);
+        X.coeff(i, 1) = static_cast<double>(i % 7);
+        X.coeff(i, 2) = std::cos(0.1 * i);
+        y.coeff(i, 0) = X.read_coeff(i, 0) + 0.5 * X.read_coeff(i, 1) - X.read_coeff(i, 2);
+    }
+
+    for(const auto split : { Stats::SplitMethod::exact, Stats::SplitMethod::histogram })
+    for(const auto method : { Stats::ImportanceMethod::gini, Stats::ImportanceMethod::permutation }){
+        Stats::StochasticForests<double> rf1(40, 6, 2, 2, 2024);
+        rf1.set_importance_method(method);
+        rf1.set_split_method(split);
+        rf1.set_n_threads(1);
+        rf1.fit(X, y);
+
+        Stats::StochasticForests<double> rf4(40, 6, 2, 2, 2024);
+        rf4.set_importance_method(method);
+        rf4.set_split_method(split);
+        rf4.set_n_threads(4);
+        REQUIRE( rf4.get_n_threads() == 4 );
+        rf4.fit(X, y);
+
+        if(method == Stats::ImportanceMethod::permutation){
+            rf1.compute_permutation_importance(X, y);
+            rf4.compute_permutation_importance(X, y);
+        }
+        REQUIRE( rf1.get_feature_importances() == rf4.get_feature_importances() );
+
+        std::stringstream ss1, ss4;
+        REQUIRE( rf1.write_to(ss1) );
+        REQUIRE( rf4.write_to(ss4) );
+        REQUIRE( ss1.str() == ss4.str() );
+    }
+}
+
+
+TEST_CASE( "StochasticForests histogram split method" ){
+    Stats::StochasticForests<double> rf_default;
+    REQUIRE( rf_default.get_split_method() == Stats::SplitMethod::exact );
+
+    SUBCASE("features with few distinct values give the same model as the exact method"){
+        // Integer-valued data with a zero-mean output keeps all running sums exact, so both methods rank candidate
+        // splits identically and select the same partitions. Both the per-feature and the subtracted histograms are exercised.
+        const int64_t n_samples = 300;
+        num_array<double> X(n_samples, 4);
+        num_array<double> y(n_samples, 1);
+        for(int64_t i = 0; i < n_samples; ++i){
+            X.coeff(i, 0) = static_cast<double>(i % 17);
+            X.coeff(i, 1) = static_cast<double>((i * 7) % 11);
+            X.coeff(i, 2) = static_cast<double>((i * 13) % 5);
+            X.coeff(i, 3) = static_cast<double>((i / 3) % 23);
+            y.coeff(i, 0) = ((i % 2) == 0 ? 1.0 : -1.0) * static_cast<double>((i / 2) % 9);
+        }
+
+        for(const int64_t max_features : { 1, 4 }){
+            Stats::StochasticForests<double> rf_exact(10, 6, 2, max_features, 31);
+            rf_exact.set_importance_method(Stats::ImportanceMethod::gini);
+            rf_exact.fit(X, y);
+
+            Stats::StochasticForests<double> rf_hist(10, 6, 2, max_features, 31);
+            rf_hist.set_importance_method(Stats::ImportanceMethod::gini);
+            rf_hist.set_split_method(Stats::SplitMethod::histogram);
+            REQUIRE( rf_hist.get_split_method() == Stats::SplitMethod::histogram );
+            rf_hist.fit(X, y);
+
+            // Thresholds may differ when a node lacks some of the values between two bin edges, but the tree shapes,
+            // split features, and leaf values do not.
+            REQUIRE( rf_exact.get_feature_importances() == rf_hist.get_feature_importances() );
+            std::stringstream ss_exact, ss_hist;
+            REQUIRE( rf_exact.write_to(ss_exact) );
+            REQUIRE( rf_hist.write_to(ss_hist) );
+            std::string l_exact, l_hist;
+            while(std::getline(ss_exact, l_exact)){
+                REQUIRE( std::getline(ss_hist, l_hist) );
+                if( (l_exact.rfind("I ", 0) == 0) && (l_hist.rfind("I ", 0) == 0) ){
+                    l_exact = l_exact.substr(0, l_exact.rfind(' '));
+                    l_hist = l_hist.substr(0, l_hist.rfind(' '));
+                }
+                REQUIRE( l_exact == l_hist );
+            }
+            REQUIRE( !std::getline(ss_hist, l_hist) );
+        }
+    }
+
+    SUBCASE("accuracy is comparable to the exact method"){
+        // Many distinct values, so features are quantized.
+        const int64_t n_samples = 2000;
+        num_array<double> X(n_samples, 3);
+        num_array<double> y(n_samples, 1);
+        for(int64_t i = 0; i < n_samples; ++i){
+            X.coeff(i, 0) = std::sin(0.37 * i) * 5.0;
+            X.coeff(i, 1) = std::cos(0.11 * i) * 3.0;
+            X.coeff(i, 2) = std::fmod(0.731 * i, 1.0);
+            y.coeff(i, 0) = 2.0 * X.read_coeff(i, 0) + X.read_coeff(i, 1) * X.read_coeff(i, 1);
+        }
+
+        const auto test_mse = [&](Stats::SplitMethod method){
+            Stats::StochasticForests<double> rf(30, 10, 2, 3, 5);
+            rf.set_split_method(method);
+            rf.fit(X, y);
+            double mse = 0.0;
+            num_array<double> x(1, 3);
+            for(int64_t i = 0; i < 200; ++i){
+                x.coeff(0, 0) = std::sin(0.5 * i + 0.2) * 5.0;
+                x.coeff(0, 1) = std::cos(0.3 * i) * 3.0;
+                x.coeff(0, 2) = 0.5;
+                const double expected = 2.0 * x.read_coeff(0, 0) + x.read_coeff(0, 1) * x.read_coeff(0, 1);
+                const double err = rf.predict(x) - expected;
+                mse += err * err / 200.0;
+            }
+            return mse;
+        };
+        const double mse_exact = test_mse(Stats::SplitMethod::exact);
+        const double mse_hist = test_mse(Stats::SplitMethod::histogram);
+        REQUIRE( mse_exact < 1.0 );
+        REQUIRE( mse_hist < 1.5 * mse_exact + 0.05 );
+    }
+}
+
+
 TEST_CASE( "StochasticForests with few samples" ){
     // Test with minimal number of samples.
     Stats::StochasticForests<double> rf(10, 3, 2, -1, 111);
@@ -810,3 +936,58 @@ TEST_CASE( "StochasticForests serialization with permutation importance" ){
     x_test.coeff(0, 1) = 0.5;
     REQUIRE( rf.predict(x_test) == rf_loaded.predict(x_test) );
 }
+
+
+TEST_CASE( "StochasticForests predict_batch" ){
+    num_array<double> X;
+    num_array<double> y;
+    tree_model_testing::make_training_data(400, X, y);
+
+    Stats::StochasticForests<double> model(7, 8, 2, 2, 11);
+    model.set_n_threads(3);
+    REQUIRE_THROWS( model.predict_batch(X) );
+    model.fit(X, y);
+    const auto X_test = tree_model_testing::make_test_inputs();
+
+    SUBCASE("results match a recursive walk of the trees"){
+        tree_model_testing::check_predict_batch(model, X_test);
+    }
+
+    SUBCASE("deserialized models predict identically"){
+        std::stringstream ss;
+        REQUIRE( model.write_to(ss) );
+        Stats::StochasticForests<double> model2;
+        REQUIRE( model2.read_from(ss) );
+        tree_model_testing::check_predict_batch(model2, X_test);
+
+        const auto p1 = model.predict_batch(X_test);
+        const auto p2 = model2.predict_batch(X_test);
+        for(int64_t i = 0; i < X_test.num_rows(); ++i){
+            REQUIRE( p1.read_coeff(i, 0) == p2.read_coeff(i, 0) );
+        }
+    }
+
+    SUBCASE("wrong number of features is rejected"){
+        num_array<double> X_bad(5, 2);
+        REQUIRE_THROWS( model.predict_batch(X_bad) );
+    }
+}
+
+
+TEST_CASE( "StochasticForests binary model format" ){
+    num_array<double> X;
+    num_array<double> y;
+    tree_model_testing::make_training_data(300, X, y);
+
+    Stats::StochasticForests<double> model(7, 8, 2, 2, 11);
+    tree_model_testing::check_binary_model_format(model, X, y,
+                                                  Stats::BinaryModelKind::stochastic_forests,
+                                                  Stats::BinaryModelKind::conditional_random_forests);
+
+    // The importances are stored along with the trees.
+    std::stringstream bin;
+    REQUIRE( model.write_binary(bin) );
+    Stats::StochasticForests<double> model2;
+    REQUIRE( model2.read_binary(bin) );
+    REQUIRE( model2.get_feature_importances() == model.get_feature_importances() );
+}
@@ -0,0 +1,231 @@
+//YgorStatsTreeModels.h - Fixtures shared by the tests of the tree regressors (StochasticForests,
+// ConditionalRandomForests, and ConditionalInferenceTrees).
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <YgorMath.h>
+#include <YgorStatsFlatTrees.h>
+
+#include "doctest/doctest.h"
+
+namespace tree_model_testing {
+
+// Training data: three features and a response with an interaction between two of them.
+inline void make_training_data(int64_t n_rows, num_array<double> &X, num_array<double> &y){
+    X = num_array<double>(n_rows, 3);
+    y = num_array<double>(n_rows, 1);
+    for(int64_t i = 0; i < n_rows; ++i){
+        X.coeff(i, 0) = std::sin(0.37 * i) * 4.0;
+        X.coeff(i, 1) = static_cast<double>(i % 9);
+        X.coeff(i, 2) = std::cos(0.05 * i);
+        y.coeff(i, 0) = X.read_coeff(i, 0) + 0.5 * X.read_coeff(i, 1) * X.read_coeff(i, 2);
+    }
+}
+
+// Inputs for the training data's features, including rows outside the training range and a missing value, and
+// enough rows to span several of predict_batch()'s blocks.
+inline num_array<double> make_test_inputs(){
+    num_array<double> X(700, 3);
+    for(int64_t i = 0; i < 700; ++i){
+        X.coeff(i, 0) = std::sin(0.91 * i) * 6.0;
+        X.coeff(i, 1) = static_cast<double>(i % 11) - 1.0;
+        X.coeff(i, 2) = std::cos(0.13 * i) * 1.5;
+    }
+    X.coeff(3, 0) = std::numeric_limits<double>::quiet_NaN();
+    return X;
+}
+
+// A tree node read back from the text model format, which is written from the models' linked trees.
+struct reference_node {
+    bool is_leaf = true;
+    int64_t feature = -1;
+    double value = 0.0; // The leaf value or split threshold.
+    std::unique_ptr<reference_node> left;
+    std::unique_ptr<reference_node> right;
+};
+
+inline std::unique_ptr<reference_node> read_reference_node(std::istream &is, std::string node_type){
+    auto node = std::make_unique<reference_node>();
+    std::string val_str;
+    if(node_type == "L"){
+        is >> val_str;
+        node->value = std::stod(val_str);
+    }else if(node_type == "I"){
+        node->is_leaf = false;
+        is >> node->feature >> val_str;
+        node->value = std::stod(val_str);
+        is >> node_type;
+        node->left = read_reference_node(is, node_type);
+        is >> node_type;
+        node->right = read_reference_node(is, node_type);
+    }else{
+        FAIL("Unrecognized node type '" << node_type << "'");
+    }
+    REQUIRE( !is.fail() );
+    return node;
+}
+
+// A plain recursive walk, as the models evaluated their linked trees before they were flattened. Missing values
+// fail the comparison and go right.
+inline double walk_reference_tree(const reference_node *node, const num_array<double> &X, int64_t row){
+    while(!node->is_leaf){
+        node = (X.read_coeff(row, node->feature) <= node->value) ? node->left.get()
+                                                                 : node->right.get();
+    }
+    return node->value;
+}
+
+// Predictions computed independently of the models' flattened trees: the trees are parsed from the text format and
+// each is walked recursively, and the tree outputs are averaged in order.
+template <class M>
+std::vector<double> reference_predictions(const M &model, const num_array<double> &X){
+    std::stringstream ss;
+    REQUIRE( model.write_to(ss) );
+
+    std::vector<std::unique_ptr<reference_node>> trees;
+    std::string token;
+    while(ss >> token){
+        if(token != "begin_tree") continue;
+
+        // Forests number their trees; the single tree is not numbered.
+        ss >> token;
+        if((token != "L") && (token != "I")) ss >> token;
+        trees.push_back(read_reference_node(ss, token));
+        ss >> token;
+        REQUIRE( token == "end_tree" );
+    }
+    REQUIRE( !trees.empty() );
+
+    std::vector<double> out;
+    for(int64_t r = 0; r < X.num_rows(); ++r){
+        double sum = 0.0;
+        for(const auto &t : trees) sum += walk_reference_tree(t.get(), X, r);
+        out.push_back(sum / static_cast<double>(trees.size()));
+    }
+    return out;
+}
+
+// Check predict_batch() and predict() against the reference predictions. The models average the trees by
+// multiplying with the reciprocal of the tree count, so they can differ from the reference in the last bits.
+template <class M>
+void check_predict_batch(const M &model, const num_array<double> &X){
+    const auto expected = reference_predictions(model, X);
+    const auto preds = model.predict_batch(X);
+    REQUIRE( preds.num_rows() == X.num_rows() );
+    REQUIRE( preds.num_cols() == 1 );
+
+    num_array<double> x(1, X.num_cols());
+    for(int64_t i = 0; i < X.num_rows(); ++i){
+        const double tol = 1.0e-12 * std::max(1.0, std::abs(expected[i]));
+        REQUIRE( std::abs(preds.read_coeff(i, 0) - expected[i]) <= tol );
+
+        for(int64_t c = 0; c < X.num_cols(); ++c) x.coeff(0, c) = X.read_coeff(i, c);
+        REQUIRE( model.predict(x) == preds.read_coeff(i, 0) );
+    }
+}
+
+// Check the binary model format: fitting enables writing, the format is detected, the round trip reproduces the
+// model exactly, and corrupt, truncated, or mismatched models are rejected without altering the model.
+//
+// 'model' must be unfitted; it is fitted to X and y. 'other_kind' is a different kind of model.
+template <template <class> class Model>
+void check_binary_model_format(Model<double> &model,
+                               const num_array<double> &X,
+                               const num_array<double> &y,
+                               Stats::BinaryModelKind kind,
+                               Stats::BinaryModelKind other_kind){
+    {
+        std::stringstream ss;
+        REQUIRE( !model.write_binary(ss) );
+    }
+    model.fit(X, y);
+
+    std::stringstream bin;
+    REQUIRE( model.write_binary(bin) );
+    const std::string bytes = bin.str();
+    std::stringstream text;
+    REQUIRE( model.write_to(text) );
+
+    // Binary and text models are distinguished.
+    REQUIRE( Stats::is_binary_model(bin) );
+    REQUIRE( Stats::is_binary_model(bin) ); // Nothing was consumed.
+    REQUIRE( !Stats::is_binary_model(text) );
+    {
+        std::stringstream empty;
+        REQUIRE( !Stats::is_binary_model(empty) );
+    }
+    Stats::BinaryModelHeader h;
+    REQUIRE( Stats::peek_binary_model_header(bin, h) );
+    REQUIRE( h.kind == static_cast<uint32_t>(kind) );
+    REQUIRE( h.n_features == static_cast<uint64_t>(X.num_cols()) );
+
+    // The round trip reproduces the model.
+    {
+        Model<double> model2;
+        REQUIRE( model2.read_binary(bin) );
+
+        std::stringstream text2;
+        REQUIRE( model2.write_to(text2) );
+        REQUIRE( text2.str() == text.str() );
+
+        const auto p1 = model.predict_batch(X);
+        const auto p2 = model2.predict_batch(X);
+        for(int64_t i = 0; i < X.num_rows(); ++i){
+            REQUIRE( p1.read_coeff(i, 0) == p2.read_coeff(i, 0) );
+        }
+
+        // Writing the restored model reproduces the same bytes.
+        std::stringstream bin2;
+        REQUIRE( model2.write_binary(bin2) );
+        REQUIRE( bin2.str() == bytes );
+    }
+
+    // Corrupt, truncated, or mismatched models are rejected.
+    Model<double> model2;
+
+    std::string s = bytes;
+    s[s.size() - 20] ^= 0x10;
+    std::stringstream flipped(s);
+    REQUIRE( !model2.read_binary(flipped) );
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() / 2));
+    REQUIRE( !model2.read_binary(truncated) );
+
+    s = bytes;
+    std::memcpy(&h, s.data(), sizeof(h));
+    h.kind = static_cast<uint32_t>(other_kind);
+    std::memcpy(&s[0], &h, sizeof(h));
+    std::stringstream other(s);
+    REQUIRE( !model2.read_binary(other) );
+
+    // A different floating-point type.
+    Model<float> model_f;
+    std::stringstream ss(bytes);
+    REQUIRE( !model_f.read_binary(ss) );
+
+    // Text models are not accepted.
+    REQUIRE( !model2.read_binary(text) );
+
+    // A failed read leaves the model untouched.
+    REQUIRE_THROWS( model2.predict_batch(X) );
+    std::stringstream truncated2(bytes.substr(0, bytes.size() / 2));
+    REQUIRE( !model.read_binary(truncated2) );
+    const auto p = model.predict_batch(X);
+    REQUIRE( p.num_rows() == X.num_rows() );
+    std::stringstream text3;
+    REQUIRE( model.write_to(text3) );
+    REQUIRE( text3.str() == text.str() );
+}
+
+} // namespace tree_model_testing
@@ -35,8 +35,13 @@ g++ \
   YgorContainers/*.cc \
   YgorFilesDirs.cc \
   YgorImages.cc \
+  YgorImagesMeshes.cc \
+  YgorIndex.cc \
+  YgorIndexBVH.cc \
   YgorIndexCells.cc \
   YgorIndexKDTree.cc \
+  YgorIndexLinearOctree.cc \
+  YgorIndexMapped.cc \
   YgorIndexOctree.cc \
   YgorIndexRTree.cc \
   YgorIO.cc \
@@ -70,6 +75,7 @@ g++ \
   YgorStats.cc \
   YgorStatsCITrees.cc \
   YgorStatsConditionalForests.cc \
+  YgorStatsPermutationTests.cc \
   YgorStatsStochasticForests.cc \
   YgorString.cc \
   YgorTime/*.cc \